@@ -67,8 +67,9 @@ def init_warehouse():
 
 def load_clinical_data():
     """Extract clinical decisions, decrypt, aggregate, and load."""
-    logger = DecisionLogger(db_path="../../services/control-engine/pacing_decisions.db")
+    logger = DecisionLogger()
     decisions = logger.get_decisions(limit=5000)
+    logger.close()
     
     if not decisions:
         print("No clinical decisions found to aggregate.")
@@ -131,8 +131,8 @@ void processLine(String line) {
   if (now - lastPublish < PUBLISH_MIN_MS) return;
   lastPublish = now;
 
-  char out[64];
-  snprintf(out, sizeof(out), "{\"value\":%d,\"ts\":%lu}", value, now);
+  char out[96];
+  snprintf(out, sizeof(out), "{\"device_id\":\"%s\",\"value\":%d,\"ts\":%lu}", MQTT_CLIENT_ID, value, now);
   if (mqttClient.connected()) {
     bool ok = mqttClient.publish(TOPIC_SENSOR_DATA, out);
     if (!ok) Serial.println("MQTT publish failed");
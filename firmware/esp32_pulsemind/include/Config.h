@@ -11,6 +11,7 @@
 // ADC Configuration
 #define ADC_SAMPLE_RATE_HZ  100  // Sampling rate for PPG
 #define ADC_RESOLUTION_BITS 12
+#define PPG_BATCH_SAMPLES   10   // Samples per sensor frame (10 frames/s at 100 Hz)
 
 // ==========================================
 // Network Configuration
@@ -26,8 +27,15 @@
 
 // MQTT Topics
 #define TOPIC_SENSOR_DATA   "pulsemind/sensor/ppg"
-#define TOPIC_PACING_CMD    "pulsemind/pacing/command"
+#define TOPIC_PACING_CMD    "pulsemind/pacing/command"      // Prefix only: not subscribed (shared by devices)
+#define TOPIC_PACING_CMD_DEVICE TOPIC_PACING_CMD "/" MQTT_CLIENT_ID  // Ingest worker commands
 #define TOPIC_DEVICE_STATUS "pulsemind/device/status"
+#define TOPIC_DEVICE_TRACE  "pulsemind/device/trace"   // Closed-loop timing of traced commands
+
+#define MQTT_COMMAND_DRAIN_MAX 8     // Received packets handled per loop before telemetry is written
+#define STATUS_INTERVAL_MS  10000    // Device status (with command latency) period
+#define MQTT_BUFFER_BYTES   1024     // PubSubClient packet buffer; the status frame carries metrics
+#define TRACE_EVERY_N_FRAMES 1       // Sensor frames carrying a sampled traceparent (0: none)
 
 // ==========================================
 // Safety Configuration
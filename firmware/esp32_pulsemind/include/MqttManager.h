@@ -24,6 +24,7 @@ private:
 public:
     MqttManager(PacingController* controller) : client(espClient), pacingController(controller), lastReconnectAttempt(0) {
         client.setServer(MQTT_BROKER, MQTT_PORT);
+        client.setBufferSize(MQTT_BUFFER_BYTES);
     }
 
     void setCallback(MQTT_CALLBACK_SIGNATURE) {
@@ -56,13 +57,19 @@ public:
                 reconnect();
             }
         } else {
+            // Drain received packets (pacing commands) before the caller
+            // writes telemetry; PubSubClient::loop() handles one per call
             client.loop();
+            for (int i = 1; i < MQTT_COMMAND_DRAIN_MAX && espClient.available() > 0; i++) {
+                client.loop();
+            }
         }
     }
 
     void reconnect() {
         if (client.connect(MQTT_CLIENT_ID)) {
-            client.subscribe(TOPIC_PACING_CMD);
+            // Policy inputs are per patient: only the device topic
+            client.subscribe(TOPIC_PACING_CMD_DEVICE);
             client.publish(TOPIC_DEVICE_STATUS, "{\"status\":\"connected\",\"fw_version\":\"1.0.0\"}");
         }
     }
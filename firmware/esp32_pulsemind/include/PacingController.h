@@ -4,9 +4,48 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include "Config.h"
+#include "SafetyPolicy.h"
+
+/**
+ * Latency from a sample to an event (command receipt, actuation) over a
+ * status interval.
+ */
+struct CommandLatency {
+    unsigned long count;
+    unsigned long lastMs;
+    unsigned long maxMs;
+    unsigned long totalMs;
+};
 
 /**
  * Manages LED output based on pacing commands.
+ *
+ * When a command carries its decision inputs (input_summary), the shared
+ * safety policy is re-evaluated locally and its result is authoritative, so
+ * the device enforces the same safety envelope as the control-engine.
+ * Otherwise the server's rate is clamped to the absolute safe bounds.
+ * The inputs come with the server's policy_state before that decision,
+ * which the local policy adopts first: the device only sees the decisions
+ * the command shaper publishes, so hysteresis counted locally would run on
+ * a subsampled stream.
+ *
+ * Commands are taken from the device's own topic (TOPIC_PACING_CMD_DEVICE)
+ * only, and ignored when addressed to another device_id.
+ *
+ * The resulting goal is passed through the shared command shaper in
+ * update(), so the delivered rate slews gradually between commands
+ * (EMERGENCY pacing applies immediately).
+ *
+ * Commands from the ingest worker echo the device time of the sample that
+ * triggered them (frame_ts_ms); the sample-to-command latency is tracked
+ * per status interval.
+ *
+ * A traced command (traceparent) is followed to its actuation: the first
+ * update() applying it, then the first pacing pulse under it (the apply
+ * itself when it turned pacing off). The timings are then available from
+ * takeTraceReport() for TOPIC_DEVICE_TRACE, and the sample-to-actuation
+ * latency is tracked alongside the command latency. A newer command
+ * replaces a trace still in flight.
  */
 class PacingController {
 private:
@@ -21,8 +60,69 @@ private:
     unsigned long ledOnTime;
     const unsigned long paceDuration = 20; // 20ms pulse duration
 
+    pulsemind::AdaptivePacingPolicy localPolicy;
+    pulsemind::CommandShaper shaper;
+    bool goalEnabled;
+    double goalRateBpm;
+    bool goalImmediate;
+    bool hasGoal;
+    CommandLatency latency;
+    CommandLatency actuationLatency;
+
+    // Traced command in flight (device millis())
+    enum class TraceStage : uint8_t { None, AwaitApply, AwaitPulse, Ready };
+    TraceStage traceStage;
+    char traceparent[56];
+    unsigned long traceSampleMs;
+    unsigned long traceRxMs;
+    unsigned long traceAppliedMs;
+    unsigned long traceActuationMs;
+
+    static void recordLatency(CommandLatency& l, unsigned long elapsed) {
+        l.count++;
+        l.lastMs = elapsed;
+        l.totalMs += elapsed;
+        if (elapsed > l.maxMs) {
+            l.maxMs = elapsed;
+        }
+    }
+
+    static bool addressedHere(JsonVariantConst deviceId) {
+        return deviceId.isNull() || strcmp(deviceId | "", MQTT_CLIENT_ID) == 0;
+    }
+
+    /**
+     * Take over the decision-relevant part of the server's policy state
+     * (the violation totals stay local). A missing or malformed state
+     * leaves the local one in place.
+     */
+    void adoptPolicyState(JsonObjectConst server) {
+        pulsemind::SafetyState current;
+        if (server.isNull() || !pulsemind::parseSafetyState(server["current_state"] | "", current) ||
+            !server["consecutive_degraded_cycles"].is<uint32_t>() ||
+            !server["consecutive_safe_cycles"].is<uint32_t>()) {
+            return;
+        }
+        pulsemind::PolicyState& s = localPolicy.state();
+        s.currentState = static_cast<uint8_t>(current);
+        s.consecutiveDegradedCycles = server["consecutive_degraded_cycles"];
+        s.consecutiveSafeCycles = server["consecutive_safe_cycles"];
+        JsonVariantConst lastRate = server["last_pacing_rate"];
+        s.hasLastRate = lastRate.is<double>() ? 1 : 0;
+        s.lastPacingRate = lastRate | 0.0;
+    }
+
+    void traceActuated(unsigned long now) {
+        traceActuationMs = now;
+        traceStage = TraceStage::Ready;
+        recordLatency(actuationLatency, now - traceSampleMs);
+    }
+
 public:
-    PacingController(uint8_t pin) : ledPin(pin), pacingEnabled(false), targetRateBpm(60.0), amplitudeMs(0), lastPaceTime(0), ledState(false) {}
+    PacingController(uint8_t pin) : ledPin(pin), pacingEnabled(false), targetRateBpm(60.0), amplitudeMs(0), lastPaceTime(0), paceInterval(1000), ledState(false),
+        goalEnabled(false), goalRateBpm(60.0), goalImmediate(false), hasGoal(false), latency{0, 0, 0, 0},
+        actuationLatency{0, 0, 0, 0}, traceStage(TraceStage::None), traceparent{0}, traceSampleMs(0), traceRxMs(0),
+        traceAppliedMs(0), traceActuationMs(0) {}
 
     void begin() {
         pinMode(ledPin, OUTPUT);
@@ -33,26 +133,105 @@ public:
      * Process a received pacing command JSON.
      */
     void processCommand(const char* jsonPayload) {
-        DynamicJsonDocument doc(512);
+        unsigned long rxMs = millis();
+        DynamicJsonDocument doc(1536);
         DeserializationError error = deserializeJson(doc, jsonPayload);
 
         if (error) {
             return; // Ignore invalid JSON
         }
+        if (!addressedHere(doc["device_id"]) || !addressedHere(doc["input_summary"]["device_id"])) {
+            return; // Another patient's command
+        }
+
+        traceStage = TraceStage::None;
+        if (doc.containsKey("frame_ts_ms")) {
+            // Same clock as the frame's ts (millis), so wraparound cancels out
+            unsigned long sampleMs = doc["frame_ts_ms"].as<unsigned long>();
+            recordLatency(latency, rxMs - sampleMs);
+
+            const char* parent = doc["traceparent"] | "";
+            if (strlen(parent) == sizeof(traceparent) - 1) {
+                memcpy(traceparent, parent, sizeof(traceparent));
+                traceSampleMs = sampleMs;
+                traceRxMs = rxMs;
+                traceStage = TraceStage::AwaitApply;
+            }
+        }
 
         // Extract command fields
         // structure matches control-engine output
-        if (doc.containsKey("pacing_command")) {
+        if (doc.containsKey("input_summary")) {
+            // Re-run the shared policy on the same inputs (defaults match
+            // process_pacing_decision), from the server's state
+            adoptPolicyState(doc["policy_state"]);
+            JsonObject in = doc["input_summary"];
+            double confidence = in["rhythm_confidence"] | 0.0;
+            double hsi = in["hsi_score"] | 50.0;
+            double heartRate = in["heart_rate_bpm"] | 70.0;
+            pulsemind::sanitizeInputs(confidence, hsi, heartRate);
+
+            pulsemind::PacingCommand local = localPolicy.compute(
+                pulsemind::parseRhythm(in["rhythm_class"] | "artifact"),
+                confidence, hsi,
+                pulsemind::parseTrend(in["hsi_trend"] | "stable"),
+                heartRate);
+
+            goalEnabled = local.pacingEnabled;
+            goalRateBpm = local.targetRateBpm;
+            goalImmediate = local.mode == pulsemind::PacingMode::Emergency;
+            hasGoal = true;
+        } else if (doc.containsKey("pacing_command")) {
             JsonObject cmd = doc["pacing_command"];
-            pacingEnabled = cmd["pacing_enabled"] | false;
-            targetRateBpm = cmd["target_rate_bpm"] | 60.0;
-            
-            // Safety clamp
-            if (targetRateBpm < 30) targetRateBpm = 30;
-            if (targetRateBpm > 200) targetRateBpm = 200;
-            
-            paceInterval = 60000 / targetRateBpm;
+            goalEnabled = cmd["pacing_enabled"] | false;
+            goalRateBpm = pulsemind::clampRate(cmd["target_rate_bpm"] | 60.0);
+            goalImmediate = strcmp(cmd["pacing_mode"] | "", "emergency") == 0;
+            hasGoal = true;
+        }
+    }
+
+    /**
+     * Current safety state of the local policy (for status reporting).
+     */
+    const char* safetyStateName() const {
+        return pulsemind::safetyStateName(
+            static_cast<pulsemind::SafetyState>(localPolicy.state().currentState));
+    }
+
+    /**
+     * Sample-to-command latency since the last resetCommandLatency().
+     */
+    const CommandLatency& commandLatency() const {
+        return latency;
+    }
+
+    /**
+     * Sample-to-actuation latency of traced commands, over the same interval.
+     */
+    const CommandLatency& commandActuationLatency() const {
+        return actuationLatency;
+    }
+
+    void resetCommandLatency() {
+        latency = CommandLatency{0, 0, 0, 0};
+        actuationLatency = CommandLatency{0, 0, 0, 0};
+    }
+
+    /**
+     * Write the timing report of a traced command once it has actuated;
+     * false when there is none (or it does not fit).
+     */
+    bool takeTraceReport(char* out, size_t size) {
+        if (traceStage != TraceStage::Ready) {
+            return false;
         }
+        traceStage = TraceStage::None;
+        int len = snprintf(out, size,
+                           "{\"device_id\":\"%s\",\"traceparent\":\"%s\",\"sample_ms\":%lu,\"command_rx_ms\":%lu,"
+                           "\"applied_ms\":%lu,\"actuation_ms\":%lu,\"now_ms\":%lu}",
+                           MQTT_CLIENT_ID, traceparent, traceSampleMs, traceRxMs, traceAppliedMs,
+                           traceActuationMs, millis());
+        return len > 0 && (size_t)len < size;
     }
 
     /**
@@ -60,7 +239,22 @@ public:
      * Should be called frequently.
      */
     void update() {
+        if (hasGoal) {
+            pulsemind::ShapedCommand shaped = shaper.shape(goalEnabled, goalRateBpm, goalImmediate, millis());
+            goalImmediate = false;
+            pacingEnabled = shaped.pacingEnabled;
+            targetRateBpm = (float)shaped.rateBpm;
+            paceInterval = 60000 / targetRateBpm;
+            if (traceStage == TraceStage::AwaitApply) {
+                traceAppliedMs = millis();
+                traceStage = TraceStage::AwaitPulse;
+            }
+        }
+
         if (!pacingEnabled) {
+            if (traceStage == TraceStage::AwaitPulse) {
+                traceActuated(traceAppliedMs); // Turning pacing off is the actuation
+            }
             if (ledState) {
                 digitalWrite(ledPin, LOW);
                 ledState = false;
@@ -76,6 +270,9 @@ public:
             ledState = true;
             lastPaceTime = now;
             ledOnTime = now;
+            if (traceStage == TraceStage::AwaitPulse) {
+                traceActuated(now);
+            }
         }
         
         // Turn OFF LED
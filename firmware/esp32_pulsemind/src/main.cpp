@@ -1,5 +1,8 @@
 #include <Arduino.h>
+#include <esp_random.h>
 #include <esp_task_wdt.h>
+#include <esp_timer.h>
+#include <inttypes.h>
 #include "Config.h"
 #include "SensorManager.h"
 #include "MqttManager.h"
@@ -23,7 +26,7 @@ void mqttCallback(char* topic, byte* payload, unsigned int length) {
     }
     
     // Check topic and route to appropriate controller
-    if (String(topic) == TOPIC_PACING_CMD) {
+    if (strcmp(topic, TOPIC_PACING_CMD_DEVICE) == 0) {
         pacer->processCommand(msg.c_str());
     }
 }
@@ -62,25 +65,96 @@ void loop() {
     // 1. Service Watchdog
     esp_task_wdt_reset();
 
-    // 2. Update Network
+    // 2. Update Network (received commands are applied before any telemetry is written)
     mqtt->update();
 
     // 3. Update Pacing Logic (High Priority)
     pacer->update();
 
+    // Timing of a traced command, once its first pulse is out
+    static char traceBuffer[256];
+    if (pacer->takeTraceReport(traceBuffer, sizeof(traceBuffer))) {
+        mqtt->publish(TOPIC_DEVICE_TRACE, traceBuffer);
+    }
+
     // 4. Sample Sensor
     float ppgValue = 0;
     if (sensor->update(ppgValue)) {
-        // Publish Sensor Data
-        // Optimization: Don't publish too fast if network is slow
-        // For real-time PPG, we typically batch or use UDP, but for this demo MQTT is fine
-        // provided latency is acceptable.
-        
-        static char jsonBuffer[64];
-        snprintf(jsonBuffer, sizeof(jsonBuffer), "{\"ppg\":%.2f,\"ts\":%lu}", ppgValue, millis());
-        mqtt->publish(TOPIC_SENSOR_DATA, jsonBuffer);
+        // Publish Sensor Data in frames of PPG_BATCH_SAMPLES: one MQTT
+        // message per 100 ms instead of per sample. The device id lets the
+        // ingest worker keep per-device windows; ts is the first sample's time.
+        // A traced frame starts a new trace, rooted at a span whose id is
+        // the trace id's low half so the ingest worker can name it from
+        // the device's trace report.
+        static float batch[PPG_BATCH_SAMPLES];
+        static unsigned long batchStartMs = 0;
+        static int batched = 0;
+
+        if (batched == 0) {
+            batchStartMs = millis();
+        }
+        batch[batched++] = ppgValue;
+        if (batched == PPG_BATCH_SAMPLES) {
+            static unsigned long framesSinceTrace = 0;
+            char traceparent[80] = "";
+            if (TRACE_EVERY_N_FRAMES > 0 && ++framesSinceTrace >= TRACE_EVERY_N_FRAMES) {
+                framesSinceTrace = 0;
+                uint32_t id[4] = {esp_random(), esp_random(), esp_random(), esp_random()};
+                snprintf(traceparent, sizeof(traceparent),
+                         "\"traceparent\":\"00-%08" PRIx32 "%08" PRIx32 "%08" PRIx32 "%08" PRIx32
+                         "-%08" PRIx32 "%08" PRIx32 "-01\",",
+                         id[0], id[1], id[2], id[3], id[2], id[3]);
+            }
+            static char jsonBuffer[320];
+            int len = snprintf(jsonBuffer, sizeof(jsonBuffer),
+                               "{\"device_id\":\"%s\",\"ts\":%lu,\"fs\":%d,%s\"ppg\":[",
+                               MQTT_CLIENT_ID, batchStartMs, ADC_SAMPLE_RATE_HZ, traceparent);
+            for (int i = 0; i < PPG_BATCH_SAMPLES; i++) {
+                len += snprintf(jsonBuffer + len, sizeof(jsonBuffer) - len, i ? ",%.2f" : "%.2f", batch[i]);
+            }
+            snprintf(jsonBuffer + len, sizeof(jsonBuffer) - len, "]}");
+            mqtt->publish(TOPIC_SENSOR_DATA, jsonBuffer);
+            batched = 0;
+        }
     }
     
-    // 5. Short yield to let IDLE task run
+    // 5. Periodic status with command and actuation latency. "metrics"
+    // repeats it under the names the services' /metrics use: _total series
+    // are counters since boot, the rest gauges over the last interval; the
+    // ingest worker exports them as they are
+    static unsigned long lastStatusMs = 0;
+    if (millis() - lastStatusMs >= STATUS_INTERVAL_MS) {
+        lastStatusMs = millis();
+        const CommandLatency& latency = pacer->commandLatency();
+        const CommandLatency& actuation = pacer->commandActuationLatency();
+        const unsigned long latencyAvgMs = latency.count ? latency.totalMs / latency.count : 0UL;
+        const unsigned long actuationAvgMs = actuation.count ? actuation.totalMs / actuation.count : 0UL;
+        static uint64_t commandsTotal = 0, actuationsTotal = 0;
+        commandsTotal += latency.count;
+        actuationsTotal += actuation.count;
+        static char statusBuffer[896];
+        snprintf(statusBuffer, sizeof(statusBuffer),
+                 "{\"device_id\":\"%s\",\"status\":\"ok\",\"safety_state\":\"%s\",\"commands\":%lu,"
+                 "\"cmd_latency_ms\":{\"last\":%lu,\"avg\":%lu,\"max\":%lu},"
+                 "\"actuation_latency_ms\":{\"last\":%lu,\"avg\":%lu,\"max\":%lu},"
+                 "\"metrics\":{\"pulsemind_device_uptime_seconds\":%" PRIu64 ","
+                 "\"pulsemind_device_free_heap_bytes\":%" PRIu32 ","
+                 "\"pulsemind_device_commands_total\":%" PRIu64 ","
+                 "\"pulsemind_device_command_latency_avg_seconds\":%lu.%03lu,"
+                 "\"pulsemind_device_command_latency_max_seconds\":%lu.%03lu,"
+                 "\"pulsemind_device_actuations_total\":%" PRIu64 ","
+                 "\"pulsemind_device_actuation_latency_avg_seconds\":%lu.%03lu,"
+                 "\"pulsemind_device_actuation_latency_max_seconds\":%lu.%03lu}}",
+                 MQTT_CLIENT_ID, pacer->safetyStateName(), latency.count, latency.lastMs, latencyAvgMs,
+                 latency.maxMs, actuation.lastMs, actuationAvgMs, actuation.maxMs,
+                 (uint64_t)(esp_timer_get_time() / 1000000), ESP.getFreeHeap(),
+                 commandsTotal, latencyAvgMs / 1000, latencyAvgMs % 1000, latency.maxMs / 1000, latency.maxMs % 1000,
+                 actuationsTotal, actuationAvgMs / 1000, actuationAvgMs % 1000,
+                 actuation.maxMs / 1000, actuation.maxMs % 1000);
+        mqtt->publish(TOPIC_DEVICE_STATUS, statusBuffer);
+        pacer->resetCommandLatency();
+    }
+
+    // 6. Short yield to let IDLE task run
     delay(1); 
 }
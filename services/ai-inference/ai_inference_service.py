@@ -15,8 +15,10 @@ from rhythm_classifier import (  # noqa: E402
     get_model_status,
     load_model_async,
 )
+from shared import metrics  # noqa: E402
 from shared.logger import setup_logger  # noqa: E402
 from shared.shutdown import register_shutdown_handler  # noqa: E402
+from shared.tracing import instrument_flask, setup_tracing  # noqa: E402
 from trust_layer import apply_trust_layer  # noqa: E402
 
 try:
@@ -34,6 +36,16 @@ except ImportError:
 logger = setup_logger("ai-inference", level="INFO")
 
 app = Flask(__name__)
+instrument_flask(app, setup_tracing("ai-inference"))
+registry = metrics.instrument_flask(app, "ai-inference")
+predict_seconds = registry.histogram(
+    "pulsemind_processing_duration_seconds", "Time spent in a service's processing steps",
+    service="ai-inference", operation="predict",
+)
+inference_seconds = registry.histogram(
+    "pulsemind_processing_duration_seconds", "Time spent in a service's processing steps",
+    service="ai-inference", operation="inference",
+)
 
 # Start async model loading in background thread
 # Design Decision: Non-blocking startup - service can handle health checks
@@ -223,6 +235,9 @@ def predict():
 
         # processing time added
         processing_time_ms = (time.time() - start_time) * 1000
+        predict_seconds.observe(processing_time_ms / 1000)
+        if "inference_time_ms" in prediction:
+            inference_seconds.observe(prediction["inference_time_ms"] / 1000)
 
         result = {
             "success": True,
@@ -289,7 +289,37 @@ def classify_rhythm(
     start_time = time.time()
     rhythm_class, confidence, all_probs = classifier.predict(features)
     inference_time_ms = (time.time() - start_time) * 1000
-    
+
+    result = build_prediction(rhythm_class, confidence, all_probs, inference_time_ms)
+
+    logger.info(
+        f"Classification: {rhythm_class} (confidence: {confidence:.2f}, "
+        f"{inference_time_ms:.2f}ms)"
+    )
+
+    return result
+
+
+def build_prediction(
+    rhythm_class: str,
+    confidence: float,
+    all_probs: List[float],
+    inference_time_ms: float
+) -> Dict:
+    """Assemble the prediction dictionary returned by classify_rhythm.
+
+    Shared with the pipeline-service, which evaluates the same forest
+    natively, so both report predictions in one schema.
+
+    Args:
+        rhythm_class: Predicted rhythm class
+        confidence: Probability of the predicted class
+        all_probs: Class probabilities in model class order
+        inference_time_ms: Time spent in the model
+
+    Returns:
+        Dictionary with classification results
+    """
     # Determine confidence level
     if confidence >= CONFIDENCE_HIGH:
         confidence_level = "high"
@@ -314,11 +344,6 @@ def classify_rhythm(
         "inference_time_ms": round(inference_time_ms, 3)
     }
 
-    logger.info(
-        f"Classification: {rhythm_class} (confidence: {confidence:.2f}, "
-        f"{inference_time_ms:.2f}ms)"
-    )
-
     return result
 
 
@@ -1,22 +1,18 @@
 import os
 import sys
+from contextlib import asynccontextmanager
 from datetime import datetime
-from typing import Dict
 
-import requests
 from fastapi import FastAPI, HTTPException
 from fastapi.responses import JSONResponse
-from tenacity import (
-    retry,
-    retry_if_exception_type,
-    stop_after_attempt,
-    wait_exponential,
-)
 
 # Add shared module to path
 sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+from shared import metrics  # noqa: E402
 from shared.logger import setup_logger  # noqa: E402
-from shared.security_utils import decode_access_token, create_access_token # noqa: E402
+from shared.security_utils import decode_access_token, create_access_token, access_token_verifier # noqa: E402
+from health_prober import HealthProber  # noqa: E402
+from upstream import CircuitBreaker, UpstreamClient  # noqa: E402
 
 from fastapi import FastAPI, HTTPException, Depends, Security
 from fastapi.security import HTTPBearer, HTTPAuthorizationCredentials
@@ -24,8 +20,12 @@ from fastapi.responses import JSONResponse
 
 security = HTTPBearer()
 
-def get_current_user(credentials: HTTPAuthorizationCredentials = Security(security)):
-    """Validate JWT token and return user data."""
+async def get_current_user(credentials: HTTPAuthorizationCredentials = Security(security)):
+    """Validate JWT token and return user data.
+
+    Async on purpose: verification is cached and takes microseconds, so it
+    runs on the event loop instead of costing a threadpool hop per request.
+    """
     token = credentials.credentials
     payload = decode_access_token(token)
     if not payload:
@@ -39,7 +39,40 @@ def get_current_user(credentials: HTTPAuthorizationCredentials = Security(securi
 # Initialize logger
 logger = setup_logger("api-gateway", level="INFO")
 
-app = FastAPI(title="PulseMind - API Gateway")
+# Pooled keep-alive connections, hedging and circuit breakers per backend
+upstream_client = UpstreamClient()
+
+
+@asynccontextmanager
+async def lifespan(app: FastAPI):
+    health_prober.start()
+    yield
+    await health_prober.stop()
+    upstream_client.close()
+
+
+app = FastAPI(title="PulseMind - API Gateway", lifespan=lifespan)
+metrics_registry = metrics.instrument_fastapi(app, "api-gateway")
+
+# Upstream counters are kept by UpstreamClient and copied in at each scrape
+UPSTREAM_COUNTERS = ("requests", "failures", "timeouts", "hedges", "hedge_wins", "short_circuited")
+
+
+def collect_upstream_metrics():
+    for upstream, stats in upstream_client.stats().items():
+        for key in UPSTREAM_COUNTERS:
+            metrics_registry.counter(
+                f"pulsemind_upstream_{key}_total", f"Upstream {key.replace('_', ' ')}", upstream=upstream
+            ).store(stats[key])
+        metrics_registry.gauge(
+            "pulsemind_upstream_in_flight", "Upstream requests in flight", upstream=upstream
+        ).set(stats["in_flight"])
+        metrics_registry.gauge(
+            "pulsemind_upstream_circuit_open", "1 while the upstream's circuit breaker is open", upstream=upstream
+        ).set(stats["circuit"] == CircuitBreaker.OPEN)
+
+
+metrics_registry.add_collector(collect_upstream_metrics)
 
 # Service registry
 SERVICES = {
@@ -50,28 +83,26 @@ SERVICES = {
 }
 
 
-@retry(
-    stop=stop_after_attempt(3),
-    wait=wait_exponential(multiplier=1, min=1, max=4),
-    retry=retry_if_exception_type((requests.ConnectionError, requests.Timeout)),
-    reraise=True
+# Backend health is probed in the background; /services reads the snapshot
+HEALTH_PROBE_INTERVAL_S = float(os.getenv("PULSEMIND_HEALTH_PROBE_INTERVAL_S", "5"))
+HEALTH_PROBE_TIMEOUT_S = float(os.getenv("PULSEMIND_HEALTH_PROBE_TIMEOUT_S", "2"))
+
+# How long a request may wait for the first probe round after startup
+HEALTH_STARTUP_WAIT_S = 5.0
+
+health_prober = HealthProber(
+    SERVICES,
+    upstream_client,
+    interval=HEALTH_PROBE_INTERVAL_S,
+    timeout=HEALTH_PROBE_TIMEOUT_S,
 )
-def call_service_with_retry(url: str, timeout: int = 5) -> Dict:
-    """Make HTTP request with retry logic.
 
-    Args:
-        url: Service URL to call
-        timeout: Request timeout in seconds
-    
-    Returns:
-        JSON response from service
-    """
-    logger.info(f"Calling service: {url}")
-    response = requests.get(url, timeout=timeout)
-    response.raise_for_status()
-    result: Dict = response.json()
-    return result
 
+async def current_health_snapshot():
+    """The latest probe round, or 503 if the first round has not finished."""
+    if not await health_prober.wait_ready(HEALTH_STARTUP_WAIT_S):
+        raise HTTPException(status_code=503, detail="Service health not yet probed")
+    return health_prober.snapshot
 
 @app.get("/health")
 async def health_check():
@@ -129,44 +160,20 @@ async def login(request: LoginRequest):
 async def list_services(user: dict = Depends(get_current_user)):
     """List all available services with their health status.
 
+    Served from the background prober's latest snapshot; `freshness` tells
+    how old it is.
+
     Returns:
         Dictionary of services with their status
     """
     logger.info("Services endpoint requested")
-    
-    services_status = {}
-    
-    for service_name, service_url in SERVICES.items():
-        try:
-            health_url = f"{service_url}/health"
-            health_data = call_service_with_retry(health_url, timeout=5)
-            
-            services_status[service_name] = {
-                "url": service_url,
-                "status": "healthy",
-                "health_data": health_data
-            }
-            logger.info(f"Service {service_name} is healthy")
-            
-        except requests.RequestException as e:
-            services_status[service_name] = {
-                "url": service_url,
-                "status": "unhealthy",
-                "error": str(e)
-            }
-            logger.error(f"Service {service_name} is unhealthy: {str(e)}")
-        except Exception as e:
-            services_status[service_name] = {
-                "url": service_url,
-                "status": "error",
-                "error": str(e)
-            }
-            logger.error(f"Error checking service {service_name}: {str(e)}")
-    
+    snapshot = await current_health_snapshot()
+
     return {
         "timestamp": datetime.utcnow().isoformat() + 'Z',
-        "total_services": len(SERVICES),
-        "services": services_status
+        "total_services": len(snapshot.services),
+        "services": snapshot.services,
+        "freshness": health_prober.freshness(snapshot)
     }
 
 
@@ -186,28 +193,39 @@ async def get_service_info(service_name: str, user: dict = Depends(get_current_u
         logger.warning(f"Service not found: {service_name}")
         raise HTTPException(status_code=404, detail=f"Service '{service_name}' not found")
     
-    service_url = SERVICES[service_name]
-    
-    try:
-        health_url = f"{service_url}/health"
-        health_data = call_service_with_retry(health_url, timeout=5)
-        
-        logger.info(f"Successfully retrieved info for {service_name}")
-        return {
-            "service_name": service_name,
-            "url": service_url,
-            "status": "healthy",
-            "health_data": health_data,
-            "timestamp": datetime.utcnow().isoformat() + 'Z'
-        }
-        
-    except requests.RequestException as e:
-        logger.error(f"Failed to get info for {service_name}: {str(e)}")
+    snapshot = await current_health_snapshot()
+    entry = snapshot.services[service_name]
+
+    if entry["status"] != "healthy":
+        logger.error(f"Failed to get info for {service_name}: {entry.get('error')}")
         raise HTTPException(
             status_code=503,
-            detail=f"Service '{service_name}' is unavailable: {str(e)}"
+            detail=f"Service '{service_name}' is unavailable: {entry.get('error')}"
         )
 
+    logger.info(f"Successfully retrieved info for {service_name}")
+    return {
+        "service_name": service_name,
+        **entry,
+        "timestamp": datetime.utcnow().isoformat() + 'Z',
+        "freshness": health_prober.freshness(snapshot)
+    }
+
+
+@app.get("/upstreams")
+async def upstream_stats(user: dict = Depends(get_current_user)):
+    """Connection pool, hedging and circuit breaker counters per backend."""
+    return {
+        "timestamp": datetime.utcnow().isoformat() + 'Z',
+        "upstreams": upstream_client.stats(),
+        "health_probes": {
+            "rounds": health_prober.rounds,
+            "probes": health_prober.probes,
+            "interval_seconds": health_prober.interval
+        },
+        "auth_cache": access_token_verifier.cache.stats()
+    }
+
 
 if __name__ == "__main__":
     import uvicorn
@@ -0,0 +1,233 @@
+"""Background Health Prober for the API Gateway.
+
+/services and /services/{name} used to probe every backend's /health on each
+request, so gateway latency followed the slowest backend and client traffic
+turned into probe traffic. Instead, one task probes all services every
+interval and publishes an immutable HealthSnapshot; handlers read the current
+snapshot and add only its age.
+
+Publishing is a single reference swap, so readers never lock and never see a
+half-updated round. Per-service entries are built once per round, with a
+bounded latency history for trends.
+"""
+
+import asyncio
+import os
+import sys
+import time
+from collections import deque
+from datetime import datetime, timezone
+from typing import Any, Deque, Dict, Mapping, Optional, Tuple
+
+# Add shared module to path
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+from shared.logger import setup_logger  # noqa: E402
+from upstream import UpstreamClient, UpstreamError  # noqa: E402
+
+logger = setup_logger("health-prober", level="INFO")
+
+
+# ============================================================================
+# CONSTANTS
+# ============================================================================
+
+PROBE_INTERVAL_SECONDS = 5.0
+PROBE_TIMEOUT_SECONDS = 2.0
+
+# Probes kept per service: 5 minutes at the default interval
+HISTORY_SIZE = 60
+
+# A snapshot older than this many intervals is flagged stale
+STALE_AFTER_INTERVALS = 3
+
+
+def _iso(epoch_seconds: float) -> str:
+    return datetime.fromtimestamp(epoch_seconds, timezone.utc).strftime("%Y-%m-%dT%H:%M:%S.%fZ")
+
+
+# ============================================================================
+# SNAPSHOT
+# ============================================================================
+
+class HealthSnapshot:
+    """Result of one probe round. Never mutated after publication."""
+
+    __slots__ = ("round", "checked_at", "services")
+
+    def __init__(self, round: int, checked_at: float, services: Dict[str, Dict[str, Any]]):
+        self.round = round
+        self.checked_at = checked_at  # Epoch seconds at the end of the round
+        self.services = services      # name -> entry, see HealthProber._entry
+
+
+class _History:
+    """Recent probe results of one service."""
+
+    __slots__ = ("latencies_ms", "consecutive_failures", "last_healthy_at", "status")
+
+    def __init__(self, size: int):
+        self.status: Optional[str] = None
+        self.latencies_ms: Deque[Optional[float]] = deque(maxlen=size)  # None = failed
+        self.consecutive_failures = 0
+        self.last_healthy_at: Optional[float] = None
+
+
+# ============================================================================
+# PROBER
+# ============================================================================
+
+class HealthProber:
+    """Probes a fixed set of services on a schedule and serves the latest results."""
+
+    def __init__(
+        self,
+        services: Mapping[str, str],
+        client: UpstreamClient,
+        interval: float = PROBE_INTERVAL_SECONDS,
+        timeout: float = PROBE_TIMEOUT_SECONDS,
+        history_size: int = HISTORY_SIZE,
+    ):
+        """
+        Args:
+            services: Service name -> base URL
+            client: Upstream client used for the probes
+            interval: Seconds between the starts of consecutive rounds
+            timeout: Per-probe timeout; kept below the interval
+            history_size: Probe results kept per service
+        """
+        self.services = dict(services)
+        self.client = client
+        self.interval = interval
+        self.timeout = min(timeout, interval)
+        self.stale_after = STALE_AFTER_INTERVALS * interval
+        self._history = {name: _History(history_size) for name in self.services}
+        self._snapshot: Optional[HealthSnapshot] = None
+        self._ready: Optional[asyncio.Event] = None
+        self._task: Optional[asyncio.Task] = None
+        self.rounds = 0
+        self.probes = 0
+
+    # ---- Probing -----------------------------------------------------------
+
+    async def _probe(self, name: str, url: str) -> Tuple[str, Optional[Dict], Optional[str], float]:
+        """Probe one service; returns (status, health_data, error, latency_ms)."""
+        started = time.perf_counter()
+        try:
+            health_data = await self.client.get_json(f"{url}/health", timeout=self.timeout)
+            status, error = "healthy", None
+        except UpstreamError as e:
+            health_data, status, error = None, "unhealthy", str(e)
+        except Exception as e:
+            health_data, status, error = None, "error", str(e)
+        return status, health_data, error, (time.perf_counter() - started) * 1000.0
+
+    def _entry(self, name: str, probe: Tuple, checked_at: float) -> Dict[str, Any]:
+        status, health_data, error, latency_ms = probe
+        history = self._history[name]
+        if status == "healthy":
+            history.latencies_ms.append(round(latency_ms, 3))
+            history.consecutive_failures = 0
+            history.last_healthy_at = checked_at
+        else:
+            history.latencies_ms.append(None)
+            history.consecutive_failures += 1
+        if status != history.status:
+            # Log transitions only; steady state costs nothing per probe
+            if status == "healthy":
+                logger.info(f"Service {name} is healthy")
+            else:
+                logger.error(f"Service {name} is {status}: {error}")
+            history.status = status
+
+        latencies = list(history.latencies_ms)
+        ok = [ms for ms in latencies if ms is not None]
+        entry: Dict[str, Any] = {
+            "url": self.services[name],
+            "status": status,
+            "checked_at": _iso(checked_at),
+            "latency_ms": round(latency_ms, 3),
+            "consecutive_failures": history.consecutive_failures,
+            "last_healthy_at": None if history.last_healthy_at is None else _iso(history.last_healthy_at),
+            "availability": round(len(ok) / len(latencies), 4),
+            "latency_p50_ms": sorted(ok)[len(ok) // 2] if ok else None,
+            "latency_max_ms": max(ok) if ok else None,
+            "latency_history_ms": latencies,
+        }
+        if health_data is not None:
+            entry["health_data"] = health_data
+        if error is not None:
+            entry["error"] = error
+        return entry
+
+    async def probe_round(self) -> HealthSnapshot:
+        """Probe every service concurrently and publish the new snapshot."""
+        probes = await asyncio.gather(
+            *(self._probe(name, url) for name, url in self.services.items())
+        )
+        checked_at = time.time()
+        services = {
+            name: self._entry(name, probe, checked_at)
+            for name, probe in zip(self.services, probes)
+        }
+        self.rounds += 1
+        self.probes += len(probes)
+        snapshot = HealthSnapshot(self.rounds, checked_at, services)
+        self._snapshot = snapshot
+        self._ready_event().set()
+        return snapshot
+
+    async def _run(self) -> None:
+        next_round = time.monotonic()
+        while True:
+            try:
+                await self.probe_round()
+            except Exception as e:
+                logger.error(f"Health probe round failed: {str(e)}")
+            # Fixed rate; a round that overruns starts the next one at once
+            next_round = max(next_round + self.interval, time.monotonic())
+            await asyncio.sleep(next_round - time.monotonic())
+
+    def start(self) -> None:
+        """Start probing from the running event loop."""
+        if self._task is None:
+            self._task = asyncio.get_running_loop().create_task(self._run())
+
+    async def stop(self) -> None:
+        if self._task is not None:
+            self._task.cancel()
+            try:
+                await self._task
+            except asyncio.CancelledError:
+                pass
+            self._task = None
+
+    # ---- Serving -----------------------------------------------------------
+
+    def _ready_event(self) -> asyncio.Event:
+        if self._ready is None:
+            self._ready = asyncio.Event()
+        return self._ready
+
+    async def wait_ready(self, timeout: float) -> bool:
+        """Wait for the first round after startup; True once a snapshot exists."""
+        if self._snapshot is None:
+            try:
+                await asyncio.wait_for(self._ready_event().wait(), timeout)
+            except asyncio.TimeoutError:
+                pass
+        return self._snapshot is not None
+
+    @property
+    def snapshot(self) -> Optional[HealthSnapshot]:
+        return self._snapshot
+
+    def freshness(self, snapshot: HealthSnapshot) -> Dict[str, Any]:
+        """Staleness metadata for a snapshot, as of now."""
+        age = max(0.0, time.time() - snapshot.checked_at)
+        return {
+            "checked_at": _iso(snapshot.checked_at),
+            "age_seconds": round(age, 3),
+            "stale": age > self.stale_after,
+            "probe_interval_seconds": self.interval,
+            "probe_round": snapshot.round,
+        }
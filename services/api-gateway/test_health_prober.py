@@ -0,0 +1,220 @@
+"""Unit tests for the gateway's background health prober.
+
+Tests probe rounds, latency history, staleness and that /services is served
+from the snapshot without touching the backends.
+"""
+import asyncio
+import os
+import sys
+import time
+import unittest
+
+os.environ.setdefault("PULSEMIND_DEV_MODE", "true")
+
+# Add the api-gateway directory to the path for imports
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+from fastapi import HTTPException  # noqa: E402
+from health_prober import HealthProber  # noqa: E402
+from test_upstream import free_port, start_backend  # noqa: E402
+from upstream import UpstreamClient  # noqa: E402
+
+
+class ProberTestCase(unittest.TestCase):
+    """Starts a healthy, a failing and a dead backend."""
+
+    def setUp(self):
+        self.healthy = start_backend()
+        self.failing = start_backend()
+        self.services = {
+            "healthy": f"http://127.0.0.1:{self.healthy.server_address[1]}",
+            # /status?code=503 stands in for a broken /health
+            "failing": f"http://127.0.0.1:{self.failing.server_address[1]}/status?code=503&x=",
+            "dead": f"http://127.0.0.1:{free_port()}",
+        }
+
+    def tearDown(self):
+        for server in (self.healthy, self.failing):
+            server.shutdown()
+            server.server_close()
+
+    def run_prober(self, scenario, **options):
+        async def main():
+            client = UpstreamClient()
+            prober = HealthProber(self.services, client, **options)
+            try:
+                return await scenario(prober)
+            finally:
+                await prober.stop()
+                client.close()
+        return asyncio.run(main())
+
+
+class TestProbeRound(ProberTestCase):
+    """Test a single probe round."""
+
+    def test_round_reports_each_service(self):
+        """Test healthy, 5xx and unreachable services."""
+        snapshot = self.run_prober(lambda prober: prober.probe_round())
+        services = snapshot.services
+        self.assertEqual(snapshot.round, 1)
+        self.assertEqual(services["healthy"]["status"], "healthy")
+        self.assertEqual(services["healthy"]["health_data"]["status"], "healthy")
+        self.assertEqual(services["failing"]["status"], "unhealthy")
+        self.assertIn("503", services["failing"]["error"])
+        self.assertEqual(services["dead"]["status"], "unhealthy")
+        self.assertIsNone(services["dead"]["last_healthy_at"])
+        self.assertEqual(services["dead"]["latency_history_ms"], [None])
+
+    def test_services_probed_concurrently(self):
+        """Test that a round costs the slowest probe, not the sum."""
+        extra = [start_backend() for _ in range(3)]
+        try:
+            for server in [self.healthy] + extra:
+                server.health_delay = 0.3
+            self.services = {
+                f"slow-{i}": f"http://127.0.0.1:{server.server_address[1]}"
+                for i, server in enumerate([self.healthy] + extra)
+            }
+
+            async def scenario(prober):
+                started = time.perf_counter()
+                snapshot = await prober.probe_round()
+                return time.perf_counter() - started, snapshot
+
+            elapsed, snapshot = self.run_prober(scenario)
+        finally:
+            for server in extra:
+                server.shutdown()
+                server.server_close()
+        self.assertEqual({s["status"] for s in snapshot.services.values()}, {"healthy"})
+        self.assertLess(elapsed, 0.9)  # Sequential would be 1.2 s
+
+    def test_probe_timeout_bounds_round(self):
+        """Test that a hung service is marked unhealthy after the probe timeout."""
+        self.healthy.health_delay = 1.0
+
+        async def scenario(prober):
+            started = time.perf_counter()
+            snapshot = await prober.probe_round()
+            return time.perf_counter() - started, snapshot
+
+        elapsed, snapshot = self.run_prober(scenario, timeout=0.2)
+        self.assertLess(elapsed, 0.8)
+        self.assertEqual(snapshot.services["healthy"]["status"], "unhealthy")
+
+    def test_history_is_bounded(self):
+        """Test that latency history and availability cover the last N probes."""
+        async def scenario(prober):
+            for _ in range(5):
+                snapshot = await prober.probe_round()
+            return snapshot
+
+        snapshot = self.run_prober(scenario, history_size=3)
+        healthy = snapshot.services["healthy"]
+        self.assertEqual(len(healthy["latency_history_ms"]), 3)
+        self.assertEqual(healthy["availability"], 1.0)
+        self.assertEqual(snapshot.services["dead"]["availability"], 0.0)
+        self.assertEqual(snapshot.services["dead"]["consecutive_failures"], 5)
+        self.assertEqual(snapshot.round, 5)
+
+    def test_published_snapshot_is_not_mutated(self):
+        """Test that a later round leaves earlier snapshots untouched."""
+        async def scenario(prober):
+            first = await prober.probe_round()
+            history = list(first.services["healthy"]["latency_history_ms"])
+            await prober.probe_round()
+            return first, history, prober.snapshot
+
+        first, history, latest = self.run_prober(scenario)
+        self.assertEqual(first.services["healthy"]["latency_history_ms"], history)
+        self.assertIsNot(first, latest)
+        self.assertEqual(latest.round, 2)
+
+
+class TestBackgroundProbing(ProberTestCase):
+    """Test the scheduled prober and staleness."""
+
+    def test_rounds_follow_interval(self):
+        """Test that probing runs on its own schedule."""
+        async def scenario(prober):
+            prober.start()
+            self.assertTrue(await prober.wait_ready(2.0))
+            await asyncio.sleep(0.35)
+            return prober.rounds
+
+        rounds = self.run_prober(scenario, interval=0.1, timeout=0.05)
+        self.assertGreaterEqual(rounds, 3)
+        self.assertLessEqual(rounds, 6)
+
+    def test_staleness(self):
+        """Test that a snapshot older than three intervals is flagged stale."""
+        async def scenario(prober):
+            snapshot = await prober.probe_round()
+            fresh = prober.freshness(snapshot)
+            await asyncio.sleep(0.35)
+            return fresh, prober.freshness(snapshot)
+
+        fresh, later = self.run_prober(scenario, interval=0.1, timeout=0.05)
+        self.assertFalse(fresh["stale"])
+        self.assertTrue(later["stale"])
+        self.assertGreaterEqual(later["age_seconds"], 0.35)
+        self.assertEqual(later["probe_round"], 1)
+
+    def test_wait_ready_times_out(self):
+        """Test that wait_ready gives up when no round has completed."""
+        async def scenario(prober):
+            return await prober.wait_ready(0.05)
+
+        self.assertFalse(self.run_prober(scenario))
+
+
+class TestGatewayEndpoints(ProberTestCase):
+    """Test /services and /services/{name} served from the snapshot."""
+
+    def test_requests_do_not_probe(self):
+        """Test that client traffic adds no probe traffic."""
+        import api_gateway_service as gateway
+
+        user = {"sub": "test"}
+
+        async def scenario():
+            client = UpstreamClient()
+            saved = gateway.health_prober
+            gateway.health_prober = HealthProber(self.services, client, interval=60.0)
+            try:
+                await gateway.health_prober.probe_round()
+                before = self.healthy.requests
+                started = time.perf_counter()
+                for _ in range(200):
+                    listing = await gateway.list_services(user=user)
+                    info = await gateway.get_service_info("healthy", user=user)
+                elapsed = time.perf_counter() - started
+                with self.assertRaises(HTTPException) as unavailable:
+                    await gateway.get_service_info("failing", user=user)
+                with self.assertRaises(HTTPException) as missing:
+                    await gateway.get_service_info("nonexistent", user=user)
+                return before, elapsed, listing, info, unavailable.exception, missing.exception
+            finally:
+                gateway.health_prober = saved
+                client.close()
+
+        saved_services = gateway.SERVICES
+        gateway.SERVICES = self.services
+        try:
+            before, elapsed, listing, info, unavailable, missing = asyncio.run(scenario())
+        finally:
+            gateway.SERVICES = saved_services
+
+        self.assertEqual(self.healthy.requests, before)
+        self.assertLess(elapsed, 2.0)
+        self.assertEqual(listing["total_services"], 3)
+        self.assertFalse(listing["freshness"]["stale"])
+        self.assertEqual(info["status"], "healthy")
+        self.assertEqual(info["service_name"], "healthy")
+        self.assertEqual(unavailable.status_code, 503)
+        self.assertEqual(missing.status_code, 404)
+
+
+if __name__ == '__main__':
+    unittest.main()
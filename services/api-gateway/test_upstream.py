@@ -0,0 +1,306 @@
+"""Unit tests for the gateway's pooled, hedged upstream client.
+
+Runs against a local threaded HTTP/1.1 server: connection reuse, concurrent
+fan-out, body framing, hedging and the circuit breaker.
+"""
+import asyncio
+import json
+import os
+import socket
+import sys
+import threading
+import time
+import unittest
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, urlsplit
+
+os.environ.setdefault("PULSEMIND_DEV_MODE", "true")
+
+# Add the api-gateway directory to the path for imports
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+import upstream  # noqa: E402
+from upstream import (  # noqa: E402
+    CircuitBreaker,
+    CircuitOpenError,
+    UpstreamClient,
+    UpstreamHTTPError,
+    UpstreamTimeout,
+    UpstreamUnavailable,
+)
+
+
+class Backend(BaseHTTPRequestHandler):
+    """Test upstream. One handler instance serves one connection."""
+
+    protocol_version = "HTTP/1.1"
+
+    def setup(self):
+        super().setup()
+        with self.server.lock:
+            self.server.connections += 1
+
+    def log_message(self, format, *args):
+        pass
+
+    def _send(self, status, payload, close=False):
+        body = json.dumps(payload).encode()
+        self.send_response(status)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+        if close:
+            # Close without announcing it, as an idle-timeout would
+            self.close_connection = True
+
+    def do_GET(self):
+        parts = urlsplit(self.path)
+        query = parse_qs(parts.query)
+        with self.server.lock:
+            self.server.requests += 1
+            n = self.server.requests
+        if parts.path == "/health":
+            time.sleep(self.server.health_delay)
+            self._send(200, {"status": "healthy", "n": n})
+        elif parts.path == "/slow":
+            time.sleep(float(query["s"][0]))
+            self._send(200, {"status": "healthy"})
+        elif parts.path == "/stall-once":
+            if n in self.server.stall_on:
+                time.sleep(1.0)
+            self._send(200, {"n": n})
+        elif parts.path == "/status":
+            self._send(int(query["code"][0]), {"error": "status"})
+        elif parts.path == "/drop":
+            self._send(200, {"n": n}, close=True)
+        elif parts.path == "/chunked":
+            self.send_response(200)
+            self.send_header("Transfer-Encoding", "chunked")
+            self.end_headers()
+            for piece in (b'{"parts": ', b'[1, 2, 3]', b'}'):
+                self.wfile.write(b"%x;ext=1\r\n%s\r\n" % (len(piece), piece))
+            self.wfile.write(b"0\r\nX-Trailer: yes\r\n\r\n")
+        else:
+            self._send(404, {"error": "not found"})
+
+
+class BackendServer(ThreadingHTTPServer):
+    daemon_threads = True
+    request_queue_size = 64
+
+    def handle_error(self, request, client_address):
+        # Cancelled hedges and timeouts hang up mid-response; that is expected
+        pass
+
+
+def start_backend():
+    server = BackendServer(("127.0.0.1", 0), Backend)
+    server.lock = threading.Lock()
+    server.connections = 0
+    server.requests = 0
+    server.stall_on = set()
+    server.health_delay = 0.0
+    threading.Thread(target=server.serve_forever, args=(0.05,), daemon=True).start()
+    return server
+
+
+def free_port():
+    with socket.socket() as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+
+class TestUpstreamClient(unittest.TestCase):
+    """Test the client against a live local backend."""
+
+    def setUp(self):
+        self.server = start_backend()
+        self.base = f"http://127.0.0.1:{self.server.server_address[1]}"
+
+    def tearDown(self):
+        self.server.shutdown()
+        self.server.server_close()
+
+    def run_client(self, scenario, **options):
+        async def main():
+            client = UpstreamClient(**options)
+            try:
+                return await scenario(client)
+            finally:
+                client.close()
+        return asyncio.run(main())
+
+    def test_keep_alive_reuses_one_connection(self):
+        """Test that sequential calls share a single pooled connection."""
+        async def scenario(client):
+            for _ in range(20):
+                self.assertEqual((await client.get_json(self.base + "/health"))["status"], "healthy")
+            return client.stats()
+
+        stats = self.run_client(scenario)
+        self.assertEqual(self.server.connections, 1)
+        upstream_stats = stats[f"127.0.0.1:{self.server.server_address[1]}"]
+        self.assertEqual(upstream_stats["connections_opened"], 1)
+        self.assertEqual(upstream_stats["connections_reused"], 19)
+        self.assertEqual(upstream_stats["successes"], 20)
+
+    def test_concurrent_calls_overlap(self):
+        """Test that concurrent calls run in parallel rather than one at a time."""
+        async def scenario(client):
+            started = time.perf_counter()
+            results = await asyncio.gather(*(client.get_json(self.base + "/slow?s=0.3") for _ in range(8)))
+            return time.perf_counter() - started, results, client.stats()
+
+        elapsed, results, stats = self.run_client(scenario)
+        self.assertEqual(len(results), 8)
+        self.assertLess(elapsed, 1.2)  # Sequential would be 2.4 s
+        self.assertEqual(next(iter(stats.values()))["max_in_flight"], 8)
+
+    def test_connection_cap_queues_callers(self):
+        """Test that callers beyond max_connections wait for a free connection."""
+        async def scenario(client):
+            await asyncio.gather(*(client.get_json(self.base + "/slow?s=0.1") for _ in range(6)))
+
+        self.run_client(scenario, max_connections=2)
+        self.assertEqual(self.server.connections, 2)
+
+    def test_chunked_body(self):
+        """Test chunked transfer decoding with extensions and trailers."""
+        async def scenario(client):
+            first = await client.get_json(self.base + "/chunked")
+            second = await client.get_json(self.base + "/health")
+            return first, second
+
+        first, second = self.run_client(scenario)
+        self.assertEqual(first, {"parts": [1, 2, 3]})
+        self.assertEqual(second["status"], "healthy")
+        self.assertEqual(self.server.connections, 1)
+
+    def test_stale_connection_is_replayed(self):
+        """Test that a keep-alive socket closed by the server is retried on a new one."""
+        async def scenario(client):
+            await client.get_json(self.base + "/drop")
+            await asyncio.sleep(0.05)
+            return await client.get_json(self.base + "/health"), client.stats()
+
+        result, stats = self.run_client(scenario)
+        self.assertEqual(result["status"], "healthy")
+        self.assertEqual(next(iter(stats.values()))["failures"], 0)
+        self.assertEqual(self.server.connections, 2)
+
+    def test_error_statuses(self):
+        """Test that 4xx raises without tripping the breaker and 5xx counts as failure."""
+        async def scenario(client):
+            with self.assertRaises(UpstreamHTTPError) as missing:
+                await client.get(self.base + "/status?code=404")
+            with self.assertRaises(UpstreamHTTPError) as broken:
+                await client.get(self.base + "/status?code=503")
+            return missing.exception, broken.exception, client.stats()
+
+        missing, broken, stats = self.run_client(scenario)
+        self.assertEqual(missing.status, 404)
+        self.assertEqual(broken.status, 503)
+        upstream_stats = next(iter(stats.values()))
+        self.assertEqual(upstream_stats["failures"], 1)
+        self.assertEqual(upstream_stats["consecutive_failures"], 1)
+
+    def test_timeout(self):
+        """Test that a slow upstream raises UpstreamTimeout."""
+        async def scenario(client):
+            with self.assertRaises(UpstreamTimeout):
+                await client.get(self.base + "/slow?s=0.5", timeout=0.1)
+            return client.stats()
+
+        stats = self.run_client(scenario)
+        self.assertEqual(next(iter(stats.values()))["timeouts"], 1)
+
+    def test_hedge_beats_stalled_request(self):
+        """Test that a request stuck past the latency percentile is hedged."""
+        warmup = upstream.HEDGE_MIN_SAMPLES * 2
+        # The request after warm-up stalls; its hedge should not
+        self.server.stall_on = {warmup + 1}
+
+        async def scenario(client):
+            for _ in range(warmup):
+                await client.get_json(self.base + "/stall-once")
+            started = time.perf_counter()
+            result = await client.get_json(self.base + "/stall-once")
+            return time.perf_counter() - started, result, client.stats()
+
+        elapsed, result, stats = self.run_client(scenario)
+        upstream_stats = next(iter(stats.values()))
+        self.assertLess(elapsed, 0.5)
+        self.assertEqual(result["n"], warmup + 2)
+        self.assertEqual(upstream_stats["hedges"], 1)
+        self.assertEqual(upstream_stats["hedge_wins"], 1)
+
+    def test_no_hedge_without_latency_profile(self):
+        """Test that hedging waits for enough latency samples."""
+        async def scenario(client):
+            await client.get_json(self.base + "/slow?s=0.2")
+            return client.stats()
+
+        stats = self.run_client(scenario)
+        self.assertEqual(next(iter(stats.values()))["hedges"], 0)
+
+    def test_rejects_non_http_url(self):
+        """Test that only plain http:// upstreams are accepted."""
+        async def scenario(client):
+            with self.assertRaises(ValueError):
+                await client.get("https://example.invalid/health")
+
+        self.run_client(scenario)
+
+
+class TestCircuitBreaker(unittest.TestCase):
+    """Test breaker transitions, alone and in the client."""
+
+    def test_opens_after_threshold_and_probes(self):
+        """Test closed -> open -> half-open -> closed."""
+        breaker = CircuitBreaker(failure_threshold=3, open_seconds=0.05)
+        for _ in range(3):
+            self.assertTrue(breaker.allow())
+            breaker.record_failure()
+        self.assertEqual(breaker.state, CircuitBreaker.OPEN)
+        self.assertFalse(breaker.allow())
+        time.sleep(0.06)
+        self.assertTrue(breaker.allow())   # The probe
+        self.assertFalse(breaker.allow())  # Only one probe at a time
+        breaker.record_success()
+        self.assertEqual(breaker.state, CircuitBreaker.CLOSED)
+        self.assertEqual(breaker.times_opened, 1)
+        self.assertEqual(breaker.short_circuited, 2)
+
+    def test_failed_probe_reopens(self):
+        """Test that a failed half-open probe opens the breaker again."""
+        breaker = CircuitBreaker(failure_threshold=1, open_seconds=0.01)
+        breaker.record_failure()
+        time.sleep(0.02)
+        self.assertTrue(breaker.allow())
+        breaker.record_failure()
+        self.assertEqual(breaker.state, CircuitBreaker.OPEN)
+        self.assertFalse(breaker.allow())
+
+    def test_dead_upstream_short_circuits(self):
+        """Test that calls to a dead upstream fail fast once the breaker opens."""
+        url = f"http://127.0.0.1:{free_port()}/health"
+
+        async def scenario():
+            client = UpstreamClient()
+            for _ in range(upstream.FAILURE_THRESHOLD):
+                with self.assertRaises(UpstreamUnavailable):
+                    await client.get(url)
+            with self.assertRaises(CircuitOpenError):
+                await client.get(url)
+            return client.stats()
+
+        stats = asyncio.run(scenario())
+        upstream_stats = next(iter(stats.values()))
+        self.assertEqual(upstream_stats["circuit"], "open")
+        self.assertEqual(upstream_stats["requests"], upstream.FAILURE_THRESHOLD)
+        self.assertEqual(upstream_stats["short_circuited"], 1)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,554 @@
+"""Pooled, Hedged Upstream Client for the API Gateway.
+
+The gateway's handlers are async, so upstream calls must not block the event
+loop. This module is a small HTTP/1.1 client on asyncio streams:
+
+- ConnectionPool: keep-alive connections per upstream (host:port), reused
+  LIFO so the warmest socket goes out first, with a cap on open connections
+  that doubles as per-upstream backpressure.
+- LatencyWindow: recent successful latencies, used to pick the hedge delay.
+- CircuitBreaker: consecutive-failure breaker (closed -> open -> half-open).
+- Upstream: one backend - pool, latency window, breaker and counters.
+- UpstreamClient: routes URLs to their Upstream and exposes stats.
+
+Hedging: a GET still outstanding after the upstream's HEDGE_PERCENTILE
+latency gets a second attempt on another connection; the first success wins
+and the loser is cancelled. Hedges are capped at HEDGE_BUDGET of requests so a
+slow backend does not see its load doubled.
+
+Only GET is supported - it is all the gateway sends upstream, and being
+idempotent it is safe to hedge and to replay on a stale keep-alive socket.
+"""
+
+import asyncio
+import json
+import socket
+import time
+from collections import deque
+from typing import Any, Deque, Dict, Optional, Tuple
+from urllib.parse import urlsplit
+
+
+# ============================================================================
+# CONSTANTS
+# ============================================================================
+
+# Connection pool, per upstream
+MAX_CONNECTIONS = 32
+MAX_IDLE_CONNECTIONS = 8
+IDLE_TIMEOUT_SECONDS = 30.0
+
+# Responses larger than this are refused rather than buffered
+MAX_RESPONSE_BYTES = 4 * 1024 * 1024
+MAX_HEADER_BYTES = 64 * 1024
+
+# Hedging
+LATENCY_WINDOW_SIZE = 256
+HEDGE_PERCENTILE = 0.95
+HEDGE_MIN_SAMPLES = 20       # No hedging until the latency profile is known
+HEDGE_MIN_DELAY_SECONDS = 0.005
+HEDGE_BUDGET = 0.1           # At most one hedge per ten requests
+
+# Circuit breaker
+FAILURE_THRESHOLD = 5
+OPEN_SECONDS = 10.0
+
+USER_AGENT = "pulsemind-api-gateway"
+
+
+# ============================================================================
+# ERRORS
+# ============================================================================
+
+class UpstreamError(Exception):
+    """Base class for upstream call failures."""
+
+
+class UpstreamUnavailable(UpstreamError):
+    """The upstream could not be reached or dropped the connection."""
+
+
+class UpstreamTimeout(UpstreamUnavailable):
+    """The upstream did not answer within the timeout."""
+
+
+class UpstreamHTTPError(UpstreamError):
+    """The upstream answered with an error status."""
+
+    def __init__(self, url: str, status: int, reason: str):
+        super().__init__(f"{status} {reason} for url: {url}")
+        self.status = status
+
+
+class CircuitOpenError(UpstreamError):
+    """The upstream's breaker is open; the call was not attempted."""
+
+
+class _ServerError(UpstreamUnavailable):
+    """A 5xx answer, raised inside an attempt so a hedge can still win."""
+
+    def __init__(self, response: "UpstreamResponse"):
+        super().__init__(f"{response.status} {response.reason}")
+        self.response = response
+
+
+# ============================================================================
+# RESPONSES
+# ============================================================================
+
+class UpstreamResponse:
+    """A fully read upstream response."""
+
+    __slots__ = ("status", "reason", "headers", "body")
+
+    def __init__(self, status: int, reason: str, headers: Dict[str, str], body: bytes):
+        self.status = status
+        self.reason = reason
+        self.headers = headers
+        self.body = body
+
+    def json(self) -> Any:
+        return json.loads(self.body)
+
+
+async def _read_chunked(reader: asyncio.StreamReader, limit: int) -> bytes:
+    """Read a chunked transfer-coded body (RFC 9112 section 7.1)."""
+    parts = []
+    total = 0
+    while True:
+        line = await reader.readuntil(b"\r\n")
+        size = int(line.split(b";", 1)[0].strip(), 16)
+        if size == 0:
+            # Trailer section ends with an empty line
+            while await reader.readuntil(b"\r\n") != b"\r\n":
+                pass
+            return b"".join(parts)
+        total += size
+        if total > limit:
+            raise UpstreamUnavailable(f"response body exceeds {limit} bytes")
+        parts.append(await reader.readexactly(size))
+        await reader.readexactly(2)
+
+
+async def _read_response(reader: asyncio.StreamReader) -> Tuple[UpstreamResponse, bool]:
+    """Read one response; returns it and whether the connection can be reused."""
+    while True:
+        head = await reader.readuntil(b"\r\n\r\n")
+        lines = head[:-4].decode("latin-1").split("\r\n")
+        version, _, rest = lines[0].partition(" ")
+        code, _, reason = rest.partition(" ")
+        status = int(code)
+        if not 100 <= status < 200:
+            break
+
+    headers = {}
+    for line in lines[1:]:
+        name, _, value = line.partition(":")
+        headers[name.strip().lower()] = value.strip()
+
+    connection = headers.get("connection", "").lower()
+    if version == "HTTP/1.1":
+        keep_alive = connection != "close"
+    else:
+        keep_alive = connection == "keep-alive"
+
+    if status in (204, 304):
+        body = b""
+    elif "chunked" in headers.get("transfer-encoding", "").lower():
+        body = await _read_chunked(reader, MAX_RESPONSE_BYTES)
+    elif "content-length" in headers:
+        length = int(headers["content-length"])
+        if length > MAX_RESPONSE_BYTES:
+            raise UpstreamUnavailable(f"response body exceeds {MAX_RESPONSE_BYTES} bytes")
+        body = await reader.readexactly(length)
+    else:
+        # Delimited by connection close
+        body = await reader.read(MAX_RESPONSE_BYTES + 1)
+        while len(body) <= MAX_RESPONSE_BYTES:
+            more = await reader.read(MAX_RESPONSE_BYTES + 1 - len(body))
+            if not more:
+                break
+            body += more
+        if len(body) > MAX_RESPONSE_BYTES:
+            raise UpstreamUnavailable(f"response body exceeds {MAX_RESPONSE_BYTES} bytes")
+        keep_alive = False
+
+    return UpstreamResponse(status, reason, headers, body), keep_alive
+
+
+# ============================================================================
+# CONNECTION POOL
+# ============================================================================
+
+class _Connection:
+    __slots__ = ("reader", "writer", "idle_since", "reused")
+
+    def __init__(self, reader: asyncio.StreamReader, writer: asyncio.StreamWriter):
+        self.reader = reader
+        self.writer = writer
+        self.idle_since = 0.0
+        self.reused = False
+
+    def close(self) -> None:
+        self.writer.close()
+
+
+class ConnectionPool:
+    """Keep-alive connections to one host:port."""
+
+    def __init__(
+        self,
+        host: str,
+        port: int,
+        max_connections: int = MAX_CONNECTIONS,
+        max_idle: int = MAX_IDLE_CONNECTIONS,
+        idle_timeout: float = IDLE_TIMEOUT_SECONDS,
+    ):
+        self.host = host
+        self.port = port
+        self.max_idle = max_idle
+        self.idle_timeout = idle_timeout
+        self._idle: Deque[_Connection] = deque()
+        self._slots = asyncio.Semaphore(max_connections)
+        self._closed = False
+        self.opened = 0
+        self.reused = 0
+        self.discarded = 0
+
+    async def acquire(self, fresh: bool = False) -> _Connection:
+        """Take an idle connection, or open one; waits while the pool is full."""
+        await self._slots.acquire()
+        try:
+            now = time.monotonic()
+            while self._idle and not fresh:
+                conn = self._idle.pop()
+                if now - conn.idle_since > self.idle_timeout or conn.reader.at_eof():
+                    self._discard(conn)
+                    continue
+                conn.reused = True
+                self.reused += 1
+                return conn
+            reader, writer = await asyncio.open_connection(
+                self.host, self.port, limit=MAX_HEADER_BYTES
+            )
+            sock = writer.get_extra_info("socket")
+            if sock is not None:
+                sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            self.opened += 1
+            return _Connection(reader, writer)
+        except BaseException:
+            self._slots.release()
+            raise
+
+    def release(self, conn: _Connection, reusable: bool) -> None:
+        """Return a connection after use; unusable ones are closed."""
+        now = time.monotonic()
+        while self._idle and now - self._idle[0].idle_since > self.idle_timeout:
+            self._discard(self._idle.popleft())
+        if reusable and not self._closed and len(self._idle) < self.max_idle:
+            conn.idle_since = now
+            self._idle.append(conn)
+        else:
+            self._discard(conn)
+        self._slots.release()
+
+    def _discard(self, conn: _Connection) -> None:
+        conn.close()
+        self.discarded += 1
+
+    def close(self) -> None:
+        """Close idle connections; connections in use close on release."""
+        self._closed = True
+        while self._idle:
+            self._discard(self._idle.pop())
+
+    @property
+    def idle(self) -> int:
+        return len(self._idle)
+
+
+# ============================================================================
+# LATENCY WINDOW AND CIRCUIT BREAKER
+# ============================================================================
+
+class LatencyWindow:
+    """Ring of the most recent successful latencies, in seconds."""
+
+    __slots__ = ("_samples", "_sorted", "count")
+
+    def __init__(self, size: int = LATENCY_WINDOW_SIZE):
+        self._samples: Deque[float] = deque(maxlen=size)
+        self._sorted: Optional[list] = None
+        self.count = 0
+
+    def record(self, seconds: float) -> None:
+        self._samples.append(seconds)
+        self.count += 1
+        # Re-sort lazily, at most once per 16 samples
+        if self.count % 16 == 0 or len(self._samples) < 16:
+            self._sorted = None
+
+    def percentile(self, q: float) -> Optional[float]:
+        if not self._samples:
+            return None
+        if self._sorted is None:
+            self._sorted = sorted(self._samples)
+        ordered = self._sorted
+        return ordered[min(len(ordered) - 1, int(q * len(ordered)))]
+
+
+class CircuitBreaker:
+    """Opens after FAILURE_THRESHOLD consecutive failures.
+
+    While open, calls fail fast. After OPEN_SECONDS one probe is let through
+    (half-open): its success closes the breaker, its failure re-opens it.
+    """
+
+    CLOSED = "closed"
+    OPEN = "open"
+    HALF_OPEN = "half_open"
+
+    def __init__(self, failure_threshold: int = FAILURE_THRESHOLD, open_seconds: float = OPEN_SECONDS):
+        self.failure_threshold = failure_threshold
+        self.open_seconds = open_seconds
+        self.state = self.CLOSED
+        self.consecutive_failures = 0
+        self.opened_at = 0.0
+        self.times_opened = 0
+        self.short_circuited = 0
+        self._probe_in_flight = False
+
+    def allow(self) -> bool:
+        if self.state == self.CLOSED:
+            return True
+        if self.state == self.OPEN and time.monotonic() - self.opened_at >= self.open_seconds:
+            self.state = self.HALF_OPEN
+        if self.state == self.HALF_OPEN and not self._probe_in_flight:
+            self._probe_in_flight = True
+            return True
+        self.short_circuited += 1
+        return False
+
+    def record_success(self) -> None:
+        self.consecutive_failures = 0
+        self._probe_in_flight = False
+        self.state = self.CLOSED
+
+    def record_abandoned(self) -> None:
+        """The call was cancelled by its caller; a half-open probe may go again."""
+        self._probe_in_flight = False
+
+    def record_failure(self) -> None:
+        self.consecutive_failures += 1
+        self._probe_in_flight = False
+        if self.state == self.HALF_OPEN or self.consecutive_failures >= self.failure_threshold:
+            if self.state != self.OPEN:
+                self.times_opened += 1
+            self.state = self.OPEN
+            self.opened_at = time.monotonic()
+
+
+# ============================================================================
+# UPSTREAM
+# ============================================================================
+
+class Upstream:
+    """One backend: connection pool, latency profile, breaker and counters."""
+
+    def __init__(self, host: str, port: int, breaker: Optional[CircuitBreaker] = None, **pool_options):
+        self.host = host
+        self.port = port
+        self.pool = ConnectionPool(host, port, **pool_options)
+        self.latency = LatencyWindow()
+        self.breaker = breaker or CircuitBreaker()
+        self.requests = 0
+        self.successes = 0
+        self.failures = 0
+        self.timeouts = 0
+        self.hedges = 0
+        self.hedge_wins = 0
+        self.in_flight = 0
+        self.max_in_flight = 0
+
+    def hedge_delay(self) -> Optional[float]:
+        """Seconds to wait before hedging, or None if a hedge is not allowed."""
+        if self.latency.count < HEDGE_MIN_SAMPLES:
+            return None
+        if self.hedges >= HEDGE_BUDGET * self.requests:
+            return None
+        return max(HEDGE_MIN_DELAY_SECONDS, self.latency.percentile(HEDGE_PERCENTILE))
+
+    async def _attempt(self, target: str) -> Tuple[UpstreamResponse, float]:
+        """Send one GET on a pooled connection; returns (response, seconds)."""
+        request = (
+            f"GET {target} HTTP/1.1\r\n"
+            f"Host: {self.host}:{self.port}\r\n"
+            f"User-Agent: {USER_AGENT}\r\n"
+            "Accept: application/json\r\n"
+            "Connection: keep-alive\r\n\r\n"
+        ).encode("latin-1")
+        fresh = False
+        while True:
+            started = time.perf_counter()
+            try:
+                conn = await self.pool.acquire(fresh)
+            except OSError as e:
+                raise UpstreamUnavailable(f"cannot connect to {self.host}:{self.port}: {e}") from e
+            reusable = False
+            try:
+                conn.writer.write(request)
+                await conn.writer.drain()
+                response, reusable = await _read_response(conn.reader)
+            except (ConnectionError, asyncio.IncompleteReadError) as e:
+                if conn.reused and not fresh:
+                    # The server closed the idle socket; replay on a new one
+                    fresh = True
+                    continue
+                raise UpstreamUnavailable(f"connection to {self.host}:{self.port} lost: {e!r}") from e
+            except (ValueError, asyncio.LimitOverrunError) as e:
+                raise UpstreamUnavailable(f"malformed response from {self.host}:{self.port}") from e
+            finally:
+                self.pool.release(conn, reusable)
+            elapsed = time.perf_counter() - started
+            if response.status >= 500:
+                raise _ServerError(response)
+            return response, elapsed
+
+    async def _hedged(self, target: str) -> UpstreamResponse:
+        primary = asyncio.ensure_future(self._attempt(target))
+        tasks = {primary}
+        try:
+            delay = self.hedge_delay()
+            if delay is not None:
+                done, _ = await asyncio.wait(tasks, timeout=delay)
+                if not done:
+                    self.hedges += 1
+                    tasks.add(asyncio.ensure_future(self._attempt(target)))
+            error: Optional[BaseException] = None
+            pending = tasks
+            while pending:
+                done, pending = await asyncio.wait(pending, return_when=asyncio.FIRST_COMPLETED)
+                winner = None
+                for task in done:
+                    exception = task.exception()
+                    if exception is not None:
+                        error = exception
+                    elif winner is None:
+                        winner = task
+                if winner is not None:
+                    response, elapsed = winner.result()
+                    self.latency.record(elapsed)
+                    if winner is not primary:
+                        self.hedge_wins += 1
+                    return response
+            assert error is not None
+            raise error
+        finally:
+            for task in tasks:
+                if not task.done():
+                    task.cancel()
+
+    async def get(self, url: str, target: str, timeout: float) -> UpstreamResponse:
+        """GET `target` (path and query), hedged and guarded by the breaker."""
+        if not self.breaker.allow():
+            raise CircuitOpenError(f"circuit open for {self.host}:{self.port}")
+        self.requests += 1
+        self.in_flight += 1
+        self.max_in_flight = max(self.max_in_flight, self.in_flight)
+        try:
+            response = await asyncio.wait_for(self._hedged(target), timeout)
+        except asyncio.TimeoutError:
+            self.timeouts += 1
+            self.failures += 1
+            self.breaker.record_failure()
+            raise UpstreamTimeout(f"no response from {url} within {timeout}s") from None
+        except _ServerError as e:
+            self.failures += 1
+            self.breaker.record_failure()
+            raise UpstreamHTTPError(url, e.response.status, e.response.reason) from None
+        except UpstreamError:
+            self.failures += 1
+            self.breaker.record_failure()
+            raise
+        except asyncio.CancelledError:
+            # The caller gave up; this says nothing about the upstream
+            self.breaker.record_abandoned()
+            raise
+        finally:
+            self.in_flight -= 1
+        self.successes += 1
+        self.breaker.record_success()
+        if response.status >= 400:
+            raise UpstreamHTTPError(url, response.status, response.reason)
+        return response
+
+    def stats(self) -> Dict[str, Any]:
+        p50 = self.latency.percentile(0.5)
+        p99 = self.latency.percentile(0.99)
+        return {
+            "circuit": self.breaker.state,
+            "consecutive_failures": self.breaker.consecutive_failures,
+            "times_opened": self.breaker.times_opened,
+            "short_circuited": self.breaker.short_circuited,
+            "requests": self.requests,
+            "successes": self.successes,
+            "failures": self.failures,
+            "timeouts": self.timeouts,
+            "hedges": self.hedges,
+            "hedge_wins": self.hedge_wins,
+            "in_flight": self.in_flight,
+            "max_in_flight": self.max_in_flight,
+            "connections_opened": self.pool.opened,
+            "connections_reused": self.pool.reused,
+            "connections_idle": self.pool.idle,
+            "latency_p50_ms": None if p50 is None else round(p50 * 1000, 3),
+            "latency_p99_ms": None if p99 is None else round(p99 * 1000, 3),
+        }
+
+
+# ============================================================================
+# CLIENT
+# ============================================================================
+
+class UpstreamClient:
+    """Routes absolute http:// URLs to a per-host:port Upstream.
+
+    Must be used from a single event loop; pools are created on first use.
+    """
+
+    def __init__(self, **upstream_options):
+        self._upstreams: Dict[Tuple[str, int], Upstream] = {}
+        self._options = upstream_options
+
+    def upstream(self, host: str, port: int) -> Upstream:
+        key = (host, port)
+        upstream = self._upstreams.get(key)
+        if upstream is None:
+            upstream = Upstream(host, port, **self._options)
+            self._upstreams[key] = upstream
+        return upstream
+
+    async def get(self, url: str, timeout: float = 5.0) -> UpstreamResponse:
+        """GET `url`; raises an UpstreamError subclass on failure or status >= 400."""
+        parts = urlsplit(url)
+        if parts.scheme != "http" or not parts.hostname:
+            raise ValueError(f"unsupported upstream URL: {url}")
+        target = parts.path or "/"
+        if parts.query:
+            target += "?" + parts.query
+        upstream = self.upstream(parts.hostname, parts.port or 80)
+        return await upstream.get(url, target, timeout)
+
+    async def get_json(self, url: str, timeout: float = 5.0) -> Any:
+        response = await self.get(url, timeout)
+        try:
+            return response.json()
+        except ValueError as e:
+            raise UpstreamError(f"invalid JSON from {url}: {e}") from e
+
+    def stats(self) -> Dict[str, Dict[str, Any]]:
+        return {f"{host}:{port}": u.stats() for (host, port), u in self._upstreams.items()}
+
+    def close(self) -> None:
+        for upstream in self._upstreams.values():
+            upstream.pool.close()
@@ -1,20 +1,43 @@
 import os
 import sys
 import time
-from datetime import datetime
+from datetime import datetime, timedelta, timezone
 
 from flask import Flask, jsonify, request
 
 # Add shared module to path
 sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
-from pacing_controller import process_pacing_decision  # noqa: E402
+from decision_journal import parse_timestamp_us  # noqa: E402
+from pacing_controller import get_decision_logger, policy_store, process_pacing_decision  # noqa: E402
+from shared import downsample, metrics  # noqa: E402
 from shared.logger import setup_logger  # noqa: E402
+from shared.security_utils import require_access_token  # noqa: E402
 from shared.shutdown import register_shutdown_handler  # noqa: E402
+from shared.tracing import instrument_flask, setup_tracing  # noqa: E402
+import waveform_store  # noqa: E402
 
 # Initialize logger
 logger = setup_logger("control-engine", level="INFO")
 
 app = Flask(__name__)
+instrument_flask(app, setup_tracing("control-engine"))
+registry = metrics.instrument_flask(app, "control-engine")
+pacing_seconds = registry.histogram(
+    "pulsemind_processing_duration_seconds", "Time spent in a service's processing steps",
+    service="control-engine", operation="compute_pacing",
+)
+
+# Most recent decisions returned by one GET /decisions
+MAX_DECISIONS_LIMIT = 1000
+
+# Waveform window returned before a decision (seconds)
+DEFAULT_WAVEFORM_SECONDS = 30.0
+MAX_WAVEFORM_SECONDS = 600.0
+
+# Device series plots: default range and width in points
+DEFAULT_SERIES_SECONDS = 3600
+DEFAULT_SERIES_POINTS = 1000
+MAX_SERIES_POINTS = 10000
 
 
 @app.route('/health')
@@ -44,6 +67,19 @@ def root():
                 "/compute-pacing": (
                     "POST - Compute pacing command from rhythm and HSI data"
                 ),
+                "/controller-state": (
+                    "GET - Snapshot per-device controller state; "
+                    "POST - Restore a snapshot (admin token)"
+                ),
+                "/decisions": (
+                    "GET - Recent decisions, or those between start and end"
+                ),
+                "/decisions/<id>/waveform": (
+                    "GET - Stored samples that preceded a decision"
+                ),
+                "/devices/<device_id>/series": (
+                    "GET - A stored series at plot resolution (raw or rollups)"
+                ),
             },
             "timestamp": datetime.utcnow().isoformat() + "Z",
         }
@@ -56,6 +92,7 @@ def compute_pacing():
 
     Expected JSON payload:
     {
+        "device_id": "esp32-01",  (optional, selects per-patient controller state)
         "rhythm_data": {
             "rhythm_class": "normal_sinus",
             "confidence": 0.85,
@@ -131,6 +168,7 @@ def compute_pacing():
     
     rhythm_data = data['rhythm_data']
     hsi_data = data['hsi_data']
+    device_id = data.get('device_id')
     
     # Validate data types
     if not isinstance(rhythm_data, dict):
@@ -147,15 +185,23 @@ def compute_pacing():
             "error": "Field 'hsi_data' must be an object"
         }), 400
     
+    if device_id is not None and (not isinstance(device_id, str) or not device_id):
+        logger.warning("Invalid device_id in request")
+        return jsonify({
+            "success": False,
+            "error": "Field 'device_id' must be a non-empty string"
+        }), 400
+    
     # Process pacing decision
     # Medical Safety: process_pacing_decision NEVER crashes, always returns
     # safe response
     try:
-        result = process_pacing_decision(rhythm_data, hsi_data)
+        result = process_pacing_decision(rhythm_data, hsi_data, device_id)
         
         # Add processing time
         processing_time_ms = (time.time() - start_time) * 1000
         result['processing_time_ms'] = round(processing_time_ms, 2)
+        pacing_seconds.observe(processing_time_ms / 1000)
         
         logger.info(f"Pacing command computed in {processing_time_ms:.2f}ms")
         
@@ -199,6 +245,234 @@ def compute_pacing():
         )
 
 
+@app.route('/controller-state', methods=['GET'])
+def get_controller_state():
+    """Export per-device safety controller state.
+
+    The snapshot can be POSTed back to this endpoint (or to another replica)
+    so hysteresis and rate limits survive restarts and failover.
+    """
+    snapshot = policy_store.snapshot()
+    logger.info(f"Controller state snapshot: {len(snapshot['devices'])} devices")
+    return jsonify({"success": True, "snapshot": snapshot}), 200
+
+
+@app.route('/controller-state', methods=['POST'])
+@require_access_token("admin")
+def restore_controller_state():
+    """Restore per-device safety controller state from a snapshot.
+
+    Requires an admin bearer token: a snapshot overwrites patients' safety
+    state.
+
+    Expected JSON payload: {"snapshot": <GET /controller-state snapshot>}
+    """
+    data = request.get_json(silent=True)
+    if not isinstance(data, dict) or 'snapshot' not in data:
+        return jsonify({
+            "success": False,
+            "error": "Missing required field: 'snapshot'"
+        }), 400
+
+    try:
+        restored = policy_store.restore(data['snapshot'])
+    except ValueError as e:
+        logger.warning(f"Rejected controller state snapshot: {e}")
+        return jsonify({"success": False, "error": str(e)}), 400
+
+    logger.info(f"Restored controller state for {restored} devices")
+    return jsonify({"success": True, "devices_restored": restored}), 200
+
+
+@app.route('/decisions', methods=['GET'])
+def get_decisions():
+    """Return journaled decisions: the most recent, or those in a time range.
+
+    Query parameters:
+        limit: Most recent decisions, newest first (default 10, max 1000)
+        start, end: ISO-8601 bounds (start <= timestamp < end, oldest first);
+            given together, they replace limit
+    """
+    start, end = request.args.get('start'), request.args.get('end')
+    decision_logger = get_decision_logger()
+    if start is not None or end is not None:
+        if start is None or end is None:
+            return jsonify({"success": False, "error": "'start' and 'end' go together"}), 400
+        try:
+            decisions = decision_logger.get_decisions_between(start, end)
+        except ValueError as e:
+            return jsonify({"success": False, "error": str(e)}), 400
+    else:
+        try:
+            limit = int(request.args.get('limit', 10))
+        except ValueError:
+            limit = 0
+        if not 1 <= limit <= MAX_DECISIONS_LIMIT:
+            return jsonify({
+                "success": False,
+                "error": f"'limit' must be an integer in [1, {MAX_DECISIONS_LIMIT}]"
+            }), 400
+        decisions = decision_logger.get_decisions(limit)
+    return jsonify({"success": True, "count": len(decisions), "decisions": decisions}), 200
+
+
+def _iso_from_us(timestamp_us: int) -> str:
+    moment = datetime(1970, 1, 1, tzinfo=timezone.utc) + timedelta(microseconds=timestamp_us)
+    return moment.strftime("%Y-%m-%dT%H:%M:%S.%f") + "Z"
+
+
+@app.route('/decisions/<int:decision_id>/waveform', methods=['GET'])
+def get_decision_waveform(decision_id):
+    """Return the samples the ingest worker stored for a decision's device
+    in the window before the decision.
+
+    Query parameters:
+        seconds: Window length before the decision (default 30, max 600)
+        metric: ppg (default), heart_rate_bpm, hrv_sdnn_ms, pulse_amplitude
+            or hsi_score
+
+    Timestamps are epoch microseconds.
+    """
+    metric = request.args.get('metric', 'ppg')
+    if metric not in waveform_store.METRICS:
+        return jsonify({
+            "success": False,
+            "error": f"Unknown metric '{metric}'"
+        }), 400
+    try:
+        seconds = float(request.args.get('seconds', DEFAULT_WAVEFORM_SECONDS))
+    except ValueError:
+        seconds = -1.0
+    if not 0 < seconds <= MAX_WAVEFORM_SECONDS:
+        return jsonify({
+            "success": False,
+            "error": f"'seconds' must be in (0, {MAX_WAVEFORM_SECONDS:g}]"
+        }), 400
+
+    reader = waveform_store.get_reader()
+    if reader is None:
+        return jsonify({
+            "success": False,
+            "error": "No time-series store configured (PULSEMIND_TSDB_DIR)"
+        }), 503
+
+    decision = get_decision_logger().get_decision(decision_id)
+    if decision is None:
+        return jsonify({
+            "success": False,
+            "error": f"Decision {decision_id} not found"
+        }), 404
+    device_id = decision["full_payload"].get("input_summary", {}).get("device_id")
+    if not device_id:
+        return jsonify({
+            "success": False,
+            "error": f"Decision {decision_id} has no device id"
+        }), 422
+
+    try:
+        end_us = parse_timestamp_us(decision["timestamp"])
+    except ValueError as e:
+        return jsonify({"success": False, "error": f"Decision {decision_id}: {e}"}), 422
+    start_us = end_us - int(seconds * 1_000_000)
+    timestamps, values = reader.query(device_id, metric, start_us, end_us + 1)
+    logger.info(
+        f"Waveform for decision {decision_id}: {len(values)} {metric} samples"
+    )
+    summary = {key: value for key, value in decision.items() if key != "full_payload"}
+    return jsonify({
+        "success": True,
+        "decision": summary,
+        "device_id": device_id,
+        "metric": metric,
+        "start": _iso_from_us(start_us),
+        "end": _iso_from_us(end_us),
+        "sample_count": len(values),
+        "timestamps_us": timestamps,
+        "values": values
+    }), 200
+
+
+@app.route('/devices/<device_id>/series', methods=['GET'])
+def get_device_series(device_id):
+    """Return a device's stored series over a time range, at the resolution
+    of a plot max_points wide.
+
+    Query parameters:
+        metric: ppg (default), heart_rate_bpm, hrv_sdnn_ms, pulse_amplitude
+            or hsi_score
+        start_us, end_us: Epoch microseconds (default: the last hour)
+        max_points: Plot width (default 1000, max 10000)
+        downsample: lttb or minmax to reduce the result to max_points
+            timestamps_us/values pairs (over the bucket means, or the bucket
+            minima and maxima, for rollups)
+
+    Short ranges return raw samples ("values", resolution_seconds 0); longer
+    ones return min/max/mean/count buckets of the coarsest rollup tier that
+    still has a bucket per point.
+    """
+    metric = request.args.get('metric', 'ppg')
+    if metric not in waveform_store.METRICS:
+        return jsonify({
+            "success": False,
+            "error": f"Unknown metric '{metric}'"
+        }), 400
+    try:
+        end_us = int(request.args.get('end_us', int(time.time() * 1_000_000)))
+        start_us = int(request.args.get('start_us', end_us - DEFAULT_SERIES_SECONDS * 1_000_000))
+        max_points = int(request.args.get('max_points', DEFAULT_SERIES_POINTS))
+    except ValueError:
+        return jsonify({
+            "success": False,
+            "error": "'start_us', 'end_us' and 'max_points' must be integers"
+        }), 400
+    if start_us >= end_us or not 0 < max_points <= MAX_SERIES_POINTS:
+        return jsonify({
+            "success": False,
+            "error": f"Need start_us < end_us and 'max_points' in [1, {MAX_SERIES_POINTS}]"
+        }), 400
+    mode = request.args.get('downsample')
+    if mode is not None and mode not in downsample.MODES:
+        return jsonify({
+            "success": False,
+            "error": f"'downsample' must be one of {list(downsample.MODES)}"
+        }), 400
+    if mode is not None and not downsample.is_available():
+        return jsonify({
+            "success": False,
+            "error": "Downsampling library not available (libdownsample.so)"
+        }), 503
+
+    reader = waveform_store.get_reader()
+    if reader is None:
+        return jsonify({
+            "success": False,
+            "error": "No time-series store configured (PULSEMIND_TSDB_DIR)"
+        }), 503
+
+    series = reader.query_range(device_id, metric, start_us, end_us, max_points)
+    resolution_us = series.pop("resolution_us")
+    if mode is not None:
+        if resolution_us == 0:
+            y, high = series["values"], None
+        elif mode == "lttb":
+            y, high = series["mean"], None
+        else:
+            y, high = series["min"], series["max"]
+        timestamps, values = downsample.downsample(mode, series["timestamps_us"], y, max_points, high)
+        series = {"timestamps_us": [int(t) for t in timestamps], "values": values}
+    return jsonify({
+        "success": True,
+        "device_id": device_id,
+        "metric": metric,
+        "start": _iso_from_us(start_us),
+        "end": _iso_from_us(end_us),
+        "resolution_seconds": resolution_us / 1_000_000,
+        "downsample": mode,
+        "point_count": len(series["timestamps_us"]),
+        **series
+    }), 200
+
+
 if __name__ == '__main__':
     register_shutdown_handler(logger)
     logger.info("Starting control-engine on port 8004")
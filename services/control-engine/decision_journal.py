@@ -0,0 +1,638 @@
+"""Append-Only Decision Journal.
+
+Durable audit log for pacing decisions. Callers append records to an
+in-memory queue; a single background thread group-commits everything that
+queued up while the previous commit was in flight: one AES-GCM encryption,
+one write and one fsync per batch instead of per decision.
+
+On-disk layout (one directory, append-only segment files):
+
+    segment-<id:08d>.log
+        segment header: b"PMDJ" | version u16 | segment id u64 | key id (4)
+        batch frame*:   b"PMJB" | ciphertext length u32 | first record id u64
+                        | record count u32 | min ts_us i64 | max ts_us i64
+                        | nonce (12) | ciphertext (+16 byte tag) | crc32 u32
+
+Each segment is encrypted under its own key, derived with HKDF from a
+service secret and the segment id; the batch sequence number inside the
+segment is the nonce. New segments use the keyring's current secret and
+record its key id, so after a key rotation (ENCRYPTION_KEYS) older segments
+stay readable as long as their secret is still in the keyring
+(segments_by_key() tells when it no longer needs to be). Version 1 segments
+have no key id; the secret that opens them is found on first read. The frame header (record ids and time bounds) is
+bound to the ciphertext as associated data, so batches cannot be reordered or
+spliced between segments. The trailing CRC detects torn writes: recovery
+stops reading a segment at the first incomplete or corrupt frame.
+
+A writer creates its segments on first commit with O_CREAT | O_EXCL, taking
+the next id after every segment in the directory, so it never appends to a
+file another process (or an earlier run) wrote and never reuses a nonce. A
+failed write or fsync fails that batch and everything queued behind it, and
+the next commit starts a fresh segment, so no acknowledged batch ever sits
+behind a torn frame. Readers in other processes (decision_replay, tools)
+open the journal with read_only=True: they create nothing, and pick up
+batches committed since they opened on each read.
+
+The plaintext of a batch is a sequence of length-prefixed JSON records.
+Frame headers stay readable without the key, so the in-memory batch index
+(used for newest-first and time-range reads) is rebuilt on startup by
+scanning headers only. Reads that span many batches decrypt them in one
+phi_crypto batch, across cores when the native library is available.
+"""
+
+import bisect
+import json
+import os
+import struct
+import sys
+import threading
+import time
+import zlib
+from datetime import datetime, timezone
+from typing import Dict, Iterator, List, NamedTuple, Optional, Tuple
+
+from cryptography.exceptions import InvalidTag
+
+# Add shared module to path
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+from shared import phi_crypto  # noqa: E402
+from shared.logger import setup_logger  # noqa: E402
+from shared.security_utils import phi_keyring  # noqa: E402
+
+logger = setup_logger("decision-journal", level="INFO")
+
+JOURNAL_VERSION = 2
+SEGMENT_MAGIC = b"PMDJ"
+BATCH_MAGIC = b"PMJB"
+SEGMENT_HEADER_V1 = struct.Struct("<4sHQ")
+SEGMENT_HEADER = struct.Struct(f"<4sHQ{phi_crypto.KEY_ID_SIZE}s")
+BATCH_HEADER = struct.Struct("<4sIQIqq")
+RECORD_LENGTH = struct.Struct("<I")
+CRC = struct.Struct("<I")
+NONCE_SIZE = 12
+TAG_SIZE = 16
+
+# Rotate to a new segment once the current one exceeds this size
+SEGMENT_MAX_BYTES = 64 * 1024 * 1024
+
+# Upper bound on records per group commit (bounds commit latency under load)
+MAX_BATCH_RECORDS = 4096
+
+# Batches decrypted per phi_crypto call when reading many
+READ_CHUNK_BATCHES = 64
+
+
+def parse_timestamp_us(timestamp: str) -> int:
+    """Convert an ISO-8601 timestamp to epoch microseconds (naive means UTC).
+
+    Raises:
+        ValueError: If the timestamp is missing or not ISO-8601
+    """
+    try:
+        parsed = datetime.fromisoformat(timestamp.replace("Z", "+00:00"))
+    except (AttributeError, TypeError, ValueError) as e:
+        raise ValueError(f"Invalid ISO-8601 timestamp: {timestamp!r}") from e
+    if parsed.tzinfo is None:
+        parsed = parsed.replace(tzinfo=timezone.utc)
+    return int(parsed.timestamp() * 1_000_000)
+
+
+def timestamp_to_us(timestamp: Optional[str]) -> int:
+    """Convert a decision's own timestamp to epoch microseconds.
+
+    Missing or unparseable timestamps map to the current time so a record is
+    never rejected for its clock. Query bounds use parse_timestamp_us.
+    """
+    try:
+        return parse_timestamp_us(timestamp)
+    except ValueError:
+        return int(time.time() * 1_000_000)
+
+
+class BatchIndexEntry(NamedTuple):
+    """Location and bounds of one committed batch."""
+    first_id: int
+    count: int
+    min_ts_us: int
+    max_ts_us: int
+    segment_id: int
+    offset: int       # Frame start within the segment file
+    length: int       # Total frame length including CRC
+
+
+class DecisionJournal:
+    """Group-commit, append-only, encrypted decision journal."""
+
+    def __init__(
+        self,
+        directory: str,
+        key: Optional[bytes] = None,
+        segment_max_bytes: int = SEGMENT_MAX_BYTES,
+        max_batch_records: int = MAX_BATCH_RECORDS,
+        keyring: Optional[phi_crypto.Keyring] = None,
+        read_only: bool = False
+    ):
+        """Open (or create) a journal and start the commit thread.
+
+        Args:
+            directory: Journal directory
+            key: Master key material (shorthand for a one-key keyring)
+            segment_max_bytes: Segment rotation threshold
+            max_batch_records: Maximum records per group commit
+            keyring: Secrets, newest first (defaults to the service keyring)
+            read_only: Only read; no commit thread, nothing is created
+        """
+        self.directory = directory
+        if key is not None:
+            keyring = phi_crypto.Keyring([key])
+        self._keyring = keyring if keyring is not None else phi_keyring
+        self._segment_max_bytes = segment_max_bytes
+        self._max_batch_records = max_batch_records
+        self.read_only = read_only
+        if not read_only:
+            os.makedirs(directory, exist_ok=True)
+
+        self._index: List[BatchIndexEntry] = []
+        self._segment_keys: Dict[int, bytes] = {}
+        # Key id per segment; None for version 1 segments not yet read
+        self._segment_key_ids: Dict[int, Optional[bytes]] = {}
+        # Where the scan of each segment stopped (a reader resumes there)
+        self._scan_offsets: Dict[int, Optional[int]] = {}
+        self._cond = threading.Condition()
+        self._recover()
+
+        self._next_id = self._index[-1].first_id + self._index[-1].count if self._index else 1
+        self._committed_id = self._next_id - 1
+        # The writer's segment, created by the first commit
+        self._file = None
+        self._segment_id = 0
+
+        self._pending: List[Tuple[int, int, bytes]] = []
+        self._failed_through = 0
+        self._failed_ranges: List[Tuple[int, int]] = []
+        self._closed = False
+        self._writer = None
+        if not read_only:
+            self._writer = threading.Thread(
+                target=self._commit_loop, name="decision-journal", daemon=True
+            )
+            self._writer.start()
+
+    # ------------------------------------------------------------------------
+    # Keys and framing
+    # ------------------------------------------------------------------------
+
+    @staticmethod
+    def _derive_segment_key(secret: bytes, segment_id: int) -> bytes:
+        return phi_crypto.derive_key(
+            secret, b"pulsemind-decision-journal/segment/" + str(segment_id).encode()
+        )
+
+    def _segment_key(self, segment_id: int) -> bytes:
+        key = self._segment_keys.get(segment_id)
+        if key is None:
+            key_id = self._segment_key_ids.get(segment_id, self._keyring.current.key_id)
+            entry = self._keyring.get(key_id) if key_id is not None else None
+            if entry is None:
+                raise InvalidTag(
+                    f"Journal segment {segment_id} is sealed under a key not in the keyring"
+                )
+            key = self._derive_segment_key(entry.secret, segment_id)
+            self._segment_keys[segment_id] = key
+        return key
+
+    def _resolve_legacy_key(self, entry: BatchIndexEntry, frame: bytes):
+        """Find the secret that opens a version 1 segment (it records no key id)."""
+        head, nonce, ciphertext = self._split_frame(frame)
+        aad = self._associated_data(entry.segment_id, head)
+        for candidate in self._keyring.entries:
+            key = self._derive_segment_key(candidate.secret, entry.segment_id)
+            try:
+                phi_crypto.open_sealed(key, nonce, ciphertext, aad)
+            except InvalidTag:
+                continue
+            self._segment_key_ids[entry.segment_id] = candidate.key_id
+            self._segment_keys[entry.segment_id] = key
+            return
+        raise InvalidTag(f"No key in the keyring opens journal segment {entry.segment_id}")
+
+    def segments_by_key(self) -> Dict[str, List[int]]:
+        """Segment ids per key id (hex; "unknown" for unread version 1 segments).
+
+        A secret can be retired from the keyring once no segment still
+        needed is listed under its key id.
+        """
+        with self._cond:
+            segment_ids = {entry.segment_id for entry in self._index}
+            if self._file is not None:
+                segment_ids.add(self._segment_id)
+            segment_ids = sorted(segment_ids)
+        usage: Dict[str, List[int]] = {}
+        for segment_id in segment_ids:
+            key_id = self._segment_key_ids.get(segment_id)
+            usage.setdefault(key_id.hex() if key_id else "unknown", []).append(segment_id)
+        return usage
+
+    def _segment_path(self, segment_id: int) -> str:
+        return os.path.join(self.directory, f"segment-{segment_id:08d}.log")
+
+    # ------------------------------------------------------------------------
+    # Recovery
+    # ------------------------------------------------------------------------
+
+    def _segment_ids(self) -> List[int]:
+        """Ids of the segment files in the directory, ascending."""
+        try:
+            names = os.listdir(self.directory)
+        except FileNotFoundError:
+            return []
+        segment_ids = []
+        for name in names:
+            if name.startswith("segment-") and name.endswith(".log"):
+                try:
+                    segment_ids.append(int(name[len("segment-"):-len(".log")]))
+                except ValueError:
+                    continue
+        return sorted(segment_ids)
+
+    def _recover(self):
+        """Rebuild the batch index from segment frame headers."""
+        for segment_id in self._segment_ids():
+            self._scan_segment(segment_id, report=True)
+        if self._index:
+            logger.info(
+                f"Decision journal recovered {len(self._index)} batches, "
+                f"last record {self._index[-1].first_id + self._index[-1].count - 1}"
+            )
+
+    def refresh(self):
+        """Index batches other processes committed since the last scan (read-only journals)."""
+        if not self.read_only:
+            return
+        with self._cond:
+            for segment_id in self._segment_ids():
+                if self._scan_offsets.get(segment_id, 0) is not None:
+                    self._scan_segment(segment_id)
+
+    def _scan_segment(self, segment_id: int, report: bool = False):
+        """Index a segment's complete frames, resuming where its last scan stopped.
+
+        A segment found unusable (bad header, out-of-order ids) is marked
+        with a None offset and not scanned again.
+        """
+        path = self._segment_path(segment_id)
+        offset = self._scan_offsets.setdefault(segment_id, 0)
+        with open(path, "rb") as f:
+            if offset:
+                f.seek(offset)
+            else:
+                header = f.read(SEGMENT_HEADER_V1.size)
+                if len(header) < SEGMENT_HEADER_V1.size:
+                    return
+                magic, version, stored_id = SEGMENT_HEADER_V1.unpack(header)
+                if magic != SEGMENT_MAGIC or version not in (1, JOURNAL_VERSION) or stored_id != segment_id:
+                    logger.error(f"Ignoring journal segment with bad header: {path}")
+                    self._scan_offsets[segment_id] = None
+                    return
+                key_id = None
+                if version == JOURNAL_VERSION:
+                    key_id = f.read(phi_crypto.KEY_ID_SIZE)
+                    if len(key_id) < phi_crypto.KEY_ID_SIZE:
+                        return
+                self._segment_key_ids[segment_id] = key_id
+                offset = self._scan_offsets[segment_id] = f.tell()
+
+            while True:
+                head = f.read(BATCH_HEADER.size)
+                if not head:
+                    return
+                if len(head) < BATCH_HEADER.size:
+                    break
+                magic, cipher_len, first_id, count, min_ts, max_ts = BATCH_HEADER.unpack(head)
+                if magic != BATCH_MAGIC:
+                    break
+                body = f.read(NONCE_SIZE + cipher_len + CRC.size)
+                if len(body) < NONCE_SIZE + cipher_len + CRC.size:
+                    break
+                (crc,) = CRC.unpack(body[-CRC.size:])
+                if zlib.crc32(body[:-CRC.size], zlib.crc32(head)) != crc:
+                    break
+                # Ids only grow (a failed commit leaves a gap, never a reuse)
+                if self._index and first_id < self._index[-1].first_id + self._index[-1].count:
+                    logger.error(f"Out-of-order record ids in {path}; stopping scan")
+                    self._scan_offsets[segment_id] = None
+                    return
+                length = BATCH_HEADER.size + len(body)
+                self._index.append(BatchIndexEntry(
+                    first_id, count, min_ts, max_ts, segment_id, offset, length
+                ))
+                offset += length
+                self._scan_offsets[segment_id] = offset
+            # A reader may just be ahead of a live writer; only recovery reports it
+            if report:
+                logger.warning(f"Discarding torn tail of journal segment {path} at offset {offset}")
+
+    # ------------------------------------------------------------------------
+    # Writing
+    # ------------------------------------------------------------------------
+
+    def _open_segment(self):
+        """Create the segment after every one in the directory (never reopen one)."""
+        existing = self._segment_ids()
+        segment_id = max(existing[-1] if existing else 0, self._segment_id) + 1
+        while True:
+            try:
+                fd = os.open(
+                    self._segment_path(segment_id),
+                    os.O_WRONLY | os.O_CREAT | os.O_EXCL | os.O_APPEND, 0o600
+                )
+                break
+            except FileExistsError:
+                segment_id += 1  # Created by another process since the scan
+        self._file = os.fdopen(fd, "ab")
+        self._segment_id = segment_id
+        key_id = self._keyring.current.key_id
+        self._segment_key_ids[segment_id] = key_id
+        self._file.write(SEGMENT_HEADER.pack(SEGMENT_MAGIC, JOURNAL_VERSION, segment_id, key_id))
+        self._file.flush()
+        os.fsync(self._file.fileno())
+        self._fsync_directory()
+        self._segment_offset = SEGMENT_HEADER.size
+        self._batch_seq = 0
+
+    def _abandon_segment(self):
+        """Stop writing the current segment after a failed write or fsync.
+
+        The torn tail is truncated off when the file still allows it;
+        recovery stops at it either way, and the next commit opens a new
+        segment, so nothing is ever written after it.
+        """
+        f, self._file = self._file, None
+        if f is None:
+            return
+        try:
+            os.ftruncate(f.fileno(), self._segment_offset)
+            os.fsync(f.fileno())
+        except OSError as e:
+            logger.error(f"Could not truncate journal segment {self._segment_id}: {e}")
+        try:
+            f.close()
+        except OSError:
+            pass
+
+    def _fsync_directory(self):
+        """Make a newly created segment's directory entry durable."""
+        try:
+            fd = os.open(self.directory, os.O_RDONLY)
+        except OSError:
+            return
+        try:
+            os.fsync(fd)
+        except OSError:
+            pass
+        finally:
+            os.close(fd)
+
+    def append(self, record: Dict) -> int:
+        """Queue a record for the next group commit.
+
+        Args:
+            record: JSON-serializable decision payload
+
+        Returns:
+            Assigned record id (pass to wait_for() for durability)
+        """
+        if self.read_only:
+            raise RuntimeError("Decision journal is open read-only")
+        data = json.dumps(record, separators=(",", ":")).encode("utf-8")
+        ts_us = timestamp_to_us(record.get("timestamp"))
+        with self._cond:
+            if self._closed:
+                raise RuntimeError("Decision journal is closed")
+            record_id = self._next_id
+            self._next_id += 1
+            self._pending.append((record_id, ts_us, data))
+            self._cond.notify_all()
+        return record_id
+
+    def wait_for(self, record_id: int, timeout: Optional[float] = None) -> bool:
+        """Block until a record is durable on disk.
+
+        Returns:
+            True if committed, False on timeout or if its batch failed to write
+        """
+        with self._cond:
+            self._cond.wait_for(
+                lambda: self._committed_id >= record_id or self._failed_through >= record_id,
+                timeout=timeout,
+            )
+            if any(first <= record_id <= last for first, last in self._failed_ranges):
+                return False
+            return self._committed_id >= record_id
+
+    def flush(self, timeout: Optional[float] = None) -> bool:
+        """Wait until everything appended so far is durable."""
+        with self._cond:
+            last = self._next_id - 1
+        return self.wait_for(last, timeout)
+
+    def _commit_loop(self):
+        while True:
+            with self._cond:
+                self._cond.wait_for(lambda: self._pending or self._closed)
+                if not self._pending and self._closed:
+                    return
+                batch = self._pending[:self._max_batch_records]
+                del self._pending[:len(batch)]
+
+            try:
+                self._write_batch(batch)
+                committed = True
+            except Exception as e:
+                logger.error(f"Decision journal commit failed: {e}", exc_info=True)
+                self._abandon_segment()
+                committed = False
+
+            with self._cond:
+                if committed:
+                    self._committed_id = batch[-1][0]
+                else:
+                    # Records queued behind the failed batch fail with it
+                    # instead of following a write the disk just refused
+                    last = self._pending[-1][0] if self._pending else batch[-1][0]
+                    del self._pending[:]
+                    self._failed_through = last
+                    self._failed_ranges.append((batch[0][0], last))
+                self._cond.notify_all()
+
+    def _write_batch(self, batch: List[Tuple[int, int, bytes]]):
+        if self._file is not None and self._segment_offset >= self._segment_max_bytes:
+            self._file.close()
+            self._file = None
+        if self._file is None:
+            self._open_segment()
+
+        plaintext = b"".join(RECORD_LENGTH.pack(len(data)) + data for _, _, data in batch)
+        first_id = batch[0][0]
+        min_ts = min(ts for _, ts, _ in batch)
+        max_ts = max(ts for _, ts, _ in batch)
+
+        nonce = struct.pack("<4xQ", self._batch_seq)
+        self._batch_seq += 1
+        cipher_len = len(plaintext) + TAG_SIZE
+        head = BATCH_HEADER.pack(BATCH_MAGIC, cipher_len, first_id, len(batch), min_ts, max_ts)
+        ciphertext = phi_crypto.seal(
+            self._segment_key(self._segment_id), nonce, plaintext,
+            self._associated_data(self._segment_id, head)
+        )
+        body = nonce + ciphertext
+        frame = head + body + CRC.pack(zlib.crc32(body, zlib.crc32(head)))
+
+        self._file.write(frame)
+        self._file.flush()
+        os.fsync(self._file.fileno())
+
+        entry = BatchIndexEntry(
+            first_id, len(batch), min_ts, max_ts,
+            self._segment_id, self._segment_offset, len(frame)
+        )
+        self._segment_offset += len(frame)
+        with self._cond:
+            self._index.append(entry)
+
+    @staticmethod
+    def _associated_data(segment_id: int, head: bytes) -> bytes:
+        return struct.pack("<Q", segment_id) + head
+
+    def close(self, timeout: Optional[float] = 5.0):
+        """Commit pending records and stop the commit thread."""
+        with self._cond:
+            if self._closed:
+                return
+            self._closed = True
+            self._cond.notify_all()
+        if self._writer is not None:
+            self._writer.join(timeout)
+        if self._file is not None:
+            self._file.close()
+            self._file = None
+
+    # ------------------------------------------------------------------------
+    # Reading
+    # ------------------------------------------------------------------------
+
+    @staticmethod
+    def _split_frame(frame: bytes) -> Tuple[bytes, bytes, bytes]:
+        """(header, nonce, ciphertext with tag) of a batch frame."""
+        head = frame[:BATCH_HEADER.size]
+        nonce = frame[BATCH_HEADER.size:BATCH_HEADER.size + NONCE_SIZE]
+        return head, nonce, frame[BATCH_HEADER.size + NONCE_SIZE:-CRC.size]
+
+    def _read_frames(self, entries: List[BatchIndexEntry]) -> List[bytes]:
+        files = {}
+        try:
+            frames = []
+            for entry in entries:
+                f = files.get(entry.segment_id)
+                if f is None:
+                    f = files[entry.segment_id] = open(self._segment_path(entry.segment_id), "rb")
+                f.seek(entry.offset)
+                frames.append(f.read(entry.length))
+            return frames
+        finally:
+            for f in files.values():
+                f.close()
+
+    def _read_batches(self, entries: List[BatchIndexEntry]) -> List[List[Tuple[int, Dict]]]:
+        """Decrypt and parse batches, all in one phi_crypto call."""
+        frames = self._read_frames(entries)
+        for entry, frame in zip(entries, frames):
+            if self._segment_key_ids.get(entry.segment_id, b"") is None:
+                self._resolve_legacy_key(entry, frame)
+
+        jobs = []
+        for entry, frame in zip(entries, frames):
+            head, nonce, ciphertext = self._split_frame(frame)
+            jobs.append((
+                self._segment_key(entry.segment_id), nonce,
+                self._associated_data(entry.segment_id, head), ciphertext
+            ))
+
+        batches = []
+        for entry, plaintext in zip(entries, phi_crypto.open_batch(jobs)):
+            if plaintext is None:
+                raise InvalidTag(f"Journal batch at record {entry.first_id} failed authentication")
+            records = []
+            pos = 0
+            for record_id in range(entry.first_id, entry.first_id + entry.count):
+                (length,) = RECORD_LENGTH.unpack_from(plaintext, pos)
+                pos += RECORD_LENGTH.size
+                records.append((record_id, json.loads(plaintext[pos:pos + length])))
+                pos += length
+            batches.append(records)
+        return batches
+
+    def _iter_batches(self, entries: List[BatchIndexEntry]) -> Iterator[List[Tuple[int, Dict]]]:
+        for start in range(0, len(entries), READ_CHUNK_BATCHES):
+            yield from self._read_batches(entries[start:start + READ_CHUNK_BATCHES])
+
+    def _snapshot_index(self) -> List[BatchIndexEntry]:
+        self.refresh()
+        with self._cond:
+            return list(self._index)
+
+    def iter_records(self) -> Iterator[Tuple[int, Dict]]:
+        """Yield every committed (record id, payload) in append order."""
+        for batch in self._iter_batches(self._snapshot_index()):
+            yield from batch
+
+    def get(self, record_id: int) -> Optional[Dict]:
+        """Return one committed record by id, or None if there is none."""
+        index = self._snapshot_index()
+        pos = bisect.bisect_right([entry.first_id for entry in index], record_id) - 1
+        if pos < 0 or record_id >= index[pos].first_id + index[pos].count:
+            return None
+        return self._read_batches([index[pos]])[0][record_id - index[pos].first_id][1]
+
+    def latest(self, limit: int) -> List[Tuple[int, Dict]]:
+        """Return up to `limit` most recent committed records, newest first."""
+        # Batch counts are in the index, so the batches needed are known up front
+        entries = []
+        needed = limit
+        for entry in reversed(self._snapshot_index()):
+            if needed <= 0:
+                break
+            entries.append(entry)
+            needed -= entry.count
+
+        result: List[Tuple[int, Dict]] = []
+        for batch in self._iter_batches(entries):
+            result.extend(reversed(batch[-(limit - len(result)):]))
+        return result
+
+    def read_range(self, start_us: int, end_us: int) -> List[Tuple[int, Dict]]:
+        """Return committed records with start_us <= timestamp < end_us.
+
+        Only batches whose time bounds overlap the range are decrypted.
+        Results are in append order.
+        """
+        index = self._snapshot_index()
+        # Batches are appended in commit order, so max_ts is non-decreasing
+        # whenever decision clocks are; fall back to a full scan otherwise.
+        max_ts = [entry.max_ts_us for entry in index]
+        start = bisect.bisect_left(max_ts, start_us) if max_ts == sorted(max_ts) else 0
+
+        entries = [
+            entry for entry in index[start:]
+            if entry.max_ts_us >= start_us and entry.min_ts_us < end_us
+        ]
+        result = []
+        for batch in self._iter_batches(entries):
+            for record_id, record in batch:
+                if start_us <= timestamp_to_us(record.get("timestamp")) < end_us:
+                    result.append((record_id, record))
+        return result
+
+    def __len__(self) -> int:
+        """Number of committed records."""
+        return sum(entry.count for entry in self._snapshot_index())
@@ -0,0 +1,389 @@
+"""Deterministic Decision Replay and What-If Simulation.
+
+Replays the inputs recorded by DecisionLogger through one or more pacing
+policy versions and reports where they diverge. Because the policy is
+deterministic and keeps per-device state (see policy_store), each device's
+decision stream is replayed independently and in order, so devices are
+distributed across worker processes.
+
+Policy versions are given as specs:
+    recorded   - the commands that were actually issued (from the log)
+    python     - pacing_controller.AdaptivePacingPolicy
+    native     - pacing_controller.NativePacingPolicy (shared C++ policy)
+    path/x.py  - a candidate module exposing an AdaptivePacingPolicy class
+
+The first spec is the baseline every other version is compared against.
+
+Production does not keep one policy per device forever: idle policies are
+evicted, a restart drops them all and POST /controller-state replaces them.
+Decisions taken on a policy that had just started over carry a policy_start
+marker (new, or restored with the restored state), and replay starts the
+device over at the same points. Journals written before the marker existed
+fall back to the idle timeout: a device restarts after a gap between its
+decisions longer than POLICY_IDLE_TIMEOUT_SECONDS.
+
+Usage:
+    python decision_replay.py --versions recorded python candidate.py \\
+        --workers 8 --output report.json
+"""
+
+import argparse
+import importlib.util
+import json
+import logging
+import os
+import sys
+from collections import Counter
+from concurrent.futures import ProcessPoolExecutor
+from typing import Callable, Dict, Iterable, List, Optional, Sequence, Tuple
+
+# Add shared module to path
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+from decision_journal import parse_timestamp_us  # noqa: E402
+from persistence import DEFAULT_JOURNAL_DIR, DecisionLogger  # noqa: E402
+from policy_store import DEFAULT_DEVICE_ID, ORIGIN_RESTORED, POLICY_IDLE_TIMEOUT_SECONDS  # noqa: E402
+
+RECORDED_SPEC = "recorded"
+
+# Command fields compared between versions
+COMPARED_FIELDS = (
+    "pacing_enabled",
+    "pacing_mode",
+    "safety_state",
+    "target_rate_bpm",
+    "pacing_amplitude_ma",
+)
+
+# Divergence examples kept per version (the counts are always exact)
+MAX_DIVERGENCE_EXAMPLES = 20
+
+# (decision id, rhythm class, confidence, hsi score, hsi trend, heart rate,
+#  recorded command, policy_start marker or None, decision time in us or None)
+ReplayInput = Tuple[int, str, float, float, str, float, Dict, Optional[Dict], Optional[int]]
+
+
+# ============================================================================
+# INPUT EXTRACTION
+# ============================================================================
+
+def extract_replay_input(decision_id: int, payload: Dict) -> Optional[Tuple[str, ReplayInput]]:
+    """Turn a logged decision payload into a replayable input.
+
+    Fallback decisions (success == False) carry no input summary and are not
+    replayable: they never reached the policy.
+
+    Args:
+        decision_id: Record id from the decision journal
+        payload: Decrypted full_payload
+
+    Returns:
+        (device id, replay input) or None if the decision is not replayable
+    """
+    summary = payload.get("input_summary")
+    if not payload.get("success") or not isinstance(summary, dict):
+        return None
+    policy_start = payload.get("policy_start")
+    try:
+        timestamp_us = parse_timestamp_us(payload.get("timestamp"))
+    except ValueError:
+        timestamp_us = None
+    try:
+        replay_input = (
+            decision_id,
+            str(summary["rhythm_class"]),
+            float(summary["rhythm_confidence"]),
+            float(summary["hsi_score"]),
+            str(summary.get("hsi_trend", "stable")),
+            float(summary["heart_rate_bpm"]),
+            payload.get("pacing_command", {}),
+            policy_start if isinstance(policy_start, dict) else None,
+            timestamp_us,
+        )
+    except (KeyError, TypeError, ValueError):
+        return None
+    return summary.get("device_id") or DEFAULT_DEVICE_ID, replay_input
+
+
+def group_by_device(
+    decisions: Iterable[Tuple[int, Dict]]
+) -> Tuple[Dict[str, List[ReplayInput]], int]:
+    """Group replayable decisions per device, preserving log order.
+
+    Args:
+        decisions: (decision id, payload) pairs in insertion order
+
+    Returns:
+        (inputs per device, number of skipped decisions)
+    """
+    by_device: Dict[str, List[ReplayInput]] = {}
+    skipped = 0
+    for decision_id, payload in decisions:
+        extracted = extract_replay_input(decision_id, payload)
+        if extracted is None:
+            skipped += 1
+            continue
+        device_id, replay_input = extracted
+        by_device.setdefault(device_id, []).append(replay_input)
+    return by_device, skipped
+
+
+# ============================================================================
+# POLICY VERSIONS
+# ============================================================================
+
+def resolve_policy_factory(spec: str) -> Optional[Callable[[], object]]:
+    """Resolve a version spec to a policy factory.
+
+    Args:
+        spec: 'recorded', 'python', 'native' or a path to a policy module
+
+    Returns:
+        Policy factory, or None for the recorded pseudo-version
+
+    Raises:
+        ValueError: If the spec cannot be resolved
+    """
+    if spec == RECORDED_SPEC:
+        return None
+
+    import pacing_controller
+    if spec == "python":
+        return pacing_controller.AdaptivePacingPolicy
+    if spec == "native":
+        import native_policy
+        if not native_policy.is_available():
+            raise ValueError("Native safety policy library is not available")
+        return pacing_controller.NativePacingPolicy
+
+    if spec.endswith(".py") and os.path.isfile(spec):
+        module_name = "replay_candidate_" + os.path.splitext(os.path.basename(spec))[0]
+        module_spec = importlib.util.spec_from_file_location(module_name, spec)
+        module = importlib.util.module_from_spec(module_spec)
+        module_spec.loader.exec_module(module)
+        factory = getattr(module, "AdaptivePacingPolicy", None)
+        if factory is None:
+            raise ValueError(f"{spec} does not define AdaptivePacingPolicy")
+        return factory
+
+    raise ValueError(f"Unknown policy version: {spec}")
+
+
+def start_policy(factory: Optional[Callable[[], object]], policy_start: Optional[Dict]):
+    """A policy as production had it at a policy_start marker.
+
+    A restored state is imported when the version supports import_state()
+    and the state is valid for it; otherwise the policy starts fresh.
+    """
+    if factory is None:
+        return None
+    policy = factory()
+    if policy_start and policy_start.get("reason") == ORIGIN_RESTORED and hasattr(policy, "import_state"):
+        try:
+            policy.import_state(policy_start.get("state"))
+        except (ValueError, TypeError, AttributeError):
+            pass
+    return policy
+
+
+def _silence_policy_logging():
+    """Disable per-decision policy logs; replay would otherwise be log-bound."""
+    for name in ("pacing-controller", "decision-logger"):
+        logging.getLogger(name).disabled = True
+
+
+# ============================================================================
+# REPLAY
+# ============================================================================
+
+def _new_version_report() -> Dict:
+    return {
+        "decisions": 0,
+        "divergent_decisions": 0,
+        "field_divergences": Counter(),
+        "state_transitions": Counter(),
+        "pacing_modes": Counter(),
+        "examples": [],
+    }
+
+
+def replay_devices(
+    devices: Sequence[Tuple[str, List[ReplayInput]]],
+    specs: Sequence[str]
+) -> Dict[str, Dict]:
+    """Replay a group of devices through every version.
+
+    Each device starts from a fresh policy per version, exactly as the
+    control engine would for a device it has not seen, and starts over
+    wherever production did (see the module docstring).
+
+    Args:
+        devices: (device id, ordered inputs) pairs
+        specs: Version specs; specs[0] is the baseline
+
+    Returns:
+        Per-version partial report (merged by replay())
+    """
+    _silence_policy_logging()
+    factories = [resolve_policy_factory(spec) for spec in specs]
+    reports = {spec: _new_version_report() for spec in specs}
+
+    idle_timeout_us = POLICY_IDLE_TIMEOUT_SECONDS * 1_000_000
+    for device_id, inputs in devices:
+        policies: List[object] = []
+        previous_states: List[Optional[str]] = [None] * len(specs)
+        has_markers = False
+        last_time_us = None
+
+        for (decision_id, rhythm, confidence, hsi, trend, heart_rate, recorded, policy_start,
+             time_us) in inputs:
+            has_markers = has_markers or policy_start is not None
+            idle = (
+                not has_markers and time_us is not None and last_time_us is not None
+                and time_us - last_time_us > idle_timeout_us
+            )
+            if time_us is not None:
+                last_time_us = time_us
+            if not policies or policy_start is not None or idle:
+                policies = [start_policy(factory, policy_start) for factory in factories]
+
+            commands = [
+                recorded if policy is None else policy.compute_pacing_command(
+                    rhythm, confidence, hsi, trend, heart_rate
+                )
+                for policy in policies
+            ]
+            baseline = commands[0]
+
+            for index, (spec, command) in enumerate(zip(specs, commands)):
+                report = reports[spec]
+                report["decisions"] += 1
+                state = command.get("safety_state")
+                if previous_states[index] is not None and state != previous_states[index]:
+                    report["state_transitions"][f"{previous_states[index]}->{state}"] += 1
+                previous_states[index] = state
+                report["pacing_modes"][command.get("pacing_mode")] += 1
+
+                if index == 0:
+                    continue
+                differing = [
+                    field for field in COMPARED_FIELDS
+                    if command.get(field) != baseline.get(field)
+                ]
+                if not differing:
+                    continue
+                report["divergent_decisions"] += 1
+                report["field_divergences"].update(differing)
+                if len(report["examples"]) < MAX_DIVERGENCE_EXAMPLES:
+                    report["examples"].append({
+                        "decision_id": decision_id,
+                        "device_id": device_id,
+                        "inputs": {
+                            "rhythm_class": rhythm,
+                            "rhythm_confidence": confidence,
+                            "hsi_score": hsi,
+                            "hsi_trend": trend,
+                            "heart_rate_bpm": heart_rate,
+                        },
+                        "baseline": {f: baseline.get(f) for f in differing},
+                        "candidate": {f: command.get(f) for f in differing},
+                    })
+    return reports
+
+
+def replay(
+    inputs_by_device: Dict[str, List[ReplayInput]],
+    specs: Sequence[str],
+    workers: int = 1
+) -> Dict:
+    """Replay all devices and build the divergence report.
+
+    Args:
+        inputs_by_device: Output of group_by_device()
+        specs: Version specs; specs[0] is the baseline
+        workers: Worker processes (1 = replay in this process)
+
+    Returns:
+        JSON-serializable report keyed by version spec
+
+    Raises:
+        ValueError: If fewer than one spec is given or a spec is invalid
+    """
+    if not specs:
+        raise ValueError("At least one policy version is required")
+    for spec in specs:
+        resolve_policy_factory(spec)  # Fail fast before starting workers
+
+    # Largest devices first so long streams do not straggle at the end
+    devices = sorted(inputs_by_device.items(), key=lambda item: len(item[1]), reverse=True)
+    if workers <= 1:
+        partials = [replay_devices(devices, specs)]
+    else:
+        tasks = [devices[i::workers * 4] for i in range(workers * 4)]
+        tasks = [task for task in tasks if task]
+        with ProcessPoolExecutor(max_workers=workers) as executor:
+            partials = list(executor.map(replay_devices, tasks, [specs] * len(tasks)))
+
+    merged = {spec: _new_version_report() for spec in specs}
+    for partial in partials:
+        for spec, report in partial.items():
+            target = merged[spec]
+            target["decisions"] += report["decisions"]
+            target["divergent_decisions"] += report["divergent_decisions"]
+            for key in ("field_divergences", "state_transitions", "pacing_modes"):
+                target[key].update(report[key])
+            room = MAX_DIVERGENCE_EXAMPLES - len(target["examples"])
+            target["examples"].extend(report["examples"][:room])
+
+    versions = {}
+    for spec, report in merged.items():
+        decisions = report["decisions"]
+        versions[spec] = {
+            "decisions": decisions,
+            "divergent_decisions": report["divergent_decisions"],
+            "divergence_rate": (
+                round(report["divergent_decisions"] / decisions, 6) if decisions else 0.0
+            ),
+            "field_divergences": dict(report["field_divergences"]),
+            "state_transitions": dict(report["state_transitions"].most_common()),
+            "pacing_modes": dict(report["pacing_modes"].most_common()),
+            "examples": sorted(report["examples"], key=lambda e: e["decision_id"]),
+        }
+
+    return {
+        "baseline": specs[0],
+        "devices": len(inputs_by_device),
+        "versions": versions,
+    }
+
+
+def main(argv: Optional[Sequence[str]] = None) -> int:
+    """Command line entry point."""
+    parser = argparse.ArgumentParser(description="Replay logged pacing decisions")
+    parser.add_argument("--journal", default=None,
+                        help="Decision journal directory (default: the service journal)")
+    parser.add_argument("--versions", nargs="+", default=[RECORDED_SPEC, "python"],
+                        help="Policy versions; the first is the baseline")
+    parser.add_argument("--workers", type=int, default=os.cpu_count() or 1)
+    parser.add_argument("--output", help="Write the JSON report here (default stdout)")
+    args = parser.parse_args(argv)
+
+    _silence_policy_logging()
+    journal_dir = args.journal or DEFAULT_JOURNAL_DIR
+    decision_logger = DecisionLogger(journal_dir, read_only=True)
+    inputs_by_device, skipped = group_by_device(decision_logger.iter_payloads())
+    report = replay(inputs_by_device, args.versions, workers=args.workers)
+    report["skipped_decisions"] = skipped
+
+    text = json.dumps(report, indent=2)
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(text + "\n")
+    else:
+        print(text)
+
+    divergent = sum(v["divergent_decisions"] for v in report["versions"].values())
+    return 1 if divergent else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
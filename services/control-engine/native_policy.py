@@ -0,0 +1,215 @@
+"""ctypes bindings for the shared C++ safety policy (shared/native/SafetyPolicy.h).
+
+The same header is compiled into the ESP32 firmware, so server and device run
+one implementation of the safety state machine. This module only exposes the
+raw C ABI; pacing_controller.NativePacingPolicy adapts it to the Python API.
+
+Build the library with `make -C services/shared/native`, or point
+PULSEMIND_SAFETY_POLICY_LIB at a prebuilt libsafety_policy.so.
+"""
+
+import ctypes
+import os
+from typing import Optional
+
+DEFAULT_LIBRARY_PATH = os.path.join(
+    os.path.dirname(os.path.abspath(__file__)),
+    "..", "shared", "native", "build", "libsafety_policy.so"
+)
+LIBRARY_PATH = os.getenv("PULSEMIND_SAFETY_POLICY_LIB", DEFAULT_LIBRARY_PATH)
+
+ABI_VERSION = 2
+
+# Enum values shared with SafetyPolicy.h
+RHYTHM_CODES = {
+    "normal_sinus": 0,
+    "bradycardia": 1,
+    "tachycardia": 2,
+    "irregular": 3,
+    "artifact": 4,
+}
+RHYTHM_UNKNOWN = 5
+TREND_CODES = {"stable": 0, "improving": 1, "declining": 2}
+
+
+class PolicyState(ctypes.Structure):
+    """Mirror of pulsemind::PolicyState."""
+
+    _fields_ = [
+        ("current_state", ctypes.c_uint8),
+        ("has_last_rate", ctypes.c_uint8),
+        ("reserved", ctypes.c_uint8 * 2),
+        ("consecutive_degraded_cycles", ctypes.c_uint32),
+        ("consecutive_safe_cycles", ctypes.c_uint32),
+        ("total_safety_violations", ctypes.c_uint32),
+        ("total_fallback_activations", ctypes.c_uint32),
+        ("last_pacing_rate", ctypes.c_double),
+        ("last_pacing_amplitude", ctypes.c_double),
+    ]
+
+
+class Command(ctypes.Structure):
+    """Mirror of pm_command."""
+
+    _fields_ = [
+        ("pacing_enabled", ctypes.c_uint8),
+        ("pacing_mode", ctypes.c_uint8),
+        ("safety_state", ctypes.c_uint8),
+        ("rate_within_bounds", ctypes.c_uint8),
+        ("amplitude_within_bounds", ctypes.c_uint8),
+        ("confidence_acceptable", ctypes.c_uint8),
+        ("hsi_acceptable", ctypes.c_uint8),
+        ("reserved", ctypes.c_uint8),
+        ("target_rate_bpm", ctypes.c_double),
+        ("pacing_amplitude_ma", ctypes.c_double),
+    ]
+
+
+class ShaperState(ctypes.Structure):
+    """Mirror of pulsemind::ShaperState."""
+
+    _fields_ = [
+        ("initialized", ctypes.c_uint8),
+        ("enabled", ctypes.c_uint8),
+        ("has_published", ctypes.c_uint8),
+        ("published_enabled", ctypes.c_uint8),
+        ("reserved", ctypes.c_uint32),
+        ("last_update_ms", ctypes.c_uint64),
+        ("last_publish_ms", ctypes.c_uint64),
+        ("goal_rate", ctypes.c_double),
+        ("shaped_rate", ctypes.c_double),
+        ("published_rate", ctypes.c_double),
+    ]
+
+
+class ShapedCommand(ctypes.Structure):
+    """Mirror of pm_shaped_command."""
+
+    _fields_ = [
+        ("pacing_enabled", ctypes.c_uint8),
+        ("publish", ctypes.c_uint8),
+        ("reserved", ctypes.c_uint8 * 6),
+        ("rate_bpm", ctypes.c_double),
+    ]
+
+
+_lib: Optional[ctypes.CDLL] = None
+
+
+def load_library(path: str = LIBRARY_PATH) -> ctypes.CDLL:
+    """Load and type the native library (cached after the first call).
+
+    Raises:
+        OSError: If the library is missing or has an incompatible ABI
+    """
+    global _lib
+    if _lib is not None:
+        return _lib
+
+    lib = ctypes.CDLL(path)
+    lib.pm_abi_version.restype = ctypes.c_uint32
+    lib.pm_policy_state_size.restype = ctypes.c_uint32
+    if lib.pm_abi_version() != ABI_VERSION:
+        raise OSError(f"Unsupported safety policy ABI version {lib.pm_abi_version()}")
+    if lib.pm_policy_state_size() != ctypes.sizeof(PolicyState):
+        raise OSError("PolicyState layout mismatch between Python and native library")
+    lib.pm_shaper_state_size.restype = ctypes.c_uint32
+    if lib.pm_shaper_state_size() != ctypes.sizeof(ShaperState):
+        raise OSError("ShaperState layout mismatch between Python and native library")
+
+    state_p = ctypes.POINTER(PolicyState)
+    u8, f64 = ctypes.c_uint8, ctypes.c_double
+
+    lib.pm_policy_init.argtypes = [state_p]
+    lib.pm_policy_init.restype = None
+    lib.pm_evaluate_state.argtypes = [state_p, u8, f64, f64, f64]
+    lib.pm_evaluate_state.restype = u8
+    lib.pm_update_state.argtypes = [state_p, u8]
+    lib.pm_update_state.restype = None
+    lib.pm_determine_pacing_mode.argtypes = [u8, f64, u8, u8]
+    lib.pm_determine_pacing_mode.restype = u8
+    lib.pm_compute_target_rate.argtypes = [state_p, f64, u8, f64, u8]
+    lib.pm_compute_target_rate.restype = f64
+    lib.pm_compute_pacing_amplitude.argtypes = [u8, f64]
+    lib.pm_compute_pacing_amplitude.restype = f64
+    lib.pm_compute_pacing_command.argtypes = [
+        state_p, u8, f64, f64, u8, f64, ctypes.POINTER(Command)
+    ]
+    lib.pm_compute_pacing_command.restype = None
+
+    shaper_p = ctypes.POINTER(ShaperState)
+    lib.pm_shaper_init.argtypes = [shaper_p]
+    lib.pm_shaper_init.restype = None
+    lib.pm_shape_command.argtypes = [
+        shaper_p, u8, f64, u8, ctypes.c_uint64, ctypes.POINTER(ShapedCommand)
+    ]
+    lib.pm_shape_command.restype = None
+
+    _lib = lib
+    return lib
+
+
+def is_available(path: str = LIBRARY_PATH) -> bool:
+    """Return True if the native library can be loaded."""
+    try:
+        load_library(path)
+        return True
+    except OSError:
+        return False
+
+
+def rhythm_code(rhythm_class: str) -> int:
+    """Map a rhythm label to its native enum value."""
+    return RHYTHM_CODES.get(rhythm_class, RHYTHM_UNKNOWN)
+
+
+def trend_code(hsi_trend: str) -> int:
+    """Map a trend label to its native enum value (unknown -> stable)."""
+    return TREND_CODES.get(hsi_trend, 0)
+
+
+def new_state() -> PolicyState:
+    """Allocate and initialize a controller state."""
+    state = PolicyState()
+    load_library().pm_policy_init(ctypes.byref(state))
+    return state
+
+
+def compute_pacing_command(
+    state: PolicyState,
+    rhythm_class: str,
+    rhythm_confidence: float,
+    hsi_score: float,
+    hsi_trend: str,
+    heart_rate: float
+) -> Command:
+    """Run one full policy decision, updating state in place."""
+    command = Command()
+    load_library().pm_compute_pacing_command(
+        ctypes.byref(state), rhythm_code(rhythm_class), rhythm_confidence,
+        hsi_score, trend_code(hsi_trend), heart_rate, ctypes.byref(command)
+    )
+    return command
+
+
+def new_shaper_state() -> ShaperState:
+    """Allocate and initialize a command shaper state."""
+    state = ShaperState()
+    load_library().pm_shaper_init(ctypes.byref(state))
+    return state
+
+
+def shape_command(
+    state: ShaperState,
+    enabled: bool,
+    target_rate: float,
+    immediate: bool,
+    now_ms: int
+) -> ShapedCommand:
+    """Advance the command shaper, updating state in place."""
+    shaped = ShapedCommand()
+    load_library().pm_shape_command(
+        ctypes.byref(state), int(enabled), target_rate, int(immediate), now_ms,
+        ctypes.byref(shaped)
+    )
+    return shaped
@@ -14,19 +14,40 @@ Design Principles:
 5. Robust - Never crashes, handles all invalid inputs gracefully
 """
 
+import atexit
+import math
 import os
 import sys
+import threading
+import time
 from datetime import datetime
 from enum import Enum
-from typing import Dict
+from typing import Dict, Optional
 
 # Add shared module to path
 sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
 from shared.logger import setup_logger  # noqa: E402
 from persistence import DecisionLogger # noqa: E402
+import native_policy  # noqa: E402
+from policy_store import DEFAULT_DEVICE_ID, ORIGIN_RESTORED, PolicyStore  # noqa: E402
 
 logger = setup_logger("pacing-controller", level="INFO")
-decision_logger = DecisionLogger()
+
+# The journal writer, opened by the first decision rather than at import:
+# importing this module (decision_replay and its workers, tests, tools)
+# must not create a segment in the live journal
+_decision_logger: Optional[DecisionLogger] = None
+_decision_logger_lock = threading.Lock()
+
+
+def get_decision_logger() -> DecisionLogger:
+    """Return this process's decision journal writer, opening it on first use."""
+    global _decision_logger
+    with _decision_logger_lock:
+        if _decision_logger is None:
+            _decision_logger = DecisionLogger()
+            atexit.register(_decision_logger.close)
+        return _decision_logger
 
 
 # ============================================================================
@@ -61,6 +82,22 @@ CONFIDENCE_THRESHOLD_MEDIUM = 0.60  # Medium confidence - be cautious
 MAX_RATE_INCREASE_PER_CYCLE = 10  # BPM - Maximum increase per decision
 MAX_RATE_DECREASE_PER_CYCLE = 10  # BPM - Maximum decrease per decision
 
+# Command shaping (applied after the policy, see CommandShaper)
+# Rationale: Decisions arrive at irregular intervals; rate changes should be
+# gradual in wall-clock time, and unchanged commands need not be resent
+SHAPER_MAX_SLEW_BPM_PER_SEC = 2.0    # BPM/s - 10 BPM change takes 5 s
+SHAPER_DEADBAND_BPM = 1.0            # BPM - Ignore smaller retargets
+SHAPER_PUBLISH_RESOLUTION_BPM = 0.5  # BPM - Smallest change worth publishing
+SHAPER_KEEPALIVE_MS = 30000          # ms - Republish unchanged commands
+
+# NOTE: These constants, the state machine and the command shaper below are
+# mirrored in the shared C++ header services/shared/native/SafetyPolicy.h (used
+# by the ESP32 firmware and NativePacingPolicy). Any change MUST be applied to
+# both.
+
+# Use the shared C++ implementation for the global policy when available
+USE_NATIVE_POLICY = os.getenv("PULSEMIND_NATIVE_POLICY") == "1"
+
 
 # ============================================================================
 # FINITE-STATE SAFETY CONTROLLER
@@ -233,6 +270,122 @@ class SafetyController:
                 logger.debug(f"Safe cycle {self.consecutive_safe_cycles}/3 for state improvement")
 
 
+# ============================================================================
+# COMMAND SHAPING
+# ============================================================================
+
+class CommandShaper:
+    """Slew limiter, deadband and publish coalescing for pacing commands.
+
+    The policy limits the target to MAX_RATE_*_PER_CYCLE per decision, but
+    not per unit time. The shaper moves the delivered rate toward the target
+    at no more than SHAPER_MAX_SLEW_BPM_PER_SEC, ignores retargets smaller
+    than SHAPER_DEADBAND_BPM, and flags a command for publishing only when it
+    differs from the last published one (or the keepalive is due).
+
+    Medical Safety: EMERGENCY pacing and switching pacing on bypass the slew
+    limit - the safe rate applies at once. Output is always clamped to the
+    absolute rate bounds.
+    """
+
+    def __init__(self):
+        """Initialize an empty shaper (first command applies immediately)."""
+        self.initialized = False
+        self.enabled = False
+        self.has_published = False
+        self.published_enabled = False
+        self.last_update_ms = 0
+        self.last_publish_ms = 0
+        self.goal_rate = 0.0
+        self.shaped_rate = 0.0
+        self.published_rate = 0.0
+
+    def shape(self, enabled: bool, target_rate: float, immediate: bool, now_ms: int) -> Dict:
+        """Advance the shaper to now_ms with a new policy output.
+
+        Args:
+            enabled: Whether the policy enabled pacing
+            target_rate: Policy target rate in BPM
+            immediate: Skip the slew limit (EMERGENCY pacing)
+            now_ms: Monotonic time in milliseconds
+
+        Returns:
+            Dictionary with 'pacing_enabled', 'target_rate_bpm' and 'publish'
+        """
+        target = max(ABSOLUTE_MIN_PACING_RATE, min(ABSOLUTE_MAX_PACING_RATE, target_rate))
+        if not self.initialized or immediate or (enabled and not self.enabled):
+            self.goal_rate = target
+            self.shaped_rate = target
+            self.initialized = True
+        else:
+            retarget = target - self.goal_rate
+            if retarget >= SHAPER_DEADBAND_BPM or retarget <= -SHAPER_DEADBAND_BPM:
+                self.goal_rate = target
+            elapsed_sec = (now_ms - self.last_update_ms) / 1000.0 if now_ms > self.last_update_ms else 0.0
+            max_step = SHAPER_MAX_SLEW_BPM_PER_SEC * elapsed_sec
+            self.shaped_rate = self.shaped_rate + max(
+                -max_step, min(max_step, self.goal_rate - self.shaped_rate)
+            )
+        self.last_update_ms = now_ms
+        self.enabled = enabled
+
+        drift = self.shaped_rate - self.published_rate
+        publish = (
+            not self.has_published
+            or enabled != self.published_enabled
+            or drift >= SHAPER_PUBLISH_RESOLUTION_BPM
+            or drift <= -SHAPER_PUBLISH_RESOLUTION_BPM
+            or (self.shaped_rate == self.goal_rate and self.published_rate != self.shaped_rate)
+            or now_ms < self.last_publish_ms
+            or now_ms - self.last_publish_ms >= SHAPER_KEEPALIVE_MS
+        )
+        if publish:
+            self.has_published = True
+            self.published_enabled = enabled
+            self.published_rate = self.shaped_rate
+            self.last_publish_ms = now_ms
+
+        return {
+            "pacing_enabled": enabled,
+            "target_rate_bpm": self.shaped_rate,
+            "publish": publish,
+        }
+
+
+# Shaper fields carried by export_state()/import_state(), by type. The names
+# are shared by CommandShaper and native_policy.ShaperState.
+SHAPER_FLAG_FIELDS = ("initialized", "enabled", "has_published", "published_enabled")
+SHAPER_TIME_FIELDS = ("last_update_ms", "last_publish_ms")
+SHAPER_RATE_FIELDS = ("goal_rate", "shaped_rate", "published_rate")
+
+
+def export_shaper_state(shaper) -> Dict:
+    """Export a CommandShaper or native ShaperState as a JSON-serializable dict."""
+    state = {field: bool(getattr(shaper, field)) for field in SHAPER_FLAG_FIELDS}
+    state.update({field: int(getattr(shaper, field)) for field in SHAPER_TIME_FIELDS})
+    state.update({field: float(getattr(shaper, field)) for field in SHAPER_RATE_FIELDS})
+    return state
+
+
+def parse_shaper_state(state: Dict) -> Dict:
+    """Validate an exported shaper state.
+
+    Raises:
+        ValueError: If a field is missing, negative or not finite
+    """
+    try:
+        parsed = {field: bool(state[field]) for field in SHAPER_FLAG_FIELDS}
+        parsed.update({field: int(state[field]) for field in SHAPER_TIME_FIELDS})
+        parsed.update({field: float(state[field]) for field in SHAPER_RATE_FIELDS})
+    except (KeyError, TypeError, ValueError, OverflowError) as e:
+        raise ValueError(f"Invalid shaper state: {e}") from e
+    if any(parsed[field] < 0 for field in SHAPER_TIME_FIELDS):
+        raise ValueError("Invalid shaper state: negative time")
+    if not all(math.isfinite(parsed[field]) for field in SHAPER_RATE_FIELDS):
+        raise ValueError("Invalid shaper state: non-finite rate")
+    return parsed
+
+
 # ============================================================================
 # ADAPTIVE PACING POLICY
 # ============================================================================
@@ -253,6 +406,7 @@ class AdaptivePacingPolicy:
     def __init__(self):
         """Initialize pacing policy."""
         self.safety_controller = SafetyController()
+        self.command_shaper = CommandShaper()
         self.last_pacing_rate = None
         self.last_pacing_amplitude = None
     
@@ -552,7 +706,32 @@ class AdaptivePacingPolicy:
         self.last_pacing_amplitude = amplitude
         
         # Step 6: Build command
-        command = {
+        command = self._build_command(
+            pacing_mode, safety_state, target_rate, amplitude,
+            rhythm_class, rhythm_confidence, hsi_score, hsi_trend
+        )
+
+        logger.info(
+            f"Pacing command: enabled={command['pacing_enabled']}, "
+            f"rate={target_rate:.1f}, amp={amplitude:.2f}, "
+            f"mode={pacing_mode.value}, state={safety_state.value}"
+        )
+
+        return command
+    
+    def _build_command(
+        self,
+        pacing_mode: PacingMode,
+        safety_state: SafetyState,
+        target_rate: float,
+        amplitude: float,
+        rhythm_class: str,
+        rhythm_confidence: float,
+        hsi_score: float,
+        hsi_trend: str
+    ) -> Dict:
+        """Assemble the pacing command dictionary returned to callers."""
+        return {
             "pacing_enabled": pacing_mode != PacingMode.MONITOR_ONLY,
             "target_rate_bpm": round(target_rate, 1),
             "pacing_amplitude_ma": round(amplitude, 2),
@@ -577,14 +756,6 @@ class AdaptivePacingPolicy:
             )
         }
 
-        logger.info(
-            f"Pacing command: enabled={command['pacing_enabled']}, "
-            f"rate={target_rate:.1f}, amp={amplitude:.2f}, "
-            f"mode={pacing_mode.value}, state={safety_state.value}"
-        )
-
-        return command
-    
     def _generate_rationale(
         self,
         rhythm_class: str,
@@ -652,14 +823,200 @@ class AdaptivePacingPolicy:
         
         return "; ".join(parts)
 
+    def shape_command(self, command: Dict, now_ms: int) -> Dict:
+        """Shape a computed pacing command for delivery.
+
+        Args:
+            command: Output of compute_pacing_command
+            now_ms: Monotonic time in milliseconds
+
+        Returns:
+            Shaped command ('pacing_enabled', 'target_rate_bpm', 'publish')
+        """
+        shaped = self.command_shaper.shape(
+            command["pacing_enabled"], command["target_rate_bpm"],
+            command["pacing_mode"] == PacingMode.EMERGENCY.name.lower(), now_ms
+        )
+        shaped["target_rate_bpm"] = round(shaped["target_rate_bpm"], 1)
+        return shaped
+
+    def export_state(self) -> Dict:
+        """Export the controller state that carries over between decisions.
+
+        Returns:
+            JSON-serializable dictionary accepted by import_state()
+        """
+        controller = self.safety_controller
+        return {
+            "current_state": controller.current_state.name.lower(),
+            "consecutive_degraded_cycles": controller.consecutive_degraded_cycles,
+            "consecutive_safe_cycles": controller.consecutive_safe_cycles,
+            "total_safety_violations": controller.total_safety_violations,
+            "total_fallback_activations": controller.total_fallback_activations,
+            "last_pacing_rate": self.last_pacing_rate,
+            "last_pacing_amplitude": self.last_pacing_amplitude,
+            "command_shaper": export_shaper_state(self._shaper()),
+        }
+
+    def _shaper(self):
+        """State object behind shape_command()."""
+        return self.command_shaper
+
+    def import_state(self, state: Dict):
+        """Restore controller state produced by export_state().
+
+        Args:
+            state: Exported state dictionary
+
+        Raises:
+            ValueError: If the state is malformed (policy is left unchanged)
+        """
+        try:
+            current_state = SafetyState[str(state["current_state"]).upper()]
+            counters = [
+                int(state[key]) for key in (
+                    "consecutive_degraded_cycles", "consecutive_safe_cycles",
+                    "total_safety_violations", "total_fallback_activations",
+                )
+            ]
+            last_rate = state.get("last_pacing_rate")
+            last_amplitude = state.get("last_pacing_amplitude")
+            last_rate = None if last_rate is None else float(last_rate)
+            last_amplitude = None if last_amplitude is None else float(last_amplitude)
+            # Absent in states exported before the shaper was included: the
+            # shaper then starts empty and publishes the next command
+            shaper = state.get("command_shaper")
+            shaper = None if shaper is None else parse_shaper_state(shaper)
+        except (KeyError, TypeError, ValueError) as e:
+            raise ValueError(f"Invalid policy state: {e}") from e
+        if any(counter < 0 for counter in counters):
+            raise ValueError("Invalid policy state: negative counter")
+
+        controller = self.safety_controller
+        controller.current_state = current_state
+        (
+            controller.consecutive_degraded_cycles,
+            controller.consecutive_safe_cycles,
+            controller.total_safety_violations,
+            controller.total_fallback_activations,
+        ) = counters
+        self.last_pacing_rate = last_rate
+        self.last_pacing_amplitude = last_amplitude
+        if shaper is not None:
+            target = self._shaper()
+            for field, value in shaper.items():
+                setattr(target, field, value)
+
+
+# ============================================================================
+# NATIVE POLICY BACKEND
+# ============================================================================
+
+class NativePacingPolicy(AdaptivePacingPolicy):
+    """AdaptivePacingPolicy backed by the shared C++ safety policy.
+
+    The decision itself (state evaluation, hysteresis, mode, rate, amplitude)
+    runs in SafetyPolicy.h - the same code the firmware executes. Only command
+    formatting and rationale text are produced here.
+    
+    Medical Safety: Output is identical to AdaptivePacingPolicy for the same
+    input sequence; test_pacing_controller.py verifies parity.
+    """
+    
+    def __init__(self):
+        """Initialize native controller state (requires the native library)."""
+        super().__init__()
+        native_policy.load_library()
+        self.native_state = native_policy.new_state()
+        self.native_shaper = native_policy.new_shaper_state()
+    
+    def compute_pacing_command(
+        self,
+        rhythm_class: str,
+        rhythm_confidence: float,
+        hsi_score: float,
+        hsi_trend: str,
+        heart_rate: float
+    ) -> Dict:
+        """Compute a complete pacing command using the native policy."""
+        native = native_policy.compute_pacing_command(
+            self.native_state, rhythm_class, rhythm_confidence,
+            hsi_score, hsi_trend, heart_rate
+        )
+        pacing_mode = PacingMode(native.pacing_mode)
+        safety_state = SafetyState(native.safety_state)
+        
+        # Mirror native state on the Python attributes for introspection
+        state = self.native_state
+        self.safety_controller.current_state = safety_state
+        self.safety_controller.consecutive_degraded_cycles = state.consecutive_degraded_cycles
+        self.safety_controller.consecutive_safe_cycles = state.consecutive_safe_cycles
+        self.safety_controller.total_safety_violations = state.total_safety_violations
+        self.safety_controller.total_fallback_activations = state.total_fallback_activations
+        self.last_pacing_rate = native.target_rate_bpm
+        self.last_pacing_amplitude = native.pacing_amplitude_ma
+        
+        command = self._build_command(
+            pacing_mode, safety_state, native.target_rate_bpm,
+            native.pacing_amplitude_ma, rhythm_class, rhythm_confidence,
+            hsi_score, hsi_trend
+        )
+
+        logger.info(
+            f"Pacing command (native): enabled={command['pacing_enabled']}, "
+            f"rate={native.target_rate_bpm:.1f}, amp={native.pacing_amplitude_ma:.2f}, "
+            f"mode={pacing_mode.value}, state={safety_state.value}"
+        )
+
+        return command
+
+    def shape_command(self, command: Dict, now_ms: int) -> Dict:
+        """Shape a computed pacing command using the native shaper."""
+        shaped = native_policy.shape_command(
+            self.native_shaper, command["pacing_enabled"], command["target_rate_bpm"],
+            command["pacing_mode"] == PacingMode.EMERGENCY.name.lower(), now_ms
+        )
+        return {
+            "pacing_enabled": bool(shaped.pacing_enabled),
+            "target_rate_bpm": round(shaped.rate_bpm, 1),
+            "publish": bool(shaped.publish),
+        }
+
+    def _shaper(self):
+        """State struct behind the native shape_command()."""
+        return self.native_shaper
+
+    def import_state(self, state: Dict):
+        """Restore controller state into the native state struct."""
+        super().import_state(state)
+        controller = self.safety_controller
+        native = self.native_state
+        native.current_state = controller.current_state.value
+        native.consecutive_degraded_cycles = controller.consecutive_degraded_cycles
+        native.consecutive_safe_cycles = controller.consecutive_safe_cycles
+        native.total_safety_violations = controller.total_safety_violations
+        native.total_fallback_activations = controller.total_fallback_activations
+        native.has_last_rate = int(self.last_pacing_rate is not None)
+        native.last_pacing_rate = self.last_pacing_rate or 0.0
+        native.last_pacing_amplitude = self.last_pacing_amplitude or 0.0
+
 
 # ============================================================================
-# GLOBAL POLICY INSTANCE
+# PER-DEVICE POLICY STORE
 # ============================================================================
 
-# Global policy instance
-# Maintains state across requests for rate limiting and hysteresis
-pacing_policy = AdaptivePacingPolicy()
+if USE_NATIVE_POLICY and native_policy.is_available():
+    logger.info("Using native safety policy backend")
+    _policy_factory = NativePacingPolicy
+else:
+    if USE_NATIVE_POLICY:
+        logger.warning("Native safety policy library not found - using Python policy")
+    _policy_factory = AdaptivePacingPolicy
+
+# One policy per patient device
+# Maintains state across requests for rate limiting and hysteresis without
+# sharing hysteresis counters between patients
+policy_store = PolicyStore(_policy_factory)
 
 
 # ============================================================================
@@ -667,7 +1024,11 @@ pacing_policy = AdaptivePacingPolicy()
 # ============================================================================
 
 
-def process_pacing_decision(rhythm_data: Dict, hsi_data: Dict) -> Dict:
+def process_pacing_decision(
+    rhythm_data: Dict,
+    hsi_data: Dict,
+    device_id: Optional[str] = None
+) -> Dict:
     """Process pacing decision from rhythm and HSI data.
 
     Medical Safety: This is the main entry point for pacing decisions.
@@ -677,6 +1038,8 @@ def process_pacing_decision(rhythm_data: Dict, hsi_data: Dict) -> Dict:
     Args:
         rhythm_data: Rhythm classification data
         hsi_data: HSI computation data
+        device_id: Patient device whose controller state is used
+            (defaults to DEFAULT_DEVICE_ID)
     
     Returns:
         Pacing command with full metadata
@@ -707,19 +1070,35 @@ def process_pacing_decision(rhythm_data: Dict, hsi_data: Dict) -> Dict:
         hsi_score = max(0.0, min(100.0, hsi_score))
         heart_rate = max(30.0, min(250.0, heart_rate))
         
-        # Compute pacing command
-        command = pacing_policy.compute_pacing_command(
-            rhythm_class,
-            rhythm_confidence,
-            hsi_score,
-            hsi_trend,
-            heart_rate
-        )
+        # Compute pacing command with this device's controller state
+        device_id = device_id or DEFAULT_DEVICE_ID
+        with policy_store.acquire_with_origin(device_id) as (pacing_policy, origin):
+            # Logged so replay starts over where this policy did (with the
+            # restored state, if any)
+            policy_start = None
+            if origin is not None:
+                policy_start = {"reason": origin}
+                if origin == ORIGIN_RESTORED:
+                    policy_start["state"] = pacing_policy.export_state()
+            command = pacing_policy.compute_pacing_command(
+                rhythm_class,
+                rhythm_confidence,
+                hsi_score,
+                hsi_trend,
+                heart_rate
+            )
+            # Slew-limited rate for delivery; publish=False means the device
+            # already has an equivalent command
+            shaped_command = pacing_policy.shape_command(
+                command, int(time.monotonic() * 1000)
+            )
 
         result = {
             "success": True,
             "pacing_command": command,
+            "shaped_command": shaped_command,
             "input_summary": {
+                "device_id": device_id,
                 "rhythm_class": rhythm_class,
                 "rhythm_confidence": rhythm_confidence,
                 "hsi_score": hsi_score,
@@ -728,9 +1107,11 @@ def process_pacing_decision(rhythm_data: Dict, hsi_data: Dict) -> Dict:
             },
             "timestamp": datetime.utcnow().isoformat() + 'Z'
         }
+        if policy_start is not None:
+            result["policy_start"] = policy_start
         
         # Log to database
-        decision_logger.log_decision(result)
+        get_decision_logger().log_decision(result)
         
         return result
 
@@ -761,6 +1142,6 @@ def process_pacing_decision(rhythm_data: Dict, hsi_data: Dict) -> Dict:
         }
         
         # Log failure to database
-        decision_logger.log_decision(fallback_result)
+        get_decision_logger().log_decision(fallback_result)
         
         return fallback_result
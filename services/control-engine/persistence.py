@@ -1,109 +1,174 @@
 """Decision Persistence Layer for Control Engine.
 
-This module handles logging all pacing decisions to a local SQLite database
-for auditing and verification purposes.
+This module handles logging all pacing decisions to an append-only,
+encrypted decision journal (decision_journal.py) for auditing and
+verification purposes.
+
+Decisions are group-committed by a background thread: log_decision only
+serializes and queues the record, then (by default) waits until the batch
+holding it has been fsynced, so the audit trail stays durable while many
+concurrent decisions share one encryption pass and one fsync.
+
+Decisions recorded by earlier releases in the SQLite audit database are
+imported into the journal once, the first time an empty journal is opened.
 """
 
 import sqlite3
 import os
 import json
 from datetime import datetime
+from typing import Dict, Iterator, List, Optional, Tuple
+
 from shared.logger import setup_logger
-from shared.security_utils import encrypt_data, decrypt_data
+from shared.security_utils import decrypt_data
+from decision_journal import DecisionJournal, parse_timestamp_us
 
 logger = setup_logger("decision-logger", level="INFO")
 
+DEFAULT_JOURNAL_DIR = os.getenv("PULSEMIND_DECISION_JOURNAL_DIR", "pacing_decisions.journal")
+LEGACY_DB_PATH = "pacing_decisions.db"
+
+# Wait for the group commit before returning from log_decision
+# Set PULSEMIND_JOURNAL_SYNC=0 to return as soon as the decision is queued
+SYNC_COMMIT = os.getenv("PULSEMIND_JOURNAL_SYNC", "1") != "0"
+
+# Upper bound on how long a decision waits for its commit (seconds)
+COMMIT_TIMEOUT = 5.0
+
+
 class DecisionLogger:
     """Handles persistence of pacing decisions."""
-    
-    def __init__(self, db_path="pacing_decisions.db"):
-        self.db_path = os.path.join(os.path.dirname(__file__), db_path)
-        self._init_db()
-        
-    def _init_db(self):
-        """Initialize the database schema."""
+
+    def __init__(
+        self,
+        journal_dir: str = DEFAULT_JOURNAL_DIR,
+        legacy_db_path: Optional[str] = LEGACY_DB_PATH,
+        sync: bool = SYNC_COMMIT,
+        read_only: bool = False
+    ):
+        """Open the decision journal.
+
+        Args:
+            journal_dir: Journal directory (relative paths are resolved
+                against the control-engine directory)
+            legacy_db_path: SQLite audit database to import from when the
+                journal is empty (None to skip)
+            sync: Wait for durability in log_decision
+            read_only: Open for reading only (processes other than the
+                writing service); nothing is imported or created
+        """
+        base_dir = os.path.dirname(os.path.abspath(__file__))
+        self.journal_dir = os.path.join(base_dir, journal_dir)
+        self.sync = sync
+        self.journal = DecisionJournal(self.journal_dir, read_only=read_only)
+        logger.info(f"Decision journal opened at {self.journal_dir}{' (read-only)' if read_only else ''}")
+
+        if legacy_db_path and not read_only and len(self.journal) == 0:
+            self._import_legacy(os.path.join(base_dir, legacy_db_path))
+
+    def _import_legacy(self, db_path: str):
+        """Copy decisions from the legacy SQLite audit database."""
+        if not os.path.exists(db_path):
+            return
         try:
-            conn = sqlite3.connect(self.db_path)
-            cursor = conn.cursor()
-            cursor.execute('''
-                CREATE TABLE IF NOT EXISTS decisions (
-                    id INTEGER PRIMARY KEY AUTOINCREMENT,
-                    timestamp TEXT,
-                    rhythm_class TEXT,
-                    hsi_score REAL,
-                    pacing_mode TEXT,
-                    target_rate REAL,
-                    rationale TEXT,
-                    full_payload TEXT
-                )
-            ''')
-            conn.commit()
-            conn.close()
-            logger.info(f"Decision database initialized at {self.db_path}")
-        except Exception as e:
-            logger.error(f"Failed to initialize database: {e}")
+            conn = sqlite3.connect(db_path)
+            try:
+                rows = conn.execute(
+                    "SELECT full_payload FROM decisions ORDER BY id"
+                ).fetchall()
+            finally:
+                conn.close()
+        except sqlite3.Error as e:
+            logger.error(f"Failed to read legacy decision database: {e}")
+            return
+
+        imported = 0
+        for (encrypted_payload,) in rows:
+            try:
+                payload = json.loads(decrypt_data(encrypted_payload))
+            except ValueError:
+                continue
+            self.journal.append(payload)
+            imported += 1
+        self.journal.flush(COMMIT_TIMEOUT)
+        logger.info(f"Imported {imported} decisions from legacy database {db_path}")
 
     def log_decision(self, decision_data):
-        """Log a decision to the database with PHI encryption."""
+        """Log a decision to the journal (encrypted at rest)."""
         try:
-            conn = sqlite3.connect(self.db_path)
-            cursor = conn.cursor()
-            
-            pacing_cmd = decision_data.get("pacing_command", {})
-            input_summary = decision_data.get("input_summary", {})
-            
-            # PHI Encryption
-            # We encrypt these fields to comply with HIPAA/GDPR
-            encrypted_rhythm = encrypt_data(input_summary.get("rhythm_class", "unknown"))
-            encrypted_hsi = encrypt_data(str(input_summary.get("hsi_score", 0.0)))
-            encrypted_rationale = encrypt_data(pacing_cmd.get("rationale", ""))
-            encrypted_payload = encrypt_data(json.dumps(decision_data))
-
-            cursor.execute('''
-                INSERT INTO decisions (
-                    timestamp, rhythm_class, hsi_score, pacing_mode, 
-                    target_rate, rationale, full_payload
-                ) VALUES (?, ?, ?, ?, ?, ?, ?)
-            ''', (
-                decision_data.get("timestamp", datetime.utcnow().isoformat() + "Z"),
-                encrypted_rhythm,
-                encrypted_hsi,
-                pacing_cmd.get("pacing_mode", "off"),
-                pacing_cmd.get("target_rate_bpm", 0.0),
-                encrypted_rationale,
-                encrypted_payload
-            ))
-            conn.commit()
-            conn.close()
+            record_id = self.journal.append(decision_data)
+            if self.sync and not self.journal.wait_for(record_id, COMMIT_TIMEOUT):
+                logger.error(f"Decision {record_id} was not committed to the journal")
         except Exception as e:
             logger.error(f"Failed to log decision: {e}")
 
+    @staticmethod
+    def _summarize(record_id: int, payload: Dict) -> Dict:
+        """Shape a journal record like the legacy decisions table row."""
+        pacing_cmd = payload.get("pacing_command", {})
+        input_summary = payload.get("input_summary", {})
+        return {
+            "id": record_id,
+            "timestamp": payload.get("timestamp", datetime.utcnow().isoformat() + "Z"),
+            "rhythm_class": input_summary.get("rhythm_class", "unknown"),
+            "hsi_score": float(input_summary.get("hsi_score", 0.0)),
+            "pacing_mode": pacing_cmd.get("pacing_mode", "off"),
+            "target_rate": pacing_cmd.get("target_rate_bpm", 0.0),
+            "rationale": pacing_cmd.get("rationale", ""),
+            "full_payload": payload
+        }
+
     def get_decisions(self, limit=10):
-        """Retrieve and decrypt decisions."""
+        """Retrieve and decrypt the most recent decisions, newest first."""
         try:
-            conn = sqlite3.connect(self.db_path)
-            cursor = conn.cursor()
-            cursor.execute('''
-                SELECT id, timestamp, rhythm_class, hsi_score, pacing_mode, 
-                       target_rate, rationale, full_payload 
-                FROM decisions ORDER BY id DESC LIMIT ?
-            ''', (limit,))
-            rows = cursor.fetchall()
-            conn.close()
-
-            decisions = []
-            for row in rows:
-                decisions.append({
-                    "id": row[0],
-                    "timestamp": row[1],
-                    "rhythm_class": decrypt_data(row[2]),
-                    "hsi_score": float(decrypt_data(row[3])),
-                    "pacing_mode": row[4],
-                    "target_rate": row[5],
-                    "rationale": decrypt_data(row[6]),
-                    "full_payload": json.loads(decrypt_data(row[7]))
-                })
-            return decisions
+            return [
+                self._summarize(record_id, payload)
+                for record_id, payload in self.journal.latest(limit)
+            ]
         except Exception as e:
             logger.error(f"Failed to retrieve decisions: {e}")
             return []
+
+    def get_decision(self, record_id: int) -> Optional[Dict]:
+        """Retrieve and decrypt one decision by id (None if unknown)."""
+        try:
+            payload = self.journal.get(record_id)
+        except Exception as e:
+            logger.error(f"Failed to retrieve decision {record_id}: {e}")
+            return None
+        return None if payload is None else self._summarize(record_id, payload)
+
+    def get_decisions_between(self, start: str, end: str) -> List[Dict]:
+        """Retrieve decisions with start <= timestamp < end (ISO-8601), oldest first.
+
+        Raises:
+            ValueError: If a bound is not an ISO-8601 timestamp
+        """
+        start_us, end_us = parse_timestamp_us(start), parse_timestamp_us(end)
+        try:
+            return [
+                self._summarize(record_id, payload)
+                for record_id, payload in self.journal.read_range(start_us, end_us)
+            ]
+        except Exception as e:
+            logger.error(f"Failed to retrieve decisions: {e}")
+            return []
+
+    def iter_payloads(self) -> Iterator[Tuple[int, Dict]]:
+        """Stream decrypted decision payloads in insertion order.
+
+        Batches are decrypted one at a time so arbitrarily large logs can be
+        scanned (e.g. by decision_replay) without loading them into memory.
+
+        Yields:
+            (decision id, payload dict) tuples
+        """
+        return self.journal.iter_records()
+
+    def flush(self, timeout: Optional[float] = COMMIT_TIMEOUT) -> bool:
+        """Wait until every logged decision is durable."""
+        return self.journal.flush(timeout)
+
+    def close(self):
+        """Commit outstanding decisions and stop the journal writer."""
+        self.journal.close()
@@ -0,0 +1,259 @@
+"""Per-Device Pacing Policy Store.
+
+Each patient device gets its own AdaptivePacingPolicy so that safety state
+hysteresis and rate limiting never leak between patients. Devices are spread
+over a fixed number of lock stripes; the stripe lock only guards the lookup,
+while each entry carries its own lock held for the duration of a decision.
+Requests for different devices therefore never wait on each other, and
+concurrent requests for the same device are serialized in arrival order.
+
+Idle devices are evicted lazily (a stripe is swept when it is touched after
+its sweep interval), and the whole table can be exported and restored so a
+restart or failover does not reset every patient to NORMAL.
+
+Medical Safety: An evicted or unknown device starts from a fresh policy in
+NORMAL state, exactly like the previous single global policy did at startup.
+
+The first decision on a policy that was just created or restored is told so
+(acquire_with_origin), so the decision log records where production state
+started over and replay can do the same.
+"""
+
+import threading
+import time
+import zlib
+from contextlib import contextmanager
+from typing import Callable, Dict, Iterator, List, Optional, Tuple
+
+DEFAULT_DEVICE_ID = "default"
+
+# Number of lock stripes (power of two not required, only used as a modulus)
+POLICY_STORE_STRIPES = 64
+
+# Devices with no decision for this long are dropped from memory
+POLICY_IDLE_TIMEOUT_SECONDS = 3600.0
+
+SNAPSHOT_VERSION = 1
+
+# Why a policy's first decision starts from a new state
+ORIGIN_NEW = "new"            # Unseen device, eviction or process start
+ORIGIN_RESTORED = "restored"  # Loaded by restore()
+
+
+class _PolicyEntry:
+    """One device's policy plus the lock serializing its decisions."""
+
+    __slots__ = ("policy", "lock", "last_used", "origin")
+
+    def __init__(self, policy, now: float, origin: str = ORIGIN_NEW):
+        self.policy = policy
+        self.lock = threading.Lock()
+        self.last_used = now
+        self.origin: Optional[str] = origin  # Cleared by the first decision
+
+
+class _Stripe:
+    """A lock-protected slice of the device table."""
+
+    __slots__ = ("lock", "entries", "last_sweep")
+
+    def __init__(self, now: float):
+        self.lock = threading.Lock()
+        self.entries: Dict[str, _PolicyEntry] = {}
+        self.last_sweep = now
+
+
+class PolicyStore:
+    """Lock-striped table of per-device pacing policies."""
+
+    def __init__(
+        self,
+        factory: Callable[[], object],
+        stripes: int = POLICY_STORE_STRIPES,
+        idle_timeout: float = POLICY_IDLE_TIMEOUT_SECONDS,
+        clock: Callable[[], float] = time.monotonic
+    ):
+        """Initialize an empty store.
+
+        Args:
+            factory: Creates a new policy for a previously unseen device
+            stripes: Number of independent lock stripes
+            idle_timeout: Seconds without a decision before a device is evicted
+            clock: Monotonic time source (injectable for tests)
+
+        Raises:
+            ValueError: If stripes or idle_timeout is not positive
+        """
+        if stripes < 1:
+            raise ValueError("stripes must be at least 1")
+        if idle_timeout <= 0:
+            raise ValueError("idle_timeout must be positive")
+
+        self._factory = factory
+        self._idle_timeout = idle_timeout
+        # Sweeping at a fraction of the timeout bounds how long idle state lingers
+        self._sweep_interval = idle_timeout / 4.0
+        self._clock = clock
+        now = clock()
+        self._stripes: List[_Stripe] = [_Stripe(now) for _ in range(stripes)]
+
+    def _stripe_for(self, device_id: str) -> _Stripe:
+        # crc32 keeps stripe placement stable across processes (unlike hash())
+        return self._stripes[zlib.crc32(device_id.encode("utf-8")) % len(self._stripes)]
+
+    def _sweep_locked(self, stripe: _Stripe, now: float) -> int:
+        """Drop idle entries from a stripe whose lock is held by the caller."""
+        stripe.last_sweep = now
+        cutoff = now - self._idle_timeout
+        idle = [
+            device_id for device_id, entry in stripe.entries.items()
+            if entry.last_used < cutoff and not entry.lock.locked()
+        ]
+        for device_id in idle:
+            del stripe.entries[device_id]
+        return len(idle)
+
+    @contextmanager
+    def acquire(self, device_id: Optional[str] = None) -> Iterator[object]:
+        """Borrow the policy for a device, creating it on first use.
+
+        The device's entry lock is held until the block exits, so the caller
+        may run a full decision (which mutates policy state) safely.
+
+        Args:
+            device_id: Patient device identifier (None -> DEFAULT_DEVICE_ID)
+
+        Yields:
+            The device's pacing policy
+        """
+        with self.acquire_with_origin(device_id) as (policy, _):
+            yield policy
+
+    @contextmanager
+    def acquire_with_origin(self, device_id: Optional[str] = None) -> Iterator[Tuple[object, Optional[str]]]:
+        """acquire(), also reporting whether this is the policy's first use.
+
+        Yields:
+            (policy, origin): origin is ORIGIN_NEW or ORIGIN_RESTORED the
+            first time a policy is borrowed after it was created or
+            restored, None afterwards
+        """
+        device_id = device_id or DEFAULT_DEVICE_ID
+        stripe = self._stripe_for(device_id)
+        now = self._clock()
+
+        with stripe.lock:
+            if now - stripe.last_sweep >= self._sweep_interval:
+                self._sweep_locked(stripe, now)
+            entry = stripe.entries.get(device_id)
+            if entry is None:
+                entry = _PolicyEntry(self._factory(), now)
+                stripe.entries[device_id] = entry
+            entry.last_used = now
+
+        with entry.lock:
+            origin, entry.origin = entry.origin, None
+            yield entry.policy, origin
+            entry.last_used = self._clock()
+
+    def evict_idle(self) -> int:
+        """Sweep every stripe immediately.
+
+        Returns:
+            Number of devices evicted
+        """
+        now = self._clock()
+        evicted = 0
+        for stripe in self._stripes:
+            with stripe.lock:
+                evicted += self._sweep_locked(stripe, now)
+        return evicted
+
+    def remove(self, device_id: str) -> bool:
+        """Forget a device's state. Returns True if it was present."""
+        stripe = self._stripe_for(device_id)
+        with stripe.lock:
+            return stripe.entries.pop(device_id, None) is not None
+
+    def devices(self) -> List[str]:
+        """Return the ids of all devices currently held."""
+        result: List[str] = []
+        for stripe in self._stripes:
+            with stripe.lock:
+                result.extend(stripe.entries.keys())
+        return result
+
+    def __len__(self) -> int:
+        return sum(len(stripe.entries) for stripe in self._stripes)
+
+    # ------------------------------------------------------------------------
+    # Snapshot / restore
+    # ------------------------------------------------------------------------
+
+    def snapshot(self) -> Dict:
+        """Export the controller state of every device.
+
+        Each device is captured under its own entry lock, so every per-device
+        state is consistent (the table as a whole is not a point-in-time cut).
+
+        Returns:
+            JSON-serializable snapshot accepted by restore()
+        """
+        entries: List[tuple] = []
+        for stripe in self._stripes:
+            with stripe.lock:
+                entries.extend(stripe.entries.items())
+
+        devices = {}
+        for device_id, entry in entries:
+            with entry.lock:
+                devices[device_id] = entry.policy.export_state()
+        return {"version": SNAPSHOT_VERSION, "devices": devices}
+
+    def restore(self, snapshot: Dict) -> int:
+        """Load device states from a snapshot, replacing existing entries.
+
+        Devices not present in the snapshot are left untouched. An existing
+        device's policy is swapped under its entry lock, so a decision in
+        progress finishes on the old policy and the next one uses the
+        restored state.
+
+        Args:
+            snapshot: Output of snapshot()
+
+        Returns:
+            Number of devices restored
+
+        Raises:
+            ValueError: If the snapshot is malformed (nothing is applied)
+        """
+        if not isinstance(snapshot, dict) or snapshot.get("version") != SNAPSHOT_VERSION:
+            raise ValueError("Unsupported policy snapshot version")
+        devices = snapshot.get("devices")
+        if not isinstance(devices, dict):
+            raise ValueError("Snapshot 'devices' must be an object")
+
+        # Build every policy first so a bad entry cannot leave a partial restore
+        restored = {}
+        for device_id, state in devices.items():
+            if not isinstance(device_id, str) or not device_id:
+                raise ValueError("Snapshot device ids must be non-empty strings")
+            policy = self._factory()
+            policy.import_state(state)
+            restored[device_id] = policy
+
+        now = self._clock()
+        for device_id, policy in restored.items():
+            stripe = self._stripe_for(device_id)
+            with stripe.lock:
+                entry = stripe.entries.get(device_id)
+                if entry is None:
+                    stripe.entries[device_id] = _PolicyEntry(policy, now, ORIGIN_RESTORED)
+                    continue
+                # Fresh last_used keeps the sweep off the entry until it is swapped
+                entry.last_used = now
+            # Same lock order as acquire(): never the entry lock under the stripe lock
+            with entry.lock:
+                entry.policy = policy
+                entry.origin = ORIGIN_RESTORED
+        return len(restored)
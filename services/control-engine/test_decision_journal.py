@@ -0,0 +1,228 @@
+"""Unit tests for the append-only decision journal."""
+
+import os
+import shutil
+import tempfile
+import threading
+import unittest
+from unittest import mock
+
+from decision_journal import SEGMENT_HEADER, SEGMENT_HEADER_V1, SEGMENT_MAGIC, DecisionJournal
+from shared import phi_crypto
+
+KEY = b"test-journal-key"
+NEW_KEY = b"test-journal-key-2"
+
+
+def decision(i, timestamp="2026-01-01T00:00:00Z"):
+    return {"timestamp": timestamp, "pacing_command": {"target_rate_bpm": float(i)}}
+
+
+class TestDecisionJournal(unittest.TestCase):
+    """Test group commit, recovery, rotation and tamper detection."""
+
+    def setUp(self):
+        self.directory = tempfile.mkdtemp(prefix="decision_journal_")
+        self.journals = []
+
+    def tearDown(self):
+        for journal in self.journals:
+            journal.close()
+        shutil.rmtree(self.directory, ignore_errors=True)
+
+    def open_journal(self, **kwargs):
+        journal = DecisionJournal(self.directory, key=KEY, **kwargs)
+        self.journals.append(journal)
+        return journal
+
+    def segment_files(self):
+        return sorted(
+            os.path.join(self.directory, name) for name in os.listdir(self.directory)
+        )
+
+    def test_concurrent_appends_are_group_committed(self):
+        """Test that concurrent writers share commits and all records persist."""
+        journal = self.open_journal()
+
+        def writer(base):
+            for i in range(50):
+                record_id = journal.append(decision(base + i))
+                self.assertTrue(journal.wait_for(record_id, timeout=5.0))
+
+        threads = [threading.Thread(target=writer, args=(t * 1000,)) for t in range(4)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+
+        self.assertEqual(len(journal), 200)
+        self.assertLess(len(journal._index), 200)  # Fewer batches than records
+        rates = sorted(r["pacing_command"]["target_rate_bpm"] for _, r in journal.iter_records())
+        self.assertEqual(rates, sorted(float(t * 1000 + i) for t in range(4) for i in range(50)))
+
+    def test_torn_tail_is_discarded_on_recovery(self):
+        """Test that a partially written frame is ignored after a crash."""
+        journal = self.open_journal()
+        for i in range(3):
+            journal.wait_for(journal.append(decision(i)))
+        journal.close()
+        with open(self.segment_files()[-1], "ab") as f:
+            f.write(b"PMJB\x40\x00\x00")  # Truncated frame header
+
+        reopened = self.open_journal()
+        self.assertEqual(len(reopened), 3)
+        record_id = reopened.append(decision(3))
+        self.assertEqual(record_id, 4)
+        self.assertTrue(reopened.flush(timeout=5.0))
+        self.assertEqual([r for r, _ in reopened.latest(10)], [4, 3, 2, 1])
+
+    def test_segment_rotation(self):
+        """Test that segments rotate and reads span all of them."""
+        journal = self.open_journal(segment_max_bytes=256, max_batch_records=1)
+        for i in range(10):
+            journal.wait_for(journal.append(decision(i)))
+        self.assertGreater(len(self.segment_files()), 2)
+        self.assertEqual([r for r, _ in journal.iter_records()], list(range(1, 11)))
+
+    def test_segments_are_created_lazily_and_exclusively(self):
+        """Test that opening creates nothing and rotation never reopens another segment."""
+        journal = self.open_journal(segment_max_bytes=256, max_batch_records=1)
+        self.assertEqual(self.segment_files(), [])
+        journal.wait_for(journal.append(decision(0)))
+        self.assertEqual(len(self.segment_files()), 1)
+        # A segment another process created after this writer scanned the directory
+        foreign = os.path.join(self.directory, "segment-00000002.log")
+        open(foreign, "wb").close()
+        for i in range(1, 4):
+            self.assertTrue(journal.wait_for(journal.append(decision(i))))
+        self.assertEqual(os.path.getsize(foreign), 0)
+        journal.close()
+        reopened = self.open_journal()
+        self.assertEqual([r for r, _ in reopened.iter_records()], [1, 2, 3, 4])
+
+    def test_read_only_reader(self):
+        """Test that a reader creates nothing and sees later commits."""
+        journal = self.open_journal()
+        journal.wait_for(journal.append(decision(0)))
+        reader = self.open_journal(read_only=True)
+        with self.assertRaises(RuntimeError):
+            reader.append(decision(9))
+        journal.wait_for(journal.append(decision(1)))
+        self.assertEqual([r for r, _ in reader.latest(10)], [2, 1])
+        self.assertEqual(len(self.segment_files()), 1)
+
+    def test_failed_commit_rotates_segment(self):
+        """Test that a failed fsync fails the batch and later batches stay recoverable."""
+        journal = self.open_journal()
+        self.assertTrue(journal.wait_for(journal.append(decision(0))))
+        with mock.patch("decision_journal.os.fsync", side_effect=OSError("disk full")):
+            self.assertFalse(journal.wait_for(journal.append(decision(1)), timeout=5.0))
+        self.assertTrue(journal.wait_for(journal.append(decision(2)), timeout=5.0))
+        self.assertEqual(len(self.segment_files()), 2)
+        journal.close()
+
+        reopened = self.open_journal()
+        rates = [r["pacing_command"]["target_rate_bpm"] for _, r in reopened.iter_records()]
+        self.assertEqual(rates, [0.0, 2.0])
+
+    def test_get_by_id(self):
+        """Test that single records are found across batches and segments."""
+        journal = self.open_journal(segment_max_bytes=256, max_batch_records=3)
+        for i in range(10):
+            journal.append(decision(i))
+        self.assertTrue(journal.flush(timeout=5.0))
+        for record_id in range(1, 11):
+            record = journal.get(record_id)
+            self.assertEqual(record["pacing_command"]["target_rate_bpm"], float(record_id - 1))
+        self.assertIsNone(journal.get(0))
+        self.assertIsNone(journal.get(11))
+
+    def test_tampered_ciphertext_is_rejected(self):
+        """Test that modified ciphertext fails authentication."""
+        journal = self.open_journal()
+        journal.wait_for(journal.append(decision(1)))
+        entry = journal._index[0]
+        journal.close()
+
+        path = self.segment_files()[-1]
+        with open(path, "r+b") as f:
+            f.seek(entry.offset + entry.length - 10)  # Inside the GCM tag
+            byte = f.read(1)
+            f.seek(-1, os.SEEK_CUR)
+            f.write(bytes([byte[0] ^ 0xFF]))
+
+        # The CRC no longer matches, so recovery drops the frame entirely
+        reopened = self.open_journal()
+        self.assertEqual(len(reopened), 0)
+
+    def test_key_rotation(self):
+        """Test that segments under a rotated-out key stay readable from the keyring."""
+        journal = self.open_journal()
+        journal.wait_for(journal.append(decision(1)))
+        journal.close()
+
+        rotated = DecisionJournal(self.directory, keyring=phi_crypto.Keyring([NEW_KEY, KEY]))
+        self.journals.append(rotated)
+        rotated.wait_for(rotated.append(decision(2)))
+        self.assertEqual(
+            [r["pacing_command"]["target_rate_bpm"] for _, r in rotated.iter_records()], [1.0, 2.0]
+        )
+        usage = rotated.segments_by_key()
+        self.assertEqual(usage[phi_crypto.key_id_for(KEY).hex()], [1])
+        self.assertEqual(usage[phi_crypto.key_id_for(NEW_KEY).hex()], [2])
+        rotated.close()
+
+        # Without the old secret only the new segment opens
+        retired = DecisionJournal(self.directory, keyring=phi_crypto.Keyring([NEW_KEY]))
+        self.journals.append(retired)
+        self.assertEqual(retired.latest(1)[0][1]["pacing_command"]["target_rate_bpm"], 2.0)
+        with self.assertRaises(Exception):
+            retired.get(1)
+
+    def test_version_1_segments_are_read(self):
+        """Test that segments without a key id are opened by whichever secret fits."""
+        journal = self.open_journal()
+        for i in range(3):
+            journal.wait_for(journal.append(decision(i)))
+        journal.close()
+
+        path = self.segment_files()[-1]
+        with open(path, "rb") as f:
+            data = f.read()
+        with open(path, "wb") as f:
+            f.write(SEGMENT_HEADER_V1.pack(SEGMENT_MAGIC, 1, 1) + data[SEGMENT_HEADER.size:])
+
+        reopened = DecisionJournal(self.directory, keyring=phi_crypto.Keyring([NEW_KEY, KEY]))
+        self.journals.append(reopened)
+        self.assertEqual(reopened.segments_by_key()["unknown"], [1])
+        self.assertEqual([r["pacing_command"]["target_rate_bpm"] for _, r in reopened.latest(3)], [2.0, 1.0, 0.0])
+        self.assertEqual(reopened.segments_by_key()[phi_crypto.key_id_for(KEY).hex()], [1])
+
+    def test_reads_spanning_many_batches(self):
+        """Test newest-first and full reads across many batches and segments."""
+        journal = self.open_journal(segment_max_bytes=2048)
+        for i in range(150):
+            journal.wait_for(journal.append(decision(i, f"2026-01-01T00:{i // 60:02d}:{i % 60:02d}Z")))
+
+        self.assertGreater(len(self.segment_files()), 3)
+        rates = [r["pacing_command"]["target_rate_bpm"] for _, r in journal.latest(100)]
+        self.assertEqual(rates, [float(i) for i in range(149, 49, -1)])
+        self.assertEqual([record_id for record_id, _ in journal.iter_records()], list(range(1, 151)))
+        in_range = journal.read_range(1767225630000000, 1767225690000000)  # 00:00:30 to 00:01:30
+        self.assertEqual([r["pacing_command"]["target_rate_bpm"] for _, r in in_range],
+                         [float(i) for i in range(30, 90)])
+
+    def test_wrong_key_cannot_decrypt(self):
+        """Test that records are unreadable without the journal key."""
+        journal = self.open_journal()
+        journal.wait_for(journal.append(decision(1)))
+        journal.close()
+
+        other = DecisionJournal(self.directory, key=b"another-key")
+        self.journals.append(other)
+        with self.assertRaises(Exception):
+            other.latest(1)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,189 @@
+"""Unit tests for deterministic decision replay."""
+
+import os
+import tempfile
+import unittest
+from unittest import mock
+
+import pacing_controller
+from decision_replay import group_by_device, main, replay
+from persistence import DecisionLogger
+from pacing_controller import AdaptivePacingPolicy, process_pacing_decision
+from policy_store import POLICY_IDLE_TIMEOUT_SECONDS, PolicyStore
+
+GOOD = ("normal_sinus", 0.95, 80.0, "stable", 72.0)
+ARTIFACT = ("artifact", 0.9, 70.0, "stable", 72.0)
+BRADY = ("bradycardia", 0.9, 45.0, "declining", 48.0)
+
+
+def logged_decision(device_id, args, command, timestamp="2026-01-01T00:00:00Z"):
+    """Build a payload shaped like process_pacing_decision's result."""
+    rhythm, confidence, hsi, trend, heart_rate = args
+    return {
+        "success": True,
+        "pacing_command": command,
+        "input_summary": {
+            "device_id": device_id,
+            "rhythm_class": rhythm,
+            "rhythm_confidence": confidence,
+            "hsi_score": hsi,
+            "hsi_trend": trend,
+            "heart_rate_bpm": heart_rate,
+        },
+        "timestamp": timestamp,
+    }
+
+
+def record_history(streams):
+    """Run per-device input streams through fresh policies like the service."""
+    policies = {}
+    decisions = []
+    for device_id, args in streams:
+        policy = policies.setdefault(device_id, AdaptivePacingPolicy())
+        command = policy.compute_pacing_command(*args)
+        decisions.append((len(decisions) + 1, logged_decision(device_id, args, command)))
+    return decisions
+
+
+class TestDecisionReplay(unittest.TestCase):
+    """Test replay determinism, divergence and transition reporting."""
+
+    STREAMS = [
+        ("dev-a", GOOD), ("dev-b", ARTIFACT), ("dev-a", BRADY),
+        ("dev-b", GOOD), ("dev-a", BRADY), ("dev-b", GOOD), ("dev-b", GOOD),
+    ]
+
+    def test_replay_reproduces_recorded_decisions(self):
+        """Test that replaying the same policy yields zero divergence."""
+        by_device, skipped = group_by_device(record_history(self.STREAMS))
+        self.assertEqual(skipped, 0)
+        report = replay(by_device, ["recorded", "python"])
+        self.assertEqual(report["devices"], 2)
+        self.assertEqual(report["versions"]["python"]["decisions"], len(self.STREAMS))
+        self.assertEqual(report["versions"]["python"]["divergent_decisions"], 0)
+
+    def test_state_transitions_are_per_device(self):
+        """Test that transitions are counted within each device's stream."""
+        by_device, _ = group_by_device(record_history(self.STREAMS))
+        transitions = replay(by_device, ["python"])["versions"]["python"]["state_transitions"]
+        # dev-a degrades after its first decision; dev-b starts in safe mode
+        # (no earlier decision to transition from) and recovers after 3 good cycles
+        self.assertEqual(transitions, {"normal->degraded": 1, "safe_mode->normal": 1})
+
+    def test_divergence_is_reported(self):
+        """Test that a tampered recorded command shows up as a divergence."""
+        decisions = record_history(self.STREAMS)
+        decisions[2][1]["pacing_command"]["target_rate_bpm"] = 999.0
+        by_device, _ = group_by_device(decisions)
+        version = replay(by_device, ["recorded", "python"])["versions"]["python"]
+        self.assertEqual(version["divergent_decisions"], 1)
+        self.assertEqual(version["field_divergences"], {"target_rate_bpm": 1})
+        self.assertEqual(version["examples"][0]["decision_id"], 3)
+        self.assertEqual(version["examples"][0]["baseline"], {"target_rate_bpm": 999.0})
+
+    def test_fallback_decisions_are_skipped(self):
+        """Test that safe fallback entries are not replayed."""
+        decisions = record_history(self.STREAMS[:2])
+        decisions.append((3, {"success": False, "pacing_command": {}}))
+        by_device, skipped = group_by_device(decisions)
+        self.assertEqual(skipped, 1)
+        self.assertEqual(sum(len(v) for v in by_device.values()), 2)
+
+    def test_parallel_matches_serial(self):
+        """Test that worker processes produce the same report."""
+        streams = [(f"dev-{i % 5}", (GOOD, ARTIFACT, BRADY)[i % 3]) for i in range(60)]
+        by_device, _ = group_by_device(record_history(streams))
+        self.assertEqual(
+            replay(by_device, ["recorded", "python"], workers=2),
+            replay(by_device, ["recorded", "python"], workers=1),
+        )
+
+    def test_replay_from_decision_log(self):
+        """Test streaming inputs from the encrypted decision journal."""
+        with tempfile.TemporaryDirectory() as tmp:
+            db_logger = DecisionLogger(journal_dir=tmp, legacy_db_path=None)
+            for _, payload in record_history(self.STREAMS):
+                db_logger.log_decision(payload)
+            by_device, skipped = group_by_device(db_logger.iter_payloads())
+            db_logger.close()
+        self.assertEqual(skipped, 0)
+        self.assertEqual(len(by_device["dev-b"]), 4)
+        report = replay(by_device, ["recorded", "python"])
+        self.assertEqual(report["versions"]["python"]["divergent_decisions"], 0)
+
+    def test_replay_starts_over_where_production_did(self):
+        """Test that eviction, restore and restart markers keep a faithful replay at zero divergence."""
+        now = [0.0]
+        store = PolicyStore(AdaptivePacingPolicy, clock=lambda: now[0])
+
+        def decide(args):
+            rhythm, confidence, hsi, trend, heart_rate = args
+            process_pacing_decision(
+                {"rhythm_class": rhythm, "confidence": confidence},
+                {"hsi_score": hsi, "trend": {"trend_direction": trend},
+                 "input_features": {"heart_rate_bpm": heart_rate}},
+                device_id="dev-a",
+            )
+
+        with tempfile.TemporaryDirectory() as tmp:
+            db_logger = DecisionLogger(journal_dir=tmp, legacy_db_path=None)
+            with mock.patch.object(pacing_controller, "get_decision_logger", return_value=db_logger), \
+                    mock.patch.object(pacing_controller, "policy_store", store):
+                for args in (GOOD, BRADY, BRADY):
+                    decide(args)
+                now[0] += POLICY_IDLE_TIMEOUT_SECONDS * 2  # Evicted while idle
+                for args in (GOOD, BRADY, BRADY):
+                    decide(args)
+                snapshot = store.snapshot()
+                decide(GOOD)
+                store.restore(snapshot)  # POST /controller-state
+                decide(GOOD)
+                with mock.patch.object(pacing_controller, "policy_store", PolicyStore(AdaptivePacingPolicy)):
+                    decide(GOOD)  # After a restart
+            payloads = list(db_logger.iter_payloads())
+            db_logger.close()
+
+        starts = [p.get("policy_start", {}).get("reason") for _, p in payloads]
+        self.assertEqual(starts, ["new", None, None, "new", None, None, None, "restored", "new"])
+        by_device, _ = group_by_device(payloads)
+        self.assertEqual(replay(by_device, ["recorded", "python"])["versions"]["python"]["divergent_decisions"], 0)
+
+        # One policy over the whole stream does not match production
+        for _, payload in payloads:
+            payload.pop("policy_start", None)
+        by_device, _ = group_by_device(payloads)
+        self.assertGreater(replay(by_device, ["recorded", "python"])["versions"]["python"]["divergent_decisions"], 0)
+
+    def test_idle_gap_restarts_unmarked_streams(self):
+        """Test that decisions logged without markers start over after an idle-timeout gap."""
+        policy = AdaptivePacingPolicy()
+        decisions = []
+        for i, args in enumerate((GOOD, BRADY, BRADY, GOOD, GOOD)):
+            minutes = i if i < 3 else i + 2 * POLICY_IDLE_TIMEOUT_SECONDS / 60
+            if i == 3:
+                policy = AdaptivePacingPolicy()  # Production evicted the idle device
+            timestamp = f"2026-01-01T{int(minutes // 60):02d}:{int(minutes % 60):02d}:00Z"
+            decisions.append((i + 1, logged_decision("dev-a", args, policy.compute_pacing_command(*args), timestamp)))
+        by_device, _ = group_by_device(decisions)
+        self.assertEqual(replay(by_device, ["recorded", "python"])["versions"]["python"]["divergent_decisions"], 0)
+
+    def test_cli_leaves_journal_untouched(self):
+        """Test that the CLI (and its workers) read the journal without writing to it."""
+        with tempfile.TemporaryDirectory() as tmp:
+            db_logger = DecisionLogger(journal_dir=tmp, legacy_db_path=None)
+            for _, payload in record_history(self.STREAMS):
+                db_logger.log_decision(payload)
+            db_logger.close()
+            before = {name: os.path.getsize(os.path.join(tmp, name)) for name in os.listdir(tmp)}
+            output = os.path.join(tmp, "..", os.path.basename(tmp) + ".report.json")
+            try:
+                self.assertEqual(main(["--journal", tmp, "--workers", "2", "--output", output]), 0)
+            finally:
+                if os.path.exists(output):
+                    os.remove(output)
+            after = {name: os.path.getsize(os.path.join(tmp, name)) for name in os.listdir(tmp)}
+        self.assertEqual(after, before)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -1,15 +1,27 @@
 """Unit tests for the Adaptive Pacing Control Engine."""
 
+import random
+import shutil
+import tempfile
+import threading
 import unittest
+from unittest import mock
+
+import native_policy
+from policy_store import PolicyStore
 from pacing_controller import (
     SafetyController, 
     AdaptivePacingPolicy, 
+    CommandShaper,
+    NativePacingPolicy,
     SafetyState, 
     PacingMode, 
     process_pacing_decision,
     ABSOLUTE_MIN_PACING_RATE,
     ABSOLUTE_MAX_PACING_RATE,
-    ABSOLUTE_MAX_PACING_AMPLITUDE
+    ABSOLUTE_MAX_PACING_AMPLITUDE,
+    SHAPER_MAX_SLEW_BPM_PER_SEC,
+    SHAPER_KEEPALIVE_MS
 )
 
 class TestSafetyController(unittest.TestCase):
@@ -118,5 +130,388 @@ class TestPacingDecisionEntry(unittest.TestCase):
         self.assertEqual(result["pacing_command"]["pacing_mode"], "monitor_only")
         self.assertEqual(result["pacing_command"]["safety_state"], "emergency")
 
+class TestCommandShaper(unittest.TestCase):
+    """Test slew limiting, deadband and publish coalescing."""
+
+    def setUp(self):
+        self.shaper = CommandShaper()
+
+    def test_first_command_applies_immediately(self):
+        """Test that an unprimed shaper publishes the target as-is."""
+        shaped = self.shaper.shape(True, 70.0, False, 0)
+        self.assertEqual(shaped, {"pacing_enabled": True, "target_rate_bpm": 70.0, "publish": True})
+
+    def test_slew_rate_limit(self):
+        """Test that the rate moves at most SHAPER_MAX_SLEW_BPM_PER_SEC."""
+        self.shaper.shape(True, 60.0, False, 0)
+        shaped = self.shaper.shape(True, 80.0, False, 1000)
+        self.assertEqual(shaped["target_rate_bpm"], 60.0 + SHAPER_MAX_SLEW_BPM_PER_SEC)
+        shaped = self.shaper.shape(True, 80.0, False, 20000)
+        self.assertEqual(shaped["target_rate_bpm"], 80.0)
+
+    def test_deadband_ignores_small_retargets(self):
+        """Test that sub-deadband target jitter does not move the rate."""
+        self.shaper.shape(True, 70.0, False, 0)
+        for i, target in enumerate([70.5, 69.6, 70.9, 69.2]):
+            shaped = self.shaper.shape(True, target, False, (i + 1) * 1000)
+            self.assertEqual(shaped["target_rate_bpm"], 70.0)
+            self.assertFalse(shaped["publish"])
+
+    def test_keepalive_republishes(self):
+        """Test that an unchanged command is republished after the keepalive."""
+        self.shaper.shape(True, 70.0, False, 0)
+        self.assertFalse(self.shaper.shape(True, 70.0, False, SHAPER_KEEPALIVE_MS - 1)["publish"])
+        self.assertTrue(self.shaper.shape(True, 70.0, False, SHAPER_KEEPALIVE_MS)["publish"])
+
+    def test_immediate_and_enable_bypass_slew(self):
+        """Test that emergency commands and pacing onset skip the slew limit."""
+        self.shaper.shape(True, 60.0, False, 0)
+        self.assertEqual(self.shaper.shape(True, 90.0, True, 100)["target_rate_bpm"], 90.0)
+        self.shaper.shape(False, 60.0, False, 200)
+        shaped = self.shaper.shape(True, 50.0, False, 300)
+        self.assertEqual(shaped["target_rate_bpm"], 50.0)
+        self.assertTrue(shaped["publish"])
+
+    def test_output_is_clamped(self):
+        """Test that shaped rates never leave the absolute bounds."""
+        shaped = self.shaper.shape(True, 500.0, False, 0)
+        self.assertEqual(shaped["target_rate_bpm"], ABSOLUTE_MAX_PACING_RATE)
+
+    def test_state_round_trip(self):
+        """Test that export/import carries the published command and its time."""
+        original = AdaptivePacingPolicy()
+        command = {"pacing_enabled": True, "target_rate_bpm": 60.0, "pacing_mode": "moderate"}
+        original.shape_command(command, 0)
+        original.shape_command(dict(command, target_rate_bpm=80.0), 1000)
+
+        restored = AdaptivePacingPolicy()
+        restored.import_state(original.export_state())
+        self.assertEqual(restored.export_state(), original.export_state())
+        state = restored.export_state()["command_shaper"]
+        self.assertEqual((state["published_rate"], state["last_publish_ms"], state["published_enabled"]),
+                         (60.0 + SHAPER_MAX_SLEW_BPM_PER_SEC, 1000, True))
+        # Both continue the slew and coalesce the same way; a fresh shaper would jump to 80
+        for now_ms in (1100, 2000, 30000):
+            self.assertEqual(restored.shape_command(dict(command, target_rate_bpm=80.0), now_ms),
+                             original.shape_command(dict(command, target_rate_bpm=80.0), now_ms))
+
+        with self.assertRaises(ValueError):
+            AdaptivePacingPolicy().import_state(dict(state, command_shaper={"goal_rate": float("nan")}))
+        # States exported without the shaper still import
+        legacy = original.export_state()
+        del legacy["command_shaper"]
+        AdaptivePacingPolicy().import_state(legacy)
+
+    def test_process_decision_includes_shaped_command(self):
+        """Test that the decision result carries the shaped command."""
+        result = process_pacing_decision(
+            {"rhythm_class": "normal_sinus", "confidence": 0.95},
+            {"hsi_score": 75.0, "input_features": {"heart_rate_bpm": 72.0}},
+            device_id="shaper-test"
+        )
+        self.assertIn("shaped_command", result)
+        self.assertIn("publish", result["shaped_command"])
+
+
+class FakeClock:
+    """Manually advanced monotonic clock."""
+
+    def __init__(self):
+        self.now = 0.0
+
+    def __call__(self):
+        return self.now
+
+
+class TestPolicyStore(unittest.TestCase):
+    """Test the per-device policy store."""
+
+    DEGRADING_INPUT = ("artifact", 0.9, 70.0, "stable", 72.0)
+    GOOD_INPUT = ("normal_sinus", 0.95, 80.0, "stable", 72.0)
+
+    def test_devices_are_isolated(self):
+        """Test that one patient's state changes do not affect another."""
+        store = PolicyStore(AdaptivePacingPolicy, stripes=4)
+        with store.acquire("dev-a") as policy:
+            command = policy.compute_pacing_command(*self.DEGRADING_INPUT)
+        self.assertEqual(command["safety_state"], "safe_mode")
+        with store.acquire("dev-b") as policy:
+            command = policy.compute_pacing_command(*self.GOOD_INPUT)
+        self.assertEqual(command["safety_state"], "normal")
+        self.assertEqual(len(store), 2)
+
+    def test_process_decision_uses_device_state(self):
+        """Test that process_pacing_decision keys controller state by device."""
+        rhythm = {"rhythm_class": "artifact", "confidence": 0.9}
+        hsi = {"hsi_score": 70.0, "input_features": {"heart_rate_bpm": 72.0}}
+        result = process_pacing_decision(rhythm, hsi, device_id="test-isolated-a")
+        self.assertEqual(result["pacing_command"]["safety_state"], "safe_mode")
+        self.assertEqual(result["input_summary"]["device_id"], "test-isolated-a")
+
+        rhythm = {"rhythm_class": "normal_sinus", "confidence": 0.95}
+        result = process_pacing_decision(rhythm, hsi, device_id="test-isolated-b")
+        self.assertEqual(result["pacing_command"]["safety_state"], "normal")
+
+    def test_idle_eviction(self):
+        """Test that idle devices are dropped and restart in NORMAL."""
+        clock = FakeClock()
+        store = PolicyStore(AdaptivePacingPolicy, stripes=2, idle_timeout=100.0, clock=clock)
+        with store.acquire("dev-a") as policy:
+            policy.compute_pacing_command(*self.DEGRADING_INPUT)
+        clock.now = 50.0
+        with store.acquire("dev-b"):
+            pass
+        clock.now = 120.0
+        self.assertEqual(store.evict_idle(), 1)
+        self.assertEqual(store.devices(), ["dev-b"])
+        with store.acquire("dev-a") as policy:
+            self.assertEqual(policy.safety_controller.current_state, SafetyState.NORMAL)
+
+    def test_snapshot_restore_round_trip(self):
+        """Test that restored state continues the hysteresis sequence."""
+        store = PolicyStore(AdaptivePacingPolicy)
+        reference = AdaptivePacingPolicy()
+        sequence = [self.DEGRADING_INPUT] + [self.GOOD_INPUT] * 2
+        for args in sequence:
+            reference.compute_pacing_command(*args)
+            with store.acquire("dev-a") as policy:
+                policy.compute_pacing_command(*args)
+
+        restored = PolicyStore(AdaptivePacingPolicy)
+        self.assertEqual(restored.restore(store.snapshot()), 1)
+        with restored.acquire("dev-a") as policy:
+            self.assertEqual(policy.export_state(), reference.export_state())
+            # Third good cycle completes the upgrade in both
+            command = policy.compute_pacing_command(*self.GOOD_INPUT)
+        self.assertEqual(command, reference.compute_pacing_command(*self.GOOD_INPUT))
+        self.assertEqual(command["safety_state"], "normal")
+
+    def test_restore_rejects_malformed_snapshot(self):
+        """Test that a bad snapshot raises and restores nothing."""
+        store = PolicyStore(AdaptivePacingPolicy)
+        snapshot = {"version": 1, "devices": {
+            "dev-a": AdaptivePacingPolicy().export_state(),
+            "dev-b": {"current_state": "panic"},
+        }}
+        with self.assertRaises(ValueError):
+            store.restore(snapshot)
+        self.assertEqual(len(store), 0)
+
+    def test_restore_waits_for_decision_in_progress(self):
+        """Test that restore swaps a device's policy only under its entry lock."""
+        store = PolicyStore(AdaptivePacingPolicy)
+        source = AdaptivePacingPolicy()
+        source.compute_pacing_command(*self.DEGRADING_INPUT)
+        snapshot = {"version": 1, "devices": {"dev-a": source.export_state()}}
+
+        restorer = threading.Thread(target=store.restore, args=(snapshot,))
+        with store.acquire("dev-a") as policy:
+            restorer.start()
+            restorer.join(0.2)
+            self.assertTrue(restorer.is_alive())
+            self.assertEqual(policy.safety_controller.current_state, SafetyState.NORMAL)
+        restorer.join()
+        with store.acquire("dev-a") as policy:
+            self.assertEqual(policy.export_state(), source.export_state())
+
+    def test_concurrent_same_device_decisions_are_serialized(self):
+        """Test that parallel requests for one device never interleave."""
+        store = PolicyStore(AdaptivePacingPolicy, stripes=1)
+        active = []
+        overlaps = []
+
+        def worker():
+            for _ in range(200):
+                with store.acquire("dev-a") as policy:
+                    active.append(policy)
+                    if len(active) > 1:
+                        overlaps.append(True)
+                    active.pop()
+
+        threads = [threading.Thread(target=worker) for _ in range(4)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        self.assertEqual(overlaps, [])
+        self.assertEqual(len(store), 1)
+
+
+class TestControllerStateEndpoint(unittest.TestCase):
+    """Test that restoring controller state requires an admin token."""
+
+    @classmethod
+    def setUpClass(cls):
+        import control_engine_service
+        from shared.security_utils import create_access_token
+        cls.client = control_engine_service.app.test_client()
+        cls.tokens = {
+            role: create_access_token({"sub": f"test-{role}", "role": role})
+            for role in ("admin", "clinician")
+        }
+
+    def post(self, headers=None):
+        return self.client.post(
+            "/controller-state", headers=headers,
+            json={"snapshot": {"version": 1, "devices": {}}}
+        )
+
+    def test_restore_requires_admin_token(self):
+        """Test 401 without a valid token, 403 for clinicians, 200 for admins."""
+        response = self.post()
+        self.assertEqual(response.status_code, 401)
+        self.assertEqual(response.headers["WWW-Authenticate"], "Bearer")
+        self.assertEqual(self.post({"Authorization": "Bearer garbage"}).status_code, 401)
+        self.assertEqual(
+            self.post({"Authorization": f"Bearer {self.tokens['clinician']}"}).status_code, 403
+        )
+        response = self.post({"Authorization": f"Bearer {self.tokens['admin']}"})
+        self.assertEqual(response.status_code, 200)
+        self.assertEqual(response.get_json()["devices_restored"], 0)
+
+
+class TestDecisionsEndpoint(unittest.TestCase):
+    """Test GET /decisions against a temporary journal."""
+
+    @classmethod
+    def setUpClass(cls):
+        import control_engine_service
+        cls.service = control_engine_service
+
+    def setUp(self):
+        from persistence import DecisionLogger
+        self.directory = tempfile.mkdtemp(prefix="decisions_endpoint_")
+        self.logger = DecisionLogger(journal_dir=self.directory, legacy_db_path=None)
+        for minute in range(3):
+            self.logger.log_decision({
+                "pacing_command": {"pacing_mode": "moderate", "target_rate_bpm": 70.0 + minute},
+                "timestamp": f"2026-01-01T00:0{minute}:00Z"
+            })
+        self.patch = mock.patch.object(self.service, "get_decision_logger", return_value=self.logger)
+        self.patch.start()
+        self.client = self.service.app.test_client()
+
+    def tearDown(self):
+        self.patch.stop()
+        self.logger.close()
+        shutil.rmtree(self.directory, ignore_errors=True)
+
+    def test_latest_and_range(self):
+        """Test newest-first reads and half-open time ranges."""
+        body = self.client.get("/decisions?limit=2").get_json()
+        self.assertEqual([d["id"] for d in body["decisions"]], [3, 2])
+        body = self.client.get("/decisions?start=2026-01-01T00:01:00Z&end=2026-01-01T00:02:00Z").get_json()
+        self.assertEqual([d["id"] for d in body["decisions"]], [2])
+
+    def test_malformed_bounds_are_rejected(self):
+        """Test that a bad bound is a 400, not a range ending now."""
+        for query in ("start=yesterday&end=2026-01-01T00:02:00Z", "start=2026-01-01T00:00:00Z",
+                      "limit=0", "limit=x"):
+            self.assertEqual(self.client.get(f"/decisions?{query}").status_code, 400, query)
+
+
+@unittest.skipUnless(
+    native_policy.is_available(),
+    "native safety policy not built (make -C services/shared/native)"
+)
+class TestNativePolicyParity(unittest.TestCase):
+    """Test that the shared C++ policy matches the Python reference exactly."""
+
+    RHYTHMS = ["normal_sinus", "bradycardia", "tachycardia", "irregular", "artifact", "unknown"]
+    TRENDS = ["stable", "improving", "declining"]
+    # Boundary-heavy value sets around every threshold
+    CONFIDENCES = [0.0, 0.59, 0.6, 0.79, 0.8, 0.95, 1.0]
+    HSI_SCORES = [0.0, 9.99, 10.0, 29.9, 30.0, 49.9, 50.0, 69.9, 70.0, 85.0, 100.0]
+    HEART_RATES = [30.0, 39.9, 40.0, 45.0, 72.0, 100.0, 135.0, 179.9, 180.0, 180.1, 250.0]
+
+    def assert_same_sequence(self, inputs):
+        self.assert_same_sequence_from(AdaptivePacingPolicy(), NativePacingPolicy(), inputs)
+
+    def assert_same_sequence_from(self, python_policy, native, inputs):
+        for step, args in enumerate(inputs):
+            expected = python_policy.compute_pacing_command(*args)
+            actual = native.compute_pacing_command(*args)
+            self.assertEqual(actual, expected, f"divergence at step {step}: {args}")
+            self.assertEqual(
+                native.safety_controller.consecutive_safe_cycles,
+                python_policy.safety_controller.consecutive_safe_cycles
+            )
+            self.assertEqual(native.last_pacing_rate, python_policy.last_pacing_rate)
+
+    def test_random_sequences(self):
+        """Test long random decision sequences over boundary values."""
+        rng = random.Random(1234)
+        for _ in range(20):
+            inputs = [
+                (
+                    rng.choice(self.RHYTHMS),
+                    rng.choice(self.CONFIDENCES),
+                    rng.choice(self.HSI_SCORES),
+                    rng.choice(self.TRENDS),
+                    rng.choice(self.HEART_RATES),
+                )
+                for _ in range(200)
+            ]
+            self.assert_same_sequence(inputs)
+
+    def test_state_import_resumes_native_policy(self):
+        """Test that imported state drives the native hysteresis identically."""
+        python_policy = AdaptivePacingPolicy()
+        for args in [("artifact", 0.9, 70.0, "stable", 72.0)] + \
+                [("normal_sinus", 0.95, 80.0, "stable", 72.0)] * 2:
+            python_policy.compute_pacing_command(*args)
+        native = NativePacingPolicy()
+        native.import_state(python_policy.export_state())
+        self.assert_same_sequence_from(
+            python_policy, native, [("normal_sinus", 0.95, 80.0, "stable", 72.0)] * 3
+        )
+
+    def test_shaper_state_import(self):
+        """Test that shaper state moves between the Python and native backends."""
+        python_policy, native = AdaptivePacingPolicy(), NativePacingPolicy()
+        command = {"pacing_enabled": True, "target_rate_bpm": 60.0, "pacing_mode": "moderate"}
+        python_policy.shape_command(command, 0)
+        python_policy.shape_command(dict(command, target_rate_bpm=90.0), 2000)
+        native.import_state(python_policy.export_state())
+        self.assertEqual(native.export_state(), python_policy.export_state())
+        for now_ms in (2500, 4000, 40000):
+            self.assertEqual(native.shape_command(dict(command, target_rate_bpm=90.0), now_ms),
+                             python_policy.shape_command(dict(command, target_rate_bpm=90.0), now_ms))
+
+    def test_command_shaper_parity(self):
+        """Test that the native shaper matches the Python shaper exactly."""
+        rng = random.Random(7)
+        python_policy, native = AdaptivePacingPolicy(), NativePacingPolicy()
+        now_ms = 0
+        for step in range(5000):
+            now_ms += rng.choice([0, 1, 250, 1000, 3000, 40000])
+            command = {
+                "pacing_enabled": rng.random() < 0.8,
+                "target_rate_bpm": rng.uniform(30.0, 200.0) if rng.random() < 0.2
+                else rng.choice([50.0, 60.0, 60.4, 75.0, 110.0]),
+                "pacing_mode": rng.choice(["moderate", "emergency", "minimal"]),
+            }
+            self.assertEqual(
+                native.shape_command(command, now_ms),
+                python_policy.shape_command(command, now_ms),
+                f"divergence at step {step}"
+            )
+
+    def test_continuous_inputs(self):
+        """Test arbitrary (non-grid) floating point inputs."""
+        rng = random.Random(99)
+        inputs = [
+            (
+                rng.choice(self.RHYTHMS),
+                rng.uniform(0.0, 1.0),
+                rng.uniform(0.0, 100.0),
+                rng.choice(self.TRENDS),
+                rng.uniform(30.0, 250.0),
+            )
+            for _ in range(2000)
+        ]
+        self.assert_same_sequence(inputs)
+
+
 if __name__ == "__main__":
     unittest.main()
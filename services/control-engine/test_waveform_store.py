@@ -0,0 +1,297 @@
+"""Tests for the time-series store bindings, the decision waveform endpoint
+and the device series endpoint."""
+
+import os
+import shutil
+import tempfile
+import unittest
+from unittest import mock
+
+import waveform_store
+from persistence import DecisionLogger
+from waveform_store import WaveformReader, WaveformWriter
+
+# 2026-01-01T00:00:00Z
+DECISION_US = 1767225600 * 1_000_000
+
+
+@unittest.skipUnless(
+    waveform_store.is_available(),
+    "time-series store not built (make -C services/shared/native)"
+)
+class TestWaveformStore(unittest.TestCase):
+    """Test the ctypes writer and reader over a temporary store."""
+
+    def setUp(self):
+        self.directory = tempfile.mkdtemp(prefix="tsdb_")
+
+    def tearDown(self):
+        shutil.rmtree(self.directory, ignore_errors=True)
+
+    def test_round_trip_across_blocks(self):
+        """Test samples come back exactly, in range, for the right series only."""
+        timestamps = [DECISION_US - 120_000_000 + i * 10_000 for i in range(12_000)]
+        values = [round(2048 + (i % 97) * 1.25 - (i % 13) * 0.01, 2) for i in range(12_000)]
+        writer = WaveformWriter(self.directory, "test")
+        for start in range(0, len(values), 10):
+            writer.append("dev-a", "ppg", timestamps[start:start + 10], values[start:start + 10])
+        writer.append("dev-a", "hsi_score", [DECISION_US], [71.25])
+        writer.close()
+
+        reader = WaveformReader(self.directory)
+        try:
+            self.assertEqual(reader.query("dev-a", "ppg", 0, 2**62), (timestamps, values))
+            got_ts, got_values = reader.query(
+                "dev-a", "ppg", DECISION_US - 30_000_000, DECISION_US
+            )
+            self.assertEqual(len(got_ts), 3000)
+            self.assertEqual(got_ts[0], DECISION_US - 30_000_000)
+            self.assertEqual(got_values, values[-3000:])
+            self.assertEqual(reader.query("dev-a", "hsi_score", 0, 2**62), ([DECISION_US], [71.25]))
+            self.assertEqual(reader.query("dev-b", "ppg", 0, 2**62), ([], []))
+            self.assertEqual(reader.corrupt_blocks(), 0)
+        finally:
+            reader.close()
+
+    def test_reader_follows_writer(self):
+        """Test flushed samples become visible to an open reader."""
+        writer = WaveformWriter(self.directory, "test")
+        reader = WaveformReader(self.directory)
+        try:
+            writer.append("dev-a", "ppg", [1, 2, 3], [1.0, 2.0, 3.0])
+            self.assertEqual(reader.query("dev-a", "ppg", 0, 10), ([], []))
+            writer.flush()
+            self.assertEqual(reader.query("dev-a", "ppg", 0, 10), ([1, 2, 3], [1.0, 2.0, 3.0]))
+        finally:
+            writer.close()
+            reader.close()
+
+    def test_rollups_match_samples(self):
+        """Test every tier's buckets aggregate the samples they cover."""
+        start = DECISION_US - 900_000_000
+        timestamps = [start + i * 10_000 for i in range(90_000)]
+        values = [float(2000 + (i * 7) % 301) for i in range(90_000)]
+        writer = WaveformWriter(self.directory, "test")
+        for at in range(0, len(values), 1000):
+            writer.append("dev-a", "ppg", timestamps[at:at + 1000], values[at:at + 1000])
+        writer.close()
+
+        reader = WaveformReader(self.directory)
+        try:
+            for tier, width in waveform_store.ROLLUP_TIER_US.items():
+                buckets = reader.query_rollup("dev-a", "ppg", tier, start, DECISION_US)
+                expected = {}
+                for ts, value in zip(timestamps, values):
+                    expected.setdefault(ts - ts % width, []).append(value)
+                self.assertEqual(buckets["timestamps_us"], sorted(expected))
+                for i, bucket_start in enumerate(buckets["timestamps_us"]):
+                    covered = expected[bucket_start]
+                    self.assertEqual(buckets["min"][i], min(covered))
+                    self.assertEqual(buckets["max"][i], max(covered))
+                    self.assertEqual(buckets["count"][i], len(covered))
+                    self.assertAlmostEqual(buckets["mean"][i], sum(covered) / len(covered))
+            with self.assertRaises(ValueError):
+                reader.query_rollup("dev-a", "ppg", 0, start, DECISION_US)
+        finally:
+            reader.close()
+
+    def test_query_range_picks_resolution(self):
+        """Test short ranges read raw samples and long ones the coarsest fitting tier."""
+        self.assertEqual(waveform_store.select_tier("ppg", 10_000_000, 1000), 0)
+        self.assertEqual(waveform_store.select_tier("ppg", 3_600_000_000, 1000), 1)
+        self.assertEqual(waveform_store.select_tier("hsi_score", 3_600_000_000, 1000), 0)
+        self.assertEqual(waveform_store.select_tier("ppg", 86_400_000_000, 1000), 3)
+
+        writer = WaveformWriter(self.directory, "test")
+        writer.append("dev-a", "ppg", [DECISION_US + i * 10_000 for i in range(3000)], [1.0] * 3000)
+        writer.close()
+        reader = WaveformReader(self.directory)
+        try:
+            raw = reader.query_range("dev-a", "ppg", DECISION_US, DECISION_US + 30_000_000, 5000)
+            self.assertEqual(raw["resolution_us"], 0)
+            self.assertEqual(len(raw["values"]), 3000)
+            rollup = reader.query_range("dev-a", "ppg", DECISION_US, DECISION_US + 30_000_000, 10)
+            self.assertEqual(rollup["resolution_us"], 1_000_000)
+            self.assertEqual(len(rollup["timestamps_us"]), 30)
+            self.assertEqual(rollup["count"], [100] * 30)
+        finally:
+            reader.close()
+
+    def test_invalid_appends_are_rejected(self):
+        """Test out-of-order samples, bad device ids and unknown metrics."""
+        writer = WaveformWriter(self.directory, "test")
+        try:
+            with self.assertRaises(ValueError):
+                writer.append("dev-a", "ppg", [10, 5], [1.0, 2.0])
+            with self.assertRaises(ValueError):
+                writer.append("", "ppg", [10], [1.0])
+            with self.assertRaises(ValueError):
+                writer.append("dev-a", "spo2", [10], [1.0])
+        finally:
+            writer.close()
+        with self.assertRaises(OSError):
+            WaveformWriter(self.directory, "bad/name")
+
+
+@unittest.skipUnless(
+    waveform_store.is_available(),
+    "time-series store not built (make -C services/shared/native)"
+)
+class TestDecisionWaveformEndpoint(unittest.TestCase):
+    """Test GET /decisions/<id>/waveform against a temporary journal and store."""
+
+    @classmethod
+    def setUpClass(cls):
+        import control_engine_service
+        cls.service = control_engine_service
+
+    def setUp(self):
+        self.directory = tempfile.mkdtemp(prefix="decision_waveform_")
+        store_dir = os.path.join(self.directory, "tsdb")
+        writer = WaveformWriter(store_dir, "test")
+        writer.append(
+            "dev-a", "ppg",
+            [DECISION_US - 60_000_000 + i * 10_000 for i in range(6_100)],
+            [float(2000 + i % 50) for i in range(6_100)]
+        )
+        writer.close()
+        self.reader = WaveformReader(store_dir)
+
+        self.logger = DecisionLogger(
+            journal_dir=os.path.join(self.directory, "journal"), legacy_db_path=None
+        )
+        self.logger.log_decision({
+            "success": True,
+            "pacing_command": {"pacing_mode": "moderate", "target_rate_bpm": 70.0},
+            "input_summary": {"device_id": "dev-a", "rhythm_class": "normal_sinus", "hsi_score": 65.0},
+            "timestamp": "2026-01-01T00:00:00Z"
+        })
+        self.logger.log_decision({"success": False, "timestamp": "2026-01-01T00:00:01Z"})
+        self.logger.flush()
+
+        self.patches = [
+            mock.patch.object(self.service, "get_decision_logger", return_value=self.logger),
+            mock.patch.object(waveform_store, "get_reader", return_value=self.reader),
+        ]
+        for patch in self.patches:
+            patch.start()
+        self.client = self.service.app.test_client()
+
+    def tearDown(self):
+        for patch in self.patches:
+            patch.stop()
+        self.logger.close()
+        self.reader.close()
+        shutil.rmtree(self.directory, ignore_errors=True)
+
+    def test_waveform_before_decision(self):
+        """Test the window ends at the decision and spans the requested seconds."""
+        response = self.client.get("/decisions/1/waveform?seconds=10")
+        self.assertEqual(response.status_code, 200)
+        body = response.get_json()
+        self.assertEqual(body["device_id"], "dev-a")
+        self.assertEqual(body["decision"]["pacing_mode"], "moderate")
+        self.assertEqual(body["sample_count"], 1001)
+        self.assertEqual(body["timestamps_us"][0], DECISION_US - 10_000_000)
+        self.assertEqual(body["timestamps_us"][-1], DECISION_US)
+        self.assertEqual(body["values"][0], 2000.0)
+        self.assertEqual(body["end"], "2026-01-01T00:00:00.000000Z")
+
+    def test_errors(self):
+        """Test unknown decisions, decisions without a device and bad parameters."""
+        self.assertEqual(self.client.get("/decisions/99/waveform").status_code, 404)
+        self.assertEqual(self.client.get("/decisions/2/waveform").status_code, 422)
+        self.assertEqual(self.client.get("/decisions/1/waveform?seconds=0").status_code, 400)
+        self.assertEqual(self.client.get("/decisions/1/waveform?seconds=x").status_code, 400)
+        self.assertEqual(self.client.get("/decisions/1/waveform?metric=spo2").status_code, 400)
+        with mock.patch.object(waveform_store, "get_reader", return_value=None):
+            self.assertEqual(self.client.get("/decisions/1/waveform").status_code, 503)
+
+
+@unittest.skipUnless(
+    waveform_store.is_available(),
+    "time-series store not built (make -C services/shared/native)"
+)
+class TestDeviceSeriesEndpoint(unittest.TestCase):
+    """Test GET /devices/<device_id>/series against a temporary store."""
+
+    @classmethod
+    def setUpClass(cls):
+        import control_engine_service
+        cls.service = control_engine_service
+
+    def setUp(self):
+        self.directory = tempfile.mkdtemp(prefix="device_series_")
+        writer = WaveformWriter(self.directory, "test")
+        writer.append(
+            "dev-a", "ppg",
+            [DECISION_US + i * 10_000 for i in range(60_000)],
+            [float(2000 + i % 50) for i in range(60_000)]
+        )
+        writer.close()
+        self.reader = WaveformReader(self.directory)
+        self.patch = mock.patch.object(waveform_store, "get_reader", return_value=self.reader)
+        self.patch.start()
+        self.client = self.service.app.test_client()
+
+    def tearDown(self):
+        self.patch.stop()
+        self.reader.close()
+        shutil.rmtree(self.directory, ignore_errors=True)
+
+    def test_long_range_from_rollups(self):
+        """Test ten minutes at 100 points come from the 1 s tier."""
+        response = self.client.get(
+            f"/devices/dev-a/series?start_us={DECISION_US}&end_us={DECISION_US + 600_000_000}&max_points=100"
+        )
+        self.assertEqual(response.status_code, 200)
+        body = response.get_json()
+        self.assertEqual(body["resolution_seconds"], 1.0)
+        self.assertEqual(body["point_count"], 600)
+        self.assertEqual(body["min"][0], 2000.0)
+        self.assertEqual(body["max"][0], 2049.0)
+        self.assertEqual(body["count"][0], 100)
+        self.assertNotIn("values", body)
+
+    def test_short_range_raw(self):
+        """Test a range with fewer samples than points returns the samples."""
+        response = self.client.get(
+            f"/devices/dev-a/series?start_us={DECISION_US}&end_us={DECISION_US + 1_000_000}"
+        )
+        body = response.get_json()
+        self.assertEqual(body["resolution_seconds"], 0)
+        self.assertEqual(body["values"], [float(2000 + i % 50) for i in range(100)])
+
+    def test_downsampled_to_budget(self):
+        """Test both modes return at most max_points points, raw or from rollups."""
+        for end_us in (DECISION_US + 5_000_000, DECISION_US + 600_000_000):
+            for mode in ("lttb", "minmax"):
+                response = self.client.get(
+                    f"/devices/dev-a/series?start_us={DECISION_US}&end_us={end_us}"
+                    f"&max_points=100&downsample={mode}"
+                )
+                self.assertEqual(response.status_code, 200)
+                body = response.get_json()
+                self.assertEqual(body["downsample"], mode)
+                self.assertLessEqual(body["point_count"], 100)
+                self.assertGreater(body["point_count"], 50)
+                self.assertEqual(len(body["values"]), body["point_count"])
+                self.assertEqual(body["timestamps_us"], sorted(body["timestamps_us"]))
+                if mode == "minmax":
+                    # The envelope keeps the extremes
+                    self.assertEqual(min(body["values"]), 2000.0)
+                    self.assertEqual(max(body["values"]), 2049.0)
+
+    def test_errors(self):
+        """Test bad ranges, bad parameters and a missing store."""
+        self.assertEqual(self.client.get("/devices/dev-a/series?metric=spo2").status_code, 400)
+        self.assertEqual(self.client.get("/devices/dev-a/series?start_us=5&end_us=5").status_code, 400)
+        self.assertEqual(self.client.get("/devices/dev-a/series?max_points=0").status_code, 400)
+        self.assertEqual(self.client.get("/devices/dev-a/series?end_us=x").status_code, 400)
+        self.assertEqual(self.client.get("/devices/dev-a/series?downsample=avg").status_code, 400)
+        with mock.patch.object(waveform_store, "get_reader", return_value=None):
+            self.assertEqual(self.client.get("/devices/dev-a/series").status_code, 503)
+
+
+if __name__ == "__main__":
+    unittest.main()
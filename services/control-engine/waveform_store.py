@@ -0,0 +1,301 @@
+"""ctypes bindings for the time-series store (shared/native/TimeSeriesStore.h).
+
+The ingest worker writes every device's raw PPG samples and the features of
+each analyzed window to the store; this module reads them back so the
+waveform behind a pacing decision can be retrieved. The store also keeps
+min/max/mean/count rollups of every series in 1 s, 10 s, 1 min and 10 min
+buckets; query_range() serves a plot from the coarsest tier that still gives
+a point per pixel, so long ranges cost a few thousand points. A writer is
+exposed for tools and tests.
+
+Timestamps are Unix epoch microseconds, the clock decision timestamps use
+(decision_journal.timestamp_to_us).
+
+Build the library with `make -C services/shared/native`, or point
+PULSEMIND_TSDB_LIB at a prebuilt libtsdb.so. The store directory is
+PULSEMIND_TSDB_DIR (the ingest worker's --store).
+"""
+
+import ctypes
+import os
+import threading
+from typing import Dict, List, Optional, Tuple
+
+DEFAULT_LIBRARY_PATH = os.path.join(
+    os.path.dirname(os.path.abspath(__file__)),
+    "..", "shared", "native", "build", "libtsdb.so"
+)
+LIBRARY_PATH = os.getenv("PULSEMIND_TSDB_LIB", DEFAULT_LIBRARY_PATH)
+STORE_DIR = os.getenv("PULSEMIND_TSDB_DIR", "")
+
+ABI_VERSION = 2
+
+# pulsemind::tsdb::Metric
+METRICS: Dict[str, int] = {
+    "ppg": 0,
+    "heart_rate_bpm": 1,
+    "hrv_sdnn_ms": 2,
+    "pulse_amplitude": 3,
+    "hsi_score": 4,
+}
+
+# pulsemind::tsdb::Status
+STATUS_OK = 0
+STATUS_OUT_OF_ORDER = 1
+STATUS_INVALID_SERIES = 2
+STATUS_IO_ERROR = 3
+
+BLOCK_DURATION_US = 60 * 1_000_000
+
+# Rollup tier -> bucket width (pulsemind::tsdb::ROLLUP_TIER_US); tier 0 is raw
+ROLLUP_TIER_US: Dict[int, int] = {
+    1: 1_000_000,
+    2: 10_000_000,
+    3: 60_000_000,
+    4: 600_000_000,
+}
+
+# First query buffer size; grown to the exact match count when too small
+INITIAL_CAPACITY = 8192
+
+_lib: Optional[ctypes.CDLL] = None
+
+
+def load_library(path: str = LIBRARY_PATH) -> ctypes.CDLL:
+    """Load and type the native library (cached after the first call).
+
+    Raises:
+        OSError: If the library is missing or has an incompatible ABI
+    """
+    global _lib
+    if _lib is not None:
+        return _lib
+
+    lib = ctypes.CDLL(path)
+    lib.pm_tsdb_abi_version.restype = ctypes.c_uint32
+    if lib.pm_tsdb_abi_version() != ABI_VERSION:
+        raise OSError(f"Unsupported time-series store ABI version {lib.pm_tsdb_abi_version()}")
+
+    i64_p = ctypes.POINTER(ctypes.c_int64)
+    f64_p = ctypes.POINTER(ctypes.c_double)
+    lib.pm_tsdb_writer_open.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_int64]
+    lib.pm_tsdb_writer_open.restype = ctypes.c_void_p
+    lib.pm_tsdb_writer_append.argtypes = [
+        ctypes.c_void_p, ctypes.c_char_p, ctypes.c_uint32, i64_p, f64_p, ctypes.c_uint64
+    ]
+    lib.pm_tsdb_writer_append.restype = ctypes.c_int32
+    lib.pm_tsdb_writer_flush.argtypes = [ctypes.c_void_p]
+    lib.pm_tsdb_writer_flush.restype = ctypes.c_int32
+    lib.pm_tsdb_writer_close.argtypes = [ctypes.c_void_p]
+    lib.pm_tsdb_writer_close.restype = None
+    lib.pm_tsdb_reader_open.argtypes = [ctypes.c_char_p]
+    lib.pm_tsdb_reader_open.restype = ctypes.c_void_p
+    lib.pm_tsdb_reader_close.argtypes = [ctypes.c_void_p]
+    lib.pm_tsdb_reader_close.restype = None
+    lib.pm_tsdb_reader_query.argtypes = [
+        ctypes.c_void_p, ctypes.c_char_p, ctypes.c_uint32, ctypes.c_int64, ctypes.c_int64,
+        i64_p, f64_p, ctypes.c_uint64
+    ]
+    lib.pm_tsdb_reader_query.restype = ctypes.c_int64
+    lib.pm_tsdb_select_tier.argtypes = [ctypes.c_uint32, ctypes.c_int64, ctypes.c_uint64]
+    lib.pm_tsdb_select_tier.restype = ctypes.c_int32
+    lib.pm_tsdb_reader_query_rollup.argtypes = [
+        ctypes.c_void_p, ctypes.c_char_p, ctypes.c_uint32, ctypes.c_uint32, ctypes.c_int64, ctypes.c_int64,
+        i64_p, f64_p, f64_p, f64_p, f64_p, ctypes.c_uint64
+    ]
+    lib.pm_tsdb_reader_query_rollup.restype = ctypes.c_int64
+    lib.pm_tsdb_reader_corrupt_blocks.argtypes = [ctypes.c_void_p]
+    lib.pm_tsdb_reader_corrupt_blocks.restype = ctypes.c_uint64
+
+    _lib = lib
+    return lib
+
+
+def is_available(path: str = LIBRARY_PATH) -> bool:
+    """Return True if the native library can be loaded."""
+    try:
+        load_library(path)
+        return True
+    except OSError:
+        return False
+
+
+def metric_code(metric: str) -> int:
+    """Map a metric name to its native enum value.
+
+    Raises:
+        ValueError: If the metric is unknown
+    """
+    if metric not in METRICS:
+        raise ValueError(f"Unknown metric '{metric}' (expected one of {sorted(METRICS)})")
+    return METRICS[metric]
+
+
+def select_tier(metric: str, span_us: int, max_points: int) -> int:
+    """Coarsest rollup tier giving at least max_points buckets over span_us;
+    0 when the raw samples are needed.
+
+    Raises:
+        ValueError: If the metric is unknown
+    """
+    return load_library().pm_tsdb_select_tier(metric_code(metric), span_us, max(max_points, 0))
+
+
+class WaveformReader:
+    """Read-only view of a store directory, following its writers."""
+
+    def __init__(self, root: str):
+        self._lib = load_library()
+        self._handle = self._lib.pm_tsdb_reader_open(root.encode())
+        if not self._handle:
+            raise OSError(f"Cannot open time-series store {root}")
+        self._lock = threading.Lock()
+
+    def query(
+        self, device_id: str, metric: str, start_us: int, end_us: int
+    ) -> Tuple[List[int], List[float]]:
+        """Samples of one series with start_us <= timestamp < end_us, oldest first.
+
+        Returns:
+            (timestamps in epoch microseconds, values)
+        """
+        code = metric_code(metric)
+        capacity = INITIAL_CAPACITY
+        while True:
+            ts = (ctypes.c_int64 * capacity)()
+            values = (ctypes.c_double * capacity)()
+            with self._lock:
+                if not self._handle:
+                    raise RuntimeError("Waveform reader is closed")
+                count = self._lib.pm_tsdb_reader_query(
+                    self._handle, device_id.encode(), code, start_us, end_us, ts, values, capacity
+                )
+            if count <= capacity:
+                return ts[:count], values[:count]
+            capacity = count
+
+    def query_rollup(
+        self, device_id: str, metric: str, tier: int, start_us: int, end_us: int
+    ) -> Dict[str, list]:
+        """Buckets of one rollup tier overlapping [start_us, end_us), oldest first.
+
+        Returns:
+            {"timestamps_us": bucket starts, "min": [...], "max": [...],
+             "mean": [...], "count": [...]}
+
+        Raises:
+            ValueError: If the metric or tier is unknown
+        """
+        code = metric_code(metric)
+        if tier not in ROLLUP_TIER_US:
+            raise ValueError(f"Unknown rollup tier {tier} (expected one of {sorted(ROLLUP_TIER_US)})")
+        capacity = INITIAL_CAPACITY
+        while True:
+            ts = (ctypes.c_int64 * capacity)()
+            columns = [(ctypes.c_double * capacity)() for _ in range(4)]
+            with self._lock:
+                if not self._handle:
+                    raise RuntimeError("Waveform reader is closed")
+                count = self._lib.pm_tsdb_reader_query_rollup(
+                    self._handle, device_id.encode(), code, tier, start_us, end_us, ts, *columns, capacity
+                )
+            if count <= capacity:
+                return {
+                    "timestamps_us": ts[:count],
+                    "min": columns[0][:count],
+                    "max": columns[1][:count],
+                    "mean": columns[2][:count],
+                    "count": [int(c) for c in columns[3][:count]],
+                }
+            capacity = count
+
+    def query_range(
+        self, device_id: str, metric: str, start_us: int, end_us: int, max_points: int
+    ) -> Dict[str, object]:
+        """A series over [start_us, end_us) at the resolution of a max_points
+        wide plot: raw samples when the range is short enough, else the
+        coarsest rollup tier with at least one bucket per point.
+
+        Returns:
+            {"resolution_us": 0 for raw samples or the bucket width,
+             "timestamps_us": [...], and "values" for raw samples or
+             "min"/"max"/"mean"/"count" for buckets}
+        """
+        tier = select_tier(metric, end_us - start_us, max_points)
+        if tier == 0:
+            timestamps, values = self.query(device_id, metric, start_us, end_us)
+            return {"resolution_us": 0, "timestamps_us": timestamps, "values": values}
+        result: Dict[str, object] = {"resolution_us": ROLLUP_TIER_US[tier]}
+        result.update(self.query_rollup(device_id, metric, tier, start_us, end_us))
+        return result
+
+    def corrupt_blocks(self) -> int:
+        """Blocks skipped by queries so far because they failed their checks."""
+        with self._lock:
+            return self._lib.pm_tsdb_reader_corrupt_blocks(self._handle) if self._handle else 0
+
+    def close(self):
+        with self._lock:
+            if self._handle:
+                self._lib.pm_tsdb_reader_close(self._handle)
+                self._handle = None
+
+
+class WaveformWriter:
+    """Append samples to a store directory (single-threaded, like the native writer)."""
+
+    def __init__(self, root: str, name: str, block_duration_us: int = BLOCK_DURATION_US):
+        self._lib = load_library()
+        self._handle = self._lib.pm_tsdb_writer_open(root.encode(), name.encode(), block_duration_us)
+        if not self._handle:
+            raise OSError(f"Cannot open time-series store {root} for writing")
+
+    def append(self, device_id: str, metric: str, timestamps_us, values):
+        """Append samples with non-decreasing timestamps to one series.
+
+        Raises:
+            ValueError: On out-of-order timestamps (earlier samples were
+                stored) or an invalid device id
+            OSError: If a sealed block could not be written
+        """
+        if len(timestamps_us) != len(values):
+            raise ValueError("timestamps and values differ in length")
+        n = len(values)
+        status = self._lib.pm_tsdb_writer_append(
+            self._handle, device_id.encode(), metric_code(metric),
+            (ctypes.c_int64 * n)(*timestamps_us), (ctypes.c_double * n)(*values), n
+        )
+        self._check(status)
+
+    def flush(self):
+        """Seal all open blocks and make them durable. Buckets still open
+        are stored once the series has been idle for a flush, or on close()."""
+        self._check(self._lib.pm_tsdb_writer_flush(self._handle))
+
+    def close(self):
+        if self._handle:
+            self._lib.pm_tsdb_writer_close(self._handle)
+            self._handle = None
+
+    @staticmethod
+    def _check(status: int):
+        if status == STATUS_OUT_OF_ORDER:
+            raise ValueError("Timestamps must not go backwards within a series")
+        if status == STATUS_INVALID_SERIES:
+            raise ValueError("Invalid device id")
+        if status == STATUS_IO_ERROR:
+            raise OSError("Time-series store write failed")
+
+
+_reader: Optional[WaveformReader] = None
+_reader_lock = threading.Lock()
+
+
+def get_reader() -> Optional[WaveformReader]:
+    """Shared reader over PULSEMIND_TSDB_DIR; None when no store is configured
+    or the native library is unavailable."""
+    global _reader
+    with _reader_lock:
+        if _reader is None and STORE_DIR and is_available():
+            _reader = WaveformReader(STORE_DIR)
+        return _reader
@@ -1,24 +1,24 @@
 import time
 import os
 import json
-import socket
 import numpy as np
 import pandas as pd
 import plotly.graph_objs as go
 import requests
 import streamlit as st
-import paho.mqtt.client as mqtt
 from concurrent.futures import ThreadPoolExecutor
-from threading import Lock
-from collections import deque
 import sys
 
 # Add shared module to path
 sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+from shared import downsample
 from shared.logger import setup_logger
+from shared.tracing import setup_tracing
+from live_feed import LiveFeed
 
 # Initialize logger
 logger = setup_logger("dashboard", level="INFO")
+tracer = setup_tracing("dashboard")
 
 # ==========================================
 # 🏥 PULSEMIND BEDSIDE MONITOR (v3.0 CLINICAL)
@@ -27,19 +27,6 @@ logger = setup_logger("dashboard", level="INFO")
 REPO_ROOT = os.path.abspath(os.path.join(os.path.dirname(__file__), "..", ".."))
 XAI_RESULTS_CSV = os.path.join(REPO_ROOT, "analytics", "exports", "xai_results_all.csv")
 
-# Thread-safe buffer for high-frequency MQTT samples
-SIGNAL_LOCK = Lock()
-MQTT_BUFFER = deque([2048] * 400, maxlen=400)
-LAST_MQTT_VALUE = None
-LAST_MQTT_TS = None
-LAST_MQTT_PAYLOAD = None
-MQTT_MESSAGE_COUNT = 0
-MQTT_CONNECTED = False
-LAST_MQTT_RC = None
-LAST_MQTT_ERROR = None
-LAST_MQTT_TCP_OK = None
-MQTT_LOGS = deque(maxlen=25)
-
 if "clinical_history" not in st.session_state:
     st.session_state.clinical_history = {"hsi": []}
 
@@ -51,99 +38,25 @@ if "clinical_data" not in st.session_state:
         "safety_state": "NORMAL", "target_rate": 0
     }
 
-# --- MQTT Setup ---
-def get_default_mqtt_host():
-    env_host = os.getenv("MQTT_BROKER_HOST")
-    if env_host:
-        return env_host
+# --- Live Feed (services/live-hub) ---
+# The hub holds the one broker subscription and pushes deltas; every session
+# of this process shares one hub connection per device.
+def get_default_live_hub_url():
+    env_url = os.getenv("PULSEMIND_LIVE_HUB_URL")
+    if env_url:
+        return env_url
     if os.path.exists("/.dockerenv"):
-        return "mqtt-broker"
-    return "localhost"
-
-MQTT_HOST = get_default_mqtt_host()
-MQTT_PORT = int(os.getenv("MQTT_BROKER_PORT", "1883"))
-MQTT_TOPIC = os.getenv("MQTT_TOPIC", "pulsemind/sensor/ppg")
-
-def on_message(client, userdata, msg):
-    try:
-        payload = msg.payload.decode("utf-8", errors="ignore").strip()
-        sample = None
-
-        try:
-            data = json.loads(payload)
-            if isinstance(data, dict):
-                sample = data.get("value", data.get("ppg", data.get("signal", None)))
-            elif isinstance(data, (int, float)):
-                sample = data
-        except json.JSONDecodeError:
-            sample = None
-
-        if sample is None:
-            try:
-                sample = float(payload)
-            except Exception:
-                return
+        return "ws://live-hub:8765"
+    return "ws://localhost:8765"
 
-        try:
-            sample = float(sample)
-        except Exception:
-            return
-
-        with SIGNAL_LOCK:
-            global LAST_MQTT_VALUE, LAST_MQTT_TS, LAST_MQTT_PAYLOAD, MQTT_MESSAGE_COUNT
-            LAST_MQTT_VALUE = sample
-            LAST_MQTT_TS = time.time()
-            LAST_MQTT_PAYLOAD = payload[:200]
-            MQTT_MESSAGE_COUNT += 1
-            MQTT_BUFFER.append(sample)
-    except Exception:
-        return
-
-def get_mqtt_client():
-    if "mqtt_client" in st.session_state:
-        return st.session_state.mqtt_client
-
-    client = mqtt.Client(transport="websockets" if "browser" in MQTT_HOST else "tcp")
-    client.on_message = on_message
-
-    def on_connect(c, userdata, flags, rc):
-        global MQTT_CONNECTED, LAST_MQTT_RC
-        MQTT_CONNECTED = (rc == 0)
-        LAST_MQTT_RC = rc
-        if rc == 0:
-            c.subscribe(MQTT_TOPIC)
-
-    def on_disconnect(c, userdata, rc):
-        global MQTT_CONNECTED, LAST_MQTT_RC
-        MQTT_CONNECTED = False
-        LAST_MQTT_RC = rc
-
-    def on_log(c, userdata, level, buf):
-        MQTT_LOGS.append(buf)
-
-    client.on_connect = on_connect
-    client.on_disconnect = on_disconnect
-    client.on_log = on_log
+LIVE_HUB_URL = get_default_live_hub_url()
+LIVE_HUB_TOKEN = os.getenv("PULSEMIND_LIVE_HUB_TOKEN")
+LIVE_DEVICE_ID = os.getenv("PULSEMIND_LIVE_DEVICE", "default")
+LIVE_BUFFER_SAMPLES = 400
 
-    try:
-        global LAST_MQTT_ERROR, LAST_MQTT_TCP_OK
-        try:
-            socket.getaddrinfo(MQTT_HOST, MQTT_PORT)
-            sock = socket.create_connection((MQTT_HOST, MQTT_PORT), timeout=1.0)
-            sock.close()
-            LAST_MQTT_TCP_OK = True
-        except Exception as e:
-            LAST_MQTT_TCP_OK = False
-            LAST_MQTT_ERROR = f"TCP check failed: {e}"
-            return None
-        client.connect(MQTT_HOST, MQTT_PORT, 60)
-        client.subscribe(MQTT_TOPIC)
-        client.loop_start()
-        st.session_state.mqtt_client = client
-        return client
-    except Exception as e:
-        LAST_MQTT_ERROR = str(e)
-        return None
+@st.cache_resource
+def get_live_feed(device_id):
+    return LiveFeed(LIVE_HUB_URL, device_id, maxlen=LIVE_BUFFER_SAMPLES, token=LIVE_HUB_TOKEN).start()
 
 st.set_page_config(
     page_title="PulseMind Bedside Monitor",
@@ -210,6 +123,13 @@ SIGNAL_URL = os.getenv("SIGNAL_SERVICE_URL", "http://localhost:8001")
 HSI_URL = os.getenv("HSI_SERVICE_URL", "http://localhost:8002")
 AI_URL = os.getenv("AI_INFERENCE_URL", "http://localhost:8003")
 CTRL_URL = os.getenv("CONTROL_ENGINE_URL", "http://localhost:8004")
+PIPELINE_URL = os.getenv("PIPELINE_SERVICE_URL", "http://localhost:8005")
+
+# 📉 PLOT BUDGET: points per trace, about one per pixel of plot width
+PLOT_POINTS = int(os.getenv("PULSEMIND_PLOT_POINTS", "800"))
+PLOT_DOWNSAMPLE = os.getenv("PULSEMIND_PLOT_DOWNSAMPLE", "lttb")
+HISTORY_DEVICE_ID = os.getenv("PULSEMIND_HISTORY_DEVICE", "default")
+HISTORY_RANGES = {"Off": 0, "10 min": 600, "1 h": 3600, "6 h": 21600, "24 h": 86400}
 
 def simulate_biological_heartbeat(t, bpm):
     """Generates a realistic clinical heart pulse (Gaussian components)"""
@@ -480,14 +400,82 @@ def render_xai_card(model_title, model_subtitle, row, region_label, importance_l
     if viz_path:
         st.image(viz_path, use_container_width=True)
 
+def plot_points(x, y, mode=PLOT_DOWNSAMPLE):
+    """Reduce a trace to PLOT_POINTS so render time does not grow with the
+    sample rate or window length; the full trace if the native library is missing."""
+    if len(x) <= PLOT_POINTS or not downsample.is_available():
+        return x, y
+    return downsample.downsample(mode, x, y, PLOT_POINTS)
+
+
+def get_stored_history(device_id, seconds):
+    """A device's stored PPG over the last seconds, already reduced to
+    PLOT_POINTS by the control engine (min/max envelope of raw samples or
+    rollups), as (datetimes, values); None when unavailable."""
+    end_us = int(time.time() * 1_000_000)
+    params = {
+        "metric": "ppg", "start_us": end_us - seconds * 1_000_000, "end_us": end_us,
+        "max_points": PLOT_POINTS, "downsample": "minmax",
+    }
+    try:
+        r = requests.get(f"{CTRL_URL}/devices/{device_id}/series", params=params, timeout=1.0)
+    except requests.RequestException:
+        return None
+    if r.status_code != 200:
+        return None
+    body = r.json()
+    return pd.to_datetime(body["timestamps_us"], unit="us"), body["values"]
+
+
+def run_fused_pipeline(sig_payload):
+    """One round trip to the fused pipeline; None if it is unavailable."""
+    try:
+        r = requests.post(f"{PIPELINE_URL}/process-window", json=sig_payload, headers=tracer.inject(), timeout=1.0)
+    except requests.RequestException:
+        return None
+    if r.status_code != 200:
+        return None
+    data = sanitize_json_value(r.json())
+    pace = data.get("pacing", {}).get("pacing_command", {})
+    return data.get("features", {}), data.get("hsi", {}), data.get("prediction", {}), pace
+
+def run_service_chain(sig_payload):
+    """Fallback: signal -> (HSI || AI) -> control over four HTTP calls.
+
+    The fused pipeline also decides on the control engine, so either path
+    updates the same controller state and decision journal."""
+    # Pool threads do not see the current span, so every call carries it explicitly
+    headers = tracer.inject()
+    sig_r = requests.post(f"{SIGNAL_URL}/process", json=sig_payload, headers=headers, timeout=1.0)
+    if sig_r.status_code != 200: return None
+    feat = sig_r.json().get("features", {})
+    feat = sanitize_json_value(feat)
+
+    with ThreadPoolExecutor(max_workers=2) as ex:
+        f1 = ex.submit(requests.post, f"{HSI_URL}/compute-hsi", json={"features": feat}, headers=headers,
+                       timeout=1.0)
+        f2 = ex.submit(requests.post, f"{AI_URL}/predict", json={"features": feat}, headers=headers,
+                       timeout=1.0)
+
+    h_r, a_r = f1.result(), f2.result()
+    if h_r.status_code != 200 or a_r.status_code != 200:
+        return None
+    hsi_d = sanitize_json_value(h_r.json())
+    ai_d = sanitize_json_value(a_r.json().get("prediction", {}))
+    hsi_d["input_features"] = feat
+    ctrl_payload = sanitize_json_value({"rhythm_data": ai_d, "hsi_data": hsi_d})
+    ctrl_r = requests.post(f"{CTRL_URL}/compute-pacing", json=ctrl_payload, headers=headers, timeout=1.0)
+    pace = ctrl_r.json().get("pacing_command", {}) if ctrl_r.status_code == 200 else {}
+    return feat, hsi_d, ai_d, pace
+
 def get_data(sim_type, source):
     try:
         wave = []
         t_axis = [] # Initialize t_axis
         if source == "Live MQTT (Sensor)":
-            with SIGNAL_LOCK: wave = list(MQTT_BUFFER)
+            wave = get_live_feed(LIVE_DEVICE_ID).samples() or [2048] * LIVE_BUFFER_SAMPLES
             t_now = time.time()
-            t_axis = list(np.linspace(t_now - 4, t_now, len(wave))) # Generate t_axis for MQTT
+            t_axis = list(np.linspace(t_now - 4, t_now, len(wave))) # Generate t_axis for the live feed
         else:
             # MEDICAL GRADE SCROLLING: Use the past 4 seconds for a rolling window
             t_now = time.time()
@@ -570,23 +558,12 @@ def get_data(sim_type, source):
             }
 
         sig_payload = sanitize_json_value({"signal": wave, "sampling_rate": 100})
-        sig_r = requests.post(f"{SIGNAL_URL}/process", json=sig_payload, timeout=1.0)
-        if sig_r.status_code != 200: return None
-        feat = sig_r.json().get("features", {})
-        feat = sanitize_json_value(feat)
-
-        with ThreadPoolExecutor(max_workers=2) as ex:
-            f1 = ex.submit(requests.post, f"{HSI_URL}/compute-hsi", json={"features": feat}, timeout=1.0)
-            f2 = ex.submit(requests.post, f"{AI_URL}/predict", json={"features": feat}, timeout=1.0)
-        
-        h_r, a_r = f1.result(), f2.result()
-        if h_r.status_code == 200 and a_r.status_code == 200:
-            hsi_d = sanitize_json_value(h_r.json())
-            ai_d = sanitize_json_value(a_r.json().get("prediction", {}))
-            hsi_d["input_features"] = feat
-            ctrl_payload = sanitize_json_value({"rhythm_data": ai_d, "hsi_data": hsi_d})
-            ctrl_r = requests.post(f"{CTRL_URL}/compute-pacing", json=ctrl_payload, timeout=1.0)
-            pace = ctrl_r.json().get("pacing_command", {}) if ctrl_r.status_code == 200 else {}
+        with tracer.span("dashboard.analyze_window"):
+            stages = run_fused_pipeline(sig_payload)
+            if stages is None:
+                stages = run_service_chain(sig_payload)
+        if stages is not None:
+            feat, hsi_d, ai_d, pace = stages
             return {
                 "hr_val": f"{feat.get('heart_rate_bpm', 0):.1f}",
                 "hrv_val": f"{feat.get('hrv_sdnn_ms', 0):.1f}",
@@ -612,6 +589,8 @@ def main():
     source = st.sidebar.radio("INPUT SOURCE", ["Clinical Simulator", "Live MQTT (Sensor)"])
     mode = st.sidebar.selectbox("SCENARIO", ["Normal Sinus", "Tachycardia", "Bradycardia", "Noisy Artifact"]) if source == "Clinical Simulator" else "Live Data"
     speed = st.sidebar.slider("REFRESH (S)", 0.2, 1.0, 0.5)
+    history_range = st.sidebar.selectbox("STORED HISTORY", list(HISTORY_RANGES))
+    history_device = st.sidebar.text_input("HISTORY DEVICE", HISTORY_DEVICE_ID) if HISTORY_RANGES[history_range] else None
 
     if "xai_last_mode" not in st.session_state:
         st.session_state.xai_last_mode = None
@@ -622,32 +601,27 @@ def main():
         st.session_state.xai_last_mode = mode
         st.session_state.xai_last_source = source
     
-    # Initialize MQTT if needed
+    # Live feed from the hub (one shared connection per device)
     if source == "Live MQTT (Sensor)":
-        client = get_mqtt_client()
-        if not client: st.sidebar.error("OFFLINE: MQTT")
-        else: st.sidebar.success("ONLINE: MQTT")
-        if LAST_MQTT_VALUE is not None:
-            st.sidebar.caption(f"LATEST VALUE: {LAST_MQTT_VALUE:.1f}")
-        with st.sidebar.expander("MQTT Debug", expanded=False):
+        live = get_live_feed(LIVE_DEVICE_ID).snapshot()
+        if not live["connected"]: st.sidebar.error("OFFLINE: LIVE HUB")
+        else: st.sidebar.success("ONLINE: LIVE HUB")
+        if live["samples"]:
+            st.sidebar.caption(f"LATEST VALUE: {live['samples'][-1]:.1f}")
+        with st.sidebar.expander("Live Feed Debug", expanded=False):
             age = None
-            if LAST_MQTT_TS is not None:
-                age = time.time() - LAST_MQTT_TS
-            st.write(f"Host: {MQTT_HOST}:{MQTT_PORT}")
-            st.write(f"TCP ok: {LAST_MQTT_TCP_OK}")
-            st.write(f"Messages: {MQTT_MESSAGE_COUNT}")
-            st.write(f"Connected: {MQTT_CONNECTED} (rc={LAST_MQTT_RC})")
+            if live["last_update"] is not None:
+                age = time.time() - live["last_update"]
+            st.write(f"Hub: {live['url']}")
+            st.write(f"Connected: {live['connected']}")
+            st.write(f"Messages: {live['messages']} (resets={live['resets']}, gaps={live['gaps']})")
             st.write(f"Last age (s): {age:.2f}" if age is not None else "Last age (s): --")
-            st.write(f"Topic: {MQTT_TOPIC}")
-            st.write(f"Last payload: {LAST_MQTT_PAYLOAD}")
-            st.write(f"Last error: {LAST_MQTT_ERROR}")
-            if len(MQTT_LOGS) > 0:
-                st.write("MQTT logs (tail)")
-                st.write("\n".join(list(MQTT_LOGS)[-5:]))
-            with SIGNAL_LOCK:
-                if len(MQTT_BUFFER) > 0:
-                    st.write(f"Buffer min/max: {min(MQTT_BUFFER):.1f} / {max(MQTT_BUFFER):.1f}")
-                    st.write(f"Buffer tail: {list(MQTT_BUFFER)[-5:]}")
+            st.write(f"Sequence: {live['seq']}, fs: {live['fs']}")
+            st.write(f"Last command: {live['command']}")
+            st.write(f"Last error: {live['error']}")
+            if live["samples"]:
+                st.write(f"Buffer min/max: {min(live['samples']):.1f} / {max(live['samples']):.1f}")
+                st.write(f"Buffer tail: {live['samples'][-5:]}")
 
     st.sidebar.progress(st.session_state.clinical_data["sqi_score"])
     st.sidebar.caption(f"SIGNAL INTEGRITY: {st.session_state.clinical_data['sqi_score']*100:.1f}%")
@@ -746,9 +720,10 @@ def main():
         margin = (s_max - s_min) * 0.1
         y_range = [s_min - margin, s_max + margin]
         
+        t_plot, y_plot = plot_points(t_vals, raw_vals)
         fig = go.Figure(go.Scatter(
-            x=t_vals,
-            y=raw_vals, 
+            x=t_plot,
+            y=y_plot,
             mode='lines', 
             line=dict(color='#00FF88', width=2.5, shape='spline')
         ))
@@ -773,6 +748,21 @@ def main():
         )
         st.plotly_chart(t_fig, use_container_width=True, config={'displayModeBar': False})
 
+    if history_device:
+        st.markdown(f"<div class='hud-label'>Stored PPG [{history_device} / {history_range}]</div>", unsafe_allow_html=True)
+        history = get_stored_history(history_device, HISTORY_RANGES[history_range])
+        if history is None:
+            st.caption("STORED HISTORY UNAVAILABLE (CONTROL ENGINE / TIME-SERIES STORE)")
+        else:
+            h_fig = go.Figure(go.Scatter(x=history[0], y=history[1], mode='lines', line=dict(color='#00FF88', width=1)))
+            h_fig.update_layout(
+                template="plotly_dark", height=240, margin=dict(l=0,r=0,t=10,b=10),
+                xaxis=dict(showgrid=True, gridcolor="#111"),
+                yaxis=dict(showgrid=True, gridcolor="#111", showticklabels=False),
+                plot_bgcolor="#000000", paper_bgcolor="#000000"
+            )
+            st.plotly_chart(h_fig, use_container_width=True, config={'displayModeBar': False, 'staticPlot': True})
+
     xai_df = load_xai_csv()
     prediction_filter = normalize_rhythm_to_prediction_key(d.get("rhythm_class"))
     model_latest, anchor_ts = select_latest_model_rows(xai_df, prediction_filter)
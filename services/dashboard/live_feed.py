@@ -0,0 +1,146 @@
+"""Dashboard client for the live fan-out hub (services/live-hub).
+
+The hub holds the only broker subscription and pushes each viewer a
+coalesced delta per tick. The dashboard keeps one LiveFeed per device for
+the whole process (st.cache_resource), so Streamlit sessions read a shared
+buffer instead of each running its own MQTT client.
+
+Message format: services/live-hub/LiveHub.h.
+"""
+
+import json
+import threading
+import time
+from collections import deque
+from typing import Any, Dict, List, Optional
+from urllib.parse import quote
+
+try:
+    from websockets.sync.client import connect
+except ImportError:  # websockets < 12, or not installed
+    connect = None
+
+RECONNECT_MIN_S = 0.5
+RECONNECT_MAX_S = 10.0
+RECV_TIMEOUT_S = 1.0
+
+
+def is_available() -> bool:
+    """Return True if the WebSocket client library is installed."""
+    return connect is not None
+
+
+class LiveFeed:
+    """The newest samples and state of one device, kept current from the hub."""
+
+    def __init__(self, base_url: str, device_id: str, maxlen: int = 400, token: Optional[str] = None):
+        """
+        Args:
+            base_url: Hub address, e.g. ws://live-hub:8765
+            device_id: Device to follow
+            maxlen: Samples kept for plotting
+            token: Bearer token, when the hub requires one
+        """
+        self.url = f"{base_url.rstrip('/')}/live?devices={quote(device_id, safe='')}"
+        self.device_id = device_id
+        self.token = token
+        self._lock = threading.Lock()
+        self._samples = deque(maxlen=maxlen)
+        self._seq = None
+        self._fs = 0.0
+        self._command = None
+        self._messages = 0
+        self._resets = 0
+        self._gaps = 0
+        self._last_update = None
+        self._connected = False
+        self._error = None
+        self._stop = threading.Event()
+        self._thread = None
+
+    def apply(self, message: Dict[str, Any]) -> None:
+        """Apply one hub message (the decoded JSON) to the buffer."""
+        with self._lock:
+            self._messages += 1
+            for update in message.get("updates", []):
+                if update.get("device") != self.device_id:
+                    continue
+                samples = update.get("samples", [])
+                seq = int(update["seq"])
+                if update.get("reset"):
+                    self._samples.clear()
+                    self._resets += 1
+                elif self._seq is not None and seq - len(samples) != self._seq:
+                    # Hub restarted: its sequence starts over
+                    self._samples.clear()
+                    self._gaps += 1
+                self._samples.extend(samples)
+                self._seq = seq
+                state = update.get("state")
+                if state is not None:
+                    self._fs = float(state.get("fs") or 0.0)
+                    self._command = state.get("command")
+                self._last_update = time.time()
+
+    def samples(self) -> List[float]:
+        with self._lock:
+            return list(self._samples)
+
+    def snapshot(self) -> Dict[str, Any]:
+        """Buffer, state and connection details for display."""
+        with self._lock:
+            return {
+                "url": self.url,
+                "connected": self._connected,
+                "samples": list(self._samples),
+                "seq": self._seq,
+                "fs": self._fs,
+                "command": self._command,
+                "messages": self._messages,
+                "resets": self._resets,
+                "gaps": self._gaps,
+                "last_update": self._last_update,
+                "error": self._error,
+            }
+
+    def start(self) -> "LiveFeed":
+        """Follow the hub from a daemon thread, reconnecting with backoff."""
+        if self._thread is None:
+            self._thread = threading.Thread(target=self._run, name=f"live-feed-{self.device_id}", daemon=True)
+            self._thread.start()
+        return self
+
+    def stop(self, timeout: float = 5.0) -> None:
+        self._stop.set()
+        if self._thread is not None:
+            self._thread.join(timeout)
+
+    def _run(self) -> None:
+        backoff = RECONNECT_MIN_S
+        headers = {"Authorization": f"Bearer {self.token}"} if self.token else None
+        while not self._stop.is_set():
+            if connect is None:
+                self._set_error("websockets>=12 is not installed")
+                return
+            try:
+                with connect(self.url, additional_headers=headers, open_timeout=5) as ws:
+                    with self._lock:
+                        self._connected = True
+                        self._error = None
+                    backoff = RECONNECT_MIN_S
+                    while not self._stop.is_set():
+                        try:
+                            raw = ws.recv(timeout=RECV_TIMEOUT_S)
+                        except TimeoutError:
+                            continue
+                        self.apply(json.loads(raw))
+            except Exception as e:  # Connection refused, closed, bad message: retry
+                self._set_error(str(e) or type(e).__name__)
+            with self._lock:
+                self._connected = False
+            self._stop.wait(backoff)
+            backoff = min(backoff * 2, RECONNECT_MAX_S)
+
+    def _set_error(self, error: str) -> None:
+        with self._lock:
+            self._error = error
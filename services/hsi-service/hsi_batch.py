@@ -0,0 +1,174 @@
+"""Vectorized Batch HSI Computation.
+
+Columnar counterpart of hsi_computer.compute_hsi for population analytics and
+retrospective re-scoring of stored feature rows. The normalization curves are
+the same piecewise definitions as normalize_heart_rate, normalize_hrv and
+normalize_pulse_amplitude, evaluated over whole numpy arrays so the inner loops
+run in numpy's SIMD kernels instead of the interpreter.
+
+Results are not rounded or logged per row; callers round on output if needed.
+"""
+
+import math
+from typing import Dict, Optional
+
+import numpy as np
+
+from hsi_computer import (
+    HR_MAX,
+    HR_MIN,
+    HR_OPTIMAL,
+    HRV_MAX,
+    HRV_MIN,
+    HSI_EXCELLENT,
+    HSI_FAIR,
+    HSI_GOOD,
+    HSI_POOR,
+    PULSE_AMP_MAX,
+    PULSE_AMP_MIN,
+    WEIGHT_HR,
+    WEIGHT_HRV,
+    WEIGHT_PULSE,
+)
+
+# Category codes returned by interpret_hsi_batch, indexed by code
+# Order matches interpret_hsi from worst to best
+HSI_CATEGORY_NAMES = ("very_poor", "poor", "fair", "good", "excellent")
+_HSI_CATEGORY_THRESHOLDS = np.array([HSI_POOR, HSI_FAIR, HSI_GOOD, HSI_EXCELLENT])
+
+
+# ============================================================================
+# NORMALIZATION KERNELS
+# ============================================================================
+
+def normalize_heart_rate_batch(hr_bpm: np.ndarray) -> np.ndarray:
+    """Vectorized normalize_heart_rate (parabolic, peak at HR_OPTIMAL).
+
+    Args:
+        hr_bpm: Heart rates in BPM
+
+    Returns:
+        Normalized scores between 0 and 1
+    """
+    hr = np.clip(np.asarray(hr_bpm, dtype=np.float64), HR_MIN, HR_MAX)
+    # Below optimal the deviation is scaled by the lower half-width,
+    # above optimal by the upper half-width
+    half_width = np.where(hr < HR_OPTIMAL, HR_OPTIMAL - HR_MIN, HR_MAX - HR_OPTIMAL)
+    deviation = np.abs(hr - HR_OPTIMAL)
+    deviation /= half_width
+    np.square(deviation, out=deviation)
+    np.subtract(1.0, deviation, out=deviation)
+    return np.clip(deviation, 0.0, 1.0, out=deviation)
+
+
+def _normalize_linear(values: np.ndarray, low: float, high: float) -> np.ndarray:
+    """Clamp to [low, high] and scale linearly to [0, 1]."""
+    score = np.clip(np.asarray(values, dtype=np.float64), low, high)
+    score -= low
+    score /= (high - low)
+    return np.clip(score, 0.0, 1.0, out=score)
+
+
+def normalize_hrv_batch(hrv_sdnn_ms: np.ndarray) -> np.ndarray:
+    """Vectorized normalize_hrv (linear between HRV_MIN and HRV_MAX)."""
+    return _normalize_linear(hrv_sdnn_ms, HRV_MIN, HRV_MAX)
+
+
+def normalize_pulse_amplitude_batch(pulse_amp: np.ndarray) -> np.ndarray:
+    """Vectorized normalize_pulse_amplitude (linear between PULSE_AMP_MIN/MAX)."""
+    return _normalize_linear(pulse_amp, PULSE_AMP_MIN, PULSE_AMP_MAX)
+
+
+# ============================================================================
+# BATCH HSI
+# ============================================================================
+
+def interpret_hsi_batch(hsi_scores: np.ndarray) -> np.ndarray:
+    """Vectorized interpret_hsi returning integer category codes.
+
+    Codes index into HSI_CATEGORY_NAMES (0 = very_poor ... 4 = excellent).
+
+    Args:
+        hsi_scores: HSI scores (0-100)
+
+    Returns:
+        int8 array of category codes
+    """
+    codes = np.searchsorted(_HSI_CATEGORY_THRESHOLDS, hsi_scores, side="right")
+    return codes.astype(np.int8)
+
+
+def compute_hsi_batch(
+    heart_rate_bpm: np.ndarray,
+    hrv_sdnn_ms: np.ndarray,
+    pulse_amplitude: np.ndarray,
+    weights: Optional[Dict[str, float]] = None
+) -> Dict[str, np.ndarray]:
+    """Compute HSI for columnar feature arrays.
+
+    Same formula as compute_hsi:
+    HSI = 100 * (w_hr * norm_hr + w_hrv * norm_hrv + w_pulse * norm_pulse)
+
+    Args:
+        heart_rate_bpm: Heart rates in BPM
+        hrv_sdnn_ms: HRV SDNN values in milliseconds
+        pulse_amplitude: Pulse amplitudes in arbitrary units
+        weights: Optional override of 'hr', 'hrv', 'pulse' weights
+            (defaults to WEIGHT_HR, WEIGHT_HRV, WEIGHT_PULSE)
+
+    Returns:
+        Dictionary of float64 arrays keyed like compute_hsi's result
+        ('hsi_score', 'hr_contribution', ..., 'normalized_pulse') plus
+        'category_code' (int8, see HSI_CATEGORY_NAMES)
+
+    Raises:
+        ValueError: If the input arrays are not 1-D, differ in length or hold
+            non-finite values, or a weight is not finite
+    """
+    w_hr, w_hrv, w_pulse = WEIGHT_HR, WEIGHT_HRV, WEIGHT_PULSE
+    if weights:
+        w_hr = float(weights.get("hr", w_hr))
+        w_hrv = float(weights.get("hrv", w_hrv))
+        w_pulse = float(weights.get("pulse", w_pulse))
+    if not all(math.isfinite(w) for w in (w_hr, w_hrv, w_pulse)):
+        raise ValueError(f"Weights must be finite: hr={w_hr}, hrv={w_hrv}, pulse={w_pulse}")
+
+    hr = np.asarray(heart_rate_bpm, dtype=np.float64)
+    hrv = np.asarray(hrv_sdnn_ms, dtype=np.float64)
+    pulse = np.asarray(pulse_amplitude, dtype=np.float64)
+    for name, column in (("heart_rate_bpm", hr), ("hrv_sdnn_ms", hrv), ("pulse_amplitude", pulse)):
+        # NaN would fall past every category threshold into "excellent", and
+        # nested rows would broadcast into a 2-D result
+        if column.ndim != 1:
+            raise ValueError(f"'{name}' must be a flat array of numbers, got {column.ndim}-D")
+        finite = np.isfinite(column)
+        if not finite.all():
+            row = int(np.argmin(finite))
+            raise ValueError(f"'{name}' row {row} is not a finite number: {column[row]}")
+    if not (hr.shape == hrv.shape == pulse.shape):
+        raise ValueError(
+            f"Feature arrays must have equal shape: {hr.shape}, {hrv.shape}, {pulse.shape}"
+        )
+
+    norm_hr = normalize_heart_rate_batch(hr)
+    norm_hrv = normalize_hrv_batch(hrv)
+    norm_pulse = normalize_pulse_amplitude_batch(pulse)
+
+    hr_contrib = norm_hr * w_hr
+    hrv_contrib = norm_hrv * w_hrv
+    pulse_contrib = norm_pulse * w_pulse
+
+    hsi_score = hr_contrib + hrv_contrib
+    hsi_score += pulse_contrib
+    hsi_score *= 100.0
+
+    return {
+        "hsi_score": hsi_score,
+        "hr_contribution": hr_contrib,
+        "hrv_contribution": hrv_contrib,
+        "pulse_contribution": pulse_contrib,
+        "normalized_hr": norm_hr,
+        "normalized_hrv": norm_hrv,
+        "normalized_pulse": norm_pulse,
+        "category_code": interpret_hsi_batch(hsi_score),
+    }
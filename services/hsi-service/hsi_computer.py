@@ -9,15 +9,18 @@ All formulas and constants are documented for transparency and reproducibility.
 
 import os
 import sys
-from datetime import datetime
+from datetime import datetime, timezone
 from typing import Dict, Optional
 
 # Add shared module to path
 sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
-from shared.logger import setup_logger  # noqa: E402
+from shared.logger import hot_path_logger, setup_logger  # noqa: E402
 
 logger = setup_logger("hsi-computer", level="INFO")
 
+# Per-request progress lines: kept to a steady trickle under load
+request_logger = hot_path_logger(logger, per_second=10, burst=20)
+
 
 # ============================================================================
 # CONSTANTS AND NORMALIZATION PARAMETERS
@@ -58,6 +61,11 @@ HSI_POOR = 20.0  # Poor cardiovascular status
 TREND_SIGNIFICANT_THRESHOLD = 5.0  # HSI points - minimum change to be "significant"
 TREND_TIME_WINDOW_SECONDS = 300.0  # 5 minutes - time window for trend rate calculation
 
+# Robust (windowed) trend estimation parameters - see hsi_trend.py
+TREND_ROBUST_MAX_SAMPLES = 32  # Max measurements in the Theil-Sen window (bounds the update cost)
+TREND_MIN_CONFIDENCE = 0.5  # Min pairwise-slope agreement for a non-stable trend
+TREND_EWMA_ALPHA = 0.3  # Smoothing factor for the HSI moving average
+
 
 # ============================================================================
 # NORMALIZATION FUNCTIONS
@@ -184,7 +192,7 @@ def compute_hsi(
         - normalized_hrv: Normalized HRV score (0-1)
         - normalized_pulse: Normalized pulse score (0-1)
     """
-    logger.info(
+    logger.debug(
         f"Computing HSI: HR={heart_rate_bpm}, "
         f"HRV={hrv_sdnn_ms}, Pulse={pulse_amplitude}"
     )
@@ -202,7 +210,7 @@ def compute_hsi(
     # Compute final HSI score (0-100 scale)
     hsi_score = 100.0 * (hr_contrib + hrv_contrib + pulse_contrib)
 
-    logger.info(
+    logger.debug(
         f"HSI computed: {hsi_score:.2f} (HR:{hr_contrib:.3f}, "
         f"HRV:{hrv_contrib:.3f}, Pulse:{pulse_contrib:.3f})"
     )
@@ -243,6 +251,34 @@ def interpret_hsi(hsi_score: float) -> str:
 # TREND CALCULATION
 # ============================================================================
 
+_EPOCH = datetime(1970, 1, 1, tzinfo=timezone.utc)
+
+
+def iso_to_epoch_us(timestamp: str) -> int:
+    """Convert an ISO-8601 timestamp to epoch microseconds.
+
+    Naive timestamps are interpreted as UTC (matching the 'Z'-suffixed
+    timestamps produced by every PulseMind service).
+    
+    Args:
+        timestamp: ISO-8601 timestamp string
+    
+    Returns:
+        Epoch timestamp in microseconds
+    
+    Raises:
+        ValueError: If the timestamp cannot be parsed
+    """
+    try:
+        parsed = datetime.fromisoformat(timestamp.replace('Z', '+00:00'))
+    except (AttributeError, TypeError) as e:
+        raise ValueError(f"Invalid timestamp: {e}")
+    if parsed.tzinfo is None:
+        parsed = parsed.replace(tzinfo=timezone.utc)
+    delta = parsed - _EPOCH
+    return (delta.days * 86400 + delta.seconds) * 1_000_000 + delta.microseconds
+
+
 def compute_trend(
     current_measurement: Dict,
     previous_measurement: Optional[Dict] = None
@@ -267,7 +303,7 @@ def compute_trend(
         - time_elapsed_seconds: Time between measurements
     """
     if previous_measurement is None:
-        logger.info("No previous measurement - trend cannot be computed")
+        request_logger.info("No previous measurement - trend cannot be computed")
         return {
             "delta_hsi": 0.0,
             "delta_per_minute": 0.0,
@@ -305,9 +341,8 @@ def compute_trend(
         trend_direction = "declining"
         is_significant = True
 
-    logger.info(
-        f"Trend: {trend_direction}, delta={delta_hsi:.2f}, "
-        f"rate={delta_per_minute:.2f}/min"
+    request_logger.info(
+        "Trend: %s, delta=%.2f, rate=%.2f/min", trend_direction, delta_hsi, delta_per_minute
     )
 
     return {
@@ -326,17 +361,25 @@ def compute_trend(
 def process_hsi_computation(
     features: Dict,
     previous_measurement: Optional[Dict] = None,
-    timestamp: Optional[str] = None
+    timestamp: Optional[str] = None,
+    device_id: Optional[str] = None,
+    history=None,
+    profile=None
 ) -> Dict:
-    """Main stateless function to compute HSI and trends.
+    """Main function to compute HSI and trends.
 
-    This function is completely stateless - all required data must be provided
-    in the input parameters. No internal state is maintained.
+    This function itself holds no state. Trend history is either supplied by
+    the caller (previous_measurement) or kept in an injected history store
+    keyed by device_id. An explicit previous_measurement always takes precedence.
     
     Args:
         features: Dictionary with 'heart_rate_bpm', 'hrv_sdnn_ms', 'pulse_amplitude'
         previous_measurement: Optional previous measurement for trend calculation
         timestamp: Optional ISO timestamp (defaults to current UTC time)
+        device_id: Optional device identifier for server-side trend history
+        history: Optional HSIHistoryStore used together with device_id
+        profile: Optional CompiledProfile (hsi_profiles.py) replacing the
+            module-level normalization constants
     
     Returns:
         Dictionary with HSI results, interpretation, and trend analysis
@@ -344,7 +387,7 @@ def process_hsi_computation(
     Raises:
         ValueError: If required features are missing or invalid
     """
-    logger.info("Processing HSI computation request")
+    request_logger.info("Processing HSI computation request")
     
     # Validate required features
     required_fields = ["heart_rate_bpm", "hrv_sdnn_ms", "pulse_amplitude"]
@@ -373,7 +416,10 @@ def process_hsi_computation(
         timestamp = datetime.utcnow().isoformat() + 'Z'
     
     # Compute HSI
-    hsi_result = compute_hsi(hr, hrv, pulse)
+    if profile is not None:
+        hsi_result = profile.compute_hsi(hr, hrv, pulse)
+    else:
+        hsi_result = compute_hsi(hr, hrv, pulse)
     hsi_score = hsi_result["hsi_score"]
     
     # Interpret HSI
@@ -386,7 +432,10 @@ def process_hsi_computation(
     }
     
     # Compute trend
-    trend = compute_trend(current_measurement, previous_measurement)
+    if previous_measurement is None and device_id is not None and history is not None:
+        trend = history.record(device_id, hsi_score, iso_to_epoch_us(timestamp))
+    else:
+        trend = compute_trend(current_measurement, previous_measurement)
     
     # Assemble result
     result = {
@@ -395,6 +444,7 @@ def process_hsi_computation(
         "interpretation": interpretation,
         "trend": trend,
         "timestamp": timestamp,
+        "profile_id": profile.profile_id if profile is not None else "default",
         "input_features": {
             "heart_rate_bpm": hr,
             "hrv_sdnn_ms": hrv,
@@ -402,9 +452,8 @@ def process_hsi_computation(
         }
     }
 
-    logger.info(
-        f"HSI computation completed: score={hsi_score:.2f}, "
-        f"interpretation={interpretation}"
+    request_logger.info(
+        "HSI computation completed: score=%.2f, interpretation=%s", hsi_score, interpretation
     )
 
     return result
@@ -0,0 +1,237 @@
+"""Per-Device HSI History Store.
+
+This module keeps a bounded, server-side history of HSI measurements for each
+device so that trends can be computed without the client carrying the previous
+measurement around.
+
+Each device owns a fixed-size ring buffer laid out as a struct-of-arrays:
+- timestamps_us: epoch timestamps in microseconds (signed 64-bit)
+- scores: HSI scores (double)
+
+The delta over TREND_TIME_WINDOW_SECONDS is maintained incrementally: a window
+tail index only ever moves forward, so each new measurement costs amortized O(1)
+regardless of how much history is retained. Trend direction and significance
+come from the robust per-device estimator in hsi_trend.py.
+"""
+
+import os
+import sys
+import threading
+from array import array
+from typing import Dict, Optional
+
+# Add shared module to path
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+from hsi_computer import TREND_TIME_WINDOW_SECONDS  # noqa: E402
+from hsi_trend import TrendEngine  # noqa: E402
+from shared.logger import setup_logger  # noqa: E402
+
+logger = setup_logger("hsi-history", level="INFO")
+
+
+# ============================================================================
+# CONSTANTS
+# ============================================================================
+
+# Ring buffer capacity per device
+# At one measurement every 5 s this covers ~40 minutes of history
+HISTORY_CAPACITY = 512
+
+# Upper bound on tracked devices - least recently updated device is evicted
+MAX_TRACKED_DEVICES = 10000
+
+MICROSECONDS_PER_SECOND = 1_000_000
+TREND_WINDOW_US = int(TREND_TIME_WINDOW_SECONDS * MICROSECONDS_PER_SECOND)
+
+
+# ============================================================================
+# PER-DEVICE RING BUFFER
+# ============================================================================
+
+class DeviceHistory:
+    """Fixed-size ring buffer of HSI measurements for a single device.
+
+    Storage is preallocated at construction; appends never allocate.
+    """
+
+    __slots__ = (
+        "capacity", "timestamps_us", "scores", "head", "count", "tail", "trend_engine"
+    )
+
+    def __init__(self, capacity: int = HISTORY_CAPACITY):
+        """Initialize an empty history of the given capacity."""
+        self.capacity = capacity
+        self.timestamps_us = array('q', bytes(8 * capacity))
+        self.scores = array('d', bytes(8 * capacity))
+        self.head = 0   # Next write slot
+        self.count = 0  # Number of valid entries
+        self.tail = 0   # Oldest entry inside the trend window
+        self.trend_engine = TrendEngine()
+
+    def _slot(self, age: int) -> int:
+        """Return the buffer slot holding the entry `age` steps back (0 = newest)."""
+        return (self.head - 1 - age) % self.capacity
+
+    @property
+    def latest_timestamp_us(self) -> Optional[int]:
+        """Timestamp of the newest entry, or None if empty."""
+        if self.count == 0:
+            return None
+        return self.timestamps_us[self._slot(0)]
+
+    def append(self, timestamp_us: int, hsi_score: float) -> Dict:
+        """Append a measurement and return the windowed trend.
+
+        Trend Logic:
+        - The reference point is the oldest measurement within
+          TREND_TIME_WINDOW_SECONDS of the new one
+        - delta_hsi = current - reference
+        - delta_per_minute = delta_hsi / elapsed * 60
+        - Direction/significance come from the robust TrendEngine estimate
+
+        Args:
+            timestamp_us: Epoch timestamp in microseconds
+            hsi_score: HSI score of the new measurement
+
+        Returns:
+            Trend dictionary compatible with hsi_computer.compute_trend
+
+        Raises:
+            ValueError: If the timestamp precedes the newest stored measurement
+        """
+        latest = self.latest_timestamp_us
+        if latest is not None and timestamp_us < latest:
+            raise ValueError("Timestamp precedes the last recorded measurement")
+
+        # Write into the ring; if it is full the oldest slot (possibly the
+        # window tail) is overwritten, so drag the tail forward with it
+        if self.count == self.capacity and self.tail == self.head:
+            self.tail = (self.tail + 1) % self.capacity
+        self.timestamps_us[self.head] = timestamp_us
+        self.scores[self.head] = hsi_score
+        self.head = (self.head + 1) % self.capacity
+        self.count = min(self.count + 1, self.capacity)
+
+        # Advance the window tail past expired measurements (amortized O(1))
+        newest = self._slot(0)
+        window_start = timestamp_us - TREND_WINDOW_US
+        while self.tail != newest and self.timestamps_us[self.tail] < window_start:
+            self.tail = (self.tail + 1) % self.capacity
+
+        robust = self.trend_engine.update(timestamp_us, hsi_score)
+
+        window_samples = (newest - self.tail) % self.capacity + 1
+        if window_samples < 2:
+            return {
+                "delta_hsi": 0.0,
+                "delta_per_minute": 0.0,
+                "time_elapsed_seconds": 0.0,
+                "window_samples": window_samples,
+                **robust,
+            }
+
+        delta_hsi = hsi_score - self.scores[self.tail]
+        time_elapsed = (timestamp_us - self.timestamps_us[self.tail]) / MICROSECONDS_PER_SECOND
+
+        if time_elapsed > 0:
+            delta_per_minute = (delta_hsi / time_elapsed) * 60.0
+        else:
+            delta_per_minute = 0.0
+
+        return {
+            "delta_hsi": round(delta_hsi, 2),
+            "delta_per_minute": round(delta_per_minute, 3),
+            "time_elapsed_seconds": round(time_elapsed, 1),
+            "window_samples": window_samples,
+            **robust,
+        }
+
+
+# ============================================================================
+# MULTI-DEVICE STORE
+# ============================================================================
+
+class HSIHistoryStore:
+    """Thread-safe map of device id -> DeviceHistory.
+
+    Bounded to MAX_TRACKED_DEVICES; the least recently updated device is
+    evicted when a new one arrives at capacity.
+    """
+
+    def __init__(
+        self,
+        capacity: int = HISTORY_CAPACITY,
+        max_devices: int = MAX_TRACKED_DEVICES
+    ):
+        """Initialize an empty store."""
+        self.capacity = capacity
+        self.max_devices = max_devices
+        self._devices: Dict[str, DeviceHistory] = {}
+        self._lock = threading.Lock()
+
+    def record(self, device_id: str, hsi_score: float, timestamp_us: int) -> Dict:
+        """Record a measurement for a device and return its windowed trend.
+
+        Args:
+            device_id: Device identifier
+            hsi_score: HSI score of the new measurement
+            timestamp_us: Epoch timestamp in microseconds
+
+        Returns:
+            Trend dictionary (see DeviceHistory.append)
+
+        Raises:
+            ValueError: If the timestamp is older than the device's last measurement
+        """
+        with self._lock:
+            history = self._devices.pop(device_id, None)
+            if history is None:
+                if len(self._devices) >= self.max_devices:
+                    # Dicts preserve insertion order; re-inserting on every
+                    # update keeps the least recently updated device first
+                    evicted = next(iter(self._devices))
+                    del self._devices[evicted]
+                    logger.info(f"Evicted HSI history for idle device {evicted}")
+                history = DeviceHistory(self.capacity)
+            self._devices[device_id] = history
+            return history.append(timestamp_us, hsi_score)
+
+    def get_history(self, device_id: str, limit: Optional[int] = None) -> list:
+        """Return stored measurements for a device, oldest first.
+
+        Args:
+            device_id: Device identifier
+            limit: Optional maximum number of (newest) measurements to return
+
+        Returns:
+            List of {'timestamp_us', 'hsi_score'} dicts
+        """
+        with self._lock:
+            history = self._devices.get(device_id)
+            if history is None:
+                return []
+            n = history.count if limit is None else min(limit, history.count)
+            return [
+                {
+                    "timestamp_us": history.timestamps_us[history._slot(age)],
+                    "hsi_score": history.scores[history._slot(age)],
+                }
+                for age in range(n - 1, -1, -1)
+            ]
+
+    def clear(self, device_id: Optional[str] = None):
+        """Drop history for one device, or for all devices."""
+        with self._lock:
+            if device_id is None:
+                self._devices.clear()
+            else:
+                self._devices.pop(device_id, None)
+
+    def __len__(self) -> int:
+        """Number of tracked devices."""
+        with self._lock:
+            return len(self._devices)
+
+
+# Global store shared by the service process
+history_store = HSIHistoryStore()
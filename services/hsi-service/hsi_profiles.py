@@ -0,0 +1,377 @@
+"""Per-Patient / Per-Cohort HSI Normalization Profiles.
+
+The module constants in hsi_computer.py describe a single adult reference curve.
+Athletes (low resting HR, high HRV) and elderly patients are scored unfairly
+against it. This module lets each device be scored against its own profile.
+
+Each profile is compiled once into a flat coefficient table:
+- HR: two quadratic segments (below / above optimal), evaluated with Horner's rule
+- HRV and pulse amplitude: one linear segment each (offset + slope)
+Every segment is evaluated on the clamped input and clamped to [0, 1], which is
+algebraically identical to the formulas in hsi_computer.py.
+
+Scoring cost is therefore one dict lookup plus a fixed number of arithmetic
+operations, independent of how many profiles are loaded. Updates replace the
+profile maps atomically (copy-on-write), so they apply immediately without a
+service restart and readers never take a lock.
+
+The table is plain Python rather than a native library: a compiled profile is
+ten coefficients, and evaluating one is cheaper than a ctypes call into a
+native table would be.
+"""
+
+import json
+import math
+import os
+import sys
+import threading
+from typing import Dict, Optional
+
+# Add shared module to path
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+from hsi_computer import (  # noqa: E402
+    HR_MAX,
+    HR_MIN,
+    HR_OPTIMAL,
+    HRV_MAX,
+    HRV_MIN,
+    PULSE_AMP_MAX,
+    PULSE_AMP_MIN,
+    WEIGHT_HR,
+    WEIGHT_HRV,
+    WEIGHT_PULSE,
+)
+from shared.logger import setup_logger  # noqa: E402
+
+logger = setup_logger("hsi-profiles", level="INFO")
+
+# Profile used when a device has no assignment
+DEFAULT_PROFILE_ID = "default"
+
+# Path segments of other /profiles/... routes, which PUT /profiles/<id> would
+# otherwise take as profile ids
+RESERVED_PROFILE_IDS = frozenset({"reload", "assignments"})
+
+# Optional JSON file loaded at startup and on /profiles/reload
+PROFILES_PATH = os.getenv("HSI_PROFILES_PATH")
+
+# Profile parameters and their defaults (the global reference curve)
+PROFILE_DEFAULTS = {
+    "hr_min": HR_MIN,
+    "hr_max": HR_MAX,
+    "hr_optimal": HR_OPTIMAL,
+    "hrv_min": HRV_MIN,
+    "hrv_max": HRV_MAX,
+    "pulse_amp_min": PULSE_AMP_MIN,
+    "pulse_amp_max": PULSE_AMP_MAX,
+    "weight_hr": WEIGHT_HR,
+    "weight_hrv": WEIGHT_HRV,
+    "weight_pulse": WEIGHT_PULSE,
+}
+
+
+# ============================================================================
+# COMPILED PROFILE
+# ============================================================================
+
+class CompiledProfile:
+    """A normalization profile compiled into polynomial coefficient tables.
+
+    HR segment below optimal, with d = HR_OPT - HR_MIN:
+        1 - ((opt - x) / d)^2 = (1 - opt^2/d^2) + (2 opt/d^2) x - (1/d^2) x^2
+    and the same form above optimal with d = HR_MAX - HR_OPT.
+
+    Linear segments:
+        (x - min) / (max - min) = -min/(max - min) + x/(max - min)
+    """
+
+    __slots__ = (
+        "profile_id", "params",
+        "hr_min", "hr_max", "hr_optimal", "hr_lo", "hr_hi",
+        "hrv_min", "hrv_max", "hrv_coef",
+        "pulse_min", "pulse_max", "pulse_coef",
+        "weight_hr", "weight_hrv", "weight_pulse",
+    )
+
+    def __init__(self, profile_id: str, params: Dict[str, float]):
+        """Validate parameters and compile coefficient tables.
+
+        Args:
+            profile_id: Profile identifier
+            params: Profile parameters (missing keys use PROFILE_DEFAULTS)
+
+        Raises:
+            ValueError: If params is not a dict, or a parameter is unknown,
+                non-numeric or inconsistent
+        """
+        if not isinstance(params, dict):
+            raise ValueError(f"Parameters of profile '{profile_id}' must be an object")
+        unknown = set(params) - set(PROFILE_DEFAULTS)
+        if unknown:
+            raise ValueError(f"Unknown profile parameter(s): {sorted(unknown)}")
+
+        p = dict(PROFILE_DEFAULTS)
+        try:
+            p.update({k: float(v) for k, v in params.items()})
+        except (TypeError, ValueError) as e:
+            raise ValueError(f"Invalid profile parameter value: {e}")
+        # NaN fails every comparison below without raising, and an infinite
+        # bound makes a zero slope; neither can score a patient
+        non_finite = sorted(k for k, v in p.items() if not math.isfinite(v))
+        if non_finite:
+            raise ValueError(f"Profile parameter(s) must be finite: {non_finite}")
+
+        if not p["hr_min"] < p["hr_optimal"] < p["hr_max"]:
+            raise ValueError("Profile requires hr_min < hr_optimal < hr_max")
+        if not p["hrv_min"] < p["hrv_max"]:
+            raise ValueError("Profile requires hrv_min < hrv_max")
+        if not p["pulse_amp_min"] < p["pulse_amp_max"]:
+            raise ValueError("Profile requires pulse_amp_min < pulse_amp_max")
+        weights = (p["weight_hr"], p["weight_hrv"], p["weight_pulse"])
+        if min(weights) < 0 or abs(sum(weights) - 1.0) > 1e-6:
+            raise ValueError("Profile weights must be non-negative and sum to 1.0")
+
+        self.profile_id = profile_id
+        self.params = p
+
+        self.hr_min = p["hr_min"]
+        self.hr_max = p["hr_max"]
+        self.hr_optimal = opt = p["hr_optimal"]
+        self.hr_lo = self._quadratic(opt, opt - p["hr_min"])
+        self.hr_hi = self._quadratic(opt, p["hr_max"] - opt)
+
+        self.hrv_min = p["hrv_min"]
+        self.hrv_max = p["hrv_max"]
+        self.hrv_coef = self._linear(p["hrv_min"], p["hrv_max"])
+
+        self.pulse_min = p["pulse_amp_min"]
+        self.pulse_max = p["pulse_amp_max"]
+        self.pulse_coef = self._linear(p["pulse_amp_min"], p["pulse_amp_max"])
+
+        self.weight_hr, self.weight_hrv, self.weight_pulse = weights
+
+    @staticmethod
+    def _quadratic(optimal: float, half_width: float) -> tuple:
+        """Coefficients (c0, c1, c2) of 1 - ((x - optimal) / half_width)^2."""
+        inv = 1.0 / (half_width * half_width)
+        return (1.0 - optimal * optimal * inv, 2.0 * optimal * inv, -inv)
+
+    @staticmethod
+    def _linear(low: float, high: float) -> tuple:
+        """Coefficients (c0, c1) of (x - low) / (high - low)."""
+        inv = 1.0 / (high - low)
+        return (-low * inv, inv)
+
+    def normalize_heart_rate(self, hr_bpm: float) -> float:
+        """Profile-specific normalize_heart_rate."""
+        x = max(self.hr_min, min(self.hr_max, hr_bpm))
+        c0, c1, c2 = self.hr_lo if x < self.hr_optimal else self.hr_hi
+        return max(0.0, min(1.0, c0 + x * (c1 + x * c2)))
+
+    def normalize_hrv(self, hrv_sdnn_ms: float) -> float:
+        """Profile-specific normalize_hrv."""
+        x = max(self.hrv_min, min(self.hrv_max, hrv_sdnn_ms))
+        c0, c1 = self.hrv_coef
+        return max(0.0, min(1.0, c0 + x * c1))
+
+    def normalize_pulse_amplitude(self, pulse_amp: float) -> float:
+        """Profile-specific normalize_pulse_amplitude."""
+        x = max(self.pulse_min, min(self.pulse_max, pulse_amp))
+        c0, c1 = self.pulse_coef
+        return max(0.0, min(1.0, c0 + x * c1))
+
+    def compute_hsi(
+        self,
+        heart_rate_bpm: float,
+        hrv_sdnn_ms: float,
+        pulse_amplitude: float
+    ) -> Dict[str, float]:
+        """Profile-specific compute_hsi (same result keys and rounding)."""
+        norm_hr = self.normalize_heart_rate(heart_rate_bpm)
+        norm_hrv = self.normalize_hrv(hrv_sdnn_ms)
+        norm_pulse = self.normalize_pulse_amplitude(pulse_amplitude)
+
+        hr_contrib = self.weight_hr * norm_hr
+        hrv_contrib = self.weight_hrv * norm_hrv
+        pulse_contrib = self.weight_pulse * norm_pulse
+        hsi_score = 100.0 * (hr_contrib + hrv_contrib + pulse_contrib)
+
+        return {
+            "hsi_score": round(hsi_score, 2),
+            "hr_contribution": round(hr_contrib, 4),
+            "hrv_contribution": round(hrv_contrib, 4),
+            "pulse_contribution": round(pulse_contrib, 4),
+            "normalized_hr": round(norm_hr, 4),
+            "normalized_hrv": round(norm_hrv, 4),
+            "normalized_pulse": round(norm_pulse, 4)
+        }
+
+
+# ============================================================================
+# PROFILE TABLE
+# ============================================================================
+
+class ProfileTable:
+    """Registry of compiled profiles and device -> profile assignments.
+
+    Reads are lock-free: both maps are immutable snapshots swapped atomically
+    by writers, which serialize on a lock among themselves.
+    """
+
+    def __init__(self):
+        """Initialize with only the default profile."""
+        self._write_lock = threading.Lock()
+        self._profiles: Dict[str, CompiledProfile] = {
+            DEFAULT_PROFILE_ID: CompiledProfile(DEFAULT_PROFILE_ID, {})
+        }
+        self._assignments: Dict[str, str] = {}
+
+    @staticmethod
+    def _check_profile_id(profile_id: str):
+        """Reject ids that are not strings or are reserved route names."""
+        if not isinstance(profile_id, str) or not profile_id:
+            raise ValueError("Profile ids must be non-empty strings")
+        if profile_id in RESERVED_PROFILE_IDS:
+            raise ValueError(f"Profile id '{profile_id}' is reserved")
+
+    def put_profile(self, profile_id: str, params: Dict[str, float]) -> CompiledProfile:
+        """Create or replace a profile.
+
+        Raises:
+            ValueError: If the id is reserved or the parameters are invalid
+        """
+        self._check_profile_id(profile_id)
+        compiled = CompiledProfile(profile_id, params)
+        with self._write_lock:
+            profiles = dict(self._profiles)
+            profiles[profile_id] = compiled
+            self._profiles = profiles
+        logger.info(f"HSI profile '{profile_id}' updated")
+        return compiled
+
+    def delete_profile(self, profile_id: str) -> bool:
+        """Delete a profile and any assignments to it.
+
+        Raises:
+            ValueError: If attempting to delete the default profile
+        """
+        if profile_id == DEFAULT_PROFILE_ID:
+            raise ValueError("The default profile cannot be deleted")
+        with self._write_lock:
+            if profile_id not in self._profiles:
+                return False
+            profiles = dict(self._profiles)
+            del profiles[profile_id]
+            self._assignments = {
+                d: p for d, p in self._assignments.items() if p != profile_id
+            }
+            self._profiles = profiles
+        logger.info(f"HSI profile '{profile_id}' deleted")
+        return True
+
+    def assign(self, device_id: str, profile_id: Optional[str]):
+        """Assign a device to a profile (None removes the assignment).
+
+        Raises:
+            ValueError: If the profile does not exist
+        """
+        with self._write_lock:
+            if profile_id is not None and profile_id not in self._profiles:
+                raise ValueError(f"Unknown profile: '{profile_id}'")
+            assignments = dict(self._assignments)
+            if profile_id is None:
+                assignments.pop(device_id, None)
+            else:
+                assignments[device_id] = profile_id
+            self._assignments = assignments
+
+    def get(self, profile_id: str) -> Optional[CompiledProfile]:
+        """Return a compiled profile by id."""
+        return self._profiles.get(profile_id)
+
+    def resolve(
+        self,
+        device_id: Optional[str] = None,
+        profile_id: Optional[str] = None
+    ) -> CompiledProfile:
+        """Resolve the profile for a request.
+
+        Precedence: explicit profile_id, then the device assignment, then default.
+
+        Raises:
+            ValueError: If an explicit profile_id does not exist
+        """
+        profiles = self._profiles
+        if profile_id is not None:
+            compiled = profiles.get(profile_id)
+            if compiled is None:
+                raise ValueError(f"Unknown profile: '{profile_id}'")
+            return compiled
+        if device_id is not None:
+            assigned = self._assignments.get(device_id)
+            if assigned is not None and assigned in profiles:
+                return profiles[assigned]
+        return profiles[DEFAULT_PROFILE_ID]
+
+    def load(self, config: Dict):
+        """Replace all profiles and assignments from a config dict.
+
+        Format:
+        {
+            "profiles": {"athlete": {"hr_optimal": 55, "hr_min": 35, ...}, ...},
+            "assignments": {"ESP32_PulseMind_01": "athlete", ...}
+        }
+
+        Raises:
+            ValueError: If the config is malformed or any profile is invalid
+                (nothing is applied)
+        """
+        if not isinstance(config, dict):
+            raise ValueError("Profile config must be an object")
+        config_profiles = config.get("profiles", {})
+        config_assignments = config.get("assignments", {})
+        if not isinstance(config_profiles, dict):
+            raise ValueError("Profile config 'profiles' must be an object")
+        if not isinstance(config_assignments, dict):
+            raise ValueError("Profile config 'assignments' must be an object")
+
+        profiles = {DEFAULT_PROFILE_ID: CompiledProfile(DEFAULT_PROFILE_ID, {})}
+        for pid, params in config_profiles.items():
+            self._check_profile_id(pid)
+            profiles[pid] = CompiledProfile(pid, params)
+        assignments = dict(config_assignments)
+        if not all(isinstance(pid, str) for pid in assignments.values()):
+            raise ValueError("Profile config assignments must map device ids to profile ids")
+        missing = set(assignments.values()) - set(profiles)
+        if missing:
+            raise ValueError(f"Assignments reference unknown profile(s): {sorted(missing)}")
+
+        with self._write_lock:
+            self._profiles = profiles
+            self._assignments = assignments
+        logger.info(
+            f"Loaded {len(profiles)} HSI profiles and {len(assignments)} assignments"
+        )
+
+    def load_file(self, path: str):
+        """Load profiles from a JSON file (see load)."""
+        with open(path) as f:
+            self.load(json.load(f))
+
+    def summary(self) -> Dict:
+        """Return profile parameters and assignment count."""
+        profiles = self._profiles
+        return {
+            "profiles": {pid: c.params for pid, c in profiles.items()},
+            "total_assignments": len(self._assignments),
+        }
+
+
+# Global table shared by the service process
+profile_table = ProfileTable()
+
+if PROFILES_PATH and os.path.exists(PROFILES_PATH):
+    try:
+        profile_table.load_file(PROFILES_PATH)
+    except (OSError, ValueError) as e:
+        logger.error(f"Failed to load HSI profiles from {PROFILES_PATH}: {e}")
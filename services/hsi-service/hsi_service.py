@@ -7,14 +7,34 @@ from flask import Flask, jsonify, request
 
 # Add shared module to path
 sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+import numpy as np  # noqa: E402
+from hsi_batch import HSI_CATEGORY_NAMES, compute_hsi_batch  # noqa: E402
 from hsi_computer import process_hsi_computation  # noqa: E402
+from hsi_history import history_store  # noqa: E402
+from hsi_profiles import PROFILES_PATH, profile_table  # noqa: E402
+from shared import metrics  # noqa: E402
 from shared.logger import setup_logger  # noqa: E402
 from shared.shutdown import register_shutdown_handler  # noqa: E402
+from shared.tracing import instrument_flask, setup_tracing  # noqa: E402
 
 # Initialize logger
 logger = setup_logger("hsi-service", level="INFO")
 
 app = Flask(__name__)
+instrument_flask(app, setup_tracing("hsi-service"))
+registry = metrics.instrument_flask(app, "hsi-service")
+compute_seconds = registry.histogram(
+    "pulsemind_processing_duration_seconds", "Time spent in a service's processing steps",
+    service="hsi-service", operation="compute_hsi",
+)
+batch_seconds = registry.histogram(
+    "pulsemind_processing_duration_seconds", "Time spent in a service's processing steps",
+    service="hsi-service", operation="compute_hsi_batch",
+)
+
+# Maximum rows accepted by /compute-hsi-batch in a single HTTP request
+# Larger archives should call hsi_batch.compute_hsi_batch directly
+MAX_BATCH_ROWS = 100000
 
 
 @app.route('/health')
@@ -40,7 +60,13 @@ def root():
         "description": "Hemodynamic Surrogate Index (HSI) Computation Service",
         "endpoints": {
             "/health": "Health check",
-            "/compute-hsi": "POST - Compute HSI from PPG features"
+            "/compute-hsi": "POST - Compute HSI from PPG features",
+            "/compute-hsi-batch": "POST - Compute HSI for columnar feature arrays",
+            "/history/<device_id>": "GET - Recent HSI measurements for a device",
+            "/profiles": "GET - List normalization profiles",
+            "/profiles/<profile_id>": "PUT/DELETE - Create, replace or delete a profile",
+            "/profiles/assignments/<device_id>": "PUT - Assign a device to a profile",
+            "/profiles/reload": "POST - Reload profiles from HSI_PROFILES_PATH"
         },
         "timestamp": datetime.utcnow().isoformat() + 'Z'
     })
@@ -57,7 +83,9 @@ def compute_hsi():
             "hrv_sdnn_ms": 45.3,
             "pulse_amplitude": 15.2
         },
-        "previous_measurement": {  // Optional
+        "device_id": "ESP32_PulseMind_01",  // Optional - enables server-side trend
+        "profile_id": "athlete",  // Optional - overrides the device's profile
+        "previous_measurement": {  // Optional - overrides server-side history
             "hsi_score": 65.4,
             "timestamp": "2026-01-01T14:30:00.000000Z"
         },
@@ -127,6 +155,15 @@ def compute_hsi():
     # Extract optional fields
     previous_measurement = data.get('previous_measurement')
     timestamp = data.get('timestamp')
+    device_id = data.get('device_id')
+    
+    # Validate device_id if provided
+    if device_id is not None and (not isinstance(device_id, str) or not device_id):
+        logger.warning(f"Invalid device_id type: {type(device_id)}")
+        return jsonify({
+            "success": False,
+            "error": "Field 'device_id' must be a non-empty string"
+        }), 400
     
     # Validate previous_measurement if provided
     if previous_measurement is not None:
@@ -155,11 +192,16 @@ def compute_hsi():
 
     # Process HSI computation
     try:
-        result = process_hsi_computation(features, previous_measurement, timestamp)
+        profile = profile_table.resolve(device_id, data.get('profile_id'))
+        result = process_hsi_computation(
+            features, previous_measurement, timestamp,
+            device_id=device_id, history=history_store, profile=profile
+        )
         
         # Add processing time
         processing_time_ms = (time.time() - start_time) * 1000
         result["processing_time_ms"] = round(processing_time_ms, 2)
+        compute_seconds.observe(processing_time_ms / 1000)
         
         # Add timestamp (required by schema)
         result["timestamp"] = datetime.utcnow().isoformat() + "Z"
@@ -184,6 +226,210 @@ def compute_hsi():
         }), 500
 
 
+@app.route('/compute-hsi-batch', methods=['POST'])
+def compute_hsi_batch_endpoint():
+    """Compute HSI for many feature rows in one call.
+
+    Expected JSON payload (columnar, equal-length arrays):
+    {
+        "heart_rate_bpm": [72.5, 88.0, ...],
+        "hrv_sdnn_ms": [45.3, 30.1, ...],
+        "pulse_amplitude": [15.2, 22.0, ...],
+        "weights": {"hr": 0.35, "hrv": 0.40, "pulse": 0.25}  // Optional
+    }
+    
+    Returns:
+    {
+        "success": true,
+        "count": 2,
+        "hsi_score": [...],
+        "hr_contribution": [...],
+        ...
+        "interpretation": ["good", "fair", ...]
+    }
+    """
+    start_time = time.time()
+
+    if not request.is_json:
+        return jsonify({
+            "success": False,
+            "error": "Request must have Content-Type: application/json"
+        }), 400
+
+    data = request.get_json(silent=True)
+    if not isinstance(data, dict):
+        return jsonify({"success": False, "error": "Invalid JSON body"}), 400
+
+    columns = []
+    for field in ("heart_rate_bpm", "hrv_sdnn_ms", "pulse_amplitude"):
+        values = data.get(field)
+        if not isinstance(values, list):
+            return jsonify({
+                "success": False,
+                "error": f"Field '{field}' must be an array"
+            }), 400
+        try:
+            # JSON null becomes NaN here; compute_hsi_batch rejects it before scoring
+            columns.append(np.asarray(values, dtype=np.float64))
+        except (TypeError, ValueError) as e:
+            return jsonify({
+                "success": False,
+                "error": f"Invalid value in '{field}': {e}"
+            }), 400
+
+    count = len(columns[0])
+    if count > MAX_BATCH_ROWS:
+        return jsonify({
+            "success": False,
+            "error": f"Batch too large: {count} rows (max {MAX_BATCH_ROWS})"
+        }), 400
+
+    weights = data.get("weights")
+    if weights is not None and not isinstance(weights, dict):
+        return jsonify({
+            "success": False,
+            "error": "Field 'weights' must be an object"
+        }), 400
+
+    try:
+        result = compute_hsi_batch(*columns, weights=weights)
+    except (TypeError, ValueError) as e:
+        logger.warning(f"HSI batch validation error: {e}")
+        return jsonify({"success": False, "error": str(e)}), 400
+
+    response = {
+        "success": True,
+        "count": count,
+        "hsi_score": np.round(result["hsi_score"], 2).tolist(),
+        "interpretation": [HSI_CATEGORY_NAMES[c] for c in result["category_code"]],
+    }
+    for key in (
+        "hr_contribution", "hrv_contribution", "pulse_contribution",
+        "normalized_hr", "normalized_hrv", "normalized_pulse"
+    ):
+        response[key] = np.round(result[key], 4).tolist()
+
+    processing_time_ms = (time.time() - start_time) * 1000
+    response["processing_time_ms"] = round(processing_time_ms, 2)
+    batch_seconds.observe(processing_time_ms / 1000)
+    response["timestamp"] = datetime.utcnow().isoformat() + "Z"
+
+    logger.info(f"HSI batch of {count} rows computed in {processing_time_ms:.2f}ms")
+    return jsonify(response), 200
+
+
+@app.route('/history/<device_id>')
+def get_history(device_id):
+    """Return the most recent HSI measurements recorded for a device.
+
+    Query parameters:
+        limit: Maximum number of measurements to return (default 100)
+    """
+    try:
+        limit = int(request.args.get('limit', 100))
+    except ValueError:
+        return jsonify({
+            "success": False,
+            "error": "Query parameter 'limit' must be an integer"
+        }), 400
+
+    measurements = history_store.get_history(device_id, limit=max(0, limit))
+    return jsonify({
+        "success": True,
+        "device_id": device_id,
+        "count": len(measurements),
+        "measurements": measurements,
+        "timestamp": datetime.utcnow().isoformat() + 'Z'
+    }), 200
+
+
+@app.route('/profiles')
+def list_profiles():
+    """List loaded normalization profiles."""
+    return jsonify({
+        "success": True,
+        **profile_table.summary(),
+        "timestamp": datetime.utcnow().isoformat() + 'Z'
+    }), 200
+
+
+@app.route('/profiles/<profile_id>', methods=['PUT', 'DELETE'])
+def update_profile(profile_id):
+    """Create, replace or delete a normalization profile.
+
+    PUT payload (all fields optional, defaults are the global constants):
+    {
+        "hr_min": 35, "hr_max": 110, "hr_optimal": 55,
+        "hrv_min": 20, "hrv_max": 150,
+        "pulse_amp_min": 5, "pulse_amp_max": 50,
+        "weight_hr": 0.35, "weight_hrv": 0.40, "weight_pulse": 0.25
+    }
+    """
+    try:
+        if request.method == 'DELETE':
+            if not profile_table.delete_profile(profile_id):
+                return jsonify({
+                    "success": False,
+                    "error": f"Profile '{profile_id}' not found"
+                }), 404
+            return jsonify({"success": True, "profile_id": profile_id}), 200
+
+        params = request.get_json(silent=True)
+        if not isinstance(params, dict):
+            return jsonify({
+                "success": False,
+                "error": "Profile parameters must be a JSON object"
+            }), 400
+        compiled = profile_table.put_profile(profile_id, params)
+        return jsonify({
+            "success": True,
+            "profile_id": profile_id,
+            "params": compiled.params
+        }), 200
+    except ValueError as e:
+        logger.warning(f"Profile update rejected: {e}")
+        return jsonify({"success": False, "error": str(e)}), 400
+
+
+@app.route('/profiles/assignments/<device_id>', methods=['PUT'])
+def assign_profile(device_id):
+    """Assign a device to a profile.
+
+    Payload: {"profile_id": "athlete"}  (null removes the assignment)
+    """
+    data = request.get_json(silent=True)
+    if not isinstance(data, dict) or 'profile_id' not in data:
+        return jsonify({
+            "success": False,
+            "error": "Missing required field: 'profile_id'"
+        }), 400
+    try:
+        profile_table.assign(device_id, data['profile_id'])
+    except ValueError as e:
+        return jsonify({"success": False, "error": str(e)}), 400
+    return jsonify({
+        "success": True,
+        "device_id": device_id,
+        "profile_id": data['profile_id']
+    }), 200
+
+
+@app.route('/profiles/reload', methods=['POST'])
+def reload_profiles():
+    """Reload profiles and assignments from HSI_PROFILES_PATH."""
+    if not PROFILES_PATH:
+        return jsonify({
+            "success": False,
+            "error": "HSI_PROFILES_PATH is not configured"
+        }), 400
+    try:
+        profile_table.load_file(PROFILES_PATH)
+    except (OSError, ValueError) as e:
+        logger.error(f"Failed to reload HSI profiles: {e}")
+        return jsonify({"success": False, "error": str(e)}), 400
+    return jsonify({"success": True, **profile_table.summary()}), 200
+
+
 if __name__ == '__main__':
     register_shutdown_handler(logger)
     logger.info("Starting hsi-service on port 8002")
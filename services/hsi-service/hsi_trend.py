@@ -0,0 +1,213 @@
+"""Incremental Robust HSI Trend Estimation.
+
+Two-point deltas flip between "improving" and "declining" on measurement noise.
+This module maintains, per device, a bounded window of recent measurements and
+updates three estimators incrementally as each measurement arrives:
+
+1. Online least-squares slope (running sums, O(1) add/remove)
+2. Exponentially weighted moving average of the HSI score
+3. Theil-Sen slope: the median of all pairwise slopes in the window
+
+Cost contract: the window is capped at w = max_samples (TREND_ROBUST_MAX_SAMPLES
+= 32, at most TREND_MAX_SAMPLES_LIMIT = 64), and the cap is what bounds the cost
+of an update. O(log n) per update is not reachable for an exact Theil-Sen slope:
+every new measurement pairs with each of the w - 1 points already held, so
+w - 1 slopes enter (and up to w - 1 leave) the order-statistic set whatever
+structure holds it. Here that set is a sorted list of at most w(w - 1)/2 slopes:
+each insertion/removal is an O(log w) binary search plus a memmove of up to
+w^2/2 floats, so an update costs O(w log w) comparisons and O(w^3) moved
+words, about 40 us at w = 32. The median and the sign-agreement confidence are
+then read in O(1)/O(log w). A balanced order-statistic tree would cut the moves
+to O(w log w) but costs more than the memmove at these sizes in pure Python;
+raising the cap beyond the limit needs one.
+
+Trend Decision:
+    projected_change = theil_sen_slope * window_span
+    - |projected_change| < TREND_SIGNIFICANT_THRESHOLD -> stable
+    - confidence < TREND_MIN_CONFIDENCE -> stable
+    - otherwise improving/declining by the sign of the slope
+
+Confidence is the net fraction of pairwise slopes agreeing in sign:
+    confidence = |n_positive - n_negative| / n_slopes
+"""
+
+from bisect import bisect_left, bisect_right, insort
+from collections import deque
+from typing import Dict, Optional
+
+from hsi_computer import (
+    TREND_EWMA_ALPHA,
+    TREND_MIN_CONFIDENCE,
+    TREND_ROBUST_MAX_SAMPLES,
+    TREND_SIGNIFICANT_THRESHOLD,
+    TREND_TIME_WINDOW_SECONDS,
+)
+
+MICROSECONDS_PER_SECOND = 1_000_000
+
+# Largest window the sorted-list slope set is meant for (see the cost contract)
+TREND_MAX_SAMPLES_LIMIT = 64
+
+
+class TrendEngine:
+    """Per-device incremental trend estimator over a bounded window.
+
+    A measurement leaves the window when it is older than window_seconds
+    relative to the newest one, or when more than max_samples are held.
+    """
+
+    __slots__ = (
+        "max_samples", "window_seconds", "ewma_alpha",
+        "_origin_us", "_points", "_slopes",
+        "_sum_t", "_sum_y", "_sum_tt", "_sum_ty",
+        "ewma",
+    )
+
+    def __init__(
+        self,
+        max_samples: int = TREND_ROBUST_MAX_SAMPLES,
+        window_seconds: float = TREND_TIME_WINDOW_SECONDS,
+        ewma_alpha: float = TREND_EWMA_ALPHA
+    ):
+        """Initialize an empty estimator.
+
+        Raises:
+            ValueError: If max_samples is outside 2..TREND_MAX_SAMPLES_LIMIT
+        """
+        if not 2 <= max_samples <= TREND_MAX_SAMPLES_LIMIT:
+            raise ValueError(f"max_samples must be between 2 and {TREND_MAX_SAMPLES_LIMIT}")
+        self.max_samples = max_samples
+        self.window_seconds = window_seconds
+        self.ewma_alpha = ewma_alpha
+
+        # Times are stored in seconds relative to the first measurement to
+        # keep the least-squares running sums well conditioned
+        self._origin_us: Optional[int] = None
+        self._points: deque = deque()
+        self._slopes: list = []
+
+        self._sum_t = 0.0
+        self._sum_y = 0.0
+        self._sum_tt = 0.0
+        self._sum_ty = 0.0
+
+        self.ewma: Optional[float] = None
+
+    @staticmethod
+    def _pair_slope(earlier: tuple, later: tuple) -> Optional[float]:
+        """Slope between two points (HSI points/second), None if simultaneous.
+
+        Always computed in (earlier, later) order so that insertion and removal
+        produce bit-identical values.
+        """
+        dt = later[0] - earlier[0]
+        if dt <= 0:
+            return None
+        return (later[1] - earlier[1]) / dt
+
+    def _evict_oldest(self):
+        """Remove the oldest point and every pairwise slope it participates in."""
+        oldest = self._points.popleft()
+        for point in self._points:
+            slope = self._pair_slope(oldest, point)
+            if slope is not None:
+                del self._slopes[bisect_left(self._slopes, slope)]
+
+        t, y = oldest
+        self._sum_t -= t
+        self._sum_y -= y
+        self._sum_tt -= t * t
+        self._sum_ty -= t * y
+
+    def update(self, timestamp_us: int, hsi_score: float) -> Dict:
+        """Add a measurement and return the current trend estimates.
+
+        Args:
+            timestamp_us: Epoch timestamp in microseconds (non-decreasing)
+            hsi_score: HSI score of the new measurement
+
+        Returns:
+            Dictionary containing:
+            - trend_direction: 'improving', 'stable', or 'declining'
+            - is_significant: Whether the robust trend is significant
+            - slope_per_minute: Theil-Sen slope (HSI points per minute)
+            - ols_slope_per_minute: Least-squares slope (HSI points per minute)
+            - ewma_hsi: Exponentially weighted moving average of HSI
+            - confidence: Pairwise slope sign agreement (0-1)
+        """
+        if self._origin_us is None:
+            self._origin_us = timestamp_us
+        t = (timestamp_us - self._origin_us) / MICROSECONDS_PER_SECOND
+        point = (t, hsi_score)
+
+        # Expire by age and by count before inserting
+        while self._points and (
+            len(self._points) >= self.max_samples
+            or self._points[0][0] < t - self.window_seconds
+        ):
+            self._evict_oldest()
+
+        for earlier in self._points:
+            slope = self._pair_slope(earlier, point)
+            if slope is not None:
+                insort(self._slopes, slope)
+        self._points.append(point)
+
+        self._sum_t += t
+        self._sum_y += hsi_score
+        self._sum_tt += t * t
+        self._sum_ty += t * hsi_score
+
+        # EWMA
+        if self.ewma is None:
+            self.ewma = hsi_score
+        else:
+            self.ewma += self.ewma_alpha * (hsi_score - self.ewma)
+
+        # Least-squares slope
+        n = len(self._points)
+        denom = n * self._sum_tt - self._sum_t * self._sum_t
+        if n >= 2 and denom > 1e-12:
+            ols_slope = (n * self._sum_ty - self._sum_t * self._sum_y) / denom
+        else:
+            ols_slope = 0.0
+
+        # Theil-Sen median slope and sign agreement
+        m = len(self._slopes)
+        if m == 0:
+            median_slope = 0.0
+            confidence = 0.0
+        else:
+            mid = m // 2
+            if m % 2:
+                median_slope = self._slopes[mid]
+            else:
+                median_slope = 0.5 * (self._slopes[mid - 1] + self._slopes[mid])
+            n_negative = bisect_left(self._slopes, 0.0)
+            n_positive = m - bisect_right(self._slopes, 0.0)
+            confidence = abs(n_positive - n_negative) / m
+
+        span = self._points[-1][0] - self._points[0][0]
+        projected_change = median_slope * span
+
+        if (
+            abs(projected_change) < TREND_SIGNIFICANT_THRESHOLD
+            or confidence < TREND_MIN_CONFIDENCE
+        ):
+            trend_direction = "stable"
+            is_significant = False
+        elif median_slope > 0:
+            trend_direction = "improving"
+            is_significant = True
+        else:
+            trend_direction = "declining"
+            is_significant = True
+
+        return {
+            "trend_direction": trend_direction,
+            "is_significant": is_significant,
+            "slope_per_minute": round(median_slope * 60.0, 3),
+            "ols_slope_per_minute": round(ols_slope * 60.0, 3),
+            "ewma_hsi": round(self.ewma, 2),
+            "confidence": round(confidence, 3),
+        }
@@ -10,6 +10,10 @@ from datetime import datetime, timedelta
 # Add the hsi-service directory to the path for imports
 sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
 
+import numpy as np
+
+from hsi_batch import HSI_CATEGORY_NAMES, compute_hsi_batch, interpret_hsi_batch
+from hsi_profiles import DEFAULT_PROFILE_ID, ProfileTable
 from hsi_computer import (
     HR_OPTIMAL,
     HRV_MAX,
@@ -382,5 +386,184 @@ class TestProcessHSIComputation(unittest.TestCase):
         self.assertEqual(result['timestamp'], custom_timestamp)
 
 
+class TestBatchComputation(unittest.TestCase):
+    """Test the vectorized batch kernel against the scalar implementation."""
+
+    def setUp(self):
+        rng = np.random.default_rng(7)
+        n = 500
+        self.hr = np.concatenate([rng.uniform(20.0, 200.0, n), [40.0, 70.0, 120.0]])
+        self.hrv = np.concatenate([rng.uniform(0.0, 150.0, n), [10.0, 50.0, 100.0]])
+        self.pulse = np.concatenate([rng.uniform(0.0, 80.0, n), [5.0, 25.0, 50.0]])
+
+    def test_matches_scalar_implementation(self):
+        """Test that every batch row equals compute_hsi/interpret_hsi."""
+        result = compute_hsi_batch(self.hr, self.hrv, self.pulse)
+        for i in range(len(self.hr)):
+            expected = compute_hsi(self.hr[i], self.hrv[i], self.pulse[i])
+            for key, value in expected.items():
+                places = 2 if key == 'hsi_score' else 4
+                self.assertAlmostEqual(round(result[key][i], places), value, places=places)
+            self.assertEqual(
+                HSI_CATEGORY_NAMES[result['category_code'][i]],
+                interpret_hsi(result['hsi_score'][i])
+            )
+
+    def test_category_boundaries(self):
+        """Test that category thresholds are inclusive like interpret_hsi."""
+        scores = np.array([0.0, 19.99, 20.0, 40.0, 60.0, 80.0, 100.0])
+        names = [HSI_CATEGORY_NAMES[c] for c in interpret_hsi_batch(scores)]
+        self.assertEqual(names, [interpret_hsi(s) for s in scores])
+
+    def test_weight_override(self):
+        """Test re-scoring with different weights."""
+        result = compute_hsi_batch(
+            [70.0], [10.0], [5.0], weights={"hr": 1.0, "hrv": 0.0, "pulse": 0.0}
+        )
+        self.assertAlmostEqual(result['hsi_score'][0], 100.0, places=6)
+
+    def test_mismatched_lengths(self):
+        """Test that unequal column lengths are rejected."""
+        with self.assertRaises(ValueError):
+            compute_hsi_batch([70.0, 80.0], [50.0], [25.0])
+
+    def test_non_finite_and_nested_rejected(self):
+        """Test that NaN, inf and nested rows are rejected instead of scored."""
+        for hr in ([70.0, float("nan")], [70.0, float("inf")], [[70.0], [80.0]]):
+            with self.assertRaises(ValueError):
+                compute_hsi_batch(hr, [50.0, 50.0], [25.0, 25.0])
+        with self.assertRaises(ValueError):
+            compute_hsi_batch([70.0], [50.0], [25.0], weights={"hr": float("nan")})
+
+    def test_endpoint_rejects_null_row(self):
+        """Test that a JSON null row gets a 400 with valid JSON, not a NaN score."""
+        import hsi_service
+        client = hsi_service.app.test_client()
+        for hr in ([72.0, None], [[72.0], [80.0]]):
+            response = client.post("/compute-hsi-batch", json={
+                "heart_rate_bpm": hr, "hrv_sdnn_ms": [45.0, 45.0], "pulse_amplitude": [15.0, 15.0]
+            })
+            self.assertEqual(response.status_code, 400, hr)
+            self.assertFalse(response.get_json()["success"])
+            self.assertIn("heart_rate_bpm", response.get_json()["error"])
+        response = client.post("/compute-hsi-batch", json={
+            "heart_rate_bpm": [72.0, 80.0], "hrv_sdnn_ms": [45.0, 45.0], "pulse_amplitude": [15.0, 15.0]
+        })
+        self.assertEqual(response.status_code, 200)
+        self.assertEqual(response.get_json()["count"], 2)
+
+
+class TestNormalizationProfiles(unittest.TestCase):
+    """Test compiled per-patient normalization profiles."""
+
+    def setUp(self):
+        self.table = ProfileTable()
+
+    def test_default_profile_matches_module_constants(self):
+        """Test that the compiled default curve equals compute_hsi."""
+        profile = self.table.resolve()
+        for hr in range(20, 201, 7):
+            for hrv in (0.0, 10.0, 33.3, 50.0, 100.0, 140.0):
+                for pulse in (0.0, 5.0, 17.5, 25.0, 50.0, 70.0):
+                    self.assertEqual(
+                        profile.compute_hsi(hr, hrv, pulse), compute_hsi(hr, hrv, pulse)
+                    )
+
+    def test_athlete_profile_peaks_at_its_optimum(self):
+        """Test that a custom optimum receives a perfect HR score."""
+        self.table.put_profile("athlete", {"hr_min": 35, "hr_optimal": 52, "hr_max": 110})
+        athlete = self.table.get("athlete")
+        self.assertAlmostEqual(athlete.normalize_heart_rate(52.0), 1.0, places=6)
+        self.assertAlmostEqual(athlete.normalize_heart_rate(35.0), 0.0, places=6)
+        self.assertGreater(
+            athlete.normalize_heart_rate(50.0), normalize_heart_rate(50.0)
+        )
+
+    def test_invalid_profiles_rejected(self):
+        """Test validation of profile parameters."""
+        with self.assertRaises(ValueError):
+            self.table.put_profile("bad", {"hr_min": 80, "hr_optimal": 70})
+        with self.assertRaises(ValueError):
+            self.table.put_profile("bad", {"weight_hr": 0.9})
+        with self.assertRaises(ValueError):
+            self.table.put_profile("bad", {"unknown": 1})
+        with self.assertRaises(ValueError):
+            self.table.put_profile("bad", {"weight_hr": float("nan")})
+        with self.assertRaises(ValueError):
+            self.table.put_profile("bad", {"hr_max": float("inf")})
+        with self.assertRaises(ValueError):
+            self.table.put_profile("bad", {"hrv_min": 100.0, "hrv_max": 100.0})
+        self.assertIsNone(self.table.get("bad"))
+
+    def test_malformed_config_rejected(self):
+        """Test that non-object configs and params raise ValueError, leaving the table as is."""
+        self.table.put_profile("athlete", {"hr_optimal": 55})
+        for config in (
+            [], {"profiles": []}, {"profiles": {"x": [1, 2]}}, {"profiles": {"x": 5}},
+            {"assignments": ["dev-1"]}, {"assignments": {"dev-1": ["athlete"]}},
+        ):
+            with self.assertRaises(ValueError, msg=config):
+                self.table.load(config)
+        self.assertIsNotNone(self.table.get("athlete"))
+
+    def test_reserved_profile_ids(self):
+        """Test that route names cannot become profile ids."""
+        for pid in ("reload", "assignments"):
+            with self.assertRaises(ValueError):
+                self.table.put_profile(pid, {})
+            with self.assertRaises(ValueError):
+                self.table.load({"profiles": {pid: {}}})
+            self.assertIsNone(self.table.get(pid))
+
+    def test_profile_endpoints_reject_bad_input(self):
+        """Test 400s for a reserved id and for malformed reload files."""
+        import json
+        import tempfile
+        from unittest import mock
+
+        import hsi_service
+        client = hsi_service.app.test_client()
+        response = client.put("/profiles/reload", json={"hr_optimal": 55})
+        self.assertEqual(response.status_code, 400)
+        self.assertNotIn("reload", client.get("/profiles").get_json()["profiles"])
+
+        with tempfile.NamedTemporaryFile("w", suffix=".json", delete=False) as f:
+            json.dump({"profiles": {"athlete": "fast"}}, f)
+        try:
+            with mock.patch.object(hsi_service, "PROFILES_PATH", f.name):
+                response = client.post("/profiles/reload")
+        finally:
+            os.remove(f.name)
+        self.assertEqual(response.status_code, 400)
+        self.assertIn("must be an object", response.get_json()["error"])
+
+    def test_resolution_precedence(self):
+        """Test explicit profile > device assignment > default."""
+        self.table.put_profile("elderly", {"hr_optimal": 75})
+        self.table.put_profile("athlete", {"hr_optimal": 55})
+        self.table.assign("dev-1", "elderly")
+        self.assertEqual(self.table.resolve("dev-1").profile_id, "elderly")
+        self.assertEqual(self.table.resolve("dev-1", "athlete").profile_id, "athlete")
+        self.assertEqual(self.table.resolve("dev-2").profile_id, DEFAULT_PROFILE_ID)
+        with self.assertRaises(ValueError):
+            self.table.resolve("dev-1", "missing")
+
+    def test_delete_removes_assignments(self):
+        """Test that deleting a profile falls back to the default."""
+        self.table.put_profile("elderly", {"hr_optimal": 75})
+        self.table.assign("dev-1", "elderly")
+        self.assertTrue(self.table.delete_profile("elderly"))
+        self.assertEqual(self.table.resolve("dev-1").profile_id, DEFAULT_PROFILE_ID)
+
+    def test_process_with_profile(self):
+        """Test that process_hsi_computation scores against the given profile."""
+        self.table.put_profile("athlete", {"hr_min": 35, "hr_optimal": 50, "hr_max": 110})
+        features = {"heart_rate_bpm": 50.0, "hrv_sdnn_ms": 45.0, "pulse_amplitude": 20.0}
+        default = process_hsi_computation(features)
+        athlete = process_hsi_computation(features, profile=self.table.get("athlete"))
+        self.assertEqual(athlete['profile_id'], "athlete")
+        self.assertGreater(athlete['hsi']['hsi_score'], default['hsi']['hsi_score'])
+
+
 if __name__ == '__main__':
     unittest.main()
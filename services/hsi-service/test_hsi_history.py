@@ -0,0 +1,224 @@
+"""Unit tests for the per-device HSI history store.
+
+Tests ring buffer behavior, windowed trend computation, and device isolation.
+"""
+import sys
+import os
+import unittest
+
+# Add the hsi-service directory to the path for imports
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+from hsi_computer import iso_to_epoch_us, process_hsi_computation
+from hsi_history import (
+    MICROSECONDS_PER_SECOND,
+    DeviceHistory,
+    HSIHistoryStore,
+)
+from hsi_trend import TREND_MAX_SAMPLES_LIMIT, TrendEngine
+
+T0 = 1_767_225_600 * MICROSECONDS_PER_SECOND  # 2026-01-01T00:00:00Z
+
+
+def seconds(n: float) -> int:
+    """Convert seconds to microseconds."""
+    return int(n * MICROSECONDS_PER_SECOND)
+
+
+class TestTimestampConversion(unittest.TestCase):
+    """Test ISO timestamp to epoch microsecond conversion."""
+
+    def test_zulu_timestamp(self):
+        """Test 'Z'-suffixed timestamp conversion."""
+        self.assertEqual(iso_to_epoch_us("2026-01-01T00:00:00.000000Z"), T0)
+
+    def test_naive_timestamp_is_utc(self):
+        """Test that naive timestamps are treated as UTC."""
+        self.assertEqual(iso_to_epoch_us("2026-01-01T00:00:01.5"), T0 + seconds(1.5))
+
+    def test_invalid_timestamp(self):
+        """Test that unparseable timestamps raise ValueError."""
+        with self.assertRaises(ValueError):
+            iso_to_epoch_us("yesterday")
+
+
+class TestDeviceHistory(unittest.TestCase):
+    """Test the single-device ring buffer."""
+
+    def test_first_measurement_is_stable(self):
+        """Test that a single measurement yields a stable trend."""
+        history = DeviceHistory(capacity=8)
+        trend = history.append(T0, 60.0)
+        self.assertEqual(trend['trend_direction'], 'stable')
+        self.assertEqual(trend['window_samples'], 1)
+
+    def test_improving_trend(self):
+        """Test improving trend within the window."""
+        history = DeviceHistory(capacity=8)
+        history.append(T0, 60.0)
+        trend = history.append(T0 + seconds(60), 70.0)
+        self.assertEqual(trend['trend_direction'], 'improving')
+        self.assertTrue(trend['is_significant'])
+        self.assertAlmostEqual(trend['delta_per_minute'], 10.0, places=2)
+
+    def test_window_drops_old_measurements(self):
+        """Test that measurements older than the window are not the reference."""
+        history = DeviceHistory(capacity=64)
+        history.append(T0, 20.0)  # Falls out of the 300 s window
+        history.append(T0 + seconds(400), 60.0)
+        trend = history.append(T0 + seconds(500), 62.0)
+        self.assertAlmostEqual(trend['delta_hsi'], 2.0, places=2)
+        self.assertEqual(trend['window_samples'], 2)
+        self.assertEqual(trend['trend_direction'], 'stable')
+
+    def test_ring_wraparound(self):
+        """Test that a full ring overwrites the oldest entries."""
+        history = DeviceHistory(capacity=4)
+        for i in range(10):
+            trend = history.append(T0 + seconds(i), 50.0 + i)
+        self.assertEqual(history.count, 4)
+        self.assertEqual(trend['window_samples'], 4)
+        self.assertAlmostEqual(trend['delta_hsi'], 3.0, places=2)
+
+    def test_out_of_order_rejected(self):
+        """Test that timestamps older than the newest entry are rejected."""
+        history = DeviceHistory(capacity=8)
+        history.append(T0 + seconds(10), 60.0)
+        with self.assertRaises(ValueError):
+            history.append(T0, 60.0)
+
+
+class TestTrendEngine(unittest.TestCase):
+    """Test the incremental robust trend estimator."""
+
+    def test_noisy_flat_series_is_stable(self):
+        """Test that alternating noise does not flip the trend direction."""
+        engine = TrendEngine(max_samples=16)
+        directions = set()
+        for i in range(40):
+            score = 60.0 + (7.0 if i % 2 else -7.0)  # Two-point deltas of 14
+            trend = engine.update(T0 + seconds(10 * i), score)
+            if i >= 2:  # Two points alone are indistinguishable from a real trend
+                directions.add(trend['trend_direction'])
+        self.assertEqual(directions, {'stable'})
+
+    def test_steady_decline(self):
+        """Test that a consistent decline is detected with full confidence."""
+        engine = TrendEngine(max_samples=16)
+        for i in range(10):
+            trend = engine.update(T0 + seconds(30 * i), 80.0 - 2.0 * i)
+        self.assertEqual(trend['trend_direction'], 'declining')
+        self.assertAlmostEqual(trend['slope_per_minute'], -4.0, places=3)
+        self.assertAlmostEqual(trend['ols_slope_per_minute'], -4.0, places=3)
+        self.assertEqual(trend['confidence'], 1.0)
+
+    def test_outlier_resistance(self):
+        """Test that a single outlier does not move the Theil-Sen slope."""
+        engine = TrendEngine(max_samples=16)
+        for i in range(9):
+            engine.update(T0 + seconds(30 * i), 60.0)
+        trend = engine.update(T0 + seconds(270), 10.0)
+        self.assertEqual(trend['slope_per_minute'], 0.0)
+        self.assertEqual(trend['trend_direction'], 'stable')
+
+    def test_window_cap_is_enforced(self):
+        """Test that windows outside the documented cost contract are refused."""
+        for max_samples in (1, TREND_MAX_SAMPLES_LIMIT + 1):
+            with self.assertRaises(ValueError):
+                TrendEngine(max_samples=max_samples)
+        engine = TrendEngine(max_samples=TREND_MAX_SAMPLES_LIMIT)
+        for i in range(TREND_MAX_SAMPLES_LIMIT + 5):
+            engine.update(T0 + seconds(i), 60.0 + i)
+        self.assertEqual(len(engine._slopes), TREND_MAX_SAMPLES_LIMIT * (TREND_MAX_SAMPLES_LIMIT - 1) // 2)
+
+    def test_matches_batch_estimates_after_eviction(self):
+        """Test incremental slopes against a from-scratch computation."""
+        engine = TrendEngine(max_samples=8)
+        scores = [61.0, 64.5, 59.0, 70.2, 66.1, 72.3, 68.8, 75.0, 71.4, 79.9, 74.6, 82.0]
+        for i, score in enumerate(scores):
+            trend = engine.update(T0 + seconds(20 * i), score)
+
+        window = [(20.0 * i, y) for i, y in enumerate(scores)][-8:]
+        slopes = sorted(
+            (yj - yi) / (tj - ti)
+            for k, (ti, yi) in enumerate(window)
+            for (tj, yj) in window[k + 1:]
+        )
+        median = 0.5 * (slopes[len(slopes) // 2 - 1] + slopes[len(slopes) // 2])
+        self.assertAlmostEqual(trend['slope_per_minute'], round(median * 60.0, 3), places=3)
+
+        n = len(window)
+        st = sum(t for t, _ in window)
+        sy = sum(y for _, y in window)
+        stt = sum(t * t for t, _ in window)
+        sty = sum(t * y for t, y in window)
+        ols = (n * sty - st * sy) / (n * stt - st * st)
+        self.assertAlmostEqual(trend['ols_slope_per_minute'], round(ols * 60.0, 3), places=2)
+
+
+class TestHSIHistoryStore(unittest.TestCase):
+    """Test the multi-device store."""
+
+    def test_devices_are_isolated(self):
+        """Test that each device has its own trend."""
+        store = HSIHistoryStore(capacity=8)
+        store.record("dev-a", 60.0, T0)
+        store.record("dev-b", 80.0, T0)
+        trend_a = store.record("dev-a", 70.0, T0 + seconds(30))
+        trend_b = store.record("dev-b", 70.0, T0 + seconds(30))
+        self.assertEqual(trend_a['trend_direction'], 'improving')
+        self.assertEqual(trend_b['trend_direction'], 'declining')
+
+    def test_lru_eviction(self):
+        """Test that the least recently updated device is evicted."""
+        store = HSIHistoryStore(capacity=8, max_devices=2)
+        store.record("dev-a", 60.0, T0)
+        store.record("dev-b", 60.0, T0)
+        store.record("dev-a", 61.0, T0 + seconds(1))
+        store.record("dev-c", 60.0, T0)
+        self.assertEqual(len(store), 2)
+        self.assertEqual(store.get_history("dev-b"), [])
+        self.assertEqual(len(store.get_history("dev-a")), 2)
+
+    def test_get_history_order_and_limit(self):
+        """Test that history is returned oldest first and honors the limit."""
+        store = HSIHistoryStore(capacity=8)
+        for i in range(5):
+            store.record("dev", 50.0 + i, T0 + seconds(i))
+        measurements = store.get_history("dev", limit=3)
+        self.assertEqual([m['hsi_score'] for m in measurements], [52.0, 53.0, 54.0])
+
+
+class TestProcessWithHistory(unittest.TestCase):
+    """Test process_hsi_computation with server-side history."""
+
+    FEATURES = {"heart_rate_bpm": 72.0, "hrv_sdnn_ms": 45.0, "pulse_amplitude": 20.0}
+
+    def test_trend_without_previous_measurement(self):
+        """Test that device history replaces client-supplied previous measurement."""
+        store = HSIHistoryStore(capacity=8)
+        process_hsi_computation(
+            {"heart_rate_bpm": 72.0, "hrv_sdnn_ms": 20.0, "pulse_amplitude": 10.0},
+            timestamp="2026-01-01T00:00:00Z", device_id="dev", history=store
+        )
+        result = process_hsi_computation(
+            self.FEATURES, timestamp="2026-01-01T00:01:00Z",
+            device_id="dev", history=store
+        )
+        self.assertEqual(result['trend']['trend_direction'], 'improving')
+        self.assertEqual(result['trend']['window_samples'], 2)
+
+    def test_previous_measurement_takes_precedence(self):
+        """Test that an explicit previous measurement bypasses the store."""
+        store = HSIHistoryStore(capacity=8)
+        result = process_hsi_computation(
+            self.FEATURES,
+            previous_measurement={"hsi_score": 0.0, "timestamp": "2026-01-01T00:00:00Z"},
+            timestamp="2026-01-01T00:01:00Z", device_id="dev", history=store
+        )
+        self.assertNotIn('window_samples', result['trend'])
+        self.assertEqual(len(store), 0)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,271 @@
+#ifndef PULSEMIND_DEVICE_STREAM_H
+#define PULSEMIND_DEVICE_STREAM_H
+
+/**
+ * Per-device streaming state for the ingest worker.
+ *
+ * DeviceStream turns a device's frames into overlapping analysis windows:
+ * the last STREAM_WINDOW_SECONDS of samples, re-analyzed every
+ * STREAM_HOP_SECONDS. TrendTracker is the hsi-service trend estimator
+ * (hsi_trend.TrendEngine) reduced to the direction the policy consumes.
+ *
+ * Each device is owned by exactly one worker thread, so nothing here is
+ * synchronized.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <vector>
+
+#include "SafetyPolicy.h"
+
+namespace pulsemind {
+
+// ==========================================
+// Streaming Constants
+// ==========================================
+constexpr double STREAM_WINDOW_SECONDS = 4.0;     // Window the dashboard sends to /process
+constexpr double STREAM_HOP_SECONDS = 1.0;        // One decision per device per second
+constexpr uint64_t STREAM_GAP_TOLERANCE_MS = 250; // Timestamp jitter before a frame counts as a gap
+constexpr double DEFAULT_SAMPLING_RATE_HZ = 100.0; // Firmware ADC_SAMPLE_RATE_HZ
+constexpr int64_t CLOCK_REANCHOR_US = 2 * 1000 * 1000; // Device/wall clock disagreement before re-anchoring
+
+// hsi_computer.py trend constants
+constexpr double TREND_SIGNIFICANT_THRESHOLD = 5.0;
+constexpr double TREND_TIME_WINDOW_SECONDS = 300.0;
+constexpr size_t TREND_ROBUST_MAX_SAMPLES = 32;
+constexpr double TREND_MIN_CONFIDENCE = 0.5;
+
+/**
+ * Python's round(x, 2): printf rounds the exact binary value to nearest,
+ * ties to even, as CPython's float rounding does.
+ */
+inline double roundTo2(double x) {
+    char text[64];
+    snprintf(text, sizeof(text), "%.2f", x);
+    return strtod(text, nullptr);
+}
+
+// ==========================================
+// HSI Trend
+// ==========================================
+
+/**
+ * Theil-Sen trend direction over a bounded window (TrendEngine.update).
+ *
+ * The window holds at most TREND_ROBUST_MAX_SAMPLES points, so the pairwise
+ * slopes (<= 496) are recomputed per update instead of being maintained
+ * incrementally; eviction, median and sign agreement follow TrendEngine.
+ */
+class TrendTracker {
+public:
+    Trend update(double timeSec, double hsiScore) {
+        if (!hasOrigin_) {
+            origin_ = timeSec;
+            hasOrigin_ = true;
+        }
+        const double t = timeSec - origin_;
+        while (!points_.empty() &&
+               (points_.size() >= TREND_ROBUST_MAX_SAMPLES || points_.front().t < t - TREND_TIME_WINDOW_SECONDS)) {
+            points_.pop_front();
+        }
+        points_.push_back({t, hsiScore});
+
+        slopes_.clear();
+        for (size_t i = 0; i < points_.size(); i++) {
+            for (size_t j = i + 1; j < points_.size(); j++) {
+                const double dt = points_[j].t - points_[i].t;
+                if (dt > 0) {
+                    slopes_.push_back((points_[j].y - points_[i].y) / dt);
+                }
+            }
+        }
+        const size_t m = slopes_.size();
+        if (m == 0) {
+            return Trend::Stable;
+        }
+        std::sort(slopes_.begin(), slopes_.end());
+        const size_t mid = m / 2;
+        const double median = (m % 2) ? slopes_[mid] : 0.5 * (slopes_[mid - 1] + slopes_[mid]);
+        const size_t negative = static_cast<size_t>(std::lower_bound(slopes_.begin(), slopes_.end(), 0.0) - slopes_.begin());
+        const size_t positive = m - static_cast<size_t>(std::upper_bound(slopes_.begin(), slopes_.end(), 0.0) - slopes_.begin());
+        const double confidence =
+            static_cast<double>(positive > negative ? positive - negative : negative - positive) / static_cast<double>(m);
+
+        const double projected = median * (points_.back().t - points_.front().t);
+        if (std::fabs(projected) < TREND_SIGNIFICANT_THRESHOLD || confidence < TREND_MIN_CONFIDENCE) {
+            return Trend::Stable;
+        }
+        return median > 0 ? Trend::Improving : Trend::Declining;
+    }
+
+private:
+    struct Point {
+        double t;
+        double y;
+    };
+
+    bool hasOrigin_ = false;
+    double origin_ = 0.0;
+    std::deque<Point> points_;
+    std::vector<double> slopes_;
+};
+
+// ==========================================
+// Sample Windows
+// ==========================================
+
+/**
+ * Ring of a device's most recent samples.
+ *
+ * Frames with timestamps are checked for continuity: a frame that starts
+ * more than STREAM_GAP_TOLERANCE_MS away from where the previous one ended
+ * (dropped frames, a device reboot, reordering) restarts the window, so a
+ * window never spans a discontinuity.
+ */
+class DeviceStream {
+public:
+    enum class Append { Buffered, WindowReady };
+
+    double samplingRate() const { return samplingRate_; }
+    size_t windowLength() const { return ring_.size(); }
+    uint64_t gaps() const { return gaps_; }
+
+    Append append(const double* samples, size_t n, double samplingRate, bool hasTimestamp, uint64_t timestampMs) {
+        if (samplingRate != samplingRate_) {
+            configure(samplingRate);
+        }
+        if (hasTimestamp) {
+            if (hasNextTimestamp_ && (timestampMs + STREAM_GAP_TOLERANCE_MS < nextTimestampMs_ ||
+                                      timestampMs > nextTimestampMs_ + STREAM_GAP_TOLERANCE_MS)) {
+                restart();
+                gaps_++;
+            }
+            nextTimestampMs_ = timestampMs + static_cast<uint64_t>(std::llround(n * 1000.0 / samplingRate_));
+            hasNextTimestamp_ = true;
+        }
+        const size_t capacity = ring_.size();
+        for (size_t i = 0; i < n; i++) {
+            ring_[head_] = samples[i];
+            head_ = (head_ + 1 == capacity) ? 0 : head_ + 1;
+        }
+        filled_ = std::min(capacity, filled_ + n);
+        sinceWindow_ += n;
+        return (filled_ == capacity && sinceWindow_ >= hop_) ? Append::WindowReady : Append::Buffered;
+    }
+
+    /**
+     * Copy the window oldest-first into out (windowLength() values) and start
+     * counting toward the next hop.
+     */
+    void takeWindow(double* out) {
+        const size_t capacity = ring_.size();
+        std::copy(ring_.begin() + head_, ring_.end(), out);
+        std::copy(ring_.begin(), ring_.begin() + head_, out + (capacity - head_));
+        sinceWindow_ = 0;
+    }
+
+private:
+    void configure(double samplingRate) {
+        samplingRate_ = samplingRate;
+        ring_.assign(static_cast<size_t>(std::llround(STREAM_WINDOW_SECONDS * samplingRate)), 0.0);
+        hop_ = static_cast<size_t>(std::llround(STREAM_HOP_SECONDS * samplingRate));
+        hasNextTimestamp_ = false;
+        restart();
+    }
+
+    void restart() {
+        head_ = 0;
+        filled_ = 0;
+        sinceWindow_ = 0;
+    }
+
+    double samplingRate_ = 0.0;
+    std::vector<double> ring_;
+    size_t hop_ = 0;
+    size_t head_ = 0;
+    size_t filled_ = 0;
+    size_t sinceWindow_ = 0;
+    bool hasNextTimestamp_ = false;
+    uint64_t nextTimestampMs_ = 0;
+    uint64_t gaps_ = 0;
+};
+
+// ==========================================
+// Sample Times
+// ==========================================
+
+/**
+ * Wall-clock (Unix epoch) times of a device's samples, for the time-series
+ * store, so stored waveforms line up with decision timestamps.
+ *
+ * Device timestamps are uptime milliseconds: the offset to wall time is
+ * taken when a frame arrives and kept while the two clocks agree within
+ * CLOCK_REANCHOR_US, so sample spacing follows the device clock; a reboot
+ * or a long stall re-anchors. Frames without timestamps continue where the
+ * previous frame ended. Sample times never go backwards.
+ */
+class SampleClock {
+public:
+    /**
+     * Time of the frame's first sample; sample i is at start + i * periodUs.
+     * arrivalUs is the wall-clock time the frame arrived.
+     */
+    int64_t frameStart(size_t n, double samplingRate, bool hasTimestamp, uint64_t timestampMs, int64_t arrivalUs) {
+        periodUs_ = std::llround(1e6 / samplingRate);
+        // The last sample was taken no later than the frame arrived
+        const int64_t arrivalStart = arrivalUs - static_cast<int64_t>(n > 0 ? n - 1 : 0) * periodUs_;
+        int64_t start;
+        if (hasTimestamp) {
+            const int64_t deviceUs = static_cast<int64_t>(timestampMs) * 1000;
+            start = offsetUs_ + deviceUs;
+            if (!anchored_ || std::llabs(start - arrivalStart) > CLOCK_REANCHOR_US) {
+                offsetUs_ = arrivalStart - deviceUs;
+                start = arrivalStart;
+                anchored_ = true;
+            }
+        } else {
+            start = hasNext_ ? nextUs_ : arrivalStart;
+            if (std::llabs(start - arrivalStart) > CLOCK_REANCHOR_US) {
+                start = arrivalStart;
+            }
+            anchored_ = false;
+        }
+        if (hasNext_) {
+            start = std::max(start, nextUs_);
+        }
+        nextUs_ = start + static_cast<int64_t>(n) * periodUs_;
+        hasNext_ = true;
+        return start;
+    }
+
+    int64_t periodUs() const { return periodUs_; }
+
+private:
+    bool anchored_ = false;
+    int64_t offsetUs_ = 0;
+    bool hasNext_ = false;
+    int64_t nextUs_ = 0;
+    int64_t periodUs_ = 10000;
+};
+
+/**
+ * Everything a worker keeps per device.
+ */
+struct DeviceState {
+    DeviceStream stream;
+    TrendTracker trend;
+    AdaptivePacingPolicy policy;
+    CommandShaper shaper;
+    SampleClock clock;
+    uint64_t lastSeenMs = 0;
+};
+
+}  // namespace pulsemind
+
+#endif  // PULSEMIND_DEVICE_STREAM_H
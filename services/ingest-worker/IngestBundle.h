@@ -0,0 +1,192 @@
+#ifndef PULSEMIND_INGEST_BUNDLE_H
+#define PULSEMIND_INGEST_BUNDLE_H
+
+/**
+ * Model bundle for the ingest worker: the rhythm forest and the bandpass
+ * coefficients, exported from the Python services by
+ * export_ingest_bundle.py so the daemon runs exactly the models the
+ * services do (see PpgPipeline.h for why the filter is not designed here).
+ *
+ * Text format, whitespace separated, floats as C99 hex literals (exact):
+ *
+ *   pulsemind-ingest-bundle 1
+ *   labels <n> <label_0> ... <label_n-1>
+ *   filter <sampling_rate> <taps> <b_0..b_taps-1> <a_0..a_taps-1>   (repeated)
+ *   tree <node_count>                                                (repeated)
+ *     <feature> <threshold> <left> <right> <value_0..value_n-1>     (per node)
+ *   end
+ */
+
+#include <stdlib.h>
+
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "PpgPipeline.h"
+#include "SafetyPolicy.h"
+
+namespace pulsemind {
+
+constexpr int BUNDLE_FORMAT_VERSION = 1;
+
+struct BandpassFilter {
+    double samplingRate;
+    std::vector<double> b;
+    std::vector<double> a;
+};
+
+class IngestBundle {
+public:
+    /**
+     * Load a bundle file; on failure returns false and sets error.
+     */
+    bool load(const std::string& path, std::string& error) {
+        std::ifstream in(path);
+        if (!in) {
+            error = "cannot open " + path;
+            return false;
+        }
+        std::string token;
+        int version = 0;
+        if (!(in >> token) || token != "pulsemind-ingest-bundle" || !(in >> version) ||
+            version != BUNDLE_FORMAT_VERSION) {
+            error = "not a version 1 ingest bundle";
+            return false;
+        }
+
+        size_t classes = 0;
+        while (in >> token) {
+            if (token == "end") {
+                break;
+            }
+            if (token == "labels") {
+                if (!(in >> classes) || classes == 0 || classes > MAX_FOREST_CLASSES) {
+                    error = "bad class count";
+                    return false;
+                }
+                labels_.resize(classes);
+                rhythms_.resize(classes);
+                for (size_t c = 0; c < classes; c++) {
+                    if (!(in >> labels_[c])) {
+                        error = "truncated labels";
+                        return false;
+                    }
+                    rhythms_[c] = parseRhythm(labels_[c].c_str());
+                }
+                forest_ = std::make_unique<RandomForest>(static_cast<uint32_t>(classes));
+            } else if (token == "filter") {
+                BandpassFilter f;
+                size_t taps = 0;
+                if (!readDouble(in, f.samplingRate) || !(in >> taps) || taps < 2 || taps > MAX_FILTER_TAPS) {
+                    error = "bad filter header";
+                    return false;
+                }
+                f.b.resize(taps);
+                f.a.resize(taps);
+                for (double& v : f.b) {
+                    if (!readDouble(in, v)) {
+                        error = "truncated filter";
+                        return false;
+                    }
+                }
+                for (double& v : f.a) {
+                    if (!readDouble(in, v)) {
+                        error = "truncated filter";
+                        return false;
+                    }
+                }
+                if (f.a[0] != 1.0) {
+                    error = "filter a[0] must be 1";
+                    return false;
+                }
+                filters_.push_back(std::move(f));
+            } else if (token == "tree") {
+                if (!forest_ || !readTree(in, classes, error)) {
+                    if (error.empty()) {
+                        error = "tree before labels";
+                    }
+                    return false;
+                }
+            } else {
+                error = "unknown section " + token;
+                return false;
+            }
+        }
+        if (token != "end") {
+            error = "missing end marker";
+            return false;
+        }
+        if (!forest_ || forest_->numTrees() == 0 || filters_.empty()) {
+            error = "bundle needs labels, at least one tree and one filter";
+            return false;
+        }
+        return true;
+    }
+
+    const RandomForest& forest() const { return *forest_; }
+    const std::string& label(uint32_t c) const { return labels_[c]; }
+    Rhythm rhythm(uint32_t c) const { return rhythms_[c]; }
+
+    /**
+     * Coefficients for a sampling rate, or nullptr if none were exported.
+     */
+    const BandpassFilter* filterFor(double samplingRate) const {
+        for (const BandpassFilter& f : filters_) {
+            if (f.samplingRate == samplingRate) {
+                return &f;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    static bool readDouble(std::ifstream& in, double& out) {
+        std::string token;
+        if (!(in >> token)) {
+            return false;
+        }
+        char* end = nullptr;
+        out = strtod(token.c_str(), &end);
+        return end == token.c_str() + token.size();
+    }
+
+    bool readTree(std::ifstream& in, size_t classes, std::string& error) {
+        size_t nodes = 0;
+        if (!(in >> nodes) || nodes == 0) {
+            error = "bad tree size";
+            return false;
+        }
+        std::vector<int64_t> feature(nodes), left(nodes), right(nodes);
+        std::vector<double> threshold(nodes), value(nodes * classes);
+        for (size_t i = 0; i < nodes; i++) {
+            if (!(in >> feature[i]) || !readDouble(in, threshold[i]) || !(in >> left[i]) || !(in >> right[i])) {
+                error = "truncated tree";
+                return false;
+            }
+            for (size_t c = 0; c < classes; c++) {
+                if (!readDouble(in, value[i * classes + c])) {
+                    error = "truncated tree";
+                    return false;
+                }
+            }
+        }
+        if (!validTreeLayout(nodes, feature.data(), left.data(), right.data())) {
+            error = "inconsistent tree layout";
+            return false;
+        }
+        forest_->addTree(nodes, feature.data(), threshold.data(), left.data(), right.data(), value.data());
+        return true;
+    }
+
+    std::vector<std::string> labels_;
+    std::vector<Rhythm> rhythms_;
+    std::vector<BandpassFilter> filters_;
+    std::unique_ptr<RandomForest> forest_;
+};
+
+}  // namespace pulsemind
+
+#endif  // PULSEMIND_INGEST_BUNDLE_H
@@ -0,0 +1,590 @@
+#ifndef PULSEMIND_INGEST_FRAME_H
+#define PULSEMIND_INGEST_FRAME_H
+
+/**
+ * Sensor frame decoding for pulsemind/sensor/ppg.
+ *
+ * Two encodings share the topic:
+ *
+ * JSON (firmware, bridges, test clients)
+ *   {"device_id": "ESP32_PulseMind_01", "ts": 123456, "fs": 100,
+ *    "ppg": [2048.0, 2051.5, ...]}
+ *   - samples under "ppg", "value" or "signal" (the keys the dashboard reads),
+ *     either one number or an array of numbers
+ *   - "ts" (device milliseconds of the first sample) and "fs" /
+ *     "sampling_rate" are optional; "device_id" defaults to "default"
+ *   - "traceparent" (W3C trace context, optional) marks a traced frame; one
+ *     that does not parse is ignored, never a reason to drop the samples
+ *   - a bare JSON number is a single sample from the default device
+ *
+ * Binary (little-endian, for high-rate publishers)
+ *   offset 0   'P' 'M'           magic
+ *          2   u8  version       = 1
+ *          3   u8  sample format   0 = float32, 1 = uint16 (raw ADC)
+ *          4   u16 sample count
+ *          6   u16 sampling rate (Hz, 0 = unspecified)
+ *          8   u32 ts (ms)
+ *         12   u8  device id length (1..MAX_DEVICE_ID_LEN)
+ *         13   device id bytes, then the samples
+ *
+ * Binary frames carry no trace context.
+ *
+ * Device ids end up in topic names, so ids with MQTT wildcards, separators,
+ * quotes or control characters are rejected.
+ *
+ * decodeTraceReport() reads the device's closed-loop timing for a traced
+ * command (pulsemind/device/trace), also JSON:
+ *   {"device_id": "ESP32_PulseMind_01", "traceparent": "<the command's>",
+ *    "sample_ms": ..., "command_rx_ms": ..., "applied_ms": ...,
+ *    "actuation_ms": ..., "now_ms": ...}
+ * All times are the device's millis(): the sample the command answers, its
+ * receipt, the first PacingController::update() applying it, the first LED
+ * pulse under it (applied_ms when it turned pacing off) and the report.
+ *
+ * decodeDeviceStatus() reads the metrics of a device status frame
+ * (pulsemind/device/status):
+ *   {"device_id": "ESP32_PulseMind_01", "status": "ok", ...,
+ *    "metrics": {"pulsemind_device_commands_total": 42, ...}}
+ * Names are the exposition's; _total series are counters since boot, the
+ * rest gauges. Frames without "metrics" (the firmware's connect notice)
+ * decode with none.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmath>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "MqttCodec.h"
+#include "TraceRing.h"
+
+namespace pulsemind {
+
+constexpr size_t MAX_DEVICE_ID_LEN = 64;
+constexpr size_t MAX_FRAME_SAMPLES = 1024;
+constexpr const char* DEFAULT_DEVICE_ID = "default";  // policy_store.DEFAULT_DEVICE_ID
+
+constexpr uint8_t BINARY_FRAME_VERSION = 1;
+constexpr size_t BINARY_HEADER_SIZE = 13;
+constexpr uint8_t SAMPLE_FORMAT_FLOAT32 = 0;
+constexpr uint8_t SAMPLE_FORMAT_UINT16 = 1;
+
+/** Most metrics one status frame may carry. */
+constexpr size_t MAX_STATUS_METRICS = 32;
+
+/** Longest step between consecutive trace report times (device clock). */
+constexpr uint32_t MAX_TRACE_REPORT_STEP_MS = 60 * 1000;
+
+enum class FrameStatus : uint8_t {
+    Ok = 0,
+    Malformed,       // Not valid JSON / truncated binary frame
+    BadDeviceId,     // Empty, too long or not topic-safe
+    NoSamples,       // No sample key, or an empty array
+    TooManySamples,  // > MAX_FRAME_SAMPLES
+    BadSample,       // Non-numeric or non-finite sample
+};
+
+struct Frame {
+    std::string_view deviceId;  // Aliases the payload (or DEFAULT_DEVICE_ID)
+    bool hasTimestamp;
+    uint64_t timestampMs;
+    double samplingRate;        // 0 when the frame does not say
+    trace::TraceContext trace;  // Not valid() when the frame is not traced
+};
+
+struct TraceReport {
+    std::string_view deviceId;    // Aliases the payload
+    trace::TraceContext command;  // The command's trace context, as it arrived
+    uint32_t sampleMs;
+    uint32_t commandRxMs;
+    uint32_t appliedMs;
+    uint32_t actuationMs;
+    uint32_t nowMs;
+};
+
+struct DeviceStatus {
+    std::string_view deviceId;  // Aliases the payload (or DEFAULT_DEVICE_ID)
+    std::pair<std::string_view, double> metrics[MAX_STATUS_METRICS];  // Names alias the payload
+    size_t metricCount;
+};
+
+namespace detail {
+
+inline uint16_t readU16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+
+inline uint32_t readU32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+inline bool isBinary(const uint8_t* p, size_t n) { return n >= 2 && p[0] == 'P' && p[1] == 'M'; }
+
+inline bool validDeviceId(std::string_view id) {
+    return id.size() <= MAX_DEVICE_ID_LEN && mqtt::isTopicSafe(id.data(), id.size());
+}
+
+/**
+ * Cursor over a JSON document. Only what frames need: objects, arrays,
+ * numbers, unescaped strings (escaped strings are skipped, never decoded),
+ * literals.
+ */
+class JsonCursor {
+public:
+    JsonCursor(const char* p, const char* end) : p_(p), end_(end) {}
+
+    void skipWs() {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) {
+            p_++;
+        }
+    }
+
+    bool consume(char c) {
+        skipWs();
+        if (p_ < end_ && *p_ == c) {
+            p_++;
+            return true;
+        }
+        return false;
+    }
+
+    bool peek(char c) {
+        skipWs();
+        return p_ < end_ && *p_ == c;
+    }
+
+    bool atEnd() {
+        skipWs();
+        return p_ == end_;
+    }
+
+    /**
+     * String token; escaped is set when it contains backslash escapes (the
+     * view then holds the raw, undecoded text).
+     */
+    bool string(std::string_view& out, bool& escaped) {
+        if (!consume('"')) {
+            return false;
+        }
+        const char* start = p_;
+        escaped = false;
+        while (p_ < end_ && *p_ != '"') {
+            if (*p_ == '\\') {
+                escaped = true;
+                p_++;
+            }
+            p_++;
+        }
+        if (p_ >= end_) {
+            return false;
+        }
+        out = std::string_view(start, static_cast<size_t>(p_ - start));
+        p_++;
+        return true;
+    }
+
+    bool number(double& out) {
+        skipWs();
+        char token[64];
+        size_t len = 0;
+        while (p_ < end_ && len < sizeof(token) - 1 &&
+               ((*p_ >= '0' && *p_ <= '9') || *p_ == '-' || *p_ == '+' || *p_ == '.' || *p_ == 'e' ||
+                *p_ == 'E')) {
+            token[len++] = *p_++;
+        }
+        if (len == 0) {
+            return false;
+        }
+        token[len] = '\0';
+        char* parsed = nullptr;
+        out = strtod(token, &parsed);
+        return parsed == token + len;
+    }
+
+    bool literal(const char* word) {
+        skipWs();
+        const size_t len = strlen(word);
+        if (static_cast<size_t>(end_ - p_) < len || memcmp(p_, word, len) != 0) {
+            return false;
+        }
+        p_ += len;
+        return true;
+    }
+
+    bool skipValue(int depth = 0) {
+        if (depth > 16) {
+            return false;
+        }
+        skipWs();
+        if (p_ >= end_) {
+            return false;
+        }
+        std::string_view s;
+        bool escaped;
+        double d;
+        switch (*p_) {
+            case '"':
+                return string(s, escaped);
+            case 't':
+                return literal("true");
+            case 'f':
+                return literal("false");
+            case 'n':
+                return literal("null");
+            case '[':
+                p_++;
+                if (consume(']')) {
+                    return true;
+                }
+                do {
+                    if (!skipValue(depth + 1)) {
+                        return false;
+                    }
+                } while (consume(','));
+                return consume(']');
+            case '{':
+                p_++;
+                if (consume('}')) {
+                    return true;
+                }
+                do {
+                    if (!string(s, escaped) || !consume(':') || !skipValue(depth + 1)) {
+                        return false;
+                    }
+                } while (consume(','));
+                return consume('}');
+            default:
+                return number(d);
+        }
+    }
+
+private:
+    const char* p_;
+    const char* end_;
+};
+
+inline FrameStatus parseSamples(JsonCursor& c, std::vector<double>& samples) {
+    double v;
+    if (!c.consume('[')) {
+        if (!c.number(v)) {
+            return FrameStatus::BadSample;
+        }
+        samples.push_back(v);
+        return std::isfinite(v) ? FrameStatus::Ok : FrameStatus::BadSample;
+    }
+    if (c.consume(']')) {
+        return FrameStatus::NoSamples;
+    }
+    do {
+        if (samples.size() == MAX_FRAME_SAMPLES) {
+            return FrameStatus::TooManySamples;
+        }
+        if (!c.number(v) || !std::isfinite(v)) {
+            return FrameStatus::BadSample;
+        }
+        samples.push_back(v);
+    } while (c.consume(','));
+    return c.consume(']') ? FrameStatus::Ok : FrameStatus::Malformed;
+}
+
+inline FrameStatus decodeJson(const char* p, size_t n, Frame& frame, std::vector<double>& samples) {
+    JsonCursor c(p, p + n);
+    double v;
+    if (!c.peek('{')) {
+        // Bare number: one sample from the default device
+        if (!c.number(v) || !c.atEnd()) {
+            return FrameStatus::Malformed;
+        }
+        if (!std::isfinite(v)) {
+            return FrameStatus::BadSample;
+        }
+        samples.push_back(v);
+        return FrameStatus::Ok;
+    }
+    c.consume('{');
+    bool sawSamples = false;
+    if (!c.consume('}')) {
+        do {
+            std::string_view key;
+            bool escaped;
+            if (!c.string(key, escaped) || !c.consume(':')) {
+                return FrameStatus::Malformed;
+            }
+            if (key == "device_id") {
+                std::string_view id;
+                if (!c.string(id, escaped)) {
+                    return FrameStatus::BadDeviceId;
+                }
+                if (escaped || !validDeviceId(id)) {
+                    return FrameStatus::BadDeviceId;
+                }
+                frame.deviceId = id;
+            } else if (key == "ts") {
+                if (!c.number(v) || !(v >= 0.0) || v > 1.8e19) {
+                    return FrameStatus::Malformed;
+                }
+                frame.hasTimestamp = true;
+                frame.timestampMs = static_cast<uint64_t>(v);
+            } else if (key == "fs" || key == "sampling_rate") {
+                if (!c.number(v) || !std::isfinite(v) || v < 0.0) {
+                    return FrameStatus::Malformed;
+                }
+                frame.samplingRate = v;
+            } else if (key == "traceparent") {
+                std::string_view value;
+                if (!c.string(value, escaped)) {
+                    return FrameStatus::Malformed;
+                }
+                if (escaped || !trace::parseTraceparent(value.data(), value.size(), frame.trace)) {
+                    frame.trace = trace::TraceContext{};
+                }
+            } else if (!sawSamples && (key == "ppg" || key == "value" || key == "signal")) {
+                const FrameStatus status = parseSamples(c, samples);
+                if (status != FrameStatus::Ok) {
+                    return status;
+                }
+                sawSamples = true;
+            } else if (!c.skipValue()) {
+                return FrameStatus::Malformed;
+            }
+        } while (c.consume(','));
+        if (!c.consume('}')) {
+            return FrameStatus::Malformed;
+        }
+    }
+    if (!c.atEnd()) {
+        return FrameStatus::Malformed;
+    }
+    return sawSamples ? FrameStatus::Ok : FrameStatus::NoSamples;
+}
+
+inline FrameStatus decodeBinary(const uint8_t* p, size_t n, Frame& frame, std::vector<double>& samples) {
+    if (n < BINARY_HEADER_SIZE || p[2] != BINARY_FRAME_VERSION) {
+        return FrameStatus::Malformed;
+    }
+    const uint8_t format = p[3];
+    const size_t count = readU16(p + 4);
+    const size_t idLen = p[12];
+    const size_t sampleSize = format == SAMPLE_FORMAT_FLOAT32 ? 4 : format == SAMPLE_FORMAT_UINT16 ? 2 : 0;
+    if (sampleSize == 0 || n != BINARY_HEADER_SIZE + idLen + count * sampleSize) {
+        return FrameStatus::Malformed;
+    }
+    if (count == 0) {
+        return FrameStatus::NoSamples;
+    }
+    if (count > MAX_FRAME_SAMPLES) {
+        return FrameStatus::TooManySamples;
+    }
+    const std::string_view id(reinterpret_cast<const char*>(p + BINARY_HEADER_SIZE), idLen);
+    if (!validDeviceId(id)) {
+        return FrameStatus::BadDeviceId;
+    }
+    frame.deviceId = id;
+    frame.samplingRate = readU16(p + 6);
+    frame.hasTimestamp = true;
+    frame.timestampMs = readU32(p + 8);
+
+    const uint8_t* s = p + BINARY_HEADER_SIZE + idLen;
+    for (size_t i = 0; i < count; i++, s += sampleSize) {
+        if (format == SAMPLE_FORMAT_UINT16) {
+            samples.push_back(readU16(s));
+            continue;
+        }
+        const uint32_t bits = readU32(s);
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        if (!std::isfinite(f)) {
+            return FrameStatus::BadSample;
+        }
+        samples.push_back(f);
+    }
+    return FrameStatus::Ok;
+}
+
+inline bool reportTime(JsonCursor& c, uint32_t& out) {
+    double v;
+    if (!c.number(v) || !(v >= 0.0) || v > 4294967295.0 || v != std::floor(v)) {
+        return false;
+    }
+    out = static_cast<uint32_t>(v);
+    return true;
+}
+
+}  // namespace detail
+
+/**
+ * Decode a device trace report. Every field is required, and the times
+ * must follow each other (modulo millis() wraparound) by at most
+ * MAX_TRACE_REPORT_STEP_MS.
+ */
+inline FrameStatus decodeTraceReport(const uint8_t* p, size_t n, TraceReport& report) {
+    report = TraceReport{};
+    detail::JsonCursor c(reinterpret_cast<const char*>(p), reinterpret_cast<const char*>(p) + n);
+    if (!c.consume('{')) {
+        return FrameStatus::Malformed;
+    }
+    const std::pair<std::string_view, uint32_t*> times[] = {
+        {"sample_ms", &report.sampleMs},   {"command_rx_ms", &report.commandRxMs},
+        {"applied_ms", &report.appliedMs}, {"actuation_ms", &report.actuationMs},
+        {"now_ms", &report.nowMs},
+    };
+    constexpr unsigned TIMES = sizeof(times) / sizeof(times[0]);
+    unsigned seen = 0;  // Bit per required field: the times, then device_id and traceparent
+    if (!c.consume('}')) {
+        do {
+            std::string_view key;
+            bool escaped;
+            if (!c.string(key, escaped) || !c.consume(':')) {
+                return FrameStatus::Malformed;
+            }
+            unsigned t = 0;
+            while (t < TIMES && times[t].first != key) {
+                t++;
+            }
+            if (t < TIMES) {
+                if (!detail::reportTime(c, *times[t].second)) {
+                    return FrameStatus::Malformed;
+                }
+                seen |= 1u << t;
+            } else if (key == "device_id") {
+                std::string_view id;
+                if (!c.string(id, escaped) || escaped || !detail::validDeviceId(id)) {
+                    return FrameStatus::BadDeviceId;
+                }
+                report.deviceId = id;
+                seen |= 1u << TIMES;
+            } else if (key == "traceparent") {
+                std::string_view value;
+                if (!c.string(value, escaped) || escaped ||
+                    !trace::parseTraceparent(value.data(), value.size(), report.command)) {
+                    return FrameStatus::Malformed;
+                }
+                seen |= 1u << (TIMES + 1);
+            } else if (!c.skipValue()) {
+                return FrameStatus::Malformed;
+            }
+        } while (c.consume(','));
+        if (!c.consume('}')) {
+            return FrameStatus::Malformed;
+        }
+    }
+    if (!c.atEnd() || seen != (1u << (TIMES + 2)) - 1) {
+        return FrameStatus::Malformed;
+    }
+    const uint32_t steps[] = {report.commandRxMs - report.sampleMs, report.appliedMs - report.commandRxMs,
+                              report.actuationMs - report.appliedMs, report.nowMs - report.actuationMs};
+    for (uint32_t step : steps) {
+        if (step > MAX_TRACE_REPORT_STEP_MS) {
+            return FrameStatus::Malformed;
+        }
+    }
+    return FrameStatus::Ok;
+}
+
+/**
+ * Decode a device status frame's device id and metrics. Metric values must
+ * be finite numbers; names are left to the metrics registry to validate.
+ */
+inline FrameStatus decodeDeviceStatus(const uint8_t* p, size_t n, DeviceStatus& status) {
+    status.deviceId = DEFAULT_DEVICE_ID;
+    status.metricCount = 0;
+    detail::JsonCursor c(reinterpret_cast<const char*>(p), reinterpret_cast<const char*>(p) + n);
+    if (!c.consume('{')) {
+        return FrameStatus::Malformed;
+    }
+    if (!c.consume('}')) {
+        do {
+            std::string_view key;
+            bool escaped;
+            if (!c.string(key, escaped) || !c.consume(':')) {
+                return FrameStatus::Malformed;
+            }
+            if (key == "device_id") {
+                std::string_view id;
+                if (!c.string(id, escaped) || escaped || !detail::validDeviceId(id)) {
+                    return FrameStatus::BadDeviceId;
+                }
+                status.deviceId = id;
+            } else if (key == "metrics" && status.metricCount == 0) {
+                if (!c.consume('{')) {
+                    return FrameStatus::Malformed;
+                }
+                if (c.consume('}')) {
+                    continue;
+                }
+                do {
+                    std::string_view name;
+                    double v;
+                    if (status.metricCount == MAX_STATUS_METRICS) {
+                        return FrameStatus::TooManySamples;
+                    }
+                    if (!c.string(name, escaped) || escaped || !c.consume(':') || !c.number(v) ||
+                        !std::isfinite(v)) {
+                        return FrameStatus::Malformed;
+                    }
+                    status.metrics[status.metricCount++] = {name, v};
+                } while (c.consume(','));
+                if (!c.consume('}')) {
+                    return FrameStatus::Malformed;
+                }
+            } else if (!c.skipValue()) {
+                return FrameStatus::Malformed;
+            }
+        } while (c.consume(','));
+        if (!c.consume('}')) {
+            return FrameStatus::Malformed;
+        }
+    }
+    return c.atEnd() ? FrameStatus::Ok : FrameStatus::Malformed;
+}
+
+/**
+ * Decode one frame. samples is cleared first; on success it holds the
+ * frame's samples in order.
+ */
+inline FrameStatus decodeFrame(const uint8_t* p, size_t n, Frame& frame, std::vector<double>& samples) {
+    frame.deviceId = DEFAULT_DEVICE_ID;
+    frame.hasTimestamp = false;
+    frame.timestampMs = 0;
+    frame.samplingRate = 0.0;
+    frame.trace = trace::TraceContext{};
+    samples.clear();
+    if (detail::isBinary(p, n)) {
+        return detail::decodeBinary(p, n, frame, samples);
+    }
+    return detail::decodeJson(reinterpret_cast<const char*>(p), n, frame, samples);
+}
+
+/**
+ * Device id of a frame without decoding it, for routing to a worker shard.
+ * Falls back to DEFAULT_DEVICE_ID when the frame has none or is malformed
+ * (the worker rejects malformed frames when it decodes them).
+ */
+inline std::string_view peekDeviceId(const uint8_t* p, size_t n) {
+    if (detail::isBinary(p, n)) {
+        if (n < BINARY_HEADER_SIZE || BINARY_HEADER_SIZE + p[12] > n) {
+            return DEFAULT_DEVICE_ID;
+        }
+        return std::string_view(reinterpret_cast<const char*>(p + BINARY_HEADER_SIZE), p[12]);
+    }
+    static constexpr std::string_view KEY = "\"device_id\"";
+    const std::string_view text(reinterpret_cast<const char*>(p), n);
+    const size_t at = text.find(KEY);
+    if (at == std::string_view::npos) {
+        return DEFAULT_DEVICE_ID;
+    }
+    detail::JsonCursor c(text.data() + at + KEY.size(), text.data() + n);
+    std::string_view id;
+    bool escaped;
+    if (!c.consume(':') || !c.string(id, escaped)) {
+        return DEFAULT_DEVICE_ID;
+    }
+    return id;
+}
+
+}  // namespace pulsemind
+
+#endif  // PULSEMIND_INGEST_FRAME_H
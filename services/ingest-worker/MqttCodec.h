@@ -0,0 +1,499 @@
+#ifndef PULSEMIND_MQTT_CODEC_H
+#define PULSEMIND_MQTT_CODEC_H
+
+/**
+ * Minimal MQTT 3.1.1 codec for the ingest worker.
+ *
+ * Client side, only what a QoS 0 subscriber/publisher needs: CONNECT,
+ * SUBSCRIBE, PUBLISH, PINGREQ and DISCONNECT are encoded; CONNACK, SUBACK,
+ * PUBLISH and PINGRESP are decoded. Incoming QoS 1 publishes are
+ * acknowledged, so a broker that does not downgrade to the subscription QoS
+ * still works.
+ *
+ * Broker side (embedded broker mode): CONNECT, SUBSCRIBE and UNSUBSCRIBE are
+ * decoded; CONNACK, SUBACK, UNSUBACK and PINGRESP are encoded; topicMatches
+ * implements filter matching with + and # wildcards.
+ *
+ * Encoders append to a caller-owned output buffer; MqttReader frames packets
+ * out of a byte stream without copying payloads.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+namespace pulsemind {
+namespace mqtt {
+
+// ==========================================
+// Packet Types (fixed header, high nibble)
+// ==========================================
+constexpr uint8_t CONNECT = 1;
+constexpr uint8_t CONNACK = 2;
+constexpr uint8_t PUBLISH = 3;
+constexpr uint8_t PUBACK = 4;
+constexpr uint8_t SUBSCRIBE = 8;
+constexpr uint8_t SUBACK = 9;
+constexpr uint8_t UNSUBSCRIBE = 10;
+constexpr uint8_t UNSUBACK = 11;
+constexpr uint8_t PINGREQ = 12;
+constexpr uint8_t PINGRESP = 13;
+constexpr uint8_t DISCONNECT = 14;
+
+constexpr uint8_t PROTOCOL_LEVEL_311 = 4;
+constexpr uint8_t CONNECT_FLAG_CLEAN_SESSION = 0x02;
+constexpr uint8_t CONNECT_FLAG_WILL = 0x04;
+constexpr uint8_t CONNECT_FLAG_PASSWORD = 0x40;
+constexpr uint8_t CONNECT_FLAG_USERNAME = 0x80;
+constexpr uint8_t SUBACK_FAILURE = 0x80;
+
+// CONNACK return codes
+constexpr uint8_t CONNACK_ACCEPTED = 0x00;
+constexpr uint8_t CONNACK_BAD_PROTOCOL = 0x01;
+constexpr uint8_t CONNACK_BAD_CLIENT_ID = 0x02;
+
+constexpr uint32_t MAX_REMAINING_LENGTH = 268435455;  // 4-byte varint limit
+
+// ==========================================
+// Encoding
+// ==========================================
+inline void putU16(std::vector<uint8_t>& out, uint16_t v) {
+    out.push_back(static_cast<uint8_t>(v >> 8));
+    out.push_back(static_cast<uint8_t>(v & 0xFF));
+}
+
+inline void putString(std::vector<uint8_t>& out, const char* s, size_t len) {
+    putU16(out, static_cast<uint16_t>(len));
+    out.insert(out.end(), s, s + len);
+}
+
+inline void putFixedHeader(std::vector<uint8_t>& out, uint8_t firstByte, uint32_t remaining) {
+    out.push_back(firstByte);
+    do {
+        uint8_t digit = remaining % 128;
+        remaining /= 128;
+        if (remaining > 0) {
+            digit |= 0x80;
+        }
+        out.push_back(digit);
+    } while (remaining > 0);
+}
+
+inline void encodeConnect(std::vector<uint8_t>& out, const std::string& clientId, uint16_t keepaliveSec) {
+    const uint32_t remaining = 10 + 2 + static_cast<uint32_t>(clientId.size());
+    putFixedHeader(out, CONNECT << 4, remaining);
+    putString(out, "MQTT", 4);
+    out.push_back(PROTOCOL_LEVEL_311);
+    out.push_back(CONNECT_FLAG_CLEAN_SESSION);
+    putU16(out, keepaliveSec);
+    putString(out, clientId.data(), clientId.size());
+}
+
+inline void encodeSubscribe(std::vector<uint8_t>& out, uint16_t packetId, const std::string& filter, uint8_t qos) {
+    const uint32_t remaining = 2 + 2 + static_cast<uint32_t>(filter.size()) + 1;
+    putFixedHeader(out, (SUBSCRIBE << 4) | 0x02, remaining);
+    putU16(out, packetId);
+    putString(out, filter.data(), filter.size());
+    out.push_back(qos);
+}
+
+/**
+ * QoS 0 PUBLISH (no packet identifier).
+ */
+inline void encodePublish(std::vector<uint8_t>& out, const char* topic, size_t topicLen, const char* payload,
+                          size_t payloadLen) {
+    const uint32_t remaining = static_cast<uint32_t>(2 + topicLen + payloadLen);
+    putFixedHeader(out, PUBLISH << 4, remaining);
+    putString(out, topic, topicLen);
+    out.insert(out.end(), payload, payload + payloadLen);
+}
+
+inline void encodePuback(std::vector<uint8_t>& out, uint16_t packetId) {
+    putFixedHeader(out, PUBACK << 4, 2);
+    putU16(out, packetId);
+}
+
+inline void encodePingreq(std::vector<uint8_t>& out) { putFixedHeader(out, PINGREQ << 4, 0); }
+
+inline void encodeDisconnect(std::vector<uint8_t>& out) { putFixedHeader(out, DISCONNECT << 4, 0); }
+
+inline void encodeConnack(std::vector<uint8_t>& out, uint8_t returnCode) {
+    putFixedHeader(out, CONNACK << 4, 2);
+    out.push_back(0);  // No session present: sessions are always clean
+    out.push_back(returnCode);
+}
+
+inline void encodeSuback(std::vector<uint8_t>& out, uint16_t packetId, const uint8_t* codes, size_t n) {
+    putFixedHeader(out, SUBACK << 4, static_cast<uint32_t>(2 + n));
+    putU16(out, packetId);
+    out.insert(out.end(), codes, codes + n);
+}
+
+inline void encodeUnsuback(std::vector<uint8_t>& out, uint16_t packetId) {
+    putFixedHeader(out, UNSUBACK << 4, 2);
+    putU16(out, packetId);
+}
+
+inline void encodePingresp(std::vector<uint8_t>& out) { putFixedHeader(out, PINGRESP << 4, 0); }
+
+/**
+ * Size of the encoded packet at the start of p (fixed header included), or 0
+ * if p[0, n) does not hold a complete packet.
+ */
+inline size_t encodedPacketSize(const uint8_t* p, size_t n) {
+    uint32_t remaining = 0;
+    uint32_t multiplier = 1;
+    for (size_t i = 1; i < n && i <= 4; i++) {
+        remaining += (p[i] & 0x7F) * multiplier;
+        if (!(p[i] & 0x80)) {
+            const size_t total = i + 1 + remaining;
+            return total <= n ? total : 0;
+        }
+        multiplier *= 128;
+    }
+    return 0;
+}
+
+/**
+ * Topic names a device id may be embedded in: no wildcards, separators or
+ * control characters.
+ */
+inline bool isTopicSafe(const char* s, size_t len) {
+    if (len == 0) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        const unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c < 0x20 || c == 0x7F || c == '+' || c == '#' || c == '/' || c == '"' || c == '\\') {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * PUBLISH topic names: non-empty, no wildcards, no NUL.
+ */
+inline bool isValidTopicName(const char* s, size_t len) {
+    return len > 0 && memchr(s, '+', len) == nullptr && memchr(s, '#', len) == nullptr &&
+           memchr(s, '\0', len) == nullptr;
+}
+
+/**
+ * SUBSCRIBE topic filters: + and # only as whole levels, # only last.
+ */
+inline bool isValidTopicFilter(const char* s, size_t len) {
+    if (len == 0 || memchr(s, '\0', len) != nullptr) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] != '+' && s[i] != '#') {
+            continue;
+        }
+        const bool levelStart = i == 0 || s[i - 1] == '/';
+        const bool levelEnd = i + 1 == len || s[i + 1] == '/';
+        if (!levelStart || !levelEnd || (s[i] == '#' && i + 1 != len)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Whether a topic name matches a (valid) filter. Topics starting with $ are
+ * not matched by a leading wildcard.
+ */
+inline bool topicMatches(const char* filter, size_t filterLen, const char* topic, size_t topicLen) {
+    if (topicLen > 0 && topic[0] == '$' && filterLen > 0 && (filter[0] == '+' || filter[0] == '#')) {
+        return false;
+    }
+    size_t f = 0;
+    size_t t = 0;
+    while (f < filterLen) {
+        if (filter[f] == '#') {
+            return true;  // Matches the parent level and everything below it
+        }
+        if (filter[f] == '+') {
+            while (t < topicLen && topic[t] != '/') {
+                t++;
+            }
+            f++;
+        } else {
+            while (f < filterLen && filter[f] != '/') {
+                if (t == topicLen || topic[t] != filter[f]) {
+                    return false;
+                }
+                f++;
+                t++;
+            }
+            if (t < topicLen && topic[t] != '/') {
+                return false;
+            }
+        }
+        // Both at a level separator or at the end
+        if (f == filterLen) {
+            return t == topicLen;
+        }
+        f++;  // Skip '/'
+        if (t == topicLen) {
+            // "a/#" matches "a"
+            return f + 1 == filterLen && filter[f] == '#';
+        }
+        t++;
+    }
+    return t == topicLen;
+}
+
+// ==========================================
+// Decoding
+// ==========================================
+struct Packet {
+    uint8_t type;
+    uint8_t flags;           // Low nibble of the fixed header
+    const uint8_t* body;     // Variable header + payload
+    uint32_t length;
+};
+
+/**
+ * PUBLISH fields; pointers alias the packet body.
+ */
+struct Publish {
+    const char* topic;
+    size_t topicLen;
+    uint8_t qos;
+    uint16_t packetId;       // Only for qos > 0
+    const uint8_t* payload;
+    size_t payloadLen;
+};
+
+inline bool parsePublish(const Packet& p, Publish& out) {
+    if (p.length < 2) {
+        return false;
+    }
+    out.qos = (p.flags >> 1) & 0x03;
+    if (out.qos > 2) {
+        return false;
+    }
+    out.topicLen = (static_cast<size_t>(p.body[0]) << 8) | p.body[1];
+    size_t offset = 2 + out.topicLen;
+    if (offset > p.length) {
+        return false;
+    }
+    out.topic = reinterpret_cast<const char*>(p.body + 2);
+    out.packetId = 0;
+    if (out.qos > 0) {
+        if (offset + 2 > p.length) {
+            return false;
+        }
+        out.packetId = static_cast<uint16_t>((p.body[offset] << 8) | p.body[offset + 1]);
+        offset += 2;
+    }
+    out.payload = p.body + offset;
+    out.payloadLen = p.length - offset;
+    return true;
+}
+
+/**
+ * CONNECT fields; clientId aliases the packet body. Will, username and
+ * password are validated and skipped.
+ */
+struct Connect {
+    uint8_t protocolLevel;
+    uint8_t flags;
+    uint16_t keepaliveSec;
+    const char* clientId;
+    size_t clientIdLen;
+};
+
+namespace detail {
+
+inline bool readString(const Packet& p, size_t& offset, const char*& s, size_t& len) {
+    if (offset + 2 > p.length) {
+        return false;
+    }
+    len = (static_cast<size_t>(p.body[offset]) << 8) | p.body[offset + 1];
+    if (offset + 2 + len > p.length) {
+        return false;
+    }
+    s = reinterpret_cast<const char*>(p.body + offset + 2);
+    offset += 2 + len;
+    return true;
+}
+
+/**
+ * SUBSCRIBE/UNSUBSCRIBE: packet id, then (filter[, qos]) entries.
+ */
+template <typename Fn>
+inline bool forEachFilter(const Packet& p, bool withQos, uint16_t& packetId, Fn&& fn) {
+    if (p.flags != 0x02 || p.length < 2) {
+        return false;
+    }
+    packetId = static_cast<uint16_t>((p.body[0] << 8) | p.body[1]);
+    size_t offset = 2;
+    size_t count = 0;
+    while (offset < p.length) {
+        const char* filter;
+        size_t len;
+        if (!readString(p, offset, filter, len)) {
+            return false;
+        }
+        uint8_t qos = 0;
+        if (withQos) {
+            if (offset >= p.length || (p.body[offset] & 0xFC) != 0) {
+                return false;
+            }
+            qos = p.body[offset++];
+        }
+        fn(filter, len, qos);
+        count++;
+    }
+    return count > 0;
+}
+
+}  // namespace detail
+
+inline bool parseConnect(const Packet& p, Connect& out) {
+    size_t offset = 0;
+    const char* name;
+    size_t nameLen;
+    if (!detail::readString(p, offset, name, nameLen) || offset + 4 > p.length) {
+        return false;
+    }
+    const bool mqtt = nameLen == 4 && memcmp(name, "MQTT", 4) == 0;
+    const bool mqisdp = nameLen == 6 && memcmp(name, "MQIsdp", 6) == 0;  // MQTT 3.1
+    if (!mqtt && !mqisdp) {
+        return false;
+    }
+    out.protocolLevel = p.body[offset];
+    out.flags = p.body[offset + 1];
+    out.keepaliveSec = static_cast<uint16_t>((p.body[offset + 2] << 8) | p.body[offset + 3]);
+    offset += 4;
+    const uint8_t willQos = (out.flags >> 3) & 0x03;
+    if ((out.flags & 0x01) != 0 || willQos > 2 || (!(out.flags & CONNECT_FLAG_WILL) && (out.flags & 0x38) != 0)) {
+        return false;
+    }
+    if (!detail::readString(p, offset, out.clientId, out.clientIdLen)) {
+        return false;
+    }
+    const char* skipped;
+    size_t skippedLen;
+    if ((out.flags & CONNECT_FLAG_WILL) && (!detail::readString(p, offset, skipped, skippedLen) ||
+                                            !detail::readString(p, offset, skipped, skippedLen))) {
+        return false;
+    }
+    if ((out.flags & CONNECT_FLAG_USERNAME) && !detail::readString(p, offset, skipped, skippedLen)) {
+        return false;
+    }
+    if ((out.flags & CONNECT_FLAG_PASSWORD) && !detail::readString(p, offset, skipped, skippedLen)) {
+        return false;
+    }
+    return offset == p.length;
+}
+
+/**
+ * Calls fn(filter, len, requestedQos) per entry; false if malformed.
+ */
+template <typename Fn>
+inline bool parseSubscribe(const Packet& p, uint16_t& packetId, Fn&& fn) {
+    return detail::forEachFilter(p, true, packetId, fn);
+}
+
+/**
+ * Calls fn(filter, len, 0) per entry; false if malformed.
+ */
+template <typename Fn>
+inline bool parseUnsubscribe(const Packet& p, uint16_t& packetId, Fn&& fn) {
+    return detail::forEachFilter(p, false, packetId, fn);
+}
+
+/**
+ * Frames packets out of a TCP byte stream.
+ *
+ * Append received bytes with append() (or write into writableTail() and
+ * commit()), then call next() until it returns NeedMore. Packets returned by
+ * next() stay valid until the following append/commit.
+ */
+class MqttReader {
+public:
+    enum class Result { Packet, NeedMore, Malformed };
+
+    explicit MqttReader(uint32_t maxPacketSize) : maxPacketSize_(maxPacketSize) {}
+
+    uint8_t* writableTail(size_t want) {
+        compact();
+        buffer_.resize(end_ + want);
+        return buffer_.data() + end_;
+    }
+
+    void commit(size_t n) { end_ += n; }
+
+    void append(const uint8_t* data, size_t n) {
+        memcpy(writableTail(n), data, n);
+        commit(n);
+    }
+
+    Result next(Packet& out) {
+        const size_t available = end_ - start_;
+        if (available < 2) {
+            return Result::NeedMore;
+        }
+        const uint8_t* p = buffer_.data() + start_;
+        uint32_t remaining = 0;
+        uint32_t multiplier = 1;
+        size_t header = 1;
+        for (;;) {
+            if (header >= available) {
+                return Result::NeedMore;
+            }
+            const uint8_t digit = p[header++];
+            remaining += (digit & 0x7F) * multiplier;
+            if (!(digit & 0x80)) {
+                break;
+            }
+            if (header == 5) {
+                return Result::Malformed;  // More than 4 length bytes
+            }
+            multiplier *= 128;
+        }
+        if (remaining > maxPacketSize_) {
+            return Result::Malformed;
+        }
+        if (available < header + remaining) {
+            return Result::NeedMore;
+        }
+        out.type = p[0] >> 4;
+        out.flags = p[0] & 0x0F;
+        out.body = p + header;
+        out.length = remaining;
+        start_ += header + remaining;
+        return Result::Packet;
+    }
+
+    void reset() { start_ = end_ = 0; }
+
+private:
+    void compact() {
+        if (start_ == 0) {
+            return;
+        }
+        if (start_ == end_) {
+            start_ = end_ = 0;
+            return;
+        }
+        memmove(buffer_.data(), buffer_.data() + start_, end_ - start_);
+        end_ -= start_;
+        start_ = 0;
+    }
+
+    uint32_t maxPacketSize_;
+    std::vector<uint8_t> buffer_;
+    size_t start_ = 0;
+    size_t end_ = 0;
+};
+
+}  // namespace mqtt
+}  // namespace pulsemind
+
+#endif  // PULSEMIND_MQTT_CODEC_H
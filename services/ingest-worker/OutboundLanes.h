@@ -0,0 +1,199 @@
+#ifndef PULSEMIND_OUTBOUND_LANES_H
+#define PULSEMIND_OUTBOUND_LANES_H
+
+/**
+ * Strict-priority outbound queues for one MQTT connection.
+ *
+ * Pacing commands (and protocol replies) go in the priority lane; sensor
+ * fan-out and telemetry acknowledgements in the bulk lane. Whole packets
+ * move from the lanes to the wire buffer, priority first and bulk at most
+ * one chunk at a time, so a command queues behind at most one chunk of
+ * telemetry however large the bulk backlog grows.
+ *
+ * Commands can be timed: push() with the time the command was produced, and
+ * consume() records produced-to-written latency once its last byte has been
+ * handed to the socket.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "MqttCodec.h"
+
+namespace pulsemind {
+
+/**
+ * Latency distribution in power-of-two microsecond buckets.
+ */
+class LatencyHistogram {
+public:
+    static constexpr size_t BUCKETS = 40;
+
+    void record(uint64_t us) {
+        buckets_[bucketFor(us)]++;
+        count_++;
+        max_ = std::max(max_, us);
+    }
+
+    uint64_t count() const { return count_; }
+    uint64_t max() const { return max_; }
+
+    /**
+     * Upper bound (exclusive, microseconds) of the bucket holding quantile q;
+     * 0 when nothing was recorded.
+     */
+    uint64_t quantile(double q) const {
+        if (count_ == 0) {
+            return 0;
+        }
+        const uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count_ - 1));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            seen += buckets_[i];
+            if (seen > rank) {
+                return 1ull << i;
+            }
+        }
+        return 1ull << (BUCKETS - 1);
+    }
+
+private:
+    static size_t bucketFor(uint64_t us) {
+        if (us == 0) {
+            return 0;
+        }
+        return std::min<size_t>(BUCKETS - 1, static_cast<size_t>(64 - __builtin_clzll(us)));
+    }
+
+    uint64_t buckets_[BUCKETS] = {};
+    uint64_t count_ = 0;
+    uint64_t max_ = 0;
+};
+
+class OutboundLanes {
+public:
+    enum class Lane { Priority, Bulk };
+
+    OutboundLanes(size_t priorityMaxBytes, size_t bulkMaxBytes, size_t chunkBytes)
+        : priorityMaxBytes_(priorityMaxBytes), bulkMaxBytes_(bulkMaxBytes), chunkBytes_(chunkBytes) {}
+
+    /**
+     * Lane buffers for encoders (control packets, uncapped).
+     */
+    std::vector<uint8_t>& lane(Lane lane) { return lane == Lane::Priority ? priority_ : bulk_; }
+
+    /**
+     * Queue an encoded packet; false (dropped) when the lane is over its cap.
+     * A priority packet with producedUs > 0 is timed.
+     */
+    bool push(Lane lane, const uint8_t* packet, size_t n, uint64_t producedUs = 0) {
+        if (lane == Lane::Priority) {
+            if (priority_.size() + n > priorityMaxBytes_) {
+                return false;
+            }
+            priority_.insert(priority_.end(), packet, packet + n);
+            if (producedUs > 0) {
+                priorityTimes_.push_back({priority_.size(), producedUs});
+            }
+            return true;
+        }
+        if (bulk_.size() - bulkOffset_ + n > bulkMaxBytes_) {
+            return false;
+        }
+        bulk_.insert(bulk_.end(), packet, packet + n);
+        return true;
+    }
+
+    bool pending() const { return wireOffset_ < wire_.size() || !priority_.empty() || bulkOffset_ < bulk_.size(); }
+
+    /**
+     * Bytes to write next: the unwritten rest of the wire buffer, refilled
+     * from the lanes once it is fully written. Size 0 when nothing is queued.
+     */
+    std::pair<const uint8_t*, size_t> next() {
+        if (wireOffset_ == wire_.size()) {
+            refill();
+        }
+        return {wire_.data() + wireOffset_, wire_.size() - wireOffset_};
+    }
+
+    /**
+     * n bytes from next() were written at nowUs.
+     */
+    void consume(size_t n, uint64_t nowUs, LatencyHistogram& latency) {
+        wireOffset_ += n;
+        while (wireTimesDone_ < wireTimes_.size() && wireTimes_[wireTimesDone_].end <= wireOffset_) {
+            const uint64_t producedUs = wireTimes_[wireTimesDone_++].producedUs;
+            latency.record(nowUs > producedUs ? nowUs - producedUs : 0);
+        }
+    }
+
+    void clear() {
+        priority_.clear();
+        priorityTimes_.clear();
+        bulk_.clear();
+        bulkOffset_ = 0;
+        wire_.clear();
+        wireOffset_ = 0;
+        wireTimes_.clear();
+        wireTimesDone_ = 0;
+    }
+
+private:
+    struct Timed {
+        size_t end;  // Offset just past the command in its buffer
+        uint64_t producedUs;
+    };
+
+    void refill() {
+        wire_.clear();
+        wireOffset_ = 0;
+        wireTimes_.clear();
+        wireTimesDone_ = 0;
+        if (!priority_.empty()) {
+            wire_.swap(priority_);
+            wireTimes_.swap(priorityTimes_);
+            return;
+        }
+        if (bulkOffset_ == bulk_.size()) {
+            return;
+        }
+        // Whole packets, up to one chunk (at least one packet)
+        const uint8_t* p = bulk_.data() + bulkOffset_;
+        const size_t available = bulk_.size() - bulkOffset_;
+        size_t take = 0;
+        while (take < available) {
+            const size_t size = mqtt::encodedPacketSize(p + take, available - take);
+            if (size == 0 || (take > 0 && take + size > chunkBytes_)) {
+                break;
+            }
+            take += size;
+        }
+        wire_.assign(p, p + take);
+        bulkOffset_ += take;
+        if (bulkOffset_ == bulk_.size()) {
+            bulk_.clear();
+            bulkOffset_ = 0;
+        }
+    }
+
+    size_t priorityMaxBytes_;
+    size_t bulkMaxBytes_;
+    size_t chunkBytes_;
+    std::vector<uint8_t> priority_;
+    std::vector<Timed> priorityTimes_;
+    std::vector<uint8_t> bulk_;
+    size_t bulkOffset_ = 0;
+    std::vector<uint8_t> wire_;
+    size_t wireOffset_ = 0;
+    std::vector<Timed> wireTimes_;
+    size_t wireTimesDone_ = 0;
+};
+
+}  // namespace pulsemind
+
+#endif  // PULSEMIND_OUTBOUND_LANES_H
@@ -0,0 +1,100 @@
+"""Export the ingest worker's model bundle.
+
+Writes the rhythm forest the ai-inference service loads and the bandpass
+coefficients signal-service designs, in the text format IngestBundle.h
+reads. Floats are written as hex literals, so the native worker runs exactly
+the services' models.
+
+Usage:
+    python export_ingest_bundle.py [OUTPUT]   (default build/ingest_bundle.txt)
+"""
+
+import os
+import sys
+from typing import Iterable, TextIO
+
+import numpy as np
+
+SERVICES_DIR = os.path.abspath(os.path.join(os.path.dirname(__file__), ".."))
+sys.path.insert(0, SERVICES_DIR)
+for _stage_dir in ("signal-service", "ai-inference"):
+    sys.path.append(os.path.join(SERVICES_DIR, _stage_dir))
+
+from shared.logger import setup_logger  # noqa: E402
+
+logger = setup_logger("ingest-bundle", level="INFO")
+
+BUNDLE_FORMAT_VERSION = 1
+
+# Sampling rates devices may report ("fs"); 100 Hz is the firmware default
+SAMPLING_RATES = (50.0, 100.0, 125.0, 250.0)
+
+# Mirror of PpgPipeline.h MAX_FOREST_CLASSES
+MAX_FOREST_CLASSES = 8
+
+DEFAULT_OUTPUT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "build", "ingest_bundle.txt")
+
+
+def _hex(values: Iterable[float]) -> str:
+    return " ".join(float(v).hex() for v in values)
+
+
+def write_bundle(model, labels, out: TextIO, sampling_rates=SAMPLING_RATES):
+    """Write a fitted RandomForestClassifier and the bandpass filters.
+
+    Args:
+        model: Fitted RandomForestClassifier with classes 0..n-1
+        labels: Rhythm label per class (rhythm_classifier.RHYTHM_CLASSES)
+        out: Text stream to write to
+        sampling_rates: Rates to design bandpass filters for
+
+    Raises:
+        ValueError: If the model cannot be represented in a bundle
+    """
+    from signal_processor import design_bandpass
+
+    classes = np.asarray(model.classes_)
+    if classes.dtype.kind not in "iu" or not np.array_equal(classes, np.arange(len(classes))):
+        raise ValueError(f"Unsupported forest classes: {classes.tolist()}")
+    if len(classes) > MAX_FOREST_CLASSES:
+        raise ValueError(f"Forest has {len(classes)} classes (max {MAX_FOREST_CLASSES})")
+    if getattr(model, "n_features_in_", 3) != 3:
+        raise ValueError(f"Forest expects {model.n_features_in_} features, the worker provides 3")
+    num_classes = len(classes)
+
+    out.write(f"pulsemind-ingest-bundle {BUNDLE_FORMAT_VERSION}\n")
+    out.write(f"labels {num_classes} {' '.join(labels[:num_classes])}\n")
+    for rate in sampling_rates:
+        b, a = design_bandpass(rate)
+        out.write(f"filter {float(rate).hex()} {len(b)}\n{_hex(b)}\n{_hex(a)}\n")
+    for estimator in model.estimators_:
+        tree = estimator.tree_
+        out.write(f"tree {tree.node_count}\n")
+        for i in range(tree.node_count):
+            out.write(
+                f"{int(tree.feature[i])} {float(tree.threshold[i]).hex()} "
+                f"{int(tree.children_left[i])} {int(tree.children_right[i])} "
+                f"{_hex(tree.value[i, 0, :num_classes])}\n"
+            )
+    out.write("end\n")
+
+
+def export_bundle(path: str = DEFAULT_OUTPUT) -> str:
+    """Export the ai-inference model to path (written atomically)."""
+    from rhythm_classifier import RHYTHM_CLASSES, classifier
+
+    if not classifier.load_model():
+        raise RuntimeError("Rhythm model unavailable")
+
+    directory = os.path.dirname(os.path.abspath(path))
+    os.makedirs(directory, exist_ok=True)
+    tmp_path = path + ".tmp"
+    with open(tmp_path, "w") as f:
+        write_bundle(classifier.model, RHYTHM_CLASSES, f)
+    os.replace(tmp_path, path)
+    logger.info(f"Ingest bundle written to {path}")
+    return path
+
+
+if __name__ == "__main__":
+    export_bundle(sys.argv[1] if len(sys.argv) > 1 else DEFAULT_OUTPUT)
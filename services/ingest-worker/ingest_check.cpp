@@ -0,0 +1,551 @@
+/**
+ * Self-checks for the ingest worker's building blocks: MQTT framing and topic
+ * matching, outbound priority lanes, sensor frame and trace report decoding,
+ * streaming windows, trend direction and bundle loading.
+ *
+ * Exit status is 0 when every check passes, 1 otherwise.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "DeviceStream.h"
+#include "IngestBundle.h"
+#include "IngestFrame.h"
+#include "MqttCodec.h"
+#include "OutboundLanes.h"
+
+using namespace pulsemind;
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                        \
+    do {                                                                   \
+        if (!(cond)) {                                                     \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            g_failures++;                                                  \
+        }                                                                  \
+    } while (0)
+
+// W3C Trace Context example
+#define TRACEPARENT "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01"
+
+// Frame.deviceId aliases the payload, so keep the last decoded text alive
+std::string g_text;
+
+FrameStatus decodeText(const std::string& text, Frame& frame, std::vector<double>& samples) {
+    g_text = text;
+    return decodeFrame(reinterpret_cast<const uint8_t*>(g_text.data()), g_text.size(), frame, samples);
+}
+
+std::vector<uint8_t> binaryFrame(const std::string& id, uint8_t format, const std::vector<double>& samples,
+                                 uint16_t rate, uint32_t ts) {
+    std::vector<uint8_t> f = {'P', 'M', BINARY_FRAME_VERSION, format,
+                              static_cast<uint8_t>(samples.size() & 0xFF), static_cast<uint8_t>(samples.size() >> 8),
+                              static_cast<uint8_t>(rate & 0xFF), static_cast<uint8_t>(rate >> 8),
+                              static_cast<uint8_t>(ts), static_cast<uint8_t>(ts >> 8),
+                              static_cast<uint8_t>(ts >> 16), static_cast<uint8_t>(ts >> 24),
+                              static_cast<uint8_t>(id.size())};
+    f.insert(f.end(), id.begin(), id.end());
+    for (double v : samples) {
+        if (format == SAMPLE_FORMAT_UINT16) {
+            const uint16_t u = static_cast<uint16_t>(v);
+            f.push_back(static_cast<uint8_t>(u & 0xFF));
+            f.push_back(static_cast<uint8_t>(u >> 8));
+        } else {
+            const float x = static_cast<float>(v);
+            uint8_t bytes[4];
+            memcpy(bytes, &x, 4);
+            f.insert(f.end(), bytes, bytes + 4);
+        }
+    }
+    return f;
+}
+
+// ==========================================
+// MQTT
+// ==========================================
+void checkMqtt() {
+    std::vector<uint8_t> out;
+    mqtt::encodeConnect(out, "c", 30);
+    const std::vector<uint8_t> connect = {0x10, 13, 0, 4, 'M', 'Q', 'T', 'T', 4, 0x02, 0, 30, 0, 1, 'c'};
+    CHECK(out == connect);
+
+    // A publish with a two-byte remaining length, fed one byte at a time
+    out.clear();
+    const std::string topic = "pulsemind/sensor/ppg";
+    const std::string payload(300, 'x');
+    mqtt::encodePublish(out, topic.data(), topic.size(), payload.data(), payload.size());
+    mqtt::encodePingreq(out);
+    CHECK(out[1] == (0x80 | ((2 + 20 + 300) % 128)) && out[2] == (2 + 20 + 300) / 128);
+
+    mqtt::MqttReader reader(1024);
+    mqtt::Packet packet;
+    size_t packets = 0;
+    for (uint8_t byte : out) {
+        reader.append(&byte, 1);
+        while (reader.next(packet) == mqtt::MqttReader::Result::Packet) {
+            packets++;
+            if (packets == 1) {
+                mqtt::Publish pub = {};
+                CHECK(packet.type == mqtt::PUBLISH);
+                CHECK(mqtt::parsePublish(packet, pub));
+                CHECK(std::string(pub.topic, pub.topicLen) == topic);
+                CHECK(pub.qos == 0 && pub.payloadLen == payload.size());
+            } else {
+                CHECK(packet.type == mqtt::PINGREQ && packet.length == 0);
+            }
+        }
+    }
+    CHECK(packets == 2);
+
+    // QoS 1 publish carries a packet id
+    const std::vector<uint8_t> qos1 = {0x32, 7, 0, 1, 't', 0x12, 0x34, 'h', 'i'};
+    reader.reset();
+    reader.append(qos1.data(), qos1.size());
+    mqtt::Publish pub = {};
+    CHECK(reader.next(packet) == mqtt::MqttReader::Result::Packet);
+    CHECK(mqtt::parsePublish(packet, pub) && pub.qos == 1 && pub.packetId == 0x1234 && pub.payloadLen == 2);
+
+    // Five length bytes and oversize packets are malformed
+    const std::vector<uint8_t> badLength = {0x30, 0xFF, 0xFF, 0xFF, 0xFF, 0x01};
+    reader.reset();
+    reader.append(badLength.data(), badLength.size());
+    CHECK(reader.next(packet) == mqtt::MqttReader::Result::Malformed);
+    const std::vector<uint8_t> oversize = {0x30, 0x80, 0x10};  // 2048 > 1024
+    reader.reset();
+    reader.append(oversize.data(), oversize.size());
+    CHECK(reader.next(packet) == mqtt::MqttReader::Result::Malformed);
+
+    CHECK(mqtt::isTopicSafe("ESP32_PulseMind_01", 18));
+    CHECK(!mqtt::isTopicSafe("a/b", 3) && !mqtt::isTopicSafe("a+", 2) && !mqtt::isTopicSafe("#", 1));
+}
+
+bool matches(const std::string& filter, const std::string& topic) {
+    return mqtt::topicMatches(filter.data(), filter.size(), topic.data(), topic.size());
+}
+
+mqtt::Packet onePacket(mqtt::MqttReader& reader, const std::vector<uint8_t>& bytes) {
+    mqtt::Packet packet = {};
+    reader.reset();
+    reader.append(bytes.data(), bytes.size());
+    CHECK(reader.next(packet) == mqtt::MqttReader::Result::Packet);
+    return packet;
+}
+
+void checkMqttBroker() {
+    // Filters
+    CHECK(matches("pulsemind/pacing/command/+", "pulsemind/pacing/command/dev-1"));
+    CHECK(!matches("pulsemind/pacing/command/+", "pulsemind/pacing/command"));
+    CHECK(matches("pulsemind/pacing/command/#", "pulsemind/pacing/command"));
+    CHECK(matches("pulsemind/#", "pulsemind/sensor/ppg") && matches("#", "pulsemind/sensor/ppg"));
+    CHECK(matches("+/+/ppg", "pulsemind/sensor/ppg") && !matches("+/ppg", "pulsemind/sensor/ppg"));
+    CHECK(matches("a/+/c", "a//c") && matches("+", "") && !matches("a/b", "a/bc") && !matches("a/bc", "a/b"));
+    CHECK(!matches("a", "a/b") && !matches("a/b/", "a/b") && matches("a/b/", "a/b/"));
+    CHECK(!matches("#", "$SYS/load") && !matches("+/load", "$SYS/load") && matches("$SYS/#", "$SYS/load"));
+    CHECK(mqtt::isValidTopicFilter("a/+/#", 5) && mqtt::isValidTopicFilter("#", 1));
+    CHECK(!mqtt::isValidTopicFilter("a/#/b", 5) && !mqtt::isValidTopicFilter("a+", 2) && !mqtt::isValidTopicFilter("", 0));
+    CHECK(mqtt::isValidTopicName("a/b", 3) && !mqtt::isValidTopicName("a/+", 3) && !mqtt::isValidTopicName("", 0));
+
+    // CONNECT with username and password; what encodeConnect sends
+    mqtt::MqttReader reader(1024);
+    const std::vector<uint8_t> connect = {0x10, 22, 0, 4, 'M', 'Q', 'T', 'T', 4, 0xC2, 0, 60, 0, 2, 'i', 'd',
+                                          0, 2, 'u', 's', 0, 2, 'p', 'w'};
+    mqtt::Connect c = {};
+    CHECK(mqtt::parseConnect(onePacket(reader, connect), c));
+    CHECK(c.protocolLevel == 4 && c.keepaliveSec == 60 && std::string(c.clientId, c.clientIdLen) == "id");
+    std::vector<uint8_t> out;
+    mqtt::encodeConnect(out, "dev", 30);
+    CHECK(mqtt::parseConnect(onePacket(reader, out), c) && std::string(c.clientId, c.clientIdLen) == "dev");
+    // Reserved flag, trailing bytes
+    const std::vector<uint8_t> reserved = {0x10, 12, 0, 4, 'M', 'Q', 'T', 'T', 4, 0x03, 0, 60, 0, 0};
+    CHECK(!mqtt::parseConnect(onePacket(reader, reserved), c));
+    const std::vector<uint8_t> trailing = {0x10, 13, 0, 4, 'M', 'Q', 'T', 'T', 4, 0x02, 0, 60, 0, 0, 'x'};
+    CHECK(!mqtt::parseConnect(onePacket(reader, trailing), c));
+
+    // SUBSCRIBE with two filters, round-tripped from encodeSubscribe
+    out.clear();
+    mqtt::encodeSubscribe(out, 7, "a/+", 0);
+    out[1] += 4;
+    out.insert(out.end(), {0, 1, '#', 1});
+    std::vector<std::string> filters;
+    uint16_t packetId = 0;
+    CHECK(mqtt::parseSubscribe(onePacket(reader, out), packetId, [&](const char* f, size_t n, uint8_t qos) {
+        filters.push_back(std::string(f, n) + ":" + std::to_string(qos));
+    }));
+    CHECK(packetId == 7 && filters == std::vector<std::string>({"a/+:0", "#:1"}));
+    const std::vector<uint8_t> unsubscribe = {0xA2, 5, 0, 9, 0, 1, 'x'};
+    filters.clear();
+    CHECK(mqtt::parseUnsubscribe(onePacket(reader, unsubscribe), packetId,
+                                 [&](const char* f, size_t n, uint8_t) { filters.emplace_back(f, n); }));
+    CHECK(packetId == 9 && filters == std::vector<std::string>({"x"}));
+    const std::vector<uint8_t> badFlags = {0x80, 6, 0, 1, 0, 1, 'x', 0};
+    CHECK(!mqtt::parseSubscribe(onePacket(reader, badFlags), packetId, [](const char*, size_t, uint8_t) {}));
+
+    // Replies and packet boundaries
+    out.clear();
+    const uint8_t codes[] = {0, mqtt::SUBACK_FAILURE};
+    mqtt::encodeConnack(out, mqtt::CONNACK_ACCEPTED);
+    mqtt::encodeSuback(out, 7, codes, 2);
+    CHECK(out == std::vector<uint8_t>({0x20, 2, 0, 0, 0x90, 4, 0, 7, 0, 0x80}));
+    CHECK(mqtt::encodedPacketSize(out.data(), out.size()) == 4);
+    CHECK(mqtt::encodedPacketSize(out.data() + 4, 6) == 6 && mqtt::encodedPacketSize(out.data() + 4, 5) == 0);
+    out.clear();
+    const std::string payload(300, 'x');
+    mqtt::encodePublish(out, "t", 1, payload.data(), payload.size());
+    CHECK(mqtt::encodedPacketSize(out.data(), out.size()) == out.size());
+    CHECK(mqtt::encodedPacketSize(out.data(), 2) == 0);
+}
+
+// ==========================================
+// Outbound Lanes
+// ==========================================
+
+/**
+ * Write everything queued, chunk by chunk, at one microsecond per chunk;
+ * returns the first byte of each chunk's first packet.
+ */
+std::vector<uint8_t> drainLanes(OutboundLanes& lanes, uint64_t& clockUs, LatencyHistogram& latency) {
+    std::vector<uint8_t> firstBytes;
+    while (lanes.pending()) {
+        const auto chunk = lanes.next();
+        firstBytes.push_back(chunk.first[0]);
+        lanes.consume(chunk.second, ++clockUs, latency);
+    }
+    return firstBytes;
+}
+
+void checkLanes() {
+    const std::string sample(200, 's');
+    const std::string command(100, 'c');
+    std::vector<uint8_t> telemetry;
+    mqtt::encodePublish(telemetry, "pulsemind/sensor/ppg", 20, sample.data(), sample.size());
+    std::vector<uint8_t> pacing;
+    mqtt::encodePublish(pacing, "pulsemind/pacing/command/d", 26, command.data(), command.size());
+
+    // A command queued behind a telemetry backlog waits for one chunk at most,
+    // however large the backlog
+    for (size_t backlog : {10u, 1000u, 4000u}) {
+        OutboundLanes lanes(64 * 1024, 4 * 1024 * 1024, 4096);
+        for (size_t i = 0; i < backlog; i++) {
+            CHECK(lanes.push(OutboundLanes::Lane::Bulk, telemetry.data(), telemetry.size()));
+        }
+        LatencyHistogram latency;
+        uint64_t clockUs = 1000;
+        const auto first = lanes.next();
+        CHECK(first.second <= 4096 && first.second % telemetry.size() == 0);
+        CHECK(lanes.push(OutboundLanes::Lane::Priority, pacing.data(), pacing.size(), clockUs));
+        lanes.consume(first.second / 2, clockUs, latency);  // Partial write: finish the packet in flight
+        const auto rest = lanes.next();
+        CHECK(rest.second == first.second - first.second / 2);
+        lanes.consume(rest.second, ++clockUs, latency);
+        const auto next = lanes.next();
+        CHECK(next.second == pacing.size() && memcmp(next.first, pacing.data(), pacing.size()) == 0);
+        lanes.consume(next.second, ++clockUs, latency);
+        CHECK(latency.count() == 1 && latency.max() == 2);
+        drainLanes(lanes, clockUs, latency);
+        CHECK(!lanes.pending() && latency.count() == 1);
+    }
+
+    // Priority chunks are whole lanes; untimed packets are not recorded; caps drop
+    OutboundLanes lanes(2 + pacing.size() * 2, telemetry.size(), 4096);
+    LatencyHistogram latency;
+    uint64_t clockUs = 0;
+    mqtt::encodePingresp(lanes.lane(OutboundLanes::Lane::Priority));
+    CHECK(lanes.push(OutboundLanes::Lane::Priority, pacing.data(), pacing.size(), 5));
+    CHECK(lanes.push(OutboundLanes::Lane::Priority, pacing.data(), pacing.size()));
+    CHECK(!lanes.push(OutboundLanes::Lane::Priority, pacing.data(), pacing.size(), 5));
+    CHECK(lanes.push(OutboundLanes::Lane::Bulk, telemetry.data(), telemetry.size()));
+    CHECK(!lanes.push(OutboundLanes::Lane::Bulk, telemetry.data(), telemetry.size()));
+    const std::vector<uint8_t> order = drainLanes(lanes, clockUs, latency);
+    CHECK(order == std::vector<uint8_t>({mqtt::PINGRESP << 4, mqtt::PUBLISH << 4}));
+    CHECK(latency.count() == 1 && latency.max() == 0);  // Produced at 5, written at 1: clamped
+
+    // Histogram buckets are powers of two
+    LatencyHistogram h;
+    CHECK(h.quantile(0.5) == 0);
+    for (uint64_t us : {0u, 1u, 3u, 900u, 1000u, 1023u, 1024u, 50000u}) {
+        h.record(us);
+    }
+    CHECK(h.count() == 8 && h.max() == 50000);
+    CHECK(h.quantile(0.0) == 1 && h.quantile(0.5) == 1024 && h.quantile(0.99) == 2048 && h.quantile(1.0) == 65536);
+}
+
+// ==========================================
+// Frames
+// ==========================================
+void checkFrames() {
+    Frame frame;
+    std::vector<double> samples;
+
+    CHECK(decodeText("{\"device_id\":\"dev-1\",\"ts\":1200,\"fs\":125,\"ppg\":[1.5, -2, 3e2]}", frame, samples) ==
+          FrameStatus::Ok);
+    CHECK(frame.deviceId == "dev-1" && frame.hasTimestamp && frame.timestampMs == 1200);
+    CHECK(frame.samplingRate == 125.0);
+    CHECK(samples == (std::vector<double>{1.5, -2.0, 300.0}));
+
+    // Firmware v1 and bridge frames: one sample, no device id
+    CHECK(decodeText("{\"ppg\":2048.25,\"ts\":5}", frame, samples) == FrameStatus::Ok);
+    CHECK(frame.deviceId == DEFAULT_DEVICE_ID && samples == std::vector<double>{2048.25});
+    CHECK(decodeText("{\"value\":812,\"ts\":5,\"device_id\":\"uart\"}", frame, samples) == FrameStatus::Ok);
+    CHECK(frame.deviceId == "uart" && samples == std::vector<double>{812.0});
+    CHECK(decodeText(" 17.5 ", frame, samples) == FrameStatus::Ok && samples == std::vector<double>{17.5});
+
+    // Unknown keys of any shape are skipped
+    CHECK(decodeText("{\"meta\":{\"a\":[1,{\"b\":null}],\"c\":\"x\\\"y\"},\"ok\":true,\"signal\":[4]}", frame,
+                     samples) == FrameStatus::Ok);
+    CHECK(samples == std::vector<double>{4.0});
+
+    CHECK(decodeText("{\"device_id\":\"a/b\",\"ppg\":[1]}", frame, samples) == FrameStatus::BadDeviceId);
+    CHECK(decodeText("{\"device_id\":\"a\\u0041\",\"ppg\":[1]}", frame, samples) == FrameStatus::BadDeviceId);
+    CHECK(decodeText("{\"device_id\":\"\",\"ppg\":[1]}", frame, samples) == FrameStatus::BadDeviceId);
+    CHECK(decodeText("{\"device_id\":\"x\",\"ppg\":[]}", frame, samples) == FrameStatus::NoSamples);
+    CHECK(decodeText("{\"device_id\":\"x\"}", frame, samples) == FrameStatus::NoSamples);
+    CHECK(decodeText("{\"ppg\":[1,\"2\"]}", frame, samples) == FrameStatus::BadSample);
+    CHECK(decodeText("{\"ppg\":[1e999]}", frame, samples) == FrameStatus::BadSample);
+    CHECK(decodeText("{\"ppg\":[1]} x", frame, samples) == FrameStatus::Malformed);
+    CHECK(decodeText("{\"ppg\":[1,2", frame, samples) == FrameStatus::Malformed);
+    CHECK(decodeText("", frame, samples) == FrameStatus::Malformed);
+
+    std::string many = "{\"ppg\":[";
+    for (size_t i = 0; i <= MAX_FRAME_SAMPLES; i++) {
+        many += i ? ",1" : "1";
+    }
+    many += "]}";
+    CHECK(decodeText(many, frame, samples) == FrameStatus::TooManySamples);
+
+    // Binary
+    std::vector<uint8_t> bin = binaryFrame("dev-2", SAMPLE_FORMAT_FLOAT32, {1.5, 2.25}, 100, 777);
+    CHECK(decodeFrame(bin.data(), bin.size(), frame, samples) == FrameStatus::Ok);
+    CHECK(frame.deviceId == "dev-2" && frame.timestampMs == 777 && frame.samplingRate == 100.0);
+    CHECK(samples == (std::vector<double>{1.5, 2.25}));
+    CHECK(peekDeviceId(bin.data(), bin.size()) == "dev-2");
+    bin.pop_back();
+    CHECK(decodeFrame(bin.data(), bin.size(), frame, samples) == FrameStatus::Malformed);
+    bin = binaryFrame("dev-3", SAMPLE_FORMAT_UINT16, {4095, 0}, 0, 1);
+    CHECK(decodeFrame(bin.data(), bin.size(), frame, samples) == FrameStatus::Ok);
+    CHECK(samples == (std::vector<double>{4095.0, 0.0}) && frame.samplingRate == 0.0);
+    bin = binaryFrame("dev#", SAMPLE_FORMAT_UINT16, {1}, 0, 1);
+    CHECK(decodeFrame(bin.data(), bin.size(), frame, samples) == FrameStatus::BadDeviceId);
+
+    const std::string text = "{\"ts\":1, \"device_id\" : \"dev-4\",\"ppg\":[1]}";
+    CHECK(peekDeviceId(reinterpret_cast<const uint8_t*>(text.data()), text.size()) == "dev-4");
+    const std::string none = "{\"ppg\":[1]}";
+    CHECK(peekDeviceId(reinterpret_cast<const uint8_t*>(none.data()), none.size()) == DEFAULT_DEVICE_ID);
+
+    // Trace context: a bad traceparent leaves the frame untraced, not rejected
+    CHECK(decodeText("{\"device_id\":\"dev-5\",\"traceparent\":\"" TRACEPARENT "\",\"ppg\":[1]}", frame,
+                     samples) == FrameStatus::Ok);
+    CHECK(frame.trace.sampled() && frame.trace.spanId == 0x00f067aa0ba902b7ull && frame.trace.traceId[0] == 0x4b);
+    CHECK(decodeText("{\"ppg\":[1]}", frame, samples) == FrameStatus::Ok && !frame.trace.valid());
+    CHECK(decodeText("{\"traceparent\":\"00-zz\",\"ppg\":[1]}", frame, samples) == FrameStatus::Ok);
+    CHECK(!frame.trace.valid());
+    CHECK(decodeText("{\"traceparent\":7,\"ppg\":[1]}", frame, samples) == FrameStatus::Malformed);
+}
+
+bool decodeReport(const std::string& text, TraceReport& report) {
+    g_text = text;
+    return decodeTraceReport(reinterpret_cast<const uint8_t*>(g_text.data()), g_text.size(), report) ==
+           FrameStatus::Ok;
+}
+
+void checkTraceReports() {
+    TraceReport r;
+    const std::string head = "{\"device_id\":\"dev-1\",\"traceparent\":\"" TRACEPARENT "\",";
+    CHECK(decodeReport(head + "\"sample_ms\":1000,\"command_rx_ms\":1150,\"applied_ms\":1160,"
+                              "\"actuation_ms\":1700,\"now_ms\":1701}",
+                       r));
+    CHECK(r.deviceId == "dev-1" && r.command.spanId == 0x00f067aa0ba902b7ull);
+    CHECK(r.sampleMs == 1000 && r.commandRxMs == 1150 && r.appliedMs == 1160 && r.actuationMs == 1700 &&
+          r.nowMs == 1701);
+
+    // millis() wraps after 49.7 days; steps are taken modulo 2^32
+    CHECK(decodeReport(head + "\"sample_ms\":4294967000,\"command_rx_ms\":100,\"applied_ms\":110,"
+                              "\"actuation_ms\":300,\"now_ms\":300}",
+                       r));
+    CHECK(static_cast<uint32_t>(r.actuationMs - r.sampleMs) == 596);
+
+    // Out of order, missing, unparseable or implausibly spread times
+    CHECK(!decodeReport(head + "\"sample_ms\":1000,\"command_rx_ms\":900,\"applied_ms\":1160,"
+                               "\"actuation_ms\":1700,\"now_ms\":1701}",
+                        r));
+    CHECK(!decodeReport(head + "\"sample_ms\":1000,\"applied_ms\":1160,\"actuation_ms\":1700,\"now_ms\":1701}",
+                        r));
+    CHECK(!decodeReport(head + "\"sample_ms\":1000,\"command_rx_ms\":1150,\"applied_ms\":1160,"
+                               "\"actuation_ms\":90000,\"now_ms\":90001}",
+                        r));
+    CHECK(!decodeReport(head + "\"sample_ms\":-1,\"command_rx_ms\":1150,\"applied_ms\":1160,"
+                               "\"actuation_ms\":1700,\"now_ms\":1701}",
+                        r));
+    CHECK(!decodeReport("{\"device_id\":\"dev-1\",\"traceparent\":\"00-bad\",\"sample_ms\":1000,"
+                        "\"command_rx_ms\":1150,\"applied_ms\":1160,\"actuation_ms\":1700,\"now_ms\":1701}",
+                        r));
+    CHECK(!decodeReport("{\"device_id\":\"a/b\",\"traceparent\":\"" TRACEPARENT "\",\"sample_ms\":1000,"
+                        "\"command_rx_ms\":1150,\"applied_ms\":1160,\"actuation_ms\":1700,\"now_ms\":1701}",
+                        r));
+}
+
+FrameStatus decodeStatus(const std::string& text, DeviceStatus& status) {
+    g_text = text;
+    return decodeDeviceStatus(reinterpret_cast<const uint8_t*>(g_text.data()), g_text.size(), status);
+}
+
+void checkDeviceStatus() {
+    DeviceStatus st;
+    CHECK(decodeStatus("{\"device_id\":\"dev-1\",\"status\":\"ok\",\"cmd_latency_ms\":{\"last\":3},"
+                       "\"metrics\":{\"pulsemind_device_commands_total\":42,"
+                       "\"pulsemind_device_command_latency_max_seconds\":0.125}}",
+                       st) == FrameStatus::Ok);
+    CHECK(st.deviceId == "dev-1" && st.metricCount == 2);
+    CHECK(st.metrics[0].first == "pulsemind_device_commands_total" && st.metrics[0].second == 42.0);
+    CHECK(st.metrics[1].first == "pulsemind_device_command_latency_max_seconds" && st.metrics[1].second == 0.125);
+
+    // The firmware's connect notice: no device id, no metrics
+    CHECK(decodeStatus("{\"status\":\"connected\",\"fw_version\":\"1.0.0\"}", st) == FrameStatus::Ok);
+    CHECK(st.deviceId == DEFAULT_DEVICE_ID && st.metricCount == 0);
+
+    CHECK(decodeStatus("{\"metrics\":{\"a\":\"x\"}}", st) == FrameStatus::Malformed);
+    CHECK(decodeStatus("{\"metrics\":[1]}", st) == FrameStatus::Malformed);
+    CHECK(decodeStatus("{\"metrics\":{\"a\":1}", st) == FrameStatus::Malformed);
+    CHECK(decodeStatus("{\"device_id\":\"a/b\",\"metrics\":{}}", st) == FrameStatus::BadDeviceId);
+    std::string many = "{\"metrics\":{";
+    for (size_t i = 0; i <= MAX_STATUS_METRICS; i++) {
+        many += (i ? ",\"m" : "\"m") + std::to_string(i) + "\":1";
+    }
+    CHECK(decodeStatus(many + "}}", st) == FrameStatus::TooManySamples);
+}
+
+// ==========================================
+// Streams and Trend
+// ==========================================
+void checkStream() {
+    DeviceStream stream;
+    std::vector<double> frame(10);
+    double next = 0.0;
+    uint64_t ts = 1000;
+    size_t windows = 0;
+    for (int f = 0; f < 100; f++, ts += 100) {  // 10 s at 100 Hz
+        for (double& v : frame) {
+            v = next++;
+        }
+        if (stream.append(frame.data(), frame.size(), 100.0, true, ts) == DeviceStream::Append::WindowReady) {
+            std::vector<double> window(stream.windowLength());
+            stream.takeWindow(window.data());
+            CHECK(window.size() == 400);
+            CHECK(window.front() == next - 400 && window.back() == next - 1);
+            windows++;
+        }
+    }
+    CHECK(windows == 7);  // At 4 s, then every second to 10 s
+    CHECK(stream.gaps() == 0);
+
+    // Jitter within tolerance is not a gap; a skipped second restarts the window
+    CHECK(stream.append(frame.data(), frame.size(), 100.0, true, ts + 200) == DeviceStream::Append::Buffered);
+    CHECK(stream.gaps() == 0);
+    CHECK(stream.append(frame.data(), frame.size(), 100.0, true, ts + 1300) == DeviceStream::Append::Buffered);
+    CHECK(stream.gaps() == 1);
+    ts += 1400;
+    for (int f = 0; f < 38; f++, ts += 100) {
+        CHECK(stream.append(frame.data(), frame.size(), 100.0, true, ts) == DeviceStream::Append::Buffered);
+    }
+    CHECK(stream.append(frame.data(), frame.size(), 100.0, true, ts) == DeviceStream::Append::WindowReady);
+
+    // A sampling rate change resizes the window
+    stream.append(frame.data(), frame.size(), 50.0, false, 0);
+    CHECK(stream.windowLength() == 200);
+
+    TrendTracker flat;
+    TrendTracker rising;
+    TrendTracker falling;
+    Trend f = Trend::Stable, r = Trend::Stable, d = Trend::Stable;
+    for (int i = 0; i < 20; i++) {
+        f = flat.update(10.0 * i, 60.0 + (i % 2) * 0.5);
+        r = rising.update(10.0 * i, 40.0 + i);
+        d = falling.update(10.0 * i, 80.0 - i);
+    }
+    CHECK(f == Trend::Stable && r == Trend::Improving && d == Trend::Declining);
+
+    // round(x, 2) semantics: exact binary value, ties to even
+    CHECK(roundTo2(2.675) == 2.67);
+    CHECK(roundTo2(0.125) == 0.12);
+    CHECK(roundTo2(72.3456) == 72.35);
+}
+
+// ==========================================
+// Bundle
+// ==========================================
+void checkBundle() {
+    char path[] = "/tmp/ingest_check_bundle_XXXXXX";
+    const int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    const std::string text =
+        "pulsemind-ingest-bundle 1\n"
+        "labels 2 normal_sinus artifact\n"
+        "filter 0x1.9p+6 3\n0x1p-2 0x0p+0 -0x1p-2\n0x1p+0 -0x1p-1 0x1p-3\n"
+        "tree 3\n"
+        "0 0x1.2p+6 1 2 0x1p+0 0x1p+0\n"
+        "-2 -0x1p+1 -1 -1 0x1.8p+1 0x1p+0\n"
+        "-2 -0x1p+1 -1 -1 0x0p+0 0x1p+2\n"
+        "end\n";
+    CHECK(write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size()));
+    close(fd);
+
+    IngestBundle bundle;
+    std::string error;
+    CHECK(bundle.load(path, error));
+    CHECK(error.empty());
+    CHECK(bundle.label(1) == "artifact" && bundle.rhythm(0) == Rhythm::NormalSinus);
+    const BandpassFilter* filter = bundle.filterFor(100.0);
+    CHECK(filter != nullptr && filter->b.size() == 3 && filter->a[1] == -0.5);
+    CHECK(bundle.filterFor(250.0) == nullptr);
+
+    double proba[MAX_FOREST_CLASSES];
+    const double low[3] = {60.0, 50.0, 20.0};   // 60 <= 72: left leaf
+    const double high[3] = {90.0, 50.0, 20.0};  // right leaf
+    bundle.forest().predictProba(low, proba);
+    CHECK(proba[0] == 0.75 && proba[1] == 0.25);
+    bundle.forest().predictProba(high, proba);
+    CHECK(proba[0] == 0.0 && proba[1] == 1.0);
+
+    // Child before parent: rejected
+    const std::string bad =
+        "pulsemind-ingest-bundle 1\nlabels 1 normal_sinus\nfilter 100 2\n1 1\n1 0\n"
+        "tree 2\n0 0 0 1 1\n-2 -2 -1 -1 1\nend\n";
+    FILE* f = fopen(path, "w");
+    fputs(bad.c_str(), f);
+    fclose(f);
+    IngestBundle rejected;
+    error.clear();
+    CHECK(!rejected.load(path, error) && error == "inconsistent tree layout");
+
+    f = fopen(path, "w");
+    fputs("pulsemind-ingest-bundle 2\nend\n", f);
+    fclose(f);
+    IngestBundle wrongVersion;
+    CHECK(!wrongVersion.load(path, error));
+    unlink(path);
+}
+
+}  // namespace
+
+int main() {
+    checkMqtt();
+    checkMqttBroker();
+    checkLanes();
+    checkFrames();
+    checkTraceReports();
+    checkDeviceStatus();
+    checkStream();
+    checkBundle();
+    if (g_failures > 0) {
+        printf("FAILED: %d check(s)\n", g_failures);
+        return 1;
+    }
+    printf("OK: ingest worker checks passed\n");
+    return 0;
+}
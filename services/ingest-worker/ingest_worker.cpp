@@ -0,0 +1,2248 @@
+/**
+ * PulseMind ingest worker: the closed loop from device sensor frames to
+ * pacing commands.
+ *
+ *   pulsemind/sensor/ppg --(shared subscription)--> network thread
+ *       --(shard by device id)--> worker threads: DeviceStream window
+ *       -> PpgPipeline (filter, peaks, features, HSI, forest)
+ *       -> SafetyPolicy (policy + command shaper)
+ *   pulsemind/pacing/command/<device_id> <-- network thread
+ *
+ * One network thread runs an epoll loop over --connections broker
+ * connections. All of them subscribe to $share/<group>/<topic>, so the
+ * broker load-balances frames across connections and across any number of
+ * worker processes started with the same group. Each device is owned by one
+ * worker thread (FNV-1a of the device id), which keeps its window, trend,
+ * policy and shaper state without locks.
+ *
+ * Commands are published only when the shaper reports a change worth
+ * sending (or the keepalive is due), as {"pacing_command": {...}} with the
+ * decision's input_summary (the same fields as process_pacing_decision, at
+ * full precision) and the policy_state the decision started from. The
+ * firmware adopts that state and re-runs the shared policy on those inputs
+ * (PacingController::processCommand) instead of trusting the command alone;
+ * since the state carries the hysteresis counters and the last rate, the
+ * device's policy does not depend on which decisions the shaper dropped.
+ *
+ * Decisions made here are not written to the control engine's decision
+ * journal: it is encrypted under the services' keyring, which the worker
+ * does not hold. The audit trail of closed-loop pacing is the command topic
+ * itself, plus the features and samples behind each window with --store;
+ * GET /decisions covers decisions made through the control engine only.
+ *
+ * With --listen the worker is the broker (EmbeddedBroker): devices connect
+ * to it directly, frames go from the socket to the router without a broker
+ * hop, and commands go out in a priority lane ahead of sensor fan-out.
+ * Without it, the worker is a client of a regular broker (mosquitto), the
+ * compatibility mode.
+ *
+ * With --store each worker also writes its devices' raw samples and the
+ * features of every analyzed window to the time-series store
+ * (TimeSeriesStore.h), stamped with wall-clock time, so the waveform behind
+ * any decision can be pulled later, along with 1 s to 10 min rollups for
+ * long-range plots. Heads are flushed every sweep, which bounds what a crash
+ * can lose to SWEEP_INTERVAL_MS of samples (and the open rollup buckets).
+ *
+ * Frames carrying a sampled traceparent are traced. With --trace-file the
+ * worker records spans for each window such a frame completes (time in the
+ * inbox, the window, pipeline analysis, the policy decision and the hand-off
+ * of the command to a connection), puts the trace context into the command
+ * (traceparent) and appends the spans to the file as OTLP/JSON lines. The
+ * device answers a traced command with a report on pulsemind/device/trace,
+ * from which the worker keeps the sample-to-actuation latency (printed with
+ * the stats, with or without --trace-file) and records the device's spans.
+ *
+ * With --metrics-file the worker writes its totals, the sample-to-actuation
+ * latency and the metrics of device status frames (pulsemind/device/status,
+ * pulsemind_device_* labelled by device_id) to the file in the services'
+ * /metrics format, replacing it at every stats interval and on exit.
+ *
+ * The model bundle comes from export_ingest_bundle.py.
+ *
+ * Usage:
+ *   ingest_worker [--host H] [--port P] [--bundle FILE] [--workers N]
+ *                 [--connections N] [--group NAME] [--client-id ID]
+ *                 [--keepalive SEC] [--stats-interval SEC] [--store DIR]
+ *                 [--trace-file FILE] [--metrics-file FILE]
+ *   ingest_worker --listen PORT [--bundle FILE] [--workers N] [--stats-interval SEC]
+ *                 [--store DIR] [--trace-file FILE] [--metrics-file FILE]
+ *   ingest_worker --bench DEVICES [--bench-seconds S] [--bundle FILE] [--workers N]
+ *                 [--store DIR]
+ *   ingest_worker --probe --bundle FILE      (window analysis over stdin, for tests)
+ *
+ * Defaults come from MQTT_HOST, MQTT_PORT, PULSEMIND_INGEST_BUNDLE,
+ * PULSEMIND_INGEST_WORKERS, PULSEMIND_INGEST_CONNECTIONS,
+ * PULSEMIND_INGEST_GROUP, PULSEMIND_INGEST_LISTEN, PULSEMIND_TSDB_DIR,
+ * PULSEMIND_TRACE_FILE and PULSEMIND_METRICS_FILE.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "DeviceStream.h"
+#include "IngestBundle.h"
+#include "IngestFrame.h"
+#include "Metrics.h"
+#include "MqttCodec.h"
+#include "OutboundLanes.h"
+#include "TimeSeriesStore.h"
+#include "TraceRing.h"
+
+using namespace pulsemind;
+
+namespace {
+
+// ==========================================
+// Configuration
+// ==========================================
+constexpr const char* SENSOR_TOPIC = "pulsemind/sensor/ppg";           // Firmware TOPIC_SENSOR_DATA
+constexpr const char* COMMAND_TOPIC = "pulsemind/pacing/command";         // Firmware TOPIC_PACING_CMD
+constexpr const char* COMMAND_TOPIC_PREFIX = "pulsemind/pacing/command/"; // + device id
+constexpr const char* TRACE_TOPIC = "pulsemind/device/trace";             // Firmware TOPIC_DEVICE_TRACE
+constexpr const char* STATUS_TOPIC = "pulsemind/device/status";           // Firmware TOPIC_DEVICE_STATUS
+
+// Tracing
+constexpr const char* TRACE_SERVICE = "ingest-worker";
+constexpr const char* DEVICE_TRACE_SERVICE = "esp32-firmware";
+
+constexpr uint32_t MAX_PACKET_SIZE = 256 * 1024;
+constexpr size_t INBOX_MAX_BYTES = 16 * 1024 * 1024;  // Per worker; frames beyond this are dropped
+constexpr size_t OUTBUF_MAX_BYTES = 8 * 1024 * 1024;  // Per connection; commands beyond this are dropped
+constexpr uint64_t DEVICE_IDLE_TIMEOUT_MS = 5 * 60 * 1000;
+constexpr uint64_t SWEEP_INTERVAL_MS = 10 * 1000;
+constexpr uint64_t RECONNECT_MIN_MS = 500;
+constexpr uint64_t RECONNECT_MAX_MS = 10 * 1000;
+
+// Embedded broker
+constexpr size_t SESSION_PRIORITY_MAX_BYTES = 256 * 1024;  // Per client; commands beyond this are dropped
+constexpr size_t SESSION_BULK_MAX_BYTES = 1024 * 1024;     // Per client; sensor fan-out beyond this is dropped
+constexpr size_t WIRE_CHUNK_BYTES = 16 * 1024;             // Bulk bytes a command can queue behind
+constexpr uint64_t CONNECT_TIMEOUT_MS = 10 * 1000;         // Accepted socket to CONNECT
+
+struct Config {
+    std::string host = "localhost";
+    int port = 1883;
+    std::string bundlePath = "build/ingest_bundle.txt";
+    std::string group = "pulsemind-ingest";
+    std::string clientId;
+    unsigned workers = 0;
+    unsigned connections = 1;
+    unsigned keepaliveSec = 30;
+    int listenPort = -1;  // >= 0: embedded broker mode (0 picks a free port)
+    std::string storeDir; // Time-series store root (empty: samples are not kept)
+    std::string traceFile; // OTLP/JSON span lines (empty: no spans are recorded)
+    std::string metricsFile; // Exposition text (empty: metrics are not written)
+    unsigned statsIntervalSec = 10;
+    unsigned benchDevices = 0;
+    unsigned benchSeconds = 10;
+    bool probe = false;
+};
+
+uint64_t nowMs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+}
+
+uint64_t nowUs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+}
+
+int64_t wallUs() {
+    return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                    std::chrono::system_clock::now().time_since_epoch())
+                                    .count());
+}
+
+uint32_t fnv1a(std::string_view s) {
+    uint32_t h = 2166136261u;
+    for (char c : s) {
+        h ^= static_cast<uint8_t>(c);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+std::atomic<bool> g_stop{false};
+
+void onSignal(int) { g_stop.store(true); }
+
+// ==========================================
+// Outbound Commands
+// ==========================================
+
+/**
+ * A pacing command, stamped when its worker produced it. A traced command
+ * carries its dispatch span (trace.spanId, echoed to the device in the
+ * payload) and that span's parent, the window span.
+ */
+struct Command {
+    std::string topic;
+    std::string payload;
+    uint64_t producedUs;
+    trace::TraceContext trace;  // Not valid() when the command is not traced
+    uint64_t traceParent;
+    int64_t producedWallUs;
+};
+
+/**
+ * Commands produced by workers, drained by the network thread.
+ */
+class Outbox {
+public:
+    Outbox() : wakeFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+    ~Outbox() {
+        if (wakeFd_ >= 0) {
+            close(wakeFd_);
+        }
+    }
+
+    int wakeFd() const { return wakeFd_; }
+
+    void push(std::string topic, std::string payload, const trace::TraceContext& context = trace::TraceContext{},
+              uint64_t traceParent = 0) {
+        const int64_t wall = context.valid() ? trace::wallUs() : 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_.push_back({std::move(topic), std::move(payload), nowUs(), context, traceParent, wall});
+        }
+        const uint64_t one = 1;
+        if (write(wakeFd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            perror("ingest_worker: eventfd write");
+        }
+    }
+
+    void drain(std::vector<Command>& out) {
+        uint64_t count;
+        if (read(wakeFd_, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+            perror("ingest_worker: eventfd read");
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        out.swap(pending_);
+    }
+
+private:
+    int wakeFd_;
+    std::mutex mutex_;
+    std::vector<Command> pending_;
+};
+
+// ==========================================
+// Workers
+// ==========================================
+struct WorkerStats {
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> samples{0};
+    std::atomic<uint64_t> rejected{0};       // Undecodable frame or unsupported sampling rate
+    std::atomic<uint64_t> windows{0};
+    std::atomic<uint64_t> analysisFailed{0}; // Too few peaks, features out of range
+    std::atomic<uint64_t> commands{0};
+    std::atomic<uint64_t> devices{0};
+    std::atomic<uint64_t> storeErrors{0};    // Appends rejected or blocks lost by the store
+};
+
+/**
+ * Frames waiting for a worker: payloads back to back in bytes, ends[i] is
+ * the end offset of payload i and receivedUs[i] the wall time it was read
+ * off the socket (0: unknown).
+ */
+struct FrameBatch {
+    std::vector<uint8_t> bytes;
+    std::vector<uint32_t> ends;
+    std::vector<int64_t> receivedUs;
+
+    void add(const uint8_t* p, size_t n, int64_t received) {
+        bytes.insert(bytes.end(), p, p + n);
+        ends.push_back(static_cast<uint32_t>(bytes.size()));
+        receivedUs.push_back(received);
+    }
+
+    void clear() {
+        bytes.clear();
+        ends.clear();
+        receivedUs.clear();
+    }
+
+    bool empty() const { return ends.empty(); }
+};
+
+/**
+ * Stage times of one traced window, filled in by analyze().
+ */
+struct WindowTrace {
+    trace::TraceContext frame;  // The device's: trace id and its root span
+    uint64_t windowSpan;
+    int64_t pipelineStartUs;
+    int64_t pipelineEndUs;
+    int64_t policyEndUs;
+    bool analyzed;
+    bool published;
+    double heartRateBpm;
+    const char* safetyState;
+    const char* pacingMode;
+};
+
+class Worker {
+public:
+    Worker(const IngestBundle& bundle, Outbox& outbox, std::unique_ptr<tsdb::TimeSeriesWriter> store,
+           trace::SpanRing* spans)
+        : bundle_(bundle), outbox_(outbox), store_(std::move(store)), spans_(spans) {}
+
+    WorkerStats stats;
+
+    /**
+     * Hand a batch to the worker; returns false (and leaves the batch) when
+     * the inbox is full.
+     */
+    bool submit(FrameBatch& batch) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (inbox_.bytes.size() + batch.bytes.size() > INBOX_MAX_BYTES) {
+                return false;
+            }
+            if (inbox_.empty()) {
+                inbox_.bytes.swap(batch.bytes);
+                inbox_.ends.swap(batch.ends);
+                inbox_.receivedUs.swap(batch.receivedUs);
+            } else {
+                const uint32_t base = static_cast<uint32_t>(inbox_.bytes.size());
+                inbox_.bytes.insert(inbox_.bytes.end(), batch.bytes.begin(), batch.bytes.end());
+                for (uint32_t end : batch.ends) {
+                    inbox_.ends.push_back(base + end);
+                }
+                inbox_.receivedUs.insert(inbox_.receivedUs.end(), batch.receivedUs.begin(), batch.receivedUs.end());
+            }
+            busy_ = true;
+        }
+        ready_.notify_one();
+        batch.clear();
+        return true;
+    }
+
+    /**
+     * Whether everything submitted so far has been processed.
+     */
+    bool idle() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return !busy_;
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        ready_.notify_one();
+    }
+
+    void run() {
+        FrameBatch batch;
+        uint64_t lastSweep = nowMs();
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (inbox_.empty()) {
+                    busy_ = false;
+                }
+                ready_.wait_for(lock, std::chrono::milliseconds(SWEEP_INTERVAL_MS),
+                                [&] { return stopping_ || !inbox_.empty(); });
+                if (stopping_) {
+                    return;
+                }
+                batch.bytes.swap(inbox_.bytes);
+                batch.ends.swap(inbox_.ends);
+                batch.receivedUs.swap(inbox_.receivedUs);
+            }
+            uint32_t start = 0;
+            for (size_t i = 0; i < batch.ends.size(); i++) {
+                process(batch.bytes.data() + start, batch.ends[i] - start, batch.receivedUs[i]);
+                start = batch.ends[i];
+            }
+            batch.clear();
+
+            const uint64_t now = nowMs();
+            if (now - lastSweep >= SWEEP_INTERVAL_MS) {
+                sweep(now);
+                lastSweep = now;
+            }
+        }
+    }
+
+private:
+    void process(const uint8_t* payload, size_t n, int64_t receivedUs) {
+        Frame frame;
+        if (decodeFrame(payload, n, frame, samples_) != FrameStatus::Ok) {
+            stats.rejected.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        const bool traced = spans_ != nullptr && frame.trace.sampled();
+        const int64_t startUs = traced ? trace::wallUs() : 0;
+        const double samplingRate = frame.samplingRate > 0 ? frame.samplingRate : DEFAULT_SAMPLING_RATE_HZ;
+        const BandpassFilter* filter = bundle_.filterFor(samplingRate);
+        if (filter == nullptr) {
+            stats.rejected.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        stats.frames.fetch_add(1, std::memory_order_relaxed);
+        stats.samples.fetch_add(samples_.size(), std::memory_order_relaxed);
+
+        key_.assign(frame.deviceId.data(), frame.deviceId.size());
+        auto it = devices_.find(key_);
+        if (it == devices_.end()) {
+            it = devices_.emplace(key_, std::make_unique<DeviceState>()).first;
+            stats.devices.fetch_add(1, std::memory_order_relaxed);
+        }
+        DeviceState& device = *it->second;
+        device.lastSeenMs = nowMs();
+        if (store_) {
+            keep(it->first, device, frame, samplingRate);
+        }
+        if (device.stream.append(samples_.data(), samples_.size(), samplingRate, frame.hasTimestamp,
+                                 frame.timestampMs) == DeviceStream::Append::WindowReady) {
+            // Device clock time of the newest sample, echoed in the command so
+            // the device can measure sample-to-command latency on its own clock
+            const int64_t frameTsMs =
+                frame.hasTimestamp
+                    ? static_cast<int64_t>(frame.timestampMs +
+                                           std::llround((samples_.size() - 1) * 1000.0 / samplingRate))
+                    : -1;
+            if (!traced) {
+                analyze(it->first, device, *filter, frameTsMs, nullptr);
+                return;
+            }
+            WindowTrace window = {};
+            window.frame = frame.trace;
+            window.windowSpan = trace::randomId();
+            analyze(it->first, device, *filter, frameTsMs, &window);
+            recordWindow(it->first, window, receivedUs, startUs);
+        }
+    }
+
+    /**
+     * Append the frame's samples to the store, and remember when the newest
+     * was taken for the features of a window it completes.
+     */
+    void keep(const std::string& deviceId, DeviceState& device, const Frame& frame, double samplingRate) {
+        const size_t n = samples_.size();
+        const int64_t start =
+            device.clock.frameStart(n, samplingRate, frame.hasTimestamp, frame.timestampMs, wallUs());
+        sampleTimes_.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            sampleTimes_[i] = start + static_cast<int64_t>(i) * device.clock.periodUs();
+        }
+        newestSampleUs_ = n > 0 ? sampleTimes_[n - 1] : start;
+        if (store_->append(deviceId, tsdb::Metric::Ppg, sampleTimes_.data(), samples_.data(), n) !=
+            tsdb::Status::Ok) {
+            stats.storeErrors.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void keepFeature(const std::string& deviceId, tsdb::Metric metric, double value) {
+        if (store_->append(deviceId, metric, &newestSampleUs_, &value, 1) != tsdb::Status::Ok) {
+            stats.storeErrors.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Analyze the device's window and publish a command if the shaper says
+     * so. timing, when given, gets the stage times and a traced command.
+     */
+    void analyze(const std::string& deviceId, DeviceState& device, const BandpassFilter& filter, int64_t frameTsMs,
+                 WindowTrace* timing) {
+        if (timing) {
+            timing->pipelineStartUs = trace::wallUs();
+        }
+        window_.resize(device.stream.windowLength());
+        device.stream.takeWindow(window_.data());
+        stats.windows.fetch_add(1, std::memory_order_relaxed);
+
+        PipelineResult r;
+        const PipelineStatus status = runPipeline(bundle_.forest(), filter.b.data(), filter.a.data(),
+                                                  filter.b.size(), window_.data(), window_.size(),
+                                                  filter.samplingRate, workspace_, r);
+        if (timing) {
+            timing->pipelineEndUs = trace::wallUs();
+        }
+        // Same range checks as process_hsi_computation and classify_rhythm
+        if (status != PipelineStatus::Ok || r.heartRateBpm <= 0 || r.heartRateBpm > 300 || !(r.hrvSdnnMs >= 0) ||
+            r.hrvSdnnMs > 500) {
+            stats.analysisFailed.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (store_) {
+            keepFeature(deviceId, tsdb::Metric::HeartRate, r.heartRateBpm);
+            keepFeature(deviceId, tsdb::Metric::HrvSdnn, r.hrvSdnnMs);
+            keepFeature(deviceId, tsdb::Metric::PulseAmplitude, r.pulseAmplitude);
+            keepFeature(deviceId, tsdb::Metric::Hsi, r.hsi.hsiScore);
+        }
+
+        // process_pacing_decision on the fused pipeline's stage outputs
+        const uint64_t now = nowMs();
+        const uint32_t label = r.predictedClass;
+        double confidence = r.probabilities[label];
+        double hsi = roundTo2(r.hsi.hsiScore);
+        const Trend trend = device.trend.update(now / 1000.0, hsi);
+        double heartRate = r.heartRateBpm;
+        sanitizeInputs(confidence, hsi, heartRate);
+        const PolicyState before = device.policy.state();
+        const PacingCommand cmd = device.policy.compute(bundle_.rhythm(label), confidence, hsi, trend, heartRate);
+        const ShapedCommand shaped =
+            device.shaper.shape(cmd.pacingEnabled, cmd.targetRateBpm, cmd.mode == PacingMode::Emergency, now);
+        if (timing) {
+            timing->policyEndUs = trace::wallUs();
+            timing->analyzed = true;
+            timing->published = shaped.publish;
+            timing->heartRateBpm = heartRate;
+            timing->safetyState = safetyStateName(cmd.state);
+            timing->pacingMode = pacingModeName(cmd.mode);
+        }
+        if (!shaped.publish) {
+            return;
+        }
+
+        static const char* const TREND_NAMES[] = {"stable", "improving", "declining"};
+        char frameTs[48] = "";
+        if (frameTsMs >= 0) {
+            snprintf(frameTs, sizeof(frameTs), "\"frame_ts_ms\":%" PRId64 ",", frameTsMs);
+        }
+        // The device parents its spans on the command's dispatch span
+        trace::TraceContext commandTrace = {};
+        char traceparent[24 + trace::TRACEPARENT_LENGTH] = "";
+        if (timing) {
+            commandTrace = timing->frame;
+            commandTrace.spanId = trace::randomId();
+            char value[trace::TRACEPARENT_LENGTH + 1];
+            trace::formatTraceparent(commandTrace, value);
+            snprintf(traceparent, sizeof(traceparent), "\"traceparent\":\"%s\",", value);
+        }
+        // The policy state the decision started from and its exact inputs:
+        // the device adopts the state and re-runs the policy, so its
+        // hysteresis and rate limit follow every decision, not only the
+        // published ones
+        char lastRate[32] = "null";
+        if (before.hasLastRate) {
+            snprintf(lastRate, sizeof(lastRate), "%.17g", before.lastPacingRate);
+        }
+        char payload[1024];
+        const int len = snprintf(
+            payload, sizeof(payload),
+            "{\"device_id\":\"%s\",%s%s"
+            "\"pacing_command\":{\"pacing_enabled\":%s,\"target_rate_bpm\":%.1f,\"pacing_amplitude_ma\":%.2f,"
+            "\"pacing_mode\":\"%s\",\"safety_state\":\"%s\"},"
+            "\"shaped_command\":{\"pacing_enabled\":%s,\"target_rate_bpm\":%.1f,\"publish\":true},"
+            "\"input_summary\":{\"device_id\":\"%s\",\"rhythm_class\":\"%s\",\"rhythm_confidence\":%.17g,"
+            "\"hsi_score\":%.17g,\"hsi_trend\":\"%s\",\"heart_rate_bpm\":%.17g},"
+            "\"policy_state\":{\"current_state\":\"%s\",\"consecutive_degraded_cycles\":%" PRIu32
+            ",\"consecutive_safe_cycles\":%" PRIu32 ",\"last_pacing_rate\":%s}}",
+            deviceId.c_str(), frameTs, traceparent, cmd.pacingEnabled ? "true" : "false", cmd.targetRateBpm,
+            cmd.amplitudeMa, pacingModeName(cmd.mode), safetyStateName(cmd.state),
+            shaped.pacingEnabled ? "true" : "false", shaped.rateBpm, deviceId.c_str(), bundle_.label(label).c_str(),
+            confidence, hsi, TREND_NAMES[static_cast<uint8_t>(trend)], heartRate,
+            safetyStateName(static_cast<SafetyState>(before.currentState)), before.consecutiveDegradedCycles,
+            before.consecutiveSafeCycles, lastRate);
+        if (len <= 0 || static_cast<size_t>(len) >= sizeof(payload)) {
+            return;
+        }
+        outbox_.push(COMMAND_TOPIC_PREFIX + deviceId, std::string(payload, static_cast<size_t>(len)), commandTrace,
+                     timing ? timing->windowSpan : 0);
+        stats.commands.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Spans of a traced window, under the device's root span: time in the
+     * inbox, then the window with its pipeline and policy stages.
+     */
+    void recordWindow(const std::string& deviceId, const WindowTrace& t, int64_t receivedUs, int64_t startUs) {
+        const int64_t endUs = trace::wallUs();
+        const uint8_t* traceId = t.frame.traceId;
+        const uint64_t root = t.frame.spanId;
+        const uint8_t outcome = t.analyzed ? trace::SPAN_STATUS_OK : trace::SPAN_STATUS_ERROR;
+        attrs_.assign("device.id=").append(deviceId);
+        if (receivedUs > 0 && startUs >= receivedUs) {
+            span(traceId, trace::randomId(), root, receivedUs, startUs - receivedUs, trace::SPAN_KIND_INTERNAL,
+                 trace::SPAN_STATUS_UNSET, "ingest.queue");
+        }
+        span(traceId, t.windowSpan, root, startUs, endUs - startUs, trace::SPAN_KIND_CONSUMER, outcome,
+             "ingest.window");
+        if (t.analyzed) {
+            char rate[40];
+            snprintf(rate, sizeof(rate), "\nheart_rate_bpm=%.1f", t.heartRateBpm);
+            attrs_.append(rate);
+        }
+        span(traceId, trace::randomId(), t.windowSpan, t.pipelineStartUs, t.pipelineEndUs - t.pipelineStartUs,
+             trace::SPAN_KIND_INTERNAL, outcome, "pipeline.analyze");
+        if (t.analyzed) {
+            attrs_.assign("safety.state=").append(t.safetyState);
+            attrs_.append("\npacing.mode=").append(t.pacingMode);
+            attrs_.append(t.published ? "\ncommand.published=true" : "\ncommand.published=false");
+            span(traceId, trace::randomId(), t.windowSpan, t.pipelineEndUs, t.policyEndUs - t.pipelineEndUs,
+                 trace::SPAN_KIND_INTERNAL, trace::SPAN_STATUS_OK, "policy.decide");
+        }
+    }
+
+    void span(const uint8_t* traceId, uint64_t id, uint64_t parent, int64_t startUs, int64_t durationUs,
+              uint8_t kind, uint8_t status, const char* name) {
+        spans_->record(traceId, id, parent, startUs, durationUs, kind, status, TRACE_SERVICE, strlen(TRACE_SERVICE),
+                       name, strlen(name), attrs_.data(), attrs_.size());
+    }
+
+    void sweep(uint64_t now) {
+        for (auto it = devices_.begin(); it != devices_.end();) {
+            if (now - it->second->lastSeenMs >= DEVICE_IDLE_TIMEOUT_MS) {
+                it = devices_.erase(it);
+                stats.devices.fetch_sub(1, std::memory_order_relaxed);
+            } else {
+                ++it;
+            }
+        }
+        if (store_) {
+            flushStore();
+        }
+    }
+
+    void flushStore() {
+        const uint64_t lost = store_->stats().droppedBlocks;
+        if (store_->flush() != tsdb::Status::Ok) {
+            stats.storeErrors.fetch_add(store_->stats().droppedBlocks - lost, std::memory_order_relaxed);
+        }
+    }
+
+    const IngestBundle& bundle_;
+    Outbox& outbox_;
+    std::unique_ptr<tsdb::TimeSeriesWriter> store_;  // Null without --store
+    trace::SpanRing* spans_;                         // Null without --trace-file
+
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    FrameBatch inbox_;
+    bool busy_ = false;
+    bool stopping_ = false;
+
+    std::unordered_map<std::string, std::unique_ptr<DeviceState>> devices_;
+    std::string key_;
+    std::vector<double> samples_;
+    std::vector<int64_t> sampleTimes_;
+    int64_t newestSampleUs_ = 0;
+    std::vector<double> window_;
+    PipelineWorkspace workspace_;
+    std::string attrs_;
+};
+
+/**
+ * Shards frames across workers by device id. Used from one thread (the
+ * network thread, or the bench producer); frames are staged per worker and
+ * handed over in batches by flush().
+ */
+class Router {
+public:
+    /**
+     * stores holds one writer per worker, or is empty when samples are not
+     * kept; spans is null when windows are not traced.
+     */
+    Router(const IngestBundle& bundle, Outbox& outbox, unsigned workers,
+           std::vector<std::unique_ptr<tsdb::TimeSeriesWriter>> stores, trace::SpanRing* spans)
+        : staged_(workers) {
+        for (unsigned i = 0; i < workers; i++) {
+            workers_.push_back(std::make_unique<Worker>(
+                bundle, outbox, i < stores.size() ? std::move(stores[i]) : nullptr, spans));
+        }
+        for (auto& w : workers_) {
+            threads_.emplace_back([&w] { w->run(); });
+        }
+    }
+
+    ~Router() {
+        for (auto& w : workers_) {
+            w->stop();
+        }
+        for (auto& t : threads_) {
+            t.join();
+        }
+    }
+
+    /**
+     * Stage one frame; receivedUs is the wall time it was read (0: unknown).
+     */
+    void route(const uint8_t* payload, size_t n, int64_t receivedUs) {
+        staged_[fnv1a(peekDeviceId(payload, n)) % staged_.size()].add(payload, n, receivedUs);
+    }
+
+    /**
+     * Hand staged frames to the workers. A full inbox drops the frames (the
+     * network thread must never block), unless wait is set (bench producer).
+     */
+    void flush(bool wait = false) {
+        for (size_t i = 0; i < staged_.size(); i++) {
+            if (staged_[i].empty()) {
+                continue;
+            }
+            while (!workers_[i]->submit(staged_[i])) {
+                if (!wait) {
+                    dropped_ += staged_[i].ends.size();
+                    staged_[i].clear();
+                    break;
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+    }
+
+    bool idle() {
+        for (auto& w : workers_) {
+            if (!w->idle()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    struct Totals {
+        uint64_t frames, samples, rejected, windows, analysisFailed, commands, devices, dropped, storeErrors;
+    };
+
+    Totals totals() const {
+        Totals t = {0, 0, 0, 0, 0, 0, 0, dropped_, 0};
+        for (const auto& w : workers_) {
+            t.frames += w->stats.frames.load(std::memory_order_relaxed);
+            t.samples += w->stats.samples.load(std::memory_order_relaxed);
+            t.rejected += w->stats.rejected.load(std::memory_order_relaxed);
+            t.windows += w->stats.windows.load(std::memory_order_relaxed);
+            t.analysisFailed += w->stats.analysisFailed.load(std::memory_order_relaxed);
+            t.commands += w->stats.commands.load(std::memory_order_relaxed);
+            t.devices += w->stats.devices.load(std::memory_order_relaxed);
+            t.storeErrors += w->stats.storeErrors.load(std::memory_order_relaxed);
+        }
+        return t;
+    }
+
+private:
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::vector<FrameBatch> staged_;
+    uint64_t dropped_ = 0;  // Frames dropped because a worker's inbox was full
+};
+
+// ==========================================
+// Metrics
+// ==========================================
+
+/**
+ * The worker's metrics in the exposition format the services serve at
+ * /metrics (Metrics.h): the router's totals, the sample-to-actuation latency
+ * of device trace reports and the series of device status frames, labelled
+ * by device id. Device _total series are counters, the rest gauges. Used
+ * from the network thread only.
+ */
+class Metrics {
+public:
+    Metrics() : registry_(metrics::DEFAULT_METRIC_CELLS) {
+        for (size_t i = 0; i < TOTALS; i++) {
+            totals_[i] = registry_.add(metrics::MetricType::Counter, TOTAL_NAMES[i].first, TOTAL_NAMES[i].second, "");
+        }
+        devices_ = registry_.add(metrics::MetricType::Gauge, "pulsemind_ingest_devices", "Devices with a stream", "");
+        statusFrames_ = registry_.add(metrics::MetricType::Counter, "pulsemind_ingest_status_frames_total",
+                                      "Device status frames read", "");
+        statusRejected_ = registry_.add(metrics::MetricType::Counter, "pulsemind_ingest_status_rejected_total",
+                                        "Undecodable device status frames", "");
+        sampleToActuation_ = registry_.add(metrics::MetricType::Histogram, "pulsemind_loop_sample_to_actuation_seconds",
+                                           "Device sample to LED actuation, from device trace reports", "");
+    }
+
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    /**
+     * Write to path at every write() (replaced atomically, so a reader
+     * never sees a partial file).
+     */
+    void open(const std::string& path) {
+        path_ = path;
+        fprintf(stderr, "ingest_worker: writing metrics to %s\n", path.c_str());
+    }
+
+    void observeSampleToActuation(uint64_t us) { registry_.histogramRecord(sampleToActuation_, us); }
+
+    /**
+     * A device status frame (STATUS_TOPIC). Series a device reports are
+     * registered on first sight; ones the registry refuses (bad names, no
+     * cells left) are skipped and show in its rejected count.
+     */
+    void onStatus(const uint8_t* payload, size_t n) {
+        DeviceStatus st;
+        if (decodeDeviceStatus(payload, n, st) != FrameStatus::Ok) {
+            registry_.counterAdd(statusRejected_, 1);
+            return;
+        }
+        registry_.counterAdd(statusFrames_, 1);
+        for (size_t i = 0; i < st.metricCount; i++) {
+            const std::string_view name = st.metrics[i].first;
+            const double value = st.metrics[i].second;
+            const bool counter = name.size() > 6 && name.substr(name.size() - 6) == "_total";
+            key_.assign(st.deviceId.data(), st.deviceId.size()).append(1, '\0').append(name.data(), name.size());
+            auto it = handles_.find(key_);
+            if (it == handles_.end()) {
+                labels_.assign("device_id=\"").append(st.deviceId.data(), st.deviceId.size()).append("\"");
+                const int32_t handle =
+                    registry_.add(counter ? metrics::MetricType::Counter : metrics::MetricType::Gauge, name,
+                                  "Reported by the device (status frame)", labels_);
+                if (handle < 0) {
+                    continue;
+                }
+                it = handles_.emplace(key_, handle).first;
+            }
+            if (!counter) {
+                registry_.gaugeSet(it->second, value);
+            } else if (value >= 0.0 && value < 1.8e19 && value == std::floor(value)) {
+                registry_.counterStore(it->second, static_cast<uint64_t>(value));
+            }
+        }
+    }
+
+    /**
+     * Refresh the totals and write the file (nothing without open()).
+     */
+    void write(const Router::Totals& t) {
+        if (path_.empty()) {
+            return;
+        }
+        const uint64_t values[TOTALS] = {t.frames, t.samples, t.rejected, t.dropped, t.windows,
+                                         t.analysisFailed, t.commands, t.storeErrors};
+        for (size_t i = 0; i < TOTALS; i++) {
+            registry_.counterStore(totals_[i], values[i]);
+        }
+        registry_.gaugeSet(devices_, static_cast<double>(t.devices));
+        text_.clear();
+        registry_.render(text_);
+
+        const std::string tmp = path_ + ".tmp";
+        const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        bool ok = fd >= 0;
+        for (size_t off = 0; ok && off < text_.size();) {
+            const ssize_t w = ::write(fd, text_.data() + off, text_.size() - off);
+            if (w < 0 && errno == EINTR) {
+                continue;
+            }
+            ok = w > 0;
+            off += ok ? static_cast<size_t>(w) : 0;
+        }
+        if (fd >= 0 && close(fd) != 0) {
+            ok = false;
+        }
+        if (!ok || rename(tmp.c_str(), path_.c_str()) != 0) {
+            fprintf(stderr, "ingest_worker: metrics file %s: %s\n", path_.c_str(), strerror(errno));
+        }
+    }
+
+private:
+    static constexpr size_t TOTALS = 8;
+    static constexpr std::pair<const char*, const char*> TOTAL_NAMES[TOTALS] = {
+        {"pulsemind_ingest_frames_total", "Sensor frames decoded"},
+        {"pulsemind_ingest_samples_total", "Samples in decoded frames"},
+        {"pulsemind_ingest_rejected_total", "Undecodable sensor frames"},
+        {"pulsemind_ingest_dropped_total", "Sensor frames dropped on a full worker inbox"},
+        {"pulsemind_ingest_windows_total", "Windows analyzed"},
+        {"pulsemind_ingest_analysis_failed_total", "Windows the pipeline could not analyze"},
+        {"pulsemind_ingest_commands_total", "Pacing commands produced"},
+        {"pulsemind_ingest_store_errors_total", "Time-series store write errors"},
+    };
+
+    metrics::Registry registry_;
+    int32_t totals_[TOTALS];
+    int32_t devices_;
+    int32_t statusFrames_;
+    int32_t statusRejected_;
+    int32_t sampleToActuation_;
+    std::unordered_map<std::string, int32_t> handles_;  // device id, NUL, metric name
+    std::string key_;
+    std::string labels_;
+    std::string text_;
+    std::string path_;
+};
+
+// ==========================================
+// Tracing
+// ==========================================
+
+/**
+ * The network thread's side of tracing: the span ring the workers record
+ * into and its exporter (with --trace-file), the dispatch span of each
+ * traced command, and the device reports that close the loop.
+ */
+class Tracing {
+public:
+    explicit Tracing(Metrics& metrics) : metrics_(metrics) {}
+    Tracing(const Tracing&) = delete;
+    Tracing& operator=(const Tracing&) = delete;
+
+    ~Tracing() {
+        exporter_.reset();  // Writes what is left in the ring
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    /**
+     * Export spans to path (appended); false if it cannot be opened.
+     */
+    bool open(const std::string& path) {
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            fprintf(stderr, "ingest_worker: trace file %s: %s\n", path.c_str(), strerror(errno));
+            return false;
+        }
+        ring_ = std::make_unique<trace::SpanRing>(trace::DEFAULT_SPAN_CAPACITY);
+        exporter_ = std::make_unique<trace::TraceExporter>(*ring_, fd_);
+        fprintf(stderr, "ingest_worker: tracing to %s\n", path.c_str());
+        return true;
+    }
+
+    /**
+     * The ring workers record into, null when spans are not exported.
+     */
+    trace::SpanRing* spans() { return ring_.get(); }
+
+    /**
+     * Wall time for frames read now, 0 when spans are not exported.
+     */
+    int64_t receivedUs() const { return ring_ ? trace::wallUs() : 0; }
+
+    /**
+     * Span of a traced command from its worker to a connection's outbound
+     * queue (an error when no connection took it).
+     */
+    void onDispatch(const Command& command, bool sent) {
+        if (!ring_ || !command.trace.valid()) {
+            return;
+        }
+        attrs_.assign("messaging.destination=").append(command.topic);
+        span(command.trace.traceId, command.trace.spanId, command.traceParent, command.producedWallUs,
+             trace::wallUs() - command.producedWallUs, trace::SPAN_KIND_PRODUCER,
+             sent ? trace::SPAN_STATUS_OK : trace::SPAN_STATUS_ERROR, TRACE_SERVICE, "command.dispatch");
+    }
+
+    /**
+     * A device's report for a traced command (TRACE_TOPIC), read at
+     * receivedWallUs. Device times are placed on the wall clock by their
+     * distance from the report's now_ms, so the device spans carry the
+     * report's transport delay as an offset, never as a stretch.
+     */
+    void onReport(const uint8_t* payload, size_t n, int64_t receivedWallUs) {
+        TraceReport r;
+        if (decodeTraceReport(payload, n, r) != FrameStatus::Ok) {
+            rejected_++;
+            return;
+        }
+        reports_++;
+        const uint64_t loopUs = static_cast<uint64_t>(static_cast<uint32_t>(r.actuationMs - r.sampleMs)) * 1000;
+        sampleToActuation_.record(loopUs);
+        metrics_.observeSampleToActuation(loopUs);
+        if (!ring_) {
+            return;
+        }
+        auto wallAt = [&](uint32_t t) {
+            return receivedWallUs - static_cast<int64_t>(static_cast<uint32_t>(r.nowMs - t)) * 1000;
+        };
+        auto lengthUs = [](uint32_t from, uint32_t to) {
+            return static_cast<int64_t>(static_cast<uint32_t>(to - from)) * 1000;
+        };
+        const uint8_t* traceId = r.command.traceId;
+        const uint64_t apply = trace::randomId();
+        attrs_.assign("device.id=").append(r.deviceId.data(), r.deviceId.size());
+        // The firmware's root span id is the low half of its trace id
+        span(traceId, trace::loadBigEndian64(traceId + 8), 0, wallAt(r.sampleMs), lengthUs(r.sampleMs, r.actuationMs),
+             trace::SPAN_KIND_INTERNAL, trace::SPAN_STATUS_OK, DEVICE_TRACE_SERVICE, "device.sample_to_actuation");
+        span(traceId, apply, r.command.spanId, wallAt(r.commandRxMs), lengthUs(r.commandRxMs, r.appliedMs),
+             trace::SPAN_KIND_CONSUMER, trace::SPAN_STATUS_OK, DEVICE_TRACE_SERVICE, "device.command_apply");
+        span(traceId, trace::randomId(), apply, wallAt(r.appliedMs), lengthUs(r.appliedMs, r.actuationMs),
+             trace::SPAN_KIND_INTERNAL, trace::SPAN_STATUS_OK, DEVICE_TRACE_SERVICE, "device.pulse_wait");
+    }
+
+    /**
+     * Sample-to-actuation latency from device reports (bucket upper bounds)
+     * and span counts.
+     */
+    void print() const {
+        const trace::TraceStats st = ring_ ? ring_->stats() : trace::TraceStats{};
+        fprintf(stderr,
+                "ingest_worker: sample_to_actuation_us n=%" PRIu64 " p50<%" PRIu64 " p99<%" PRIu64 " max=%" PRIu64
+                " reports=%" PRIu64 " rejected=%" PRIu64 " spans=%" PRIu64 " spans_dropped=%" PRIu64 "\n",
+                sampleToActuation_.count(), sampleToActuation_.quantile(0.50), sampleToActuation_.quantile(0.99),
+                sampleToActuation_.max(), reports_, rejected_, st.recorded, st.dropped);
+    }
+
+private:
+    void span(const uint8_t* traceId, uint64_t id, uint64_t parent, int64_t startUs, int64_t durationUs,
+              uint8_t kind, uint8_t status, const char* service, const char* name) {
+        ring_->record(traceId, id, parent, startUs, durationUs, kind, status, service, strlen(service), name,
+                      strlen(name), attrs_.data(), attrs_.size());
+    }
+
+    Metrics& metrics_;
+    int fd_ = -1;
+    std::unique_ptr<trace::SpanRing> ring_;
+    std::unique_ptr<trace::TraceExporter> exporter_;
+    LatencyHistogram sampleToActuation_;
+    uint64_t reports_ = 0;
+    uint64_t rejected_ = 0;  // Undecodable reports
+    std::string attrs_;
+};
+
+// ==========================================
+// Broker Connections
+// ==========================================
+class BrokerLink {
+public:
+    enum class State { Idle, Connecting, AwaitConnack, Ready };
+
+    BrokerLink(const Config& config, unsigned index, int epollFd, LatencyHistogram& latency, Tracing& tracing,
+               Metrics& metrics)
+        : config_(config),
+          epollFd_(epollFd),
+          latency_(latency),
+          tracing_(tracing),
+          metrics_(metrics),
+          reader_(MAX_PACKET_SIZE),
+          out_(OUTBUF_MAX_BYTES, OUTBUF_MAX_BYTES, WIRE_CHUNK_BYTES) {
+        clientId_ = config.clientId + "-" + std::to_string(index);
+    }
+
+    ~BrokerLink() { closeSocket(); }
+
+    State state() const { return state_; }
+    int fd() const { return fd_; }
+
+    /**
+     * Start a non-blocking connect if the link is down and its backoff has
+     * elapsed.
+     */
+    void maybeConnect(uint64_t now) {
+        if (state_ != State::Idle || now < reconnectAtMs_) {
+            return;
+        }
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addrs = nullptr;
+        const std::string port = std::to_string(config_.port);
+        if (getaddrinfo(config_.host.c_str(), port.c_str(), &hints, &addrs) != 0 || addrs == nullptr) {
+            fprintf(stderr, "ingest_worker: cannot resolve %s\n", config_.host.c_str());
+            scheduleReconnect(now);
+            return;
+        }
+        fd_ = socket(addrs->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd_ < 0) {
+            freeaddrinfo(addrs);
+            scheduleReconnect(now);
+            return;
+        }
+        const int one = 1;
+        setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        const int rc = connect(fd_, addrs->ai_addr, addrs->ai_addrlen);
+        freeaddrinfo(addrs);
+        if (rc < 0 && errno != EINPROGRESS) {
+            closeSocket();
+            scheduleReconnect(now);
+            return;
+        }
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLOUT;
+        ev.data.ptr = this;
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd_, &ev);
+        state_ = State::Connecting;
+        lastRecvMs_ = lastSendMs_ = now;
+    }
+
+    void onEvent(uint32_t events, Router& router, uint64_t now) {
+        if (events & (EPOLLERR | EPOLLHUP)) {
+            fail(now, "connection lost");
+            return;
+        }
+        if (state_ == State::Connecting && (events & EPOLLOUT)) {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(fd_, SOL_SOCKET, SO_ERROR, &err, &len);
+            if (err != 0) {
+                fail(now, strerror(err));
+                return;
+            }
+            mqtt::encodeConnect(control(), clientId_, static_cast<uint16_t>(config_.keepaliveSec));
+            state_ = State::AwaitConnack;
+        }
+        if (events & EPOLLIN) {
+            if (!readPackets(router, now)) {
+                return;
+            }
+        }
+        flushOut(now);
+    }
+
+    /**
+     * Queue a command as a QoS 0 publish in the priority lane (dropped when
+     * the link is down or backed up).
+     */
+    bool publish(const Command& command, uint64_t now) {
+        if (state_ != State::Ready) {
+            return false;
+        }
+        encoded_.clear();
+        mqtt::encodePublish(encoded_, command.topic.data(), command.topic.size(), command.payload.data(),
+                            command.payload.size());
+        if (!out_.push(OutboundLanes::Lane::Priority, encoded_.data(), encoded_.size(), command.producedUs)) {
+            return false;
+        }
+        flushOut(now);
+        return true;
+    }
+
+    void tick(uint64_t now) {
+        if (state_ == State::Idle) {
+            return;
+        }
+        const uint64_t keepaliveMs = config_.keepaliveSec * 1000ull;
+        if (now - lastRecvMs_ > keepaliveMs + keepaliveMs / 2) {
+            fail(now, "keepalive timeout");
+            return;
+        }
+        if (state_ == State::Ready && now - lastSendMs_ >= keepaliveMs / 2) {
+            mqtt::encodePingreq(control());
+            flushOut(now);
+        }
+    }
+
+    void disconnect() {
+        if (state_ == State::Ready) {
+            mqtt::encodeDisconnect(control());
+            flushOut(nowMs());
+        }
+        closeSocket();
+    }
+
+private:
+    /**
+     * One read per event: epoll is level-triggered, and the daemon loop
+     * drains worker commands between reads, so a telemetry backlog on the
+     * socket does not hold commands back.
+     */
+    bool readPackets(Router& router, uint64_t now) {
+        uint8_t* tail = reader_.writableTail(64 * 1024);
+        const ssize_t n = recv(fd_, tail, 64 * 1024, 0);
+        if (n == 0) {
+            fail(now, "closed by broker");
+            return false;
+        }
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                return true;
+            }
+            fail(now, strerror(errno));
+            return false;
+        }
+        reader_.commit(static_cast<size_t>(n));
+        lastRecvMs_ = now;
+        const int64_t receivedUs = tracing_.receivedUs();
+
+        mqtt::Packet packet;
+        mqtt::MqttReader::Result result;
+        while ((result = reader_.next(packet)) == mqtt::MqttReader::Result::Packet) {
+            if (!handle(packet, router, now, receivedUs)) {
+                return false;
+            }
+        }
+        if (result == mqtt::MqttReader::Result::Malformed) {
+            fail(now, "malformed packet");
+            return false;
+        }
+        return true;
+    }
+
+    bool handle(const mqtt::Packet& packet, Router& router, uint64_t now, int64_t receivedUs) {
+        switch (packet.type) {
+            case mqtt::PUBLISH: {
+                mqtt::Publish pub = {};
+                if (!mqtt::parsePublish(packet, pub)) {
+                    fail(now, "malformed publish");
+                    return false;
+                }
+                if (pub.qos == 1) {
+                    // Telemetry acknowledgements never hold up commands
+                    mqtt::encodePuback(out_.lane(OutboundLanes::Lane::Bulk), pub.packetId);
+                }
+                const std::string_view topic(pub.topic, pub.topicLen);
+                if (topic == TRACE_TOPIC) {
+                    tracing_.onReport(pub.payload, pub.payloadLen, trace::wallUs());
+                } else if (topic == STATUS_TOPIC) {
+                    metrics_.onStatus(pub.payload, pub.payloadLen);
+                } else {
+                    router.route(pub.payload, pub.payloadLen, receivedUs);
+                }
+                return true;
+            }
+            case mqtt::CONNACK:
+                if (packet.length < 2 || packet.body[1] != 0) {
+                    fail(now, "connection refused");
+                    return false;
+                }
+                mqtt::encodeSubscribe(control(), SENSOR_SUBSCRIBE_ID, "$share/" + config_.group + "/" + SENSOR_TOPIC,
+                                      0);
+                mqtt::encodeSubscribe(control(), TRACE_SUBSCRIBE_ID, "$share/" + config_.group + "/" + TRACE_TOPIC, 0);
+                mqtt::encodeSubscribe(control(), STATUS_SUBSCRIBE_ID, "$share/" + config_.group + "/" + STATUS_TOPIC,
+                                      0);
+                return true;
+            case mqtt::SUBACK: {
+                const uint16_t id =
+                    packet.length >= 2 ? static_cast<uint16_t>((packet.body[0] << 8) | packet.body[1]) : 0;
+                if (id == TRACE_SUBSCRIBE_ID || id == STATUS_SUBSCRIBE_ID) {
+                    // Device reports and status are optional: the link serves frames without them
+                    if (packet.length < 3 || packet.body[2] == mqtt::SUBACK_FAILURE) {
+                        fprintf(stderr, "ingest_worker: %s: %s not subscribed\n", clientId_.c_str(),
+                                id == TRACE_SUBSCRIBE_ID ? "trace reports" : "device status");
+                    }
+                    return true;
+                }
+                if (packet.length < 3 || packet.body[2] == mqtt::SUBACK_FAILURE) {
+                    fail(now, "subscription refused");
+                    return false;
+                }
+                state_ = State::Ready;
+                backoffMs_ = RECONNECT_MIN_MS;
+                fprintf(stderr, "ingest_worker: %s subscribed to $share/%s/%s\n", clientId_.c_str(),
+                        config_.group.c_str(), SENSOR_TOPIC);
+                return true;
+            }
+            default:
+                return true;  // PINGRESP, PUBACK
+        }
+    }
+
+    void flushOut(uint64_t now) {
+        while (fd_ >= 0 && state_ != State::Connecting && out_.pending()) {
+            const auto chunk = out_.next();
+            const ssize_t n = send(fd_, chunk.first, chunk.second, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    fail(now, strerror(errno));
+                    return;
+                }
+                break;
+            }
+            out_.consume(static_cast<size_t>(n), nowUs(), latency_);
+            lastSendMs_ = now;
+        }
+        if (fd_ >= 0) {
+            epoll_event ev = {};
+            ev.events = EPOLLIN | ((state_ == State::Connecting || out_.pending()) ? EPOLLOUT : 0u);
+            ev.data.ptr = this;
+            epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd_, &ev);
+        }
+    }
+
+    void fail(uint64_t now, const char* reason) {
+        fprintf(stderr, "ingest_worker: %s: %s, reconnecting\n", clientId_.c_str(), reason);
+        closeSocket();
+        scheduleReconnect(now);
+    }
+
+    void scheduleReconnect(uint64_t now) {
+        state_ = State::Idle;
+        reconnectAtMs_ = now + backoffMs_;
+        backoffMs_ = std::min(backoffMs_ * 2, RECONNECT_MAX_MS);
+    }
+
+    void closeSocket() {
+        if (fd_ >= 0) {
+            epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd_, nullptr);
+            close(fd_);
+            fd_ = -1;
+        }
+        state_ = State::Idle;
+        reader_.reset();
+        out_.clear();
+    }
+
+    std::vector<uint8_t>& control() { return out_.lane(OutboundLanes::Lane::Priority); }
+
+    static constexpr uint16_t SENSOR_SUBSCRIBE_ID = 1;
+    static constexpr uint16_t TRACE_SUBSCRIBE_ID = 2;
+    static constexpr uint16_t STATUS_SUBSCRIBE_ID = 3;
+
+    const Config& config_;
+    int epollFd_;
+    LatencyHistogram& latency_;
+    Tracing& tracing_;
+    Metrics& metrics_;
+    std::string clientId_;
+    int fd_ = -1;
+    State state_ = State::Idle;
+    mqtt::MqttReader reader_;
+    OutboundLanes out_;
+    std::vector<uint8_t> encoded_;
+    uint64_t lastRecvMs_ = 0;
+    uint64_t lastSendMs_ = 0;
+    uint64_t reconnectAtMs_ = 0;
+    uint64_t backoffMs_ = RECONNECT_MIN_MS;
+};
+
+// ==========================================
+// Embedded Broker
+// ==========================================
+
+/**
+ * Topic classes the embedded broker keeps metrics for. Commands travel in
+ * the priority lane; sensor frames and anything else in the bulk lane.
+ */
+enum class TopicClass : uint8_t { Sensor, Command, Other };
+constexpr size_t TOPIC_CLASS_COUNT = 3;
+const char* const TOPIC_CLASS_NAMES[TOPIC_CLASS_COUNT] = {"sensor", "command", "other"};
+
+TopicClass classifyTopic(std::string_view topic) {
+    if (topic == SENSOR_TOPIC) {
+        return TopicClass::Sensor;
+    }
+    const std::string_view command(COMMAND_TOPIC);
+    if (topic.substr(0, command.size()) == command && (topic.size() == command.size() || topic[command.size()] == '/')) {
+        return TopicClass::Command;
+    }
+    return TopicClass::Other;
+}
+
+struct TopicStats {
+    uint64_t messagesIn = 0;
+    uint64_t bytesIn = 0;
+    uint64_t deliveries = 0;   // Messages queued to subscribers
+    uint64_t bytesOut = 0;
+    uint64_t dropped = 0;      // Deliveries dropped on a backed-up client
+};
+
+/**
+ * One client connection. Pacing commands and protocol replies go out in
+ * the priority lane; sensor fan-out, other topics and telemetry
+ * acknowledgements in the bulk lane.
+ */
+struct BrokerSession {
+    explicit BrokerSession(int socketFd)
+        : fd(socketFd),
+          reader(MAX_PACKET_SIZE),
+          out(SESSION_PRIORITY_MAX_BYTES, SESSION_BULK_MAX_BYTES, WIRE_CHUNK_BYTES) {}
+
+    int fd;
+    bool connected = false;      // CONNECT accepted
+    bool closing = false;
+    bool dirty = false;          // Queued for flush this iteration
+    bool wantWrite = false;      // EPOLLOUT registered
+    std::string clientId;
+    uint64_t keepaliveMs = 0;    // 0: no keepalive
+    uint64_t lastRecvMs = 0;
+    uint64_t deliveredSeq = 0;   // Last publish delivered (one copy per overlapping filters)
+    mqtt::MqttReader reader;
+    std::vector<std::string> filters;
+    OutboundLanes out;
+
+    std::vector<uint8_t>& control() { return out.lane(OutboundLanes::Lane::Priority); }
+};
+
+/**
+ * MQTT 3.1.1 broker for the PulseMind topic set, in-process with the
+ * workers (--listen). Devices connect here directly: their sensor frames go
+ * straight to the router without a second network hop, and commands from
+ * the workers are queued in each subscriber's priority lane.
+ *
+ * Any topic can be published and subscribed (+ and # filters), so the
+ * dashboard and other services keep working against it. Deliberately out
+ * of scope, as PulseMind traffic is QoS 0 and recomputed every second:
+ * QoS 1/2 delivery (subscriptions are granted QoS 0; QoS 1 publishes are
+ * acknowledged, QoS 2 clients are disconnected), retained messages, wills,
+ * persistent sessions, shared subscriptions and authentication.
+ */
+class EmbeddedBroker {
+public:
+    EmbeddedBroker(const Config& config, int epollFd, Tracing& tracing, Metrics& metrics)
+        : config_(config), epollFd_(epollFd), tracing_(tracing), metrics_(metrics) {}
+
+    ~EmbeddedBroker() {
+        for (auto& entry : sessions_) {
+            close(entry.first);
+        }
+        if (listenFd_ >= 0) {
+            close(listenFd_);
+        }
+    }
+
+    /**
+     * Bind and register the listener; returns the bound port or -1.
+     */
+    int listen() {
+        listenFd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd_ < 0) {
+            perror("ingest_worker: socket");
+            return -1;
+        }
+        const int one = 1;
+        setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(static_cast<uint16_t>(config_.listenPort));
+        socklen_t len = sizeof(addr);
+        if (bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(listenFd_, 1024) < 0 ||
+            getsockname(listenFd_, reinterpret_cast<sockaddr*>(&addr), &len) < 0) {
+            perror("ingest_worker: listen");
+            return -1;
+        }
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.ptr = this;
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, listenFd_, &ev);
+        return ntohs(addr.sin_port);
+    }
+
+    size_t clients() const { return sessions_.size(); }
+    const TopicStats& stats(TopicClass c) const { return stats_[static_cast<size_t>(c)]; }
+
+    void onAccept(uint64_t now) {
+        for (;;) {
+            const int fd = accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    perror("ingest_worker: accept");
+                }
+                return;
+            }
+            const int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            auto session = std::make_unique<BrokerSession>(fd);
+            session->lastRecvMs = now;
+            epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.ptr = session.get();
+            epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev);
+            sessions_.emplace(fd, std::move(session));
+        }
+    }
+
+    void onEvent(BrokerSession& s, uint32_t events, Router& router, uint64_t now) {
+        if (s.closing) {
+            return;
+        }
+        if (events & (EPOLLERR | EPOLLHUP)) {
+            drop(s);
+            return;
+        }
+        if (events & EPOLLIN) {
+            // One read per event: level-triggered epoll comes back for the
+            // rest, so a chatty client cannot starve the others
+            uint8_t* tail = s.reader.writableTail(64 * 1024);
+            const ssize_t n = recv(s.fd, tail, 64 * 1024, 0);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                drop(s);
+                return;
+            }
+            if (n > 0) {
+                s.reader.commit(static_cast<size_t>(n));
+                s.lastRecvMs = now;
+                const int64_t receivedUs = tracing_.receivedUs();
+                mqtt::Packet packet;
+                mqtt::MqttReader::Result result;
+                while (!s.closing && (result = s.reader.next(packet)) == mqtt::MqttReader::Result::Packet) {
+                    handle(s, packet, router, receivedUs);
+                }
+                if (!s.closing && result == mqtt::MqttReader::Result::Malformed) {
+                    drop(s);
+                    return;
+                }
+            }
+        }
+        if (events & EPOLLOUT) {
+            markDirty(s);
+        }
+    }
+
+    /**
+     * Deliver a worker command to its subscribers (priority lane); false if
+     * none took it.
+     */
+    bool publish(const Command& command) {
+        return deliver(TopicClass::Command, command.topic.data(), command.topic.size(),
+                       reinterpret_cast<const uint8_t*>(command.payload.data()), command.payload.size(),
+                       command.producedUs) > 0;
+    }
+
+    const LatencyHistogram& latency() const { return latency_; }
+
+    /**
+     * Write queued packets of every session touched since the last call,
+     * then release closed sessions.
+     */
+    void flush() {
+        for (BrokerSession* s : dirty_) {
+            s->dirty = false;
+            if (!s->closing) {
+                flushSession(*s);
+            }
+        }
+        dirty_.clear();
+        for (BrokerSession* s : closed_) {
+            release(*s);
+        }
+        closed_.clear();
+    }
+
+    /**
+     * Disconnect clients that missed their keepalive (or never sent CONNECT).
+     */
+    void expire(uint64_t now) {
+        for (auto& entry : sessions_) {
+            BrokerSession& s = *entry.second;
+            const uint64_t limit = s.connected ? s.keepaliveMs + s.keepaliveMs / 2 : CONNECT_TIMEOUT_MS;
+            if (!s.closing && limit > 0 && now - s.lastRecvMs > limit) {
+                drop(s);
+            }
+        }
+    }
+
+private:
+    void handle(BrokerSession& s, const mqtt::Packet& packet, Router& router, int64_t receivedUs) {
+        if (!s.connected && packet.type != mqtt::CONNECT) {
+            drop(s);
+            return;
+        }
+        switch (packet.type) {
+            case mqtt::CONNECT:
+                onConnect(s, packet);
+                return;
+            case mqtt::PUBLISH: {
+                mqtt::Publish pub = {};
+                if (!mqtt::parsePublish(packet, pub) || pub.qos == 2 || !mqtt::isValidTopicName(pub.topic, pub.topicLen)) {
+                    drop(s);
+                    return;
+                }
+                const TopicClass cls = classifyTopic(std::string_view(pub.topic, pub.topicLen));
+                if (pub.qos == 1) {
+                    mqtt::encodePuback(s.out.lane(cls == TopicClass::Command ? OutboundLanes::Lane::Priority
+                                                                             : OutboundLanes::Lane::Bulk),
+                                       pub.packetId);
+                    markDirty(s);
+                }
+                TopicStats& st = stats_[static_cast<size_t>(cls)];
+                st.messagesIn++;
+                st.bytesIn += pub.payloadLen;
+                if (cls == TopicClass::Sensor) {
+                    router.route(pub.payload, pub.payloadLen, receivedUs);
+                } else if (std::string_view(pub.topic, pub.topicLen) == TRACE_TOPIC) {
+                    tracing_.onReport(pub.payload, pub.payloadLen, trace::wallUs());
+                } else if (std::string_view(pub.topic, pub.topicLen) == STATUS_TOPIC) {
+                    metrics_.onStatus(pub.payload, pub.payloadLen);
+                }
+                // Commands from other publishers are timed from their arrival
+                deliver(cls, pub.topic, pub.topicLen, pub.payload, pub.payloadLen,
+                        cls == TopicClass::Command ? nowUs() : 0);
+                return;
+            }
+            case mqtt::SUBSCRIBE: {
+                uint16_t packetId = 0;
+                codes_.clear();
+                const bool ok = mqtt::parseSubscribe(packet, packetId, [&](const char* f, size_t len, uint8_t) {
+                    const bool valid = mqtt::isValidTopicFilter(f, len) && !startsWith(f, len, "$share/");
+                    if (valid) {
+                        subscribe(s, std::string(f, len));
+                    }
+                    codes_.push_back(valid ? 0 : mqtt::SUBACK_FAILURE);
+                });
+                if (!ok) {
+                    drop(s);
+                    return;
+                }
+                mqtt::encodeSuback(s.control(), packetId, codes_.data(), codes_.size());
+                markDirty(s);
+                return;
+            }
+            case mqtt::UNSUBSCRIBE: {
+                uint16_t packetId = 0;
+                if (!mqtt::parseUnsubscribe(packet, packetId, [&](const char* f, size_t len, uint8_t) {
+                        unsubscribe(s, std::string(f, len));
+                    })) {
+                    drop(s);
+                    return;
+                }
+                mqtt::encodeUnsuback(s.control(), packetId);
+                markDirty(s);
+                return;
+            }
+            case mqtt::PINGREQ:
+                mqtt::encodePingresp(s.control());
+                markDirty(s);
+                return;
+            case mqtt::DISCONNECT:
+                drop(s);
+                return;
+            default:
+                return;  // PUBACK for QoS 1 sent by clients: nothing is outstanding
+        }
+    }
+
+    void onConnect(BrokerSession& s, const mqtt::Packet& packet) {
+        mqtt::Connect c = {};
+        if (s.connected || !mqtt::parseConnect(packet, c)) {
+            drop(s);
+            return;
+        }
+        uint8_t code = mqtt::CONNACK_ACCEPTED;
+        if (c.protocolLevel != mqtt::PROTOCOL_LEVEL_311 && c.protocolLevel != 3) {
+            code = mqtt::CONNACK_BAD_PROTOCOL;
+        } else if (c.clientIdLen == 0 && !(c.flags & mqtt::CONNECT_FLAG_CLEAN_SESSION)) {
+            code = mqtt::CONNACK_BAD_CLIENT_ID;
+        }
+        if (code != mqtt::CONNACK_ACCEPTED) {
+            // Best effort: the refusal is the last thing the client gets
+            std::vector<uint8_t> refusal;
+            mqtt::encodeConnack(refusal, code);
+            if (send(s.fd, refusal.data(), refusal.size(), MSG_NOSIGNAL) < 0) {
+                // Closing anyway
+            }
+            drop(s);
+            return;
+        }
+        mqtt::encodeConnack(s.control(), code);
+        markDirty(s);
+        s.clientId = c.clientIdLen > 0 ? std::string(c.clientId, c.clientIdLen)
+                                       : "auto-" + std::to_string(++autoClientIds_);
+        s.keepaliveMs = c.keepaliveSec * 1000ull;
+        s.connected = true;
+        // A reconnecting device takes over its previous session
+        auto it = clientIds_.find(s.clientId);
+        if (it != clientIds_.end()) {
+            drop(*it->second);
+        }
+        clientIds_[s.clientId] = &s;
+    }
+
+    static bool startsWith(const char* s, size_t len, const char* prefix) {
+        const size_t n = strlen(prefix);
+        return len >= n && memcmp(s, prefix, n) == 0;
+    }
+
+    static bool hasWildcard(const std::string& filter) {
+        return filter.find_first_of("+#") != std::string::npos;
+    }
+
+    void subscribe(BrokerSession& s, const std::string& filter) {
+        if (std::find(s.filters.begin(), s.filters.end(), filter) != s.filters.end()) {
+            return;
+        }
+        s.filters.push_back(filter);
+        if (hasWildcard(filter)) {
+            wildcard_.emplace_back(filter, &s);
+        } else {
+            exact_[filter].push_back(&s);
+        }
+    }
+
+    void unsubscribe(BrokerSession& s, const std::string& filter) {
+        auto it = std::find(s.filters.begin(), s.filters.end(), filter);
+        if (it == s.filters.end()) {
+            return;
+        }
+        s.filters.erase(it);
+        if (hasWildcard(filter)) {
+            wildcard_.erase(std::remove(wildcard_.begin(), wildcard_.end(), std::make_pair(filter, &s)),
+                            wildcard_.end());
+            return;
+        }
+        auto entry = exact_.find(filter);
+        std::vector<BrokerSession*>& subscribers = entry->second;
+        subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), &s), subscribers.end());
+        if (subscribers.empty()) {
+            exact_.erase(entry);
+        }
+    }
+
+    /**
+     * Queue a publish to every matching session; returns how many took it.
+     */
+    size_t deliver(TopicClass cls, const char* topic, size_t topicLen, const uint8_t* payload, size_t n,
+                   uint64_t producedUs) {
+        const uint64_t seq = ++publishSeq_;
+        size_t delivered = 0;
+        const OutboundLanes::Lane lane =
+            cls == TopicClass::Command ? OutboundLanes::Lane::Priority : OutboundLanes::Lane::Bulk;
+        TopicStats& st = stats_[static_cast<size_t>(cls)];
+        encoded_.clear();
+        auto send = [&](BrokerSession* s) {
+            if (s->closing || s->deliveredSeq == seq) {
+                return;
+            }
+            s->deliveredSeq = seq;
+            if (encoded_.empty()) {
+                mqtt::encodePublish(encoded_, topic, topicLen, reinterpret_cast<const char*>(payload), n);
+            }
+            if (!s->out.push(lane, encoded_.data(), encoded_.size(), producedUs)) {
+                st.dropped++;
+                return;
+            }
+            st.deliveries++;
+            st.bytesOut += n;
+            delivered++;
+            markDirty(*s);
+        };
+        key_.assign(topic, topicLen);
+        auto exact = exact_.find(key_);
+        if (exact != exact_.end()) {
+            for (BrokerSession* s : exact->second) {
+                send(s);
+            }
+        }
+        for (const auto& sub : wildcard_) {
+            if (mqtt::topicMatches(sub.first.data(), sub.first.size(), topic, topicLen)) {
+                send(sub.second);
+            }
+        }
+        return delivered;
+    }
+
+    void markDirty(BrokerSession& s) {
+        if (!s.dirty) {
+            s.dirty = true;
+            dirty_.push_back(&s);
+        }
+    }
+
+    void flushSession(BrokerSession& s) {
+        while (s.out.pending()) {
+            const auto chunk = s.out.next();
+            const ssize_t n = send(s.fd, chunk.first, chunk.second, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    drop(s);
+                    return;
+                }
+                break;
+            }
+            s.out.consume(static_cast<size_t>(n), nowUs(), latency_);
+        }
+        const bool pending = s.out.pending();
+        if (pending != s.wantWrite) {
+            s.wantWrite = pending;
+            epoll_event ev = {};
+            ev.events = EPOLLIN | (pending ? EPOLLOUT : 0u);
+            ev.data.ptr = &s;
+            epoll_ctl(epollFd_, EPOLL_CTL_MOD, s.fd, &ev);
+        }
+    }
+
+    /**
+     * Stop serving a session; it is released after this iteration's flush.
+     */
+    void drop(BrokerSession& s) {
+        if (s.closing) {
+            return;
+        }
+        s.closing = true;
+        s.out.clear();
+        closed_.push_back(&s);
+    }
+
+    void release(BrokerSession& s) {
+        while (!s.filters.empty()) {
+            const std::string filter = s.filters.back();  // unsubscribe erases it
+            unsubscribe(s, filter);
+        }
+        auto it = clientIds_.find(s.clientId);
+        if (it != clientIds_.end() && it->second == &s) {
+            clientIds_.erase(it);
+        }
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, s.fd, nullptr);
+        close(s.fd);
+        sessions_.erase(s.fd);  // Destroys s
+    }
+
+    const Config& config_;
+    int epollFd_;
+    Tracing& tracing_;
+    Metrics& metrics_;
+    int listenFd_ = -1;
+    std::unordered_map<int, std::unique_ptr<BrokerSession>> sessions_;
+    std::unordered_map<std::string, BrokerSession*> clientIds_;
+    std::unordered_map<std::string, std::vector<BrokerSession*>> exact_;
+    std::vector<std::pair<std::string, BrokerSession*>> wildcard_;
+    std::vector<BrokerSession*> dirty_;
+    std::vector<BrokerSession*> closed_;
+    TopicStats stats_[TOPIC_CLASS_COUNT];
+    LatencyHistogram latency_;
+    uint64_t publishSeq_ = 0;
+    uint64_t autoClientIds_ = 0;
+    std::string key_;
+    std::vector<uint8_t> encoded_;
+    std::vector<uint8_t> codes_;
+};
+
+void printStats(const char* prefix, const Router::Totals& t) {
+    fprintf(stderr,
+            "%s frames=%" PRIu64 " samples=%" PRIu64 " rejected=%" PRIu64 " dropped=%" PRIu64
+            " windows=%" PRIu64 " analysis_failed=%" PRIu64 " commands=%" PRIu64 " devices=%" PRIu64
+            " store_errors=%" PRIu64 "\n",
+            prefix, t.frames, t.samples, t.rejected, t.dropped, t.windows, t.analysisFailed, t.commands,
+            t.devices, t.storeErrors);
+}
+
+using Stores = std::vector<std::unique_ptr<tsdb::TimeSeriesWriter>>;
+
+/**
+ * One store writer per worker (none without --store); false if the store
+ * cannot be opened.
+ */
+bool openStores(const Config& config, Stores& stores) {
+    if (config.storeDir.empty()) {
+        return true;
+    }
+    for (unsigned i = 0; i < config.workers; i++) {
+        auto writer = std::make_unique<tsdb::TimeSeriesWriter>();
+        std::string error;
+        if (!writer->open(config.storeDir, "ingest-w" + std::to_string(i), error)) {
+            fprintf(stderr, "ingest_worker: store: %s\n", error.c_str());
+            return false;
+        }
+        stores.push_back(std::move(writer));
+    }
+    fprintf(stderr, "ingest_worker: storing samples under %s\n", config.storeDir.c_str());
+    return true;
+}
+
+/**
+ * Produced-to-written command latency (bucket upper bounds).
+ */
+void printLatency(const LatencyHistogram& latency) {
+    fprintf(stderr,
+            "ingest_worker: command_latency_us n=%" PRIu64 " p50<%" PRIu64 " p99<%" PRIu64 " max=%" PRIu64 "\n",
+            latency.count(), latency.quantile(0.50), latency.quantile(0.99), latency.max());
+}
+
+// ==========================================
+// Modes
+// ==========================================
+int runDaemon(const Config& config, const IngestBundle& bundle, Stores stores, Tracing& tracing, Metrics& metrics) {
+    const int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        perror("ingest_worker: epoll_create1");
+        return 1;
+    }
+    Outbox outbox;
+    epoll_event wake = {};
+    wake.events = EPOLLIN;
+    wake.data.ptr = &outbox;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, outbox.wakeFd(), &wake);
+
+    Router router(bundle, outbox, config.workers, std::move(stores), tracing.spans());
+    LatencyHistogram latency;
+    std::vector<std::unique_ptr<BrokerLink>> links;
+    for (unsigned i = 0; i < config.connections; i++) {
+        links.push_back(std::make_unique<BrokerLink>(config, i, epollFd, latency, tracing, metrics));
+    }
+    fprintf(stderr, "ingest_worker: %s:%d, %u connection(s), %u worker(s), group %s\n", config.host.c_str(),
+            config.port, config.connections, config.workers, config.group.c_str());
+
+    std::vector<epoll_event> events(64);
+    std::vector<Command> commands;
+    size_t nextLink = 0;
+    uint64_t droppedCommands = 0;
+    uint64_t lastStats = nowMs();
+    while (!g_stop.load()) {
+        uint64_t now = nowMs();
+        for (auto& link : links) {
+            link->maybeConnect(now);
+            link->tick(now);
+        }
+        const int n = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), 100);
+        if (n < 0 && errno != EINTR) {
+            perror("ingest_worker: epoll_wait");
+            break;
+        }
+        now = nowMs();
+        // Commands first, whatever else is ready
+        outbox.drain(commands);
+        for (const Command& command : commands) {
+            // Any ready connection can publish; spread them round robin
+            bool sent = false;
+            for (size_t tries = 0; tries < links.size() && !sent; tries++) {
+                BrokerLink& link = *links[nextLink++ % links.size()];
+                sent = link.publish(command, now);
+            }
+            droppedCommands += sent ? 0 : 1;
+            tracing.onDispatch(command, sent);
+        }
+        commands.clear();
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr != &outbox) {
+                static_cast<BrokerLink*>(events[i].data.ptr)->onEvent(events[i].events, router, now);
+            }
+        }
+        router.flush();
+
+        if (config.statsIntervalSec > 0 && now - lastStats >= config.statsIntervalSec * 1000ull) {
+            char prefix[96];
+            snprintf(prefix, sizeof(prefix), "ingest_worker: commands_dropped=%" PRIu64, droppedCommands);
+            const Router::Totals totals = router.totals();
+            printStats(prefix, totals);
+            tracing.print();
+            printLatency(latency);
+            metrics.write(totals);
+            lastStats = now;
+        }
+    }
+    for (auto& link : links) {
+        link->disconnect();
+    }
+    close(epollFd);
+    const Router::Totals totals = router.totals();
+    printStats("ingest_worker: final", totals);
+    tracing.print();
+    printLatency(latency);
+    metrics.write(totals);
+    return 0;
+}
+
+void printBrokerStats(const EmbeddedBroker& broker) {
+    std::string line = "ingest_worker: broker clients=" + std::to_string(broker.clients());
+    for (size_t c = 0; c < TOPIC_CLASS_COUNT; c++) {
+        const TopicStats& st = broker.stats(static_cast<TopicClass>(c));
+        char part[192];
+        snprintf(part, sizeof(part),
+                 " %s_in=%" PRIu64 " %s_in_bytes=%" PRIu64 " %s_out=%" PRIu64 " %s_out_bytes=%" PRIu64
+                 " %s_dropped=%" PRIu64,
+                 TOPIC_CLASS_NAMES[c], st.messagesIn, TOPIC_CLASS_NAMES[c], st.bytesIn, TOPIC_CLASS_NAMES[c],
+                 st.deliveries, TOPIC_CLASS_NAMES[c], st.bytesOut, TOPIC_CLASS_NAMES[c], st.dropped);
+        line += part;
+    }
+    fprintf(stderr, "%s\n", line.c_str());
+}
+
+/**
+ * Embedded broker mode: devices connect to this process. Each iteration
+ * queues worker commands before reading any socket, so they go out ahead of
+ * the sensor traffic read in the same iteration.
+ */
+int runBroker(const Config& config, const IngestBundle& bundle, Stores stores, Tracing& tracing, Metrics& metrics) {
+    const int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        perror("ingest_worker: epoll_create1");
+        return 1;
+    }
+    Outbox outbox;
+    epoll_event wake = {};
+    wake.events = EPOLLIN;
+    wake.data.ptr = &outbox;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, outbox.wakeFd(), &wake);
+
+    Router router(bundle, outbox, config.workers, std::move(stores), tracing.spans());
+    EmbeddedBroker broker(config, epollFd, tracing, metrics);
+    const int port = broker.listen();
+    if (port < 0) {
+        close(epollFd);
+        return 1;
+    }
+    fprintf(stderr, "ingest_worker: embedded broker listening on port %d, %u worker(s)\n", port, config.workers);
+
+    std::vector<epoll_event> events(256);
+    std::vector<Command> commands;
+    uint64_t lastStats = nowMs();
+    uint64_t lastExpire = lastStats;
+    while (!g_stop.load()) {
+        const int n = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), 100);
+        if (n < 0 && errno != EINTR) {
+            perror("ingest_worker: epoll_wait");
+            break;
+        }
+        const uint64_t now = nowMs();
+        outbox.drain(commands);
+        for (const Command& command : commands) {
+            tracing.onDispatch(command, broker.publish(command));
+        }
+        commands.clear();
+        for (int i = 0; i < n; i++) {
+            void* ptr = events[i].data.ptr;
+            if (ptr == &broker) {
+                broker.onAccept(now);
+            } else if (ptr != &outbox) {
+                broker.onEvent(*static_cast<BrokerSession*>(ptr), events[i].events, router, now);
+            }
+        }
+        router.flush();
+        if (now - lastExpire >= 1000) {
+            broker.expire(now);
+            lastExpire = now;
+        }
+        broker.flush();
+
+        if (config.statsIntervalSec > 0 && now - lastStats >= config.statsIntervalSec * 1000ull) {
+            const Router::Totals totals = router.totals();
+            printStats("ingest_worker:", totals);
+            tracing.print();
+            printBrokerStats(broker);
+            printLatency(broker.latency());
+            metrics.write(totals);
+            lastStats = now;
+        }
+    }
+    close(epollFd);
+    const Router::Totals totals = router.totals();
+    printStats("ingest_worker: final", totals);
+    tracing.print();
+    printBrokerStats(broker);
+    printLatency(broker.latency());
+    metrics.write(totals);
+    return 0;
+}
+
+/**
+ * Push synthetic devices through the router and workers as fast as they go
+ * (no broker) and report throughput relative to real time.
+ */
+int runBench(const Config& config, const IngestBundle& bundle, Stores stores) {
+    constexpr unsigned FRAMES_PER_SECOND = 10;  // 10-sample frames at 100 Hz, as the firmware sends
+    constexpr unsigned SAMPLES_PER_FRAME = 10;
+    constexpr double PI = 3.14159265358979323846;
+
+    // One second of frames per device, replayed every second
+    std::vector<std::string> frames;
+    frames.reserve(static_cast<size_t>(config.benchDevices) * FRAMES_PER_SECOND);
+    uint32_t noise = 12345;
+    for (unsigned f = 0; f < FRAMES_PER_SECOND; f++) {
+        for (unsigned d = 0; d < config.benchDevices; d++) {
+            char frame[512];
+            int len = snprintf(frame, sizeof(frame), "{\"device_id\":\"bench-%05u\",\"fs\":100,\"ppg\":[", d);
+            for (unsigned s = 0; s < SAMPLES_PER_FRAME; s++) {
+                noise = noise * 1664525u + 1013904223u;
+                const double t = (f * SAMPLES_PER_FRAME + s) / 100.0;
+                const double v = 2048.0 + (200.0 + d % 200) * std::sin(2.0 * PI * t) + (noise >> 24) / 16.0;
+                len += snprintf(frame + len, sizeof(frame) - len, s ? ",%.2f" : "%.2f", v);
+            }
+            len += snprintf(frame + len, sizeof(frame) - len, "]}");
+            frames.emplace_back(frame, static_cast<size_t>(len));
+        }
+    }
+
+    Outbox outbox;  // Commands are counted, never published
+    Router router(bundle, outbox, config.workers, std::move(stores), nullptr);
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned second = 0; second < config.benchSeconds && !g_stop.load(); second++) {
+        for (size_t i = 0; i < frames.size(); i++) {
+            const std::string& frame = frames[i];
+            router.route(reinterpret_cast<const uint8_t*>(frame.data()), frame.size(), 0);
+            if (i % 256 == 255) {
+                router.flush(true);
+            }
+        }
+        router.flush(true);
+        std::vector<Command> discard;
+        outbox.drain(discard);
+    }
+    while (!router.idle()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const Router::Totals t = router.totals();
+    printStats("bench:", t);
+    const double required = static_cast<double>(config.benchDevices) * 100.0;
+    printf("devices=%u workers=%u seconds=%u elapsed=%.2fs samples/s=%.0f windows/s=%.0f realtime=%.1fx\n",
+           config.benchDevices, config.workers, config.benchSeconds, elapsed, t.samples / elapsed,
+           t.windows / elapsed, t.samples / elapsed / required);
+    return t.dropped == 0 ? 0 : 1;
+}
+
+/**
+ * Window analysis for parity tests: each stdin line is
+ *   <sampling_rate> <n> <sample_1> ... <sample_n>
+ * and produces
+ *   <status> <hr> <hrv> <pulse> <num_peaks> <label> <p_0> ... <p_k>
+ * with floats as hex literals.
+ */
+int runProbe(const IngestBundle& bundle) {
+    PipelineWorkspace workspace;
+    std::vector<double> window;
+    double samplingRate;
+    size_t n;
+    while (std::cin >> samplingRate >> n) {
+        window.resize(n);
+        for (double& v : window) {
+            std::cin >> v;
+        }
+        const BandpassFilter* filter = bundle.filterFor(samplingRate);
+        if (filter == nullptr) {
+            printf("-1\n");
+            continue;
+        }
+        PipelineResult r = {};
+        const PipelineStatus status = runPipeline(bundle.forest(), filter->b.data(), filter->a.data(),
+                                                  filter->b.size(), window.data(), n, samplingRate, workspace, r);
+        printf("%d %a %a %a %u %u", static_cast<int>(status), r.heartRateBpm, r.hrvSdnnMs, r.pulseAmplitude,
+               r.numPeaks, r.predictedClass);
+        for (uint32_t c = 0; c < bundle.forest().numClasses(); c++) {
+            printf(" %a", r.probabilities[c]);
+        }
+        printf("\n");
+    }
+    return 0;
+}
+
+unsigned envUnsigned(const char* name, unsigned fallback) {
+    const char* v = getenv(name);
+    return (v != nullptr && *v != '\0') ? static_cast<unsigned>(strtoul(v, nullptr, 10)) : fallback;
+}
+
+std::string envString(const char* name, const std::string& fallback) {
+    const char* v = getenv(name);
+    return (v != nullptr && *v != '\0') ? std::string(v) : fallback;
+}
+
+bool parseArgs(int argc, char** argv, Config& c) {
+    c.host = envString("MQTT_HOST", c.host);
+    c.port = static_cast<int>(envUnsigned("MQTT_PORT", static_cast<unsigned>(c.port)));
+    c.bundlePath = envString("PULSEMIND_INGEST_BUNDLE", c.bundlePath);
+    c.workers = envUnsigned("PULSEMIND_INGEST_WORKERS", 0);
+    c.connections = envUnsigned("PULSEMIND_INGEST_CONNECTIONS", c.connections);
+    c.group = envString("PULSEMIND_INGEST_GROUP", c.group);
+    c.storeDir = envString("PULSEMIND_TSDB_DIR", c.storeDir);
+    c.traceFile = envString("PULSEMIND_TRACE_FILE", c.traceFile);
+    c.metricsFile = envString("PULSEMIND_METRICS_FILE", c.metricsFile);
+    const std::string listen = envString("PULSEMIND_INGEST_LISTEN", "");
+    if (!listen.empty()) {
+        c.listenPort = atoi(listen.c_str());
+    }
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--probe") {
+            c.probe = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "missing value for %s\n", arg.c_str());
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--host") {
+            c.host = value;
+        } else if (arg == "--port") {
+            c.port = atoi(value);
+        } else if (arg == "--bundle") {
+            c.bundlePath = value;
+        } else if (arg == "--workers") {
+            c.workers = static_cast<unsigned>(strtoul(value, nullptr, 10));
+        } else if (arg == "--connections") {
+            c.connections = static_cast<unsigned>(strtoul(value, nullptr, 10));
+        } else if (arg == "--group") {
+            c.group = value;
+        } else if (arg == "--client-id") {
+            c.clientId = value;
+        } else if (arg == "--keepalive") {
+            c.keepaliveSec = static_cast<unsigned>(strtoul(value, nullptr, 10));
+        } else if (arg == "--stats-interval") {
+            c.statsIntervalSec = static_cast<unsigned>(strtoul(value, nullptr, 10));
+        } else if (arg == "--store") {
+            c.storeDir = value;
+        } else if (arg == "--trace-file") {
+            c.traceFile = value;
+        } else if (arg == "--metrics-file") {
+            c.metricsFile = value;
+        } else if (arg == "--listen") {
+            c.listenPort = atoi(value);
+        } else if (arg == "--bench") {
+            c.benchDevices = static_cast<unsigned>(strtoul(value, nullptr, 10));
+        } else if (arg == "--bench-seconds") {
+            c.benchSeconds = static_cast<unsigned>(strtoul(value, nullptr, 10));
+        } else {
+            fprintf(stderr, "unknown option %s\n", arg.c_str());
+            return false;
+        }
+    }
+    if (c.workers == 0) {
+        c.workers = std::max(1u, std::thread::hardware_concurrency() - 1);
+    }
+    if (c.clientId.empty()) {
+        char host[64] = "ingest";
+        gethostname(host, sizeof(host) - 1);
+        c.clientId = "pulsemind-ingest-" + std::string(host) + "-" + std::to_string(getpid());
+    }
+    if (c.connections == 0 || c.keepaliveSec == 0 || c.keepaliveSec > 65535 || c.port <= 0 || c.port > 65535 ||
+        c.listenPort < -1 || c.listenPort > 65535) {
+        fprintf(stderr, "invalid connection settings\n");
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Config config;
+    if (!parseArgs(argc, argv, config)) {
+        return 2;
+    }
+
+    IngestBundle bundle;
+    std::string error;
+    if (!bundle.load(config.bundlePath, error)) {
+        fprintf(stderr, "ingest_worker: bundle %s: %s\n", config.bundlePath.c_str(), error.c_str());
+        return 1;
+    }
+    if (config.probe) {
+        return runProbe(bundle);
+    }
+
+    struct sigaction sa = {};
+    sa.sa_handler = onSignal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    Stores stores;
+    if (!openStores(config, stores)) {
+        return 1;
+    }
+    if (config.benchDevices > 0) {
+        return runBench(config, bundle, std::move(stores));
+    }
+    Metrics metrics;
+    if (!config.metricsFile.empty()) {
+        metrics.open(config.metricsFile);
+    }
+    // Outlives the router, whose workers record into its ring
+    Tracing tracing(metrics);
+    if (!config.traceFile.empty() && !tracing.open(config.traceFile)) {
+        return 1;
+    }
+    return config.listenPort >= 0 ? runBroker(config, bundle, std::move(stores), tracing, metrics)
+                                  : runDaemon(config, bundle, std::move(stores), tracing, metrics);
+}
@@ -0,0 +1,453 @@
+"""Tests for the native ingest worker and its model bundle."""
+
+import json
+import os
+import socket
+import struct
+import subprocess  # nosec B404
+import sys
+import tempfile
+import threading
+import time
+import unittest
+
+import numpy as np
+
+from export_ingest_bundle import write_bundle
+from rhythm_classifier import RHYTHM_CLASSES, RhythmClassifier
+from signal_processor import process_ppg_signal
+
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "control-engine"))
+import waveform_store  # noqa: E402
+from pacing_controller import AdaptivePacingPolicy  # noqa: E402
+
+WORKER_BINARY = os.path.join(os.path.dirname(os.path.abspath(__file__)), "build", "ingest_worker")
+
+
+def synthetic_ppg(rng, n, sampling_rate, bpm, noise):
+    t = np.arange(n) / sampling_rate
+    return 2048 + 300 * np.sin(2 * np.pi * bpm / 60.0 * t) + rng.normal(0, noise, n)
+
+
+def mqtt_packet(first_byte, body):
+    length, encoded = len(body), bytearray()
+    while True:
+        digit, length = length % 128, length // 128
+        encoded.append(digit | (0x80 if length else 0))
+        if not length:
+            return bytes([first_byte]) + bytes(encoded) + body
+
+
+def mqtt_string(s):
+    data = s.encode()
+    return struct.pack(">H", len(data)) + data
+
+
+def mqtt_connect(client_id, keepalive=30):
+    body = mqtt_string("MQTT") + bytes([4, 0x02]) + struct.pack(">H", keepalive) + mqtt_string(client_id)
+    return mqtt_packet(0x10, body)
+
+
+def mqtt_subscribe(packet_id, topic_filter):
+    return mqtt_packet(0x82, struct.pack(">H", packet_id) + mqtt_string(topic_filter) + b"\x00")
+
+
+def read_packet(conn):
+    """Read one MQTT packet: (type, flags, body)."""
+    header = conn.recv(1)
+    if not header:
+        raise ConnectionError("closed")
+    multiplier, length = 1, 0
+    while True:
+        digit = conn.recv(1)[0]
+        length += (digit & 0x7F) * multiplier
+        multiplier *= 128
+        if not digit & 0x80:
+            break
+    body = b""
+    while len(body) < length:
+        body += conn.recv(length - len(body))
+    return header[0] >> 4, header[0] & 0x0F, body
+
+
+@unittest.skipUnless(
+    os.path.exists(WORKER_BINARY),
+    "ingest worker not built (make -C services/ingest-worker)"
+)
+class TestIngestWorker(unittest.TestCase):
+    """Test the worker against the Python services."""
+
+    @classmethod
+    def setUpClass(cls):
+        cls.model = RhythmClassifier().create_default_model()
+        cls.tmp = tempfile.TemporaryDirectory()
+        cls.bundle = os.path.join(cls.tmp.name, "bundle.txt")
+        with open(cls.bundle, "w") as f:
+            write_bundle(cls.model, RHYTHM_CLASSES, f)
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.tmp.cleanup()
+
+    def test_window_analysis_matches_services(self):
+        """Test bundle + native window analysis against signal-service and the model."""
+        rng = np.random.default_rng(5)
+        windows = []
+        for _ in range(80):
+            sampling_rate = float(rng.choice([50, 100, 125, 250]))
+            windows.append((sampling_rate, synthetic_ppg(
+                rng, int(4 * sampling_rate), sampling_rate, rng.uniform(40, 170), rng.uniform(1, 120)
+            )))
+        stdin = "".join(
+            f"{rate} {len(w)} {' '.join(repr(float(v)) for v in w)}\n" for rate, w in windows
+        )
+        result = subprocess.run(  # nosec B603
+            [WORKER_BINARY, "--probe", "--bundle", self.bundle],
+            input=stdin, capture_output=True, text=True, check=True, timeout=60
+        )
+        lines = result.stdout.splitlines()
+        self.assertEqual(len(lines), len(windows))
+
+        compared = 0
+        for (rate, window), line in zip(windows, lines):
+            fields = line.split()
+            try:
+                expected = process_ppg_signal(window.tolist(), rate)["features"]
+            except ValueError:
+                self.assertNotEqual(fields[0], "0")
+                continue
+            self.assertEqual(fields[0], "0")
+            hr, hrv, pulse = (float.fromhex(v) for v in fields[1:4])
+            self.assertEqual(int(fields[4]), expected["num_peaks"])
+            self.assertEqual(hr, expected["heart_rate_bpm"])
+            self.assertEqual(pulse, expected["pulse_amplitude"])
+            if expected["num_peaks"] > 2:  # SDNN of one interval is NaN
+                self.assertEqual(hrv, expected["hrv_sdnn_ms"])
+            proba = self.model.predict_proba([[hr, hrv, pulse]])[0]
+            self.assertEqual([float.fromhex(v) for v in fields[6:]], proba.tolist())
+            self.assertEqual(int(fields[5]), int(np.argmax(proba)))
+            compared += 1
+        self.assertGreater(compared, 60)
+
+    def test_closed_loop_through_broker(self):
+        """Test frames in over a shared subscription, commands out per device."""
+        server = socket.socket()
+        server.bind(("127.0.0.1", 0))
+        server.listen(1)
+        server.settimeout(10)
+        port = server.getsockname()[1]
+        worker = subprocess.Popen(  # nosec B603
+            [WORKER_BINARY, "--bundle", self.bundle, "--host", "127.0.0.1", "--port", str(port),
+             "--workers", "2", "--stats-interval", "0", "--group", "test"],
+            stderr=subprocess.DEVNULL
+        )
+        commands = {}
+        conn = None
+        try:
+            conn, _ = server.accept()
+            conn.settimeout(10)
+            packet_type, _, body = read_packet(conn)
+            self.assertEqual(packet_type, 1)  # CONNECT
+            self.assertEqual(body[:7], b"\x00\x04MQTT\x04")
+            conn.sendall(bytes([0x20, 2, 0, 0]))
+
+            packet_type, _, body = read_packet(conn)
+            self.assertEqual(packet_type, 8)  # SUBSCRIBE
+            self.assertEqual(body[4:4 + 32].decode(), "$share/test/pulsemind/sensor/ppg")
+            conn.sendall(bytes([0x90, 3]) + body[:2] + b"\x00")
+
+            def read_commands():
+                try:
+                    while True:
+                        packet_type, _, body = read_packet(conn)
+                        if packet_type == 3:
+                            topic_len = struct.unpack(">H", body[:2])[0]
+                            topic = body[2:2 + topic_len].decode()
+                            commands.setdefault(topic, []).append(json.loads(body[2 + topic_len:]))
+                except (ConnectionError, OSError):
+                    return
+
+            reader = threading.Thread(target=read_commands, daemon=True)
+            reader.start()
+
+            # 6 s of 10-sample frames for two devices
+            rng = np.random.default_rng(9)
+            signals = {
+                "dev-a": synthetic_ppg(rng, 600, 100.0, 72.0, 10.0),
+                "dev-b": synthetic_ppg(rng, 600, 100.0, 150.0, 10.0),
+            }
+            for start in range(0, 600, 10):
+                for device_id, signal in signals.items():
+                    frame = json.dumps({
+                        "device_id": device_id, "ts": 1000 + start * 10,
+                        "ppg": [round(float(v), 2) for v in signal[start:start + 10]],
+                    })
+                    conn.sendall(mqtt_packet(
+                        0x30, mqtt_string("pulsemind/sensor/ppg") + frame.encode()
+                    ))
+            deadline = time.time() + 10
+            while len(commands) < 2 and time.time() < deadline:
+                time.sleep(0.05)
+        finally:
+            worker.terminate()
+            worker.wait(timeout=10)
+            if conn is not None:
+                conn.close()
+            server.close()
+
+        self.assertEqual(
+            sorted(commands),
+            ["pulsemind/pacing/command/dev-a", "pulsemind/pacing/command/dev-b"]
+        )
+        for messages in commands.values():
+            first = messages[0]
+            self.assertIn(first["pacing_command"]["pacing_mode"],
+                          {"monitor_only", "minimal", "moderate", "aggressive", "emergency"})
+            self.assertTrue(first["shaped_command"]["publish"])
+            # The firmware re-runs its policy only on input_summary
+            summary = first["input_summary"]
+            self.assertIn(summary["rhythm_class"], RHYTHM_CLASSES)
+            self.assertEqual(summary["device_id"], first["device_id"])
+            self.assertEqual(sorted(summary), sorted(
+                ["device_id", "rhythm_class", "rhythm_confidence", "hsi_score", "hsi_trend", "heart_rate_bpm"]
+            ))
+            # ...from the state the worker's policy was in, which replays
+            # to the same command with the Python policy
+            policy = AdaptivePacingPolicy()
+            policy.import_state(dict(first["policy_state"], total_safety_violations=0, total_fallback_activations=0))
+            replayed = policy.compute_pacing_command(
+                summary["rhythm_class"], summary["rhythm_confidence"], summary["hsi_score"],
+                summary["hsi_trend"], summary["heart_rate_bpm"],
+            )
+            self.assertEqual(replayed["pacing_mode"], first["pacing_command"]["pacing_mode"])
+            self.assertAlmostEqual(replayed["target_rate_bpm"], first["pacing_command"]["target_rate_bpm"], places=1)
+        self.assertEqual(commands["pulsemind/pacing/command/dev-b"][0]["device_id"], "dev-b")
+        # Newest sample time on the device clock: frames start at 1000 ms, 10 ms apart
+        frame_ts = commands["pulsemind/pacing/command/dev-a"][0]["frame_ts_ms"]
+        self.assertEqual((frame_ts - 1000) % 100, 90)
+
+    def test_embedded_broker(self):
+        """Test --listen: devices connect to the worker, commands and fan-out come back."""
+        store_dir = os.path.join(self.tmp.name, "tsdb")
+        worker = subprocess.Popen(  # nosec B603
+            [WORKER_BINARY, "--bundle", self.bundle, "--listen", "0", "--workers", "2",
+             "--stats-interval", "0", "--store", store_dir],
+            stderr=subprocess.PIPE, text=True
+        )
+        clients = []
+        try:
+            port = None
+            for line in worker.stderr:
+                if "listening on port" in line:
+                    port = int(line.split("port")[1].split(",")[0])
+                    break
+            self.assertIsNotNone(port)
+
+            def connect(client_id, *filters):
+                conn = socket.create_connection(("127.0.0.1", port), timeout=10)
+                clients.append(conn)
+                conn.sendall(mqtt_connect(client_id))
+                self.assertEqual(read_packet(conn), (2, 0, b"\x00\x00"))  # CONNACK accepted
+                for i, topic_filter in enumerate(filters, 1):
+                    conn.sendall(mqtt_subscribe(i, topic_filter))
+                    self.assertEqual(read_packet(conn), (9, 0, struct.pack(">H", i) + b"\x00"))
+                return conn
+
+            device = connect("dev-a", "pulsemind/pacing/command/dev-a")
+            dashboard = connect("dashboard", "pulsemind/sensor/#")
+
+            # Shared subscriptions are a broker-client feature, refused here
+            dashboard.sendall(mqtt_subscribe(5, "$share/g/pulsemind/sensor/ppg"))
+            self.assertEqual(read_packet(dashboard), (9, 0, b"\x00\x05\x80"))
+
+            signal = synthetic_ppg(np.random.default_rng(3), 600, 100.0, 80.0, 10.0)
+            sent = [round(float(v), 2) for v in signal]
+            for start in range(0, 600, 10):
+                frame = json.dumps({
+                    "device_id": "dev-a", "ts": 1000 + start * 10,
+                    "ppg": sent[start:start + 10],
+                })
+                device.sendall(mqtt_packet(0x30, mqtt_string("pulsemind/sensor/ppg") + frame.encode()))
+
+            # Every sensor frame reaches the dashboard, in order
+            for start in range(0, 600, 10):
+                packet_type, _, body = read_packet(dashboard)
+                self.assertEqual(packet_type, 3)
+                self.assertEqual(json.loads(body[2 + len("pulsemind/sensor/ppg"):])["ts"], 1000 + start * 10)
+
+            packet_type, _, body = read_packet(device)
+            self.assertEqual(packet_type, 3)
+            topic_len = struct.unpack(">H", body[:2])[0]
+            self.assertEqual(body[2:2 + topic_len].decode(), "pulsemind/pacing/command/dev-a")
+            self.assertEqual(json.loads(body[2 + topic_len:])["device_id"], "dev-a")
+
+            device.sendall(bytes([0xC0, 0]))  # PINGREQ
+            while True:
+                packet_type, _, _ = read_packet(device)
+                if packet_type == 13:  # PINGRESP (after any queued commands)
+                    break
+                self.assertEqual(packet_type, 3)
+        finally:
+            for conn in clients:
+                conn.close()
+            worker.terminate()
+            worker.wait(timeout=10)
+            stderr = worker.stderr.read()
+            worker.stderr.close()
+
+        lines = stderr.strip().splitlines()
+        stats = dict(item.split("=") for item in lines[-2].split("broker ")[1].split())
+        latency = dict(item.replace("<", "=").split("=") for item in lines[-1].split("command_latency_us ")[1].split())
+        self.assertGreaterEqual(int(latency["n"]), 1)
+        self.assertLessEqual(int(latency["p50"]), int(latency["p99"]))
+        self.assertEqual(int(stats["sensor_in"]), 60)
+        self.assertEqual(int(stats["sensor_out"]), 60)
+        self.assertGreaterEqual(int(stats["command_out"]), 1)
+        self.assertEqual(int(stats["sensor_dropped"]) + int(stats["command_dropped"]), 0)
+
+        # The raw samples and window features were stored on wall-clock time
+        if not waveform_store.is_available():
+            return
+        reader = waveform_store.WaveformReader(store_dir)
+        try:
+            timestamps, values = reader.query("dev-a", "ppg", 0, 2**62)
+            self.assertEqual(values, sent)
+            self.assertEqual(set(np.diff(timestamps)), {10_000})  # Device clock spacing
+            self.assertLess(abs(timestamps[-1] / 1e6 - time.time()), 60)
+            hsi_ts, hsi = reader.query("dev-a", "hsi_score", 0, 2**62)
+            self.assertGreaterEqual(len(hsi), 1)
+            self.assertIn(hsi_ts[0], timestamps)
+            # Rollups were maintained alongside and stored on shutdown
+            seconds = reader.query_rollup("dev-a", "ppg", 1, 0, 2**62)
+            self.assertEqual(sum(seconds["count"]), len(sent))
+            self.assertEqual(min(seconds["min"]), min(sent))
+        finally:
+            reader.close()
+
+    def test_traced_closed_loop(self):
+        """Test traced frames: the command carries the trace, the device report closes it."""
+        trace_file = os.path.join(self.tmp.name, "spans.jsonl")
+        metrics_file = os.path.join(self.tmp.name, "ingest.prom")
+        worker = subprocess.Popen(  # nosec B603
+            [WORKER_BINARY, "--bundle", self.bundle, "--listen", "0", "--workers", "1",
+             "--stats-interval", "0", "--trace-file", trace_file, "--metrics-file", metrics_file],
+            stderr=subprocess.PIPE, text=True
+        )
+        device = None
+        try:
+            port = None
+            for line in worker.stderr:
+                if "listening on port" in line:
+                    port = int(line.split("port")[1].split(",")[0])
+                    break
+            self.assertIsNotNone(port)
+            device = socket.create_connection(("127.0.0.1", port), timeout=10)
+            device.sendall(mqtt_connect("dev-t"))
+            self.assertEqual(read_packet(device)[0], 2)
+            device.sendall(mqtt_subscribe(1, "pulsemind/pacing/command/dev-t"))
+            self.assertEqual(read_packet(device)[0], 9)
+
+            # As the firmware does: a new trace per frame, rooted at its low half
+            signal = synthetic_ppg(np.random.default_rng(5), 600, 100.0, 75.0, 10.0)
+            trace_ids = set()
+            for start in range(0, 600, 10):
+                trace_id = os.urandom(16).hex()
+                trace_ids.add(trace_id)
+                frame = json.dumps({
+                    "device_id": "dev-t", "ts": 1000 + start * 10,
+                    "traceparent": f"00-{trace_id}-{trace_id[16:]}-01",
+                    "ppg": [round(float(v), 2) for v in signal[start:start + 10]],
+                })
+                device.sendall(mqtt_packet(0x30, mqtt_string("pulsemind/sensor/ppg") + frame.encode()))
+
+            packet_type, _, body = read_packet(device)
+            self.assertEqual(packet_type, 3)
+            command = json.loads(body[2 + len("pulsemind/pacing/command/dev-t"):])
+            _, trace_id, dispatch_span, flags = command["traceparent"].split("-")
+            self.assertIn(trace_id, trace_ids)
+            self.assertEqual(flags, "01")
+
+            sample_ms = command["frame_ts_ms"]
+            report = json.dumps({
+                "device_id": "dev-t", "traceparent": command["traceparent"],
+                "sample_ms": sample_ms, "command_rx_ms": sample_ms + 40, "applied_ms": sample_ms + 50,
+                "actuation_ms": sample_ms + 450, "now_ms": sample_ms + 451,
+            })
+            device.sendall(mqtt_packet(0x30, mqtt_string("pulsemind/device/trace") + report.encode()))
+            device.sendall(mqtt_packet(0x30, mqtt_string("pulsemind/device/trace") + b"{}"))
+            # A status frame, as the firmware sends it every STATUS_INTERVAL_MS
+            status = json.dumps({
+                "device_id": "dev-t", "status": "ok", "metrics": {
+                    "pulsemind_device_commands_total": 7, "pulsemind_device_command_latency_max_seconds": 0.042,
+                },
+            })
+            device.sendall(mqtt_packet(0x30, mqtt_string("pulsemind/device/status") + status.encode()))
+            device.sendall(mqtt_packet(0x30, mqtt_string("pulsemind/device/status") + b"{"))
+            device.sendall(bytes([0xC0, 0]))  # PINGREQ: the reports were handled before its answer
+            while read_packet(device)[0] != 13:
+                pass
+        finally:
+            if device is not None:
+                device.close()
+            worker.terminate()
+            worker.wait(timeout=10)
+            stderr = worker.stderr.read()
+            worker.stderr.close()
+
+        lines = stderr.strip().splitlines()
+        traces = dict(
+            item.replace("<", "=").split("=") for item in lines[-3].split("sample_to_actuation_us ")[1].split()
+        )
+        self.assertEqual(int(traces["n"]), 1)
+        self.assertEqual(int(traces["max"]), 450_000)
+        self.assertEqual(int(traces["reports"]), 1)
+        self.assertEqual(int(traces["rejected"]), 1)
+        self.assertEqual(int(traces["spans_dropped"]), 0)
+
+        # Written on exit, in the services' /metrics format
+        with open(metrics_file) as f:
+            exposition = f.read()
+        self.assertIn("# TYPE pulsemind_device_commands_total counter\n", exposition)
+        self.assertIn('pulsemind_device_commands_total{device_id="dev-t"} 7\n', exposition)
+        self.assertIn('pulsemind_device_command_latency_max_seconds{device_id="dev-t"} 0.042\n', exposition)
+        self.assertIn("pulsemind_ingest_status_frames_total 1\n", exposition)
+        self.assertIn("pulsemind_ingest_status_rejected_total 1\n", exposition)
+        self.assertIn('pulsemind_loop_sample_to_actuation_seconds_bucket{le="0.262144"} 0\n', exposition)
+        self.assertIn('pulsemind_loop_sample_to_actuation_seconds_bucket{le="1.048576"} 1\n', exposition)
+        self.assertIn("pulsemind_loop_sample_to_actuation_seconds_sum 0.450000\n", exposition)
+        self.assertRegex(exposition, r"\npulsemind_ingest_frames_total 60\n")
+
+        spans = {}
+        with open(trace_file) as f:
+            for line in f:
+                for resource in json.loads(line)["resourceSpans"]:
+                    service = resource["resource"]["attributes"][0]["value"]["stringValue"]
+                    for span in resource["scopeSpans"][0]["spans"]:
+                        if span["traceId"] == trace_id:
+                            spans[span["name"]] = dict(span, service=service)
+        self.assertGreaterEqual(int(traces["spans"]), len(spans))
+        self.assertEqual(set(spans), {
+            "ingest.queue", "ingest.window", "pipeline.analyze", "policy.decide", "command.dispatch",
+            "device.sample_to_actuation", "device.command_apply", "device.pulse_wait",
+        })
+        root = spans["device.sample_to_actuation"]
+        self.assertEqual((root["spanId"], root["service"]), (trace_id[16:], "esp32-firmware"))
+        self.assertNotIn("parentSpanId", root)
+        window = spans["ingest.window"]
+        self.assertEqual(window["parentSpanId"], trace_id[16:])
+        self.assertEqual(spans["pipeline.analyze"]["parentSpanId"], window["spanId"])
+        self.assertEqual(spans["command.dispatch"]["spanId"], dispatch_span)
+        self.assertEqual(spans["command.dispatch"]["parentSpanId"], window["spanId"])
+        self.assertEqual(spans["device.command_apply"]["parentSpanId"], dispatch_span)
+        self.assertEqual(spans["device.pulse_wait"]["parentSpanId"], spans["device.command_apply"]["spanId"])
+
+        def duration_ns(span):
+            return int(span["endTimeUnixNano"]) - int(span["startTimeUnixNano"])
+
+        self.assertEqual(duration_ns(root), 450_000_000)
+        self.assertEqual(duration_ns(spans["device.pulse_wait"]), 400_000_000)
+        self.assertEqual(int(spans["device.pulse_wait"]["endTimeUnixNano"]), int(root["endTimeUnixNano"]))
+
+
+if __name__ == "__main__":
+    unittest.main()
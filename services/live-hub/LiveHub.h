@@ -0,0 +1,404 @@
+#ifndef PULSEMIND_LIVE_HUB_H
+#define PULSEMIND_LIVE_HUB_H
+
+/**
+ * Live device state for dashboard fan-out, independent of sockets.
+ *
+ * The hub keeps, per device, the newest sampling rate and pacing command
+ * and a short ring of raw samples numbered by a running sequence. A viewer
+ * holds a cursor per subscribed device; compose() turns everything that
+ * changed since the viewer's cursors into one JSON message:
+ *
+ *   {"t": <hub wall-clock us>, "updates": [
+ *     {"device": "dev-a", "seq": 1234, "reset": true, "ts_ms": 98765,
+ *      "samples": [2048, 2051.5, ...],
+ *      "state": {"fs": 100, "command": {...} | null, "command_us": 0}}
+ *   ]}
+ *
+ * - samples are the ones numbered seq - len(samples) .. seq - 1
+ * - "reset" (only when true): samples were skipped since the viewer's last
+ *   update (first update, or the viewer fell more than a ring behind), so
+ *   its trace restarts here
+ * - "ts_ms" (only when the device sends it): device clock of the newest
+ *   frame's first sample
+ * - "state" only when the rate or command changed since the viewer last
+ *   saw it; "command" is the device's newest pacing command as published
+ *
+ * Messages coalesce: however many frames arrived since a viewer's last
+ * message, it gets one update per device. Within a tick, an update is
+ * encoded once per device and cursor and copied to every viewer at that
+ * cursor, so per-viewer cost is a memcpy when viewers keep up.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <charconv>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "IngestFrame.h"
+
+namespace pulsemind {
+
+constexpr size_t DEFAULT_RING_SAMPLES = 1024;  // ~10 s at 100 Hz
+constexpr size_t MAX_RING_SAMPLES = 1 << 16;
+constexpr size_t MAX_VIEWER_DEVICES = 32;
+constexpr size_t MAX_COMMAND_BYTES = 16 * 1024;
+
+// ==========================================
+// Waveform Ring
+// ==========================================
+
+/**
+ * The newest capacity() samples of a device; sample k of the device's
+ * stream (from 0) is retained while tail() <= k < head().
+ */
+class WaveformRing {
+public:
+    /** capacity is rounded up to a power of two (at least 2). */
+    explicit WaveformRing(size_t capacity) {
+        size_t n = 2;
+        while (n < capacity && n < MAX_RING_SAMPLES) {
+            n <<= 1;
+        }
+        samples_.assign(n, 0.0);
+        mask_ = n - 1;
+    }
+
+    void append(const double* v, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            samples_[(head_ + i) & mask_] = v[i];
+        }
+        head_ += n;
+    }
+
+    uint64_t head() const { return head_; }
+    uint64_t tail() const { return head_ > capacity() ? head_ - capacity() : 0; }
+    size_t capacity() const { return mask_ + 1; }
+    double at(uint64_t seq) const { return samples_[seq & mask_]; }
+
+private:
+    std::vector<double> samples_;
+    uint64_t mask_ = 0;
+    uint64_t head_ = 0;
+};
+
+// ==========================================
+// Devices and Viewers
+// ==========================================
+
+struct DeviceLive {
+    DeviceLive(std::string_view deviceId, size_t ringSamples, int64_t nowUs)
+        : id(deviceId), ring(ringSamples), lastSeenUs(nowUs) {}
+
+    std::string id;
+    WaveformRing ring;
+    double samplingRate = 0;   // 0 until a frame states it
+    bool hasTimestamp = false;
+    uint64_t frameTsMs = 0;    // Newest frame's first sample, device clock
+    int64_t lastSeenUs;        // Newest frame or command (creation before either)
+    uint64_t frames = 0;
+    std::string command;       // Newest pacing command JSON ("" before the first)
+    int64_t commandUs = 0;     // When command last changed
+    uint64_t stateVersion = 1; // Bumped when samplingRate or command changes
+    uint32_t viewers = 0;
+
+    /** An update encoded this tick, shared by viewers at the same cursor. */
+    struct Encoded {
+        uint64_t from;
+        bool reset;
+        bool withState;
+        std::string json;
+    };
+    std::vector<Encoded> encoded;
+};
+
+struct Subscription {
+    DeviceLive* device;
+    uint64_t cursor = 0;   // Next sample the viewer has not seen
+    uint64_t version = 0;  // stateVersion last sent (0: nothing sent yet)
+};
+
+/**
+ * A viewer's subscriptions; owned by its connection, which must call
+ * LiveHub::release() before dropping it.
+ */
+struct Viewer {
+    std::vector<Subscription> subscriptions;
+};
+
+class LiveHub {
+public:
+    struct Stats {
+        uint64_t frames;       // Accepted sensor frames
+        uint64_t badFrames;    // Rejected (FrameStatus != Ok)
+        uint64_t samples;
+        uint64_t commands;
+        uint64_t badCommands;  // Not a JSON object, or too large
+        uint64_t messages;     // compose() calls that produced a message
+        uint64_t updates;      // Device updates across those messages
+        uint64_t encodes;      // Updates encoded
+        uint64_t resets;       // Updates that skipped samples for a lagging viewer
+    };
+
+    explicit LiveHub(size_t ringSamples = DEFAULT_RING_SAMPLES) : ringSamples_(ringSamples) {}
+
+    LiveHub(const LiveHub&) = delete;
+    LiveHub& operator=(const LiveHub&) = delete;
+
+    /**
+     * A pulsemind/sensor/ppg payload (IngestFrame.h encodings).
+     */
+    FrameStatus onSensorFrame(const uint8_t* p, size_t n, int64_t nowUs) {
+        Frame frame = {};
+        samples_.clear();
+        const FrameStatus status = decodeFrame(p, n, frame, samples_);
+        if (status != FrameStatus::Ok) {
+            stats_.badFrames++;
+            return status;
+        }
+        DeviceLive& d = device(frame.deviceId, nowUs);
+        d.ring.append(samples_.data(), samples_.size());
+        if (frame.samplingRate > 0 && frame.samplingRate != d.samplingRate) {
+            d.samplingRate = frame.samplingRate;
+            d.stateVersion++;
+        }
+        d.hasTimestamp = frame.hasTimestamp;
+        d.frameTsMs = frame.timestampMs;
+        d.lastSeenUs = nowUs;
+        d.frames++;
+        stats_.frames++;
+        stats_.samples += samples_.size();
+        return FrameStatus::Ok;
+    }
+
+    /**
+     * A pacing command for deviceId (pulsemind/pacing/command/<id>). Kept
+     * verbatim when it is a JSON object; false (and ignored) otherwise.
+     */
+    bool onCommand(std::string_view deviceId, const char* p, size_t n, int64_t nowUs) {
+        if (!detail::validDeviceId(deviceId) || n > MAX_COMMAND_BYTES || !isJsonObject(p, n)) {
+            stats_.badCommands++;
+            return false;
+        }
+        DeviceLive& d = device(deviceId, nowUs);
+        if (d.command.size() != n || memcmp(d.command.data(), p, n) != 0) {
+            d.command.assign(p, n);
+            d.commandUs = nowUs;
+            d.stateVersion++;
+        }
+        d.lastSeenUs = nowUs;
+        stats_.commands++;
+        return true;
+    }
+
+    /**
+     * Add deviceId to the viewer (a no-op if already there). False for an
+     * invalid id or past MAX_VIEWER_DEVICES.
+     */
+    bool subscribe(Viewer& v, std::string_view deviceId, int64_t nowUs) {
+        if (!detail::validDeviceId(deviceId)) {
+            return false;
+        }
+        for (const Subscription& s : v.subscriptions) {
+            if (s.device->id == deviceId) {
+                return true;
+            }
+        }
+        if (v.subscriptions.size() >= MAX_VIEWER_DEVICES) {
+            return false;
+        }
+        DeviceLive& d = device(deviceId, nowUs);
+        d.viewers++;
+        v.subscriptions.push_back({&d});
+        return true;
+    }
+
+    void release(Viewer& v) {
+        for (const Subscription& s : v.subscriptions) {
+            s.device->viewers--;
+        }
+        v.subscriptions.clear();
+    }
+
+    /**
+     * Start a fan-out round: forget the previous round's encoded updates.
+     */
+    void beginTick() {
+        for (DeviceLive* d : touched_) {
+            d->encoded.clear();
+        }
+        touched_.clear();
+    }
+
+    /**
+     * The viewer's next message into out, advancing its cursors; false (out
+     * empty) when none of its devices changed.
+     */
+    bool compose(Viewer& v, int64_t nowUs, std::string& out) {
+        out.clear();
+        for (Subscription& s : v.subscriptions) {
+            DeviceLive& d = *s.device;
+            const uint64_t head = d.ring.head();
+            const bool withState = s.version != d.stateVersion;
+            if (s.cursor == head && !withState) {
+                continue;
+            }
+            const uint64_t tail = d.ring.tail();
+            const bool first = s.version == 0;
+            const uint64_t from = s.cursor >= tail && !first ? s.cursor : tail;
+            const bool reset = first || from != s.cursor;
+            if (reset && !first) {
+                stats_.resets++;
+            }
+            if (out.empty()) {
+                out = "{\"t\":";
+                appendInt(out, nowUs);
+                out += ",\"updates\":[";
+            } else {
+                out += ',';
+            }
+            out += update(d, from, reset, withState);
+            s.cursor = head;
+            s.version = d.stateVersion;
+            stats_.updates++;
+        }
+        if (out.empty()) {
+            return false;
+        }
+        out += "]}";
+        stats_.messages++;
+        return true;
+    }
+
+    /**
+     * Forget devices nobody watches that sent nothing for idleUs.
+     */
+    size_t sweep(int64_t nowUs, int64_t idleUs) {
+        beginTick();
+        size_t removed = 0;
+        for (auto it = devices_.begin(); it != devices_.end();) {
+            if (it->second->viewers == 0 && nowUs - it->second->lastSeenUs > idleUs) {
+                it = devices_.erase(it);
+                removed++;
+            } else {
+                ++it;
+            }
+        }
+        return removed;
+    }
+
+    const DeviceLive* find(std::string_view deviceId) const {
+        key_.assign(deviceId.data(), deviceId.size());
+        auto it = devices_.find(key_);
+        return it == devices_.end() ? nullptr : it->second.get();
+    }
+
+    size_t devices() const { return devices_.size(); }
+    const Stats& stats() const { return stats_; }
+
+private:
+    static bool isJsonObject(const char* p, size_t n) {
+        // Commands are embedded verbatim, so raw control characters in
+        // strings (which the cursor lets through) are refused too
+        bool inString = false;
+        for (size_t i = 0; i < n; i++) {
+            const unsigned char c = static_cast<unsigned char>(p[i]);
+            if (!inString) {
+                inString = c == '"';
+            } else if (c < 0x20) {
+                return false;
+            } else if (c == '\\') {
+                i++;
+            } else if (c == '"') {
+                inString = false;
+            }
+        }
+        detail::JsonCursor c(p, p + n);
+        return c.peek('{') && c.skipValue() && c.atEnd();
+    }
+
+    static void appendInt(std::string& out, int64_t v) {
+        char buf[24];
+        const auto r = std::to_chars(buf, buf + sizeof(buf), v);
+        out.append(buf, r.ptr);
+    }
+
+    static void appendNumber(std::string& out, double v) {
+        // Shortest round-trip form: 2048 rather than 2048.000000
+        char buf[32];
+        const auto r = std::to_chars(buf, buf + sizeof(buf), v);
+        out.append(buf, r.ptr);
+    }
+
+    DeviceLive& device(std::string_view deviceId, int64_t nowUs) {
+        key_.assign(deviceId.data(), deviceId.size());
+        auto it = devices_.find(key_);
+        if (it == devices_.end()) {
+            it = devices_.emplace(key_, std::make_unique<DeviceLive>(deviceId, ringSamples_, nowUs)).first;
+        }
+        return *it->second;
+    }
+
+    const std::string& update(DeviceLive& d, uint64_t from, bool reset, bool withState) {
+        for (const DeviceLive::Encoded& e : d.encoded) {
+            if (e.from == from && e.reset == reset && e.withState == withState) {
+                return e.json;
+            }
+        }
+        if (d.encoded.empty()) {
+            touched_.push_back(&d);
+        }
+        stats_.encodes++;
+        d.encoded.push_back({from, reset, withState, std::string()});
+        std::string& out = d.encoded.back().json;
+        const uint64_t head = d.ring.head();
+        out.reserve(64 + (head - from) * 8);
+        out = "{\"device\":\"";
+        out += d.id;  // detail::validDeviceId: nothing to escape
+        out += "\",\"seq\":";
+        appendInt(out, static_cast<int64_t>(head));
+        if (reset) {
+            out += ",\"reset\":true";
+        }
+        if (d.hasTimestamp) {
+            out += ",\"ts_ms\":";
+            appendInt(out, static_cast<int64_t>(d.frameTsMs));
+        }
+        out += ",\"samples\":[";
+        for (uint64_t k = from; k < head; k++) {
+            if (k != from) {
+                out += ',';
+            }
+            appendNumber(out, d.ring.at(k));
+        }
+        out += ']';
+        if (withState) {
+            out += ",\"state\":{\"fs\":";
+            appendNumber(out, d.samplingRate);
+            out += ",\"command\":";
+            out += d.command.empty() ? "null" : d.command;
+            out += ",\"command_us\":";
+            appendInt(out, d.commandUs);
+            out += '}';
+        }
+        out += '}';
+        return out;
+    }
+
+    size_t ringSamples_;
+    std::unordered_map<std::string, std::unique_ptr<DeviceLive>> devices_;
+    std::vector<DeviceLive*> touched_;
+    std::vector<double> samples_;
+    mutable std::string key_;
+    Stats stats_ = {};
+};
+
+}  // namespace pulsemind
+
+#endif  // PULSEMIND_LIVE_HUB_H
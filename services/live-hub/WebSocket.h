@@ -0,0 +1,442 @@
+#ifndef PULSEMIND_WEBSOCKET_H
+#define PULSEMIND_WEBSOCKET_H
+
+/**
+ * Server side of RFC 6455 for the live hub: the HTTP upgrade request, the
+ * accept key (SHA-1 + base64), and frame encoding/decoding.
+ *
+ * Only what a fan-out server needs: outgoing frames are unfragmented and
+ * unmasked; incoming frames must be masked (clients always mask) and are
+ * small (subscriptions live in the upgrade URL, so viewers only ever send
+ * control frames).
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace pulsemind {
+namespace ws {
+
+constexpr uint8_t OP_CONTINUATION = 0x0;
+constexpr uint8_t OP_TEXT = 0x1;
+constexpr uint8_t OP_BINARY = 0x2;
+constexpr uint8_t OP_CLOSE = 0x8;
+constexpr uint8_t OP_PING = 0x9;
+constexpr uint8_t OP_PONG = 0xA;
+
+constexpr uint16_t CLOSE_NORMAL = 1000;
+constexpr uint16_t CLOSE_GOING_AWAY = 1001;
+constexpr uint16_t CLOSE_PROTOCOL_ERROR = 1002;
+constexpr uint16_t CLOSE_TOO_BIG = 1009;
+constexpr uint16_t CLOSE_TRY_AGAIN_LATER = 1013;
+
+constexpr size_t MAX_REQUEST_BYTES = 8 * 1024;
+constexpr size_t MAX_CONTROL_PAYLOAD = 125;
+constexpr const char* ACCEPT_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// ==========================================
+// SHA-1 and Base64 (accept key only)
+// ==========================================
+
+inline uint32_t rotl32(uint32_t x, unsigned n) { return (x << n) | (x >> (32 - n)); }
+
+inline void sha1(const uint8_t* data, size_t n, uint8_t digest[20]) {
+    uint32_t h[5] = {0x67452301u, 0xEFCDAB89u, 0x98BADCFEu, 0x10325476u, 0xC3D2E1F0u};
+    const uint64_t bits = static_cast<uint64_t>(n) * 8;
+    // Message, 0x80, zero padding, 64-bit big-endian length: whole 64-byte blocks
+    const size_t total = ((n + 8) / 64 + 1) * 64;
+    uint8_t block[64];
+    for (size_t offset = 0; offset < total; offset += 64) {
+        for (size_t i = 0; i < 64; i++) {
+            const size_t at = offset + i;
+            if (at < n) {
+                block[i] = data[at];
+            } else if (at == n) {
+                block[i] = 0x80;
+            } else if (at >= total - 8) {
+                block[i] = static_cast<uint8_t>(bits >> (8 * (total - 1 - at)));
+            } else {
+                block[i] = 0;
+            }
+        }
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            w[i] = (static_cast<uint32_t>(block[4 * i]) << 24) | (static_cast<uint32_t>(block[4 * i + 1]) << 16) |
+                   (static_cast<uint32_t>(block[4 * i + 2]) << 8) | block[4 * i + 3];
+        }
+        for (int i = 16; i < 80; i++) {
+            w[i] = rotl32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999u;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1u;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDCu;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6u;
+            }
+            const uint32_t t = rotl32(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl32(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+    for (int i = 0; i < 5; i++) {
+        digest[4 * i] = static_cast<uint8_t>(h[i] >> 24);
+        digest[4 * i + 1] = static_cast<uint8_t>(h[i] >> 16);
+        digest[4 * i + 2] = static_cast<uint8_t>(h[i] >> 8);
+        digest[4 * i + 3] = static_cast<uint8_t>(h[i]);
+    }
+}
+
+inline std::string base64Encode(const uint8_t* data, size_t n) {
+    static const char* const alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((n + 2) / 3 * 4);
+    for (size_t i = 0; i < n; i += 3) {
+        const uint32_t v = (static_cast<uint32_t>(data[i]) << 16) | (i + 1 < n ? data[i + 1] << 8 : 0) |
+                           (i + 2 < n ? data[i + 2] : 0);
+        out.push_back(alphabet[(v >> 18) & 0x3F]);
+        out.push_back(alphabet[(v >> 12) & 0x3F]);
+        out.push_back(i + 1 < n ? alphabet[(v >> 6) & 0x3F] : '=');
+        out.push_back(i + 2 < n ? alphabet[v & 0x3F] : '=');
+    }
+    return out;
+}
+
+/**
+ * Sec-WebSocket-Accept for a client's Sec-WebSocket-Key.
+ */
+inline std::string acceptKey(std::string_view key) {
+    std::string input(key);
+    input += ACCEPT_GUID;
+    uint8_t digest[20];
+    sha1(reinterpret_cast<const uint8_t*>(input.data()), input.size(), digest);
+    return base64Encode(digest, sizeof(digest));
+}
+
+// ==========================================
+// Upgrade Request
+// ==========================================
+
+/**
+ * An HTTP/1.1 request head. Views alias the receive buffer.
+ */
+struct Request {
+    std::string_view method;
+    std::string_view path;
+    std::string_view query;     // After '?', without it
+    std::string_view key;       // Sec-WebSocket-Key
+    std::string_view version;   // Sec-WebSocket-Version
+    std::string_view authorization;
+    bool upgrade = false;       // Upgrade: websocket and Connection: upgrade
+    size_t headerBytes = 0;     // Request line and headers, through the blank line
+};
+
+enum class ParseResult { Complete, NeedMore, Malformed };
+
+namespace detail {
+
+inline char lower(char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c; }
+
+inline bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (lower(a[i]) != lower(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * True if the comma-separated header value lists token (case-insensitive),
+ * e.g. "keep-alive, Upgrade" has "upgrade".
+ */
+inline bool hasToken(std::string_view value, std::string_view token) {
+    while (!value.empty()) {
+        const size_t comma = value.find(',');
+        std::string_view item = value.substr(0, comma);
+        while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) {
+            item.remove_prefix(1);
+        }
+        while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) {
+            item.remove_suffix(1);
+        }
+        if (equalsIgnoreCase(item, token)) {
+            return true;
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        value.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+}  // namespace detail
+
+/**
+ * Parse a request head from the first n received bytes; NeedMore until the
+ * blank line has arrived (Malformed past MAX_REQUEST_BYTES).
+ */
+inline ParseResult parseRequest(const char* p, size_t n, Request& out) {
+    const std::string_view text(p, n);
+    const size_t end = text.find("\r\n\r\n");
+    if (end == std::string_view::npos) {
+        return n > MAX_REQUEST_BYTES ? ParseResult::Malformed : ParseResult::NeedMore;
+    }
+    out = Request();
+    out.headerBytes = end + 4;
+
+    size_t lineEnd = text.find("\r\n");
+    const std::string_view requestLine = text.substr(0, lineEnd);
+    const size_t sp1 = requestLine.find(' ');
+    const size_t sp2 = requestLine.rfind(' ');
+    if (sp1 == std::string_view::npos || sp2 <= sp1 + 1 || requestLine.substr(sp2 + 1, 5) != "HTTP/") {
+        return ParseResult::Malformed;
+    }
+    out.method = requestLine.substr(0, sp1);
+    const std::string_view target = requestLine.substr(sp1 + 1, sp2 - sp1 - 1);
+    const size_t question = target.find('?');
+    out.path = target.substr(0, question);
+    if (question != std::string_view::npos) {
+        out.query = target.substr(question + 1);
+    }
+
+    bool upgradeHeader = false;
+    bool connectionUpgrade = false;
+    size_t at = lineEnd + 2;
+    while (at < end) {
+        lineEnd = text.find("\r\n", at);
+        const std::string_view line = text.substr(at, lineEnd - at);
+        at = lineEnd + 2;
+        const size_t colon = line.find(':');
+        if (colon == std::string_view::npos || colon == 0) {
+            return ParseResult::Malformed;
+        }
+        const std::string_view name = line.substr(0, colon);
+        std::string_view value = line.substr(colon + 1);
+        while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+            value.remove_prefix(1);
+        }
+        while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+            value.remove_suffix(1);
+        }
+        if (detail::equalsIgnoreCase(name, "upgrade")) {
+            upgradeHeader = detail::hasToken(value, "websocket");
+        } else if (detail::equalsIgnoreCase(name, "connection")) {
+            connectionUpgrade = detail::hasToken(value, "upgrade");
+        } else if (detail::equalsIgnoreCase(name, "sec-websocket-key")) {
+            out.key = value;
+        } else if (detail::equalsIgnoreCase(name, "sec-websocket-version")) {
+            out.version = value;
+        } else if (detail::equalsIgnoreCase(name, "authorization")) {
+            out.authorization = value;
+        }
+    }
+    out.upgrade = upgradeHeader && connectionUpgrade;
+    return ParseResult::Complete;
+}
+
+/**
+ * The 101 response completing a handshake.
+ */
+inline std::string acceptResponse(std::string_view key) {
+    std::string out =
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: ";
+    out += acceptKey(key);
+    out += "\r\n\r\n";
+    return out;
+}
+
+/**
+ * A plain HTTP response that closes the connection.
+ */
+inline std::string httpResponse(int status, const char* reason, std::string_view contentType, std::string_view body,
+                                std::string_view extraHeaders = {}) {
+    std::string out = "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n";
+    out += "Content-Type: ";
+    out += contentType;
+    out += "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n";
+    out += extraHeaders;
+    out += "Connection: close\r\n\r\n";
+    out += body;
+    return out;
+}
+
+// ==========================================
+// Frames
+// ==========================================
+
+/**
+ * Append an unmasked, final frame header for a payload of n bytes; the
+ * payload follows it in the caller's buffer.
+ */
+inline void encodeFrameHeader(std::vector<uint8_t>& out, uint8_t opcode, uint64_t n) {
+    out.push_back(static_cast<uint8_t>(0x80 | opcode));
+    if (n < 126) {
+        out.push_back(static_cast<uint8_t>(n));
+    } else if (n <= 0xFFFF) {
+        out.push_back(126);
+        out.push_back(static_cast<uint8_t>(n >> 8));
+        out.push_back(static_cast<uint8_t>(n));
+    } else {
+        out.push_back(127);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            out.push_back(static_cast<uint8_t>(n >> shift));
+        }
+    }
+}
+
+inline void encodeFrame(std::vector<uint8_t>& out, uint8_t opcode, const void* payload, size_t n) {
+    encodeFrameHeader(out, opcode, n);
+    const uint8_t* p = static_cast<const uint8_t*>(payload);
+    out.insert(out.end(), p, p + n);
+}
+
+inline void encodeClose(std::vector<uint8_t>& out, uint16_t code) {
+    const uint8_t payload[2] = {static_cast<uint8_t>(code >> 8), static_cast<uint8_t>(code)};
+    encodeFrame(out, OP_CLOSE, payload, sizeof(payload));
+}
+
+struct Frame {
+    bool fin;
+    uint8_t opcode;
+    const uint8_t* payload;  // Unmasked in place; valid until the next append/commit
+    size_t length;
+};
+
+/**
+ * Frames client frames out of a TCP byte stream, in the MqttReader style:
+ * append or writableTail()/commit(), then next() until NeedMore.
+ *
+ * Malformed covers unmasked frames, reserved bits, oversized payloads and
+ * fragmented or oversized control frames.
+ */
+class FrameReader {
+public:
+    enum class Result { Frame, NeedMore, Malformed };
+
+    explicit FrameReader(size_t maxPayload) : maxPayload_(maxPayload) {}
+
+    uint8_t* writableTail(size_t want) {
+        compact();
+        buffer_.resize(end_ + want);
+        return buffer_.data() + end_;
+    }
+
+    void commit(size_t n) { end_ += n; }
+
+    void append(const uint8_t* data, size_t n) {
+        memcpy(writableTail(n), data, n);
+        commit(n);
+    }
+
+    Result next(Frame& out) {
+        const size_t available = end_ - start_;
+        if (available < 2) {
+            return Result::NeedMore;
+        }
+        uint8_t* p = buffer_.data() + start_;
+        const bool fin = (p[0] & 0x80) != 0;
+        const uint8_t opcode = p[0] & 0x0F;
+        if ((p[0] & 0x70) != 0 || !(p[1] & 0x80)) {
+            return Result::Malformed;  // Extension bits, or an unmasked client frame
+        }
+        uint64_t length = p[1] & 0x7F;
+        size_t header = 2;
+        if (length == 126) {
+            if (available < 4) {
+                return Result::NeedMore;
+            }
+            length = (static_cast<uint64_t>(p[2]) << 8) | p[3];
+            header = 4;
+        } else if (length == 127) {
+            if (available < 10) {
+                return Result::NeedMore;
+            }
+            length = 0;
+            for (int i = 0; i < 8; i++) {
+                length = (length << 8) | p[2 + i];
+            }
+            header = 10;
+        }
+        if (opcode >= OP_CLOSE && (!fin || length > MAX_CONTROL_PAYLOAD)) {
+            return Result::Malformed;
+        }
+        if (length > maxPayload_) {
+            return Result::Malformed;
+        }
+        if (available < header + 4 + length) {
+            return Result::NeedMore;
+        }
+        const uint8_t* mask = p + header;
+        uint8_t* payload = p + header + 4;
+        for (size_t i = 0; i < length; i++) {
+            payload[i] ^= mask[i & 3];
+        }
+        out.fin = fin;
+        out.opcode = opcode;
+        out.payload = payload;
+        out.length = static_cast<size_t>(length);
+        start_ += header + 4 + static_cast<size_t>(length);
+        return Result::Frame;
+    }
+
+    /** Bytes received but not yet returned as frames (the handshake reads them). */
+    const uint8_t* pendingData() const { return buffer_.data() + start_; }
+    size_t pendingSize() const { return end_ - start_; }
+    void discard(size_t n) { start_ += n; }
+
+    void reset() { start_ = end_ = 0; }
+
+private:
+    void compact() {
+        if (start_ == 0) {
+            return;
+        }
+        if (start_ == end_) {
+            start_ = end_ = 0;
+            return;
+        }
+        memmove(buffer_.data(), buffer_.data() + start_, end_ - start_);
+        end_ -= start_;
+        start_ = 0;
+    }
+
+    size_t maxPayload_;
+    std::vector<uint8_t> buffer_;
+    size_t start_ = 0;
+    size_t end_ = 0;
+};
+
+}  // namespace ws
+}  // namespace pulsemind
+
+#endif  // PULSEMIND_WEBSOCKET_H
@@ -0,0 +1,1104 @@
+/**
+ * PulseMind live hub: one broker subscription, any number of dashboard
+ * viewers.
+ *
+ *   pulsemind/sensor/ppg, pulsemind/pacing/command/# --(one connection)-->
+ *       LiveHub (per device: sample ring, rate, newest command)
+ *       --(every --tick-ms)--> WebSocket viewers: ws://host:8765/live?devices=a,b
+ *
+ * Before the hub each dashboard session opened its own MQTT client, so
+ * broker subscriptions and per-frame work grew with sessions x devices.
+ * Here the broker sees one client however many viewers there are, and a
+ * frame costs one ring append.
+ *
+ * Viewers get one JSON message per tick at most, holding every change to
+ * their devices since their last message (LiveHub.h has the format). A
+ * viewer whose socket has more than VIEWER_SOFT_LIMIT_BYTES unsent skips
+ * ticks, so its updates coalesce into fewer, larger messages instead of
+ * queueing without bound; past a ring's worth of lag it gets a reset. A
+ * viewer that accepts nothing for VIEWER_STALL_TIMEOUT_MS is disconnected.
+ *
+ * Viewers only send control frames; the subscription is the URL. With
+ * PULSEMIND_LIVE_HUB_TOKEN set, upgrades need "Authorization: Bearer
+ * <token>". GET /health answers with the hub's status.
+ *
+ * Usage:
+ *   live_hub [--host H] [--port P] [--listen PORT] [--tick-ms MS] [--ring N]
+ *            [--client-id ID] [--keepalive SEC] [--stats-interval SEC]
+ *   live_hub --bench VIEWERS [--bench-devices N] [--bench-seconds S] [--tick-ms MS]
+ *
+ * Defaults come from MQTT_HOST, MQTT_PORT, PULSEMIND_LIVE_HUB_LISTEN,
+ * PULSEMIND_LIVE_HUB_TICK_MS and PULSEMIND_LIVE_HUB_TOKEN.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "IngestFrame.h"
+#include "LiveHub.h"
+#include "MqttCodec.h"
+#include "WebSocket.h"
+
+using namespace pulsemind;
+
+namespace {
+
+// ==========================================
+// Configuration
+// ==========================================
+constexpr const char* SENSOR_TOPIC = "pulsemind/sensor/ppg";       // Firmware TOPIC_SENSOR_DATA
+constexpr const char* COMMAND_TOPIC = "pulsemind/pacing/command";  // Firmware TOPIC_PACING_CMD
+constexpr const char* COMMAND_FILTER = "pulsemind/pacing/command/#";
+constexpr const char* LIVE_PATH = "/live";
+constexpr const char* HEALTH_PATH = "/health";
+
+constexpr uint32_t MAX_PACKET_SIZE = 256 * 1024;
+constexpr size_t MAX_VIEWER_FRAME = 4 * 1024;              // Viewers only send control frames
+constexpr size_t VIEWER_SOFT_LIMIT_BYTES = 256 * 1024;     // Unsent bytes at which a viewer skips ticks
+constexpr size_t VIEWER_MAX_BYTES = 8 * 1024 * 1024;       // Unsent bytes at which it is dropped
+constexpr uint64_t VIEWER_STALL_TIMEOUT_MS = 30 * 1000;    // Unsent bytes and no progress: dropped
+constexpr int VIEWER_SNDBUF_BYTES = 128 * 1024;             // Kernel buffer; caps stale data queued below the hub
+constexpr uint64_t HANDSHAKE_TIMEOUT_MS = 10 * 1000;       // Accepted socket to upgrade request
+constexpr int64_t DEVICE_IDLE_TIMEOUT_US = 5 * 60 * 1000 * 1000ll;
+constexpr uint64_t SWEEP_INTERVAL_MS = 10 * 1000;
+constexpr uint64_t RECONNECT_MIN_MS = 500;
+constexpr uint64_t RECONNECT_MAX_MS = 10 * 1000;
+
+struct Config {
+    std::string host = "localhost";
+    int port = 1883;
+    int listenPort = 8765;  // 0 picks a free port
+    std::string clientId;
+    std::string token;      // Bearer token viewers must present (empty: none)
+    unsigned keepaliveSec = 30;
+    unsigned tickMs = 50;
+    unsigned ringSamples = DEFAULT_RING_SAMPLES;
+    unsigned statsIntervalSec = 10;
+    unsigned benchViewers = 0;
+    unsigned benchDevices = 100;
+    unsigned benchSeconds = 10;
+};
+
+uint64_t nowMs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+}
+
+int64_t wallUs() {
+    return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                    std::chrono::system_clock::now().time_since_epoch())
+                                    .count());
+}
+
+std::atomic<bool> g_stop{false};
+
+void onSignal(int) { g_stop.store(true); }
+
+// ==========================================
+// Broker Connection
+// ==========================================
+
+/**
+ * The hub's one MQTT client: subscribes to sensor frames and pacing
+ * commands for every device and feeds them to the LiveHub.
+ */
+class BrokerLink {
+public:
+    enum class State { Idle, Connecting, AwaitConnack, Subscribing, Ready };
+
+    BrokerLink(const Config& config, int epollFd, LiveHub& hub)
+        : config_(config), epollFd_(epollFd), hub_(hub), reader_(MAX_PACKET_SIZE) {}
+
+    ~BrokerLink() { closeSocket(); }
+
+    bool ready() const { return state_ == State::Ready; }
+
+    /**
+     * Start a non-blocking connect if the link is down and its backoff has
+     * elapsed.
+     */
+    void maybeConnect(uint64_t now) {
+        if (state_ != State::Idle || now < reconnectAtMs_) {
+            return;
+        }
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addrs = nullptr;
+        const std::string port = std::to_string(config_.port);
+        if (getaddrinfo(config_.host.c_str(), port.c_str(), &hints, &addrs) != 0 || addrs == nullptr) {
+            fprintf(stderr, "live_hub: cannot resolve %s\n", config_.host.c_str());
+            scheduleReconnect(now);
+            return;
+        }
+        fd_ = socket(addrs->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd_ < 0) {
+            freeaddrinfo(addrs);
+            scheduleReconnect(now);
+            return;
+        }
+        const int one = 1;
+        setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        const int rc = connect(fd_, addrs->ai_addr, addrs->ai_addrlen);
+        freeaddrinfo(addrs);
+        if (rc < 0 && errno != EINPROGRESS) {
+            closeSocket();
+            scheduleReconnect(now);
+            return;
+        }
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLOUT;
+        ev.data.ptr = this;
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd_, &ev);
+        state_ = State::Connecting;
+        lastRecvMs_ = lastSendMs_ = now;
+    }
+
+    void onEvent(uint32_t events, uint64_t now) {
+        if (events & (EPOLLERR | EPOLLHUP)) {
+            fail(now, "connection lost");
+            return;
+        }
+        if (state_ == State::Connecting && (events & EPOLLOUT)) {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(fd_, SOL_SOCKET, SO_ERROR, &err, &len);
+            if (err != 0) {
+                fail(now, strerror(err));
+                return;
+            }
+            mqtt::encodeConnect(out_, config_.clientId, static_cast<uint16_t>(config_.keepaliveSec));
+            state_ = State::AwaitConnack;
+        }
+        if (events & EPOLLIN) {
+            if (!readPackets(now)) {
+                return;
+            }
+        }
+        flushOut(now);
+    }
+
+    void tick(uint64_t now) {
+        if (state_ == State::Idle) {
+            return;
+        }
+        const uint64_t keepaliveMs = config_.keepaliveSec * 1000ull;
+        if (now - lastRecvMs_ > keepaliveMs + keepaliveMs / 2) {
+            fail(now, "keepalive timeout");
+            return;
+        }
+        if (state_ == State::Ready && now - lastSendMs_ >= keepaliveMs / 2) {
+            mqtt::encodePingreq(out_);
+            flushOut(now);
+        }
+    }
+
+    void disconnect() {
+        if (state_ == State::Ready) {
+            mqtt::encodeDisconnect(out_);
+            flushOut(nowMs());
+        }
+        closeSocket();
+    }
+
+private:
+    bool readPackets(uint64_t now) {
+        uint8_t* tail = reader_.writableTail(64 * 1024);
+        const ssize_t n = recv(fd_, tail, 64 * 1024, 0);
+        if (n == 0) {
+            fail(now, "closed by broker");
+            return false;
+        }
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                return true;
+            }
+            fail(now, strerror(errno));
+            return false;
+        }
+        reader_.commit(static_cast<size_t>(n));
+        lastRecvMs_ = now;
+
+        mqtt::Packet packet;
+        mqtt::MqttReader::Result result;
+        while ((result = reader_.next(packet)) == mqtt::MqttReader::Result::Packet) {
+            if (!handle(packet, now)) {
+                return false;
+            }
+        }
+        if (result == mqtt::MqttReader::Result::Malformed) {
+            fail(now, "malformed packet");
+            return false;
+        }
+        return true;
+    }
+
+    bool handle(const mqtt::Packet& packet, uint64_t now) {
+        switch (packet.type) {
+            case mqtt::PUBLISH: {
+                mqtt::Publish pub = {};
+                if (!mqtt::parsePublish(packet, pub)) {
+                    fail(now, "malformed publish");
+                    return false;
+                }
+                if (pub.qos == 1) {
+                    mqtt::encodePuback(out_, pub.packetId);
+                }
+                route(std::string_view(pub.topic, pub.topicLen), pub.payload, pub.payloadLen);
+                return true;
+            }
+            case mqtt::CONNACK:
+                if (packet.length < 2 || packet.body[1] != 0) {
+                    fail(now, "connection refused");
+                    return false;
+                }
+                mqtt::encodeSubscribe(out_, 1, SENSOR_TOPIC, 0);
+                mqtt::encodeSubscribe(out_, 2, COMMAND_FILTER, 0);
+                subacks_ = 0;
+                state_ = State::Subscribing;
+                return true;
+            case mqtt::SUBACK:
+                if (packet.length < 3 || packet.body[2] == mqtt::SUBACK_FAILURE) {
+                    fail(now, "subscription refused");
+                    return false;
+                }
+                if (++subacks_ == 2) {
+                    state_ = State::Ready;
+                    backoffMs_ = RECONNECT_MIN_MS;
+                    fprintf(stderr, "live_hub: %s subscribed to %s and %s\n", config_.clientId.c_str(),
+                            SENSOR_TOPIC, COMMAND_FILTER);
+                }
+                return true;
+            default:
+                return true;  // PINGRESP
+        }
+    }
+
+    void route(std::string_view topic, const uint8_t* payload, size_t n) {
+        const int64_t now = wallUs();
+        if (topic == SENSOR_TOPIC) {
+            hub_.onSensorFrame(payload, n, now);
+            return;
+        }
+        const std::string_view command(COMMAND_TOPIC);
+        if (topic.substr(0, command.size()) != command) {
+            return;
+        }
+        std::string_view deviceId = DEFAULT_DEVICE_ID;  // Firmware's device-less topic
+        if (topic.size() > command.size()) {
+            if (topic[command.size()] != '/') {
+                return;
+            }
+            deviceId = topic.substr(command.size() + 1);
+        }
+        hub_.onCommand(deviceId, reinterpret_cast<const char*>(payload), n, now);
+    }
+
+    void flushOut(uint64_t now) {
+        while (fd_ >= 0 && state_ != State::Connecting && sent_ < out_.size()) {
+            const ssize_t n = send(fd_, out_.data() + sent_, out_.size() - sent_, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    fail(now, strerror(errno));
+                    return;
+                }
+                break;
+            }
+            sent_ += static_cast<size_t>(n);
+            lastSendMs_ = now;
+        }
+        if (sent_ == out_.size()) {
+            out_.clear();
+            sent_ = 0;
+        }
+        if (fd_ >= 0) {
+            epoll_event ev = {};
+            ev.events = EPOLLIN | ((state_ == State::Connecting || !out_.empty()) ? EPOLLOUT : 0u);
+            ev.data.ptr = this;
+            epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd_, &ev);
+        }
+    }
+
+    void fail(uint64_t now, const char* reason) {
+        fprintf(stderr, "live_hub: %s: %s, reconnecting\n", config_.clientId.c_str(), reason);
+        closeSocket();
+        scheduleReconnect(now);
+    }
+
+    void scheduleReconnect(uint64_t now) {
+        state_ = State::Idle;
+        reconnectAtMs_ = now + backoffMs_;
+        backoffMs_ = std::min(backoffMs_ * 2, RECONNECT_MAX_MS);
+    }
+
+    void closeSocket() {
+        if (fd_ >= 0) {
+            epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd_, nullptr);
+            close(fd_);
+            fd_ = -1;
+        }
+        state_ = State::Idle;
+        reader_.reset();
+        out_.clear();
+        sent_ = 0;
+    }
+
+    const Config& config_;
+    int epollFd_;
+    LiveHub& hub_;
+    int fd_ = -1;
+    State state_ = State::Idle;
+    unsigned subacks_ = 0;
+    mqtt::MqttReader reader_;
+    std::vector<uint8_t> out_;
+    size_t sent_ = 0;
+    uint64_t lastRecvMs_ = 0;
+    uint64_t lastSendMs_ = 0;
+    uint64_t reconnectAtMs_ = 0;
+    uint64_t backoffMs_ = RECONNECT_MIN_MS;
+};
+
+// ==========================================
+// WebSocket Viewers
+// ==========================================
+
+struct ViewerConn {
+    enum class State { Handshake, Open, Closing };
+
+    explicit ViewerConn(int socketFd) : fd(socketFd), reader(MAX_VIEWER_FRAME) {}
+
+    size_t pending() const { return out.size() - sent; }
+
+    int fd;
+    State state = State::Handshake;
+    ws::FrameReader reader;
+    std::vector<uint8_t> out;
+    size_t sent = 0;
+    Viewer viewer;
+    uint64_t acceptedMs = 0;
+    uint64_t progressMs = 0;  // Last time the socket took bytes (or had none pending)
+    bool wantWrite = false;
+    bool dirty = false;
+    bool closed = false;
+};
+
+struct ViewerStats {
+    uint64_t accepted;
+    uint64_t upgraded;
+    uint64_t refused;   // Non-upgrade, bad or unauthorized requests
+    uint64_t skipped;   // Ticks a viewer sat out with VIEWER_SOFT_LIMIT_BYTES unsent
+    uint64_t dropped;   // Stalled, overflowing or protocol-violating viewers
+    uint64_t bytesOut;
+};
+
+/**
+ * Constant-time comparison, for the bearer token.
+ */
+bool sameSecret(std::string_view a, std::string_view b) {
+    unsigned char diff = a.size() == b.size() ? 0 : 1;
+    for (size_t i = 0; i < a.size(); i++) {
+        diff |= static_cast<unsigned char>(a[i] ^ (i < b.size() ? b[i] : 0));
+    }
+    return diff == 0;
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/**
+ * Device ids from devices=a,b (or repeated device=a) in a query string;
+ * false if a value does not percent-decode.
+ */
+bool queryDevices(std::string_view query, std::vector<std::string>& out) {
+    while (!query.empty()) {
+        const size_t amp = query.find('&');
+        const std::string_view pair = query.substr(0, amp);
+        query = amp == std::string_view::npos ? std::string_view() : query.substr(amp + 1);
+        const size_t eq = pair.find('=');
+        const std::string_view name = pair.substr(0, eq);
+        if (eq == std::string_view::npos || (name != "devices" && name != "device")) {
+            continue;
+        }
+        std::string value;
+        const std::string_view raw = pair.substr(eq + 1);
+        for (size_t i = 0; i < raw.size(); i++) {
+            if (raw[i] == '%') {
+                if (i + 2 >= raw.size() || hexValue(raw[i + 1]) < 0 || hexValue(raw[i + 2]) < 0) {
+                    return false;
+                }
+                value.push_back(static_cast<char>(hexValue(raw[i + 1]) * 16 + hexValue(raw[i + 2])));
+                i += 2;
+            } else {
+                value.push_back(raw[i]);
+            }
+        }
+        size_t start = 0;
+        while (start <= value.size()) {
+            const size_t comma = std::min(value.find(',', start), value.size());
+            if (comma > start) {
+                out.push_back(value.substr(start, comma - start));
+            }
+            start = comma + 1;
+        }
+    }
+    return true;
+}
+
+class ViewerServer {
+public:
+    ViewerServer(const Config& config, int epollFd, LiveHub& hub) : config_(config), epollFd_(epollFd), hub_(hub) {}
+
+    ~ViewerServer() {
+        for (auto& entry : viewers_) {
+            hub_.release(entry.second->viewer);
+            close(entry.first);
+        }
+        if (listenFd_ >= 0) {
+            close(listenFd_);
+        }
+    }
+
+    /**
+     * Bind and register the listener; returns the bound port or -1.
+     */
+    int listen() {
+        listenFd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd_ < 0) {
+            perror("live_hub: socket");
+            return -1;
+        }
+        const int one = 1;
+        setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(static_cast<uint16_t>(config_.listenPort));
+        socklen_t len = sizeof(addr);
+        if (bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(listenFd_, 1024) < 0 ||
+            getsockname(listenFd_, reinterpret_cast<sockaddr*>(&addr), &len) < 0) {
+            perror("live_hub: listen");
+            return -1;
+        }
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.ptr = this;
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, listenFd_, &ev);
+        return ntohs(addr.sin_port);
+    }
+
+    size_t viewers() const { return viewers_.size(); }
+    const ViewerStats& stats() const { return stats_; }
+    void setBrokerReady(bool ready) { brokerReady_ = ready; }
+
+    void onAccept(uint64_t now) {
+        for (;;) {
+            const int fd = accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    perror("live_hub: accept");
+                }
+                return;
+            }
+            const int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            // Without a cap the kernel autotunes to megabytes of stale frames
+            // before the soft limit ever sees backpressure
+            const int sndbuf = VIEWER_SNDBUF_BYTES;
+            setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+            auto conn = std::make_unique<ViewerConn>(fd);
+            conn->acceptedMs = conn->progressMs = now;
+            epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.ptr = conn.get();
+            epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev);
+            viewers_.emplace(fd, std::move(conn));
+            stats_.accepted++;
+        }
+    }
+
+    void onEvent(ViewerConn& c, uint32_t events, uint64_t now) {
+        if (c.closed) {
+            return;
+        }
+        if (events & (EPOLLERR | EPOLLHUP)) {
+            drop(c);
+            return;
+        }
+        if ((events & EPOLLIN) && c.state == ViewerConn::State::Closing) {
+            // Read and discard until the last bytes are out, or level-triggered
+            // epoll keeps reporting the socket
+            uint8_t scratch[4096];
+            if (recv(c.fd, scratch, sizeof(scratch), 0) == 0) {
+                drop(c);
+                return;
+            }
+        } else if (events & EPOLLIN) {
+            uint8_t* tail = c.reader.writableTail(16 * 1024);
+            const ssize_t n = recv(c.fd, tail, 16 * 1024, 0);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                drop(c);
+                return;
+            }
+            if (n > 0) {
+                c.reader.commit(static_cast<size_t>(n));
+                if (c.state == ViewerConn::State::Handshake) {
+                    handshake(c, now);
+                }
+                if (c.state == ViewerConn::State::Open) {
+                    readFrames(c);
+                }
+            }
+        }
+        if (events & EPOLLOUT) {
+            markDirty(c);
+        }
+    }
+
+    /**
+     * One fan-out round: a coalesced message for every viewer with changes
+     * and room in its socket.
+     */
+    void tick(int64_t wallNowUs) {
+        hub_.beginTick();
+        for (auto& entry : viewers_) {
+            ViewerConn& c = *entry.second;
+            if (c.closed || c.state != ViewerConn::State::Open) {
+                continue;
+            }
+            if (c.pending() >= VIEWER_SOFT_LIMIT_BYTES) {
+                stats_.skipped++;  // Its cursors stay put; the next message carries the backlog
+                continue;
+            }
+            if (!hub_.compose(c.viewer, wallNowUs, message_)) {
+                continue;
+            }
+            if (c.pending() + message_.size() > VIEWER_MAX_BYTES) {
+                stats_.dropped++;
+                drop(c);
+                continue;
+            }
+            ws::encodeFrame(c.out, ws::OP_TEXT, message_.data(), message_.size());
+            markDirty(c);
+        }
+    }
+
+    /**
+     * Write what every touched viewer has queued, then release closed ones.
+     */
+    void flush(uint64_t now) {
+        for (ViewerConn* c : dirty_) {
+            c->dirty = false;
+            if (!c->closed) {
+                flushViewer(*c, now);
+            }
+        }
+        dirty_.clear();
+        for (ViewerConn* c : closed_) {
+            release(*c);
+        }
+        closed_.clear();
+    }
+
+    /**
+     * Drop connections that never upgraded, and viewers whose socket has
+     * taken nothing for VIEWER_STALL_TIMEOUT_MS.
+     */
+    void expire(uint64_t now) {
+        for (auto& entry : viewers_) {
+            ViewerConn& c = *entry.second;
+            if (c.closed) {
+                continue;
+            }
+            if (c.state == ViewerConn::State::Handshake && now - c.acceptedMs > HANDSHAKE_TIMEOUT_MS) {
+                drop(c);
+            } else if (c.pending() > 0 && now - c.progressMs > VIEWER_STALL_TIMEOUT_MS) {
+                stats_.dropped++;
+                drop(c);
+            }
+        }
+    }
+
+    /**
+     * Ask every viewer to reconnect later (shutdown), best effort.
+     */
+    void goAway() {
+        std::vector<uint8_t> frame;
+        ws::encodeClose(frame, ws::CLOSE_GOING_AWAY);
+        for (auto& entry : viewers_) {
+            if (entry.second->state == ViewerConn::State::Open && entry.second->pending() == 0 &&
+                send(entry.first, frame.data(), frame.size(), MSG_NOSIGNAL) < 0) {
+                // Closing anyway
+            }
+        }
+    }
+
+private:
+    void handshake(ViewerConn& c, uint64_t now) {
+        ws::Request request;
+        const ws::ParseResult result = ws::parseRequest(reinterpret_cast<const char*>(c.reader.pendingData()),
+                                                        c.reader.pendingSize(), request);
+        if (result == ws::ParseResult::NeedMore) {
+            return;
+        }
+        if (result == ws::ParseResult::Malformed) {
+            refuse(c, 400, "Bad Request", "malformed request");
+            return;
+        }
+        if (request.method != "GET") {
+            refuse(c, 405, "Method Not Allowed", "GET only");
+            return;
+        }
+        if (request.path == HEALTH_PATH) {
+            respond(c, ws::httpResponse(200, "OK", "application/json", healthJson()));
+            return;
+        }
+        if (request.path != LIVE_PATH) {
+            refuse(c, 404, "Not Found", "unknown path");
+            return;
+        }
+        if (!request.upgrade || request.key.size() != 24) {
+            refuse(c, 400, "Bad Request", "WebSocket upgrade required");
+            return;
+        }
+        if (request.version != "13") {
+            respond(c, ws::httpResponse(426, "Upgrade Required", "text/plain", "WebSocket version 13 only\n",
+                                        "Sec-WebSocket-Version: 13\r\n"));
+            stats_.refused++;
+            return;
+        }
+        if (!config_.token.empty() && !sameSecret(request.authorization, "Bearer " + config_.token)) {
+            refuse(c, 401, "Unauthorized", "bearer token required");
+            return;
+        }
+        std::vector<std::string> devices;
+        if (!queryDevices(request.query, devices) || devices.empty()) {
+            refuse(c, 400, "Bad Request", "devices=<id>[,<id>...] required");
+            return;
+        }
+        const int64_t wallNow = wallUs();
+        for (const std::string& id : devices) {
+            if (!hub_.subscribe(c.viewer, id, wallNow)) {
+                hub_.release(c.viewer);
+                refuse(c, 400, "Bad Request", "invalid device id, or too many devices");
+                return;
+            }
+        }
+        const std::string response = ws::acceptResponse(request.key);
+        c.reader.discard(request.headerBytes);
+        c.out.insert(c.out.end(), response.begin(), response.end());
+        c.state = ViewerConn::State::Open;
+        c.progressMs = now;
+        stats_.upgraded++;
+        markDirty(c);
+    }
+
+    void readFrames(ViewerConn& c) {
+        ws::Frame frame;
+        ws::FrameReader::Result result;
+        while (c.state == ViewerConn::State::Open &&
+               (result = c.reader.next(frame)) == ws::FrameReader::Result::Frame) {
+            if (frame.opcode == ws::OP_PING) {
+                ws::encodeFrame(c.out, ws::OP_PONG, frame.payload, frame.length);
+                markDirty(c);
+            } else if (frame.opcode == ws::OP_CLOSE) {
+                // Echo the status code, then close once it is out
+                ws::encodeFrame(c.out, ws::OP_CLOSE, frame.payload, frame.length >= 2 ? 2 : 0);
+                c.state = ViewerConn::State::Closing;
+                markDirty(c);
+            }
+            // Data frames carry nothing for the hub; pongs need no answer
+        }
+        if (c.state == ViewerConn::State::Open && result == ws::FrameReader::Result::Malformed) {
+            ws::encodeClose(c.out, ws::CLOSE_PROTOCOL_ERROR);
+            c.state = ViewerConn::State::Closing;
+            stats_.dropped++;
+            markDirty(c);
+        }
+    }
+
+    std::string healthJson() const {
+        const LiveHub::Stats& s = hub_.stats();
+        char body[256];
+        snprintf(body, sizeof(body),
+                 "{\"status\":\"%s\",\"service\":\"live-hub\",\"broker_connected\":%s,\"viewers\":%zu,"
+                 "\"devices\":%zu,\"frames\":%" PRIu64 "}",
+                 brokerReady_ ? "healthy" : "degraded", brokerReady_ ? "true" : "false", viewers_.size(),
+                 hub_.devices(), s.frames);
+        return body;
+    }
+
+    void refuse(ViewerConn& c, int status, const char* reason, const char* detail) {
+        stats_.refused++;
+        respond(c, ws::httpResponse(status, reason, "text/plain", std::string(detail) + "\n"));
+    }
+
+    /** Send a plain HTTP response and close once it is out. */
+    void respond(ViewerConn& c, const std::string& response) {
+        c.out.insert(c.out.end(), response.begin(), response.end());
+        c.state = ViewerConn::State::Closing;
+        markDirty(c);
+    }
+
+    void markDirty(ViewerConn& c) {
+        if (!c.dirty) {
+            c.dirty = true;
+            dirty_.push_back(&c);
+        }
+    }
+
+    void flushViewer(ViewerConn& c, uint64_t now) {
+        while (c.pending() > 0) {
+            const ssize_t n = send(c.fd, c.out.data() + c.sent, c.pending(), MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    drop(c);
+                    return;
+                }
+                break;
+            }
+            c.sent += static_cast<size_t>(n);
+            c.progressMs = now;
+            stats_.bytesOut += static_cast<uint64_t>(n);
+        }
+        if (c.pending() == 0) {
+            c.out.clear();
+            c.sent = 0;
+            c.progressMs = now;
+            if (c.state == ViewerConn::State::Closing) {
+                drop(c);
+                return;
+            }
+        } else if (c.sent >= 64 * 1024 && c.sent >= c.out.size() / 2) {
+            c.out.erase(c.out.begin(), c.out.begin() + static_cast<std::ptrdiff_t>(c.sent));
+            c.sent = 0;
+        }
+        const bool pending = c.pending() > 0;
+        if (pending != c.wantWrite) {
+            c.wantWrite = pending;
+            epoll_event ev = {};
+            ev.events = EPOLLIN | (pending ? EPOLLOUT : 0u);
+            ev.data.ptr = &c;
+            epoll_ctl(epollFd_, EPOLL_CTL_MOD, c.fd, &ev);
+        }
+    }
+
+    /**
+     * Stop serving a connection; it is released after this iteration's flush.
+     */
+    void drop(ViewerConn& c) {
+        if (c.closed) {
+            return;
+        }
+        c.closed = true;
+        closed_.push_back(&c);
+    }
+
+    void release(ViewerConn& c) {
+        hub_.release(c.viewer);
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, c.fd, nullptr);
+        close(c.fd);
+        viewers_.erase(c.fd);  // Destroys c
+    }
+
+    const Config& config_;
+    int epollFd_;
+    LiveHub& hub_;
+    int listenFd_ = -1;
+    bool brokerReady_ = false;
+    std::unordered_map<int, std::unique_ptr<ViewerConn>> viewers_;
+    std::vector<ViewerConn*> dirty_;
+    std::vector<ViewerConn*> closed_;
+    std::string message_;
+    ViewerStats stats_ = {};
+};
+
+void printStats(const char* prefix, const LiveHub& hub, const ViewerServer& server) {
+    const LiveHub::Stats& h = hub.stats();
+    const ViewerStats& v = server.stats();
+    fprintf(stderr,
+            "%s devices=%zu frames=%" PRIu64 " rejected=%" PRIu64 " samples=%" PRIu64 " commands=%" PRIu64
+            " viewers=%zu upgraded=%" PRIu64 " refused=%" PRIu64 " messages=%" PRIu64 " updates=%" PRIu64
+            " encodes=%" PRIu64 " resets=%" PRIu64 " skipped=%" PRIu64 " dropped=%" PRIu64 " bytes_out=%" PRIu64 "\n",
+            prefix, hub.devices(), h.frames, h.badFrames + h.badCommands, h.samples, h.commands, server.viewers(),
+            v.upgraded, v.refused, h.messages, h.updates, h.encodes, h.resets, v.skipped, v.dropped, v.bytesOut);
+}
+
+int runHub(const Config& config) {
+    const int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        perror("live_hub: epoll_create1");
+        return 1;
+    }
+    LiveHub hub(config.ringSamples);
+    BrokerLink link(config, epollFd, hub);
+    ViewerServer server(config, epollFd, hub);
+    const int port = server.listen();
+    if (port < 0) {
+        close(epollFd);
+        return 1;
+    }
+    fprintf(stderr, "live_hub: listening on port %d, broker %s:%d, tick %u ms\n", port, config.host.c_str(),
+            config.port, config.tickMs);
+
+    std::vector<epoll_event> events(256);
+    uint64_t nextTick = nowMs() + config.tickMs;
+    uint64_t lastStats = nowMs();
+    uint64_t lastExpire = lastStats;
+    uint64_t lastSweep = lastStats;
+    while (!g_stop.load()) {
+        link.maybeConnect(nowMs());
+        const uint64_t before = nowMs();
+        const int timeout = nextTick > before ? static_cast<int>(std::min<uint64_t>(nextTick - before, 1000)) : 0;
+        const int n = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), timeout);
+        if (n < 0 && errno != EINTR) {
+            perror("live_hub: epoll_wait");
+            break;
+        }
+        const uint64_t now = nowMs();
+        for (int i = 0; i < n; i++) {
+            void* ptr = events[i].data.ptr;
+            if (ptr == &link) {
+                link.onEvent(events[i].events, now);
+            } else if (ptr == &server) {
+                server.onAccept(now);
+            } else {
+                server.onEvent(*static_cast<ViewerConn*>(ptr), events[i].events, now);
+            }
+        }
+        server.setBrokerReady(link.ready());
+        if (now >= nextTick) {
+            server.tick(wallUs());
+            link.tick(now);
+            // Late ticks are not made up: the next message coalesces them
+            nextTick = std::max(nextTick + config.tickMs, now + 1);
+        }
+        if (now - lastExpire >= 1000) {
+            server.expire(now);
+            lastExpire = now;
+        }
+        server.flush(now);
+        if (now - lastSweep >= SWEEP_INTERVAL_MS) {
+            hub.sweep(wallUs(), DEVICE_IDLE_TIMEOUT_US);
+            lastSweep = now;
+        }
+        if (config.statsIntervalSec > 0 && now - lastStats >= config.statsIntervalSec * 1000ull) {
+            printStats("live_hub:", hub, server);
+            lastStats = now;
+        }
+    }
+    server.goAway();
+    link.disconnect();
+    close(epollFd);
+    printStats("live_hub: final", hub, server);
+    return 0;
+}
+
+/**
+ * Fan synthetic devices out to in-process viewers (no sockets) as fast as
+ * it goes, and report the hub's cost per tick and per viewer.
+ */
+int runBench(const Config& config) {
+    constexpr unsigned SAMPLES_PER_FRAME = 10;  // 10-sample frames at 100 Hz, as the firmware sends
+    constexpr double SAMPLE_RATE = 100.0;
+    constexpr double PI = 3.14159265358979323846;
+
+    LiveHub hub(config.ringSamples);
+    const int64_t start = wallUs();
+    std::vector<std::string> ids;
+    for (unsigned d = 0; d < config.benchDevices; d++) {
+        ids.push_back("bench-" + std::to_string(d));
+    }
+    std::vector<Viewer> viewers(config.benchViewers);
+    for (unsigned v = 0; v < config.benchViewers; v++) {
+        hub.subscribe(viewers[v], ids[v % ids.size()], start);
+    }
+
+    const uint64_t tickUs = config.tickMs * 1000ull;
+    const uint64_t frameUs = static_cast<uint64_t>(SAMPLES_PER_FRAME / SAMPLE_RATE * 1e6);
+    const uint64_t ticks = config.benchSeconds * 1000000ull / tickUs;
+    std::vector<uint64_t> nextFrameUs(ids.size());
+    for (size_t d = 0; d < ids.size(); d++) {
+        nextFrameUs[d] = d * frameUs / ids.size();  // Spread devices over the frame period
+    }
+    std::string frame;
+    std::string message;
+    std::vector<uint8_t> wire;
+    uint64_t seq = 0;
+    uint64_t wireBytes = 0;
+    double ingestSec = 0;
+    double fanoutSec = 0;
+    for (uint64_t t = 1; t <= ticks; t++) {
+        const uint64_t tickEndUs = t * tickUs;
+        const auto t0 = std::chrono::steady_clock::now();
+        for (size_t d = 0; d < ids.size(); d++) {
+            while (nextFrameUs[d] < tickEndUs) {
+                frame = "{\"device_id\":\"" + ids[d] + "\",\"ts\":" + std::to_string(nextFrameUs[d] / 1000) +
+                        ",\"fs\":100,\"ppg\":[";
+                for (unsigned i = 0; i < SAMPLES_PER_FRAME; i++) {
+                    const double v = 2048 + 300 * std::sin(2 * PI * 1.2 * static_cast<double>(seq++) / SAMPLE_RATE);
+                    frame += (i ? "," : "") + std::to_string(static_cast<int>(v));
+                }
+                frame += "]}";
+                hub.onSensorFrame(reinterpret_cast<const uint8_t*>(frame.data()), frame.size(),
+                                  start + static_cast<int64_t>(nextFrameUs[d]));
+                nextFrameUs[d] += frameUs;
+            }
+        }
+        const auto t1 = std::chrono::steady_clock::now();
+        hub.beginTick();
+        for (Viewer& v : viewers) {
+            if (hub.compose(v, start + static_cast<int64_t>(tickEndUs), message)) {
+                wire.clear();
+                ws::encodeFrame(wire, ws::OP_TEXT, message.data(), message.size());
+                wireBytes += wire.size();
+            }
+        }
+        const auto t2 = std::chrono::steady_clock::now();
+        ingestSec += std::chrono::duration<double>(t1 - t0).count();
+        fanoutSec += std::chrono::duration<double>(t2 - t1).count();
+    }
+
+    const LiveHub::Stats& s = hub.stats();
+    const double simulated = static_cast<double>(ticks) * static_cast<double>(tickUs) / 1e6;
+    printf("live_hub bench: %u viewers over %u devices, %.0f s simulated at %u ms ticks\n", config.benchViewers,
+           config.benchDevices, simulated, config.tickMs);
+    printf("  ingest:  %" PRIu64 " frames in %.3f s (%.2f us/frame)\n", s.frames, ingestSec,
+           s.frames ? ingestSec * 1e6 / static_cast<double>(s.frames) : 0.0);
+    printf("  fan-out: %" PRIu64 " messages, %" PRIu64 " updates from %" PRIu64 " encodes, %.1f MB in %.3f s "
+           "(%.3f ms/tick, %.2f us/message)\n",
+           s.messages, s.updates, s.encodes, static_cast<double>(wireBytes) / 1e6, fanoutSec,
+           ticks ? fanoutSec * 1e3 / static_cast<double>(ticks) : 0.0,
+           s.messages ? fanoutSec * 1e6 / static_cast<double>(s.messages) : 0.0);
+    // A per-session client subscribes to the sensor topic, which carries every device
+    printf("  broker:  %" PRIu64 " deliveries (per-session clients: %" PRIu64 ")\n", s.frames,
+           s.frames * config.benchViewers);
+    printf("  load:    %.1f%% of one core in real time\n", (ingestSec + fanoutSec) / simulated * 100.0);
+    return 0;
+}
+
+unsigned envUnsigned(const char* name, unsigned fallback) {
+    const char* v = getenv(name);
+    return (v != nullptr && *v != '\0') ? static_cast<unsigned>(strtoul(v, nullptr, 10)) : fallback;
+}
+
+std::string envString(const char* name, const std::string& fallback) {
+    const char* v = getenv(name);
+    return (v != nullptr && *v != '\0') ? std::string(v) : fallback;
+}
+
+bool parseArgs(int argc, char** argv, Config& c) {
+    c.host = envString("MQTT_HOST", c.host);
+    c.port = static_cast<int>(envUnsigned("MQTT_PORT", static_cast<unsigned>(c.port)));
+    c.listenPort = static_cast<int>(envUnsigned("PULSEMIND_LIVE_HUB_LISTEN", static_cast<unsigned>(c.listenPort)));
+    c.tickMs = envUnsigned("PULSEMIND_LIVE_HUB_TICK_MS", c.tickMs);
+    c.token = envString("PULSEMIND_LIVE_HUB_TOKEN", c.token);
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            fprintf(stderr, "missing value for %s\n", arg.c_str());
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--host") {
+            c.host = value;
+        } else if (arg == "--port") {
+            c.port = atoi(value);
+        } else if (arg == "--listen") {
+            c.listenPort = atoi(value);
+        } else if (arg == "--tick-ms") {
+            c.tickMs = static_cast<unsigned>(strtoul(value, nullptr, 10));
+        } else if (arg == "--ring") {
+            c.ringSamples = static_cast<unsigned>(strtoul(value, nullptr, 10));
+        } else if (arg == "--client-id") {
+            c.clientId = value;
+        } else if (arg == "--keepalive") {
+            c.keepaliveSec = static_cast<unsigned>(strtoul(value, nullptr, 10));
+        } else if (arg == "--stats-interval") {
+            c.statsIntervalSec = static_cast<unsigned>(strtoul(value, nullptr, 10));
+        } else if (arg == "--bench") {
+            c.benchViewers = static_cast<unsigned>(strtoul(value, nullptr, 10));
+        } else if (arg == "--bench-devices") {
+            c.benchDevices = static_cast<unsigned>(strtoul(value, nullptr, 10));
+        } else if (arg == "--bench-seconds") {
+            c.benchSeconds = static_cast<unsigned>(strtoul(value, nullptr, 10));
+        } else {
+            fprintf(stderr, "unknown option %s\n", arg.c_str());
+            return false;
+        }
+    }
+    if (c.clientId.empty()) {
+        char host[64] = "hub";
+        gethostname(host, sizeof(host) - 1);
+        c.clientId = "pulsemind-live-hub-" + std::string(host) + "-" + std::to_string(getpid());
+    }
+    if (c.keepaliveSec == 0 || c.keepaliveSec > 65535 || c.port <= 0 || c.port > 65535 || c.listenPort < 0 ||
+        c.listenPort > 65535) {
+        fprintf(stderr, "invalid connection settings\n");
+        return false;
+    }
+    if (c.tickMs == 0 || c.tickMs > 10000 || c.ringSamples == 0 || c.ringSamples > MAX_RING_SAMPLES ||
+        c.benchDevices == 0) {
+        fprintf(stderr, "invalid hub settings\n");
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Config config;
+    if (!parseArgs(argc, argv, config)) {
+        return 2;
+    }
+    if (config.benchViewers > 0) {
+        return runBench(config);
+    }
+
+    struct sigaction sa = {};
+    sa.sa_handler = onSignal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    return runHub(config);
+}
@@ -0,0 +1,345 @@
+/**
+ * Self-checks for the live hub's building blocks: SHA-1 and the WebSocket
+ * accept key, upgrade request parsing, frame encoding and decoding, the
+ * waveform ring, and delta composition (coalescing, shared encodes, resets
+ * and state changes).
+ *
+ * Exit status is 0 when every check passes, 1 otherwise.
+ */
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "IngestFrame.h"
+#include "LiveHub.h"
+#include "WebSocket.h"
+
+using namespace pulsemind;
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                        \
+    do {                                                                   \
+        if (!(cond)) {                                                     \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            g_failures++;                                                  \
+        }                                                                  \
+    } while (0)
+
+std::string hex(const uint8_t* p, size_t n) {
+    static const char* const digits = "0123456789abcdef";
+    std::string out;
+    for (size_t i = 0; i < n; i++) {
+        out += digits[p[i] >> 4];
+        out += digits[p[i] & 0xF];
+    }
+    return out;
+}
+
+std::string sha1Hex(const std::string& s) {
+    uint8_t digest[20];
+    ws::sha1(reinterpret_cast<const uint8_t*>(s.data()), s.size(), digest);
+    return hex(digest, sizeof(digest));
+}
+
+/** A client frame as a browser sends it: masked. */
+std::vector<uint8_t> clientFrame(uint8_t opcode, const std::string& payload, bool fin = true) {
+    std::vector<uint8_t> f;
+    ws::encodeFrameHeader(f, opcode, payload.size());
+    if (!fin) {
+        f[0] &= 0x7F;
+    }
+    f[1] |= 0x80;
+    const uint8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+    f.insert(f.end(), mask, mask + 4);
+    for (size_t i = 0; i < payload.size(); i++) {
+        f.push_back(static_cast<uint8_t>(payload[i] ^ mask[i & 3]));
+    }
+    return f;
+}
+
+bool validJson(const std::string& s) {
+    detail::JsonCursor c(s.data(), s.data() + s.size());
+    return c.skipValue() && c.atEnd();
+}
+
+void feed(LiveHub& hub, const std::string& frame, int64_t nowUs) {
+    CHECK(hub.onSensorFrame(reinterpret_cast<const uint8_t*>(frame.data()), frame.size(), nowUs) == FrameStatus::Ok);
+}
+
+void checkHandshake() {
+    CHECK(sha1Hex("") == "da39a3ee5e6b4b0d3255bfef95601890afd80709");
+    CHECK(sha1Hex("abc") == "a9993e364706816aba3e25717850c26c9cd0d89d");
+    // 56 bytes: the length no longer fits the first block
+    CHECK(sha1Hex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq") ==
+          "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+    CHECK(sha1Hex(std::string(1000, 'a')) == "291e9a6c66994949b57ba5e650361e98fc36b1ba");
+
+    const uint8_t bytes[] = {'f', 'o', 'o', 'b', 'a', 'r'};
+    CHECK(ws::base64Encode(bytes, 4) == "Zm9vYg==");
+    CHECK(ws::base64Encode(bytes, 5) == "Zm9vYmE=");
+    CHECK(ws::base64Encode(bytes, 6) == "Zm9vYmFy");
+
+    // RFC 6455 section 1.3
+    CHECK(ws::acceptKey("dGhlIHNhbXBsZSBub25jZQ==") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+
+    const std::string request =
+        "GET /live?devices=dev-a,dev-b HTTP/1.1\r\n"
+        "Host: hub:8765\r\n"
+        "upgrade: WebSocket\r\n"
+        "Connection: keep-alive, Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "Authorization: Bearer secret\r\n"
+        "\r\n";
+    ws::Request r;
+    CHECK(ws::parseRequest(request.data(), request.size() - 2, r) == ws::ParseResult::NeedMore);
+    CHECK(ws::parseRequest(request.data(), request.size(), r) == ws::ParseResult::Complete);
+    CHECK(r.method == "GET");
+    CHECK(r.path == "/live");
+    CHECK(r.query == "devices=dev-a,dev-b");
+    CHECK(r.upgrade);
+    CHECK(r.key == "dGhlIHNhbXBsZSBub25jZQ==");
+    CHECK(r.version == "13");
+    CHECK(r.authorization == "Bearer secret");
+    CHECK(r.headerBytes == request.size());
+
+    const std::string plain = "GET /health HTTP/1.1\r\nHost: hub\r\n\r\n";
+    CHECK(ws::parseRequest(plain.data(), plain.size(), r) == ws::ParseResult::Complete);
+    CHECK(r.path == "/health" && r.query.empty() && !r.upgrade);
+
+    const std::string noConnection = "GET /live HTTP/1.1\r\nUpgrade: websocket\r\n\r\n";
+    CHECK(ws::parseRequest(noConnection.data(), noConnection.size(), r) == ws::ParseResult::Complete);
+    CHECK(!r.upgrade);
+
+    const std::string badLine = "GET\r\n\r\n";
+    CHECK(ws::parseRequest(badLine.data(), badLine.size(), r) == ws::ParseResult::Malformed);
+    const std::string badHeader = "GET / HTTP/1.1\r\nno colon\r\n\r\n";
+    CHECK(ws::parseRequest(badHeader.data(), badHeader.size(), r) == ws::ParseResult::Malformed);
+    const std::string endless = "GET / HTTP/1.1\r\n" + std::string(ws::MAX_REQUEST_BYTES, 'x');
+    CHECK(ws::parseRequest(endless.data(), endless.size(), r) == ws::ParseResult::Malformed);
+
+    const std::string response = ws::acceptResponse("dGhlIHNhbXBsZSBub25jZQ==");
+    CHECK(response.find("HTTP/1.1 101 ") == 0);
+    CHECK(response.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n") != std::string::npos);
+}
+
+void checkFrames() {
+    std::vector<uint8_t> out;
+    ws::encodeFrame(out, ws::OP_TEXT, "hi", 2);
+    CHECK(out == std::vector<uint8_t>({0x81, 2, 'h', 'i'}));
+    out.clear();
+    ws::encodeFrameHeader(out, ws::OP_TEXT, 125);
+    CHECK(out.size() == 2 && out[1] == 125);
+    out.clear();
+    ws::encodeFrameHeader(out, ws::OP_TEXT, 126);
+    CHECK(out == std::vector<uint8_t>({0x81, 126, 0, 126}));
+    out.clear();
+    ws::encodeFrameHeader(out, ws::OP_TEXT, 65536);
+    CHECK(out == std::vector<uint8_t>({0x81, 127, 0, 0, 0, 0, 0, 1, 0, 0}));
+    out.clear();
+    ws::encodeClose(out, ws::CLOSE_GOING_AWAY);
+    CHECK(out == std::vector<uint8_t>({0x88, 2, 0x03, 0xE9}));
+
+    // Split across reads, several per read, and a 16-bit length
+    ws::FrameReader reader(4096);
+    const std::vector<uint8_t> ping = clientFrame(ws::OP_PING, "beat");
+    const std::string big(300, 'x');
+    const std::vector<uint8_t> text = clientFrame(ws::OP_TEXT, big);
+    std::vector<uint8_t> stream = ping;
+    stream.insert(stream.end(), text.begin(), text.end());
+    ws::Frame frame;
+    reader.append(stream.data(), 3);
+    CHECK(reader.next(frame) == ws::FrameReader::Result::NeedMore);
+    reader.append(stream.data() + 3, stream.size() - 3);
+    CHECK(reader.next(frame) == ws::FrameReader::Result::Frame);
+    CHECK(frame.fin && frame.opcode == ws::OP_PING &&
+          std::string(reinterpret_cast<const char*>(frame.payload), frame.length) == "beat");
+    CHECK(reader.next(frame) == ws::FrameReader::Result::Frame);
+    CHECK(frame.opcode == ws::OP_TEXT && std::string(reinterpret_cast<const char*>(frame.payload), frame.length) == big);
+    CHECK(reader.next(frame) == ws::FrameReader::Result::NeedMore);
+
+    // Clients must mask
+    ws::FrameReader unmasked(4096);
+    std::vector<uint8_t> plain;
+    ws::encodeFrame(plain, ws::OP_TEXT, "hi", 2);
+    unmasked.append(plain.data(), plain.size());
+    CHECK(unmasked.next(frame) == ws::FrameReader::Result::Malformed);
+
+    // Oversized payloads are refused from the header alone
+    ws::FrameReader small(16);
+    const std::vector<uint8_t> tooBig = clientFrame(ws::OP_TEXT, std::string(17, 'x'));
+    small.append(tooBig.data(), 4);
+    CHECK(small.next(frame) == ws::FrameReader::Result::Malformed);
+
+    // Control frames cannot be fragmented
+    ws::FrameReader fragmented(4096);
+    const std::vector<uint8_t> partialPing = clientFrame(ws::OP_PING, "x", false);
+    fragmented.append(partialPing.data(), partialPing.size());
+    CHECK(fragmented.next(frame) == ws::FrameReader::Result::Malformed);
+
+    // Handshake bytes are read from the same buffer, then discarded
+    ws::FrameReader handshake(4096);
+    const std::string head = "GET /live HTTP/1.1\r\n\r\n";
+    handshake.append(reinterpret_cast<const uint8_t*>(head.data()), head.size());
+    handshake.append(ping.data(), ping.size());
+    CHECK(handshake.pendingSize() == head.size() + ping.size());
+    handshake.discard(head.size());
+    CHECK(handshake.next(frame) == ws::FrameReader::Result::Frame && frame.opcode == ws::OP_PING);
+}
+
+void checkRing() {
+    WaveformRing ring(5);
+    CHECK(ring.capacity() == 8);
+    CHECK(ring.head() == 0 && ring.tail() == 0);
+    std::vector<double> v;
+    for (int i = 0; i < 11; i++) {
+        v.push_back(i);
+    }
+    ring.append(v.data(), 6);
+    CHECK(ring.head() == 6 && ring.tail() == 0);
+    ring.append(v.data() + 6, 5);
+    CHECK(ring.head() == 11 && ring.tail() == 3);
+    for (uint64_t k = ring.tail(); k < ring.head(); k++) {
+        CHECK(ring.at(k) == static_cast<double>(k));
+    }
+}
+
+void checkDeltas() {
+    LiveHub hub(8);
+    Viewer a;
+    Viewer b;
+    Viewer slow;
+    std::string msg;
+    CHECK(hub.subscribe(a, "dev-a", 0));
+    CHECK(hub.subscribe(a, "dev-a", 0));  // Already there
+    CHECK(a.subscriptions.size() == 1);
+    CHECK(hub.subscribe(b, "dev-a", 0));
+    CHECK(hub.subscribe(slow, "dev-a", 0));
+    CHECK(!hub.subscribe(a, "bad/id", 0));
+    CHECK(!hub.subscribe(a, "", 0));
+    CHECK(hub.devices() == 1);
+    CHECK(hub.find("dev-a")->viewers == 3);
+
+    // First message: a reset with state, even before any samples
+    hub.beginTick();
+    CHECK(hub.compose(a, 7, msg));
+    CHECK(msg == "{\"t\":7,\"updates\":[{\"device\":\"dev-a\",\"seq\":0,\"reset\":true,\"samples\":[],"
+                 "\"state\":{\"fs\":0,\"command\":null,\"command_us\":0}}]}");
+    CHECK(hub.compose(b, 7, msg));
+    CHECK(hub.compose(slow, 7, msg));
+    CHECK(!hub.compose(a, 7, msg));  // Nothing new
+    CHECK(msg.empty());
+    CHECK(hub.stats().encodes == 1);
+
+    // Two frames coalesce into one update; the rate is a state change
+    feed(hub, "{\"device_id\":\"dev-a\",\"ts\":1000,\"fs\":100,\"ppg\":[1,2.5,3]}", 10);
+    feed(hub, "{\"device_id\":\"dev-a\",\"ts\":1030,\"ppg\":[4,5]}", 20);
+    hub.beginTick();
+    CHECK(hub.compose(a, 30, msg));
+    CHECK(msg == "{\"t\":30,\"updates\":[{\"device\":\"dev-a\",\"seq\":5,\"ts_ms\":1030,\"samples\":[1,2.5,3,4,5],"
+                 "\"state\":{\"fs\":100,\"command\":null,\"command_us\":0}}]}");
+    CHECK(validJson(msg));
+    const uint64_t encodes = hub.stats().encodes;
+    CHECK(hub.compose(b, 30, msg));  // Same cursor: the same bytes, no new encode
+    CHECK(hub.stats().encodes == encodes);
+    const uint64_t updates = hub.stats().updates;
+
+    // Same rate again is not a state change; the slow viewer sits this one out
+    feed(hub, "{\"device_id\":\"dev-a\",\"fs\":100,\"ppg\":[6]}", 40);
+    hub.beginTick();
+    CHECK(hub.compose(a, 50, msg));
+    CHECK(msg == "{\"t\":50,\"updates\":[{\"device\":\"dev-a\",\"seq\":6,\"samples\":[6]}]}");
+
+    // A command is state; a repeat of the same command is not
+    const std::string command = "{\"pacing_command\": {\"pacing_mode\": \"minimal\", \"target_rate\": 70}}";
+    CHECK(hub.onCommand("dev-a", command.data(), command.size(), 55));
+    CHECK(!hub.onCommand("dev-a", "not json", 8, 55));
+    CHECK(!hub.onCommand("dev-a", "[1]", 3, 55));
+    CHECK(!hub.onCommand("dev-a", "{\"a\":\"x\ny\"}", 11, 55));  // Raw control character
+    CHECK(!hub.onCommand("bad#id", command.data(), command.size(), 55));
+    CHECK(hub.stats().badCommands == 4);
+    hub.beginTick();
+    CHECK(hub.compose(a, 60, msg));
+    CHECK(msg == "{\"t\":60,\"updates\":[{\"device\":\"dev-a\",\"seq\":6,\"samples\":[],\"state\":{\"fs\":100,"
+                 "\"command\":" + command + ",\"command_us\":55}}]}");
+    CHECK(validJson(msg));
+    CHECK(hub.onCommand("dev-a", command.data(), command.size(), 65));
+    hub.beginTick();
+    CHECK(!hub.compose(a, 70, msg));
+
+    // The slow viewer catches up in one message: everything since its cursor
+    CHECK(hub.compose(slow, 70, msg));
+    CHECK(msg.find("\"seq\":6,\"samples\":[1,2.5,3,4,5,6],\"state\":{\"fs\":100,\"command\":{") !=
+          std::string::npos);
+    CHECK(msg.find("\"reset\"") == std::string::npos);
+    CHECK(hub.stats().resets == 0);
+
+    // More than a ring behind: a reset carrying the whole ring
+    for (int i = 0; i < 3; i++) {
+        feed(hub, "{\"device_id\":\"dev-a\",\"ppg\":[10,11,12,13]}", 80);
+    }
+    hub.beginTick();
+    CHECK(hub.compose(b, 90, msg));
+    CHECK(msg.find("{\"device\":\"dev-a\",\"seq\":18,\"reset\":true,\"samples\":[10,11,12,13,10,11,12,13],"
+                   "\"state\":{") != std::string::npos);
+    CHECK(hub.stats().resets == 1);
+    CHECK(hub.stats().updates > updates);
+
+    // Several devices in one message; an unknown device is created for its viewer
+    CHECK(hub.subscribe(a, "dev-b", 100));
+    feed(hub, "{\"device_id\":\"dev-b\",\"ppg\":[7]}", 100);
+    hub.beginTick();
+    CHECK(hub.compose(a, 110, msg));
+    CHECK(validJson(msg));
+    CHECK(msg.find("{\"device\":\"dev-a\",\"seq\":18,\"reset\":true,\"samples\":[10,11,12,13,10,11,12,13]}") !=
+          std::string::npos);
+    CHECK(msg.find("{\"device\":\"dev-b\",\"seq\":1,\"reset\":true,\"samples\":[7],\"state\":") != std::string::npos);
+    CHECK(hub.stats().resets == 2);  // dev-a was a ring behind for this viewer too
+
+    // Idle devices go once nobody watches them
+    feed(hub, "{\"device_id\":\"dev-c\",\"ppg\":[1]}", 100);
+    CHECK(hub.devices() == 3);
+    CHECK(hub.sweep(1000, 500) == 1);  // dev-c; dev-a and dev-b have viewers
+    CHECK(hub.find("dev-c") == nullptr);
+    hub.release(a);
+    hub.release(b);
+    hub.release(slow);
+    CHECK(a.subscriptions.empty());
+    CHECK(hub.find("dev-a")->viewers == 0);
+    CHECK(hub.sweep(1000, 500) == 2);
+    CHECK(hub.devices() == 0);
+
+    // Bad frames are counted, not stored
+    const std::string bad = "{\"device_id\":\"dev-a\"}";
+    CHECK(hub.onSensorFrame(reinterpret_cast<const uint8_t*>(bad.data()), bad.size(), 0) == FrameStatus::NoSamples);
+    CHECK(hub.stats().badFrames == 1);
+    CHECK(hub.devices() == 0);
+
+    // Subscription limit
+    Viewer many;
+    for (size_t i = 0; i < MAX_VIEWER_DEVICES; i++) {
+        CHECK(hub.subscribe(many, "d" + std::to_string(i), 0));
+    }
+    CHECK(!hub.subscribe(many, "one-more", 0));
+    hub.release(many);
+}
+
+}  // namespace
+
+int main() {
+    checkHandshake();
+    checkFrames();
+    checkRing();
+    checkDeltas();
+    if (g_failures > 0) {
+        printf("FAILED: %d check(s)\n", g_failures);
+        return 1;
+    }
+    printf("OK: live hub checks passed\n");
+    return 0;
+}
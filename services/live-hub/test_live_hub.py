@@ -0,0 +1,362 @@
+"""Tests for the native live hub and the dashboard's LiveFeed client."""
+
+import base64
+import hashlib
+import json
+import os
+import shutil
+import socket
+import struct
+import subprocess  # nosec B404
+import sys
+import threading
+import time
+import unittest
+
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "dashboard"))
+import live_feed  # noqa: E402
+
+HUB_DIR = os.path.dirname(os.path.abspath(__file__))
+HUB_BINARY = os.path.join(HUB_DIR, "build", "live_hub")
+WS_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+
+def mqtt_packet(first_byte, body):
+    length, encoded = len(body), bytearray()
+    while True:
+        digit, length = length % 128, length // 128
+        encoded.append(digit | (0x80 if length else 0))
+        if not length:
+            return bytes([first_byte]) + bytes(encoded) + body
+
+
+def mqtt_string(s):
+    data = s.encode()
+    return struct.pack(">H", len(data)) + data
+
+
+def mqtt_publish(topic, payload):
+    return mqtt_packet(0x30, mqtt_string(topic) + payload.encode())
+
+
+def read_packet(conn):
+    """Read one MQTT packet: (type, flags, body)."""
+    header = conn.recv(1)
+    if not header:
+        raise ConnectionError("closed")
+    multiplier, length = 1, 0
+    while True:
+        digit = conn.recv(1)[0]
+        length += (digit & 0x7F) * multiplier
+        multiplier *= 128
+        if not digit & 0x80:
+            break
+    body = b""
+    while len(body) < length:
+        body += conn.recv(length - len(body))
+    return header[0] >> 4, header[0] & 0x0F, body
+
+
+class FakeBroker:
+    """Accepts the hub's one connection and acknowledges its subscriptions."""
+
+    def __init__(self):
+        self.server = socket.socket()
+        self.server.bind(("127.0.0.1", 0))
+        self.server.listen(4)
+        self.server.settimeout(10)
+        self.port = self.server.getsockname()[1]
+        self.conn = None
+        self.filters = []
+
+    def accept(self):
+        self.conn, _ = self.server.accept()
+        self.conn.settimeout(10)
+        packet_type, _, body = read_packet(self.conn)
+        assert packet_type == 1  # CONNECT
+        self.conn.sendall(bytes([0x20, 2, 0, 0]))
+        for _ in range(2):
+            packet_type, _, body = read_packet(self.conn)
+            assert packet_type == 8  # SUBSCRIBE
+            topic_len = struct.unpack(">H", body[2:4])[0]
+            self.filters.append(body[4:4 + topic_len].decode())
+            self.conn.sendall(bytes([0x90, 3]) + body[:2] + b"\x00")
+
+    def publish(self, topic, payload):
+        self.conn.sendall(mqtt_publish(topic, payload))
+
+    def close(self):
+        if self.conn is not None:
+            self.conn.close()
+        self.server.close()
+
+
+def start_hub(broker_port, env=None):
+    """Start the hub on a free port; returns (process, port)."""
+    hub = subprocess.Popen(  # nosec B603
+        [HUB_BINARY, "--host", "127.0.0.1", "--port", str(broker_port), "--listen", "0",
+         "--tick-ms", "20", "--stats-interval", "0"],
+        stderr=subprocess.PIPE, text=True, env=dict(os.environ, **(env or {}))
+    )
+    port = None
+    for line in hub.stderr:
+        if "listening on port" in line:
+            port = int(line.split("port")[1].split(",")[0])
+            break
+    # Keep draining so the hub never blocks on a full pipe
+    threading.Thread(target=hub.stderr.read, daemon=True).start()
+    return hub, port
+
+
+class WebSocketViewer:
+    """Minimal RFC 6455 client over a raw socket."""
+
+    def __init__(self, port, path, headers=()):
+        self.sock = socket.create_connection(("127.0.0.1", port), timeout=10)
+        self.stream = self.sock.makefile("rb")
+        key = base64.b64encode(os.urandom(16)).decode()
+        request = (
+            f"GET {path} HTTP/1.1\r\nHost: 127.0.0.1:{port}\r\nUpgrade: websocket\r\n"
+            f"Connection: Upgrade\r\nSec-WebSocket-Key: {key}\r\nSec-WebSocket-Version: 13\r\n"
+            + "".join(f"{h}\r\n" for h in headers) + "\r\n"
+        )
+        self.sock.sendall(request.encode())
+        self.status = int(self.stream.readline().split()[1])
+        self.headers = {}
+        while True:
+            line = self.stream.readline().decode().strip()
+            if not line:
+                break
+            name, value = line.split(":", 1)
+            self.headers[name.strip().lower()] = value.strip()
+        self.expected_accept = base64.b64encode(
+            hashlib.sha1((key + WS_GUID).encode()).digest()  # nosec B324 - RFC 6455 handshake
+        ).decode()
+
+    def read_frame(self):
+        """(opcode, payload) of the next server frame."""
+        b0, b1 = self.stream.read(2)
+        assert not b1 & 0x80, "server frames are unmasked"
+        length = b1 & 0x7F
+        if length == 126:
+            length = struct.unpack(">H", self.stream.read(2))[0]
+        elif length == 127:
+            length = struct.unpack(">Q", self.stream.read(8))[0]
+        return b0 & 0x0F, self.stream.read(length)
+
+    def send_frame(self, opcode, payload=b""):
+        mask = os.urandom(4)
+        masked = bytes(b ^ mask[i % 4] for i, b in enumerate(payload))
+        self.sock.sendall(bytes([0x80 | opcode, 0x80 | len(payload)]) + mask + masked)
+
+    def close(self):
+        self.stream.close()
+        self.sock.close()
+
+
+def http_get(port, path):
+    """(status, body) of a plain GET."""
+    with socket.create_connection(("127.0.0.1", port), timeout=10) as sock:
+        sock.sendall(f"GET {path} HTTP/1.1\r\nHost: hub\r\n\r\n".encode())
+        data = b""
+        while True:
+            chunk = sock.recv(4096)
+            if not chunk:
+                break
+            data += chunk
+    head, _, body = data.partition(b"\r\n\r\n")
+    return int(head.split()[1]), body
+
+
+class TestLiveHub(unittest.TestCase):
+    """Test the hub between a broker and WebSocket viewers."""
+
+    @classmethod
+    def setUpClass(cls):
+        # Build (or bring up to date) here, so a hub that no longer compiles
+        # fails the suite instead of leaving a stale binary, or none, behind
+        if shutil.which("make") is None:
+            raise AssertionError("make not found; the live hub must build for these tests")
+        build = subprocess.run(  # nosec B603 B607
+            ["make", "-C", HUB_DIR, "all"], capture_output=True, text=True
+        )
+        if build.returncode != 0:
+            raise AssertionError(f"live hub build failed:\n{build.stdout}{build.stderr}")
+
+    def test_fan_out_from_one_subscription(self):
+        """Test viewers rebuild every device's samples and command from the hub's deltas."""
+        broker = FakeBroker()
+        hub, port = start_hub(broker.port)
+        viewers = []
+        try:
+            self.assertIsNotNone(port)
+            broker.accept()
+            self.assertEqual(broker.filters, ["pulsemind/sensor/ppg", "pulsemind/pacing/command/#"])
+
+            for path in ["/live?devices=dev-a", "/live?devices=dev-a", "/live?devices=dev-a,dev-b"]:
+                viewer = WebSocketViewer(port, path)
+                self.assertEqual(viewer.status, 101)
+                self.assertEqual(viewer.headers["sec-websocket-accept"], viewer.expected_accept)
+                viewers.append(viewer)
+
+            sent = {"dev-a": [float(2000 + i) for i in range(600)],
+                    "dev-b": [float(1000 + i % 50) + 0.5 for i in range(600)]}
+            command = {"pacing_command": {"pacing_mode": "minimal", "target_rate": 70}, "device_id": "dev-a"}
+            for start in range(0, 600, 10):
+                for device_id, samples in sent.items():
+                    broker.publish("pulsemind/sensor/ppg", json.dumps({
+                        "device_id": device_id, "ts": 1000 + start * 10, "fs": 100,
+                        "ppg": samples[start:start + 10],
+                    }))
+                if start == 300:
+                    broker.publish("pulsemind/pacing/command/dev-a", json.dumps(command))
+            broker.publish("pulsemind/sensor/ppg", json.dumps({"device_id": "bad/id", "ppg": [1]}))
+
+            for viewer, devices in zip(viewers, [["dev-a"], ["dev-a"], ["dev-a", "dev-b"]]):
+                got = {d: [] for d in devices}
+                seqs = {}
+                state = {}
+                messages = 0
+                while any(len(got[d]) < 600 for d in devices) or "command" not in state:
+                    opcode, payload = viewer.read_frame()
+                    self.assertEqual(opcode, 1)
+                    message = json.loads(payload)
+                    messages += 1
+                    devices_in_message = [u["device"] for u in message["updates"]]
+                    self.assertEqual(len(devices_in_message), len(set(devices_in_message)))
+                    for update in message["updates"]:
+                        device_id = update["device"]
+                        self.assertIn(device_id, devices)
+                        if update.get("reset"):
+                            got[device_id] = []
+                        else:
+                            self.assertEqual(update["seq"] - len(update["samples"]), seqs[device_id])
+                        got[device_id].extend(update["samples"])
+                        seqs[device_id] = update["seq"]
+                        if "state" in update:
+                            self.assertIn(update["state"]["fs"], (0, 100))  # 0 before the first frame
+                            if device_id == "dev-a" and update["state"]["command"] is not None:
+                                state["command"] = update["state"]["command"]
+                for device_id in devices:
+                    self.assertEqual(got[device_id], sent[device_id])
+                self.assertEqual(state["command"], command)
+                # 60 frames per device, coalesced into fewer messages
+                self.assertLess(messages, 60)
+
+            # Ping is answered; close is echoed
+            viewers[0].send_frame(0x9, b"beat")
+            self.assertEqual(viewers[0].read_frame(), (0xA, b"beat"))
+            viewers[0].send_frame(0x8, struct.pack(">H", 1000))
+            self.assertEqual(viewers[0].read_frame(), (0x8, struct.pack(">H", 1000)))
+
+            status, body = http_get(port, "/health")
+            self.assertEqual(status, 200)
+            health = json.loads(body)
+            self.assertEqual(health["status"], "healthy")
+            self.assertTrue(health["broker_connected"])
+            self.assertEqual(health["devices"], 2)
+            self.assertEqual(health["frames"], 60 * 2)
+        finally:
+            hub.terminate()
+            hub.wait(timeout=10)
+            for viewer in viewers:
+                viewer.close()
+            broker.close()
+
+    def test_refused_requests(self):
+        """Test bad upgrades, unknown paths and the bearer token."""
+        unused = socket.socket()
+        unused.bind(("127.0.0.1", 0))
+        broker_port = unused.getsockname()[1]
+        unused.close()
+        hub, port = start_hub(broker_port, {"PULSEMIND_LIVE_HUB_TOKEN": "s3cret"})
+        try:
+            self.assertIsNotNone(port)
+            status, body = http_get(port, "/health")
+            self.assertEqual(status, 200)
+            self.assertEqual(json.loads(body)["status"], "degraded")
+            self.assertFalse(json.loads(body)["broker_connected"])
+
+            self.assertEqual(http_get(port, "/nowhere")[0], 404)
+            self.assertEqual(http_get(port, "/live?devices=dev-a")[0], 400)  # Not an upgrade
+
+            auth = ("Authorization: Bearer s3cret",)
+            self.assertEqual(WebSocketViewer(port, "/live?devices=dev-a").status, 401)
+            self.assertEqual(WebSocketViewer(port, "/live?devices=dev-a", ("Authorization: Bearer nope",)).status,
+                             401)
+            self.assertEqual(WebSocketViewer(port, "/live", auth).status, 400)
+            self.assertEqual(WebSocketViewer(port, "/live?devices=a%2Fb", auth).status, 400)
+            too_many = ",".join(f"d{i}" for i in range(33))
+            self.assertEqual(WebSocketViewer(port, f"/live?devices={too_many}", auth).status, 400)
+
+            viewer = WebSocketViewer(port, "/live?device=dev%2Da", auth)
+            self.assertEqual(viewer.status, 101)
+            opcode, payload = viewer.read_frame()
+            update = json.loads(payload)["updates"][0]
+            self.assertEqual((update["device"], update["seq"], update["reset"]), ("dev-a", 0, True))
+            self.assertIsNone(update["state"]["command"])
+            viewer.close()
+        finally:
+            hub.terminate()
+            hub.wait(timeout=10)
+
+    @unittest.skipUnless(live_feed.is_available(), "websockets>=12 not installed")
+    def test_dashboard_live_feed(self):
+        """Test the dashboard's LiveFeed follows a device through the hub."""
+        broker = FakeBroker()
+        hub, port = start_hub(broker.port)
+        feed = None
+        try:
+            broker.accept()
+            feed = live_feed.LiveFeed(f"ws://127.0.0.1:{port}", "dev-a", maxlen=400).start()
+            deadline = time.time() + 10
+            while not feed.snapshot()["connected"] and time.time() < deadline:
+                time.sleep(0.02)
+            samples = [float(i) for i in range(500)]
+            for start in range(0, 500, 10):
+                broker.publish("pulsemind/sensor/ppg", json.dumps({
+                    "device_id": "dev-a", "fs": 100, "ppg": samples[start:start + 10]
+                }))
+                broker.publish("pulsemind/sensor/ppg", json.dumps({"device_id": "dev-b", "ppg": [0.0] * 10}))
+            broker.publish("pulsemind/pacing/command/dev-a", '{"pacing_command": {"target_rate": 72}}')
+            while time.time() < deadline:
+                snapshot = feed.snapshot()
+                if snapshot["seq"] == 500 and snapshot["command"] is not None:
+                    break
+                time.sleep(0.02)
+            self.assertEqual(snapshot["samples"], samples[-400:])
+            self.assertEqual(snapshot["fs"], 100.0)
+            self.assertEqual(snapshot["command"], {"pacing_command": {"target_rate": 72}})
+            self.assertEqual(snapshot["gaps"], 0)
+        finally:
+            if feed is not None:
+                feed.stop()
+            hub.terminate()
+            hub.wait(timeout=10)
+            broker.close()
+
+
+class TestLiveFeedApply(unittest.TestCase):
+    """Test LiveFeed's delta handling without a hub."""
+
+    def test_reset_append_and_restart(self):
+        feed = live_feed.LiveFeed("ws://hub:8765", "dev-a", maxlen=5)
+        self.assertEqual(feed.url, "ws://hub:8765/live?devices=dev-a")
+        feed.apply({"t": 1, "updates": [
+            {"device": "dev-a", "seq": 3, "reset": True, "samples": [1, 2, 3],
+             "state": {"fs": 50, "command": None, "command_us": 0}},
+            {"device": "dev-b", "seq": 9, "samples": [9]},
+        ]})
+        feed.apply({"t": 2, "updates": [{"device": "dev-a", "seq": 6, "samples": [4, 5, 6]}]})
+        snapshot = feed.snapshot()
+        self.assertEqual(snapshot["samples"], [2, 3, 4, 5, 6])
+        self.assertEqual((snapshot["seq"], snapshot["fs"], snapshot["resets"]), (6, 50.0, 1))
+
+        # A sequence that does not continue (hub restarted) starts the trace over
+        feed.apply({"t": 3, "updates": [{"device": "dev-a", "seq": 2, "samples": [7, 8]}]})
+        self.assertEqual(feed.samples(), [7, 8])
+        self.assertEqual(feed.snapshot()["gaps"], 1)
+
+
+if __name__ == "__main__":
+    unittest.main()
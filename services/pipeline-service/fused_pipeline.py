@@ -0,0 +1,399 @@
+"""Fused In-Process Analysis Pipeline.
+
+Runs one PPG window through the same stages as the service chain
+
+    signal-service /process -> hsi-service /compute-hsi
+                            -> ai-inference /predict -> control-engine /compute-pacing
+
+without HTTP hops. Filtering, peak detection, feature extraction, HSI scoring
+and the random forest run in one native call (shared/native/PpgPipeline.h)
+over per-thread buffers; the bandpass coefficients come from
+signal_processor.design_bandpass, once per sampling rate.
+
+The control stage is pluggable. By default it is the control-engine's own
+process_pacing_decision, in this process. pipeline-service instead hands it
+to the control-engine (/compute-pacing), so the per-device controller state
+(hysteresis, command shaper) and the decision journal stay in one place
+whichever path a window takes, and fused decisions show up in GET /decisions
+and decision replay.
+
+Each stage's result is reported in the schema of the service it replaces.
+
+Build the library with `make -C services/shared/native`, or point
+PULSEMIND_PIPELINE_LIB at a prebuilt libppg_pipeline.so.
+"""
+
+import ctypes
+import os
+import sys
+import time
+from datetime import datetime
+from typing import Dict, List, Optional, Sequence
+
+import numpy as np
+
+SERVICES_DIR = os.path.abspath(os.path.join(os.path.dirname(__file__), ".."))
+sys.path.insert(0, SERVICES_DIR)
+for _stage_dir in ("signal-service", "ai-inference", "hsi-service", "control-engine"):
+    sys.path.append(os.path.join(SERVICES_DIR, _stage_dir))
+
+from shared.logger import setup_logger  # noqa: E402
+
+logger = setup_logger("fused-pipeline", level="INFO")
+
+DEFAULT_LIBRARY_PATH = os.path.join(SERVICES_DIR, "shared", "native", "build", "libppg_pipeline.so")
+LIBRARY_PATH = os.getenv("PULSEMIND_PIPELINE_LIB", DEFAULT_LIBRARY_PATH)
+
+ABI_VERSION = 1
+
+# Mirrors of PpgPipeline.h constants
+MAX_FOREST_CLASSES = 8
+
+# pulsemind::PipelineStatus
+STATUS_OK = 0
+STATUS_SIGNAL_TOO_SHORT = 1
+STATUS_SAMPLING_RATE_TOO_LOW = 2
+STATUS_NON_FINITE_SAMPLE = 3
+STATUS_TOO_FEW_PEAKS = 4
+STATUS_INVALID_FOREST = 5
+STATUS_INVALID_FILTER = 6
+
+# Mirrors of the process_ppg_signal input checks
+MIN_SIGNAL_SAMPLES = 100
+MIN_SAMPLING_RATE_HZ = 10.0
+
+
+class PipelineResult(ctypes.Structure):
+    """Mirror of pulsemind::PipelineResult."""
+
+    _fields_ = [
+        ("heart_rate_bpm", ctypes.c_double),
+        ("hrv_sdnn_ms", ctypes.c_double),
+        ("pulse_amplitude", ctypes.c_double),
+        ("num_peaks", ctypes.c_uint32),
+        ("predicted_class", ctypes.c_uint32),
+        ("hsi_score", ctypes.c_double),
+        ("hr_contribution", ctypes.c_double),
+        ("hrv_contribution", ctypes.c_double),
+        ("pulse_contribution", ctypes.c_double),
+        ("normalized_hr", ctypes.c_double),
+        ("normalized_hrv", ctypes.c_double),
+        ("normalized_pulse", ctypes.c_double),
+        ("probabilities", ctypes.c_double * MAX_FOREST_CLASSES),
+    ]
+
+
+_lib: Optional[ctypes.CDLL] = None
+
+
+def load_library(path: str = LIBRARY_PATH) -> ctypes.CDLL:
+    """Load and type the native library (cached after the first call).
+
+    Raises:
+        OSError: If the library is missing or has an incompatible ABI
+    """
+    global _lib
+    if _lib is not None:
+        return _lib
+
+    lib = ctypes.CDLL(path)
+    lib.pm_pipeline_abi_version.restype = ctypes.c_uint32
+    lib.pm_pipeline_result_size.restype = ctypes.c_uint32
+    if lib.pm_pipeline_abi_version() != ABI_VERSION:
+        raise OSError(f"Unsupported pipeline ABI version {lib.pm_pipeline_abi_version()}")
+    if lib.pm_pipeline_result_size() != ctypes.sizeof(PipelineResult):
+        raise OSError("PipelineResult layout mismatch between Python and native library")
+
+    double_p = ctypes.POINTER(ctypes.c_double)
+    int64_p = ctypes.POINTER(ctypes.c_int64)
+    lib.pm_forest_create.argtypes = [ctypes.c_uint32]
+    lib.pm_forest_create.restype = ctypes.c_void_p
+    lib.pm_forest_add_tree.argtypes = [
+        ctypes.c_void_p, ctypes.c_uint64, int64_p, double_p, int64_p, int64_p, double_p
+    ]
+    lib.pm_forest_add_tree.restype = ctypes.c_int32
+    lib.pm_forest_destroy.argtypes = [ctypes.c_void_p]
+    lib.pm_forest_destroy.restype = None
+    lib.pm_forest_predict_proba.argtypes = [ctypes.c_void_p, double_p, double_p]
+    lib.pm_forest_predict_proba.restype = None
+    lib.pm_pipeline_run.argtypes = [
+        ctypes.c_void_p, double_p, double_p, ctypes.c_uint32,
+        double_p, ctypes.c_uint64, ctypes.c_double, ctypes.POINTER(PipelineResult)
+    ]
+    lib.pm_pipeline_run.restype = ctypes.c_int32
+
+    _lib = lib
+    return lib
+
+
+def is_available() -> bool:
+    """Whether the native pipeline library can be loaded."""
+    try:
+        load_library()
+        return True
+    except OSError:
+        return False
+
+
+def _as_pointer(array: np.ndarray, ctype):
+    return array.ctypes.data_as(ctypes.POINTER(ctype))
+
+
+# ============================================================================
+# FOREST
+# ============================================================================
+
+class NativeForest:
+    """A fitted RandomForestClassifier flattened into the native library.
+
+    Only models whose classes are the integer labels 0..n-1 are supported;
+    rhythm_classifier indexes RHYTHM_CLASSES and the probabilities by label.
+    """
+
+    def __init__(self, model):
+        """Copy the trees of a fitted RandomForestClassifier.
+
+        Raises:
+            ValueError: If the model cannot be represented natively
+        """
+        classes = np.asarray(model.classes_)
+        if classes.dtype.kind not in "iu" or not np.array_equal(classes, np.arange(len(classes))):
+            raise ValueError(f"Unsupported forest classes: {classes.tolist()}")
+        if len(classes) > MAX_FOREST_CLASSES:
+            raise ValueError(f"Forest has {len(classes)} classes (max {MAX_FOREST_CLASSES})")
+        if getattr(model, "n_features_in_", 3) != 3:
+            raise ValueError(f"Forest expects {model.n_features_in_} features, pipeline provides 3")
+
+        self._lib = load_library()
+        self.num_classes = len(classes)
+        self._handle = self._lib.pm_forest_create(self.num_classes)
+        if not self._handle:
+            raise ValueError("Failed to allocate native forest")
+
+        for estimator in model.estimators_:
+            tree = estimator.tree_
+            feature = np.ascontiguousarray(tree.feature, dtype=np.int64)
+            threshold = np.ascontiguousarray(tree.threshold, dtype=np.float64)
+            left = np.ascontiguousarray(tree.children_left, dtype=np.int64)
+            right = np.ascontiguousarray(tree.children_right, dtype=np.int64)
+            value = np.ascontiguousarray(
+                tree.value[:, 0, :self.num_classes], dtype=np.float64
+            )
+            status = self._lib.pm_forest_add_tree(
+                self._handle, tree.node_count,
+                _as_pointer(feature, ctypes.c_int64), _as_pointer(threshold, ctypes.c_double),
+                _as_pointer(left, ctypes.c_int64), _as_pointer(right, ctypes.c_int64),
+                _as_pointer(value, ctypes.c_double)
+            )
+            if status != 0:
+                self.close()
+                raise ValueError("Forest tree has an inconsistent node layout")
+
+    @property
+    def handle(self):
+        return self._handle
+
+    def predict_proba(self, features: Sequence[float]) -> List[float]:
+        """Class probabilities for one [hr, hrv, pulse] feature vector."""
+        x = np.ascontiguousarray(features, dtype=np.float64)
+        proba = np.zeros(MAX_FOREST_CLASSES)
+        self._lib.pm_forest_predict_proba(
+            self._handle, _as_pointer(x, ctypes.c_double), _as_pointer(proba, ctypes.c_double)
+        )
+        return proba[:self.num_classes].tolist()
+
+    def close(self):
+        """Free the native forest."""
+        if self._handle:
+            self._lib.pm_forest_destroy(self._handle)
+            self._handle = None
+
+    def __del__(self):
+        self.close()
+
+
+# ============================================================================
+# PIPELINE
+# ============================================================================
+
+class FusedPipeline:
+    """Signal -> (HSI, rhythm) -> control for one window, in process."""
+
+    def __init__(self, model, history=None, control=None):
+        """Build the pipeline around a fitted rhythm model.
+
+        Args:
+            model: Fitted RandomForestClassifier (rhythm_classifier.classifier.model)
+            history: Optional HSIHistoryStore for device trends (as hsi-service)
+            control: Optional control stage, called as control(rhythm_data,
+                hsi_data, device_id) and returning the /compute-pacing body;
+                process_pacing_decision in this process by default
+        """
+        self.forest = NativeForest(model)
+        self.history = history
+        self.control = control
+        self._lib = self.forest._lib
+        self._filters: Dict[float, tuple] = {}
+
+    def _filter_for(self, sampling_rate: float) -> tuple:
+        """Bandpass coefficients for a sampling rate (designed once)."""
+        coefficients = self._filters.get(sampling_rate)
+        if coefficients is None:
+            from signal_processor import design_bandpass
+            try:
+                b, a = design_bandpass(sampling_rate)
+            except ValueError as e:
+                raise ValueError(f"Bandpass filtering failed: {e}")
+            coefficients = (np.ascontiguousarray(b, dtype=np.float64),
+                            np.ascontiguousarray(a, dtype=np.float64))
+            self._filters[sampling_rate] = coefficients
+        return coefficients
+
+    def analyze(self, signal: Sequence[float], sampling_rate: float) -> PipelineResult:
+        """Run the native stages on one window.
+
+        Raises:
+            ValueError: For the same inputs process_ppg_signal rejects
+        """
+        if signal is None or len(signal) == 0:
+            raise ValueError("Signal array is empty")
+        try:
+            samples = np.ascontiguousarray(signal, dtype=np.float64)
+        except (ValueError, TypeError) as e:
+            raise ValueError(f"Failed to convert signal to numeric array: {e}")
+        if samples.ndim != 1:
+            raise ValueError("Signal must be a one-dimensional array")
+        if len(samples) < MIN_SIGNAL_SAMPLES:
+            raise ValueError(
+                f"Signal too short: {len(samples)} samples. "
+                f"Need at least {MIN_SIGNAL_SAMPLES} samples."
+            )
+        sampling_rate = float(sampling_rate)
+        if sampling_rate <= 0:
+            raise ValueError(f"Sampling rate must be positive, got {sampling_rate}")
+        if sampling_rate < MIN_SAMPLING_RATE_HZ:
+            raise ValueError(
+                f"Sampling rate too low: {sampling_rate} Hz. Need at least {MIN_SAMPLING_RATE_HZ:g} Hz."
+            )
+
+        b, a = self._filter_for(sampling_rate)
+        result = PipelineResult()
+        status = self._lib.pm_pipeline_run(
+            self.forest.handle, _as_pointer(b, ctypes.c_double), _as_pointer(a, ctypes.c_double),
+            len(b), _as_pointer(samples, ctypes.c_double), len(samples),
+            sampling_rate, ctypes.byref(result)
+        )
+        if status == STATUS_OK:
+            return result
+        if status == STATUS_NON_FINITE_SAMPLE:
+            raise ValueError("Signal contains NaN or infinite values")
+        if status == STATUS_TOO_FEW_PEAKS:
+            raise ValueError(
+                "Feature extraction failed: Need at least 2 peaks for feature "
+                f"extraction, got {result.num_peaks}"
+            )
+        raise RuntimeError(f"Native pipeline failed with status {status}")
+
+    def process_window(
+        self,
+        signal: Sequence[float],
+        sampling_rate: float,
+        device_id: Optional[str] = None,
+        timestamp: Optional[str] = None
+    ) -> Dict:
+        """Run the full pipeline and return every stage's result.
+
+        Args:
+            signal: PPG samples
+            sampling_rate: Sampling rate in Hz
+            device_id: Optional device for HSI trend history and controller state
+            timestamp: Optional ISO timestamp of the window (defaults to now)
+
+        Returns:
+            {"success", "features", "hsi", "prediction", "pacing",
+             "timing_us", "timestamp"}; each stage in its service's schema
+
+        Raises:
+            ValueError: If the signal or its features are invalid
+            Exception: Whatever the control stage raises
+        """
+        from hsi_computer import compute_trend, interpret_hsi, iso_to_epoch_us
+        from rhythm_classifier import RHYTHM_CLASSES, build_prediction
+        from trust_layer import apply_trust_layer
+
+        start = time.perf_counter()
+        native = self.analyze(signal, sampling_rate)
+        analysis_us = (time.perf_counter() - start) * 1e6
+
+        hr, hrv, pulse = native.heart_rate_bpm, native.hrv_sdnn_ms, native.pulse_amplitude
+        # Same range checks as process_hsi_computation and classify_rhythm
+        if hr <= 0 or hr > 300:
+            raise ValueError(f"Heart rate out of valid range: {hr} BPM")
+        if hrv < 0 or hrv > 500:
+            raise ValueError(f"HRV out of valid range: {hrv} ms")
+
+        features = {
+            "heart_rate_bpm": float(hr),
+            "hrv_sdnn_ms": float(hrv),
+            "pulse_amplitude": float(pulse),
+            "num_peaks": int(native.num_peaks),
+        }
+        input_features = {"heart_rate_bpm": hr, "hrv_sdnn_ms": hrv, "pulse_amplitude": pulse}
+
+        # HSI (hsi-service /compute-hsi body, default profile)
+        if timestamp is None:
+            timestamp = datetime.utcnow().isoformat() + "Z"
+        hsi_result = {
+            "hsi_score": round(native.hsi_score, 2),
+            "hr_contribution": round(native.hr_contribution, 4),
+            "hrv_contribution": round(native.hrv_contribution, 4),
+            "pulse_contribution": round(native.pulse_contribution, 4),
+            "normalized_hr": round(native.normalized_hr, 4),
+            "normalized_hrv": round(native.normalized_hrv, 4),
+            "normalized_pulse": round(native.normalized_pulse, 4),
+        }
+        hsi_score = hsi_result["hsi_score"]
+        if device_id is not None and self.history is not None:
+            trend = self.history.record(device_id, hsi_score, iso_to_epoch_us(timestamp))
+        else:
+            trend = compute_trend({"hsi_score": hsi_score, "timestamp": timestamp})
+        hsi = {
+            "success": True,
+            "hsi": hsi_result,
+            "interpretation": interpret_hsi(hsi_score),
+            "trend": trend,
+            "timestamp": timestamp,
+            "profile_id": "default",
+            "input_features": input_features,
+        }
+
+        # Rhythm (ai-inference /predict "prediction", without the SHAP explanation)
+        label = int(native.predicted_class)
+        probabilities = list(native.probabilities[:self.forest.num_classes])
+        prediction = apply_trust_layer(
+            build_prediction(
+                RHYTHM_CLASSES[label], probabilities[label], probabilities, analysis_us / 1000.0
+            ),
+            input_features
+        )
+
+        # Control (control-engine /compute-pacing body)
+        control = self.control
+        if control is None:
+            from pacing_controller import process_pacing_decision as control
+        start = time.perf_counter()
+        pacing = control(prediction, {**hsi, "input_features": features}, device_id)
+        control_us = (time.perf_counter() - start) * 1e6
+
+        return {
+            "success": True,
+            "features": features,
+            "hsi": hsi,
+            "prediction": prediction,
+            "pacing": pacing,
+            "timing_us": {
+                "analysis": round(analysis_us, 1),
+                "control": round(control_us, 1),
+            },
+            "timestamp": datetime.utcnow().isoformat() + "Z",
+        }
@@ -0,0 +1,223 @@
+import os
+import sys
+import time
+from datetime import datetime
+
+import requests
+from flask import Flask, jsonify, request
+
+# Add shared module to path
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+import fused_pipeline  # noqa: E402
+from shared import metrics  # noqa: E402
+from shared.logger import setup_logger  # noqa: E402
+from shared.shutdown import register_shutdown_handler  # noqa: E402
+from shared.tracing import instrument_flask, setup_tracing  # noqa: E402
+
+# Initialize logger
+logger = setup_logger("pipeline-service", level="INFO")
+
+app = Flask(__name__)
+tracer = setup_tracing("pipeline-service")
+instrument_flask(app, tracer)
+registry = metrics.instrument_flask(app, "pipeline-service")
+window_seconds = registry.histogram(
+    "pulsemind_processing_duration_seconds", "Time spent in a service's processing steps",
+    service="pipeline-service", operation="process_window",
+)
+
+# Maximum samples accepted per window
+MAX_WINDOW_SAMPLES = 100000
+
+# The control stage runs on the control-engine, which owns the per-device
+# controller state and the decision journal
+CONTROL_ENGINE_URL = os.getenv("CONTROL_ENGINE_URL", "http://localhost:8004")
+CONTROL_TIMEOUT_SECONDS = 1.0
+
+
+class ControlStageError(Exception):
+    """The control-engine did not return a pacing decision."""
+
+
+def control_stage(rhythm_data, hsi_data, device_id):
+    """Decide on the control-engine (/compute-pacing), as the service chain does.
+
+    A fused window and a window that went through the per-service chain
+    then update the same controller state and land in the same journal.
+
+    Raises:
+        ControlStageError: If the control-engine is unreachable or fails
+    """
+    payload = {"rhythm_data": rhythm_data, "hsi_data": hsi_data}
+    if device_id is not None:
+        payload["device_id"] = device_id
+    try:
+        r = requests.post(
+            f"{CONTROL_ENGINE_URL}/compute-pacing", json=payload, headers=tracer.inject(),
+            timeout=CONTROL_TIMEOUT_SECONDS
+        )
+    except requests.RequestException as e:
+        raise ControlStageError(f"Control engine unreachable: {e}") from e
+    if r.status_code != 200:
+        raise ControlStageError(f"Control engine returned HTTP {r.status_code}")
+    return r.json()
+
+
+def _build_pipeline():
+    """Load the rhythm model and build the fused pipeline.
+
+    Design Decision: Load synchronously at startup - every request needs the
+    model, and /health reports 503 until the pipeline exists.
+    """
+    from hsi_history import history_store
+    from rhythm_classifier import classifier
+
+    if not classifier.load_model():
+        logger.error("Rhythm model unavailable - fused pipeline disabled")
+        return None
+    try:
+        return fused_pipeline.FusedPipeline(classifier.model, history=history_store, control=control_stage)
+    except (OSError, ValueError) as e:
+        logger.error(f"Fused pipeline unavailable: {e}")
+        return None
+
+
+pipeline = _build_pipeline()
+
+
+@app.route('/health')
+def health_check():
+    """Health check endpoint for container orchestration."""
+    logger.info("Health check requested")
+    is_ready = pipeline is not None
+    return jsonify({
+        "status": "healthy" if is_ready else "unavailable",
+        "service": "pipeline-service",
+        "version": "1.0.0",
+        "native_pipeline": is_ready,
+        "timestamp": datetime.utcnow().isoformat() + 'Z'
+    }), 200 if is_ready else 503
+
+
+@app.route('/')
+def root():
+    """Root endpoint."""
+    logger.info("Root endpoint accessed")
+    return jsonify({
+        "service": "pipeline-service",
+        "version": "1.0.0",
+        "status": "running",
+        "description": "Fused in-process signal, HSI, rhythm and pacing pipeline",
+        "endpoints": {
+            "/health": "Health check",
+            "/process-window": "POST - Run one PPG window through every stage"
+        },
+        "timestamp": datetime.utcnow().isoformat() + 'Z'
+    })
+
+
+@app.route('/process-window', methods=['POST'])
+def process_window():
+    """Run one PPG window through signal, HSI, rhythm and pacing stages.
+
+    Expected JSON payload:
+    {
+        "signal": [100, 102, 105, ...],  # Array of signal values
+        "sampling_rate": 100,             # Sampling rate in Hz
+        "device_id": "ESP32_PulseMind_01",  // Optional - trend and controller state
+        "timestamp": "2026-01-01T14:35:00.000000Z"  // Optional
+    }
+
+    Returns:
+    {
+        "success": true,
+        "features": {...},    # signal-service /process "features"
+        "hsi": {...},         # hsi-service /compute-hsi response
+        "prediction": {...},  # ai-inference /predict "prediction"
+        "pacing": {...},      # control-engine /compute-pacing response
+        "timing_us": {"analysis": 21.4, "control": 850.2},
+        "timestamp": "...",
+        "processing_time_ms": 1.12
+    }
+    """
+    start_time = time.time()
+
+    if pipeline is None:
+        return jsonify({
+            "success": False,
+            "error": "Fused pipeline unavailable - use the per-service endpoints"
+        }), 503
+
+    if not request.is_json:
+        logger.warning("Request missing JSON content-type")
+        return jsonify({
+            "success": False,
+            "error": "Request must have Content-Type: application/json"
+        }), 400
+
+    data = request.get_json(silent=True)
+    if not isinstance(data, dict):
+        return jsonify({"success": False, "error": "Invalid JSON body"}), 400
+
+    for field in ("signal", "sampling_rate"):
+        if field not in data:
+            logger.warning(f"Missing '{field}' field in request")
+            return jsonify({
+                "success": False,
+                "error": f"Missing required field: '{field}'"
+            }), 400
+
+    signal_array = data["signal"]
+    if not isinstance(signal_array, list):
+        return jsonify({
+            "success": False,
+            "error": "Field 'signal' must be an array"
+        }), 400
+    if len(signal_array) > MAX_WINDOW_SAMPLES:
+        return jsonify({
+            "success": False,
+            "error": f"Window too large: {len(signal_array)} samples (max {MAX_WINDOW_SAMPLES})"
+        }), 400
+
+    try:
+        sampling_rate = float(data["sampling_rate"])
+    except (ValueError, TypeError):
+        return jsonify({
+            "success": False,
+            "error": "Field 'sampling_rate' must be a number"
+        }), 400
+
+    device_id = data.get("device_id")
+    if device_id is not None and (not isinstance(device_id, str) or not device_id):
+        return jsonify({
+            "success": False,
+            "error": "Field 'device_id' must be a non-empty string"
+        }), 400
+
+    try:
+        result = pipeline.process_window(
+            signal_array, sampling_rate, device_id=device_id, timestamp=data.get("timestamp")
+        )
+    except ValueError as e:
+        logger.warning(f"Window rejected: {e}")
+        return jsonify({"success": False, "error": str(e)}), 400
+    except ControlStageError as e:
+        logger.error(f"Control stage failed: {e}")
+        return jsonify({"success": False, "error": str(e)}), 502
+    except Exception as e:
+        logger.error(f"Unexpected error in fused pipeline: {e}", exc_info=True)
+        return jsonify({
+            "success": False,
+            "error": f"Internal processing error: {str(e)}"
+        }), 500
+
+    processing_time_ms = (time.time() - start_time) * 1000
+    result["processing_time_ms"] = round(processing_time_ms, 2)
+    window_seconds.observe(processing_time_ms / 1000)
+    return jsonify(result), 200
+
+
+if __name__ == '__main__':
+    register_shutdown_handler(logger)
+    logger.info("Starting pipeline-service on port 8005")
+    app.run(host="0.0.0.0", port=8005, threaded=True)  # nosec B104
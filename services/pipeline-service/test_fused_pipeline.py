@@ -0,0 +1,131 @@
+"""Unit tests for the fused in-process pipeline."""
+
+import unittest
+
+import numpy as np
+
+import fused_pipeline
+from fused_pipeline import FusedPipeline
+from hsi_computer import compute_hsi
+from rhythm_classifier import RhythmClassifier, classify_rhythm, classifier
+from signal_processor import process_ppg_signal
+
+
+def synthetic_ppg(rng, n, sampling_rate, bpm, noise):
+    t = np.arange(n) / sampling_rate
+    return 2048 + 300 * np.sin(2 * np.pi * bpm / 60.0 * t) + rng.normal(0, noise, n)
+
+
+@unittest.skipUnless(
+    fused_pipeline.is_available(),
+    "native pipeline not built (make -C services/shared/native)"
+)
+class TestFusedPipeline(unittest.TestCase):
+    """Test that the fused pipeline matches the per-service stages exactly."""
+
+    @classmethod
+    def setUpClass(cls):
+        cls.model = RhythmClassifier().create_default_model()
+        cls.pipeline = FusedPipeline(cls.model)
+
+    def test_features_match_signal_service(self):
+        """Test bit-identical features over random windows and sampling rates."""
+        rng = np.random.default_rng(7)
+        compared = 0
+        for _ in range(150):
+            sampling_rate = float(rng.choice([25, 50, 100, 125, 250]))
+            window = synthetic_ppg(
+                rng, int(rng.integers(100, 1500)), sampling_rate,
+                rng.uniform(35, 180), rng.uniform(1, 150)
+            )
+            try:
+                expected = process_ppg_signal(window.tolist(), sampling_rate)["features"]
+            except ValueError:
+                with self.assertRaises(ValueError):
+                    self.pipeline.analyze(window, sampling_rate)
+                continue
+            result = self.pipeline.analyze(window, sampling_rate)
+            self.assertEqual(result.num_peaks, expected["num_peaks"])
+            self.assertEqual(result.heart_rate_bpm, expected["heart_rate_bpm"])
+            self.assertEqual(result.pulse_amplitude, expected["pulse_amplitude"])
+            if expected["num_peaks"] > 2:  # SDNN of one interval is NaN
+                self.assertEqual(result.hrv_sdnn_ms, expected["hrv_sdnn_ms"])
+            compared += 1
+        self.assertGreater(compared, 100)
+
+    def test_forest_matches_predict_proba(self):
+        """Test that the native forest reproduces scikit-learn's probabilities."""
+        rng = np.random.default_rng(11)
+        samples = np.column_stack([
+            rng.uniform(20, 200, 2000), rng.uniform(0, 150, 2000), rng.uniform(0, 60, 2000)
+        ])
+        expected = self.model.predict_proba(samples)
+        for x, proba in zip(samples, expected):
+            self.assertEqual(self.pipeline.forest.predict_proba(x), proba.tolist())
+
+    def test_stage_outputs_match_services(self):
+        """Test the HSI and prediction sections against the service functions."""
+        rng = np.random.default_rng(3)
+        window = synthetic_ppg(rng, 400, 100.0, 72.0, 15.0)
+        result = self.pipeline.process_window(window.tolist(), 100.0, device_id="fused-test")
+
+        features = result["features"]
+        self.assertEqual(features, process_ppg_signal(window.tolist(), 100.0)["features"])
+        self.assertEqual(
+            result["hsi"]["hsi"],
+            compute_hsi(features["heart_rate_bpm"], features["hrv_sdnn_ms"], features["pulse_amplitude"])
+        )
+
+        saved = classifier.model, classifier.is_loaded
+        classifier.model, classifier.is_loaded = self.model, True
+        try:
+            expected = classify_rhythm(
+                features["heart_rate_bpm"], features["hrv_sdnn_ms"], features["pulse_amplitude"]
+            )
+        finally:
+            classifier.model, classifier.is_loaded = saved
+        prediction = result["prediction"]
+        for key in ("rhythm_class", "confidence", "confidence_level", "probability_distribution"):
+            self.assertEqual(prediction[key], expected[key])
+        self.assertIn("trust_flag", prediction)
+
+        pacing = result["pacing"]
+        self.assertTrue(pacing["success"])
+        self.assertEqual(pacing["input_summary"]["device_id"], "fused-test")
+        self.assertEqual(pacing["input_summary"]["rhythm_class"], prediction["rhythm_class"])
+
+    def test_control_stage_is_pluggable(self):
+        """Test that a supplied control stage decides instead of the in-process policy."""
+        calls = []
+
+        def control(rhythm_data, hsi_data, device_id):
+            calls.append((rhythm_data, hsi_data, device_id))
+            return {"success": True, "pacing_command": {"pacing_mode": "monitor_only"}}
+
+        pipeline = FusedPipeline(self.model, control=control)
+        window = synthetic_ppg(np.random.default_rng(5), 400, 100.0, 72.0, 15.0)
+        result = pipeline.process_window(window.tolist(), 100.0, device_id="fused-remote")
+        self.assertEqual(result["pacing"]["pacing_command"], {"pacing_mode": "monitor_only"})
+        self.assertEqual(len(calls), 1)
+        rhythm_data, hsi_data, device_id = calls[0]
+        self.assertEqual(device_id, "fused-remote")
+        self.assertEqual(rhythm_data, result["prediction"])
+        self.assertEqual(hsi_data["input_features"], result["features"])
+        self.assertEqual(hsi_data["hsi"], result["hsi"]["hsi"])
+
+    def test_invalid_windows(self):
+        """Test that invalid input is rejected like process_ppg_signal."""
+        with self.assertRaises(ValueError):
+            self.pipeline.process_window([], 100.0)
+        with self.assertRaises(ValueError):
+            self.pipeline.process_window([1.0] * 99, 100.0)
+        with self.assertRaises(ValueError):
+            self.pipeline.process_window([1.0] * 400, 5.0)
+        with self.assertRaises(ValueError):
+            self.pipeline.process_window([1.0] * 399 + [float("nan")], 100.0)
+        with self.assertRaises(ValueError):
+            self.pipeline.process_window([0.0] * 400, 100.0)  # No peaks
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,115 @@
+"""ctypes bindings for pixel-budget downsampling (shared/native/Downsample.h).
+
+Plots should receive about one point per pixel of width, whatever the
+sample rate and window length. Two reductions:
+
+- "lttb": Largest-Triangle-Three-Buckets, the best-looking line for a
+  waveform's shape
+- "minmax": the lowest and highest point of each pixel column, which keeps
+  every peak and dropout; with separate low/high inputs it also decimates
+  rollup buckets
+
+Build the library with `make -C services/shared/native`, or point
+PULSEMIND_DOWNSAMPLE_LIB at a prebuilt libdownsample.so.
+"""
+
+import ctypes
+import os
+from typing import List, Optional, Sequence, Tuple
+
+DEFAULT_LIBRARY_PATH = os.path.join(
+    os.path.dirname(os.path.abspath(__file__)), "native", "build", "libdownsample.so"
+)
+LIBRARY_PATH = os.getenv("PULSEMIND_DOWNSAMPLE_LIB", DEFAULT_LIBRARY_PATH)
+
+ABI_VERSION = 1
+
+MODES = ("lttb", "minmax")
+
+_F64_P = ctypes.POINTER(ctypes.c_double)
+
+_lib: Optional[ctypes.CDLL] = None
+
+
+def load_library(path: str = LIBRARY_PATH) -> ctypes.CDLL:
+    """Load and type the native library (cached after the first call).
+
+    Raises:
+        OSError: If the library is missing or has an incompatible ABI
+    """
+    global _lib
+    if _lib is not None:
+        return _lib
+
+    lib = ctypes.CDLL(path)
+    lib.pm_downsample_abi_version.restype = ctypes.c_uint32
+    if lib.pm_downsample_abi_version() != ABI_VERSION:
+        raise OSError(f"Unsupported downsample ABI version {lib.pm_downsample_abi_version()}")
+
+    lib.pm_downsample_lttb.argtypes = [_F64_P, _F64_P, ctypes.c_uint64, ctypes.c_uint64, _F64_P, _F64_P]
+    lib.pm_downsample_lttb.restype = ctypes.c_uint64
+    lib.pm_downsample_min_max.argtypes = [
+        _F64_P, _F64_P, _F64_P, ctypes.c_uint64, ctypes.c_uint64, _F64_P, _F64_P
+    ]
+    lib.pm_downsample_min_max.restype = ctypes.c_uint64
+
+    _lib = lib
+    return lib
+
+
+def is_available(path: str = LIBRARY_PATH) -> bool:
+    """Return True if the native library can be loaded."""
+    try:
+        load_library(path)
+        return True
+    except OSError:
+        return False
+
+
+def _doubles(values: Sequence[float]):
+    """(owner, pointer) for a float64 view of values; numpy arrays are not copied
+    element by element."""
+    if hasattr(values, "__array_interface__"):
+        array = values.astype("float64", order="C", copy=False)
+        return array, array.ctypes.data_as(_F64_P)
+    array = (ctypes.c_double * len(values))(*values)
+    return array, ctypes.cast(array, _F64_P)
+
+
+def downsample(
+    mode: str, x: Sequence[float], y: Sequence[float], max_points: int,
+    high: Optional[Sequence[float]] = None
+) -> Tuple[List[float], List[float]]:
+    """Reduce the points (x[i], y[i]), x non-decreasing, to at most max_points.
+
+    Args:
+        mode: "lttb" or "minmax"
+        high: For "minmax", per-point maxima when y holds minima (rollup
+            buckets); defaults to y
+
+    Returns:
+        (x, y) lists; unchanged when the points already fit
+
+    Raises:
+        ValueError: On an unknown mode, mismatched lengths or max_points < 1
+        OSError: If the native library is unavailable
+    """
+    if mode not in MODES:
+        raise ValueError(f"Unknown downsample mode '{mode}' (expected one of {MODES})")
+    n = len(x)
+    if len(y) != n or (high is not None and len(high) != n):
+        raise ValueError("x and y differ in length")
+    if max_points < 1:
+        raise ValueError("max_points must be at least 1")
+    lib = load_library()
+
+    x_owner, x_ptr = _doubles(x)
+    y_owner, y_ptr = _doubles(y)
+    x_out = (ctypes.c_double * max_points)()
+    y_out = (ctypes.c_double * max_points)()
+    if mode == "lttb":
+        count = lib.pm_downsample_lttb(x_ptr, y_ptr, n, max_points, x_out, y_out)
+    else:
+        high_owner, high_ptr = _doubles(high) if high is not None else (y_owner, y_ptr)
+        count = lib.pm_downsample_min_max(x_ptr, y_ptr, high_ptr, n, max_points, x_out, y_out)
+    return x_out[:count], y_out[:count]
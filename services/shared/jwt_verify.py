@@ -0,0 +1,268 @@
+"""HS256 access-token verification with a cache of verified tokens.
+
+Hs256Verifier checks a token's signature and claims. With the native
+library (shared/native/JwtHs256.h) the HMAC runs on OpenSSL's SHA-256
+(SHA-NI where the CPU has it) with the key's padded blocks hashed once;
+without it the same check runs through hmac. Either way the header must say
+HS256, exp is required and must be in the future, and nbf, if present, must
+have passed.
+
+TokenCache maps tokens that verified to their claims until they expire, so
+a dashboard session polling with the same token pays for verification once.
+It is split into shards, each with its own lock, and bounded: a full shard
+first drops expired tokens, then the oldest.
+
+Build the library with `make -C services/shared/native`, or point
+PULSEMIND_JWT_LIB at a prebuilt libjwt_hs256.so.
+"""
+
+import base64
+import binascii
+import ctypes
+import hashlib
+import hmac
+import json
+import os
+import threading
+import time
+from typing import Dict, List, Optional, Tuple
+
+DEFAULT_LIBRARY_PATH = os.path.join(
+    os.path.dirname(os.path.abspath(__file__)), "native", "build", "libjwt_hs256.so"
+)
+LIBRARY_PATH = os.getenv("PULSEMIND_JWT_LIB", DEFAULT_LIBRARY_PATH)
+
+ABI_VERSION = 1
+
+ALGORITHM = "HS256"
+
+_STATUS_OK = 0
+
+
+_lib: Optional[ctypes.CDLL] = None
+
+
+def load_library(path: str = LIBRARY_PATH) -> ctypes.CDLL:
+    """Load and type the native library (cached after the first call).
+
+    Raises:
+        OSError: If the library is missing or has an incompatible ABI
+    """
+    global _lib
+    if _lib is not None:
+        return _lib
+
+    lib = ctypes.CDLL(path)
+    lib.pm_jwt_abi_version.restype = ctypes.c_uint32
+    if lib.pm_jwt_abi_version() != ABI_VERSION:
+        raise OSError(f"Unsupported JWT ABI version {lib.pm_jwt_abi_version()}")
+
+    lib.pm_jwt_key_new.argtypes = [ctypes.c_char_p, ctypes.c_uint64]
+    lib.pm_jwt_key_new.restype = ctypes.c_void_p
+    lib.pm_jwt_key_free.argtypes = [ctypes.c_void_p]
+    lib.pm_jwt_key_free.restype = None
+    lib.pm_jwt_verify.argtypes = [
+        ctypes.c_void_p, ctypes.c_char_p, ctypes.c_uint64, ctypes.c_void_p, ctypes.c_uint64,
+        ctypes.POINTER(ctypes.c_uint64), ctypes.POINTER(ctypes.c_uint64),
+    ]
+    lib.pm_jwt_verify.restype = ctypes.c_int32
+
+    _lib = lib
+    return lib
+
+
+def is_available(path: str = LIBRARY_PATH) -> bool:
+    """Return True if the native library can be loaded."""
+    try:
+        load_library(path)
+        return True
+    except OSError:
+        return False
+
+
+# ============================================================================
+# VERIFICATION
+# ============================================================================
+
+def _b64url_decode(segment: bytes) -> bytes:
+    """Strict unpadded base64url, as the native decoder accepts it.
+
+    Raises:
+        ValueError: If the segment is not the canonical encoding of its bytes
+    """
+    data = base64.urlsafe_b64decode(segment + b"=" * (-len(segment) % 4))
+    # Re-encoding catches stray characters, padding and non-zero trailing bits
+    if base64.urlsafe_b64encode(data).rstrip(b"=") != segment:
+        raise ValueError("Non-canonical base64url")
+    return data
+
+
+def _claims_valid(claims: Dict, now: float) -> bool:
+    exp = claims.get("exp")
+    if isinstance(exp, bool) or not isinstance(exp, (int, float)) or exp <= now:
+        return False
+    nbf = claims.get("nbf")
+    if nbf is not None and (isinstance(nbf, bool) or not isinstance(nbf, (int, float)) or nbf > now):
+        return False
+    return True
+
+
+class Hs256Verifier:
+    """Verifies HS256 tokens signed with one secret. Safe to share across threads."""
+
+    def __init__(self, secret: bytes, native: Optional[bool] = None):
+        self.secret = secret
+        self._mac = hmac.new(secret, digestmod=hashlib.sha256)
+        self._key: Optional[int] = None
+        self._local = threading.local()
+        if native is None:
+            native = is_available()
+        if native:
+            self._lib = load_library()
+            self._key = self._lib.pm_jwt_key_new(secret, len(secret))
+
+    def __del__(self):
+        if getattr(self, "_key", None):
+            self._lib.pm_jwt_key_free(self._key)
+            self._key = None
+
+    @property
+    def native(self) -> bool:
+        return self._key is not None
+
+    def _signed_parts_native(self, token: bytes) -> Optional[Tuple[bytes, bytes]]:
+        # Decoded header and payload are shorter than the token itself
+        buffer = getattr(self._local, "buffer", None)
+        if buffer is None or len(buffer) < len(token):
+            buffer = self._local.buffer = ctypes.create_string_buffer(max(len(token), 4096))
+        header_len = ctypes.c_uint64()
+        payload_len = ctypes.c_uint64()
+        status = self._lib.pm_jwt_verify(
+            self._key, token, len(token), buffer, len(buffer), ctypes.byref(header_len), ctypes.byref(payload_len)
+        )
+        if status != _STATUS_OK:
+            return None
+        raw = ctypes.string_at(buffer, header_len.value + payload_len.value)
+        return raw[:header_len.value], raw[header_len.value:]
+
+    def _signed_parts_python(self, token: bytes) -> Optional[Tuple[bytes, bytes]]:
+        parts = token.split(b".")
+        if len(parts) != 3:
+            return None
+        try:
+            signature = _b64url_decode(parts[2])
+            mac = self._mac.copy()
+            mac.update(token[:len(parts[0]) + len(parts[1]) + 1])
+            if not hmac.compare_digest(signature, mac.digest()):
+                return None
+            return _b64url_decode(parts[0]), _b64url_decode(parts[1])
+        except (ValueError, binascii.Error):
+            return None
+
+    def verify(self, token: str, now: Optional[float] = None) -> Optional[Dict]:
+        """Claims of a valid token, or None if it is malformed, forged or expired."""
+        try:
+            raw = token.encode("ascii")
+        except (UnicodeEncodeError, AttributeError):
+            return None
+        parts = self._signed_parts_native(raw) if self._key else self._signed_parts_python(raw)
+        if parts is None:
+            return None
+        try:
+            header = json.loads(parts[0])
+            claims = json.loads(parts[1])
+        except ValueError:
+            return None
+        if not isinstance(header, dict) or header.get("alg") != ALGORITHM or not isinstance(claims, dict):
+            return None
+        return claims if _claims_valid(claims, time.time() if now is None else now) else None
+
+
+# ============================================================================
+# CACHE
+# ============================================================================
+
+class _Shard:
+    __slots__ = ("lock", "entries", "next_expiry")
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        # token -> (claims, exp), in insertion order
+        self.entries: Dict[str, Tuple[Dict, float]] = {}
+        self.next_expiry = float("inf")
+
+
+class TokenCache:
+    """Verified tokens and their claims, bounded, sharded and dropped at expiry."""
+
+    def __init__(self, max_entries: int = 8192, shards: int = 16):
+        self.shard_capacity = max(1, max_entries // shards)
+        self._shards: List[_Shard] = [_Shard() for _ in range(shards)]
+        # Counters are updated outside the shard locks; they are for monitoring only
+        self.hits = 0
+        self.misses = 0
+        self.evictions = 0
+
+    def _shard(self, token: str) -> _Shard:
+        return self._shards[hash(token) % len(self._shards)]
+
+    def get(self, token: str, now: float) -> Optional[Dict]:
+        """A copy of the cached claims, or None if absent or expired."""
+        shard = self._shard(token)
+        with shard.lock:
+            entry = shard.entries.get(token)
+            if entry is not None and entry[1] <= now:
+                del shard.entries[token]
+                entry = None
+        if entry is None:
+            self.misses += 1
+            return None
+        self.hits += 1
+        return dict(entry[0])
+
+    def put(self, token: str, claims: Dict, exp: float, now: float) -> None:
+        shard = self._shard(token)
+        with shard.lock:
+            entries = shard.entries
+            if token not in entries and len(entries) >= self.shard_capacity:
+                evicted = len(entries)
+                if now >= shard.next_expiry:
+                    live = {t: e for t, e in entries.items() if e[1] > now}
+                    shard.entries = entries = live
+                    shard.next_expiry = min((e[1] for e in live.values()), default=float("inf"))
+                if len(entries) >= self.shard_capacity:
+                    del entries[next(iter(entries))]
+                self.evictions += evicted - len(entries)
+            entries[token] = (dict(claims), exp)
+            shard.next_expiry = min(shard.next_expiry, exp)
+
+    def clear(self) -> None:
+        for shard in self._shards:
+            with shard.lock:
+                shard.entries = {}
+                shard.next_expiry = float("inf")
+
+    def __len__(self) -> int:
+        return sum(len(shard.entries) for shard in self._shards)
+
+    def stats(self) -> Dict:
+        return {"entries": len(self), "hits": self.hits, "misses": self.misses, "evictions": self.evictions}
+
+
+class TokenVerifier:
+    """Cache-first verification: a token seen before skips the HMAC and JSON entirely."""
+
+    def __init__(self, secret: bytes, cache: Optional[TokenCache] = None, native: Optional[bool] = None):
+        self.verifier = Hs256Verifier(secret, native=native)
+        self.cache = cache if cache is not None else TokenCache()
+
+    def decode(self, token: str) -> Optional[Dict]:
+        """Claims of a valid token (a copy the caller may keep), or None."""
+        now = time.time()
+        claims = self.cache.get(token, now)
+        if claims is not None:
+            return claims
+        claims = self.verifier.verify(token, now)
+        if claims is not None:
+            self.cache.put(token, claims, claims["exp"], now)
+        return claims
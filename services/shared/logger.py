@@ -1,34 +1,117 @@
 """Centralized logging utility for PulseMind services.
 
 Provides structured JSON logging with consistent formatting.
+
+When the native logging ring is available (native_log.py), every logger in
+the process shares one RingHandler: the request thread only renders the
+message and queues it, and a native thread scrubs PHI, formats the JSON and
+writes it. Otherwise CustomJsonFormatter does the same work in-line. Both
+produce the same lines. Set PULSEMIND_NATIVE_LOG=0 to force the in-line path.
+
+Hot paths that log on every request should go through hot_path_logger(),
+which samples and/or rate-limits a call site and reports what it skipped.
 """
+import atexit
 import logging
+import os
+import re
 import sys
-from datetime import datetime
+import time
 
 from pythonjsonlogger import jsonlogger
 
+try:
+    from . import native_log
+except ImportError:  # Imported as a top-level module
+    import native_log
+
 
 # Sensitive fields to scrub from logs for HIPAA/GDPR compliance
 PHI_FIELDS = {'patient_id', 'ssn', 'birth_date', 'signal', 'raw_data'}
 
+# All PHI field names in one case-insensitive pass over the message
+_PHI_PATTERN = re.compile(
+    "|".join(re.escape(field) for field in sorted(PHI_FIELDS)), re.IGNORECASE | re.ASCII
+)
+
+_timestamp_prefix = (None, "")
+
+
+def _timestamp(created: float) -> str:
+    """ISO-8601 UTC with microseconds; the date part is formatted once per second.
+
+    Rounds like the native ring (via integer microseconds), so both paths
+    print the same time for a record.
+    """
+    global _timestamp_prefix
+    seconds, micros = divmod(int(created * 1_000_000), 1_000_000)
+    cached_second, prefix = _timestamp_prefix
+    if seconds != cached_second:
+        prefix = time.strftime("%Y-%m-%dT%H:%M:%S", time.gmtime(seconds))
+        _timestamp_prefix = (seconds, prefix)
+    return f"{prefix}.{micros:06d}Z"
+
+
 class CustomJsonFormatter(jsonlogger.JsonFormatter):
     """Custom JSON formatter with additional fields and PHI scrubbing."""
-    
+
     def add_fields(self, log_record, record, message_dict):
         super(CustomJsonFormatter, self).add_fields(log_record, record, message_dict)
-        log_record['timestamp'] = datetime.utcnow().isoformat() + 'Z'
+        log_record['timestamp'] = _timestamp(record.created)
         log_record['level'] = record.levelname
         if not log_record.get('service'):
             log_record['service'] = 'unknown'
-            
+
         # PHI Scrubbing
-        for field in PHI_FIELDS:
-            if field in log_record:
-                log_record[field] = "[MASKED_PHI]"
-            if 'message' in log_record and isinstance(log_record['message'], str):
-                if field in log_record['message'].lower():
-                    log_record['message'] = "[REDACTED_POTENTIAL_PHI]"
+        for field in PHI_FIELDS.intersection(log_record):
+            log_record[field] = native_log.MASKED_PHI
+        message = log_record.get('message')
+        if isinstance(message, str) and _PHI_PATTERN.search(message):
+            log_record['message'] = "[REDACTED_POTENTIAL_PHI]"
+
+
+def _json_formatter():
+    return CustomJsonFormatter('%(timestamp)s %(level)s %(service)s %(message)s')
+
+
+# ============================================================================
+# NATIVE RING
+# ============================================================================
+
+_ring_handler = None
+_orphaned_sinks = []
+
+
+def _reopen_after_fork():
+    """The ring's writer thread does not survive fork(); give the child its own."""
+    handler = _ring_handler
+    # The old sink's thread is gone in the child: it must never be closed
+    _orphaned_sinks.append(handler.sink)
+    handler.sink = native_log.LogSink(handler.sink.fd, PHI_FIELDS)
+
+
+def _flush_ring():
+    if _ring_handler is not None:
+        _ring_handler.sink.flush()
+
+
+def _get_ring_handler():
+    """The process-wide RingHandler, or None to format in-line."""
+    global _ring_handler
+    if _ring_handler is not None:
+        return _ring_handler
+    if os.getenv("PULSEMIND_NATIVE_LOG", "1") == "0" or not native_log.is_available():
+        return None
+    try:
+        sink = native_log.LogSink(sys.stdout.fileno(), PHI_FIELDS)
+    except (OSError, ValueError, AttributeError):
+        # No real stdout (captured) or the sink failed to open
+        return None
+    handler = native_log.RingHandler(sink, PHI_FIELDS, overflow=_json_formatter())
+    _ring_handler = handler
+    os.register_at_fork(after_in_child=_reopen_after_fork)
+    atexit.register(_flush_ring)
+    return handler
 
 
 def setup_logger(service_name: str, level: str = "INFO") -> logging.Logger:
@@ -37,25 +120,83 @@ def setup_logger(service_name: str, level: str = "INFO") -> logging.Logger:
     Args:
         service_name: Name of the service
         level: Logging level (DEBUG, INFO, WARNING, ERROR, CRITICAL)
-    
+
     Returns:
         Configured logger instance
     """
     logger = logging.getLogger(service_name)
     logger.setLevel(getattr(logging, level.upper()))
-    
+
     # Remove existing handlers
     logger.handlers = []
-    
-    # Console handler with JSON formatting
-    handler = logging.StreamHandler(sys.stdout)
-    formatter = CustomJsonFormatter(
-        '%(timestamp)s %(level)s %(service)s %(message)s'
-    )
-    handler.setFormatter(formatter)
+
+    handler = _get_ring_handler()
+    if handler is None:
+        # Console handler with JSON formatting
+        handler = logging.StreamHandler(sys.stdout)
+        handler.setFormatter(_json_formatter())
     logger.addHandler(handler)
-    
+
     # Add service name to all log records
     adapter = logging.LoggerAdapter(logger, {"service": service_name})
 
     return adapter  # type: ignore[return-value]
+
+
+# ============================================================================
+# HOT PATHS
+# ============================================================================
+
+class HotPathLogger:
+    """Logger for a call site that runs on every request.
+
+    Records past the site's budget are dropped before they are built; the
+    next record kept carries `suppressed`, the number dropped in between.
+    Pass format arguments separately (logger.info("x=%s", x)) so dropped
+    records cost no formatting.
+    """
+
+    def __init__(self, logger, site):
+        if isinstance(logger, logging.LoggerAdapter):
+            self._logger = logger.logger
+            self._extra = dict(logger.extra or {})
+        else:
+            self._logger = logger
+            self._extra = {}
+        self._site = site
+
+    def log(self, level: int, msg, *args, **kwargs) -> None:
+        if not self._logger.isEnabledFor(level):
+            return
+        suppressed = self._site.allow()
+        if suppressed is None:
+            return
+        extra = self._extra
+        if suppressed:
+            extra = dict(extra, suppressed=suppressed)
+        self._logger.log(level, msg, *args, extra=extra, **kwargs)
+
+    def debug(self, msg, *args, **kwargs) -> None:
+        self.log(logging.DEBUG, msg, *args, **kwargs)
+
+    def info(self, msg, *args, **kwargs) -> None:
+        self.log(logging.INFO, msg, *args, **kwargs)
+
+    def warning(self, msg, *args, **kwargs) -> None:
+        self.log(logging.WARNING, msg, *args, **kwargs)
+
+
+def hot_path_logger(logger, per_second: float = 0.0, burst: float = 1.0, sample_every: int = 1) -> HotPathLogger:
+    """Wrap a logger from setup_logger for a hot call site.
+
+    Args:
+        logger: Logger (or adapter) returned by setup_logger
+        per_second: Records per second kept at most (0: no rate limit)
+        burst: Records that may be kept at once after a quiet period
+        sample_every: Keep only every Nth record (1: all)
+    """
+    if native_log.is_available():
+        site = native_log.LogSite(per_second, burst, sample_every)
+    else:
+        site = native_log.PyLogSite(per_second, burst, sample_every)
+    return HotPathLogger(logger, site)
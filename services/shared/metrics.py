@@ -0,0 +1,661 @@
+"""Prometheus-style metrics: counters, gauges and latency histograms.
+
+Series live in a registry: shared/native/Metrics.h through ctypes, or
+PyRegistry when the library is missing, which renders the same text.
+Recording into the native registry is a relaxed atomic add on the calling
+thread's shard, with no lock: a few nanoseconds from C++ (metrics_check's
+bench). From Python the ctypes call dominates, under a microsecond,
+which is noise per request but not per sample; keep per-sample loops in
+native code and record their totals.
+
+default_registry() is the process's registry. instrument_flask() and
+instrument_fastapi() count and time every request and serve the registry at
+/metrics in the text exposition format.
+
+Histograms take seconds (observe) or integer microseconds (observe_us).
+They keep HDR-style buckets, 8 per power of two from 1 us to 2^36 us, which
+quantile() reads; the exposition collapses them onto le bounds at powers of
+4 us (1 us to 67 s).
+
+Names shared across the services:
+  pulsemind_http_requests_total{service,method,route,status}
+  pulsemind_http_request_duration_seconds{service,method,route}
+  pulsemind_processing_duration_seconds{service,operation}
+The firmware's status frame carries the device's metrics under
+pulsemind_device_* names, which the ingest worker exports as they are
+(services/ingest-worker, --metrics-file).
+
+Build the library with `make -C services/shared/native`, or point
+PULSEMIND_METRICS_LIB at a prebuilt libmetrics.so.
+"""
+
+import contextlib
+import ctypes
+import functools
+import math
+import os
+import threading
+import time
+from typing import Callable, Dict, Iterator, List, Mapping, Optional
+
+DEFAULT_LIBRARY_PATH = os.path.join(
+    os.path.dirname(os.path.abspath(__file__)), "native", "build", "libmetrics.so"
+)
+LIBRARY_PATH = os.getenv("PULSEMIND_METRICS_LIB", DEFAULT_LIBRARY_PATH)
+
+ABI_VERSION = 1
+
+CONTENT_TYPE = "text/plain; version=0.0.4; charset=utf-8"
+
+# Cells per shard; 0 takes the library default (16384)
+DEFAULT_CELLS = 0
+PY_DEFAULT_CELLS = 16384
+
+# Histogram layout (Metrics.h)
+HISTOGRAM_SUB_BITS = 3
+HISTOGRAM_SUB_BUCKETS = 1 << HISTOGRAM_SUB_BITS
+HISTOGRAM_MAX_BITS = 36
+HISTOGRAM_BUCKETS = (HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS
+HISTOGRAM_CELLS = HISTOGRAM_BUCKETS + 1
+HISTOGRAM_LE_STEPS = 13
+
+MAX_NAME_BYTES = 128
+MAX_HELP_BYTES = 256
+MAX_LABELS_BYTES = 256
+
+COUNTER = 0
+GAUGE = 1
+HISTOGRAM = 2
+
+_TYPE_NAMES = {COUNTER: "counter", GAUGE: "gauge", HISTOGRAM: "histogram"}
+_LE_INF = 'le="+Inf"'
+
+# Route label of requests no route matched, so stray paths add no series
+UNMATCHED_ROUTE = "<unmatched>"
+
+
+class MetricsStats(ctypes.Structure):
+    """Mirror of pulsemind::metrics::MetricsStats."""
+
+    _fields_ = [
+        ("families", ctypes.c_uint64),
+        ("series", ctypes.c_uint64),
+        ("cells_used", ctypes.c_uint64),
+        ("cells_capacity", ctypes.c_uint64),
+        ("rejected", ctypes.c_uint64),
+    ]
+
+
+_lib: Optional[ctypes.CDLL] = None
+
+
+def load_library(path: str = LIBRARY_PATH) -> ctypes.CDLL:
+    """Load and type the native library (cached after the first call).
+
+    Raises:
+        OSError: If the library is missing or has an incompatible ABI
+    """
+    global _lib
+    if _lib is not None:
+        return _lib
+
+    lib = ctypes.CDLL(path)
+    lib.pm_metrics_abi_version.restype = ctypes.c_uint32
+    if lib.pm_metrics_abi_version() != ABI_VERSION:
+        raise OSError(f"Unsupported metrics ABI version {lib.pm_metrics_abi_version()}")
+
+    lib.pm_metrics_open.argtypes = [ctypes.c_uint32]
+    lib.pm_metrics_open.restype = ctypes.c_void_p
+    lib.pm_metrics_register.argtypes = [
+        ctypes.c_void_p, ctypes.c_uint8, ctypes.c_char_p, ctypes.c_uint64,
+        ctypes.c_char_p, ctypes.c_uint64, ctypes.c_char_p, ctypes.c_uint64,
+    ]
+    lib.pm_metrics_register.restype = ctypes.c_int32
+    for name, value_type in (
+        ("pm_metrics_counter_add", ctypes.c_uint64),
+        ("pm_metrics_counter_store", ctypes.c_uint64),
+        ("pm_metrics_gauge_set", ctypes.c_double),
+        ("pm_metrics_gauge_add", ctypes.c_double),
+        ("pm_metrics_observe_us", ctypes.c_uint64),
+    ):
+        getattr(lib, name).argtypes = [ctypes.c_void_p, ctypes.c_int32, value_type]
+        getattr(lib, name).restype = None
+    for name, restype in (
+        ("pm_metrics_counter_value", ctypes.c_uint64),
+        ("pm_metrics_gauge_value", ctypes.c_double),
+        ("pm_metrics_histogram_count", ctypes.c_uint64),
+        ("pm_metrics_histogram_sum_us", ctypes.c_uint64),
+    ):
+        getattr(lib, name).argtypes = [ctypes.c_void_p, ctypes.c_int32]
+        getattr(lib, name).restype = restype
+    lib.pm_metrics_histogram_quantile_us.argtypes = [ctypes.c_void_p, ctypes.c_int32, ctypes.c_double]
+    lib.pm_metrics_histogram_quantile_us.restype = ctypes.c_uint64
+    lib.pm_metrics_render.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_uint64]
+    lib.pm_metrics_render.restype = ctypes.c_int64
+    lib.pm_metrics_stats.argtypes = [ctypes.c_void_p, ctypes.POINTER(MetricsStats)]
+    lib.pm_metrics_stats.restype = None
+    lib.pm_metrics_close.argtypes = [ctypes.c_void_p]
+    lib.pm_metrics_close.restype = None
+
+    _lib = lib
+    return lib
+
+
+def is_available(path: str = LIBRARY_PATH) -> bool:
+    """Return True if the native library can be loaded."""
+    try:
+        load_library(path)
+        return True
+    except OSError:
+        return False
+
+
+# ============================================================================
+# EXPOSITION TEXT
+# ============================================================================
+
+def format_labels(labels: Mapping[str, object]) -> str:
+    """Labels as the exposition writes them: name="value" pairs, values escaped."""
+    pairs = []
+    for name, value in labels.items():
+        text = str(value).replace("\\", "\\\\").replace("\"", "\\\"").replace("\n", "\\n")
+        pairs.append(f'{name}="{text}"')
+    return ",".join(pairs)
+
+
+def histogram_bucket(us: int) -> int:
+    """Bucket of a value in microseconds (Metrics.h's histogramBucket)."""
+    v = us - 1 if us > 0 else 0
+    if v < HISTOGRAM_SUB_BUCKETS:
+        return v
+    e = v.bit_length() - 1
+    sub = (v >> (e - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_BUCKETS - 1)
+    return min((e - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS + sub, HISTOGRAM_BUCKETS - 1)
+
+
+def histogram_bound(b: int) -> int:
+    """Largest value (microseconds) bucket b holds."""
+    if b < HISTOGRAM_SUB_BUCKETS:
+        return b + 1
+    shift = b // HISTOGRAM_SUB_BUCKETS - 1
+    return ((HISTOGRAM_SUB_BUCKETS + b % HISTOGRAM_SUB_BUCKETS) << shift) + (1 << shift)
+
+
+def _seconds(us: int) -> str:
+    return f"{us // 1_000_000}.{us % 1_000_000:06d}"
+
+
+def _double(value: float) -> str:
+    if math.isnan(value):
+        return "NaN"
+    if math.isinf(value):
+        return "+Inf" if value > 0 else "-Inf"
+    return "%.15g" % value
+
+
+def _valid_name(name: str) -> bool:
+    if not name or len(name) > MAX_NAME_BYTES:
+        return False
+    for i, c in enumerate(name):
+        if not (c.isascii() and (c.isalpha() or c in "_:" or (i > 0 and c.isdigit()))):
+            return False
+    return True
+
+
+def _valid_labels(labels: str, histogram: bool) -> bool:
+    if len(labels.encode()) > MAX_LABELS_BYTES:
+        return False
+    i, n = 0, len(labels)
+    while i < n:
+        start = i
+        while i < n and labels[i] != "=":
+            c = labels[i]
+            if not (c.isascii() and (c.isalpha() or c == "_" or (i > start and c.isdigit()))):
+                return False
+            i += 1
+        name = labels[start:i]
+        if not name or (histogram and name == "le") or labels[i:i + 2] != '="':
+            return False
+        i += 2
+        while i < n and labels[i] != '"':
+            if labels[i] == "\n":
+                return False
+            if labels[i] == "\\":
+                i += 1
+                if i >= n or labels[i] not in '\\"n':
+                    return False
+            i += 1
+        if i >= n:
+            return False
+        i += 1
+        if i < n:
+            if labels[i] != "," or i + 1 == n:
+                return False
+            i += 1
+    return True
+
+
+# ============================================================================
+# REGISTRIES
+# ============================================================================
+
+class _Registry:
+    """Typed series and collectors over a registry's handle operations."""
+
+    def __init__(self):
+        self._collectors: List[Callable[[], None]] = []
+
+    def counter(self, name: str, help: str = "", **labels) -> "Counter":
+        return Counter(self, self._add(COUNTER, name, help, labels))
+
+    def gauge(self, name: str, help: str = "", **labels) -> "Gauge":
+        return Gauge(self, self._add(GAUGE, name, help, labels))
+
+    def histogram(self, name: str, help: str = "", **labels) -> "Histogram":
+        return Histogram(self, self._add(HISTOGRAM, name, help, labels))
+
+    def add_collector(self, collect: Callable[[], None]) -> None:
+        """Run collect before every exposition, to refresh values kept elsewhere."""
+        self._collectors.append(collect)
+
+    def exposition(self) -> bytes:
+        """Run the collectors, then render; a failing collector leaves its values as they were."""
+        for collect in self._collectors:
+            try:
+                collect()
+            except Exception:  # nosec B110 - a scrape must not fail on one source
+                pass
+        return self.render()
+
+    def bind(self, operation: str, handle: int) -> Callable:
+        """operation (e.g. "counter_add") with handle bound, for a series' hot path."""
+        return functools.partial(getattr(self, operation), handle)
+
+    def _add(self, kind: int, name: str, help: str, labels: Mapping[str, object]) -> int:
+        label_text = format_labels(labels)
+        handle = self.register(kind, name, help, label_text)
+        if handle < 0:
+            raise ValueError(f"metric {name}{{{label_text}}} refused (invalid, conflicting or out of cells)")
+        return handle
+
+
+class NativeRegistry(_Registry):
+    """The native registry (Metrics.h's Registry behind metrics_capi.cpp)."""
+
+    def __init__(self, cells: int = DEFAULT_CELLS):
+        super().__init__()
+        lib = load_library()
+        self._ptr = lib.pm_metrics_open(cells)
+        if not self._ptr:
+            raise OSError("pm_metrics_open failed")
+        self._lib = lib
+        self._buffer = ctypes.create_string_buffer(64 * 1024)
+        self._render_lock = threading.Lock()
+
+    def bind(self, operation: str, handle: int) -> Callable:
+        # Straight to the library: one ctypes call per record, no Python frame in between
+        return functools.partial(getattr(self._lib, "pm_metrics_" + operation), self._ptr, handle)
+
+    def register(self, kind: int, name: str, help: str, labels: str) -> int:
+        name_b, help_b, labels_b = name.encode(), help.encode(), labels.encode()
+        return self._lib.pm_metrics_register(
+            self._ptr, kind, name_b, len(name_b), help_b, len(help_b), labels_b, len(labels_b)
+        )
+
+    def counter_add(self, handle: int, n: int) -> None:
+        self._lib.pm_metrics_counter_add(self._ptr, handle, n)
+
+    def counter_store(self, handle: int, total: int) -> None:
+        self._lib.pm_metrics_counter_store(self._ptr, handle, total)
+
+    def gauge_set(self, handle: int, value: float) -> None:
+        self._lib.pm_metrics_gauge_set(self._ptr, handle, value)
+
+    def gauge_add(self, handle: int, delta: float) -> None:
+        self._lib.pm_metrics_gauge_add(self._ptr, handle, delta)
+
+    def observe_us(self, handle: int, us: int) -> None:
+        self._lib.pm_metrics_observe_us(self._ptr, handle, us)
+
+    def counter_value(self, handle: int) -> int:
+        return self._lib.pm_metrics_counter_value(self._ptr, handle)
+
+    def gauge_value(self, handle: int) -> float:
+        return self._lib.pm_metrics_gauge_value(self._ptr, handle)
+
+    def histogram_count(self, handle: int) -> int:
+        return self._lib.pm_metrics_histogram_count(self._ptr, handle)
+
+    def histogram_sum_us(self, handle: int) -> int:
+        return self._lib.pm_metrics_histogram_sum_us(self._ptr, handle)
+
+    def quantile_us(self, handle: int, q: float) -> int:
+        return self._lib.pm_metrics_histogram_quantile_us(self._ptr, handle, q)
+
+    def render(self) -> bytes:
+        with self._render_lock:
+            while True:
+                n = self._lib.pm_metrics_render(self._ptr, self._buffer, len(self._buffer))
+                if n >= 0:
+                    return self._buffer.raw[:n]
+                self._buffer = ctypes.create_string_buffer(-n)
+
+    def stats(self) -> Dict[str, int]:
+        stats = MetricsStats()
+        self._lib.pm_metrics_stats(self._ptr, ctypes.byref(stats))
+        return {name: getattr(stats, name) for name, _ in MetricsStats._fields_}
+
+
+class PyRegistry(_Registry):
+    """Pure-Python registry with the native one's semantics and exposition text."""
+
+    def __init__(self, cells: int = PY_DEFAULT_CELLS):
+        super().__init__()
+        self._lock = threading.Lock()
+        self._capacity = max(HISTOGRAM_CELLS, min(cells or PY_DEFAULT_CELLS, 1 << 20))
+        self._capacity = (self._capacity + 7) // 8 * 8
+        self._cells: List[int] = []
+        self._families: List[dict] = []
+        self._rejected = 0
+
+    def register(self, kind: int, name: str, help: str, labels: str) -> int:
+        with self._lock:
+            if (not _valid_name(name) or len(help.encode()) > MAX_HELP_BYTES
+                    or not _valid_labels(labels, kind == HISTOGRAM)):
+                self._rejected += 1
+                return -1
+            family = next((f for f in self._families if f["name"] == name), None)
+            if family is not None:
+                if family["type"] != kind:
+                    self._rejected += 1
+                    return -1
+                for series_labels, handle in family["series"]:
+                    if series_labels == labels:
+                        return handle
+            width = HISTOGRAM_CELLS if kind == HISTOGRAM else 1
+            if len(self._cells) + width > self._capacity:
+                self._rejected += 1
+                return -1
+            if family is None:
+                family = {"name": name, "help": help, "type": kind, "series": []}
+                self._families.append(family)
+            handle = len(self._cells)
+            self._cells.extend([0] * width)
+            if kind == GAUGE:
+                self._cells[handle] = 0.0
+            family["series"].append((labels, handle))
+            return handle
+
+    def counter_add(self, handle: int, n: int) -> None:
+        with self._lock:
+            self._cells[handle] = (self._cells[handle] + n) & 0xFFFFFFFFFFFFFFFF
+
+    def counter_store(self, handle: int, total: int) -> None:
+        with self._lock:
+            self._cells[handle] = total
+
+    def gauge_set(self, handle: int, value: float) -> None:
+        with self._lock:
+            self._cells[handle] = float(value)
+
+    def gauge_add(self, handle: int, delta: float) -> None:
+        with self._lock:
+            self._cells[handle] += delta
+
+    def observe_us(self, handle: int, us: int) -> None:
+        with self._lock:
+            self._cells[handle + histogram_bucket(us)] += 1
+            self._cells[handle + HISTOGRAM_BUCKETS] += us
+
+    def counter_value(self, handle: int) -> int:
+        return self._cells[handle]
+
+    def gauge_value(self, handle: int) -> float:
+        return self._cells[handle]
+
+    def histogram_count(self, handle: int) -> int:
+        return sum(self._cells[handle:handle + HISTOGRAM_BUCKETS])
+
+    def histogram_sum_us(self, handle: int) -> int:
+        return self._cells[handle + HISTOGRAM_BUCKETS]
+
+    def quantile_us(self, handle: int, q: float) -> int:
+        counts = self._cells[handle:handle + HISTOGRAM_BUCKETS]
+        total = sum(counts)
+        if total == 0:
+            return 0
+        rank = max(1, math.ceil(min(1.0, max(0.0, q)) * total))
+        seen = 0
+        for b, count in enumerate(counts):
+            seen += count
+            if seen >= rank:
+                return histogram_bound(b)
+        return histogram_bound(HISTOGRAM_BUCKETS - 1)
+
+    def render(self) -> bytes:
+        out = []
+        with self._lock:
+            for f in self._families:
+                name = f["name"]
+                help_text = f["help"].replace("\\", "\\\\").replace("\n", "\\n")
+                out.append(f"# HELP {name} {help_text}\n# TYPE {name} {_TYPE_NAMES[f['type']]}\n")
+                for labels, handle in f["series"]:
+                    if f["type"] == COUNTER:
+                        out.append(f"{_sample(name, '', labels)}{self._cells[handle]}\n")
+                    elif f["type"] == GAUGE:
+                        out.append(f"{_sample(name, '', labels)}{_double(self._cells[handle])}\n")
+                    else:
+                        out.append(self._render_histogram(name, labels, handle))
+        return "".join(out).encode("utf-8")
+
+    def _render_histogram(self, name: str, labels: str, handle: int) -> str:
+        lines = []
+        cumulative = 0
+        le = 1
+        for b in range(HISTOGRAM_BUCKETS):
+            cumulative += self._cells[handle + b]
+            if le <= 1 << (2 * HISTOGRAM_LE_STEPS) and histogram_bound(b) == le:
+                bound = 'le="' + _seconds(le) + '"'
+                lines.append(f"{_sample(name, '_bucket', labels, bound)}{cumulative}\n")
+                le *= 4
+        lines.append(f"{_sample(name, '_bucket', labels, _LE_INF)}{cumulative}\n")
+        lines.append(f"{_sample(name, '_sum', labels)}{_seconds(self._cells[handle + HISTOGRAM_BUCKETS])}\n")
+        lines.append(f"{_sample(name, '_count', labels)}{cumulative}\n")
+        return "".join(lines)
+
+    def stats(self) -> Dict[str, int]:
+        with self._lock:
+            return {
+                "families": len(self._families),
+                "series": sum(len(f["series"]) for f in self._families),
+                "cells_used": len(self._cells),
+                "cells_capacity": self._capacity,
+                "rejected": self._rejected,
+            }
+
+
+def _sample(name: str, suffix: str, labels: str, extra: Optional[str] = None) -> str:
+    pairs = ",".join(p for p in (labels, extra) if p)
+    return f"{name}{suffix}{{{pairs}}} " if pairs else f"{name}{suffix} "
+
+
+# ============================================================================
+# SERIES
+# ============================================================================
+
+class Counter:
+    __slots__ = ("_registry", "_handle", "_add", "_store")
+
+    def __init__(self, registry: _Registry, handle: int):
+        self._registry = registry
+        self._handle = handle
+        self._add = registry.bind("counter_add", handle)
+        self._store = registry.bind("counter_store", handle)
+
+    def inc(self, n: int = 1) -> None:
+        self._add(n)
+
+    def store(self, total: int) -> None:
+        """Overwrite with a total counted elsewhere; not to be mixed with inc()."""
+        self._store(int(total))
+
+    @property
+    def value(self) -> int:
+        return self._registry.counter_value(self._handle)
+
+
+class Gauge:
+    __slots__ = ("_registry", "_handle", "_set", "_add")
+
+    def __init__(self, registry: _Registry, handle: int):
+        self._registry = registry
+        self._handle = handle
+        self._set = registry.bind("gauge_set", handle)
+        self._add = registry.bind("gauge_add", handle)
+
+    def set(self, value: float) -> None:
+        self._set(float(value))
+
+    def inc(self, delta: float = 1.0) -> None:
+        self._add(float(delta))
+
+    def dec(self, delta: float = 1.0) -> None:
+        self._add(-float(delta))
+
+    @property
+    def value(self) -> float:
+        return self._registry.gauge_value(self._handle)
+
+
+class Histogram:
+    __slots__ = ("_registry", "_handle", "_observe")
+
+    def __init__(self, registry: _Registry, handle: int):
+        self._registry = registry
+        self._handle = handle
+        self._observe = registry.bind("observe_us", handle)
+
+    def observe(self, seconds: float) -> None:
+        self._observe(int(seconds * 1e6 + 0.5) if seconds > 0 else 0)
+
+    def observe_us(self, us: int) -> None:
+        self._observe(us if us > 0 else 0)
+
+    @contextlib.contextmanager
+    def time(self) -> Iterator[None]:
+        start = time.perf_counter()
+        try:
+            yield
+        finally:
+            self.observe(time.perf_counter() - start)
+
+    @property
+    def count(self) -> int:
+        return self._registry.histogram_count(self._handle)
+
+    @property
+    def sum(self) -> float:
+        return self._registry.histogram_sum_us(self._handle) / 1e6
+
+    def quantile(self, q: float) -> float:
+        """Upper bound (seconds) of the bucket holding quantile q; 0 when empty."""
+        return self._registry.quantile_us(self._handle, q) / 1e6
+
+
+_default: Optional[_Registry] = None
+_default_lock = threading.Lock()
+
+
+def default_registry() -> _Registry:
+    """The process's registry: native when the library loads, else PyRegistry."""
+    global _default
+    with _default_lock:
+        if _default is None:
+            _default = NativeRegistry() if is_available() else PyRegistry()
+        return _default
+
+
+# ============================================================================
+# FRAMEWORKS
+# ============================================================================
+
+class _RequestMetrics:
+    """Request count and latency series per (method, route, status), created on first use."""
+
+    def __init__(self, service: str, registry: _Registry):
+        self.service = service
+        self.registry = registry
+        self._counters: Dict[tuple, Counter] = {}
+        self._histograms: Dict[tuple, Histogram] = {}
+
+    def record(self, method: str, route: str, status: int, seconds: float) -> None:
+        key = (method, route, status)
+        counter = self._counters.get(key)
+        if counter is None:
+            counter = self.registry.counter(
+                "pulsemind_http_requests_total", "HTTP requests served",
+                service=self.service, method=method, route=route, status=status,
+            )
+            self._counters[key] = counter
+        histogram = self._histograms.get(key[:2])
+        if histogram is None:
+            histogram = self.registry.histogram(
+                "pulsemind_http_request_duration_seconds", "HTTP request latency",
+                service=self.service, method=method, route=route,
+            )
+            self._histograms[key[:2]] = histogram
+        counter.inc()
+        histogram.observe(seconds)
+
+
+def instrument_flask(app, service: str, registry: Optional[_Registry] = None) -> _Registry:
+    """Count and time every request of app and serve the registry at /metrics."""
+    from flask import Response, g, request
+
+    registry = registry or default_registry()
+    requests = _RequestMetrics(service, registry)
+
+    @app.before_request
+    def _start_request_timer():
+        g.pulsemind_request_start = time.perf_counter()
+
+    @app.after_request
+    def _record_request(response):
+        start = g.pop("pulsemind_request_start", None)
+        if start is not None:
+            route = request.url_rule.rule if request.url_rule is not None else UNMATCHED_ROUTE
+            requests.record(request.method, route, response.status_code, time.perf_counter() - start)
+        return response
+
+    @app.route("/metrics")
+    def metrics():
+        return Response(registry.exposition(), content_type=CONTENT_TYPE)
+
+    return registry
+
+
+def instrument_fastapi(app, service: str, registry: Optional[_Registry] = None) -> _Registry:
+    """instrument_flask for a FastAPI app (a middleware and a /metrics route)."""
+    from starlette.responses import Response
+
+    registry = registry or default_registry()
+    requests = _RequestMetrics(service, registry)
+
+    @app.middleware("http")
+    async def _record_request(request, call_next):
+        start = time.perf_counter()
+        status = 500
+        try:
+            response = await call_next(request)
+            status = response.status_code
+            return response
+        finally:
+            route = request.scope.get("route")
+            path = getattr(route, "path", None) or UNMATCHED_ROUTE
+            requests.record(request.method, path, status, time.perf_counter() - start)
+
+    async def metrics():
+        return Response(registry.exposition(), media_type=CONTENT_TYPE)
+
+    app.add_api_route("/metrics", metrics, methods=["GET"], include_in_schema=False)
+    return registry
@@ -0,0 +1,153 @@
+#ifndef PULSEMIND_DOWNSAMPLE_H
+#define PULSEMIND_DOWNSAMPLE_H
+
+/**
+ * Reduce a series to a plot's pixel budget before it is shipped and drawn,
+ * so rendering cost depends on the plot width rather than on the sample
+ * rate and window length.
+ *
+ * - lttb(): Largest-Triangle-Three-Buckets (Steinarsson 2013). Keeps the
+ *   first and last points and, per bucket, the point forming the largest
+ *   triangle with the previously kept point and the next bucket's average.
+ *   Best for line plots of a waveform's shape.
+ * - minMax(): per bucket of equal x width, the lowest and highest point in x
+ *   order. Keeps every peak and trough (arrhythmia spikes, dropouts), so the
+ *   envelope of a long window is exact at pixel resolution. Takes separate
+ *   low and high arrays so rollup buckets (min, max columns) decimate the
+ *   same way as raw samples (low == high).
+ *
+ * x must be non-decreasing. Both write at most maxPoints points and return
+ * how many; inputs that already fit are copied unchanged.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cmath>
+
+namespace pulsemind {
+
+inline size_t copyPoints(const double* x, const double* y, size_t n, double* xOut, double* yOut) {
+    for (size_t i = 0; i < n; i++) {
+        xOut[i] = x[i];
+        yOut[i] = y[i];
+    }
+    return n;
+}
+
+inline size_t lttb(const double* x, const double* y, size_t n, size_t maxPoints, double* xOut, double* yOut) {
+    if (n <= maxPoints) {
+        return copyPoints(x, y, n, xOut, yOut);
+    }
+    if (maxPoints < 3) {
+        // Too few for a middle bucket: the end points
+        size_t k = 0;
+        if (maxPoints >= 1) {
+            xOut[k] = x[0];
+            yOut[k++] = y[0];
+        }
+        if (maxPoints >= 2) {
+            xOut[k] = x[n - 1];
+            yOut[k++] = y[n - 1];
+        }
+        return k;
+    }
+
+    // n - 2 inner points in maxPoints - 2 buckets
+    const double every = static_cast<double>(n - 2) / static_cast<double>(maxPoints - 2);
+    size_t a = 0;
+    size_t k = 0;
+    xOut[k] = x[0];
+    yOut[k++] = y[0];
+    for (size_t b = 0; b < maxPoints - 2; b++) {
+        // Average of the next bucket (the last point for the final one)
+        size_t nextFrom = static_cast<size_t>((b + 1) * every) + 1;
+        size_t nextTo = static_cast<size_t>((b + 2) * every) + 1;
+        nextTo = nextTo < n ? nextTo : n;
+        nextFrom = nextFrom < nextTo ? nextFrom : nextTo - 1;
+        double avgX = 0;
+        double avgY = 0;
+        for (size_t j = nextFrom; j < nextTo; j++) {
+            avgX += x[j];
+            avgY += y[j];
+        }
+        avgX /= static_cast<double>(nextTo - nextFrom);
+        avgY /= static_cast<double>(nextTo - nextFrom);
+
+        const size_t from = static_cast<size_t>(b * every) + 1;
+        size_t to = static_cast<size_t>((b + 1) * every) + 1;
+        to = to < n - 1 ? to : n - 1;
+        size_t best = from;
+        double bestArea = -1;
+        for (size_t j = from; j < to; j++) {
+            // Twice the triangle's area; the factor does not change the argmax
+            const double area = std::fabs((x[a] - avgX) * (y[j] - y[a]) - (x[a] - x[j]) * (avgY - y[a]));
+            if (area > bestArea) {
+                bestArea = area;
+                best = j;
+            }
+        }
+        xOut[k] = x[best];
+        yOut[k++] = y[best];
+        a = best;
+    }
+    xOut[k] = x[n - 1];
+    yOut[k++] = y[n - 1];
+    return k;
+}
+
+inline size_t minMax(const double* x, const double* low, const double* high, size_t n, size_t maxPoints,
+                     double* xOut, double* yOut) {
+    if (low == high && n <= maxPoints) {
+        return copyPoints(x, low, n, xOut, yOut);
+    }
+    const size_t buckets = maxPoints / 2;
+    if (n == 0 || buckets == 0) {
+        return 0;
+    }
+    const double x0 = x[0];
+    const double span = x[n - 1] - x0;
+    const double perBucket = span > 0 ? static_cast<double>(buckets) / span : 0;
+
+    size_t k = 0;
+    size_t i = 0;
+    while (i < n) {
+        const size_t bucket = static_cast<size_t>((x[i] - x0) * perBucket);
+        size_t lo = i;
+        size_t hi = i;
+        size_t j = i + 1;
+        for (; j < n; j++) {
+            const size_t b = static_cast<size_t>((x[j] - x0) * perBucket);
+            // The last bucket is closed: x[n - 1] lands in it
+            if (b != bucket && !(b >= buckets && bucket == buckets - 1)) {
+                break;
+            }
+            if (low[j] < low[lo]) {
+                lo = j;
+            }
+            if (high[j] > high[hi]) {
+                hi = j;
+            }
+        }
+        if (lo == hi && low[lo] == high[hi]) {
+            xOut[k] = x[lo];
+            yOut[k++] = low[lo];
+        } else if (lo <= hi) {
+            xOut[k] = x[lo];
+            yOut[k++] = low[lo];
+            xOut[k] = x[hi];
+            yOut[k++] = high[hi];
+        } else {
+            xOut[k] = x[hi];
+            yOut[k++] = high[hi];
+            xOut[k] = x[lo];
+            yOut[k++] = low[lo];
+        }
+        i = j;
+    }
+    return k;
+}
+
+}  // namespace pulsemind
+
+#endif  // PULSEMIND_DOWNSAMPLE_H
@@ -0,0 +1,224 @@
+#ifndef PULSEMIND_JWT_HS256_H
+#define PULSEMIND_JWT_HS256_H
+
+/**
+ * HS256 (HMAC-SHA256) JSON Web Token signature verification.
+ *
+ * SHA-256 is OpenSSL's (libcrypto EVP), which runs on the SHA-NI
+ * instructions where the CPU has them. HMAC is built here on top of it so
+ * the key-dependent half of the work is done once: Hs256Key absorbs the
+ * inner and outer padded key blocks at construction, and each verification
+ * copies those two states and hashes only the token. For a gateway token
+ * that is 4 SHA-256 compressions instead of 6.
+ *
+ * verify() checks the token shape (three base64url segments), the
+ * signature (constant-time compare) and decodes header and payload. It
+ * does not parse JSON: the caller checks the header's alg and the claims.
+ * base64url is decoded strictly (no padding, no stray characters, zero
+ * trailing bits), so every signature has exactly one accepted encoding.
+ */
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace pulsemind {
+namespace jwt {
+
+// ============================================================================
+// CONSTANTS
+// ============================================================================
+
+constexpr size_t HS256_BYTES = 32;
+constexpr size_t SHA256_BLOCK_BYTES = 64;
+
+/** Verification status. */
+constexpr int32_t JWT_OK = 0;
+constexpr int32_t JWT_MALFORMED = 1;      // Not three base64url segments, or a bad signature length
+constexpr int32_t JWT_BAD_SIGNATURE = 2;
+constexpr int32_t JWT_TOO_LARGE = 3;      // Decoded header and payload do not fit the output
+constexpr int32_t JWT_ERROR = 4;          // Hash failure
+
+// ============================================================================
+// BASE64URL
+// ============================================================================
+
+/** Decoded length of n base64url characters (unpadded), or -1 if n is impossible. */
+inline int64_t base64UrlDecodedLength(size_t n) {
+    if (n % 4 == 1) {
+        return -1;
+    }
+    return static_cast<int64_t>(n / 4 * 3 + (n % 4 ? n % 4 - 1 : 0));
+}
+
+inline int base64UrlValue(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '-') return 62;
+    if (c == '_') return 63;
+    return -1;
+}
+
+/**
+ * Decode unpadded base64url into out (room for base64UrlDecodedLength(n)).
+ * Returns the decoded length, or -1 if the input is not canonical.
+ */
+inline int64_t base64UrlDecode(const char* in, size_t n, uint8_t* out) {
+    const int64_t length = base64UrlDecodedLength(n);
+    if (length < 0) {
+        return -1;
+    }
+    uint32_t acc = 0;
+    int bits = 0;
+    size_t o = 0;
+    for (size_t i = 0; i < n; i++) {
+        const int v = base64UrlValue(in[i]);
+        if (v < 0) {
+            return -1;
+        }
+        acc = (acc << 6) | static_cast<uint32_t>(v);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out[o++] = static_cast<uint8_t>(acc >> bits);
+        }
+    }
+    // Leftover bits must be zero, or several encodings would decode alike
+    if (bits > 0 && (acc & ((1u << bits) - 1)) != 0) {
+        return -1;
+    }
+    return length;
+}
+
+// ============================================================================
+// HMAC-SHA256
+// ============================================================================
+
+/** An HMAC-SHA256 key with its padded blocks pre-hashed. Safe to share across threads. */
+class Hs256Key {
+public:
+    Hs256Key(const uint8_t* key, size_t keyLen) : inner_(EVP_MD_CTX_new()), outer_(EVP_MD_CTX_new()) {
+        uint8_t block[SHA256_BLOCK_BYTES] = {};
+        if (keyLen > SHA256_BLOCK_BYTES) {
+            unsigned int len = 0;
+            ok_ = EVP_Digest(key, keyLen, block, &len, EVP_sha256(), nullptr) == 1;
+        } else if (keyLen > 0) {
+            memcpy(block, key, keyLen);
+        }
+        uint8_t ipad[SHA256_BLOCK_BYTES];
+        uint8_t opad[SHA256_BLOCK_BYTES];
+        for (size_t i = 0; i < SHA256_BLOCK_BYTES; i++) {
+            ipad[i] = block[i] ^ 0x36;
+            opad[i] = block[i] ^ 0x5c;
+        }
+        ok_ = ok_ && inner_ != nullptr && outer_ != nullptr &&
+              EVP_DigestInit_ex(inner_, EVP_sha256(), nullptr) == 1 &&
+              EVP_DigestUpdate(inner_, ipad, sizeof(ipad)) == 1 &&
+              EVP_DigestInit_ex(outer_, EVP_sha256(), nullptr) == 1 &&
+              EVP_DigestUpdate(outer_, opad, sizeof(opad)) == 1;
+        OPENSSL_cleanse(block, sizeof(block));
+        OPENSSL_cleanse(ipad, sizeof(ipad));
+        OPENSSL_cleanse(opad, sizeof(opad));
+    }
+
+    ~Hs256Key() {
+        EVP_MD_CTX_free(inner_);
+        EVP_MD_CTX_free(outer_);
+    }
+
+    Hs256Key(const Hs256Key&) = delete;
+    Hs256Key& operator=(const Hs256Key&) = delete;
+
+    bool valid() const { return ok_; }
+
+    /** HMAC-SHA256 of message into out (HS256_BYTES). */
+    bool mac(const uint8_t* message, size_t length, uint8_t* out) const {
+        // Per-thread scratch state, so the shared pre-hashed states stay read-only
+        thread_local Scratch scratch;
+        uint8_t innerHash[HS256_BYTES];
+        unsigned int len = 0;
+        return ok_ && scratch.ctx != nullptr &&
+               EVP_MD_CTX_copy_ex(scratch.ctx, inner_) == 1 &&
+               EVP_DigestUpdate(scratch.ctx, message, length) == 1 &&
+               EVP_DigestFinal_ex(scratch.ctx, innerHash, &len) == 1 &&
+               EVP_MD_CTX_copy_ex(scratch.ctx, outer_) == 1 &&
+               EVP_DigestUpdate(scratch.ctx, innerHash, sizeof(innerHash)) == 1 &&
+               EVP_DigestFinal_ex(scratch.ctx, out, &len) == 1;
+    }
+
+private:
+    struct Scratch {
+        EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+        ~Scratch() { EVP_MD_CTX_free(ctx); }
+    };
+
+    EVP_MD_CTX* inner_;
+    EVP_MD_CTX* outer_;
+    bool ok_ = true;
+};
+
+// ============================================================================
+// VERIFICATION
+// ============================================================================
+
+/**
+ * Verify an HS256 token and decode its header and payload into out:
+ * header bytes, then payload bytes (headerLen and payloadLen set on
+ * JWT_OK). Nothing in out may be used unless JWT_OK.
+ */
+inline int32_t verify(const Hs256Key& key, const char* token, size_t length, uint8_t* out, size_t capacity,
+                      uint64_t* headerLen, uint64_t* payloadLen) {
+    const char* firstDot = static_cast<const char*>(memchr(token, '.', length));
+    if (firstDot == nullptr) {
+        return JWT_MALFORMED;
+    }
+    const char* payload = firstDot + 1;
+    const char* secondDot = static_cast<const char*>(memchr(payload, '.', length - (payload - token)));
+    if (secondDot == nullptr) {
+        return JWT_MALFORMED;
+    }
+    const char* signature = secondDot + 1;
+    const size_t signatureLen = length - (signature - token);
+    if (memchr(signature, '.', signatureLen) != nullptr ||
+        base64UrlDecodedLength(signatureLen) != static_cast<int64_t>(HS256_BYTES)) {
+        return JWT_MALFORMED;
+    }
+
+    uint8_t claimed[HS256_BYTES];
+    uint8_t expected[HS256_BYTES];
+    if (base64UrlDecode(signature, signatureLen, claimed) < 0) {
+        return JWT_MALFORMED;
+    }
+    if (!key.mac(reinterpret_cast<const uint8_t*>(token), static_cast<size_t>(secondDot - token), expected)) {
+        return JWT_ERROR;
+    }
+    if (CRYPTO_memcmp(claimed, expected, HS256_BYTES) != 0) {
+        return JWT_BAD_SIGNATURE;
+    }
+
+    const size_t headerChars = static_cast<size_t>(firstDot - token);
+    const size_t payloadChars = static_cast<size_t>(secondDot - payload);
+    const int64_t headerBytes = base64UrlDecodedLength(headerChars);
+    const int64_t payloadBytes = base64UrlDecodedLength(payloadChars);
+    if (headerBytes <= 0 || payloadBytes <= 0) {
+        return JWT_MALFORMED;
+    }
+    if (static_cast<uint64_t>(headerBytes + payloadBytes) > capacity) {
+        return JWT_TOO_LARGE;
+    }
+    if (base64UrlDecode(token, headerChars, out) < 0 ||
+        base64UrlDecode(payload, payloadChars, out + headerBytes) < 0) {
+        return JWT_MALFORMED;
+    }
+    *headerLen = static_cast<uint64_t>(headerBytes);
+    *payloadLen = static_cast<uint64_t>(payloadBytes);
+    return JWT_OK;
+}
+
+}  // namespace jwt
+}  // namespace pulsemind
+
+#endif  // PULSEMIND_JWT_HS256_H
@@ -0,0 +1,711 @@
+#ifndef PULSEMIND_LOG_RING_H
+#define PULSEMIND_LOG_RING_H
+
+/**
+ * Structured JSON logging off the request path.
+ *
+ * A producer (a request thread) copies the rendered record into a slot of a
+ * bounded multi-producer, single-consumer ring and returns: one CAS to claim
+ * the slot, a memcpy, one release store. Nothing is formatted, allocated or
+ * locked there. When the ring is full the record is dropped and counted,
+ * since logging must never stall a pacing decision.
+ *
+ * One consumer thread per LogSink drains the ring. For each record it
+ * - scrubs PHI: PhiMatcher is an Aho-Corasick automaton over the PHI field
+ *   names (ASCII case-insensitive), compiled into a full DFA, so a message
+ *   is scanned once, one table lookup per byte, however many names there
+ *   are. A hit replaces the whole message, as the Python formatter does.
+ * - formats the JSON line the Python formatter (shared/logger.py) writes:
+ *   same keys, key order and json.dumps escaping (ensure_ascii), except that
+ *   the timestamp is the record's creation time, always with microseconds.
+ * - batches lines and writes them with one write() per batch.
+ *
+ * The consumer naps between drains (LOG_NAP_US) and is woken only when it
+ * has gone to sleep for good (after LOG_IDLE_NAPS empty naps) or the ring
+ * fills past half, so a busy producer does not pay for a wake-up per record.
+ *
+ * LogRateLimiter bounds hot-path call sites: every Nth record (sampling)
+ * and/or a GCRA token bucket of rate and burst, both lock-free. A record let
+ * through reports how many were suppressed before it.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace pulsemind {
+namespace logring {
+
+// ============================================================================
+// CONSTANTS
+// ============================================================================
+
+/** Bytes per ring slot: header plus service, extra, message and exc_info text. */
+constexpr size_t LOG_SLOT_BYTES = 1024;
+constexpr size_t LOG_MAX_SERVICE_BYTES = 64;
+
+constexpr uint32_t DEFAULT_LOG_CAPACITY = 4096;
+constexpr uint32_t MAX_LOG_CAPACITY = 1u << 20;
+
+/** Lines are written once this much is batched, or when the ring runs dry. */
+constexpr size_t LOG_WRITE_BATCH_BYTES = 64 * 1024;
+
+constexpr int64_t LOG_NAP_US = 5000;
+constexpr int LOG_IDLE_NAPS = 200;
+
+constexpr const char* REDACTED_MESSAGE = "[REDACTED_POTENTIAL_PHI]";
+
+/** Python logging levels. */
+inline const char* levelName(int level) {
+    switch (level) {
+        case 10: return "DEBUG";
+        case 20: return "INFO";
+        case 30: return "WARNING";
+        case 40: return "ERROR";
+        case 50: return "CRITICAL";
+        default: return nullptr;
+    }
+}
+
+// ============================================================================
+// PHI MATCHER
+// ============================================================================
+
+/**
+ * Multi-pattern substring matcher (Aho-Corasick), ASCII case-insensitive.
+ */
+class PhiMatcher {
+public:
+    static constexpr size_t MAX_STATES = 4096;
+
+    /** Compile the patterns (lowercased); false if they need too many states. */
+    bool build(const std::vector<std::string>& patterns) {
+        std::vector<int32_t> trie(256, -1);
+        std::vector<uint8_t> accept(1, 0);
+        for (const std::string& pattern : patterns) {
+            if (pattern.empty()) {
+                continue;
+            }
+            int32_t state = 0;
+            for (char c : pattern) {
+                const uint8_t b = fold(static_cast<uint8_t>(c));
+                int32_t& next = trie[static_cast<size_t>(state) * 256 + b];
+                if (next < 0) {
+                    if (accept.size() >= MAX_STATES) {
+                        return false;
+                    }
+                    next = static_cast<int32_t>(accept.size());
+                    accept.push_back(0);
+                    trie.resize(accept.size() * 256, -1);
+                }
+                state = trie[static_cast<size_t>(state) * 256 + b];
+            }
+            accept[static_cast<size_t>(state)] = 1;
+        }
+
+        // Breadth-first: fill missing transitions from the failure state,
+        // turning the trie into a DFA; a state accepts if its failure does
+        std::vector<int32_t> fail(accept.size(), 0);
+        std::vector<int32_t> queue;
+        for (size_t b = 0; b < 256; b++) {
+            int32_t& next = trie[b];
+            if (next < 0) {
+                next = 0;
+            } else {
+                queue.push_back(next);
+            }
+        }
+        for (size_t i = 0; i < queue.size(); i++) {
+            const int32_t state = queue[i];
+            accept[static_cast<size_t>(state)] |= accept[static_cast<size_t>(fail[static_cast<size_t>(state)])];
+            for (size_t b = 0; b < 256; b++) {
+                int32_t& next = trie[static_cast<size_t>(state) * 256 + b];
+                const int32_t viaFail = trie[static_cast<size_t>(fail[static_cast<size_t>(state)]) * 256 + b];
+                if (next < 0) {
+                    next = viaFail;
+                } else {
+                    fail[static_cast<size_t>(next)] = viaFail;
+                    queue.push_back(next);
+                }
+            }
+        }
+
+        // Upper-case input follows the lower-case transitions
+        for (size_t state = 0; state < accept.size(); state++) {
+            for (uint8_t b = 'A'; b <= 'Z'; b++) {
+                trie[state * 256 + b] = trie[state * 256 + fold(b)];
+            }
+        }
+        next_ = std::move(trie);
+        accept_ = std::move(accept);
+        return true;
+    }
+
+    bool empty() const { return accept_.size() <= 1; }
+
+    /** True if any pattern occurs in s. */
+    bool matches(const char* s, size_t n) const {
+        if (empty()) {
+            return false;
+        }
+        const int32_t* next = next_.data();
+        const uint8_t* accept = accept_.data();
+        int32_t state = 0;
+        for (size_t i = 0; i < n; i++) {
+            state = next[static_cast<size_t>(state) * 256 + static_cast<uint8_t>(s[i])];
+            if (accept[state]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    static uint8_t fold(uint8_t b) { return (b >= 'A' && b <= 'Z') ? static_cast<uint8_t>(b + 32) : b; }
+
+    std::vector<int32_t> next_;
+    std::vector<uint8_t> accept_;
+};
+
+// ============================================================================
+// JSON FORMATTING
+// ============================================================================
+
+inline void appendHex4(std::string& out, uint32_t v) {
+    static const char digits[] = "0123456789abcdef";
+    char buf[6] = {'\\', 'u', digits[(v >> 12) & 0xF], digits[(v >> 8) & 0xF], digits[(v >> 4) & 0xF],
+                   digits[v & 0xF]};
+    out.append(buf, 6);
+}
+
+/**
+ * Append s (UTF-8) as a JSON string the way Python's json.dumps does with
+ * ensure_ascii: non-ASCII as \uXXXX (surrogate pairs above U+FFFF). Invalid
+ * bytes become U+FFFD.
+ */
+inline void appendJsonString(std::string& out, const char* s, size_t n) {
+    out.push_back('"');
+    size_t i = 0;
+    while (i < n) {
+        const uint8_t b = static_cast<uint8_t>(s[i]);
+        if (b < 0x80) {
+            switch (b) {
+                case '"': out.append("\\\""); break;
+                case '\\': out.append("\\\\"); break;
+                case '\n': out.append("\\n"); break;
+                case '\r': out.append("\\r"); break;
+                case '\t': out.append("\\t"); break;
+                case '\b': out.append("\\b"); break;
+                case '\f': out.append("\\f"); break;
+                default:
+                    if (b < 0x20) {
+                        appendHex4(out, b);
+                    } else {
+                        out.push_back(static_cast<char>(b));
+                    }
+            }
+            i++;
+            continue;
+        }
+
+        // Multi-byte sequence; surrogates (from Python's surrogatepass) pass
+        size_t len = 0;
+        uint32_t cp = 0;
+        uint32_t min = 0;
+        if ((b & 0xE0) == 0xC0) {
+            len = 2;
+            cp = b & 0x1F;
+            min = 0x80;
+        } else if ((b & 0xF0) == 0xE0) {
+            len = 3;
+            cp = b & 0x0F;
+            min = 0x800;
+        } else if ((b & 0xF8) == 0xF0) {
+            len = 4;
+            cp = b & 0x07;
+            min = 0x10000;
+        }
+        bool valid = len != 0 && i + len <= n;
+        for (size_t k = 1; valid && k < len; k++) {
+            const uint8_t c = static_cast<uint8_t>(s[i + k]);
+            valid = (c & 0xC0) == 0x80;
+            cp = (cp << 6) | (c & 0x3F);
+        }
+        if (!valid || cp < min || cp > 0x10FFFF) {
+            appendHex4(out, 0xFFFD);
+            i++;
+            continue;
+        }
+        if (cp >= 0x10000) {
+            cp -= 0x10000;
+            appendHex4(out, 0xD800 | (cp >> 10));
+            appendHex4(out, 0xDC00 | (cp & 0x3FF));
+        } else {
+            appendHex4(out, cp);
+        }
+        i += len;
+    }
+    out.push_back('"');
+}
+
+/** Length of the longest prefix of s[0..n) not ending inside a UTF-8 sequence. */
+inline size_t utf8Prefix(const char* s, size_t n) {
+    size_t end = n;
+    size_t back = 0;
+    while (end > 0 && back < 3 && (static_cast<uint8_t>(s[end - 1]) & 0xC0) == 0x80) {
+        end--;
+        back++;
+    }
+    if (end == 0) {
+        return n;
+    }
+    const uint8_t lead = static_cast<uint8_t>(s[end - 1]);
+    size_t need = 1;
+    if ((lead & 0xE0) == 0xC0) {
+        need = 2;
+    } else if ((lead & 0xF0) == 0xE0) {
+        need = 3;
+    } else if ((lead & 0xF8) == 0xF0) {
+        need = 4;
+    }
+    return (need > 1 && back + 1 < need) ? end - 1 : n;
+}
+
+/** "YYYY-MM-DDTHH:MM:SS.ffffffZ" for a UTC epoch time in microseconds. */
+class TimestampFormatter {
+public:
+    void append(std::string& out, int64_t timeUs) {
+        int64_t seconds = timeUs / 1000000;
+        int64_t micros = timeUs % 1000000;
+        if (micros < 0) {
+            micros += 1000000;
+            seconds--;
+        }
+        if (seconds != cachedSecond_) {
+            const time_t t = static_cast<time_t>(seconds);
+            struct tm tm;
+            gmtime_r(&t, &tm);
+            strftime(prefix_, sizeof(prefix_), "%Y-%m-%dT%H:%M:%S.", &tm);
+            cachedSecond_ = seconds;
+        }
+        char buf[8];
+        for (int k = 5; k >= 0; k--) {
+            buf[k] = static_cast<char>('0' + micros % 10);
+            micros /= 10;
+        }
+        buf[6] = 'Z';
+        out.append(prefix_);
+        out.append(buf, 7);
+    }
+
+private:
+    int64_t cachedSecond_ = INT64_MIN;
+    char prefix_[32] = {0};
+};
+
+// ============================================================================
+// RING
+// ============================================================================
+
+struct LogSlot {
+    std::atomic<uint64_t> seq;
+    int64_t timeUs;
+    int32_t level;
+    uint16_t serviceLen;
+    uint16_t extraLen;
+    uint16_t messageLen;
+    uint16_t excLen;
+    uint8_t truncated;
+    char text[LOG_SLOT_BYTES - 32];  // service | extra | message | exc_info
+};
+static_assert(sizeof(LogSlot) == LOG_SLOT_BYTES, "LogSlot layout");
+
+struct LogStats {
+    uint64_t submitted;
+    uint64_t dropped;
+    uint64_t written;
+    uint64_t redacted;
+    uint64_t truncated;
+    uint64_t bytes;
+    uint64_t writeErrors;
+};
+
+/**
+ * A ring and its consumer thread writing JSON lines to a file descriptor.
+ *
+ * Configure (setPhiPatterns) before start(). submit() may be called from any
+ * number of threads; records submitted before start() wait in the ring.
+ */
+class LogSink {
+public:
+    LogSink(int fd, uint32_t capacity)
+        : fd_(fd), capacity_(roundCapacity(capacity)), mask_(capacity_ - 1), slots_(new LogSlot[capacity_]) {
+        for (uint64_t i = 0; i < capacity_; i++) {
+            slots_[i].seq.store(i, std::memory_order_relaxed);
+        }
+        out_.reserve(LOG_WRITE_BATCH_BYTES + LOG_SLOT_BYTES * 8);
+    }
+
+    ~LogSink() {
+        stop();
+        delete[] slots_;
+    }
+
+    LogSink(const LogSink&) = delete;
+    LogSink& operator=(const LogSink&) = delete;
+
+    bool setPhiPatterns(const std::vector<std::string>& patterns) { return matcher_.build(patterns); }
+
+    uint32_t capacity() const { return static_cast<uint32_t>(capacity_); }
+
+    void start() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!thread_.joinable()) {
+            stopping_.store(false);
+            thread_ = std::thread([this] { run(); });
+        }
+    }
+
+    /** Drain what is queued, then stop the consumer. */
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!thread_.joinable()) {
+                return;
+            }
+            stopping_.store(true);
+            wake_.notify_one();
+        }
+        thread_.join();
+    }
+
+    /**
+     * Queue one record; false if the ring is full (the record is dropped).
+     * Text that does not fit a slot is cut; extra is all or nothing, since it
+     * is a pre-rendered JSON fragment ("key": value, ...).
+     */
+    bool submit(int64_t timeUs, int level, const char* service, size_t serviceLen, const char* extra, size_t extraLen,
+                const char* message, size_t messageLen, const char* exc, size_t excLen) {
+        uint64_t pos = tail_.load(std::memory_order_relaxed);
+        LogSlot* slot;
+        for (;;) {
+            slot = &slots_[pos & mask_];
+            const uint64_t seq = slot->seq.load(std::memory_order_acquire);
+            const int64_t diff = static_cast<int64_t>(seq - pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->timeUs = timeUs;
+        slot->level = level;
+        bool truncated = false;
+        size_t room = sizeof(slot->text);
+        char* text = slot->text;
+        auto put = [&](const char* s, size_t n, bool utf8) -> uint16_t {
+            if (n > room) {
+                n = utf8 ? utf8Prefix(s, room) : room;
+                truncated = true;
+            }
+            memcpy(text, s, n);
+            text += n;
+            room -= n;
+            return static_cast<uint16_t>(n);
+        };
+        slot->serviceLen = put(service, serviceLen < LOG_MAX_SERVICE_BYTES ? serviceLen : LOG_MAX_SERVICE_BYTES, true);
+        if (extraLen <= room / 2) {
+            slot->extraLen = put(extra, extraLen, false);
+        } else {
+            slot->extraLen = 0;
+            truncated = extraLen > 0;
+        }
+        slot->messageLen = put(message, messageLen, true);
+        slot->excLen = put(exc, excLen, true);
+        slot->truncated = truncated;
+        slot->seq.store(pos + 1, std::memory_order_release);
+        submitted_.fetch_add(1, std::memory_order_relaxed);
+
+        // Pairs with the fence in run(): either the consumer sees this slot
+        // before sleeping, or this sees it asleep and wakes it
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int sleeping = sleeping_.load(std::memory_order_relaxed);
+        if (sleeping == DEEP ||
+            (sleeping == NAP && pos - head_.load(std::memory_order_relaxed) >= capacity_ / 2)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wake_.notify_one();
+        }
+        return true;
+    }
+
+    /**
+     * Wait until every record submitted before the call has been written;
+     * false on timeout (or if the consumer is not running).
+     */
+    bool flush(int64_t timeoutMs) {
+        const uint64_t target = tail_.load(std::memory_order_acquire);
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!thread_.joinable()) {
+            return consumed_.load() >= target;
+        }
+        flushTarget_ = target > flushTarget_ ? target : flushTarget_;
+        wake_.notify_one();
+        return flushed_.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                                 [&] { return consumed_.load() >= target; });
+    }
+
+    LogStats stats() const {
+        return LogStats{submitted_.load(), dropped_.load(), written_.load(), redacted_.load(),
+                        truncated_.load(), bytes_.load(), writeErrors_.load()};
+    }
+
+private:
+    enum Sleep { AWAKE = 0, NAP = 1, DEEP = 2 };
+
+    static uint64_t roundCapacity(uint32_t capacity) {
+        uint64_t c = 16;
+        const uint64_t want = capacity < MAX_LOG_CAPACITY ? capacity : MAX_LOG_CAPACITY;
+        while (c < want) {
+            c <<= 1;
+        }
+        return c;
+    }
+
+    bool ready() const {
+        const LogSlot& slot = slots_[head_.load(std::memory_order_relaxed) & mask_];
+        return slot.seq.load(std::memory_order_acquire) == head_.load(std::memory_order_relaxed) + 1;
+    }
+
+    void run() {
+        int emptyNaps = 0;
+        uint64_t droppedReported = 0;
+        for (;;) {
+            bool any = false;
+            while (ready()) {
+                const uint64_t head = head_.load(std::memory_order_relaxed);
+                LogSlot& slot = slots_[head & mask_];
+                format(slot);
+                slot.seq.store(head + capacity_, std::memory_order_release);
+                head_.store(head + 1, std::memory_order_relaxed);
+                any = true;
+                if (out_.size() >= LOG_WRITE_BATCH_BYTES) {
+                    writeOut();
+                }
+            }
+            const uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+            if (dropped != droppedReported) {
+                reportDropped(dropped - droppedReported);
+                droppedReported = dropped;
+            }
+            writeOut();
+            consumed_.store(head_.load(std::memory_order_relaxed));
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (consumed_.load() >= flushTarget_) {
+                flushed_.notify_all();
+            }
+            if (stopping_.load()) {
+                if (!ready()) {
+                    return;
+                }
+                continue;
+            }
+            if (consumed_.load() < flushTarget_) {
+                continue;
+            }
+            emptyNaps = any ? 0 : emptyNaps + 1;
+            const Sleep mode = emptyNaps >= LOG_IDLE_NAPS ? DEEP : NAP;
+            sleeping_.store(mode, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!ready()) {
+                if (mode == DEEP) {
+                    wake_.wait(lock);
+                } else {
+                    wake_.wait_for(lock, std::chrono::microseconds(LOG_NAP_US));
+                }
+            }
+            sleeping_.store(AWAKE, std::memory_order_relaxed);
+        }
+    }
+
+    void appendPrefix(int64_t timeUs, int level, const char* service, size_t serviceLen) {
+        out_.append("{\"timestamp\": \"");
+        timestamps_.append(out_, timeUs);
+        out_.append("\", \"level\": ");
+        if (const char* name = levelName(level)) {
+            out_.push_back('"');
+            out_.append(name);
+            out_.push_back('"');
+        } else {
+            const std::string custom = "Level " + std::to_string(level);
+            appendJsonString(out_, custom.data(), custom.size());
+        }
+        out_.append(", \"service\": ");
+        appendJsonString(out_, service, serviceLen);
+    }
+
+    void format(const LogSlot& slot) {
+        const char* service = slot.text;
+        const char* extra = service + slot.serviceLen;
+        const char* message = extra + slot.extraLen;
+        const char* exc = message + slot.messageLen;
+
+        appendPrefix(slot.timeUs, slot.level, slot.serviceLen ? service : "unknown",
+                     slot.serviceLen ? slot.serviceLen : 7);
+        out_.append(", \"message\": ");
+        if (matcher_.matches(message, slot.messageLen)) {
+            appendJsonString(out_, REDACTED_MESSAGE, strlen(REDACTED_MESSAGE));
+            redacted_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            appendJsonString(out_, message, slot.messageLen);
+        }
+        if (slot.excLen > 0) {
+            out_.append(", \"exc_info\": ");
+            appendJsonString(out_, exc, slot.excLen);
+        }
+        if (slot.extraLen > 0) {
+            out_.append(", ");
+            out_.append(extra, slot.extraLen);
+        }
+        if (slot.truncated) {
+            out_.append(", \"truncated\": true");
+            truncated_.fetch_add(1, std::memory_order_relaxed);
+        }
+        out_.append("}\n");
+        written_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void reportDropped(uint64_t count) {
+        const std::string message = "log ring full: " + std::to_string(count) + " record(s) dropped";
+        const int64_t nowUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                                  std::chrono::system_clock::now().time_since_epoch())
+                                  .count();
+        appendPrefix(nowUs, 30, "logger", 6);
+        out_.append(", \"message\": ");
+        appendJsonString(out_, message.data(), message.size());
+        out_.append("}\n");
+    }
+
+    void writeOut() {
+        size_t done = 0;
+        while (done < out_.size()) {
+            const ssize_t n = ::write(fd_, out_.data() + done, out_.size() - done);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                writeErrors_.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+            done += static_cast<size_t>(n);
+        }
+        bytes_.fetch_add(done, std::memory_order_relaxed);
+        out_.clear();
+    }
+
+    const int fd_;
+    const uint64_t capacity_;
+    const uint64_t mask_;
+    LogSlot* const slots_;
+    PhiMatcher matcher_;
+
+    alignas(64) std::atomic<uint64_t> tail_{0};
+    alignas(64) std::atomic<uint64_t> head_{0};
+    std::atomic<int> sleeping_{AWAKE};
+    std::atomic<uint64_t> consumed_{0};
+
+    std::atomic<uint64_t> submitted_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> redacted_{0};
+    std::atomic<uint64_t> truncated_{0};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> writeErrors_{0};
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable flushed_;
+    uint64_t flushTarget_ = 0;
+    std::atomic<bool> stopping_{false};
+    std::thread thread_;
+
+    // Consumer only
+    std::string out_;
+    TimestampFormatter timestamps_;
+};
+
+// ============================================================================
+// RATE LIMITER
+// ============================================================================
+
+/**
+ * Admission for one hot-path call site.
+ *
+ * sampleEvery N keeps every Nth record (1: all). ratePerSecond > 0 adds a
+ * GCRA bucket: records are spaced 1/rate apart on a virtual schedule that
+ * may run up to burst records ahead of now.
+ */
+class LogRateLimiter {
+public:
+    LogRateLimiter() = default;
+
+    void configure(double ratePerSecond, double burst, uint32_t sampleEvery) {
+        intervalNs_ = ratePerSecond > 0 ? static_cast<int64_t>(1e9 / ratePerSecond) : 0;
+        toleranceNs_ = intervalNs_ * static_cast<int64_t>(burst > 1 ? burst - 1 : 0);
+        sampleEvery_ = sampleEvery > 0 ? sampleEvery : 1;
+        tat_.store(INT64_MIN);
+        seen_.store(0);
+        suppressed_.store(0);
+    }
+
+    /** -1 to drop the record, else the number dropped since the last one kept. */
+    int64_t allow(int64_t nowNs) {
+        if (sampleEvery_ > 1 && seen_.fetch_add(1, std::memory_order_relaxed) % sampleEvery_ != 0) {
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            return -1;
+        }
+        if (intervalNs_ > 0) {
+            int64_t tat = tat_.load(std::memory_order_relaxed);
+            for (;;) {
+                const int64_t start = tat > nowNs ? tat : nowNs;
+                if (start - nowNs > toleranceNs_) {
+                    suppressed_.fetch_add(1, std::memory_order_relaxed);
+                    return -1;
+                }
+                if (tat_.compare_exchange_weak(tat, start + intervalNs_, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+        }
+        return static_cast<int64_t>(suppressed_.exchange(0, std::memory_order_relaxed));
+    }
+
+private:
+    int64_t intervalNs_ = 0;
+    int64_t toleranceNs_ = 0;
+    uint32_t sampleEvery_ = 1;
+    std::atomic<int64_t> tat_{INT64_MIN};
+    std::atomic<uint64_t> seen_{0};
+    std::atomic<uint64_t> suppressed_{0};
+};
+
+}  // namespace logring
+}  // namespace pulsemind
+
+#endif  // PULSEMIND_LOG_RING_H
@@ -0,0 +1,537 @@
+#ifndef PULSEMIND_METRICS_H
+#define PULSEMIND_METRICS_H
+
+/**
+ * Prometheus-style counters, gauges and latency histograms, cheap enough to
+ * record on every hot path.
+ *
+ * A Registry holds a block of 64-bit cells per shard (METRIC_SHARDS of
+ * them). Each thread is bound to one shard on first use, so recording a
+ * counter increment or a histogram sample is one relaxed fetch_add on a
+ * cache line no other thread normally writes to: no lock, no allocation and
+ * no lookup, since a metric's handle is its cell offset. A scrape sums the
+ * shards.
+ *
+ * - Counter: one cell per shard.
+ * - Gauge: one cell (in shard 0) holding a double; set is a store and add a
+ *   CAS loop.
+ * - Histogram: log-linear buckets over integer microseconds, as in
+ *   HdrHistogram: HISTOGRAM_SUB_BUCKETS per power of two, so a bucket is
+ *   within 12.5% of its values from 1 us to 2^36 us. A sum cell follows
+ *   the buckets. The exposition collapses the buckets onto fixed le bounds
+ *   (powers of 4 us); quantile() reads the fine buckets.
+ *
+ * Registering a series (name, help and labels) takes a mutex, and
+ * registering the same series again returns the same handle. render()
+ * writes the text exposition format (version 0.0.4).
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace pulsemind {
+namespace metrics {
+
+// ============================================================================
+// CONSTANTS
+// ============================================================================
+
+constexpr uint32_t METRIC_SHARDS = 16;
+
+/** Cells per shard; a counter or gauge takes one, a histogram HISTOGRAM_CELLS. */
+constexpr uint32_t DEFAULT_METRIC_CELLS = 16384;
+constexpr uint32_t MAX_METRIC_CELLS = 1u << 20;
+
+constexpr size_t MAX_METRIC_NAME_BYTES = 128;
+constexpr size_t MAX_METRIC_HELP_BYTES = 256;
+constexpr size_t MAX_METRIC_LABELS_BYTES = 256;
+
+constexpr uint32_t HISTOGRAM_SUB_BITS = 3;
+constexpr uint32_t HISTOGRAM_SUB_BUCKETS = 1u << HISTOGRAM_SUB_BITS;
+constexpr uint32_t HISTOGRAM_MAX_BITS = 36;  // Larger values land in the last bucket
+constexpr uint32_t HISTOGRAM_BUCKETS = (HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS;
+constexpr uint32_t HISTOGRAM_CELLS = HISTOGRAM_BUCKETS + 1;  // Buckets, then the sum
+
+/** Exposition le bounds: 4^0 .. 4^HISTOGRAM_LE_STEPS microseconds (1 us to 67 s). */
+constexpr uint32_t HISTOGRAM_LE_STEPS = 13;
+
+constexpr const char* CONTENT_TYPE = "text/plain; version=0.0.4; charset=utf-8";
+
+enum class MetricType : uint8_t { Counter = 0, Gauge = 1, Histogram = 2 };
+
+inline const char* typeName(MetricType type) {
+    switch (type) {
+        case MetricType::Counter: return "counter";
+        case MetricType::Gauge: return "gauge";
+        case MetricType::Histogram: return "histogram";
+    }
+    return "untyped";
+}
+
+/** Registry counters, for the C ABI. */
+struct MetricsStats {
+    uint64_t families;
+    uint64_t series;
+    uint64_t cellsUsed;
+    uint64_t cellsCapacity;
+    uint64_t rejected;  // Registrations refused: invalid, conflicting or out of cells
+};
+
+// ============================================================================
+// HISTOGRAM BUCKETS
+// ============================================================================
+
+/**
+ * Bucket of a value in microseconds. Bucket b holds the values above
+ * histogramBound(b - 1) up to histogramBound(b), so every power of two is
+ * a bucket's upper bound.
+ */
+inline uint32_t histogramBucket(uint64_t us) {
+    const uint64_t v = us ? us - 1 : 0;
+    if (v < HISTOGRAM_SUB_BUCKETS) {
+        return static_cast<uint32_t>(v);
+    }
+    const uint32_t e = 63 - static_cast<uint32_t>(__builtin_clzll(v));
+    const uint32_t b = (e - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS +
+                       static_cast<uint32_t>((v >> (e - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_BUCKETS - 1));
+    return b < HISTOGRAM_BUCKETS ? b : HISTOGRAM_BUCKETS - 1;
+}
+
+/** Largest value (microseconds) bucket b holds. */
+inline uint64_t histogramBound(uint32_t b) {
+    if (b < HISTOGRAM_SUB_BUCKETS) {
+        return b + 1;
+    }
+    const uint32_t shift = b / HISTOGRAM_SUB_BUCKETS - 1;
+    return ((static_cast<uint64_t>(HISTOGRAM_SUB_BUCKETS + b % HISTOGRAM_SUB_BUCKETS)) << shift) + (1ull << shift);
+}
+
+// ============================================================================
+// EXPOSITION TEXT
+// ============================================================================
+
+inline bool validMetricName(std::string_view name) {
+    if (name.empty() || name.size() > MAX_METRIC_NAME_BYTES) {
+        return false;
+    }
+    for (size_t i = 0; i < name.size(); i++) {
+        const char c = name[i];
+        const bool alpha = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == ':';
+        if (!alpha && !(i > 0 && c >= '0' && c <= '9')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Labels as they appear between the braces: name="value" pairs separated
+ * by commas, values escaped (\\, \" and \n). Empty is valid. A histogram's
+ * labels may not use le.
+ */
+inline bool validLabels(std::string_view labels, bool histogram) {
+    if (labels.size() > MAX_METRIC_LABELS_BYTES) {
+        return false;
+    }
+    size_t i = 0;
+    while (i < labels.size()) {
+        const size_t nameStart = i;
+        while (i < labels.size() && labels[i] != '=') {
+            const char c = labels[i];
+            const bool alpha = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+            if (!alpha && !(i > nameStart && c >= '0' && c <= '9')) {
+                return false;
+            }
+            i++;
+        }
+        const std::string_view labelName = labels.substr(nameStart, i - nameStart);
+        if (labelName.empty() || (histogram && labelName == "le") || labels.substr(i, 2) != "=\"") {
+            return false;
+        }
+        for (i += 2; i < labels.size() && labels[i] != '"'; i++) {
+            if (labels[i] == '\n') {
+                return false;
+            }
+            if (labels[i] == '\\') {
+                if (++i >= labels.size() || (labels[i] != '\\' && labels[i] != '"' && labels[i] != 'n')) {
+                    return false;
+                }
+            }
+        }
+        if (i >= labels.size()) {
+            return false;  // Unterminated value
+        }
+        if (++i < labels.size() && (labels[i++] != ',' || i == labels.size())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** HELP text escaping: backslash and newline. */
+inline void appendHelp(std::string& out, std::string_view help) {
+    for (char c : help) {
+        if (c == '\\') {
+            out += "\\\\";
+        } else if (c == '\n') {
+            out += "\\n";
+        } else {
+            out += c;
+        }
+    }
+}
+
+/** Microseconds as decimal seconds, exactly ("0.000250"). */
+inline void appendSeconds(std::string& out, uint64_t us) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%llu.%06llu", static_cast<unsigned long long>(us / 1000000),
+             static_cast<unsigned long long>(us % 1000000));
+    out += buf;
+}
+
+inline void appendUnsigned(std::string& out, uint64_t value) {
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%llu", static_cast<unsigned long long>(value));
+    out += buf;
+}
+
+inline void appendDouble(std::string& out, double value) {
+    if (isnan(value)) {
+        out += "NaN";
+    } else if (isinf(value)) {
+        out += value > 0 ? "+Inf" : "-Inf";
+    } else {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.15g", value);
+        out += buf;
+    }
+}
+
+// ============================================================================
+// REGISTRY
+// ============================================================================
+
+/**
+ * The shard of the calling thread, assigned round-robin on first use.
+ */
+inline uint32_t threadShard() {
+    static std::atomic<uint32_t> next{0};
+    thread_local const uint32_t shard = next.fetch_add(1, std::memory_order_relaxed) % METRIC_SHARDS;
+    return shard;
+}
+
+class Registry {
+public:
+    /** cellsPerShard is clamped to [HISTOGRAM_CELLS, MAX_METRIC_CELLS]. */
+    explicit Registry(uint32_t cellsPerShard = DEFAULT_METRIC_CELLS) {
+        cellsPerShard = std::max(HISTOGRAM_CELLS, std::min(cellsPerShard, MAX_METRIC_CELLS));
+        // Whole cache lines per shard, so shards never share one
+        lines_ = (cellsPerShard + CELLS_PER_LINE - 1) / CELLS_PER_LINE;
+        capacity_ = lines_ * CELLS_PER_LINE;
+        cells_.reset(new CellLine[static_cast<size_t>(lines_) * METRIC_SHARDS]());
+    }
+
+    Registry(const Registry&) = delete;
+    Registry& operator=(const Registry&) = delete;
+
+    /**
+     * Register a series and return its handle, or -1 if the name or labels
+     * are invalid, the name is already registered with another type, or the
+     * cells are used up. The first registration of a name sets its help.
+     */
+    int32_t add(MetricType type, std::string_view name, std::string_view help, std::string_view labels) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!validMetricName(name) || help.size() > MAX_METRIC_HELP_BYTES ||
+            !validLabels(labels, type == MetricType::Histogram)) {
+            rejected_++;
+            return -1;
+        }
+        Family* family = nullptr;
+        for (Family& f : families_) {
+            if (f.name == name) {
+                family = &f;
+                break;
+            }
+        }
+        if (family != nullptr) {
+            if (family->type != type) {
+                rejected_++;
+                return -1;
+            }
+            for (const Series& s : family->series) {
+                if (s.labels == labels) {
+                    return s.handle;
+                }
+            }
+        }
+        const uint32_t width = type == MetricType::Histogram ? HISTOGRAM_CELLS : 1;
+        if (used_ + width > capacity_) {
+            rejected_++;
+            return -1;
+        }
+        if (family == nullptr) {
+            families_.push_back(Family{std::string(name), std::string(help), type, {}});
+            family = &families_.back();
+        }
+        const int32_t handle = static_cast<int32_t>(used_);
+        used_ += width;
+        family->series.push_back(Series{handle, std::string(labels)});
+        return handle;
+    }
+
+    void counterAdd(int32_t handle, uint64_t n) {
+        if (fits(handle, 1)) {
+            cell(threadShard(), handle).fetch_add(n, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Overwrite a counter with a total counted elsewhere (a device's
+     * status). Not to be mixed with concurrent counterAdd.
+     */
+    void counterStore(int32_t handle, uint64_t total) {
+        if (!fits(handle, 1)) {
+            return;
+        }
+        for (uint32_t s = 1; s < METRIC_SHARDS; s++) {
+            cell(s, handle).store(0, std::memory_order_relaxed);
+        }
+        cell(0, handle).store(total, std::memory_order_relaxed);
+    }
+
+    void gaugeSet(int32_t handle, double value) {
+        if (fits(handle, 1)) {
+            cell(0, handle).store(toBits(value), std::memory_order_relaxed);
+        }
+    }
+
+    void gaugeAdd(int32_t handle, double delta) {
+        if (!fits(handle, 1)) {
+            return;
+        }
+        std::atomic<uint64_t>& c = cell(0, handle);
+        uint64_t old = c.load(std::memory_order_relaxed);
+        while (!c.compare_exchange_weak(old, toBits(fromBits(old) + delta), std::memory_order_relaxed)) {
+        }
+    }
+
+    void histogramRecord(int32_t handle, uint64_t us) {
+        if (fits(handle, HISTOGRAM_CELLS)) {
+            const uint32_t shard = threadShard();
+            cell(shard, handle + static_cast<int32_t>(histogramBucket(us))).fetch_add(1, std::memory_order_relaxed);
+            cell(shard, handle + static_cast<int32_t>(HISTOGRAM_BUCKETS)).fetch_add(us, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t counterValue(int32_t handle) const { return fits(handle, 1) ? sum(handle) : 0; }
+
+    double gaugeValue(int32_t handle) const {
+        return fits(handle, 1) ? fromBits(cell(0, handle).load(std::memory_order_relaxed)) : 0.0;
+    }
+
+    uint64_t histogramCount(int32_t handle) const {
+        uint64_t count = 0;
+        if (fits(handle, HISTOGRAM_CELLS)) {
+            for (uint32_t b = 0; b < HISTOGRAM_BUCKETS; b++) {
+                count += sum(handle + static_cast<int32_t>(b));
+            }
+        }
+        return count;
+    }
+
+    uint64_t histogramSum(int32_t handle) const {
+        return fits(handle, HISTOGRAM_CELLS) ? sum(handle + static_cast<int32_t>(HISTOGRAM_BUCKETS)) : 0;
+    }
+
+    /**
+     * Upper bound (microseconds) of the bucket holding quantile q (nearest
+     * rank); 0 when nothing was recorded.
+     */
+    uint64_t histogramQuantile(int32_t handle, double q) const {
+        if (!fits(handle, HISTOGRAM_CELLS)) {
+            return 0;
+        }
+        uint64_t counts[HISTOGRAM_BUCKETS];
+        uint64_t total = 0;
+        for (uint32_t b = 0; b < HISTOGRAM_BUCKETS; b++) {
+            counts[b] = sum(handle + static_cast<int32_t>(b));
+            total += counts[b];
+        }
+        if (total == 0) {
+            return 0;
+        }
+        q = q < 0 ? 0 : (q > 1 ? 1 : q);
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(ceil(q * static_cast<double>(total))));
+        uint64_t seen = 0;
+        for (uint32_t b = 0; b < HISTOGRAM_BUCKETS; b++) {
+            seen += counts[b];
+            if (seen >= rank) {
+                return histogramBound(b);
+            }
+        }
+        return histogramBound(HISTOGRAM_BUCKETS - 1);
+    }
+
+    /**
+     * Append the text exposition of every series: families in registration
+     * order, each with its HELP and TYPE lines.
+     */
+    void render(std::string& out) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const Family& f : families_) {
+            out += "# HELP ";
+            out += f.name;
+            out += ' ';
+            appendHelp(out, f.help);
+            out += "\n# TYPE ";
+            out += f.name;
+            out += ' ';
+            out += typeName(f.type);
+            out += '\n';
+            for (const Series& s : f.series) {
+                switch (f.type) {
+                    case MetricType::Counter:
+                        appendSample(out, f.name, "", s.labels);
+                        appendUnsigned(out, sum(s.handle));
+                        out += '\n';
+                        break;
+                    case MetricType::Gauge:
+                        appendSample(out, f.name, "", s.labels);
+                        appendDouble(out, fromBits(cell(0, s.handle).load(std::memory_order_relaxed)));
+                        out += '\n';
+                        break;
+                    case MetricType::Histogram:
+                        renderHistogram(out, f.name, s);
+                        break;
+                }
+            }
+        }
+    }
+
+    MetricsStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        MetricsStats st = {families_.size(), 0, used_, capacity_, rejected_};
+        for (const Family& f : families_) {
+            st.series += f.series.size();
+        }
+        return st;
+    }
+
+private:
+    static constexpr uint32_t CELLS_PER_LINE = 8;
+
+    struct alignas(64) CellLine {
+        std::atomic<uint64_t> cells[CELLS_PER_LINE];
+    };
+
+    struct Series {
+        int32_t handle;
+        std::string labels;
+    };
+
+    struct Family {
+        std::string name;
+        std::string help;
+        MetricType type;
+        std::vector<Series> series;
+    };
+
+    static uint64_t toBits(double value) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    static double fromBits(uint64_t bits) {
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    bool fits(int32_t handle, uint32_t width) const {
+        return handle >= 0 && static_cast<uint32_t>(handle) + width <= capacity_;
+    }
+
+    std::atomic<uint64_t>& cell(uint32_t shard, int32_t handle) const {
+        const uint32_t index = static_cast<uint32_t>(handle);
+        return cells_[static_cast<size_t>(shard) * lines_ + index / CELLS_PER_LINE].cells[index % CELLS_PER_LINE];
+    }
+
+    uint64_t sum(int32_t handle) const {
+        uint64_t total = 0;
+        for (uint32_t s = 0; s < METRIC_SHARDS; s++) {
+            total += cell(s, handle).load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    /** "name_suffix{labels" plus extra label, then "} " (no braces without labels). */
+    static void appendSample(std::string& out, const std::string& name, const char* suffix,
+                             const std::string& labels, const char* extra = nullptr) {
+        out += name;
+        out += suffix;
+        if (!labels.empty() || extra != nullptr) {
+            out += '{';
+            out += labels;
+            if (extra != nullptr) {
+                if (!labels.empty()) {
+                    out += ',';
+                }
+                out += extra;
+            }
+            out += '}';
+        }
+        out += ' ';
+    }
+
+    void renderHistogram(std::string& out, const std::string& name, const Series& s) const {
+        uint64_t cumulative = 0;
+        uint64_t le = 1;
+        std::string bound;
+        for (uint32_t b = 0; b < HISTOGRAM_BUCKETS; b++) {
+            cumulative += sum(s.handle + static_cast<int32_t>(b));
+            if (le <= (1ull << (2 * HISTOGRAM_LE_STEPS)) && histogramBound(b) == le) {
+                bound.assign("le=\"");
+                appendSeconds(bound, le);
+                bound += '"';
+                appendSample(out, name, "_bucket", s.labels, bound.c_str());
+                appendUnsigned(out, cumulative);
+                out += '\n';
+                le *= 4;
+            }
+        }
+        appendSample(out, name, "_bucket", s.labels, "le=\"+Inf\"");
+        appendUnsigned(out, cumulative);
+        out += '\n';
+        appendSample(out, name, "_sum", s.labels);
+        appendSeconds(out, sum(s.handle + static_cast<int32_t>(HISTOGRAM_BUCKETS)));
+        out += '\n';
+        appendSample(out, name, "_count", s.labels);
+        appendUnsigned(out, cumulative);
+        out += '\n';
+    }
+
+    uint32_t lines_;
+    uint32_t capacity_;
+    std::unique_ptr<CellLine[]> cells_;
+
+    mutable std::mutex mutex_;
+    std::vector<Family> families_;
+    uint32_t used_ = 0;
+    uint64_t rejected_ = 0;
+};
+
+}  // namespace metrics
+}  // namespace pulsemind
+
+#endif  // PULSEMIND_METRICS_H
@@ -0,0 +1,206 @@
+#ifndef PULSEMIND_PHI_CRYPTO_H
+#define PULSEMIND_PHI_CRYPTO_H
+
+/**
+ * Batched AES-256-GCM for PHI at rest.
+ *
+ * The cipher itself is OpenSSL's (libcrypto EVP): it picks the AES-NI and
+ * PCLMULQDQ (carry-less multiply for GHASH) code paths at run time, which is
+ * what makes GCM cost well under a microsecond per small record. What this
+ * header adds is the shape of the work:
+ *
+ * - one call seals or opens a whole batch of records, so the Python side
+ *   pays one ctypes crossing per batch instead of one per field;
+ * - a batch is split across worker threads (each with its own cipher
+ *   context) once it is large enough to pay for them. Called through ctypes
+ *   the GIL is released for the whole call, so decrypting a range of
+ *   journal batches really uses several cores.
+ *
+ * Every job carries its own key, so batches may mix keys (journal segments
+ * each have their own derived key, and tokens sealed under retired keys stay
+ * readable during rotation). Nonces come from the caller: the journal uses
+ * per-segment counters, tokens use random nonces.
+ */
+
+#include <openssl/evp.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace pulsemind {
+namespace phicrypto {
+
+// ============================================================================
+// CONSTANTS
+// ============================================================================
+
+constexpr size_t PHI_KEY_BYTES = 32;
+constexpr size_t PHI_NONCE_BYTES = 12;
+constexpr size_t PHI_TAG_BYTES = 16;
+
+/** A batch is split across threads only past this many bytes per thread. */
+constexpr size_t PHI_BYTES_PER_THREAD = 64 * 1024;
+constexpr unsigned PHI_MAX_THREADS = 16;
+
+/** Job status. */
+constexpr int32_t PHI_OK = 0;
+constexpr int32_t PHI_AUTH_FAILED = 1;  // Wrong key, tampered data or AAD
+constexpr int32_t PHI_ERROR = 2;        // Cipher failure or bad lengths
+
+// ============================================================================
+// SINGLE RECORDS
+// ============================================================================
+
+/**
+ * An EVP cipher context; one per thread.
+ *
+ * The expanded key (AES round keys and GHASH tables) is kept between calls,
+ * and consecutive records under the same key only set the nonce: expanding
+ * the key costs more than sealing a small record.
+ */
+class GcmContext {
+public:
+    GcmContext() : ctx_(EVP_CIPHER_CTX_new()) {}
+    ~GcmContext() { EVP_CIPHER_CTX_free(ctx_); }
+
+    GcmContext(const GcmContext&) = delete;
+    GcmContext& operator=(const GcmContext&) = delete;
+
+    bool valid() const { return ctx_ != nullptr; }
+
+    /**
+     * Encrypt in (inLen bytes) to out: inLen bytes of ciphertext followed by
+     * the PHI_TAG_BYTES tag. out may not overlap in.
+     */
+    int32_t seal(const uint8_t* key, const uint8_t* nonce, const uint8_t* aad, size_t aadLen, const uint8_t* in,
+                 size_t inLen, uint8_t* out) {
+        int len = 0;
+        if (ctx_ == nullptr || inLen > INT32_MAX || aadLen > INT32_MAX || !init(key, nonce, true) ||
+            (aadLen > 0 && EVP_EncryptUpdate(ctx_, nullptr, &len, aad, static_cast<int>(aadLen)) != 1) ||
+            (inLen > 0 && EVP_EncryptUpdate(ctx_, out, &len, in, static_cast<int>(inLen)) != 1) ||
+            EVP_EncryptFinal_ex(ctx_, out + inLen, &len) != 1 ||
+            EVP_CIPHER_CTX_ctrl(ctx_, EVP_CTRL_GCM_GET_TAG, PHI_TAG_BYTES, out + inLen) != 1) {
+            return PHI_ERROR;
+        }
+        return PHI_OK;
+    }
+
+    /**
+     * Decrypt in (ciphertext plus tag, inLen bytes) to out (inLen minus
+     * PHI_TAG_BYTES bytes). Nothing in out may be used unless PHI_OK.
+     */
+    int32_t open(const uint8_t* key, const uint8_t* nonce, const uint8_t* aad, size_t aadLen, const uint8_t* in,
+                 size_t inLen, uint8_t* out) {
+        if (inLen < PHI_TAG_BYTES) {
+            return PHI_ERROR;
+        }
+        const size_t cipherLen = inLen - PHI_TAG_BYTES;
+        int len = 0;
+        // The tag is set through a non-const pointer but only read
+        uint8_t tag[PHI_TAG_BYTES];
+        std::copy(in + cipherLen, in + inLen, tag);
+        if (ctx_ == nullptr || cipherLen > INT32_MAX || aadLen > INT32_MAX || !init(key, nonce, false) ||
+            (aadLen > 0 && EVP_DecryptUpdate(ctx_, nullptr, &len, aad, static_cast<int>(aadLen)) != 1) ||
+            (cipherLen > 0 && EVP_DecryptUpdate(ctx_, out, &len, in, static_cast<int>(cipherLen)) != 1) ||
+            EVP_CIPHER_CTX_ctrl(ctx_, EVP_CTRL_GCM_SET_TAG, PHI_TAG_BYTES, tag) != 1) {
+            return PHI_ERROR;
+        }
+        return EVP_DecryptFinal_ex(ctx_, out + cipherLen, &len) == 1 ? PHI_OK : PHI_AUTH_FAILED;
+    }
+
+private:
+    bool init(const uint8_t* key, const uint8_t* nonce, bool encrypt) {
+        const int mode = encrypt ? 1 : 0;
+        if (mode == mode_ && memcmp(key, key_, PHI_KEY_BYTES) == 0) {
+            return EVP_CipherInit_ex(ctx_, nullptr, nullptr, nullptr, nonce, mode) == 1;
+        }
+        mode_ = -1;
+        if (EVP_CipherInit_ex(ctx_, EVP_aes_256_gcm(), nullptr, key, nonce, mode) != 1) {
+            return false;
+        }
+        memcpy(key_, key, PHI_KEY_BYTES);
+        mode_ = mode;
+        return true;
+    }
+
+    EVP_CIPHER_CTX* ctx_;
+    uint8_t key_[PHI_KEY_BYTES] = {};
+    int mode_ = -1;  // 1 encrypt, 0 decrypt, -1 no key yet
+};
+
+// ============================================================================
+// BATCHES
+// ============================================================================
+
+/**
+ * One record of a batch. For seal, in is plaintext and out has room for
+ * inLen + PHI_TAG_BYTES; for open, in is ciphertext plus tag and out has
+ * room for inLen - PHI_TAG_BYTES. status is set by the batch call.
+ */
+struct GcmJob {
+    const uint8_t* key;
+    const uint8_t* nonce;
+    const uint8_t* aad;
+    uint64_t aadLen;
+    const uint8_t* in;
+    uint64_t inLen;
+    uint8_t* out;
+    int32_t status;
+};
+
+/** Threads worth using for a batch of n jobs totalling bytes (at least 1). */
+inline unsigned batchThreads(size_t n, size_t bytes, unsigned requested) {
+    unsigned threads = requested ? requested : std::thread::hardware_concurrency();
+    threads = std::min<unsigned>(std::max(threads, 1u), PHI_MAX_THREADS);
+    threads = static_cast<unsigned>(std::min<size_t>(threads, n));
+    threads = static_cast<unsigned>(std::min<size_t>(threads, bytes / PHI_BYTES_PER_THREAD + 1));
+    return std::max(threads, 1u);
+}
+
+/**
+ * Seal (encrypt = true) or open every job, on up to `threads` threads
+ * (0: one per core). Jobs are handed out one at a time from a shared
+ * counter, so uneven record sizes balance themselves. Returns the number of
+ * jobs that did not end PHI_OK.
+ */
+inline size_t runBatch(GcmJob* jobs, size_t n, bool encrypt, unsigned threads = 0) {
+    size_t bytes = 0;
+    for (size_t i = 0; i < n; i++) {
+        bytes += jobs[i].inLen;
+    }
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> failed{0};
+    auto work = [&] {
+        GcmContext ctx;
+        size_t localFailed = 0;
+        for (size_t i = next.fetch_add(1); i < n; i = next.fetch_add(1)) {
+            GcmJob& job = jobs[i];
+            job.status = encrypt ? ctx.seal(job.key, job.nonce, job.aad, job.aadLen, job.in, job.inLen, job.out)
+                                 : ctx.open(job.key, job.nonce, job.aad, job.aadLen, job.in, job.inLen, job.out);
+            localFailed += job.status != PHI_OK;
+        }
+        failed.fetch_add(localFailed);
+    };
+
+    const unsigned count = batchThreads(n, bytes, threads);
+    std::vector<std::thread> workers;
+    workers.reserve(count - 1);
+    for (unsigned t = 1; t < count; t++) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    return failed.load();
+}
+
+}  // namespace phicrypto
+}  // namespace pulsemind
+
+#endif  // PULSEMIND_PHI_CRYPTO_H
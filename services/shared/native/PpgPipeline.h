@@ -0,0 +1,475 @@
+#ifndef PULSEMIND_PPG_PIPELINE_H
+#define PULSEMIND_PPG_PIPELINE_H
+
+/**
+ * Header-only port of the per-window analysis chain:
+ *
+ *   signal-service  bandpass_filter -> detect_peaks -> extract_features
+ *   hsi-service     compute_hsi (default normalization constants)
+ *   ai-inference    RandomForestClassifier.predict_proba
+ *
+ * used by the pipeline-service to run a whole window in one call over
+ * buffers that are reused between windows, instead of four HTTP hops.
+ *
+ * Parity with the Python services:
+ * - lfilter, find_peaks (distance, then prominence) and the forest follow the
+ *   scipy/scikit-learn algorithms step by step
+ * - Sums use numpy's pairwise summation, so means and standard deviations
+ *   match numpy bit for bit (build with -ffp-contract=off)
+ * - Filter coefficients are inputs: the order-8 bandpass is ill-conditioned
+ *   in transfer-function form, so they come from the same scipy design as
+ *   bandpass_filter (a 1-ulp difference moves the output by ~1e-4)
+ *
+ * Unlike SafetyPolicy.h this is server-side code: buffers are std::vector
+ * and grow to the largest window seen, then stay allocated.
+ */
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace pulsemind {
+
+// ==========================================
+// Signal Processing Constants (signal_processor.py)
+// ==========================================
+constexpr size_t MAX_FILTER_TAPS = 16;
+
+constexpr double PEAK_MIN_DISTANCE_SEC = 0.4;
+constexpr double PEAK_PROMINENCE_FACTOR = 0.3;
+
+constexpr size_t MIN_SIGNAL_SAMPLES = 100;
+constexpr double MIN_SAMPLING_RATE_HZ = 10.0;
+
+// ==========================================
+// HSI Constants (hsi_computer.py)
+// ==========================================
+constexpr double HSI_HR_MIN = 40.0;
+constexpr double HSI_HR_MAX = 120.0;
+constexpr double HSI_HR_OPTIMAL = 70.0;
+constexpr double HSI_HRV_MIN = 10.0;
+constexpr double HSI_HRV_MAX = 100.0;
+constexpr double HSI_PULSE_AMP_MIN = 5.0;
+constexpr double HSI_PULSE_AMP_MAX = 50.0;
+constexpr double HSI_WEIGHT_HR = 0.35;
+constexpr double HSI_WEIGHT_HRV = 0.40;
+constexpr double HSI_WEIGHT_PULSE = 0.25;
+
+constexpr size_t MAX_FOREST_CLASSES = 8;
+static_assert(MAX_FOREST_CLASSES == 8, "RandomForest::predictProba sums at most 8 classes");
+
+// ==========================================
+// Numpy-Compatible Reductions
+// ==========================================
+
+/**
+ * numpy's pairwise summation (the float64 add.reduce inner loop).
+ */
+inline double pairwiseSum(const double* a, size_t n) {
+    if (n < 8) {
+        double res = 0.0;
+        for (size_t i = 0; i < n; i++) {
+            res += a[i];
+        }
+        return res;
+    }
+    if (n <= 128) {
+        double r[8];
+        for (size_t j = 0; j < 8; j++) {
+            r[j] = a[j];
+        }
+        size_t i = 8;
+        for (; i < n - (n % 8); i += 8) {
+            for (size_t j = 0; j < 8; j++) {
+                r[j] += a[i + j];
+            }
+        }
+        double res = ((r[0] + r[1]) + (r[2] + r[3])) + ((r[4] + r[5]) + (r[6] + r[7]));
+        for (; i < n; i++) {
+            res += a[i];
+        }
+        return res;
+    }
+    size_t n2 = n / 2;
+    n2 -= n2 % 8;
+    return pairwiseSum(a, n2) + pairwiseSum(a + n2, n - n2);
+}
+
+inline double numpyMean(const double* a, size_t n) {
+    return pairwiseSum(a, n) / static_cast<double>(n);
+}
+
+/**
+ * np.std(a, ddof=ddof); scratch must hold n values.
+ */
+inline double numpyStd(const double* a, size_t n, size_t ddof, double* scratch) {
+    const double mean = numpyMean(a, n);
+    for (size_t i = 0; i < n; i++) {
+        const double d = a[i] - mean;
+        scratch[i] = d * d;
+    }
+    return std::sqrt(pairwiseSum(scratch, n) / static_cast<double>(n - ddof));
+}
+
+// ==========================================
+// Bandpass Filter
+// ==========================================
+
+/**
+ * scipy.signal.lfilter(b, a, x) with zero initial conditions
+ * (direct form II transposed, 2 <= taps <= MAX_FILTER_TAPS, a[0] == 1).
+ */
+inline void lfilter(const double* b, const double* a, size_t taps, const double* x, double* y, size_t n) {
+    double z[MAX_FILTER_TAPS] = {0.0};
+    for (size_t k = 0; k < n; k++) {
+        const double xn = x[k];
+        const double yn = z[0] + b[0] * xn;
+        for (size_t i = 0; i + 2 < taps; i++) {
+            z[i] = z[i + 1] + xn * b[i + 1] - yn * a[i + 1];
+        }
+        z[taps - 2] = xn * b[taps - 1] - yn * a[taps - 1];
+        y[k] = yn;
+    }
+}
+
+// ==========================================
+// Peak Detection
+// ==========================================
+
+/**
+ * scipy.signal.find_peaks(x, distance=distance, prominence=minProminence).
+ *
+ * Ties in peak height are resolved in index order (scipy's unstable argsort
+ * may pick either); with real-valued filtered signals exact ties do not occur.
+ *
+ * @return number of peaks written to peaks
+ */
+inline size_t findPeaks(const double* x, size_t n, double distance, double minProminence,
+                        std::vector<int64_t>& peaks, std::vector<uint32_t>& order, std::vector<uint8_t>& keep) {
+    peaks.clear();
+    if (n < 3) {
+        return 0;
+    }
+
+    // Local maxima (plateaus resolve to their midpoint)
+    const size_t iMax = n - 1;
+    size_t i = 1;
+    while (i < iMax) {
+        if (x[i - 1] < x[i]) {
+            size_t ahead = i + 1;
+            while (ahead < iMax && x[ahead] == x[i]) {
+                ahead++;
+            }
+            if (x[ahead] < x[i]) {
+                peaks.push_back(static_cast<int64_t>((i + ahead - 1) / 2));
+                i = ahead;
+            }
+        }
+        i++;
+    }
+
+    // Distance: keep the highest peaks, drop neighbours closer than distance
+    const size_t count = peaks.size();
+    const double minDistance = std::ceil(distance);
+    order.resize(count);
+    keep.assign(count, 1);
+    for (size_t k = 0; k < count; k++) {
+        order[k] = static_cast<uint32_t>(k);
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](uint32_t l, uint32_t r) { return x[peaks[l]] < x[peaks[r]]; });
+    for (size_t k = count; k-- > 0;) {
+        const size_t j = order[k];
+        if (!keep[j]) {
+            continue;
+        }
+        for (size_t m = j; m-- > 0 && static_cast<double>(peaks[j] - peaks[m]) < minDistance;) {
+            keep[m] = 0;
+        }
+        for (size_t m = j + 1; m < count && static_cast<double>(peaks[m] - peaks[j]) < minDistance; m++) {
+            keep[m] = 0;
+        }
+    }
+
+    // Prominence over the whole signal (wlen=None)
+    size_t kept = 0;
+    for (size_t k = 0; k < count; k++) {
+        if (!keep[k]) {
+            continue;
+        }
+        const int64_t peak = peaks[k];
+        const double height = x[peak];
+        double leftMin = height;
+        for (int64_t m = peak; m >= 0 && x[m] <= height; m--) {
+            leftMin = std::min(leftMin, x[m]);
+        }
+        double rightMin = height;
+        for (int64_t m = peak; m < static_cast<int64_t>(n) && x[m] <= height; m++) {
+            rightMin = std::min(rightMin, x[m]);
+        }
+        if (minProminence <= height - std::max(leftMin, rightMin)) {
+            peaks[kept++] = peak;
+        }
+    }
+    peaks.resize(kept);
+    return kept;
+}
+
+// ==========================================
+// HSI
+// ==========================================
+struct HsiScore {
+    double hsiScore;
+    double hrContribution;
+    double hrvContribution;
+    double pulseContribution;
+    double normalizedHr;
+    double normalizedHrv;
+    double normalizedPulse;
+};
+
+inline double clampRange01(double v) { return std::max(0.0, std::min(1.0, v)); }
+
+/**
+ * hsi_computer.compute_hsi before rounding.
+ */
+inline HsiScore computeHsi(double hr, double hrv, double pulse) {
+    const double hrClamped = std::max(HSI_HR_MIN, std::min(HSI_HR_MAX, hr));
+    const double deviation = hrClamped < HSI_HR_OPTIMAL
+        ? (HSI_HR_OPTIMAL - hrClamped) / (HSI_HR_OPTIMAL - HSI_HR_MIN)
+        : (hrClamped - HSI_HR_OPTIMAL) / (HSI_HR_MAX - HSI_HR_OPTIMAL);
+
+    HsiScore s;
+    s.normalizedHr = clampRange01(1.0 - deviation * deviation);
+    s.normalizedHrv = clampRange01(
+        (std::max(HSI_HRV_MIN, std::min(HSI_HRV_MAX, hrv)) - HSI_HRV_MIN) / (HSI_HRV_MAX - HSI_HRV_MIN));
+    s.normalizedPulse = clampRange01(
+        (std::max(HSI_PULSE_AMP_MIN, std::min(HSI_PULSE_AMP_MAX, pulse)) - HSI_PULSE_AMP_MIN) /
+        (HSI_PULSE_AMP_MAX - HSI_PULSE_AMP_MIN));
+    s.hrContribution = HSI_WEIGHT_HR * s.normalizedHr;
+    s.hrvContribution = HSI_WEIGHT_HRV * s.normalizedHrv;
+    s.pulseContribution = HSI_WEIGHT_PULSE * s.normalizedPulse;
+    s.hsiScore = 100.0 * (s.hrContribution + s.hrvContribution + s.pulseContribution);
+    return s;
+}
+
+// ==========================================
+// Random Forest
+// ==========================================
+
+constexpr int64_t FOREST_FEATURE_COUNT = 3;  // heart_rate_bpm, hrv_sdnn_ms, pulse_amplitude
+
+/**
+ * Whether a tree's node arrays can be traversed safely: children of internal
+ * nodes lie after their parent and inside the tree (so traversal
+ * terminates), and split features are in range. Leaves have both children -1.
+ */
+inline bool validTreeLayout(size_t nodeCount, const int64_t* feature, const int64_t* left,
+                            const int64_t* right) {
+    if (nodeCount == 0) {
+        return false;
+    }
+    const int64_t count = static_cast<int64_t>(nodeCount);
+    for (int64_t i = 0; i < count; i++) {
+        if (left[i] == -1 && right[i] == -1) {
+            continue;
+        }
+        if (left[i] <= i || left[i] >= count || right[i] <= i || right[i] >= count ||
+            feature[i] < 0 || feature[i] >= FOREST_FEATURE_COUNT) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Flattened sklearn RandomForestClassifier (single output).
+ *
+ * Nodes of all trees are stored back to back; child indices are relative to
+ * the owning tree, leaves have left == -1. Leaf values are the per-class
+ * tree_.value rows.
+ */
+class RandomForest {
+public:
+    RandomForest(uint32_t numClasses) : numClasses_(numClasses) {}
+
+    void addTree(size_t nodeCount, const int64_t* feature, const double* threshold,
+                 const int64_t* left, const int64_t* right, const double* value) {
+        roots_.push_back(static_cast<uint32_t>(feature_.size()));
+        feature_.insert(feature_.end(), feature, feature + nodeCount);
+        threshold_.insert(threshold_.end(), threshold, threshold + nodeCount);
+        left_.insert(left_.end(), left, left + nodeCount);
+        right_.insert(right_.end(), right, right + nodeCount);
+        value_.insert(value_.end(), value, value + nodeCount * numClasses_);
+    }
+
+    uint32_t numClasses() const { return numClasses_; }
+    size_t numTrees() const { return roots_.size(); }
+
+    /**
+     * predict_proba for one sample; features are compared as float32,
+     * exactly like sklearn's tree traversal.
+     */
+    void predictProba(const double* x, double* proba) const {
+        double treeProba[MAX_FOREST_CLASSES];
+        for (uint32_t c = 0; c < numClasses_; c++) {
+            proba[c] = 0.0;
+        }
+        for (uint32_t root : roots_) {
+            size_t node = root;
+            while (left_[node] != -1) {
+                const double v = static_cast<double>(static_cast<float>(x[feature_[node]]));
+                node = root + static_cast<size_t>(v <= threshold_[node] ? left_[node] : right_[node]);
+            }
+            const double* leaf = &value_[node * numClasses_];
+            for (uint32_t c = 0; c < numClasses_; c++) {
+                treeProba[c] = leaf[c];
+            }
+            // pairwiseSum for n <= 8 (MAX_FOREST_CLASSES)
+            double normalizer = 0.0;
+            if (numClasses_ < 8) {
+                for (uint32_t c = 0; c < numClasses_; c++) {
+                    normalizer += treeProba[c];
+                }
+            } else {
+                normalizer = ((treeProba[0] + treeProba[1]) + (treeProba[2] + treeProba[3])) +
+                             ((treeProba[4] + treeProba[5]) + (treeProba[6] + treeProba[7]));
+            }
+            if (normalizer == 0.0) {
+                normalizer = 1.0;
+            }
+            for (uint32_t c = 0; c < numClasses_; c++) {
+                proba[c] += treeProba[c] / normalizer;
+            }
+        }
+        for (uint32_t c = 0; c < numClasses_; c++) {
+            proba[c] /= static_cast<double>(roots_.size());
+        }
+    }
+
+private:
+    uint32_t numClasses_;
+    std::vector<uint32_t> roots_;
+    std::vector<int64_t> feature_;
+    std::vector<double> threshold_;
+    std::vector<int64_t> left_;
+    std::vector<int64_t> right_;
+    std::vector<double> value_;
+};
+
+// ==========================================
+// Fused Pipeline
+// ==========================================
+enum class PipelineStatus : int32_t {
+    Ok = 0,
+    SignalTooShort = 1,        // < MIN_SIGNAL_SAMPLES
+    SamplingRateTooLow = 2,    // < MIN_SAMPLING_RATE_HZ
+    NonFiniteSample = 3,       // NaN or infinity in the signal
+    TooFewPeaks = 4,           // < 2 peaks after detection
+    InvalidForest = 5,         // No trees or too many classes
+    InvalidFilter = 6          // Tap count out of range or a[0] != 1
+};
+
+struct PipelineResult {
+    double heartRateBpm;
+    double hrvSdnnMs;
+    double pulseAmplitude;
+    uint32_t numPeaks;
+    uint32_t predictedClass;  // Index into the forest's classes
+    HsiScore hsi;
+    double probabilities[MAX_FOREST_CLASSES];
+};
+
+/**
+ * Buffers reused across windows (one per thread).
+ */
+struct PipelineWorkspace {
+    std::vector<double> filtered;
+    std::vector<double> scratch;
+    std::vector<int64_t> peaks;
+    std::vector<uint32_t> order;
+    std::vector<uint8_t> keep;
+};
+
+/**
+ * Filter, detect peaks and extract features, then score HSI and classify the
+ * rhythm from the same feature vector.
+ *
+ * The HSI and forest stages are independent of each other; both take well
+ * under a microsecond, so they run back to back rather than on two threads.
+ */
+inline PipelineStatus runPipeline(const RandomForest& forest, const double* b, const double* a, size_t taps,
+                                  const double* signal, size_t n, double samplingRate,
+                                  PipelineWorkspace& ws, PipelineResult& out) {
+    if (forest.numTrees() == 0 || forest.numClasses() == 0 || forest.numClasses() > MAX_FOREST_CLASSES) {
+        return PipelineStatus::InvalidForest;
+    }
+    if (taps < 2 || taps > MAX_FILTER_TAPS || a[0] != 1.0) {
+        return PipelineStatus::InvalidFilter;
+    }
+    if (n < MIN_SIGNAL_SAMPLES) {
+        return PipelineStatus::SignalTooShort;
+    }
+    if (!(samplingRate >= MIN_SAMPLING_RATE_HZ)) {
+        return PipelineStatus::SamplingRateTooLow;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (!std::isfinite(signal[i])) {
+            return PipelineStatus::NonFiniteSample;
+        }
+    }
+
+    // Bandpass (causal, zero initial state)
+    ws.filtered.resize(n);
+    ws.scratch.resize(n);
+    lfilter(b, a, taps, signal, ws.filtered.data(), n);
+    const double* x = ws.filtered.data();
+
+    // Peaks
+    const double distance = static_cast<double>(static_cast<int64_t>(PEAK_MIN_DISTANCE_SEC * samplingRate));
+    const double prominence = PEAK_PROMINENCE_FACTOR * numpyStd(x, n, 0, ws.scratch.data());
+    const size_t numPeaks = findPeaks(x, n, distance, prominence, ws.peaks, ws.order, ws.keep);
+    out.numPeaks = static_cast<uint32_t>(numPeaks);
+    if (numPeaks < 2) {
+        return PipelineStatus::TooFewPeaks;
+    }
+
+    // Features
+    const size_t intervals = numPeaks - 1;
+    double* intervalSec = ws.scratch.data();
+    for (size_t k = 0; k < intervals; k++) {
+        intervalSec[k] = static_cast<double>(ws.peaks[k + 1] - ws.peaks[k]) / samplingRate;
+    }
+    out.heartRateBpm = 60.0 / numpyMean(intervalSec, intervals);
+    for (size_t k = 0; k < intervals; k++) {
+        intervalSec[k] = intervalSec[k] * 1000.0;  // Now milliseconds
+    }
+    out.hrvSdnnMs = numpyStd(intervalSec, intervals, 1, intervalSec + intervals);
+
+    double* amplitudes = ws.scratch.data();
+    for (size_t k = 0; k < intervals; k++) {
+        const double* segment = x + ws.peaks[k];
+        const double trough = *std::min_element(segment, x + ws.peaks[k + 1]);
+        amplitudes[k] = x[ws.peaks[k]] - trough;
+    }
+    out.pulseAmplitude = numpyMean(amplitudes, intervals);
+
+    // HSI and rhythm classification
+    out.hsi = computeHsi(out.heartRateBpm, out.hrvSdnnMs, out.pulseAmplitude);
+    const double features[3] = {out.heartRateBpm, out.hrvSdnnMs, out.pulseAmplitude};
+    forest.predictProba(features, out.probabilities);
+    uint32_t best = 0;
+    for (uint32_t c = 1; c < forest.numClasses(); c++) {
+        if (out.probabilities[c] > out.probabilities[best]) {
+            best = c;
+        }
+    }
+    out.predictedClass = best;
+    return PipelineStatus::Ok;
+}
+
+}  // namespace pulsemind
+
+#endif  // PULSEMIND_PPG_PIPELINE_H
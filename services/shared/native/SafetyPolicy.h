@@ -0,0 +1,594 @@
+#ifndef PULSEMIND_SAFETY_POLICY_H
+#define PULSEMIND_SAFETY_POLICY_H
+
+/**
+ * Header-only port of the control-engine safety controller and adaptive
+ * pacing policy (services/control-engine/pacing_controller.py).
+ *
+ * MEDICAL SAFETY CRITICAL: This is the same finite-state logic the server
+ * runs, shared verbatim by the ESP32 firmware and the control-engine native
+ * backend so both enforce one safety envelope.
+ *
+ * Design constraints:
+ * - No heap allocation, no exceptions, no RTTI
+ * - No loops: every decision is a fixed sequence of comparisons and table
+ *   lookups, so execution time is bounded and deterministic
+ * - Command shaping (slew limit, deadband, publish coalescing) runs after
+ *   the policy and follows the same rules
+ * - Arithmetic is performed in double, in the same order as the Python
+ *   reference, so results are bit-identical (build with -ffp-contract=off)
+ *
+ * Any change here MUST be mirrored in pacing_controller.py (and vice versa);
+ * test_pacing_controller.py checks parity over the discretized input space.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+namespace pulsemind {
+
+// ==========================================
+// Safety Constants and Limits
+// ==========================================
+constexpr double ABSOLUTE_MIN_PACING_RATE = 40.0;       // BPM
+constexpr double ABSOLUTE_MAX_PACING_RATE = 180.0;      // BPM
+constexpr double ABSOLUTE_MIN_PACING_AMPLITUDE = 0.5;   // mA
+constexpr double ABSOLUTE_MAX_PACING_AMPLITUDE = 10.0;  // mA
+
+constexpr double HSI_EMERGENCY = 10.0;  // Below this: EMERGENCY state
+constexpr double HSI_CRITICAL_LOW = 30.0;
+constexpr double HSI_LOW = 50.0;
+constexpr double HSI_GOOD = 70.0;
+
+constexpr double CONFIDENCE_THRESHOLD_HIGH = 0.80;
+constexpr double CONFIDENCE_THRESHOLD_MEDIUM = 0.60;
+
+constexpr double MAX_RATE_INCREASE_PER_CYCLE = 10.0;  // BPM
+constexpr double MAX_RATE_DECREASE_PER_CYCLE = 10.0;  // BPM
+
+constexpr double EMERGENCY_PACING_RATE = 70.0;  // BPM
+constexpr uint32_t UPGRADE_REQUIRED_CYCLES = 3;
+
+// Input sanitization bounds (process_pacing_decision)
+constexpr double INPUT_MIN_HEART_RATE = 30.0;
+constexpr double INPUT_MAX_HEART_RATE = 250.0;
+
+// ==========================================
+// Enumerations (values match the Python enums)
+// ==========================================
+enum class SafetyState : uint8_t {
+    Normal = 1,
+    Degraded = 2,
+    SafeMode = 3,
+    Emergency = 4
+};
+
+enum class PacingMode : uint8_t {
+    MonitorOnly = 0,
+    Minimal = 1,
+    Moderate = 2,
+    Aggressive = 3,
+    Emergency = 4
+};
+
+enum class Rhythm : uint8_t {
+    NormalSinus = 0,
+    Bradycardia = 1,
+    Tachycardia = 2,
+    Irregular = 3,
+    Artifact = 4,
+    Unknown = 5  // Any other label
+};
+constexpr uint8_t RHYTHM_COUNT = 6;
+
+enum class Trend : uint8_t {
+    Stable = 0,
+    Improving = 1,
+    Declining = 2
+};
+
+/**
+ * Map a rhythm label to its enum. Unrecognized labels map to Unknown,
+ * matching the Python string comparisons falling through.
+ */
+inline Rhythm parseRhythm(const char* label) {
+    if (label == nullptr) return Rhythm::Unknown;
+    if (strcmp(label, "normal_sinus") == 0) return Rhythm::NormalSinus;
+    if (strcmp(label, "bradycardia") == 0) return Rhythm::Bradycardia;
+    if (strcmp(label, "tachycardia") == 0) return Rhythm::Tachycardia;
+    if (strcmp(label, "irregular") == 0) return Rhythm::Irregular;
+    if (strcmp(label, "artifact") == 0) return Rhythm::Artifact;
+    return Rhythm::Unknown;
+}
+
+/**
+ * Map a trend label to its enum. Unrecognized labels are treated as stable.
+ */
+inline Trend parseTrend(const char* label) {
+    if (label == nullptr) return Trend::Stable;
+    if (strcmp(label, "improving") == 0) return Trend::Improving;
+    if (strcmp(label, "declining") == 0) return Trend::Declining;
+    return Trend::Stable;
+}
+
+inline const char* pacingModeName(PacingMode mode) {
+    switch (mode) {
+        case PacingMode::MonitorOnly: return "monitor_only";
+        case PacingMode::Minimal: return "minimal";
+        case PacingMode::Moderate: return "moderate";
+        case PacingMode::Aggressive: return "aggressive";
+        case PacingMode::Emergency: return "emergency";
+    }
+    return "emergency";
+}
+
+inline const char* safetyStateName(SafetyState state) {
+    switch (state) {
+        case SafetyState::Normal: return "normal";
+        case SafetyState::Degraded: return "degraded";
+        case SafetyState::SafeMode: return "safe_mode";
+        case SafetyState::Emergency: return "emergency";
+    }
+    return "emergency";
+}
+
+/**
+ * Map a safety state name (safetyStateName) back to its enum; false for
+ * anything else.
+ */
+inline bool parseSafetyState(const char* label, SafetyState& state) {
+    if (label == nullptr) return false;
+    if (strcmp(label, "normal") == 0) state = SafetyState::Normal;
+    else if (strcmp(label, "degraded") == 0) state = SafetyState::Degraded;
+    else if (strcmp(label, "safe_mode") == 0) state = SafetyState::SafeMode;
+    else if (strcmp(label, "emergency") == 0) state = SafetyState::Emergency;
+    else return false;
+    return true;
+}
+
+// ==========================================
+// Clamping Helpers
+// ==========================================
+// Written to match Python's max(lo, min(hi, x)) exactly, including NaN
+// handling (a NaN input yields the upper bound, as in CPython).
+constexpr double pyMin(double a, double b) { return (b < a) ? b : a; }
+constexpr double pyMax(double a, double b) { return (b > a) ? b : a; }
+constexpr double clampRange(double x, double lo, double hi) { return pyMax(lo, pyMin(hi, x)); }
+
+constexpr double clampRate(double rate) {
+    return clampRange(rate, ABSOLUTE_MIN_PACING_RATE, ABSOLUTE_MAX_PACING_RATE);
+}
+
+constexpr double clampAmplitude(double amplitude) {
+    return clampRange(amplitude, ABSOLUTE_MIN_PACING_AMPLITUDE, ABSOLUTE_MAX_PACING_AMPLITUDE);
+}
+
+// ==========================================
+// Transition Tables
+// ==========================================
+enum class Transition : uint8_t {
+    Hold = 0,     // Same state - reset hysteresis counters
+    Degrade = 1,  // Worse state - apply immediately
+    Upgrade = 2   // Better state - requires UPGRADE_REQUIRED_CYCLES
+};
+
+// HSI bands as seen by determinePacingMode
+enum class HsiBand : uint8_t {
+    Good = 0,  // hsi >= HSI_GOOD
+    Mid = 1,   // HSI_LOW <= hsi < HSI_GOOD (and NaN, as in Python)
+    Low = 2    // hsi < HSI_LOW
+};
+constexpr uint8_t HSI_BAND_COUNT = 3;
+
+constexpr HsiBand hsiBand(double hsi) {
+    return (hsi >= HSI_GOOD) ? HsiBand::Good : (hsi < HSI_LOW) ? HsiBand::Low : HsiBand::Mid;
+}
+
+struct TransitionTable {
+    Transition entries[5][5];  // [current][proposed], index 0 unused
+};
+
+constexpr TransitionTable buildTransitionTable() {
+    TransitionTable t{};
+    for (int cur = 1; cur <= 4; cur++) {
+        for (int next = 1; next <= 4; next++) {
+            t.entries[cur][next] = (next == cur) ? Transition::Hold
+                                 : (next > cur) ? Transition::Degrade
+                                                : Transition::Upgrade;
+        }
+    }
+    return t;
+}
+
+constexpr TransitionTable TRANSITIONS = buildTransitionTable();
+
+/**
+ * Pacing mode decision logic (determine_pacing_mode):
+ * 1. Emergency state -> EMERGENCY
+ * 2. Safe mode -> MINIMAL
+ * 3. Normal sinus + good HSI -> MONITOR_ONLY
+ * 4. Declining HSI + abnormal rhythm -> AGGRESSIVE
+ * 5. Bradycardia or low HSI -> MODERATE
+ * 6. Tachycardia -> MODERATE
+ * 7. Otherwise -> MINIMAL
+ */
+constexpr PacingMode decidePacingMode(SafetyState state, Rhythm rhythm, HsiBand band, bool declining) {
+    if (state == SafetyState::Emergency) return PacingMode::Emergency;
+    if (state == SafetyState::SafeMode) return PacingMode::Minimal;
+    if (rhythm == Rhythm::NormalSinus && band == HsiBand::Good) return PacingMode::MonitorOnly;
+    if (declining && (rhythm == Rhythm::Tachycardia || rhythm == Rhythm::Bradycardia ||
+                      rhythm == Rhythm::Irregular)) {
+        return PacingMode::Aggressive;
+    }
+    if (rhythm == Rhythm::Bradycardia || band == HsiBand::Low) return PacingMode::Moderate;
+    if (rhythm == Rhythm::Tachycardia) return PacingMode::Moderate;
+    return PacingMode::Minimal;
+}
+
+struct ModeTable {
+    PacingMode entries[4][RHYTHM_COUNT][HSI_BAND_COUNT][2];  // [state-1][rhythm][band][declining]
+};
+
+constexpr ModeTable buildModeTable() {
+    ModeTable t{};
+    for (int s = 0; s < 4; s++) {
+        for (int r = 0; r < RHYTHM_COUNT; r++) {
+            for (int b = 0; b < HSI_BAND_COUNT; b++) {
+                for (int d = 0; d < 2; d++) {
+                    t.entries[s][r][b][d] = decidePacingMode(
+                        static_cast<SafetyState>(s + 1), static_cast<Rhythm>(r),
+                        static_cast<HsiBand>(b), d != 0);
+                }
+            }
+        }
+    }
+    return t;
+}
+
+constexpr ModeTable PACING_MODES = buildModeTable();
+
+static_assert(TRANSITIONS.entries[4][1] == Transition::Upgrade, "EMERGENCY must never jump to NORMAL");
+static_assert(PACING_MODES.entries[3][0][0][0] == PacingMode::Emergency, "EMERGENCY state must pace EMERGENCY");
+
+// ==========================================
+// Finite-State Safety Controller
+// ==========================================
+
+/**
+ * Controller state. Standard-layout POD so it can be snapshotted as bytes
+ * and shared with the C API (safety_policy_capi.cpp).
+ */
+struct PolicyState {
+    uint8_t currentState;  // SafetyState value
+    uint8_t hasLastRate;   // 0 until the first command is computed
+    uint8_t reserved[2];
+    uint32_t consecutiveDegradedCycles;
+    uint32_t consecutiveSafeCycles;
+    uint32_t totalSafetyViolations;
+    uint32_t totalFallbackActivations;
+    double lastPacingRate;
+    double lastPacingAmplitude;
+};
+
+inline void initPolicyState(PolicyState& s) {
+    memset(&s, 0, sizeof(s));
+    s.currentState = static_cast<uint8_t>(SafetyState::Normal);
+}
+
+/**
+ * Evaluate the safety state implied by the current inputs (evaluate_state).
+ * Increments totalSafetyViolations on EMERGENCY conditions.
+ */
+inline SafetyState evaluateState(PolicyState& s, Rhythm rhythm, double confidence, double hsi, double heartRate) {
+    if (heartRate < ABSOLUTE_MIN_PACING_RATE || heartRate > ABSOLUTE_MAX_PACING_RATE) {
+        s.totalSafetyViolations++;
+        return SafetyState::Emergency;
+    }
+    if (hsi < HSI_EMERGENCY) {
+        s.totalSafetyViolations++;
+        return SafetyState::Emergency;
+    }
+    if (confidence < CONFIDENCE_THRESHOLD_MEDIUM) return SafetyState::SafeMode;
+    if (rhythm == Rhythm::Artifact) return SafetyState::SafeMode;
+    if (hsi < HSI_CRITICAL_LOW) return SafetyState::Degraded;
+    if (confidence < CONFIDENCE_THRESHOLD_HIGH) return SafetyState::Degraded;
+    if (rhythm == Rhythm::Irregular || rhythm == Rhythm::Tachycardia || rhythm == Rhythm::Bradycardia) {
+        return SafetyState::Degraded;
+    }
+    return SafetyState::Normal;
+}
+
+/**
+ * Apply a proposed state with hysteresis (update_state): degrade immediately,
+ * upgrade only after UPGRADE_REQUIRED_CYCLES consecutive better proposals.
+ */
+inline void updateState(PolicyState& s, SafetyState proposed) {
+    const uint8_t next = static_cast<uint8_t>(proposed);
+    switch (TRANSITIONS.entries[s.currentState][next]) {
+        case Transition::Hold:
+            s.consecutiveDegradedCycles = 0;
+            s.consecutiveSafeCycles = 0;
+            return;
+        case Transition::Degrade:
+            s.currentState = next;
+            s.consecutiveDegradedCycles = 0;
+            s.consecutiveSafeCycles = 0;
+            s.totalFallbackActivations++;
+            return;
+        case Transition::Upgrade:
+            s.consecutiveSafeCycles++;
+            if (s.consecutiveSafeCycles >= UPGRADE_REQUIRED_CYCLES) {
+                s.currentState = next;
+                s.consecutiveSafeCycles = 0;
+            }
+            return;
+    }
+}
+
+// ==========================================
+// Adaptive Pacing Policy
+// ==========================================
+
+inline PacingMode determinePacingMode(Rhythm rhythm, double hsi, Trend trend, SafetyState state) {
+    return PACING_MODES.entries[static_cast<uint8_t>(state) - 1][static_cast<uint8_t>(rhythm)]
+                               [static_cast<uint8_t>(hsiBand(hsi))][trend == Trend::Declining ? 1 : 0];
+}
+
+/**
+ * Target pacing rate (compute_target_rate). Rate limiting applies only when a
+ * previous rate exists and only outside EMERGENCY / MONITOR_ONLY.
+ */
+inline double computeTargetRate(const PolicyState& s, double currentHr, Rhythm rhythm, double hsi, PacingMode mode) {
+    if (mode == PacingMode::Emergency) return clampRate(EMERGENCY_PACING_RATE);
+    if (mode == PacingMode::MonitorOnly) return clampRate(currentHr);
+
+    double baseTarget;
+    if (rhythm == Rhythm::Bradycardia) {
+        baseTarget = (hsi < HSI_CRITICAL_LOW) ? 65.0 : 70.0;
+    } else if (rhythm == Rhythm::Tachycardia) {
+        baseTarget = pyMin(currentHr, 100.0);
+    } else if (rhythm == Rhythm::Irregular) {
+        baseTarget = 70.0;
+    } else {
+        baseTarget = pyMax(60.0, pyMin(currentHr, 80.0));
+    }
+
+    double target;
+    if (mode == PacingMode::Minimal) {
+        target = currentHr + 0.25 * (baseTarget - currentHr);
+    } else if (mode == PacingMode::Moderate) {
+        target = currentHr + 0.50 * (baseTarget - currentHr);
+    } else if (mode == PacingMode::Aggressive) {
+        target = currentHr + 0.75 * (baseTarget - currentHr);
+    } else {
+        target = baseTarget;
+    }
+
+    if (s.hasLastRate) {
+        const double maxIncrease = s.lastPacingRate + MAX_RATE_INCREASE_PER_CYCLE;
+        const double maxDecrease = s.lastPacingRate - MAX_RATE_DECREASE_PER_CYCLE;
+        target = pyMax(maxDecrease, pyMin(maxIncrease, target));
+    }
+
+    return clampRate(target);
+}
+
+/**
+ * Pacing amplitude (compute_pacing_amplitude).
+ */
+inline double computePacingAmplitude(PacingMode mode, double hsi) {
+    if (mode == PacingMode::Emergency) return ABSOLUTE_MAX_PACING_AMPLITUDE;
+    if (mode == PacingMode::MonitorOnly) return 0.0;
+
+    double baseAmplitude;
+    if (hsi >= HSI_GOOD) {
+        baseAmplitude = 1.5;
+    } else if (hsi >= HSI_LOW) {
+        baseAmplitude = 2.0;
+    } else if (hsi >= HSI_CRITICAL_LOW) {
+        baseAmplitude = 3.0;
+    } else {
+        baseAmplitude = 4.0;
+    }
+
+    double amplitude;
+    if (mode == PacingMode::Minimal) {
+        amplitude = baseAmplitude * 0.8;
+    } else if (mode == PacingMode::Aggressive) {
+        amplitude = baseAmplitude * 1.2;
+    } else {
+        amplitude = baseAmplitude;
+    }
+
+    return clampAmplitude(amplitude);
+}
+
+struct PacingCommand {
+    bool pacingEnabled;
+    double targetRateBpm;
+    double amplitudeMa;
+    PacingMode mode;
+    SafetyState state;
+    bool rateWithinBounds;
+    bool amplitudeWithinBounds;
+    bool confidenceAcceptable;
+    bool hsiAcceptable;
+};
+
+/**
+ * Sanitize raw inputs exactly like process_pacing_decision.
+ */
+inline void sanitizeInputs(double& confidence, double& hsi, double& heartRate) {
+    confidence = clampRange(confidence, 0.0, 1.0);
+    hsi = clampRange(hsi, 0.0, 100.0);
+    heartRate = clampRange(heartRate, INPUT_MIN_HEART_RATE, INPUT_MAX_HEART_RATE);
+}
+
+/**
+ * Main entry point (compute_pacing_command): evaluate state, apply
+ * hysteresis, select mode, compute rate and amplitude, record history.
+ */
+inline PacingCommand computePacingCommand(PolicyState& s, Rhythm rhythm, double confidence, double hsi,
+                                          Trend trend, double heartRate) {
+    updateState(s, evaluateState(s, rhythm, confidence, hsi, heartRate));
+    const SafetyState state = static_cast<SafetyState>(s.currentState);
+
+    const PacingMode mode = determinePacingMode(rhythm, hsi, trend, state);
+    const double rate = computeTargetRate(s, heartRate, rhythm, hsi, mode);
+    const double amplitude = computePacingAmplitude(mode, hsi);
+
+    s.hasLastRate = 1;
+    s.lastPacingRate = rate;
+    s.lastPacingAmplitude = amplitude;
+
+    PacingCommand cmd;
+    cmd.pacingEnabled = mode != PacingMode::MonitorOnly;
+    cmd.targetRateBpm = rate;
+    cmd.amplitudeMa = amplitude;
+    cmd.mode = mode;
+    cmd.state = state;
+    cmd.rateWithinBounds = ABSOLUTE_MIN_PACING_RATE <= rate && rate <= ABSOLUTE_MAX_PACING_RATE;
+    cmd.amplitudeWithinBounds =
+        ABSOLUTE_MIN_PACING_AMPLITUDE <= amplitude && amplitude <= ABSOLUTE_MAX_PACING_AMPLITUDE;
+    cmd.confidenceAcceptable = confidence >= CONFIDENCE_THRESHOLD_MEDIUM;
+    cmd.hsiAcceptable = hsi >= HSI_EMERGENCY;
+    return cmd;
+}
+
+/**
+ * Stateful wrapper matching AdaptivePacingPolicy.
+ */
+class AdaptivePacingPolicy {
+public:
+    AdaptivePacingPolicy() { initPolicyState(state_); }
+
+    PacingCommand compute(Rhythm rhythm, double confidence, double hsi, Trend trend, double heartRate) {
+        return computePacingCommand(state_, rhythm, confidence, hsi, trend, heartRate);
+    }
+
+    const PolicyState& state() const { return state_; }
+    PolicyState& state() { return state_; }
+
+private:
+    PolicyState state_;
+};
+
+// ==========================================
+// Command Shaping
+// ==========================================
+// Runs after the policy. The policy already limits the target to
+// MAX_RATE_*_PER_CYCLE per decision, but decisions arrive at irregular
+// intervals and the firmware used to apply each new rate at the next pulse.
+// The shaper turns the target into a rate that moves at a bounded speed in
+// wall-clock time, ignores sub-deadband retargeting, and reports whether the
+// shaped command differs enough from the last published one to be worth
+// sending.
+
+constexpr double SHAPER_MAX_SLEW_BPM_PER_SEC = 2.0;   // 10 BPM takes 5 s
+constexpr double SHAPER_DEADBAND_BPM = 1.0;           // Ignore smaller retargets
+constexpr double SHAPER_PUBLISH_RESOLUTION_BPM = 0.5; // Smallest published change
+constexpr uint32_t SHAPER_KEEPALIVE_MS = 30000;       // Republish unchanged commands
+
+struct ShaperConfig {
+    double maxSlewBpmPerSec;
+    double deadbandBpm;
+    double publishResolutionBpm;
+    uint32_t keepaliveMs;
+};
+
+constexpr ShaperConfig DEFAULT_SHAPER_CONFIG = {
+    SHAPER_MAX_SLEW_BPM_PER_SEC, SHAPER_DEADBAND_BPM, SHAPER_PUBLISH_RESOLUTION_BPM, SHAPER_KEEPALIVE_MS};
+
+/**
+ * Shaper state. Standard-layout POD (shared with the C API).
+ */
+struct ShaperState {
+    uint8_t initialized;
+    uint8_t enabled;
+    uint8_t hasPublished;
+    uint8_t publishedEnabled;
+    uint32_t reserved;
+    uint64_t lastUpdateMs;
+    uint64_t lastPublishMs;
+    double goalRate;       // Target after the deadband
+    double shapedRate;     // Current slew-limited output
+    double publishedRate;  // Last rate reported with publish = true
+};
+
+inline void initShaperState(ShaperState& s) { memset(&s, 0, sizeof(s)); }
+
+struct ShapedCommand {
+    bool pacingEnabled;
+    double rateBpm;
+    bool publish;  // Differs from the last published command (or keepalive due)
+};
+
+/**
+ * Advance the shaper to nowMs with a new policy output.
+ *
+ * immediate skips the slew limit: used for EMERGENCY pacing (the safe rate
+ * must apply at once) and when pacing is switched on (there is no previous
+ * paced rate to slew from). Timestamps going backwards count as no elapsed
+ * time.
+ */
+inline ShapedCommand shapeCommand(ShaperState& s, const ShaperConfig& c, bool enabled, double targetRate,
+                                  bool immediate, uint64_t nowMs) {
+    const double target = clampRate(targetRate);
+    if (!s.initialized || immediate || (enabled && !s.enabled)) {
+        s.goalRate = target;
+        s.shapedRate = target;
+        s.initialized = 1;
+    } else {
+        const double retarget = target - s.goalRate;
+        if (retarget >= c.deadbandBpm || retarget <= -c.deadbandBpm) {
+            s.goalRate = target;
+        }
+        const double elapsedSec = (nowMs > s.lastUpdateMs) ? (nowMs - s.lastUpdateMs) / 1000.0 : 0.0;
+        const double maxStep = c.maxSlewBpmPerSec * elapsedSec;
+        s.shapedRate = s.shapedRate + clampRange(s.goalRate - s.shapedRate, -maxStep, maxStep);
+    }
+    s.lastUpdateMs = nowMs;
+    s.enabled = enabled;
+
+    const double drift = s.shapedRate - s.publishedRate;
+    const bool publish = !s.hasPublished || enabled != static_cast<bool>(s.publishedEnabled) ||
+                         drift >= c.publishResolutionBpm || drift <= -c.publishResolutionBpm ||
+                         (s.shapedRate == s.goalRate && s.publishedRate != s.shapedRate) ||
+                         nowMs - s.lastPublishMs >= c.keepaliveMs;
+    if (publish) {
+        s.hasPublished = 1;
+        s.publishedEnabled = enabled;
+        s.publishedRate = s.shapedRate;
+        s.lastPublishMs = nowMs;
+    }
+
+    ShapedCommand out;
+    out.pacingEnabled = enabled;
+    out.rateBpm = s.shapedRate;
+    out.publish = publish;
+    return out;
+}
+
+/**
+ * Stateful wrapper around shapeCommand.
+ */
+class CommandShaper {
+public:
+    explicit CommandShaper(const ShaperConfig& config = DEFAULT_SHAPER_CONFIG) : config_(config) {
+        initShaperState(state_);
+    }
+
+    ShapedCommand shape(bool enabled, double targetRate, bool immediate, uint64_t nowMs) {
+        return shapeCommand(state_, config_, enabled, targetRate, immediate, nowMs);
+    }
+
+    const ShaperState& state() const { return state_; }
+
+private:
+    ShaperConfig config_;
+    ShaperState state_;
+};
+
+}  // namespace pulsemind
+
+#endif  // PULSEMIND_SAFETY_POLICY_H
@@ -0,0 +1,1376 @@
+#ifndef PULSEMIND_TIME_SERIES_STORE_H
+#define PULSEMIND_TIME_SERIES_STORE_H
+
+/**
+ * Embedded time-series store for raw PPG and the features derived from it,
+ * keyed by device id and metric.
+ *
+ * Each series is cut into blocks covering fixed time slots
+ * (BLOCK_DURATION_US). A block is compressed the Gorilla way:
+ * - timestamps (microseconds) as delta-of-delta in variable-width buckets;
+ *   a regular 100 Hz stream costs one bit per sample
+ * - values as delta-of-delta of integers at a decimal scale (ADC counts, or
+ *   values printed with up to MAX_SCALE_EXP decimals), or XORed against the
+ *   previous double when no scale represents them exactly
+ *
+ * Rollups: while ingesting, the writer also aggregates every series into
+ * epoch-aligned buckets of 1 s, 10 s, 1 min and 10 min (ROLLUP_TIER_US).
+ * Each tier folds the closed buckets of the one below, so a sample costs one
+ * min/max/add. Closed buckets are stored as rollup blocks of the series in
+ * the same segments: four columns (min, max, sum, count) per bucket start.
+ * A bucket still open when its series is released is stored as is; the
+ * reader merges points that share a bucket start, so partial buckets (and
+ * several writers) add up. selectTier() picks the coarsest tier that still
+ * gives a point per pixel, so a day of PPG draws from a few thousand points.
+ *
+ * Writing: a writer keeps one compressed head block per series and tier in
+ * memory (the write-ahead buffer). A head is sealed when a point falls into
+ * the next slot, or on flush(); sealed blocks are immutable and appended to
+ * the writer's current segment file, <root>/<writer>-<seq>.seg, which is
+ * rotated at SEGMENT_TARGET_BYTES. Points still in a head (and open
+ * buckets) are lost if the process dies, so writers flush periodically.
+ *
+ * Reading: TimeSeriesReader mmaps the segments, indexes block headers by
+ * series and tier, and decodes only the blocks that overlap a query, after
+ * checking their CRC. A torn block at the end of a segment ends that
+ * segment's scan until more data arrives.
+ *
+ * A writer is used by one thread; a reader may be shared (it locks). Files
+ * are in host byte order.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace pulsemind {
+namespace tsdb {
+
+// ==========================================
+// Format
+// ==========================================
+constexpr uint32_t BLOCK_MAGIC = 0x53544D50;  // "PMTS"
+constexpr uint8_t FORMAT_VERSION = 1;
+constexpr char SEGMENT_MAGIC[8] = {'P', 'M', 'T', 'S', 'S', 'E', 'G', '1'};
+
+constexpr int64_t BLOCK_DURATION_US = 60LL * 1000 * 1000;
+constexpr int64_t MAX_BLOCK_DURATION_US = (1LL << 31) - 1;  // Keeps deltas in the 32-bit bucket
+constexpr uint32_t MAX_BLOCK_SAMPLES = 1u << 20;             // Caps a head at a few MB
+constexpr size_t SEGMENT_TARGET_BYTES = 64 * 1024 * 1024;
+constexpr size_t WRITE_BUFFER_BYTES = 64 * 1024;             // Sealed blocks coalesced per write()
+constexpr size_t MAX_DEVICE_ID_BYTES = 255;
+constexpr uint8_t MAX_SCALE_EXP = 4;
+
+// Tier 0 is the raw samples; tiers 1.. are rollups with these bucket widths
+constexpr uint8_t ROLLUP_TIER_COUNT = 4;
+constexpr int64_t ROLLUP_TIER_US[ROLLUP_TIER_COUNT + 1] = {0, 1000LL * 1000, 10LL * 1000 * 1000,
+                                                           60LL * 1000 * 1000, 600LL * 1000 * 1000};
+constexpr int64_t ROLLUP_BLOCK_DURATION_US = 30LL * 60 * 1000 * 1000;
+
+// Columns of a rollup block
+constexpr unsigned ROLLUP_MIN = 0;
+constexpr unsigned ROLLUP_MAX = 1;
+constexpr unsigned ROLLUP_SUM = 2;
+constexpr unsigned ROLLUP_COUNT = 3;
+constexpr unsigned ROLLUP_COLUMNS = 4;
+
+enum class Metric : uint8_t {
+    Ppg = 0,
+    HeartRate = 1,
+    HrvSdnn = 2,
+    PulseAmplitude = 3,
+    Hsi = 4,
+};
+constexpr uint8_t METRIC_COUNT = 5;
+
+inline const char* metricName(Metric metric) {
+    static const char* const NAMES[] = {"ppg", "heart_rate_bpm", "hrv_sdnn_ms", "pulse_amplitude", "hsi_score"};
+    return static_cast<uint8_t>(metric) < METRIC_COUNT ? NAMES[static_cast<uint8_t>(metric)] : "unknown";
+}
+
+/**
+ * Finest rollup tier kept for a metric. Features arrive once a second, so
+ * a 1 s tier would only copy them.
+ */
+inline uint8_t finestTier(Metric metric) { return metric == Metric::Ppg ? 1 : 2; }
+
+/**
+ * Coarsest tier of metric whose buckets still give at least maxPoints points
+ * over spanUs (one per pixel); 0, the raw samples, when even the finest tier
+ * is too coarse.
+ */
+inline uint8_t selectTier(Metric metric, int64_t spanUs, uint64_t maxPoints) {
+    uint8_t tier = 0;
+    if (maxPoints == 0 || spanUs <= 0) {
+        return tier;
+    }
+    const uint64_t bucketUs = static_cast<uint64_t>(spanUs) / maxPoints;
+    for (uint8_t t = finestTier(metric); t <= ROLLUP_TIER_COUNT; t++) {
+        if (static_cast<uint64_t>(ROLLUP_TIER_US[t]) <= bucketUs) {
+            tier = t;
+        }
+    }
+    return tier;
+}
+
+enum class Encoding : uint8_t {
+    Integer = 0,  // Delta-of-delta of round(value * 10^scaleExp)
+    Xor = 1,      // Gorilla XOR of the IEEE-754 bits
+};
+
+enum class Status : int32_t {
+    Ok = 0,
+    OutOfOrder = 1,     // Timestamp before the series' last one; earlier samples were stored
+    InvalidSeries = 2,  // Device id empty or too long, or unknown metric
+    IoError = 3,        // A sealed block could not be written (and was dropped)
+};
+
+/**
+ * On-disk block header, followed by the device id, the payload and padding
+ * to 8 bytes. encoding and scaleExp describe the values of a raw block, and
+ * the min and max columns of a rollup block; its sum is always XOR and its
+ * count an integer.
+ */
+struct BlockHeader {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t encoding;
+    uint8_t scaleExp;
+    uint8_t metric;
+    uint32_t count;
+    uint32_t payloadBytes;
+    int64_t firstTsUs;
+    int64_t lastTsUs;
+    uint16_t deviceIdBytes;
+    uint8_t tier;  // 0: raw samples, else ROLLUP_TIER_US index
+    uint8_t reserved;
+    uint32_t crc;  // CRC-32 of the header (with crc = 0), device id and payload
+};
+
+static_assert(sizeof(BlockHeader) == 40, "BlockHeader layout is part of the file format");
+
+inline size_t recordBytes(const BlockHeader& h) {
+    return (sizeof(BlockHeader) + h.deviceIdBytes + h.payloadBytes + 7) & ~static_cast<size_t>(7);
+}
+
+inline unsigned blockColumns(const BlockHeader& h) { return h.tier == 0 ? 1 : ROLLUP_COLUMNS; }
+
+/**
+ * Aggregates of one rollup tier, oldest bucket first.
+ */
+struct RollupPoints {
+    std::vector<int64_t> ts;  // Bucket start
+    std::vector<double> min;
+    std::vector<double> max;
+    std::vector<double> sum;
+    std::vector<double> count;
+
+    size_t size() const { return ts.size(); }
+
+    void clear() {
+        ts.clear();
+        min.clear();
+        max.clear();
+        sum.clear();
+        count.clear();
+    }
+};
+
+/**
+ * Floor of t to a multiple of width (epoch-aligned slots and buckets).
+ */
+inline int64_t alignDown(int64_t t, int64_t width) { return (t / width - (t % width < 0 ? 1 : 0)) * width; }
+
+// ==========================================
+// CRC-32 (IEEE 802.3, as zlib.crc32)
+// ==========================================
+inline uint32_t crc32Update(uint32_t crc, const uint8_t* p, size_t n) {
+    static const auto TABLE = [] {
+        struct Table {
+            uint32_t v[256];
+        } t{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t.v[i] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < n; i++) {
+        crc = TABLE.v[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+inline uint32_t blockCrc(BlockHeader h, const uint8_t* deviceId, const uint8_t* payload) {
+    h.crc = 0;
+    uint32_t crc = crc32Update(0, reinterpret_cast<const uint8_t*>(&h), sizeof(h));
+    crc = crc32Update(crc, deviceId, h.deviceIdBytes);
+    return crc32Update(crc, payload, h.payloadBytes);
+}
+
+// ==========================================
+// Bit Streams (MSB first)
+// ==========================================
+class BitWriter {
+public:
+    /**
+     * Append the low n bits of bits (n <= 64).
+     */
+    void write(uint64_t bits, unsigned n) {
+        if (n == 0) {
+            return;
+        }
+        if (n < 64) {
+            bits &= (1ull << n) - 1;
+        }
+        const unsigned space = 64 - fill_;
+        if (n < space) {
+            acc_ = (acc_ << n) | bits;
+            fill_ += n;
+            return;
+        }
+        const unsigned rest = n - space;
+        acc_ = (space == 64 ? 0 : acc_ << space) | (bits >> rest);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            bytes_.push_back(static_cast<uint8_t>(acc_ >> shift));
+        }
+        acc_ = rest == 0 ? 0 : bits & ((1ull << rest) - 1);
+        fill_ = rest;
+    }
+
+    size_t bytes() const { return bytes_.size() + (fill_ + 7) / 8; }
+
+    /**
+     * Append the stream so far, zero-padded to a byte, to out.
+     */
+    void copyTo(std::vector<uint8_t>& out) const {
+        out.insert(out.end(), bytes_.begin(), bytes_.end());
+        const uint64_t tail = fill_ == 0 ? 0 : acc_ << (64 - fill_);
+        for (unsigned i = 0; i < (fill_ + 7) / 8; i++) {
+            out.push_back(static_cast<uint8_t>(tail >> (56 - 8 * i)));
+        }
+    }
+
+    void clear() {
+        bytes_.clear();
+        acc_ = 0;
+        fill_ = 0;
+    }
+
+private:
+    std::vector<uint8_t> bytes_;
+    uint64_t acc_ = 0;
+    unsigned fill_ = 0;  // Bits in acc_ (< 64)
+};
+
+class BitReader {
+public:
+    BitReader(const uint8_t* p, size_t n) : p_(p), n_(n), limit_(static_cast<uint64_t>(n) * 8) {}
+
+    /**
+     * Next n bits (n <= 64); 0 and overrun() once the stream is exhausted.
+     */
+    uint64_t read(unsigned n) {
+        if (n > 56) {
+            const uint64_t hi = read(n - 32);
+            return (hi << 32) | read(32);
+        }
+        if (n == 0) {
+            return 0;
+        }
+        if (pos_ + n > limit_) {
+            overrun_ = true;
+            pos_ = limit_;
+            return 0;
+        }
+        const uint64_t word = load(pos_ >> 3) << (pos_ & 7);
+        pos_ += n;
+        return word >> (64 - n);
+    }
+
+    bool bit() { return read(1) != 0; }
+
+    bool overrun() const { return overrun_; }
+
+private:
+    uint64_t load(size_t byte) const {
+        uint64_t w = 0;
+        if (byte + 8 <= n_) {
+            memcpy(&w, p_ + byte, 8);
+            return __builtin_bswap64(w);
+        }
+        for (size_t i = 0; i < 8; i++) {
+            w = (w << 8) | (byte + i < n_ ? p_[byte + i] : 0);
+        }
+        return w;
+    }
+
+    const uint8_t* p_;
+    size_t n_;
+    uint64_t limit_;
+    uint64_t pos_ = 0;
+    bool overrun_ = false;
+};
+
+inline int64_t signExtend(uint64_t v, unsigned bits) {
+    const uint64_t m = 1ull << (bits - 1);
+    return static_cast<int64_t>((v ^ m) - m);
+}
+
+inline uint64_t zigzag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+
+inline int64_t unzigzag(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+// ==========================================
+// Sample Codecs
+// ==========================================
+
+/**
+ * Timestamp delta-of-delta: '0', '10'+7, '110'+9, '1110'+12, '1111'+32 bits.
+ */
+inline void writeTimestampDod(BitWriter& out, int64_t dod) {
+    const uint64_t u = static_cast<uint64_t>(dod);
+    if (dod == 0) {
+        out.write(0, 1);
+    } else if (dod >= -64 && dod < 64) {
+        out.write((0x2ull << 7) | (u & 0x7F), 9);
+    } else if (dod >= -256 && dod < 256) {
+        out.write((0x6ull << 9) | (u & 0x1FF), 12);
+    } else if (dod >= -2048 && dod < 2048) {
+        out.write((0xEull << 12) | (u & 0xFFF), 16);
+    } else {
+        out.write((0xFull << 32) | (u & 0xFFFFFFFF), 36);
+    }
+}
+
+inline int64_t readTimestampDod(BitReader& in) {
+    if (!in.bit()) {
+        return 0;
+    }
+    if (!in.bit()) {
+        return signExtend(in.read(7), 7);
+    }
+    if (!in.bit()) {
+        return signExtend(in.read(9), 9);
+    }
+    if (!in.bit()) {
+        return signExtend(in.read(12), 12);
+    }
+    return signExtend(in.read(32), 32);
+}
+
+/**
+ * Integer value delta-of-delta, zigzagged: '0', '10'+6, '110'+9, '1110'+13,
+ * '11110'+20, '11111'+64 bits.
+ */
+inline void writeValueDod(BitWriter& out, int64_t dod) {
+    const uint64_t z = zigzag(dod);
+    if (z == 0) {
+        out.write(0, 1);
+    } else if (z < (1ull << 6)) {
+        out.write((0x2ull << 6) | z, 8);
+    } else if (z < (1ull << 9)) {
+        out.write((0x6ull << 9) | z, 12);
+    } else if (z < (1ull << 13)) {
+        out.write((0xEull << 13) | z, 17);
+    } else if (z < (1ull << 20)) {
+        out.write((0x1Eull << 20) | z, 25);
+    } else {
+        out.write(0x1F, 5);
+        out.write(z, 64);
+    }
+}
+
+inline int64_t readValueDod(BitReader& in) {
+    if (!in.bit()) {
+        return 0;
+    }
+    if (!in.bit()) {
+        return unzigzag(in.read(6));
+    }
+    if (!in.bit()) {
+        return unzigzag(in.read(9));
+    }
+    if (!in.bit()) {
+        return unzigzag(in.read(13));
+    }
+    if (!in.bit()) {
+        return unzigzag(in.read(20));
+    }
+    return unzigzag(in.read(64));
+}
+
+constexpr double POW10[MAX_SCALE_EXP + 1] = {1.0, 10.0, 100.0, 1000.0, 10000.0};
+
+/**
+ * round(value * 10^scaleExp) when that integer decodes back to exactly value.
+ */
+inline bool scaledInteger(double value, uint8_t scaleExp, int64_t& out) {
+    const double scaled = value * POW10[scaleExp];
+    if (!(std::fabs(scaled) <= 9007199254740992.0) || (value == 0 && std::signbit(value))) {
+        return false;  // NaN, infinities, |x| > 2^53, -0.0
+    }
+    out = std::llrint(scaled);
+    return static_cast<double>(out) / POW10[scaleExp] == value;
+}
+
+/**
+ * Smallest scale exponent that represents value exactly; > MAX_SCALE_EXP if
+ * none does.
+ */
+inline uint8_t scaleExpFor(double value) {
+    int64_t unused;
+    uint8_t k = 0;
+    while (k <= MAX_SCALE_EXP && !scaledInteger(value, k, unused)) {
+        k++;
+    }
+    return k;
+}
+
+/**
+ * Encoder state of one value column of a head block.
+ */
+struct ColumnEncoder {
+    Encoding encoding = Encoding::Integer;
+    uint8_t scaleExp = 0;
+    // Integer encoding
+    int64_t x = 0;
+    int64_t dx = 0;
+    // XOR encoding
+    uint64_t bits = 0;
+    unsigned lead = 0xFF;
+    unsigned trail = 0;
+
+    void reset(Encoding e, uint8_t k) {
+        encoding = e;
+        scaleExp = e == Encoding::Integer ? k : 0;
+        lead = 0xFF;
+    }
+
+    /**
+     * Append value; scaled is its scaledInteger() under Integer encoding.
+     */
+    void write(BitWriter& out, bool first, double value, int64_t scaled) {
+        if (encoding == Encoding::Integer) {
+            if (first) {
+                out.write(static_cast<uint64_t>(scaled), 64);
+                dx = 0;
+            } else {
+                const int64_t d = static_cast<int64_t>(static_cast<uint64_t>(scaled) - static_cast<uint64_t>(x));
+                writeValueDod(out, static_cast<int64_t>(static_cast<uint64_t>(d) - static_cast<uint64_t>(dx)));
+                dx = d;
+            }
+            x = scaled;
+            return;
+        }
+        uint64_t b;
+        memcpy(&b, &value, sizeof(b));
+        if (first) {
+            out.write(b, 64);
+        } else {
+            const uint64_t diff = b ^ bits;
+            if (diff == 0) {
+                out.write(0, 1);
+            } else {
+                const unsigned l = std::min(31u, static_cast<unsigned>(__builtin_clzll(diff)));
+                const unsigned t = static_cast<unsigned>(__builtin_ctzll(diff));
+                if (lead != 0xFF && l >= lead && t >= trail) {
+                    out.write(0x2, 2);
+                    out.write(diff >> trail, 64 - lead - trail);
+                } else {
+                    const unsigned length = 64 - l - t;
+                    out.write((0x3u << 11) | (l << 6) | (length - 1), 13);
+                    out.write(diff >> t, length);
+                    lead = l;
+                    trail = t;
+                }
+            }
+        }
+        bits = b;
+    }
+};
+
+/**
+ * Decoder state of one value column.
+ */
+struct ColumnDecoder {
+    bool integer = true;
+    double scale = 1.0;
+    int64_t x = 0;
+    int64_t dx = 0;
+    uint64_t bits = 0;
+    unsigned lead = 0;
+    unsigned trail = 0;
+
+    /**
+     * Next value; false on an impossible XOR window.
+     */
+    bool read(BitReader& in, bool first, double& value) {
+        if (integer) {
+            if (first) {
+                x = static_cast<int64_t>(in.read(64));
+            } else {
+                dx = static_cast<int64_t>(static_cast<uint64_t>(dx) + static_cast<uint64_t>(readValueDod(in)));
+                x = static_cast<int64_t>(static_cast<uint64_t>(x) + static_cast<uint64_t>(dx));
+            }
+            value = static_cast<double>(x) / scale;
+            return true;
+        }
+        if (first) {
+            bits = in.read(64);
+        } else if (in.bit()) {
+            if (in.bit()) {
+                lead = static_cast<unsigned>(in.read(5));
+                const unsigned length = static_cast<unsigned>(in.read(6)) + 1;
+                if (lead + length > 64) {
+                    return false;
+                }
+                trail = 64 - lead - length;
+            }
+            bits ^= in.read(64 - lead - trail) << trail;
+        }
+        memcpy(&value, &bits, sizeof(bits));
+        return true;
+    }
+};
+
+/**
+ * Decode a block's points, appending the timestamps to ts and column c to
+ * *columns[c] (Columns = blockColumns(h)); false if the payload is
+ * inconsistent with the header.
+ */
+template <unsigned Columns>
+inline bool decodeColumns(const BlockHeader& h, const uint8_t* payload, std::vector<int64_t>& ts,
+                          std::vector<double>* const* columns) {
+    if (h.encoding > static_cast<uint8_t>(Encoding::Xor) || h.scaleExp > MAX_SCALE_EXP || h.count == 0 ||
+        h.tier > ROLLUP_TIER_COUNT || Columns != blockColumns(h)) {
+        return false;
+    }
+    ColumnDecoder decoders[Columns];
+    for (unsigned c = 0; c < Columns; c++) {
+        if (h.tier == 0 || c < ROLLUP_SUM) {
+            decoders[c].integer = h.encoding == static_cast<uint8_t>(Encoding::Integer);
+            decoders[c].scale = POW10[h.scaleExp];
+        } else {
+            decoders[c].integer = c == ROLLUP_COUNT;
+        }
+    }
+    BitReader in(payload, h.payloadBytes);
+    const size_t base = ts.size();
+    ts.resize(base + h.count);
+    double* out[Columns];
+    for (unsigned c = 0; c < Columns; c++) {
+        columns[c]->resize(base + h.count);
+        out[c] = columns[c]->data() + base;
+    }
+
+    int64_t t = h.firstTsUs;
+    int64_t delta = 0;
+    bool ok = true;
+    for (uint32_t i = 0; i < h.count && ok; i++) {
+        if (i > 0) {
+            delta += readTimestampDod(in);
+            t += delta;
+        }
+        ts[base + i] = t;
+        for (unsigned c = 0; c < Columns; c++) {
+            ok &= decoders[c].read(in, i == 0, out[c][i]);
+        }
+    }
+    if (!ok || in.overrun() || t != h.lastTsUs) {
+        ts.resize(base);
+        for (unsigned c = 0; c < Columns; c++) {
+            columns[c]->resize(base);
+        }
+        return false;
+    }
+    return true;
+}
+
+inline bool decodeColumns(const BlockHeader& h, const uint8_t* payload, std::vector<int64_t>& ts,
+                          std::vector<double>* const* columns, unsigned n) {
+    return n == 1 ? decodeColumns<1>(h, payload, ts, columns)
+                  : n == ROLLUP_COLUMNS && decodeColumns<ROLLUP_COLUMNS>(h, payload, ts, columns);
+}
+
+/**
+ * Decode a raw block's samples, appending to ts and values.
+ */
+inline bool decodeBlock(const BlockHeader& h, const uint8_t* payload, std::vector<int64_t>& ts,
+                        std::vector<double>& values) {
+    std::vector<double>* columns[] = {&values};
+    return decodeColumns(h, payload, ts, columns, 1);
+}
+
+/**
+ * Decode a rollup block's buckets, appending to points.
+ */
+inline bool decodeBlock(const BlockHeader& h, const uint8_t* payload, RollupPoints& points) {
+    std::vector<double>* columns[] = {&points.min, &points.max, &points.sum, &points.count};
+    return decodeColumns(h, payload, points.ts, columns, ROLLUP_COLUMNS);
+}
+
+// ==========================================
+// Writer
+// ==========================================
+class TimeSeriesWriter {
+public:
+    struct Stats {
+        uint64_t samples = 0;
+        uint64_t rollupPoints = 0;  // Buckets stored, over all tiers
+        uint64_t blocks = 0;
+        uint64_t bytesWritten = 0;
+        uint64_t droppedBlocks = 0;  // Lost to write errors
+    };
+
+    TimeSeriesWriter() = default;
+    TimeSeriesWriter(const TimeSeriesWriter&) = delete;
+    TimeSeriesWriter& operator=(const TimeSeriesWriter&) = delete;
+
+    ~TimeSeriesWriter() {
+        finish();
+        closeSegment();
+    }
+
+    /**
+     * Start writing segments named <name>-<seq>.seg under root (created if
+     * missing). Several writers may share a root as long as names differ.
+     * On failure returns false and sets error.
+     */
+    bool open(const std::string& root, const std::string& name, std::string& error,
+              int64_t blockDurationUs = BLOCK_DURATION_US, size_t segmentBytes = SEGMENT_TARGET_BYTES) {
+        if (name.empty() || name.find('/') != std::string::npos) {
+            error = "bad writer name '" + name + "'";
+            return false;
+        }
+        if (blockDurationUs <= 0 || blockDurationUs > MAX_BLOCK_DURATION_US) {
+            error = "block duration out of range";
+            return false;
+        }
+        if (mkdir(root.c_str(), 0750) != 0 && errno != EEXIST) {
+            error = "cannot create " + root + ": " + strerror(errno);
+            return false;
+        }
+        root_ = root;
+        name_ = name;
+        blockDurationUs_ = blockDurationUs;
+        segmentBytes_ = segmentBytes;
+        nextSeq_ = 0;
+        if (DIR* dir = opendir(root.c_str())) {
+            const std::string prefix = name + "-";
+            while (const dirent* entry = readdir(dir)) {
+                unsigned seq;
+                char tail[8];
+                const std::string file = entry->d_name;
+                if (file.compare(0, prefix.size(), prefix) == 0 &&
+                    sscanf(file.c_str() + prefix.size(), "%u.%7s", &seq, tail) == 2 && strcmp(tail, "seg") == 0) {
+                    nextSeq_ = std::max(nextSeq_, seq + 1);
+                }
+            }
+            closedir(dir);
+        }
+        return openSegment(error);
+    }
+
+    const Stats& stats() const { return stats_; }
+
+    size_t openSeries() const { return series_.size(); }
+
+    /**
+     * Append samples (timestamps non-decreasing per series) to a series and
+     * its rollups. Non-finite values are stored but not aggregated.
+     */
+    Status append(std::string_view deviceId, Metric metric, const int64_t* ts, const double* values, size_t n) {
+        if (deviceId.empty() || deviceId.size() > MAX_DEVICE_ID_BYTES ||
+            static_cast<uint8_t>(metric) >= METRIC_COUNT) {
+            return Status::InvalidSeries;
+        }
+        key_.assign(deviceId.data(), deviceId.size());
+        key_.push_back(static_cast<char>(metric));
+        auto it = series_.find(key_);
+        if (it == series_.end()) {
+            it = series_.emplace(key_, Series()).first;
+        }
+        Series& s = it->second;
+        s.active = true;
+
+        Status status = Status::Ok;
+        Head& raw = s.heads[0];
+        for (size_t i = 0; i < n; i++) {
+            const int64_t t = ts[i];
+            if (t < s.lastTs) {
+                stats_.samples += i;
+                return status == Status::Ok ? Status::OutOfOrder : status;
+            }
+            if (raw.count > 0 && (t >= raw.slotEnd || raw.count == MAX_BLOCK_SAMPLES)) {
+                if (!seal(deviceId, metric, 0, raw)) {
+                    status = Status::IoError;
+                }
+            }
+            if (raw.count == 0) {
+                start(raw, 0, t, &values[i]);
+            }
+            addPoint<1>(raw, 0, t, &values[i]);
+            s.lastTs = t;
+            if (std::isfinite(values[i]) && !aggregate(deviceId, metric, s, t, values[i])) {
+                status = Status::IoError;
+            }
+        }
+        stats_.samples += n;
+        return status;
+    }
+
+    /**
+     * Seal every head and write all sealed blocks. A series that received
+     * nothing since the previous flush has its open buckets stored and its
+     * state released, so idle devices cost nothing until they send again.
+     */
+    Status flush() {
+        bool ok = true;
+        for (auto it = series_.begin(); it != series_.end();) {
+            const std::string& key = it->first;
+            const std::string_view deviceId(key.data(), key.size() - 1);
+            const Metric metric = static_cast<Metric>(static_cast<uint8_t>(key.back()));
+            Series& s = it->second;
+            if (!s.active) {
+                // Lower tiers first: closing a bucket folds it into the next
+                for (uint8_t tier = finestTier(metric); tier <= ROLLUP_TIER_COUNT; tier++) {
+                    if (s.buckets[tier].count > 0) {
+                        ok &= closeBucket(deviceId, metric, s, tier);
+                    }
+                }
+            }
+            for (uint8_t tier = 0; tier <= ROLLUP_TIER_COUNT; tier++) {
+                if (s.heads[tier].count > 0) {
+                    ok &= seal(deviceId, metric, tier, s.heads[tier]);
+                }
+            }
+            if (s.active) {
+                s.active = false;
+                ++it;
+            } else {
+                it = series_.erase(it);
+            }
+        }
+        ok &= writePending();
+        return ok ? Status::Ok : Status::IoError;
+    }
+
+    /**
+     * Flush, then make the current segment durable.
+     */
+    Status sync() {
+        const Status status = flush();
+        if (fd_ >= 0 && fdatasync(fd_) != 0) {
+            return Status::IoError;
+        }
+        return status;
+    }
+
+    /**
+     * Store every open bucket and flush, releasing all series (on shutdown).
+     */
+    Status finish() {
+        for (auto& entry : series_) {
+            entry.second.active = false;
+        }
+        return flush();
+    }
+
+private:
+    /**
+     * A block being built: its timestamps and value columns (one for raw
+     * samples, ROLLUP_COLUMNS for a rollup tier).
+     */
+    struct Head {
+        BitWriter bits;
+        uint32_t count = 0;
+        int64_t slotEnd = 0;
+        int64_t firstTs = 0;
+        int64_t lastTs = 0;
+        int64_t delta = 0;
+        ColumnEncoder columns[ROLLUP_COLUMNS];
+    };
+
+    /**
+     * The open bucket of one rollup tier.
+     */
+    struct Bucket {
+        int64_t start = 0;
+        int64_t end = INT64_MIN;
+        double min = 0;
+        double max = 0;
+        double sum = 0;
+        uint64_t count = 0;
+    };
+
+    /**
+     * One series' heads and open buckets, indexed by tier.
+     */
+    struct Series {
+        Head heads[ROLLUP_TIER_COUNT + 1];
+        Bucket buckets[ROLLUP_TIER_COUNT + 1];
+        int64_t lastTs = INT64_MIN;
+        bool active = false;  // Appended to since the last flush
+    };
+
+    static void openBucket(Bucket& b, uint8_t tier, int64_t t) {
+        b.start = alignDown(t, ROLLUP_TIER_US[tier]);
+        b.end = b.start + ROLLUP_TIER_US[tier];
+        b.min = INFINITY;
+        b.max = -INFINITY;
+        b.sum = 0;
+        b.count = 0;
+    }
+
+    /**
+     * Add a sample to the finest tier's bucket, closing it first when the
+     * sample is past its end.
+     */
+    bool aggregate(std::string_view deviceId, Metric metric, Series& s, int64_t t, double value) {
+        const uint8_t tier = finestTier(metric);
+        Bucket& b = s.buckets[tier];
+        bool ok = true;
+        if (t >= b.end) {
+            if (b.count > 0) {
+                ok = closeBucket(deviceId, metric, s, tier);
+            }
+            openBucket(b, tier, t);
+        }
+        b.min = std::min(b.min, value);
+        b.max = std::max(b.max, value);
+        b.sum += value;
+        b.count++;
+        return ok;
+    }
+
+    /**
+     * Store a tier's bucket as a rollup point and fold it into the next
+     * tier's bucket.
+     */
+    bool closeBucket(std::string_view deviceId, Metric metric, Series& s, uint8_t tier) {
+        Bucket& b = s.buckets[tier];
+        const double point[ROLLUP_COLUMNS] = {b.min, b.max, b.sum, static_cast<double>(b.count)};
+        Head& h = s.heads[tier];
+        bool ok = true;
+        if (h.count > 0 && (b.start >= h.slotEnd || h.count == MAX_BLOCK_SAMPLES)) {
+            ok = seal(deviceId, metric, tier, h);
+        }
+        if (h.count == 0) {
+            start(h, tier, b.start, point);
+        }
+        addPoint<ROLLUP_COLUMNS>(h, tier, b.start, point);
+        stats_.rollupPoints++;
+
+        if (tier < ROLLUP_TIER_COUNT) {
+            Bucket& up = s.buckets[tier + 1];
+            if (b.start >= up.end) {
+                if (up.count > 0) {
+                    ok &= closeBucket(deviceId, metric, s, tier + 1);
+                }
+                openBucket(up, tier + 1, b.start);
+            }
+            up.min = std::min(up.min, b.min);
+            up.max = std::max(up.max, b.max);
+            up.sum += b.sum;
+            up.count += b.count;
+        }
+        b.count = 0;
+        return ok;
+    }
+
+    /**
+     * Set a head's column encodings: sample values (raw values, rollup min
+     * and max) share one, a rollup's sum is XOR and its count an integer.
+     */
+    static void setEncoding(Head& h, uint8_t tier, Encoding encoding, uint8_t scaleExp) {
+        h.columns[0].reset(encoding, scaleExp);
+        if (tier > 0) {
+            h.columns[ROLLUP_MAX].reset(encoding, scaleExp);
+            h.columns[ROLLUP_SUM].reset(Encoding::Xor, 0);
+            h.columns[ROLLUP_COUNT].reset(Encoding::Integer, 0);
+        }
+    }
+
+    void start(Head& h, uint8_t tier, int64_t t, const double* values) {
+        // Slots are aligned to the epoch so replicas cut identical blocks
+        const int64_t duration = tier == 0 ? blockDurationUs_ : ROLLUP_BLOCK_DURATION_US;
+        h.slotEnd = alignDown(t, duration) + duration;
+        h.firstTs = t;
+        h.lastTs = t;
+        h.delta = 0;
+        uint8_t k = scaleExpFor(values[0]);
+        if (tier > 0) {
+            k = std::max(k, scaleExpFor(values[ROLLUP_MAX]));
+        }
+        setEncoding(h, tier, k <= MAX_SCALE_EXP ? Encoding::Integer : Encoding::Xor, k);
+    }
+
+    template <unsigned Columns>
+    void addPoint(Head& h, uint8_t tier, int64_t t, const double* values) {
+        constexpr unsigned SAMPLE_COLUMNS = Columns == 1 ? 1 : ROLLUP_SUM;
+        int64_t x[Columns] = {};
+        if (h.columns[0].encoding == Encoding::Integer) {
+            bool fits = true;
+            for (unsigned c = 0; c < SAMPLE_COLUMNS; c++) {
+                fits &= scaledInteger(values[c], h.columns[0].scaleExp, x[c]);
+            }
+            if (!fits) {
+                uint8_t k = h.columns[0].scaleExp;
+                for (unsigned c = 0; c < SAMPLE_COLUMNS; c++) {
+                    k = std::max(k, scaleExpFor(values[c]));
+                }
+                reencode(h, tier, k <= MAX_SCALE_EXP ? Encoding::Integer : Encoding::Xor, k);
+                for (unsigned c = 0; c < SAMPLE_COLUMNS && h.columns[0].encoding == Encoding::Integer; c++) {
+                    scaledInteger(values[c], h.columns[0].scaleExp, x[c]);
+                }
+            }
+        }
+        if constexpr (Columns > 1) {
+            scaledInteger(values[ROLLUP_COUNT], 0, x[ROLLUP_COUNT]);
+        }
+
+        if (h.count > 0) {
+            const int64_t delta = t - h.lastTs;
+            writeTimestampDod(h.bits, delta - h.delta);
+            h.delta = delta;
+        }
+        h.lastTs = t;
+        for (unsigned c = 0; c < Columns; c++) {
+            h.columns[c].write(h.bits, h.count == 0, values[c], x[c]);
+        }
+        h.count++;
+    }
+
+    /**
+     * Re-encode the head with a wider scale, or as XOR, when a value does not
+     * fit the block's current scale. At most MAX_SCALE_EXP + 1 times a block.
+     */
+    void reencode(Head& h, uint8_t tier, Encoding encoding, uint8_t scaleExp) {
+        const unsigned columns = tier == 0 ? 1 : ROLLUP_COLUMNS;
+        std::vector<double>* decoded[ROLLUP_COLUMNS];
+        scratchBytes_.clear();
+        scratchTs_.clear();
+        for (unsigned c = 0; c < columns; c++) {
+            scratchColumns_[c].clear();
+            decoded[c] = &scratchColumns_[c];
+        }
+        h.bits.copyTo(scratchBytes_);
+        decodeColumns(header(h, tier, 0, scratchBytes_.size()), scratchBytes_.data(), scratchTs_, decoded, columns);
+        int64_t unused;
+        for (unsigned c = 0; c < (tier == 0 ? 1 : ROLLUP_SUM); c++) {
+            for (size_t i = 0; i < scratchTs_.size() && encoding == Encoding::Integer; i++) {
+                if (!scaledInteger(scratchColumns_[c][i], scaleExp, unused)) {
+                    encoding = Encoding::Xor;  // Out of integer range at the wider scale
+                }
+            }
+        }
+
+        const int64_t slotEnd = h.slotEnd;
+        h.bits.clear();
+        h.count = 0;
+        h.delta = 0;
+        setEncoding(h, tier, encoding, scaleExp);
+        for (size_t i = 0; i < scratchTs_.size(); i++) {
+            double point[ROLLUP_COLUMNS];
+            for (unsigned c = 0; c < columns; c++) {
+                point[c] = scratchColumns_[c][i];
+            }
+            if (tier == 0) {
+                addPoint<1>(h, tier, scratchTs_[i], point);
+            } else {
+                addPoint<ROLLUP_COLUMNS>(h, tier, scratchTs_[i], point);
+            }
+        }
+        h.slotEnd = slotEnd;
+    }
+
+    static BlockHeader header(const Head& h, uint8_t tier, size_t deviceIdBytes, size_t payloadBytes) {
+        BlockHeader b{};
+        b.magic = BLOCK_MAGIC;
+        b.version = FORMAT_VERSION;
+        b.encoding = static_cast<uint8_t>(h.columns[0].encoding);
+        b.scaleExp = h.columns[0].scaleExp;
+        b.count = h.count;
+        b.payloadBytes = static_cast<uint32_t>(payloadBytes);
+        b.firstTsUs = h.firstTs;
+        b.lastTsUs = h.lastTs;
+        b.deviceIdBytes = static_cast<uint16_t>(deviceIdBytes);
+        b.tier = tier;
+        return b;
+    }
+
+    /**
+     * Close the head as an immutable block in the write buffer.
+     */
+    bool seal(std::string_view deviceId, Metric metric, uint8_t tier, Head& head) {
+        BlockHeader h = header(head, tier, deviceId.size(), head.bits.bytes());
+        h.metric = static_cast<uint8_t>(metric);
+
+        const size_t at = pending_.size();
+        pending_.resize(at + sizeof(BlockHeader));
+        pending_.insert(pending_.end(), deviceId.begin(), deviceId.end());
+        head.bits.copyTo(pending_);
+        pending_.resize(at + recordBytes(h), 0);
+        h.crc = blockCrc(h, pending_.data() + at + sizeof(BlockHeader),
+                         pending_.data() + at + sizeof(BlockHeader) + h.deviceIdBytes);
+        memcpy(pending_.data() + at, &h, sizeof(h));
+
+        head.bits.clear();
+        head.count = 0;
+        stats_.blocks++;
+        return pending_.size() < WRITE_BUFFER_BYTES || writePending();
+    }
+
+    bool writePending() {
+        if (pending_.empty()) {
+            return true;
+        }
+        bool ok = fd_ >= 0;
+        size_t done = 0;
+        while (ok && done < pending_.size()) {
+            const ssize_t w = write(fd_, pending_.data() + done, pending_.size() - done);
+            if (w < 0 && errno == EINTR) {
+                continue;
+            }
+            ok = w > 0;
+            done += ok ? static_cast<size_t>(w) : 0;
+        }
+        if (!ok) {
+            // The segment may now end in a torn block: readers stop there, so
+            // continue in a fresh segment
+            for (size_t at = 0; at < pending_.size();) {
+                BlockHeader h;
+                memcpy(&h, pending_.data() + at, sizeof(h));
+                at += recordBytes(h);
+                stats_.droppedBlocks++;
+            }
+            std::string error;
+            closeSegment();
+            openSegment(error);
+        } else {
+            stats_.bytesWritten += done;
+            segmentSize_ += done;
+        }
+        pending_.clear();
+        if (ok && segmentSize_ >= segmentBytes_) {
+            std::string error;
+            closeSegment();
+            ok = openSegment(error);
+        }
+        return ok;
+    }
+
+    bool openSegment(std::string& error) {
+        for (int attempt = 0; attempt < 1000; attempt++) {
+            char file[32];
+            snprintf(file, sizeof(file), "-%08u.seg", nextSeq_++);
+            const std::string path = root_ + "/" + name_ + file;
+            fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0640);
+            if (fd_ < 0 && errno == EEXIST) {
+                continue;
+            }
+            if (fd_ < 0 || write(fd_, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) != sizeof(SEGMENT_MAGIC)) {
+                error = "cannot create " + path + ": " + strerror(errno);
+                closeSegment();
+                return false;
+            }
+            segmentSize_ = sizeof(SEGMENT_MAGIC);
+            return true;
+        }
+        error = "no free segment name in " + root_;
+        return false;
+    }
+
+    void closeSegment() {
+        if (fd_ >= 0) {
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    std::string root_;
+    std::string name_;
+    int64_t blockDurationUs_ = BLOCK_DURATION_US;
+    size_t segmentBytes_ = SEGMENT_TARGET_BYTES;
+    unsigned nextSeq_ = 0;
+    int fd_ = -1;
+    size_t segmentSize_ = 0;
+
+    std::unordered_map<std::string, Series> series_;  // Key: device id + metric byte
+    std::string key_;
+    std::vector<uint8_t> pending_;
+    std::vector<uint8_t> scratchBytes_;
+    std::vector<int64_t> scratchTs_;
+    std::vector<double> scratchColumns_[ROLLUP_COLUMNS];
+    Stats stats_;
+};
+
+// ==========================================
+// Reader
+// ==========================================
+class TimeSeriesReader {
+public:
+    struct Stats {
+        uint64_t segments = 0;
+        uint64_t blocks = 0;
+        uint64_t corruptBlocks = 0;  // Failed the CRC or decode check (skipped)
+    };
+
+    explicit TimeSeriesReader(std::string root) : root_(std::move(root)) {}
+    TimeSeriesReader(const TimeSeriesReader&) = delete;
+    TimeSeriesReader& operator=(const TimeSeriesReader&) = delete;
+
+    ~TimeSeriesReader() {
+        for (Segment& seg : segments_) {
+            unmap(seg);
+        }
+    }
+
+    Stats stats() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    /**
+     * Samples of one series with fromUs <= ts < toUs, in time order,
+     * replacing the contents of ts and values. Picks up blocks written since
+     * the last call first.
+     */
+    void query(std::string_view deviceId, Metric metric, int64_t fromUs, int64_t toUs, std::vector<int64_t>& ts,
+               std::vector<double>& values) {
+        ts.clear();
+        values.clear();
+        std::vector<double>* columns[] = {&values};
+        std::lock_guard<std::mutex> lock(mutex_);
+        refresh();
+        collect(deviceId, metric, 0, fromUs, toUs, ts, columns, 1);
+        sortByTime(ts, columns, 1);
+    }
+
+    /**
+     * Buckets of one rollup tier (1..ROLLUP_TIER_COUNT) overlapping
+     * [fromUs, toUs), oldest first, replacing the contents of points. Points
+     * of the same bucket (partial buckets, several writers) are merged.
+     */
+    void queryRollup(std::string_view deviceId, Metric metric, uint8_t tier, int64_t fromUs, int64_t toUs,
+                     RollupPoints& points) {
+        points.clear();
+        if (tier == 0 || tier > ROLLUP_TIER_COUNT) {
+            return;
+        }
+        std::vector<double>* columns[] = {&points.min, &points.max, &points.sum, &points.count};
+        std::lock_guard<std::mutex> lock(mutex_);
+        refresh();
+        const int64_t width = ROLLUP_TIER_US[tier];
+        const int64_t firstStart = fromUs > INT64_MIN + width ? fromUs - width + 1 : INT64_MIN;
+        collect(deviceId, metric, tier, firstStart, toUs, points.ts, columns, ROLLUP_COLUMNS);
+        sortByTime(points.ts, columns, ROLLUP_COLUMNS);
+
+        size_t keep = 0;
+        for (size_t i = 0; i < points.size(); i++) {
+            if (keep > 0 && points.ts[keep - 1] == points.ts[i]) {
+                points.min[keep - 1] = std::min(points.min[keep - 1], points.min[i]);
+                points.max[keep - 1] = std::max(points.max[keep - 1], points.max[i]);
+                points.sum[keep - 1] += points.sum[i];
+                points.count[keep - 1] += points.count[i];
+                continue;
+            }
+            points.ts[keep] = points.ts[i];
+            points.min[keep] = points.min[i];
+            points.max[keep] = points.max[i];
+            points.sum[keep] = points.sum[i];
+            points.count[keep] = points.count[i];
+            keep++;
+        }
+        points.ts.resize(keep);
+        points.min.resize(keep);
+        points.max.resize(keep);
+        points.sum.resize(keep);
+        points.count.resize(keep);
+    }
+
+private:
+    struct Segment {
+        std::string name;
+        const uint8_t* map = nullptr;
+        size_t mapped = 0;
+        size_t scanned = 0;  // Offset of the first block not yet indexed
+    };
+
+    struct BlockRef {
+        uint32_t segment;
+        uint64_t offset;
+        int64_t firstTsUs;
+        int64_t lastTsUs;
+    };
+
+    static std::string seriesKey(std::string_view deviceId, uint8_t metric, uint8_t tier) {
+        std::string key(deviceId);
+        key.push_back(static_cast<char>(metric));
+        key.push_back(static_cast<char>(tier));
+        return key;
+    }
+
+    /**
+     * Decode the points of one series and tier with fromUs <= ts < toUs,
+     * appending them unsorted.
+     */
+    void collect(std::string_view deviceId, Metric metric, uint8_t tier, int64_t fromUs, int64_t toUs,
+                 std::vector<int64_t>& ts, std::vector<double>* const* columns, unsigned n) {
+        auto it = index_.find(seriesKey(deviceId, static_cast<uint8_t>(metric), tier));
+        if (it == index_.end()) {
+            return;
+        }
+        for (const BlockRef& ref : it->second) {
+            if (ref.lastTsUs < fromUs || ref.firstTsUs >= toUs) {
+                continue;
+            }
+            const uint8_t* record = segments_[ref.segment].map + ref.offset;
+            BlockHeader h;
+            memcpy(&h, record, sizeof(h));
+            const uint8_t* payload = record + sizeof(BlockHeader) + h.deviceIdBytes;
+            const size_t base = ts.size();
+            if (blockCrc(h, record + sizeof(BlockHeader), payload) != h.crc ||
+                !decodeColumns(h, payload, ts, columns, n)) {
+                stats_.corruptBlocks++;
+                continue;
+            }
+            // Trim to the range in place
+            size_t keep = base;
+            for (size_t i = base; i < ts.size(); i++) {
+                if (ts[i] >= fromUs && ts[i] < toUs) {
+                    ts[keep] = ts[i];
+                    for (unsigned c = 0; c < n; c++) {
+                        (*columns[c])[keep] = (*columns[c])[i];
+                    }
+                    keep++;
+                }
+            }
+            ts.resize(keep);
+            for (unsigned c = 0; c < n; c++) {
+                columns[c]->resize(keep);
+            }
+        }
+    }
+
+    static void sortByTime(std::vector<int64_t>& ts, std::vector<double>* const* columns, unsigned n) {
+        if (std::is_sorted(ts.begin(), ts.end())) {
+            return;
+        }
+        // Blocks of one series from different writers can interleave
+        std::vector<size_t> order(ts.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return ts[a] < ts[b]; });
+        std::vector<int64_t> sortedTs(ts.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            sortedTs[i] = ts[order[i]];
+        }
+        ts.swap(sortedTs);
+        std::vector<double> sorted(ts.size());
+        for (unsigned c = 0; c < n; c++) {
+            for (size_t i = 0; i < order.size(); i++) {
+                sorted[i] = (*columns[c])[order[i]];
+            }
+            columns[c]->swap(sorted);
+        }
+    }
+
+    static void unmap(Segment& seg) {
+        if (seg.map != nullptr) {
+            munmap(const_cast<uint8_t*>(seg.map), seg.mapped);
+            seg.map = nullptr;
+            seg.mapped = 0;
+        }
+    }
+
+    void refresh() {
+        if (DIR* dir = opendir(root_.c_str())) {
+            while (const dirent* entry = readdir(dir)) {
+                const std::string file = entry->d_name;
+                if (file.size() > 4 && file.compare(file.size() - 4, 4, ".seg") == 0 && known_.count(file) == 0) {
+                    known_.emplace(file, segments_.size());
+                    segments_.push_back(Segment{file});
+                    stats_.segments++;
+                }
+            }
+            closedir(dir);
+        }
+        for (uint32_t i = 0; i < segments_.size(); i++) {
+            scan(i);
+        }
+    }
+
+    void scan(uint32_t index) {
+        Segment& seg = segments_[index];
+        const std::string path = root_ + "/" + seg.name;
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) > seg.mapped) {
+            // Remap to cover blocks appended since the last scan
+            void* map = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+            if (map != MAP_FAILED) {
+                unmap(seg);
+                seg.map = static_cast<const uint8_t*>(map);
+                seg.mapped = static_cast<size_t>(st.st_size);
+            }
+        }
+        close(fd);
+
+        if (seg.scanned == 0) {
+            if (seg.mapped < sizeof(SEGMENT_MAGIC) || memcmp(seg.map, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) != 0) {
+                return;
+            }
+            seg.scanned = sizeof(SEGMENT_MAGIC);
+        }
+        while (seg.scanned + sizeof(BlockHeader) <= seg.mapped) {
+            BlockHeader h;
+            memcpy(&h, seg.map + seg.scanned, sizeof(h));
+            if (h.magic != BLOCK_MAGIC || h.version != FORMAT_VERSION || h.metric >= METRIC_COUNT ||
+                h.tier > ROLLUP_TIER_COUNT || h.deviceIdBytes == 0 || h.deviceIdBytes > MAX_DEVICE_ID_BYTES ||
+                seg.scanned + recordBytes(h) > seg.mapped) {
+                return;  // Torn or not yet complete
+            }
+            const std::string_view deviceId(reinterpret_cast<const char*>(seg.map + seg.scanned + sizeof(BlockHeader)),
+                                            h.deviceIdBytes);
+            index_[seriesKey(deviceId, h.metric, h.tier)].push_back({index, seg.scanned, h.firstTsUs, h.lastTsUs});
+            seg.scanned += recordBytes(h);
+            stats_.blocks++;
+        }
+    }
+
+    std::string root_;
+    std::mutex mutex_;
+    std::vector<Segment> segments_;
+    std::unordered_map<std::string, size_t> known_;
+    std::unordered_map<std::string, std::vector<BlockRef>> index_;  // Key: device id + metric + tier bytes
+    Stats stats_;
+};
+
+}  // namespace tsdb
+}  // namespace pulsemind
+
+#endif  // PULSEMIND_TIME_SERIES_STORE_H
@@ -0,0 +1,644 @@
+#ifndef PULSEMIND_TRACE_RING_H
+#define PULSEMIND_TRACE_RING_H
+
+/**
+ * Span collection for end-to-end latency tracing.
+ *
+ * Trace context travels as a W3C traceparent ("00-<trace id>-<parent span
+ * id>-<flags>"): in the firmware's sensor frames, in the ingest worker's
+ * pacing commands, in the device's trace reports and in HTTP headers
+ * between the services.
+ *
+ * A finished span is copied into a slot of a bounded multi-producer,
+ * single-consumer ring, the same scheme as LogRing.h: one CAS to claim the
+ * slot, a memcpy, one release store. A full ring drops the span and counts
+ * it; tracing must never hold up a pacing decision.
+ *
+ * The consumer drains spans as OTLP/JSON ExportTraceServiceRequest
+ * documents (one resourceSpans entry per service.name), which an
+ * OpenTelemetry collector accepts on /v1/traces and its otlpjsonfile
+ * receiver reads as lines of a file. TraceExporter is that consumer as a
+ * thread appending one document per line to a file descriptor.
+ *
+ * Attributes are "key=value" lines. Values that look like integers,
+ * decimals or booleans are exported as such, anything else as a string.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LogRing.h"
+
+namespace pulsemind {
+namespace trace {
+
+// ============================================================================
+// CONSTANTS
+// ============================================================================
+
+constexpr size_t TRACE_ID_BYTES = 16;
+constexpr size_t TRACEPARENT_LENGTH = 55;
+constexpr uint8_t TRACE_FLAG_SAMPLED = 0x01;
+
+/** Bytes per ring slot: header plus service, name and attribute text. */
+constexpr size_t SPAN_SLOT_BYTES = 256;
+constexpr size_t SPAN_MAX_SERVICE_BYTES = 48;
+constexpr size_t SPAN_MAX_NAME_BYTES = 64;
+
+constexpr uint32_t DEFAULT_SPAN_CAPACITY = 8192;
+constexpr uint32_t MAX_SPAN_CAPACITY = 1u << 20;
+
+/** Spans per exported document. */
+constexpr size_t EXPORT_BATCH_SPANS = 512;
+constexpr int64_t EXPORT_INTERVAL_MS = 1000;
+
+constexpr const char* SCOPE_NAME = "pulsemind.trace";
+
+/** OTLP SpanKind. */
+constexpr uint8_t SPAN_KIND_INTERNAL = 1;
+constexpr uint8_t SPAN_KIND_SERVER = 2;
+constexpr uint8_t SPAN_KIND_CLIENT = 3;
+constexpr uint8_t SPAN_KIND_PRODUCER = 4;
+constexpr uint8_t SPAN_KIND_CONSUMER = 5;
+
+/** OTLP status code. */
+constexpr uint8_t SPAN_STATUS_UNSET = 0;
+constexpr uint8_t SPAN_STATUS_OK = 1;
+constexpr uint8_t SPAN_STATUS_ERROR = 2;
+
+// ============================================================================
+// TRACE CONTEXT
+// ============================================================================
+
+struct TraceContext {
+    uint8_t traceId[TRACE_ID_BYTES];
+    uint64_t spanId;  // The sender's span: parent of the receiver's spans
+    uint8_t flags;
+
+    bool valid() const {
+        uint8_t any = 0;
+        for (uint8_t b : traceId) {
+            any |= b;
+        }
+        return any != 0 && spanId != 0;
+    }
+
+    bool sampled() const { return valid() && (flags & TRACE_FLAG_SAMPLED) != 0; }
+};
+
+inline int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;  // Upper case is not valid traceparent
+}
+
+inline bool parseHex(const char* s, size_t digits, uint8_t* out) {
+    for (size_t i = 0; i < digits; i += 2) {
+        const int hi = hexValue(s[i]);
+        const int lo = hexValue(s[i + 1]);
+        if (hi < 0 || lo < 0) {
+            return false;
+        }
+        out[i / 2] = static_cast<uint8_t>(hi << 4 | lo);
+    }
+    return true;
+}
+
+inline void formatHex(const uint8_t* in, size_t bytes, char* out) {
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < bytes; i++) {
+        out[2 * i] = digits[in[i] >> 4];
+        out[2 * i + 1] = digits[in[i] & 0xF];
+    }
+}
+
+inline uint64_t loadBigEndian64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) {
+        v = v << 8 | p[i];
+    }
+    return v;
+}
+
+inline void storeBigEndian64(uint64_t v, uint8_t* p) {
+    for (int i = 7; i >= 0; i--) {
+        p[i] = static_cast<uint8_t>(v);
+        v >>= 8;
+    }
+}
+
+/**
+ * Parse a traceparent header. Version 00 must be exactly 55 characters;
+ * later versions may append fields, version ff is invalid. All-zero ids
+ * are rejected.
+ */
+inline bool parseTraceparent(const char* s, size_t n, TraceContext& out) {
+    if (n < TRACEPARENT_LENGTH || s[2] != '-' || s[35] != '-' || s[52] != '-') {
+        return false;
+    }
+    uint8_t version;
+    uint8_t span[8];
+    if (!parseHex(s, 2, &version) || version == 0xFF || (version == 0 && n != TRACEPARENT_LENGTH) ||
+        (n > TRACEPARENT_LENGTH && s[TRACEPARENT_LENGTH] != '-')) {
+        return false;
+    }
+    if (!parseHex(s + 3, 32, out.traceId) || !parseHex(s + 36, 16, span) || !parseHex(s + 53, 2, &out.flags)) {
+        return false;
+    }
+    out.spanId = loadBigEndian64(span);
+    return out.valid();
+}
+
+/** Write the version 00 traceparent of ctx: TRACEPARENT_LENGTH characters plus a NUL. */
+inline void formatTraceparent(const TraceContext& ctx, char* out) {
+    uint8_t span[8];
+    storeBigEndian64(ctx.spanId, span);
+    out[0] = '0';
+    out[1] = '0';
+    out[2] = '-';
+    formatHex(ctx.traceId, TRACE_ID_BYTES, out + 3);
+    out[35] = '-';
+    formatHex(span, 8, out + 36);
+    out[52] = '-';
+    formatHex(&ctx.flags, 1, out + 53);
+    out[TRACEPARENT_LENGTH] = '\0';
+}
+
+/**
+ * A random non-zero 64-bit id: splitmix64 over a per-thread state seeded
+ * once from the system, so ids never need a lock or a syscall.
+ */
+inline uint64_t randomId() {
+    thread_local uint64_t state = [] {
+        std::random_device device;
+        const uint64_t seed = (static_cast<uint64_t>(device()) << 32) ^ device();
+        return seed ^ static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    }();
+    for (;;) {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        z ^= z >> 31;
+        if (z != 0) {
+            return z;
+        }
+    }
+}
+
+inline void newTraceId(uint8_t* out) {
+    storeBigEndian64(randomId(), out);
+    storeBigEndian64(randomId(), out + 8);
+}
+
+/** Epoch time in microseconds, the clock spans are stamped with. */
+inline int64_t wallUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+// ============================================================================
+// OTLP/JSON
+// ============================================================================
+
+/** Whether an attribute value is a JSON integer ("-12"). */
+inline bool isIntegerText(const char* s, size_t n) {
+    size_t i = (n > 0 && s[0] == '-') ? 1 : 0;
+    if (i == n || n - i > 18 || (s[i] == '0' && n - i > 1)) {
+        return false;
+    }
+    for (; i < n; i++) {
+        if (s[i] < '0' || s[i] > '9') {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Whether an attribute value is a plain JSON decimal ("-1.25"). */
+inline bool isDecimalText(const char* s, size_t n) {
+    const char* dot = static_cast<const char*>(memchr(s, '.', n));
+    if (dot == nullptr || dot + 1 == s + n) {
+        return false;
+    }
+    const size_t intLen = static_cast<size_t>(dot - s);
+    if (!isIntegerText(s, intLen)) {
+        return false;
+    }
+    for (const char* p = dot + 1; p < s + n; p++) {
+        if (*p < '0' || *p > '9') {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Append "key=value" lines as an OTLP attributes array. */
+inline void appendAttributes(std::string& out, const char* attrs, size_t n) {
+    out.append("\"attributes\":[");
+    bool first = true;
+    const char* p = attrs;
+    const char* end = attrs + n;
+    while (p < end) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+        if (eol == nullptr) {
+            eol = end;
+        }
+        const char* eq = static_cast<const char*>(memchr(p, '=', static_cast<size_t>(eol - p)));
+        if (eq != nullptr && eq != p) {
+            const char* value = eq + 1;
+            const size_t valueLen = static_cast<size_t>(eol - value);
+            if (!first) {
+                out.push_back(',');
+            }
+            first = false;
+            out.append("{\"key\":");
+            logring::appendJsonString(out, p, static_cast<size_t>(eq - p));
+            out.append(",\"value\":{");
+            if (isIntegerText(value, valueLen)) {
+                out.append("\"intValue\":\"");
+                out.append(value, valueLen);
+                out.append("\"}}");
+            } else if (isDecimalText(value, valueLen)) {
+                out.append("\"doubleValue\":");
+                out.append(value, valueLen);
+                out.append("}}");
+            } else if ((valueLen == 4 && memcmp(value, "true", 4) == 0) ||
+                       (valueLen == 5 && memcmp(value, "false", 5) == 0)) {
+                out.append("\"boolValue\":");
+                out.append(value, valueLen);
+                out.append("}}");
+            } else {
+                out.append("\"stringValue\":");
+                logring::appendJsonString(out, value, valueLen);
+                out.append("}}");
+            }
+        }
+        p = eol + 1;
+    }
+    out.push_back(']');
+}
+
+// ============================================================================
+// RING
+// ============================================================================
+
+struct SpanSlot {
+    std::atomic<uint64_t> seq;
+    uint8_t traceId[TRACE_ID_BYTES];
+    uint64_t spanId;
+    uint64_t parentId;  // 0: root span
+    int64_t startUs;
+    int64_t durationUs;
+    uint8_t kind;
+    uint8_t status;
+    uint8_t serviceLen;
+    uint8_t nameLen;
+    uint16_t attrsLen;
+    char text[SPAN_SLOT_BYTES - 64];  // service | name | attrs
+};
+static_assert(sizeof(SpanSlot) == SPAN_SLOT_BYTES, "SpanSlot layout");
+
+/** A drained span (consumer side). */
+struct SpanCopy {
+    uint8_t traceId[TRACE_ID_BYTES];
+    uint64_t spanId;
+    uint64_t parentId;
+    int64_t startUs;
+    int64_t durationUs;
+    uint8_t kind;
+    uint8_t status;
+    uint8_t serviceLen;
+    uint8_t nameLen;
+    uint16_t attrsLen;
+    char text[sizeof(SpanSlot::text)];
+};
+
+struct TraceStats {
+    uint64_t recorded;
+    uint64_t dropped;    // Ring full
+    uint64_t exported;
+    uint64_t truncated;  // Attributes cut to whole lines to fit a slot
+};
+
+/**
+ * The span ring. record() may be called from any number of threads;
+ * drain() from one consumer at a time.
+ */
+class SpanRing {
+public:
+    explicit SpanRing(uint32_t capacity)
+        : capacity_(roundCapacity(capacity)), mask_(capacity_ - 1), slots_(new SpanSlot[capacity_]) {
+        for (uint64_t i = 0; i < capacity_; i++) {
+            slots_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~SpanRing() { delete[] slots_; }
+
+    SpanRing(const SpanRing&) = delete;
+    SpanRing& operator=(const SpanRing&) = delete;
+
+    uint32_t capacity() const { return static_cast<uint32_t>(capacity_); }
+
+    /**
+     * Queue one finished span; false if the ring is full (the span is
+     * dropped). Service and name are cut to their caps; attributes keep as
+     * many whole lines as fit.
+     */
+    bool record(const uint8_t* traceId, uint64_t spanId, uint64_t parentId, int64_t startUs, int64_t durationUs,
+                uint8_t kind, uint8_t status, const char* service, size_t serviceLen, const char* name,
+                size_t nameLen, const char* attrs, size_t attrsLen) {
+        uint64_t pos = tail_.load(std::memory_order_relaxed);
+        SpanSlot* slot;
+        for (;;) {
+            slot = &slots_[pos & mask_];
+            const uint64_t seq = slot->seq.load(std::memory_order_acquire);
+            const int64_t diff = static_cast<int64_t>(seq - pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+
+        memcpy(slot->traceId, traceId, TRACE_ID_BYTES);
+        slot->spanId = spanId;
+        slot->parentId = parentId;
+        slot->startUs = startUs;
+        slot->durationUs = durationUs > 0 ? durationUs : 0;
+        slot->kind = kind;
+        slot->status = status;
+        serviceLen = logring::utf8Prefix(service, serviceLen < SPAN_MAX_SERVICE_BYTES ? serviceLen
+                                                                                       : SPAN_MAX_SERVICE_BYTES);
+        nameLen = logring::utf8Prefix(name, nameLen < SPAN_MAX_NAME_BYTES ? nameLen : SPAN_MAX_NAME_BYTES);
+        memcpy(slot->text, service, serviceLen);
+        memcpy(slot->text + serviceLen, name, nameLen);
+        const size_t room = sizeof(slot->text) - serviceLen - nameLen;
+        if (attrsLen > room) {
+            // Keep whole "key=value" lines only
+            size_t keep = room;
+            while (keep > 0 && attrs[keep - 1] != '\n') {
+                keep--;
+            }
+            attrsLen = keep;
+            truncated_.fetch_add(1, std::memory_order_relaxed);
+        }
+        memcpy(slot->text + serviceLen + nameLen, attrs, attrsLen);
+        slot->serviceLen = static_cast<uint8_t>(serviceLen);
+        slot->nameLen = static_cast<uint8_t>(nameLen);
+        slot->attrsLen = static_cast<uint16_t>(attrsLen);
+        slot->seq.store(pos + 1, std::memory_order_release);
+        recorded_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * Take up to maxSpans queued spans and append them to out as one
+     * ExportTraceServiceRequest document (no trailing newline). Returns the
+     * number of spans; 0 appends nothing.
+     */
+    size_t drain(std::string& out, size_t maxSpans) {
+        std::lock_guard<std::mutex> lock(consumer_);
+        batch_.clear();
+        while (batch_.size() < maxSpans) {
+            const uint64_t head = head_.load(std::memory_order_relaxed);
+            SpanSlot& slot = slots_[head & mask_];
+            if (slot.seq.load(std::memory_order_acquire) != head + 1) {
+                break;
+            }
+            batch_.emplace_back();
+            SpanCopy& copy = batch_.back();
+            memcpy(copy.traceId, slot.traceId, TRACE_ID_BYTES);
+            copy.spanId = slot.spanId;
+            copy.parentId = slot.parentId;
+            copy.startUs = slot.startUs;
+            copy.durationUs = slot.durationUs;
+            copy.kind = slot.kind;
+            copy.status = slot.status;
+            copy.serviceLen = slot.serviceLen;
+            copy.nameLen = slot.nameLen;
+            copy.attrsLen = slot.attrsLen;
+            memcpy(copy.text, slot.text, static_cast<size_t>(slot.serviceLen) + slot.nameLen + slot.attrsLen);
+            slot.seq.store(head + capacity_, std::memory_order_release);
+            head_.store(head + 1, std::memory_order_relaxed);
+        }
+        if (batch_.empty()) {
+            return 0;
+        }
+        format(out);
+        exported_.fetch_add(batch_.size(), std::memory_order_relaxed);
+        return batch_.size();
+    }
+
+    TraceStats stats() const {
+        return TraceStats{recorded_.load(), dropped_.load(), exported_.load(), truncated_.load()};
+    }
+
+private:
+    static uint64_t roundCapacity(uint32_t capacity) {
+        uint64_t c = 16;
+        const uint64_t want = capacity < MAX_SPAN_CAPACITY ? capacity : MAX_SPAN_CAPACITY;
+        while (c < want) {
+            c <<= 1;
+        }
+        return c;
+    }
+
+    static bool sameService(const SpanCopy& a, const SpanCopy& b) {
+        return a.serviceLen == b.serviceLen && memcmp(a.text, b.text, a.serviceLen) == 0;
+    }
+
+    /** One resourceSpans entry per service, services in order of first appearance. */
+    void format(std::string& out) {
+        done_.assign(batch_.size(), 0);
+        out.append("{\"resourceSpans\":[");
+        bool firstResource = true;
+        for (size_t i = 0; i < batch_.size(); i++) {
+            if (done_[i]) {
+                continue;
+            }
+            if (!firstResource) {
+                out.push_back(',');
+            }
+            firstResource = false;
+            out.append("{\"resource\":{\"attributes\":[{\"key\":\"service.name\",\"value\":{\"stringValue\":");
+            logring::appendJsonString(out, batch_[i].text, batch_[i].serviceLen);
+            out.append("}}]},\"scopeSpans\":[{\"scope\":{\"name\":\"");
+            out.append(SCOPE_NAME);
+            out.append("\"},\"spans\":[");
+            bool firstSpan = true;
+            for (size_t j = i; j < batch_.size(); j++) {
+                if (done_[j] || !sameService(batch_[i], batch_[j])) {
+                    continue;
+                }
+                done_[j] = 1;
+                if (!firstSpan) {
+                    out.push_back(',');
+                }
+                firstSpan = false;
+                appendSpan(out, batch_[j]);
+            }
+            out.append("]}]}");
+        }
+        out.append("]}");
+    }
+
+    static void appendSpan(std::string& out, const SpanCopy& s) {
+        char hex[33];
+        uint8_t id[8];
+        out.append("{\"traceId\":\"");
+        formatHex(s.traceId, TRACE_ID_BYTES, hex);
+        out.append(hex, 32);
+        out.append("\",\"spanId\":\"");
+        storeBigEndian64(s.spanId, id);
+        formatHex(id, 8, hex);
+        out.append(hex, 16);
+        if (s.parentId != 0) {
+            out.append("\",\"parentSpanId\":\"");
+            storeBigEndian64(s.parentId, id);
+            formatHex(id, 8, hex);
+            out.append(hex, 16);
+        }
+        out.append("\",\"name\":");
+        logring::appendJsonString(out, s.text + s.serviceLen, s.nameLen);
+        out.append(",\"kind\":");
+        out.append(std::to_string(s.kind));
+        out.append(",\"startTimeUnixNano\":\"");
+        out.append(std::to_string(s.startUs * 1000));
+        out.append("\",\"endTimeUnixNano\":\"");
+        out.append(std::to_string((s.startUs + s.durationUs) * 1000));
+        out.push_back('"');
+        if (s.attrsLen > 0) {
+            out.push_back(',');
+            appendAttributes(out, s.text + s.serviceLen + s.nameLen, s.attrsLen);
+        }
+        if (s.status != SPAN_STATUS_UNSET) {
+            out.append(",\"status\":{\"code\":");
+            out.append(std::to_string(s.status));
+            out.push_back('}');
+        }
+        out.push_back('}');
+    }
+
+    const uint64_t capacity_;
+    const uint64_t mask_;
+    SpanSlot* const slots_;
+
+    alignas(64) std::atomic<uint64_t> tail_{0};
+    alignas(64) std::atomic<uint64_t> head_{0};
+
+    std::atomic<uint64_t> recorded_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> exported_{0};
+    std::atomic<uint64_t> truncated_{0};
+
+    // Consumer only
+    std::mutex consumer_;
+    std::vector<SpanCopy> batch_;
+    std::vector<uint8_t> done_;
+};
+
+// ============================================================================
+// EXPORTER
+// ============================================================================
+
+/**
+ * A thread draining a SpanRing every EXPORT_INTERVAL_MS and appending each
+ * document as one line to fd. stop() (or destruction) exports what is left.
+ */
+class TraceExporter {
+public:
+    TraceExporter(SpanRing& ring, int fd, int64_t intervalMs = EXPORT_INTERVAL_MS)
+        : ring_(ring), fd_(fd), intervalMs_(intervalMs) {
+        thread_ = std::thread([this] { run(); });
+    }
+
+    ~TraceExporter() { stop(); }
+
+    TraceExporter(const TraceExporter&) = delete;
+    TraceExporter& operator=(const TraceExporter&) = delete;
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) {
+                return;
+            }
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        thread_.join();
+    }
+
+    uint64_t writeErrors() const { return writeErrors_.load(); }
+
+private:
+    void run() {
+        std::string line;
+        for (;;) {
+            bool stopping;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait_for(lock, std::chrono::milliseconds(intervalMs_), [&] { return stopping_; });
+                stopping = stopping_;
+            }
+            for (;;) {
+                line.clear();
+                if (ring_.drain(line, EXPORT_BATCH_SPANS) == 0) {
+                    break;
+                }
+                line.push_back('\n');
+                writeAll(line);
+            }
+            if (stopping) {
+                return;
+            }
+        }
+    }
+
+    void writeAll(const std::string& data) {
+        size_t done = 0;
+        while (done < data.size()) {
+            const ssize_t n = ::write(fd_, data.data() + done, data.size() - done);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                writeErrors_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            done += static_cast<size_t>(n);
+        }
+    }
+
+    SpanRing& ring_;
+    const int fd_;
+    const int64_t intervalMs_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    std::atomic<uint64_t> writeErrors_{0};
+    std::thread thread_;
+};
+
+}  // namespace trace
+}  // namespace pulsemind
+
+#endif  // PULSEMIND_TRACE_RING_H
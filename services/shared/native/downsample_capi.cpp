@@ -0,0 +1,27 @@
+/**
+ * C ABI over Downsample.h.
+ *
+ * Loaded from Python with ctypes (services/shared/downsample.py) by the
+ * control engine's series endpoint and the dashboard, which hand plots a
+ * pixel budget of points. Output buffers hold max_points points.
+ */
+
+#include "Downsample.h"
+
+using namespace pulsemind;
+
+extern "C" {
+
+uint32_t pm_downsample_abi_version(void) { return 1; }
+
+uint64_t pm_downsample_lttb(const double* x, const double* y, uint64_t n, uint64_t max_points, double* x_out,
+                            double* y_out) {
+    return lttb(x, y, n, max_points, x_out, y_out);
+}
+
+uint64_t pm_downsample_min_max(const double* x, const double* low, const double* high, uint64_t n,
+                               uint64_t max_points, double* x_out, double* y_out) {
+    return minMax(x, low, high, n, max_points, x_out, y_out);
+}
+
+}  // extern "C"
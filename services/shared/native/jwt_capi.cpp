@@ -0,0 +1,45 @@
+/**
+ * C ABI over JwtHs256.h.
+ *
+ * Loaded from Python with ctypes (services/shared/jwt_verify.py), which
+ * verifies the gateway's access tokens with it. A key is created once per
+ * secret and shared by every request thread.
+ *
+ *   pm_jwt_verify   token bytes in; on JWT_OK, out holds the decoded
+ *                   header (header_len bytes) followed by the decoded
+ *                   payload (payload_len bytes)
+ */
+
+#include <new>
+
+#include "JwtHs256.h"
+
+using namespace pulsemind::jwt;
+
+extern "C" {
+
+uint32_t pm_jwt_abi_version(void) { return 1; }
+
+/** A verification key for an HS256 secret, or null on failure. */
+void* pm_jwt_key_new(const uint8_t* secret, uint64_t secret_len) {
+    Hs256Key* key = new (std::nothrow) Hs256Key(secret, secret_len);
+    if (key != nullptr && !key->valid()) {
+        delete key;
+        return nullptr;
+    }
+    return key;
+}
+
+void pm_jwt_key_free(void* key) { delete static_cast<Hs256Key*>(key); }
+
+/** Verify one token; returns a JWT_* status. */
+int32_t pm_jwt_verify(const void* key, const char* token, uint64_t token_len, uint8_t* out, uint64_t out_capacity,
+                      uint64_t* header_len, uint64_t* payload_len) {
+    if (key == nullptr) {
+        return JWT_ERROR;
+    }
+    return verify(*static_cast<const Hs256Key*>(key), token, token_len, out, out_capacity, header_len,
+                  payload_len);
+}
+
+}  // extern "C"
@@ -0,0 +1,183 @@
+/**
+ * Self-checks and cost measurement for HS256 token verification (JwtHs256.h).
+ *
+ * Checks HMAC-SHA256 against RFC 4231 (cases 1, 2 and 6, the last with a
+ * key longer than a block), a known HS256 token, that every tampered or
+ * malformed token is rejected, and that one key verifies correctly from
+ * several threads at once. Then it times verification of a gateway-sized
+ * token.
+ *
+ * Usage:
+ *   jwt_check
+ *
+ * Exit status is 0 when every check passed, 1 otherwise.
+ */
+
+#include "JwtHs256.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace pulsemind::jwt;
+
+namespace {
+
+int g_failures = 0;
+int g_checks = 0;
+
+void expect(bool ok, const char* what) {
+    g_checks++;
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s\n", what);
+        g_failures++;
+    }
+}
+
+std::string hex(const uint8_t* data, size_t n) {
+    static const char* digits = "0123456789abcdef";
+    std::string out;
+    for (size_t i = 0; i < n; i++) {
+        out += digits[data[i] >> 4];
+        out += digits[data[i] & 0xf];
+    }
+    return out;
+}
+
+std::string macHex(const std::string& key, const std::string& message) {
+    Hs256Key k(reinterpret_cast<const uint8_t*>(key.data()), key.size());
+    uint8_t out[HS256_BYTES];
+    if (!k.valid() || !k.mac(reinterpret_cast<const uint8_t*>(message.data()), message.size(), out)) {
+        return "";
+    }
+    return hex(out, sizeof(out));
+}
+
+void checkHmac() {
+    expect(macHex(std::string(20, '\x0b'), "Hi There") ==
+               "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7",
+           "rfc 4231 case 1");
+    expect(macHex("Jefe", "what do ya want for nothing?") ==
+               "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843",
+           "rfc 4231 case 2");
+    expect(macHex(std::string(131, '\xaa'), "Test Using Larger Than Block-Size Key - Hash Key First") ==
+               "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54",
+           "rfc 4231 case 6 (key longer than a block)");
+}
+
+const char* SECRET = "your-256-bit-secret";
+const char* TOKEN =
+    "eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9."
+    "eyJzdWIiOiIxMjM0NTY3ODkwIiwibmFtZSI6IkpvaG4gRG9lIiwiaWF0IjoxNTE2MjM5MDIyfQ."
+    "SflKxwRJSMeKKF2QT4fwpMeJf36POk6yJV_adQssw5c";
+
+struct Result {
+    int32_t status;
+    std::string header;
+    std::string payload;
+};
+
+Result run(const Hs256Key& key, const std::string& token) {
+    uint8_t out[512];
+    uint64_t headerLen = 0;
+    uint64_t payloadLen = 0;
+    Result r{verify(key, token.data(), token.size(), out, sizeof(out), &headerLen, &payloadLen), "", ""};
+    if (r.status == JWT_OK) {
+        r.header.assign(reinterpret_cast<const char*>(out), headerLen);
+        r.payload.assign(reinterpret_cast<const char*>(out + headerLen), payloadLen);
+    }
+    return r;
+}
+
+void checkTokens() {
+    Hs256Key key(reinterpret_cast<const uint8_t*>(SECRET), strlen(SECRET));
+    Result r = run(key, TOKEN);
+    expect(r.status == JWT_OK, "known token verifies");
+    expect(r.header == "{\"alg\":\"HS256\",\"typ\":\"JWT\"}", "header decoded");
+    expect(r.payload == "{\"sub\":\"1234567890\",\"name\":\"John Doe\",\"iat\":1516239022}", "payload decoded");
+
+    Hs256Key other(reinterpret_cast<const uint8_t*>("another secret"), 14);
+    expect(run(other, TOKEN).status == JWT_BAD_SIGNATURE, "other secret rejected");
+
+    const std::string token = TOKEN;
+    const size_t signature = token.rfind('.') + 1;
+    bool allRejected = true;
+    for (size_t i = 0; i < token.size(); i++) {
+        if (token[i] == '.') {
+            continue;
+        }
+        std::string tampered = token;
+        tampered[i] = token[i] == 'A' ? 'B' : 'A';
+        allRejected &= run(key, tampered).status != JWT_OK;
+    }
+    expect(allRejected, "every changed character is rejected");
+
+    // 'c' ends the signature with 2 unused bits set to 0; 'd' sets one of them
+    std::string looseBits = token;
+    looseBits.back() = 'd';
+    expect(run(key, looseBits).status == JWT_MALFORMED, "non-canonical signature encoding rejected");
+    expect(run(key, token + "=").status == JWT_MALFORMED, "padding rejected");
+    expect(run(key, token.substr(0, signature)).status == JWT_MALFORMED, "empty signature (alg none) rejected");
+    expect(run(key, token.substr(0, signature - 1)).status == JWT_MALFORMED, "two segments rejected");
+    expect(run(key, token + ".x").status == JWT_MALFORMED, "four segments rejected");
+    expect(run(key, "").status == JWT_MALFORMED, "empty token rejected");
+    expect(run(key, token.substr(0, signature) + std::string(43, '+')).status == JWT_MALFORMED,
+           "standard base64 alphabet rejected");
+
+    uint8_t small[16];
+    uint64_t headerLen = 0;
+    uint64_t payloadLen = 0;
+    expect(verify(key, token.data(), token.size(), small, sizeof(small), &headerLen, &payloadLen) == JWT_TOO_LARGE,
+           "small output reported");
+}
+
+void checkThreads() {
+    Hs256Key key(reinterpret_cast<const uint8_t*>(SECRET), strlen(SECRET));
+    std::atomic<int> failures{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 20000; i++) {
+                failures += run(key, TOKEN).status != JWT_OK;
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    expect(failures.load() == 0, "one key shared by four threads");
+}
+
+void bench() {
+    Hs256Key key(reinterpret_cast<const uint8_t*>(SECRET), strlen(SECRET));
+    const int n = 200000;
+    const std::string token = TOKEN;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+        run(key, token);
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("bench: %zu-byte token: %.0f ns per verification\n", token.size(), seconds / n * 1e9);
+}
+
+}  // namespace
+
+int main() {
+    checkHmac();
+    checkTokens();
+    checkThreads();
+    if (g_failures == 0) {
+        bench();
+    }
+    if (g_failures) {
+        fprintf(stderr, "jwt_check: %d of %d checks failed\n", g_failures, g_checks);
+        return 1;
+    }
+    printf("jwt_check: all %d checks passed\n", g_checks);
+    return 0;
+}
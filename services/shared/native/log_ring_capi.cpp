@@ -0,0 +1,115 @@
+/**
+ * C ABI over LogRing.h.
+ *
+ * Loaded from Python with ctypes (services/shared/native_log.py): each
+ * service process opens one sink on stdout and its logging handler submits
+ * records to it. Rate-limited call sites live in a fixed process-wide table,
+ * so admission is a lock-free call with no allocation.
+ */
+
+#include <new>
+#include <string>
+#include <vector>
+
+#include "LogRing.h"
+
+using namespace pulsemind::logring;
+
+namespace {
+
+constexpr uint32_t MAX_SITES = 1024;
+
+LogRateLimiter g_sites[MAX_SITES];
+std::atomic<uint32_t> g_siteCount{0};
+
+int64_t monotonicNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+}  // namespace
+
+extern "C" {
+
+uint32_t pm_log_abi_version(void) { return 1; }
+
+/**
+ * Open a sink writing to fd. phi_patterns is a newline-separated list of
+ * PHI field names; nullptr if they do not compile. The consumer starts
+ * immediately.
+ */
+LogSink* pm_log_open(int32_t fd, uint32_t capacity, const char* phi_patterns) {
+    LogSink* sink = new (std::nothrow) LogSink(fd, capacity ? capacity : DEFAULT_LOG_CAPACITY);
+    if (sink == nullptr) {
+        return nullptr;
+    }
+    std::vector<std::string> patterns;
+    std::string current;
+    for (const char* p = phi_patterns ? phi_patterns : ""; *p; p++) {
+        if (*p == '\n') {
+            patterns.push_back(current);
+            current.clear();
+        } else {
+            current.push_back(*p);
+        }
+    }
+    patterns.push_back(current);
+    if (!sink->setPhiPatterns(patterns)) {
+        delete sink;
+        return nullptr;
+    }
+    sink->start();
+    return sink;
+}
+
+/**
+ * Queue one record (UTF-8 text with explicit lengths); 0 if the ring was
+ * full and the record dropped.
+ */
+int32_t pm_log_submit(LogSink* sink, int64_t time_us, int32_t level, const char* service, uint64_t service_len,
+                      const char* extra, uint64_t extra_len, const char* message, uint64_t message_len,
+                      const char* exc, uint64_t exc_len) {
+    return sink->submit(time_us, level, service, service_len, extra, extra_len, message, message_len, exc, exc_len);
+}
+
+/** Wait up to timeout_ms for queued records to be written; 1 if they were. */
+int32_t pm_log_flush(LogSink* sink, int64_t timeout_ms) { return sink->flush(timeout_ms); }
+
+void pm_log_stats(const LogSink* sink, LogStats* out) { *out = sink->stats(); }
+
+/** Drain, stop the consumer and free the sink. */
+void pm_log_close(LogSink* sink) { delete sink; }
+
+/**
+ * Register a call site: keep every sample_every-th record and at most
+ * rate_per_second (burst at once; 0 for no rate limit). Returns the site id,
+ * or -1 when the table is full.
+ */
+int32_t pm_log_site_new(double rate_per_second, double burst, uint32_t sample_every) {
+    const uint32_t id = g_siteCount.fetch_add(1);
+    if (id >= MAX_SITES) {
+        g_siteCount.store(MAX_SITES);
+        return -1;
+    }
+    g_sites[id].configure(rate_per_second, burst, sample_every);
+    return static_cast<int32_t>(id);
+}
+
+/** -1 to drop the record, else the number suppressed since the last one kept. */
+int64_t pm_log_site_allow(int32_t site) {
+    if (site < 0 || static_cast<uint32_t>(site) >= MAX_SITES) {
+        return 0;
+    }
+    return g_sites[site].allow(monotonicNs());
+}
+
+/** pm_log_site_allow at an explicit monotonic time, for tests. */
+int64_t pm_log_site_allow_at(int32_t site, int64_t now_ns) {
+    if (site < 0 || static_cast<uint32_t>(site) >= MAX_SITES) {
+        return 0;
+    }
+    return g_sites[site].allow(now_ns);
+}
+
+}  // extern "C"
@@ -0,0 +1,356 @@
+/**
+ * Self-checks and cost measurement for the logging ring (LogRing.h).
+ *
+ * Checks the PHI matcher against a naive lower-case search on random text,
+ * JSON escaping against json.dumps output, UTF-8 safe truncation,
+ * timestamps, the rate limiter on a synthetic clock, and a sink fed by
+ * several threads at once: every record written exactly once, in order per
+ * thread, or counted as dropped. Then it times submit() from one and from
+ * several threads into /dev/null.
+ *
+ * Usage:
+ *   log_ring_check [--records N]
+ *
+ * Exit status is 0 when every check passed, 1 otherwise.
+ */
+
+#include "LogRing.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace pulsemind::logring;
+
+namespace {
+
+int g_failures = 0;
+int g_checks = 0;
+
+void expect(bool ok, const char* what) {
+    g_checks++;
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s\n", what);
+        g_failures++;
+    }
+}
+
+const std::vector<std::string> PHI = {"patient_id", "ssn", "birth_date", "signal", "raw_data"};
+
+bool naiveMatch(const std::vector<std::string>& patterns, const std::string& text) {
+    std::string lower = text;
+    for (char& c : lower) {
+        if (c >= 'A' && c <= 'Z') {
+            c = static_cast<char>(c + 32);
+        }
+    }
+    for (const std::string& p : patterns) {
+        if (lower.find(p) != std::string::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void checkMatcher() {
+    PhiMatcher matcher;
+    expect(!matcher.matches("ssn", 3), "unbuilt matcher matches nothing");
+    expect(matcher.build(PHI), "PHI patterns compile");
+    const char* hits[] = {"patient_id=42", "Patient_ID", "SSN: 1", "lessness", "raw signal", "x BIRTH_DATE"};
+    for (const char* text : hits) {
+        expect(matcher.matches(text, strlen(text)), text);
+    }
+    const char* misses[] = {"", "Processing PPG", "patient id", "sig nal", "birth-date"};
+    for (const char* text : misses) {
+        expect(!matcher.matches(text, strlen(text)), text);
+    }
+
+    // Overlapping patterns need the failure links
+    PhiMatcher overlap;
+    expect(overlap.build({"he", "she", "his", "hers"}), "overlapping patterns compile");
+    expect(overlap.matches("ushers", 6), "ushers");
+    expect(overlap.matches("ahishe", 6), "ahishe");
+    expect(!overlap.matches("hxsxr", 5), "hxsxr");
+
+    std::mt19937 rng(7);
+    const char alphabet[] = "aAbdehinrsStw_ ";
+    int agree = 0;
+    const int trials = 20000;
+    for (int t = 0; t < trials; t++) {
+        std::string text(rng() % 40, ' ');
+        for (char& c : text) {
+            c = alphabet[rng() % (sizeof(alphabet) - 1)];
+        }
+        // Plant a pattern now and then, in random case
+        if (rng() % 4 == 0) {
+            std::string p = PHI[rng() % PHI.size()];
+            for (char& c : p) {
+                if (rng() % 2) {
+                    c = static_cast<char>(toupper(c));
+                }
+            }
+            text.insert(rng() % (text.size() + 1), p);
+        }
+        agree += matcher.matches(text.data(), text.size()) == naiveMatch(PHI, text);
+    }
+    expect(agree == trials, "matcher agrees with naive search on random text");
+}
+
+std::string json(const std::string& s) {
+    std::string out;
+    appendJsonString(out, s.data(), s.size());
+    return out;
+}
+
+void checkJson() {
+    // Expected values are json.dumps() output
+    expect(json("plain") == "\"plain\"", "plain string");
+    expect(json("q\"b\\n\nr\rt\tb\bf\f") == "\"q\\\"b\\\\n\\nr\\rt\\tb\\bf\\f\"", "short escapes");
+    expect(json(std::string("\x01\x1f\x7f", 3)) == "\"\\u0001\\u001f\x7f\"", "control characters");
+    expect(json("\xc3\xa9") == "\"\\u00e9\"", "two-byte UTF-8");
+    expect(json("\xe2\x82\xac") == "\"\\u20ac\"", "three-byte UTF-8");
+    expect(json("\xf0\x9f\x92\x93") == "\"\\ud83d\\udc93\"", "four-byte UTF-8 as a surrogate pair");
+    expect(json("\xed\xa0\x80") == "\"\\ud800\"", "lone surrogate (surrogatepass)");
+    expect(json("a\xff" "b") == "\"a\\ufffdb\"", "invalid byte");
+    expect(json("\xc3") == "\"\\ufffd\"", "cut sequence");
+    expect(json("\xc0\x80") == "\"\\ufffd\\ufffd\"", "overlong encoding");
+
+    const std::string euro = "ab\xe2\x82\xac";
+    expect(utf8Prefix(euro.data(), 5) == 5, "whole sequence kept");
+    expect(utf8Prefix(euro.data(), 4) == 2, "cut inside a sequence backs up");
+    expect(utf8Prefix(euro.data(), 3) == 2, "cut after a lead byte backs up");
+    expect(utf8Prefix(euro.data(), 2) == 2, "cut before a sequence is kept");
+    const std::string whole = "a\xc3\xa9";
+    expect(utf8Prefix(whole.data(), 3) == 3, "complete sequence kept");
+
+    TimestampFormatter ts;
+    std::string out;
+    ts.append(out, 0);
+    expect(out == "1970-01-01T00:00:00.000000Z", "epoch");
+    out.clear();
+    ts.append(out, 1767225600123456LL);
+    expect(out == "2026-01-01T00:00:00.123456Z", "2026 timestamp");
+    out.clear();
+    ts.append(out, -1);
+    expect(out == "1969-12-31T23:59:59.999999Z", "negative time");
+}
+
+void checkRateLimiter() {
+    LogRateLimiter limiter;
+    limiter.configure(10.0, 3.0, 1);
+    const int64_t t0 = 1000000000LL;
+    expect(limiter.allow(t0) == 0, "burst 1");
+    expect(limiter.allow(t0) == 0, "burst 2");
+    expect(limiter.allow(t0) == 0, "burst 3");
+    expect(limiter.allow(t0) == -1, "beyond burst suppressed");
+    expect(limiter.allow(t0 + 50000000) == -1, "before the next slot suppressed");
+    expect(limiter.allow(t0 + 100000000) == 2, "next slot reports two suppressed");
+    expect(limiter.allow(t0 + 10000000000LL) == 0, "long idle refills");
+
+    LogRateLimiter sampled;
+    sampled.configure(0, 0, 4);
+    int kept = 0;
+    int64_t suppressed = 0;
+    for (int i = 0; i < 100; i++) {
+        const int64_t r = sampled.allow(t0);
+        if (r >= 0) {
+            kept++;
+            suppressed += r;
+        }
+    }
+    expect(kept == 25, "every 4th record kept");
+    expect(suppressed == 72, "suppressed counts reported (last 3 pending)");
+}
+
+std::string readFile(const char* path) {
+    std::string data;
+    FILE* f = fopen(path, "rb");
+    if (f == nullptr) {
+        return data;
+    }
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        data.append(buf, n);
+    }
+    fclose(f);
+    return data;
+}
+
+void checkSink(unsigned records) {
+    const char* path = "build/log_ring_check.out";
+    const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0640);
+    expect(fd >= 0, "open output");
+    if (fd < 0) {
+        return;
+    }
+    const unsigned threads = 4;
+    uint64_t accepted = 0;
+    uint64_t rejected = 0;
+    {
+        LogSink sink(fd, 256);
+        expect(sink.setPhiPatterns(PHI), "sink patterns");
+        sink.start();
+
+        std::vector<std::thread> pool;
+        std::vector<uint64_t> ok(threads, 0);
+        for (unsigned t = 0; t < threads; t++) {
+            pool.emplace_back([&, t] {
+                char message[64];
+                for (unsigned i = 0; i < records; i++) {
+                    const int n = snprintf(message, sizeof(message), "t%u i%u", t, i);
+                    ok[t] += sink.submit(1767225600000000LL + i, 20, "check", 5, "", 0, message,
+                                         static_cast<size_t>(n), "", 0);
+                    if (i % 64 == 0) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (std::thread& th : pool) {
+            th.join();
+        }
+        for (uint64_t n : ok) {
+            accepted += n;
+        }
+        rejected = threads * static_cast<uint64_t>(records) - accepted;
+
+        const std::string phi = "lookup patient_id=7";
+        sink.submit(0, 40, "check", 5, "\"suppressed\": 3", 15, phi.data(), phi.size(), "Traceback", 9);
+        const std::string big(5000, 'x');
+        sink.submit(0, 25, "check", 5, "", 0, big.data(), big.size(), "", 0);
+        expect(sink.flush(5000), "flush completes");
+
+        const LogStats stats = sink.stats();
+        expect(stats.submitted == accepted + 2, "submitted counts accepted records");
+        expect(stats.dropped == rejected, "dropped counts rejected records");
+        expect(stats.written == accepted + 2, "every accepted record written");
+        expect(stats.redacted == 1, "one record redacted");
+        expect(stats.truncated == 1, "one record truncated");
+    }
+    close(fd);
+
+    const std::string out = readFile(path);
+    std::vector<int64_t> last(threads, -1);
+    bool ordered = true;
+    bool wellFormed = true;
+    uint64_t lines = 0;
+    uint64_t dropNotices = 0;
+    size_t start = 0;
+    std::string redactedLine;
+    std::string truncatedLine;
+    while (start < out.size()) {
+        const size_t end = out.find('\n', start);
+        const std::string line = out.substr(start, end - start);
+        start = end + 1;
+        wellFormed &= line.front() == '{' && line.back() == '}';
+        unsigned t = 0;
+        unsigned i = 0;
+        const size_t m = line.find("\"message\": \"t");
+        if (m != std::string::npos && sscanf(line.c_str() + m, "\"message\": \"t%u i%u\"", &t, &i) == 2) {
+            ordered &= t < threads && static_cast<int64_t>(i) > last[t];
+            last[t] = i;
+            lines++;
+        } else if (line.find("log ring full") != std::string::npos) {
+            dropNotices++;
+        } else if (line.find("REDACTED") != std::string::npos) {
+            redactedLine = line;
+        } else if (line.find("\"truncated\": true") != std::string::npos) {
+            truncatedLine = line;
+        }
+    }
+    expect(wellFormed, "every line is a JSON object");
+    expect(ordered, "records of one thread stay in order");
+    expect(lines == accepted, "one line per accepted record");
+    expect(rejected == 0 || dropNotices > 0, "drops are reported");
+    expect(redactedLine ==
+               "{\"timestamp\": \"1970-01-01T00:00:00.000000Z\", \"level\": \"ERROR\", \"service\": \"check\", "
+               "\"message\": \"[REDACTED_POTENTIAL_PHI]\", \"exc_info\": \"Traceback\", \"suppressed\": 3}",
+           "redacted record layout");
+    expect(truncatedLine.find("\"level\": \"Level 25\"") != std::string::npos, "custom level name");
+    expect(truncatedLine.size() < LOG_SLOT_BYTES + 200, "truncated to the slot");
+    printf("sink: %llu records from %u threads, %llu dropped with a 256-slot ring\n",
+           static_cast<unsigned long long>(accepted), threads, static_cast<unsigned long long>(rejected));
+    unlink(path);
+}
+
+void bench(unsigned records) {
+    // Bursts of half a ring, each flushed before the next: submit() is timed
+    // alone, the flush gives the consumer's formatting throughput
+    const int fd = open("/dev/null", O_WRONLY);
+    const std::string message = "Features extracted: HR=72.4 BPM, HRV=41.0 ms";
+    const unsigned burst = DEFAULT_LOG_CAPACITY / 2;
+    for (unsigned threads : {1u, 4u}) {
+        LogSink sink(fd, DEFAULT_LOG_CAPACITY);
+        sink.setPhiPatterns(PHI);
+        sink.start();
+        double submitNs = 0;
+        double totalNs = 0;
+        uint64_t kept = 0;
+        uint64_t submitted = 0;
+        for (unsigned done = 0; done < records; done += burst) {
+            std::vector<std::thread> pool;
+            std::vector<uint64_t> ok(threads, 0);
+            std::vector<double> ns(threads, 0);
+            const auto t0 = std::chrono::steady_clock::now();
+            for (unsigned t = 0; t < threads; t++) {
+                pool.emplace_back([&, t] {
+                    const auto s0 = std::chrono::steady_clock::now();
+                    for (unsigned i = 0; i < burst / threads; i++) {
+                        ok[t] += sink.submit(1767225600000000LL + i, 20, "signal-service", 14, "", 0,
+                                             message.data(), message.size(), "", 0);
+                    }
+                    ns[t] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - s0).count();
+                });
+            }
+            for (std::thread& th : pool) {
+                th.join();
+            }
+            sink.flush(10000);
+            totalNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+            for (unsigned t = 0; t < threads; t++) {
+                kept += ok[t];
+                submitNs += ns[t];
+            }
+            submitted += burst / threads * threads;
+        }
+        printf("bench: %u thread(s): %.0f ns per submit, %.2f M records/s formatted\n", threads,
+               submitNs / static_cast<double>(kept), static_cast<double>(kept) / totalNs * 1e3);
+        expect(kept == submitted, "bursts of half a ring are never dropped");
+    }
+    close(fd);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    unsigned records = 200000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--records") == 0 && i + 1 < argc) {
+            records = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+        } else {
+            fprintf(stderr, "usage: %s [--records N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    checkMatcher();
+    checkJson();
+    checkRateLimiter();
+    checkSink(records / 4);
+    bench(records);
+
+    if (g_failures > 0) {
+        fprintf(stderr, "log_ring_check: %d of %d check(s) failed\n", g_failures, g_checks);
+        return 1;
+    }
+    printf("log_ring_check: all %d checks passed\n", g_checks);
+    return 0;
+}
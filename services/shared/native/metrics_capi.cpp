@@ -0,0 +1,113 @@
+/**
+ * C ABI over Metrics.h.
+ *
+ * Loaded from Python with ctypes (services/shared/metrics.py): each service
+ * process keeps one registry, records into it through the handles it
+ * registered and renders it for /metrics.
+ */
+
+#include <new>
+
+#include "Metrics.h"
+
+using namespace pulsemind::metrics;
+
+namespace {
+
+/** A registry and the exposition rendered from it but not yet taken. */
+struct MetricsHandle {
+    explicit MetricsHandle(uint32_t cells) : registry(cells) {}
+    Registry registry;
+    std::mutex renderMutex;
+    std::string pending;
+};
+
+}  // namespace
+
+extern "C" {
+
+uint32_t pm_metrics_abi_version(void) { return 1; }
+
+MetricsHandle* pm_metrics_open(uint32_t cells) {
+    return new (std::nothrow) MetricsHandle(cells ? cells : DEFAULT_METRIC_CELLS);
+}
+
+/**
+ * Register a series (type: 0 counter, 1 gauge, 2 histogram; text is UTF-8
+ * with explicit lengths, labels preformatted as name="value" pairs).
+ * Returns its handle, or -1 if refused.
+ */
+int32_t pm_metrics_register(MetricsHandle* handle, uint8_t type, const char* name, uint64_t name_len,
+                            const char* help, uint64_t help_len, const char* labels, uint64_t labels_len) {
+    if (type > static_cast<uint8_t>(MetricType::Histogram)) {
+        return -1;
+    }
+    return handle->registry.add(static_cast<MetricType>(type), std::string_view(name, name_len),
+                                std::string_view(help, help_len), std::string_view(labels, labels_len));
+}
+
+void pm_metrics_counter_add(MetricsHandle* handle, int32_t metric, uint64_t n) {
+    handle->registry.counterAdd(metric, n);
+}
+
+void pm_metrics_counter_store(MetricsHandle* handle, int32_t metric, uint64_t total) {
+    handle->registry.counterStore(metric, total);
+}
+
+void pm_metrics_gauge_set(MetricsHandle* handle, int32_t metric, double value) {
+    handle->registry.gaugeSet(metric, value);
+}
+
+void pm_metrics_gauge_add(MetricsHandle* handle, int32_t metric, double delta) {
+    handle->registry.gaugeAdd(metric, delta);
+}
+
+void pm_metrics_observe_us(MetricsHandle* handle, int32_t metric, uint64_t us) {
+    handle->registry.histogramRecord(metric, us);
+}
+
+uint64_t pm_metrics_counter_value(const MetricsHandle* handle, int32_t metric) {
+    return handle->registry.counterValue(metric);
+}
+
+double pm_metrics_gauge_value(const MetricsHandle* handle, int32_t metric) {
+    return handle->registry.gaugeValue(metric);
+}
+
+uint64_t pm_metrics_histogram_count(const MetricsHandle* handle, int32_t metric) {
+    return handle->registry.histogramCount(metric);
+}
+
+uint64_t pm_metrics_histogram_sum_us(const MetricsHandle* handle, int32_t metric) {
+    return handle->registry.histogramSum(metric);
+}
+
+/** Upper bound (microseconds) of the bucket holding quantile q; 0 when empty. */
+uint64_t pm_metrics_histogram_quantile_us(const MetricsHandle* handle, int32_t metric, double q) {
+    return handle->registry.histogramQuantile(metric, q);
+}
+
+/**
+ * Render the exposition into out. Returns its length, or minus the length
+ * needed when out is too small (the text is kept for the next call, so a
+ * retry with a larger buffer returns the same scrape).
+ */
+int64_t pm_metrics_render(MetricsHandle* handle, char* out, uint64_t capacity) {
+    std::lock_guard<std::mutex> lock(handle->renderMutex);
+    if (handle->pending.empty()) {
+        handle->registry.render(handle->pending);
+    }
+    const uint64_t length = handle->pending.size();
+    if (length > capacity) {
+        return -static_cast<int64_t>(length);
+    }
+    memcpy(out, handle->pending.data(), length);
+    handle->pending.clear();
+    return static_cast<int64_t>(length);
+}
+
+void pm_metrics_stats(const MetricsHandle* handle, MetricsStats* out) { *out = handle->registry.stats(); }
+
+void pm_metrics_close(MetricsHandle* handle) { delete handle; }
+
+}  // extern "C"
@@ -0,0 +1,288 @@
+/**
+ * Self-checks and cost measurement for the metrics registry (Metrics.h).
+ *
+ * Checks the histogram bucket layout (every bucket's bound maps back to it,
+ * buckets tile the value range, widths stay within 1/HISTOGRAM_SUB_BUCKETS
+ * of their values), metric name and label validation, registration
+ * (idempotent, type conflicts, running out of cells), the exact exposition
+ * text of a small registry, quantiles, and counters and histograms fed by
+ * several threads at once: nothing lost. Then it times recording from one
+ * and from several threads (thread CPU time).
+ *
+ * Usage:
+ *   metrics_check [--samples N]
+ *
+ * Exit status is 0 when every check passed, 1 otherwise.
+ */
+
+#include "Metrics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace pulsemind::metrics;
+
+namespace {
+
+int g_failures = 0;
+int g_checks = 0;
+
+void expect(bool ok, const char* what) {
+    g_checks++;
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s\n", what);
+        g_failures++;
+    }
+}
+
+void checkBuckets() {
+    bool roundTrip = true;
+    bool tiled = true;
+    bool narrow = true;
+    for (uint32_t b = 0; b < HISTOGRAM_BUCKETS; b++) {
+        const uint64_t bound = histogramBound(b);
+        roundTrip &= histogramBucket(bound) == b;
+        if (b + 1 < HISTOGRAM_BUCKETS) {
+            tiled &= histogramBucket(bound + 1) == b + 1;
+        }
+        if (b >= HISTOGRAM_SUB_BUCKETS) {  // Below, every value has a bucket of its own
+            narrow &= (bound - histogramBound(b - 1)) * HISTOGRAM_SUB_BUCKETS <= bound;
+        }
+    }
+    expect(roundTrip, "bucket bound maps back to its bucket");
+    expect(tiled, "buckets tile the value range");
+    expect(narrow, "bucket width within 1/HISTOGRAM_SUB_BUCKETS of its values");
+    expect(histogramBucket(0) == 0 && histogramBucket(1) == 0 && histogramBucket(2) == 1, "small values");
+    expect(histogramBound(HISTOGRAM_BUCKETS - 1) == 1ull << HISTOGRAM_MAX_BITS, "last bound");
+    expect(histogramBucket(UINT64_MAX) == HISTOGRAM_BUCKETS - 1, "huge values land in the last bucket");
+    bool powers = true;
+    for (uint32_t k = 0; k <= 2 * HISTOGRAM_LE_STEPS; k++) {
+        powers &= histogramBound(histogramBucket(1ull << k)) == 1ull << k;
+    }
+    expect(powers, "powers of two are bucket bounds");
+}
+
+void checkValidation() {
+    expect(validMetricName("pulsemind_http_requests_total"), "plain name");
+    expect(validMetricName("ns:sub_1"), "colon and digit");
+    expect(!validMetricName("1abc"), "leading digit");
+    expect(!validMetricName("a-b"), "dash");
+    expect(!validMetricName(""), "empty name");
+    expect(!validMetricName(std::string(MAX_METRIC_NAME_BYTES + 1, 'a')), "long name");
+
+    expect(validLabels("", false), "no labels");
+    expect(validLabels("service=\"a\",route=\"/x\"", false), "two labels");
+    expect(validLabels("v=\"a\\\"b\\\\c\\n\"", false), "escaped value");
+    expect(validLabels("v=\"\"", false), "empty value");
+    expect(!validLabels("v=\"a\",", false), "trailing comma");
+    expect(!validLabels("v=a", false), "unquoted value");
+    expect(!validLabels("v=\"a", false), "unterminated value");
+    expect(!validLabels("v=\"a\\x\"", false), "bad escape");
+    expect(!validLabels("v=\"a\nb\"", false), "raw newline");
+    expect(!validLabels("1v=\"a\"", false), "label name with leading digit");
+    expect(!validLabels("le=\"1\"", true), "le on a histogram");
+    expect(validLabels("le=\"1\"", false), "le elsewhere");
+}
+
+void checkRegistration() {
+    Registry registry(1);  // Clamped up to one histogram's cells
+    expect(registry.add(MetricType::Histogram, "latency_seconds", "", "") >= 0, "histogram");
+    const int32_t a = registry.add(MetricType::Counter, "requests_total", "Requests", "route=\"/a\"");
+    const int32_t b = registry.add(MetricType::Counter, "requests_total", "ignored", "route=\"/b\"");
+    expect(a >= 0 && b >= 0 && a != b, "two series of a family");
+    expect(registry.add(MetricType::Counter, "requests_total", "", "route=\"/a\"") == a, "same series, same handle");
+    expect(registry.add(MetricType::Gauge, "requests_total", "", "route=\"/c\"") < 0, "type conflict");
+    expect(registry.add(MetricType::Counter, "bad name", "", "") < 0, "invalid name");
+    expect(registry.add(MetricType::Histogram, "other_seconds", "", "") < 0, "out of cells");
+    const MetricsStats st = registry.stats();
+    expect(st.families == 2 && st.series == 3 && st.rejected == 3, "stats");
+
+    registry.counterAdd(-1, 1);
+    registry.counterAdd(1 << 30, 1);
+    registry.histogramRecord(a, 5);  // A counter's handle, too close to the end for a histogram
+    expect(registry.counterValue(a) == 0 && registry.counterValue(b) == 0, "out of range handles ignored");
+}
+
+void checkExposition() {
+    Registry registry;
+    const int32_t requests = registry.add(MetricType::Counter, "http_requests_total", "HTTP requests\nby route",
+                                          "route=\"/a\"");
+    const int32_t bare = registry.add(MetricType::Counter, "frames_total", "Frames \\ total", "");
+    const int32_t depth = registry.add(MetricType::Gauge, "queue_depth", "Queue depth", "");
+    const int32_t ratio = registry.add(MetricType::Gauge, "ratio", "", "k=\"v\"");
+    const int32_t latency = registry.add(MetricType::Histogram, "latency_seconds", "Latency", "op=\"x\"");
+    registry.counterAdd(requests, 3);
+    registry.counterAdd(requests, 2);
+    registry.counterStore(bare, 42);
+    registry.gaugeSet(depth, 7);
+    registry.gaugeAdd(depth, 0.5);
+    registry.gaugeSet(ratio, -INFINITY);
+    for (uint64_t us : {1ull, 3ull, 4ull, 250ull, 1000000ull, 100000000ull}) {
+        registry.histogramRecord(latency, us);
+    }
+    expect(registry.counterValue(requests) == 5, "counter value");
+    expect(registry.gaugeValue(depth) == 7.5, "gauge value");
+    expect(registry.histogramCount(latency) == 6 && registry.histogramSum(latency) == 101000258, "histogram totals");
+
+    std::string text;
+    registry.render(text);
+    std::string expected =
+        "# HELP http_requests_total HTTP requests\\nby route\n"
+        "# TYPE http_requests_total counter\n"
+        "http_requests_total{route=\"/a\"} 5\n"
+        "# HELP frames_total Frames \\\\ total\n"
+        "# TYPE frames_total counter\n"
+        "frames_total 42\n"
+        "# HELP queue_depth Queue depth\n"
+        "# TYPE queue_depth gauge\n"
+        "queue_depth 7.5\n"
+        "# HELP ratio \n"
+        "# TYPE ratio gauge\n"
+        "ratio{k=\"v\"} -Inf\n"
+        "# HELP latency_seconds Latency\n"
+        "# TYPE latency_seconds histogram\n";
+    const uint64_t cumulative[HISTOGRAM_LE_STEPS + 1] = {1, 3, 3, 3, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5};
+    uint64_t le = 1;
+    for (uint64_t c : cumulative) {
+        char line[96];
+        snprintf(line, sizeof(line), "latency_seconds_bucket{op=\"x\",le=\"%llu.%06llu\"} %llu\n",
+                 static_cast<unsigned long long>(le / 1000000), static_cast<unsigned long long>(le % 1000000),
+                 static_cast<unsigned long long>(c));
+        expected += line;
+        le *= 4;
+    }
+    expected +=
+        "latency_seconds_bucket{op=\"x\",le=\"+Inf\"} 6\n"
+        "latency_seconds_sum{op=\"x\"} 101.000258\n"
+        "latency_seconds_count{op=\"x\"} 6\n";
+    expect(text == expected, "exposition text");
+    if (text != expected) {
+        fprintf(stderr, "got:\n%s\nexpected:\n%s\n", text.c_str(), expected.c_str());
+    }
+}
+
+void checkQuantiles() {
+    Registry registry;
+    const int32_t h = registry.add(MetricType::Histogram, "q_seconds", "", "");
+    expect(registry.histogramQuantile(h, 0.5) == 0, "empty quantile");
+    for (uint64_t us = 1; us <= 10000; us++) {
+        registry.histogramRecord(h, us);
+    }
+    bool close = true;
+    for (double q : {0.01, 0.5, 0.9, 0.99, 1.0}) {
+        const double exact = q * 10000;
+        const double got = static_cast<double>(registry.histogramQuantile(h, q));
+        close &= got >= exact && got <= exact * (1.0 + 1.0 / HISTOGRAM_SUB_BUCKETS);
+    }
+    expect(close, "quantiles within a bucket of the exact value");
+    expect(registry.histogramQuantile(h, 0) == 1, "quantile 0 is the first sample's bucket");
+}
+
+void checkConcurrency(unsigned samples) {
+    Registry registry;
+    const int32_t counter = registry.add(MetricType::Counter, "c_total", "", "");
+    const int32_t gauge = registry.add(MetricType::Gauge, "g", "", "");
+    const int32_t histogram = registry.add(MetricType::Histogram, "h_seconds", "", "");
+    const unsigned threads = 8;
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; t++) {
+        pool.emplace_back([&, t] {
+            for (unsigned i = 0; i < samples; i++) {
+                registry.counterAdd(counter, 1);
+                registry.gaugeAdd(gauge, 1);
+                registry.histogramRecord(histogram, t * 1000 + i % 1000);
+            }
+        });
+    }
+    // Scrapes run alongside the writers
+    std::string text;
+    for (int i = 0; i < 20; i++) {
+        text.clear();
+        registry.render(text);
+    }
+    for (std::thread& th : pool) {
+        th.join();
+    }
+    const uint64_t total = static_cast<uint64_t>(threads) * samples;
+    expect(registry.counterValue(counter) == total, "concurrent counter adds all counted");
+    expect(registry.gaugeValue(gauge) == static_cast<double>(total), "concurrent gauge adds all counted");
+    expect(registry.histogramCount(histogram) == total, "concurrent histogram samples all counted");
+}
+
+/** CPU time of the calling thread: threads that share a core are not charged for each other. */
+double threadNs() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) * 1e9 + static_cast<double>(ts.tv_nsec);
+}
+
+void bench(unsigned samples) {
+    for (unsigned threads : {1u, 4u}) {
+        Registry registry;
+        const int32_t counter = registry.add(MetricType::Counter, "bench_total", "", "");
+        const int32_t histogram = registry.add(MetricType::Histogram, "bench_seconds", "", "");
+        std::vector<std::thread> pool;
+        std::vector<double> counterNs(threads, 0);
+        std::vector<double> histogramNs(threads, 0);
+        for (unsigned t = 0; t < threads; t++) {
+            pool.emplace_back([&, t] {
+                const double s0 = threadNs();
+                for (unsigned i = 0; i < samples; i++) {
+                    registry.counterAdd(counter, 1);
+                }
+                const double s1 = threadNs();
+                for (unsigned i = 0; i < samples; i++) {
+                    registry.histogramRecord(histogram, i & 0xffff);
+                }
+                counterNs[t] = s1 - s0;
+                histogramNs[t] = threadNs() - s1;
+            });
+        }
+        for (std::thread& th : pool) {
+            th.join();
+        }
+        double c = 0;
+        double h = 0;
+        for (unsigned t = 0; t < threads; t++) {
+            c += counterNs[t];
+            h += histogramNs[t];
+        }
+        const double n = static_cast<double>(threads) * samples;
+        printf("bench: %u thread(s): %.1f ns per counter add, %.1f ns per histogram sample\n", threads, c / n,
+               h / n);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    unsigned samples = 2000000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            samples = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+        } else {
+            fprintf(stderr, "usage: %s [--samples N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    checkBuckets();
+    checkValidation();
+    checkRegistration();
+    checkExposition();
+    checkQuantiles();
+    checkConcurrency(samples / 20);
+
+    if (g_failures > 0) {
+        fprintf(stderr, "metrics_check: %d of %d check(s) failed\n", g_failures, g_checks);
+        return 1;
+    }
+    bench(samples);
+    printf("metrics_check: all %d checks passed\n", g_checks);
+    return 0;
+}
@@ -0,0 +1,81 @@
+/**
+ * C ABI over PhiCrypto.h.
+ *
+ * Loaded from Python with ctypes (services/shared/phi_crypto.py), which
+ * seals PHI tokens and decision journal batches with it. A batch crosses
+ * the boundary as packed buffers rather than per-record structs, so the
+ * Python side builds it with a few joins:
+ *
+ *   keys        key table, PHI_KEY_BYTES each; key_index[i] picks job i's key
+ *   nonces      n * PHI_NONCE_BYTES
+ *   aad, in     concatenated; job i is [offsets[i], offsets[i + 1])
+ *               (aad may be null for no associated data)
+ *   out         seal: job i at in_offsets[i] + i * PHI_TAG_BYTES, plaintext
+ *               then tag; open: job i at in_offsets[i] - i * PHI_TAG_BYTES
+ *   status      one PHI_OK / PHI_AUTH_FAILED / PHI_ERROR per job
+ *
+ * Both calls return the number of failed jobs, or -1 if the batch is
+ * malformed.
+ */
+
+#include <new>
+#include <vector>
+
+#include "PhiCrypto.h"
+
+using namespace pulsemind::phicrypto;
+
+namespace {
+
+int64_t run(const uint8_t* keys, uint32_t key_count, const uint32_t* key_index, const uint8_t* nonces,
+            const uint8_t* aad, const uint64_t* aad_offsets, const uint8_t* in, const uint64_t* in_offsets,
+            uint64_t n, uint8_t* out, int32_t* status, uint32_t threads, bool encrypt) {
+    std::vector<GcmJob> jobs;
+    try {
+        jobs.resize(n);
+    } catch (const std::bad_alloc&) {
+        return -1;
+    }
+    for (uint64_t i = 0; i < n; i++) {
+        const uint64_t inLen = in_offsets[i + 1] - in_offsets[i];
+        if (key_index[i] >= key_count || in_offsets[i + 1] < in_offsets[i] || (!encrypt && inLen < PHI_TAG_BYTES)) {
+            return -1;
+        }
+        GcmJob& job = jobs[i];
+        job.key = keys + static_cast<size_t>(key_index[i]) * PHI_KEY_BYTES;
+        job.nonce = nonces + i * PHI_NONCE_BYTES;
+        job.aad = aad ? aad + aad_offsets[i] : nullptr;
+        job.aadLen = aad ? aad_offsets[i + 1] - aad_offsets[i] : 0;
+        job.in = in + in_offsets[i];
+        job.inLen = inLen;
+        job.out = out + (encrypt ? in_offsets[i] + i * PHI_TAG_BYTES : in_offsets[i] - i * PHI_TAG_BYTES);
+        job.status = PHI_ERROR;
+    }
+    const size_t failed = runBatch(jobs.data(), jobs.size(), encrypt, threads);
+    for (uint64_t i = 0; i < n; i++) {
+        status[i] = jobs[i].status;
+    }
+    return static_cast<int64_t>(failed);
+}
+
+}  // namespace
+
+extern "C" {
+
+uint32_t pm_phi_abi_version(void) { return 1; }
+
+/** Encrypt n records (see the layout above); threads 0 for one per core. */
+int64_t pm_phi_seal(const uint8_t* keys, uint32_t key_count, const uint32_t* key_index, const uint8_t* nonces,
+                    const uint8_t* aad, const uint64_t* aad_offsets, const uint8_t* in, const uint64_t* in_offsets,
+                    uint64_t n, uint8_t* out, int32_t* status, uint32_t threads) {
+    return run(keys, key_count, key_index, nonces, aad, aad_offsets, in, in_offsets, n, out, status, threads, true);
+}
+
+/** Decrypt and authenticate n records (ciphertext plus tag each). */
+int64_t pm_phi_open(const uint8_t* keys, uint32_t key_count, const uint32_t* key_index, const uint8_t* nonces,
+                    const uint8_t* aad, const uint64_t* aad_offsets, const uint8_t* in, const uint64_t* in_offsets,
+                    uint64_t n, uint8_t* out, int32_t* status, uint32_t threads) {
+    return run(keys, key_count, key_index, nonces, aad, aad_offsets, in, in_offsets, n, out, status, threads, false);
+}
+
+}  // extern "C"
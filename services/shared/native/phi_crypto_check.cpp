@@ -0,0 +1,265 @@
+/**
+ * Self-checks and cost measurement for batched AES-256-GCM (PhiCrypto.h).
+ *
+ * Checks the AES-256 test cases of the GCM specification (McGrew and Viega,
+ * cases 13 to 16), that any change to ciphertext, tag, associated data or
+ * key fails authentication, and that batches (mixed keys, uneven sizes,
+ * several threads) agree with record-at-a-time sealing. Then it times small
+ * records on one thread and journal-sized batches on one and on all cores.
+ *
+ * Usage:
+ *   phi_crypto_check
+ *
+ * Exit status is 0 when every check passed, 1 otherwise.
+ */
+
+#include "PhiCrypto.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace pulsemind::phicrypto;
+
+namespace {
+
+int g_failures = 0;
+int g_checks = 0;
+
+void expect(bool ok, const char* what) {
+    g_checks++;
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s\n", what);
+        g_failures++;
+    }
+}
+
+std::vector<uint8_t> hex(const char* s) {
+    std::vector<uint8_t> out;
+    for (size_t i = 0; s[i] && s[i + 1]; i += 2) {
+        out.push_back(static_cast<uint8_t>(std::stoi(std::string(s + i, 2), nullptr, 16)));
+    }
+    return out;
+}
+
+struct Vector {
+    const char* name;
+    const char* key;
+    const char* nonce;
+    const char* plaintext;
+    const char* aad;
+    const char* ciphertext;
+    const char* tag;
+};
+
+const char* K15 = "feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308";
+const char* P15 =
+    "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525"
+    "b16aedf5aa0de657ba637b391aafd255";
+const char* C15 =
+    "522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa8cb08e48590dbb3da7b08b1056828838"
+    "c5f61e6393ba7a0abcc9f662898015ad";
+
+const Vector VECTORS[] = {
+    {"gcm case 13", "0000000000000000000000000000000000000000000000000000000000000000", "000000000000000000000000",
+     "", "", "", "530f8afbc74536b9a963b4f1c4cb738b"},
+    {"gcm case 14", "0000000000000000000000000000000000000000000000000000000000000000", "000000000000000000000000",
+     "00000000000000000000000000000000", "", "cea7403d4d606b6e074ec5d3baf39d18", "d0d1c8a799996bf0265b98b5d48ab919"},
+    {"gcm case 15", K15, "cafebabefacedbaddecaf888", P15, "", C15, "b094dac5d93471bdec1a502270e3cc6c"},
+};
+
+void checkVectors() {
+    GcmContext ctx;
+    expect(ctx.valid(), "cipher context");
+    auto run = [&](const char* name, const std::vector<uint8_t>& key, const std::vector<uint8_t>& nonce,
+                   const std::vector<uint8_t>& plaintext, const std::vector<uint8_t>& aad,
+                   const std::vector<uint8_t>& ciphertext, const std::vector<uint8_t>& tag) {
+        std::vector<uint8_t> sealed(plaintext.size() + PHI_TAG_BYTES);
+        std::vector<uint8_t> expected = ciphertext;
+        expected.insert(expected.end(), tag.begin(), tag.end());
+        const std::string what = std::string(name) + ": ";
+        expect(ctx.seal(key.data(), nonce.data(), aad.data(), aad.size(), plaintext.data(), plaintext.size(),
+                        sealed.data()) == PHI_OK,
+               (what + "seal").c_str());
+        expect(sealed == expected, (what + "ciphertext and tag").c_str());
+
+        std::vector<uint8_t> opened(plaintext.size() + 1);
+        expect(ctx.open(key.data(), nonce.data(), aad.data(), aad.size(), sealed.data(), sealed.size(),
+                        opened.data()) == PHI_OK,
+               (what + "open").c_str());
+        expect(std::equal(plaintext.begin(), plaintext.end(), opened.begin()), (what + "round trip").c_str());
+    };
+    for (const Vector& v : VECTORS) {
+        run(v.name, hex(v.key), hex(v.nonce), hex(v.plaintext), hex(v.aad), hex(v.ciphertext), hex(v.tag));
+    }
+    // Case 16: case 15 with associated data and a 60-byte plaintext
+    std::vector<uint8_t> p16 = hex(P15);
+    p16.resize(60);
+    std::vector<uint8_t> c16 = hex(C15);
+    c16.resize(60);
+    run("gcm case 16", hex(K15), hex("cafebabefacedbaddecaf888"), p16, hex("feedfacedeadbeeffeedfacedeadbeefabaddad2"),
+        c16, hex("76fc6ece0f4e1768cddf8853bb2d551b"));
+}
+
+void checkTampering() {
+    GcmContext ctx;
+    std::vector<uint8_t> key(PHI_KEY_BYTES, 7);
+    std::vector<uint8_t> nonce(PHI_NONCE_BYTES, 9);
+    const std::string aad = "segment 3";
+    const std::string text = "{\"patient_id\": \"p-17\", \"hsi_score\": 71.5}";
+    std::vector<uint8_t> sealed(text.size() + PHI_TAG_BYTES);
+    ctx.seal(key.data(), nonce.data(), reinterpret_cast<const uint8_t*>(aad.data()), aad.size(),
+             reinterpret_cast<const uint8_t*>(text.data()), text.size(), sealed.data());
+    std::vector<uint8_t> out(text.size());
+
+    auto open = [&](const std::vector<uint8_t>& k, const std::string& a, const std::vector<uint8_t>& s) {
+        return ctx.open(k.data(), nonce.data(), reinterpret_cast<const uint8_t*>(a.data()), a.size(), s.data(),
+                        s.size(), out.data());
+    };
+    expect(open(key, aad, sealed) == PHI_OK, "intact record opens");
+    expect(memcmp(out.data(), text.data(), text.size()) == 0, "intact record round trip");
+
+    bool allRejected = true;
+    for (size_t i = 0; i < sealed.size(); i++) {
+        std::vector<uint8_t> flipped = sealed;
+        flipped[i] ^= 0x01;
+        allRejected &= open(key, aad, flipped) == PHI_AUTH_FAILED;
+    }
+    expect(allRejected, "every flipped ciphertext or tag bit is rejected");
+    expect(open(key, "segment 4", sealed) == PHI_AUTH_FAILED, "other associated data rejected");
+    std::vector<uint8_t> otherKey = key;
+    otherKey[31] ^= 0x80;
+    expect(open(otherKey, aad, sealed) == PHI_AUTH_FAILED, "other key rejected");
+    std::vector<uint8_t> shortInput(PHI_TAG_BYTES - 1);
+    expect(open(key, aad, shortInput) == PHI_ERROR, "input shorter than a tag is an error");
+}
+
+struct Batch {
+    std::vector<std::vector<uint8_t>> keys;
+    std::vector<std::vector<uint8_t>> nonces;
+    std::vector<std::vector<uint8_t>> plaintexts;
+    std::vector<std::vector<uint8_t>> sealed;
+    std::vector<std::vector<uint8_t>> opened;
+    std::vector<GcmJob> jobs;
+
+    Batch(size_t n, size_t minLen, size_t maxLen, size_t keyCount, std::mt19937_64& rng) {
+        std::uniform_int_distribution<size_t> length(minLen, maxLen);
+        for (size_t k = 0; k < keyCount; k++) {
+            keys.emplace_back(PHI_KEY_BYTES);
+            for (uint8_t& b : keys.back()) {
+                b = static_cast<uint8_t>(rng());
+            }
+        }
+        for (size_t i = 0; i < n; i++) {
+            nonces.emplace_back(PHI_NONCE_BYTES);
+            memcpy(nonces.back().data(), &i, sizeof(i));
+            plaintexts.emplace_back(length(rng));
+            for (uint8_t& b : plaintexts.back()) {
+                b = static_cast<uint8_t>(rng());
+            }
+            sealed.emplace_back(plaintexts.back().size() + PHI_TAG_BYTES);
+            opened.emplace_back(plaintexts.back().size());
+        }
+    }
+
+    const uint8_t* keyFor(size_t i) const { return keys[i % keys.size()].data(); }
+
+    size_t seal(unsigned threads) {
+        jobs.clear();
+        for (size_t i = 0; i < plaintexts.size(); i++) {
+            jobs.push_back({keyFor(i), nonces[i].data(), nullptr, 0, plaintexts[i].data(), plaintexts[i].size(),
+                            sealed[i].data(), -1});
+        }
+        return runBatch(jobs.data(), jobs.size(), true, threads);
+    }
+
+    size_t open(unsigned threads) {
+        jobs.clear();
+        for (size_t i = 0; i < sealed.size(); i++) {
+            jobs.push_back({keyFor(i), nonces[i].data(), nullptr, 0, sealed[i].data(), sealed[i].size(),
+                            opened[i].data(), -1});
+        }
+        return runBatch(jobs.data(), jobs.size(), false, threads);
+    }
+};
+
+void checkBatches() {
+    std::mt19937_64 rng(72);
+    expect(batchThreads(1000, 100, 8) == 1, "small batches stay on the calling thread");
+    expect(batchThreads(3, 1 << 30, 8) == 3, "no more threads than jobs");
+    expect(batchThreads(1000, 4 * PHI_BYTES_PER_THREAD, 8) == 5, "threads scale with bytes");
+
+    Batch batch(500, 0, 40000, 3, rng);
+    expect(batch.seal(4) == 0, "batch seals");
+    GcmContext ctx;
+    bool matches = true;
+    for (size_t i = 0; i < batch.plaintexts.size(); i++) {
+        std::vector<uint8_t> single(batch.plaintexts[i].size() + PHI_TAG_BYTES);
+        ctx.seal(batch.keyFor(i), batch.nonces[i].data(), nullptr, 0, batch.plaintexts[i].data(),
+                 batch.plaintexts[i].size(), single.data());
+        matches &= single == batch.sealed[i];
+    }
+    expect(matches, "threaded batch equals record-at-a-time sealing");
+    expect(batch.open(4) == 0, "batch opens");
+    expect(batch.opened == batch.plaintexts, "batch round trip");
+
+    batch.sealed[123][0] ^= 0x40;
+    batch.sealed[321].back() ^= 0x01;
+    expect(batch.open(4) == 2, "two tampered records fail");
+    expect(batch.jobs[123].status == PHI_AUTH_FAILED && batch.jobs[321].status == PHI_AUTH_FAILED,
+           "tampered records are the ones reported");
+    expect(batch.jobs[122].status == PHI_OK && batch.opened[122] == batch.plaintexts[122],
+           "other records still open");
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void bench() {
+    std::mt19937_64 rng(1);
+    Batch small(20000, 256, 256, 1, rng);
+    auto start = std::chrono::steady_clock::now();
+    small.seal(1);
+    const double sealSeconds = secondsSince(start);
+    start = std::chrono::steady_clock::now();
+    small.open(1);
+    const double openSeconds = secondsSince(start);
+    printf("bench: 256-byte records: %.0f ns seal, %.0f ns open\n", sealSeconds / 20000 * 1e9,
+           openSeconds / 20000 * 1e9);
+
+    Batch large(256, 256 * 1024, 256 * 1024, 3, rng);
+    large.seal(0);
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned threads : {1u, cores}) {
+        start = std::chrono::steady_clock::now();
+        large.open(threads);
+        const double seconds = secondsSince(start);
+        printf("bench: 64 MB of 256 KB batches, %u thread(s): %.2f GB/s open\n", threads,
+               256.0 * 256 * 1024 / seconds / 1e9);
+        if (cores == 1) {
+            break;
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    checkVectors();
+    checkTampering();
+    checkBatches();
+    if (g_failures == 0) {
+        bench();
+    }
+    if (g_failures) {
+        fprintf(stderr, "phi_crypto_check: %d of %d checks failed\n", g_failures, g_checks);
+        return 1;
+    }
+    printf("phi_crypto_check: all %d checks passed\n", g_checks);
+    return 0;
+}
@@ -0,0 +1,62 @@
+/**
+ * C ABI over PpgPipeline.h for the pipeline-service.
+ *
+ * Loaded from Python with ctypes (services/pipeline-service/fused_pipeline.py).
+ * The forest is built once from the loaded scikit-learn model and the filter
+ * coefficients are designed by signal_processor (scipy); windows are
+ * then processed with a per-thread workspace, so ctypes calls from concurrent
+ * request threads (the GIL is released) never share buffers.
+ */
+
+#include <new>
+
+#include "PpgPipeline.h"
+
+using namespace pulsemind;
+
+static_assert(sizeof(PipelineResult) == 152, "PipelineResult layout is part of the C ABI");
+
+extern "C" {
+
+uint32_t pm_pipeline_abi_version(void) { return 1; }
+
+uint32_t pm_pipeline_result_size(void) { return sizeof(PipelineResult); }
+
+RandomForest* pm_forest_create(uint32_t num_classes) {
+    if (num_classes == 0 || num_classes > MAX_FOREST_CLASSES) {
+        return nullptr;
+    }
+    return new (std::nothrow) RandomForest(num_classes);
+}
+
+/**
+ * Append one tree; returns 0, or -1 if the node arrays are inconsistent
+ * (child out of range, child not after its parent, unknown feature).
+ */
+int32_t pm_forest_add_tree(RandomForest* forest, uint64_t node_count, const int64_t* feature,
+                           const double* threshold, const int64_t* left, const int64_t* right,
+                           const double* value) {
+    if (!validTreeLayout(node_count, feature, left, right)) {
+        return -1;
+    }
+    try {
+        forest->addTree(node_count, feature, threshold, left, right, value);
+    } catch (const std::bad_alloc&) {
+        return -1;
+    }
+    return 0;
+}
+
+void pm_forest_destroy(RandomForest* forest) { delete forest; }
+
+void pm_forest_predict_proba(const RandomForest* forest, const double* features, double* proba) {
+    forest->predictProba(features, proba);
+}
+
+int32_t pm_pipeline_run(const RandomForest* forest, const double* b, const double* a, uint32_t taps,
+                        const double* signal, uint64_t n, double sampling_rate, PipelineResult* out) {
+    static thread_local PipelineWorkspace workspace;
+    return static_cast<int32_t>(runPipeline(*forest, b, a, taps, signal, n, sampling_rate, workspace, *out));
+}
+
+}  // extern "C"
@@ -0,0 +1,385 @@
+/**
+ * State-space explorer for the shared safety policy (SafetyPolicy.h).
+ *
+ * Drives the C++ controller through
+ *   - every combination of a discretized input space (rhythm x confidence
+ *     band x HSI band x HR band x trend) from every controller state
+ *     (safety state x upgrade counter x previous rate), and
+ *   - multithreaded random walks from power-on state with inputs biased
+ *     toward threshold boundaries,
+ * and checks safety invariants after every single transition.
+ *
+ * Usage:
+ *   safety_explorer [--mode exhaustive|fuzz|all] [--steps N] [--walk-length N]
+ *                   [--threads N] [--seed N]
+ *
+ * Exit status is 0 when no invariant was violated, 1 otherwise.
+ */
+
+#include "SafetyPolicy.h"
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace pulsemind;
+
+namespace {
+
+// ==========================================
+// Invariants
+// ==========================================
+enum Invariant : uint8_t {
+    RateWithinBounds = 0,      // ABSOLUTE_MIN_PACING_RATE <= rate <= ABSOLUTE_MAX_PACING_RATE
+    AmplitudeWithinBounds,     // 0 when monitoring, else within absolute amplitude bounds
+    RateSlewLimited,           // |rate - last rate| <= per-cycle limit outside EMERGENCY/MONITOR_ONLY
+    EmergencyConditionsApply,  // out-of-range HR or HSI < HSI_EMERGENCY -> EMERGENCY now
+    UnreliableInputNotTrusted, // artifact or low confidence -> SAFE_MODE or worse
+    UpgradeRequiresHysteresis, // no upgrade without UPGRADE_REQUIRED_CYCLES proposals
+    UpgradeIsSingleStep,       // upgrades move only to the proposed state
+    EmergencyModeMatchesState, // EMERGENCY pacing iff EMERGENCY state
+    CounterBounded,            // consecutiveSafeCycles < UPGRADE_REQUIRED_CYCLES
+    INVARIANT_COUNT
+};
+
+const char* const INVARIANT_NAMES[INVARIANT_COUNT] = {
+    "rate_within_bounds",
+    "amplitude_within_bounds",
+    "rate_slew_limited",
+    "emergency_conditions_apply",
+    "unreliable_input_not_trusted",
+    "upgrade_requires_hysteresis",
+    "upgrade_is_single_step",
+    "emergency_mode_matches_state",
+    "counter_bounded",
+};
+
+struct Input {
+    Rhythm rhythm;
+    double confidence;
+    double hsi;
+    Trend trend;
+    double heartRate;
+};
+
+struct Stats {
+    uint64_t transitions = 0;
+    uint64_t stateTransitions[5][5] = {};  // [from][to], index 0 unused
+    uint64_t violations[INVARIANT_COUNT] = {};
+
+    void merge(const Stats& other) {
+        transitions += other.transitions;
+        for (int i = 0; i < 5; i++) {
+            for (int j = 0; j < 5; j++) stateTransitions[i][j] += other.stateTransitions[i][j];
+        }
+        for (int i = 0; i < INVARIANT_COUNT; i++) violations[i] += other.violations[i];
+    }
+
+    uint64_t totalViolations() const {
+        uint64_t total = 0;
+        for (uint64_t v : violations) total += v;
+        return total;
+    }
+};
+
+std::mutex reportMutex;
+std::atomic<uint32_t> examplesReported{0};
+constexpr uint32_t MAX_EXAMPLES = 10;
+
+void reportViolation(Invariant invariant, const PolicyState& before, const Input& in, const PacingCommand& cmd) {
+    if (examplesReported.fetch_add(1) >= MAX_EXAMPLES) return;
+    std::lock_guard<std::mutex> lock(reportMutex);
+    fprintf(stderr,
+            "VIOLATION %s: state=%s safe_cycles=%" PRIu32 " last_rate=%s%.3f | rhythm=%u conf=%.6f hsi=%.6f "
+            "trend=%u hr=%.6f -> state=%s mode=%s rate=%.6f amp=%.6f\n",
+            INVARIANT_NAMES[invariant], safetyStateName(static_cast<SafetyState>(before.currentState)),
+            before.consecutiveSafeCycles, before.hasLastRate ? "" : "(none)", before.lastPacingRate,
+            static_cast<unsigned>(in.rhythm), in.confidence, in.hsi, static_cast<unsigned>(in.trend),
+            in.heartRate, safetyStateName(cmd.state), pacingModeName(cmd.mode), cmd.targetRateBpm,
+            cmd.amplitudeMa);
+}
+
+/**
+ * Run one transition and check every invariant against the pre-state.
+ * Inputs are sanitized first, exactly like process_pacing_decision.
+ */
+inline void step(PolicyState& s, Input in, Stats& stats) {
+    sanitizeInputs(in.confidence, in.hsi, in.heartRate);
+    const PolicyState before = s;
+    const PacingCommand cmd = computePacingCommand(s, in.rhythm, in.confidence, in.hsi, in.trend, in.heartRate);
+
+    stats.transitions++;
+    stats.stateTransitions[before.currentState][s.currentState]++;
+
+    const auto fail = [&](Invariant invariant) {
+        stats.violations[invariant]++;
+        reportViolation(invariant, before, in, cmd);
+    };
+
+    const double rate = cmd.targetRateBpm;
+    if (!(rate >= ABSOLUTE_MIN_PACING_RATE && rate <= ABSOLUTE_MAX_PACING_RATE)) fail(RateWithinBounds);
+
+    const double amp = cmd.amplitudeMa;
+    if (cmd.mode == PacingMode::MonitorOnly ? amp != 0.0
+                                            : !(amp >= ABSOLUTE_MIN_PACING_AMPLITUDE &&
+                                                amp <= ABSOLUTE_MAX_PACING_AMPLITUDE)) {
+        fail(AmplitudeWithinBounds);
+    }
+
+    if (before.hasLastRate && cmd.mode != PacingMode::Emergency && cmd.mode != PacingMode::MonitorOnly) {
+        if (rate > before.lastPacingRate + MAX_RATE_INCREASE_PER_CYCLE ||
+            rate < before.lastPacingRate - MAX_RATE_DECREASE_PER_CYCLE) {
+            fail(RateSlewLimited);
+        }
+    }
+
+    const bool emergencyInput = in.heartRate < ABSOLUTE_MIN_PACING_RATE ||
+                                in.heartRate > ABSOLUTE_MAX_PACING_RATE || in.hsi < HSI_EMERGENCY;
+    if (emergencyInput && cmd.state != SafetyState::Emergency) fail(EmergencyConditionsApply);
+
+    const bool unreliable = in.rhythm == Rhythm::Artifact || in.confidence < CONFIDENCE_THRESHOLD_MEDIUM;
+    if (unreliable && cmd.state != SafetyState::SafeMode && cmd.state != SafetyState::Emergency) {
+        fail(UnreliableInputNotTrusted);
+    }
+
+    if (s.currentState < before.currentState) {
+        if (before.consecutiveSafeCycles + 1 < UPGRADE_REQUIRED_CYCLES) fail(UpgradeRequiresHysteresis);
+        // Recompute the proposal on a scratch copy (evaluateState bumps counters)
+        PolicyState scratch = before;
+        const SafetyState proposed = evaluateState(scratch, in.rhythm, in.confidence, in.hsi, in.heartRate);
+        if (s.currentState != static_cast<uint8_t>(proposed)) fail(UpgradeIsSingleStep);
+    }
+
+    if ((cmd.mode == PacingMode::Emergency) != (cmd.state == SafetyState::Emergency)) {
+        fail(EmergencyModeMatchesState);
+    }
+
+    if (s.consecutiveSafeCycles >= UPGRADE_REQUIRED_CYCLES) fail(CounterBounded);
+}
+
+// ==========================================
+// Discretized Input Space
+// ==========================================
+// Values on, just below and just above every threshold, plus values outside
+// the sanitized range and NaN.
+const double EPS = 1e-9;
+
+const double CONFIDENCE_POINTS[] = {
+    NAN, -0.5, 0.0, CONFIDENCE_THRESHOLD_MEDIUM - EPS, CONFIDENCE_THRESHOLD_MEDIUM,
+    0.7, CONFIDENCE_THRESHOLD_HIGH - EPS, CONFIDENCE_THRESHOLD_HIGH, 0.95, 1.0, 1.5,
+};
+
+const double HSI_POINTS[] = {
+    NAN, -5.0, 0.0, HSI_EMERGENCY - EPS, HSI_EMERGENCY, 20.0, HSI_CRITICAL_LOW - EPS, HSI_CRITICAL_LOW,
+    40.0, HSI_LOW - EPS, HSI_LOW, 60.0, HSI_GOOD - EPS, HSI_GOOD, 85.0, 100.0, 150.0,
+};
+
+const double HEART_RATE_POINTS[] = {
+    NAN, 0.0, INPUT_MIN_HEART_RATE, ABSOLUTE_MIN_PACING_RATE - EPS, ABSOLUTE_MIN_PACING_RATE, 48.0,
+    60.0, 65.0, 70.0, 80.0, 100.0, 100.0 + EPS, 135.0, ABSOLUTE_MAX_PACING_RATE - EPS,
+    ABSOLUTE_MAX_PACING_RATE, ABSOLUTE_MAX_PACING_RATE + EPS, INPUT_MAX_HEART_RATE, 400.0,
+};
+
+// Previous pacing rates seeded into the controller state (first = none)
+const double LAST_RATE_POINTS[] = {
+    -1.0, ABSOLUTE_MIN_PACING_RATE, 55.0, 70.0, 95.0, 130.0, ABSOLUTE_MAX_PACING_RATE,
+};
+
+template <typename T, size_t N>
+constexpr size_t countOf(const T (&)[N]) { return N; }
+
+/**
+ * One step from every (controller state x input) combination.
+ * Work is split across threads by starting safety state and rhythm.
+ */
+Stats exploreExhaustive(unsigned threads) {
+    const size_t jobs = 4 * RHYTHM_COUNT;
+    std::atomic<size_t> nextJob{0};
+    std::vector<Stats> results(threads);
+    std::vector<std::thread> pool;
+
+    for (unsigned t = 0; t < threads; t++) {
+        pool.emplace_back([&, t] {
+            Stats& stats = results[t];
+            for (size_t job; (job = nextJob.fetch_add(1)) < jobs;) {
+                const uint8_t startState = static_cast<uint8_t>(job / RHYTHM_COUNT + 1);
+                const Rhythm rhythm = static_cast<Rhythm>(job % RHYTHM_COUNT);
+                for (uint32_t cycles = 0; cycles < UPGRADE_REQUIRED_CYCLES; cycles++) {
+                    for (double lastRate : LAST_RATE_POINTS) {
+                        PolicyState base;
+                        initPolicyState(base);
+                        base.currentState = startState;
+                        base.consecutiveSafeCycles = cycles;
+                        base.hasLastRate = lastRate >= 0.0;
+                        base.lastPacingRate = base.hasLastRate ? lastRate : 0.0;
+                        for (double conf : CONFIDENCE_POINTS) {
+                            for (double hsi : HSI_POINTS) {
+                                for (uint8_t trend = 0; trend < 3; trend++) {
+                                    for (double hr : HEART_RATE_POINTS) {
+                                        PolicyState s = base;
+                                        step(s, Input{rhythm, conf, hsi, static_cast<Trend>(trend), hr}, stats);
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        });
+    }
+    for (auto& th : pool) th.join();
+
+    Stats total;
+    for (const auto& r : results) total.merge(r);
+    return total;
+}
+
+// ==========================================
+// Random Walks
+// ==========================================
+struct SplitMix64 {
+    uint64_t x;
+    uint64_t next() {
+        uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+    double uniform(double lo, double hi) { return lo + (hi - lo) * ((next() >> 11) * 0x1.0p-53); }
+    template <typename T, size_t N>
+    T pick(const T (&values)[N]) { return values[next() % N]; }
+};
+
+// Half of the draws come from the boundary tables, half are continuous
+inline double draw(SplitMix64& rng, const double* points, size_t count, double lo, double hi) {
+    const uint64_t r = rng.next();
+    if (r & 1) return points[(r >> 1) % count];
+    return rng.uniform(lo, hi);
+}
+
+Stats exploreRandom(uint64_t steps, uint32_t walkLength, unsigned threads, uint64_t seed) {
+    std::vector<Stats> results(threads);
+    std::vector<std::thread> pool;
+
+    for (unsigned t = 0; t < threads; t++) {
+        pool.emplace_back([&, t] {
+            SplitMix64 rng{seed ^ (0xD1B54A32D192ED03ull * (t + 1))};
+            Stats& stats = results[t];
+            const uint64_t quota = steps / threads + (t < steps % threads ? 1 : 0);
+            PolicyState s;
+            initPolicyState(s);
+            for (uint64_t i = 0; i < quota; i++) {
+                if (i % walkLength == 0) initPolicyState(s);
+                const Input in{
+                    static_cast<Rhythm>(rng.next() % RHYTHM_COUNT),
+                    draw(rng, CONFIDENCE_POINTS, countOf(CONFIDENCE_POINTS), -0.1, 1.1),
+                    draw(rng, HSI_POINTS, countOf(HSI_POINTS), -10.0, 110.0),
+                    static_cast<Trend>(rng.next() % 3),
+                    draw(rng, HEART_RATE_POINTS, countOf(HEART_RATE_POINTS), 20.0, 260.0),
+                };
+                step(s, in, stats);
+            }
+        });
+    }
+    for (auto& th : pool) th.join();
+
+    Stats total;
+    for (const auto& r : results) total.merge(r);
+    return total;
+}
+
+// ==========================================
+// Reporting
+// ==========================================
+void printStats(const char* label, const Stats& stats, double seconds) {
+    printf("%s: %" PRIu64 " transitions in %.2f s (%.1f M/s)\n", label, stats.transitions, seconds,
+           seconds > 0 ? stats.transitions / seconds / 1e6 : 0.0);
+    printf("  state transitions (from -> to):\n");
+    for (int from = 1; from <= 4; from++) {
+        for (int to = 1; to <= 4; to++) {
+            if (stats.stateTransitions[from][to] == 0) continue;
+            printf("    %-9s -> %-9s %" PRIu64 "\n", safetyStateName(static_cast<SafetyState>(from)),
+                   safetyStateName(static_cast<SafetyState>(to)), stats.stateTransitions[from][to]);
+        }
+    }
+    printf("  invariant violations:\n");
+    for (int i = 0; i < INVARIANT_COUNT; i++) {
+        printf("    %-30s %" PRIu64 "\n", INVARIANT_NAMES[i], stats.violations[i]);
+    }
+}
+
+template <typename Fn>
+Stats timed(const char* label, Fn fn) {
+    const auto start = std::chrono::steady_clock::now();
+    Stats stats = fn();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printStats(label, stats, seconds);
+    return stats;
+}
+
+void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [--mode exhaustive|fuzz|all] [--steps N] [--walk-length N] "
+            "[--threads N] [--seed N]\n",
+            argv0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const char* mode = "all";
+    uint64_t steps = 100000000ull;
+    uint32_t walkLength = 1000;
+    unsigned threads = std::thread::hardware_concurrency();
+    uint64_t seed = 0x5EED;
+
+    for (int i = 1; i < argc; i++) {
+        const bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--mode") == 0 && hasValue) {
+            mode = argv[++i];
+        } else if (strcmp(argv[i], "--steps") == 0 && hasValue) {
+            steps = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--walk-length") == 0 && hasValue) {
+            walkLength = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+            threads = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--seed") == 0 && hasValue) {
+            seed = strtoull(argv[++i], nullptr, 0);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (threads == 0) threads = 1;
+    if (walkLength == 0) walkLength = 1;
+
+    const bool runExhaustive = strcmp(mode, "exhaustive") == 0 || strcmp(mode, "all") == 0;
+    const bool runFuzz = strcmp(mode, "fuzz") == 0 || strcmp(mode, "all") == 0;
+    if (!runExhaustive && !runFuzz) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    uint64_t violations = 0;
+    if (runExhaustive) {
+        violations += timed("exhaustive", [&] { return exploreExhaustive(threads); }).totalViolations();
+    }
+    if (runFuzz) {
+        violations += timed("fuzz", [&] { return exploreRandom(steps, walkLength, threads, seed); })
+                          .totalViolations();
+    }
+
+    if (violations != 0) {
+        printf("FAILED: %" PRIu64 " invariant violations\n", violations);
+        return 1;
+    }
+    printf("OK: no invariant violations\n");
+    return 0;
+}
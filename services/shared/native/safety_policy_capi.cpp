@@ -0,0 +1,96 @@
+/**
+ * C ABI over SafetyPolicy.h for the control-engine native backend.
+ *
+ * Loaded from Python with ctypes (services/control-engine/native_policy.py).
+ * Rhythm, trend, state and mode are passed as their integer enum values.
+ */
+
+#include "SafetyPolicy.h"
+
+using namespace pulsemind;
+
+static_assert(sizeof(PolicyState) == 40, "PolicyState layout is part of the C ABI");
+static_assert(sizeof(ShaperState) == 48, "ShaperState layout is part of the C ABI");
+
+extern "C" {
+
+struct pm_command {
+    uint8_t pacing_enabled;
+    uint8_t pacing_mode;
+    uint8_t safety_state;
+    uint8_t rate_within_bounds;
+    uint8_t amplitude_within_bounds;
+    uint8_t confidence_acceptable;
+    uint8_t hsi_acceptable;
+    uint8_t reserved;
+    double target_rate_bpm;
+    double pacing_amplitude_ma;
+};
+
+struct pm_shaped_command {
+    uint8_t pacing_enabled;
+    uint8_t publish;
+    uint8_t reserved[6];
+    double rate_bpm;
+};
+
+uint32_t pm_abi_version(void) { return 2; }
+
+uint32_t pm_policy_state_size(void) { return sizeof(PolicyState); }
+
+void pm_policy_init(PolicyState* state) { initPolicyState(*state); }
+
+uint8_t pm_evaluate_state(PolicyState* state, uint8_t rhythm, double confidence, double hsi, double heart_rate) {
+    return static_cast<uint8_t>(evaluateState(*state, static_cast<Rhythm>(rhythm), confidence, hsi, heart_rate));
+}
+
+void pm_update_state(PolicyState* state, uint8_t proposed) {
+    updateState(*state, static_cast<SafetyState>(proposed));
+}
+
+uint8_t pm_determine_pacing_mode(uint8_t rhythm, double hsi, uint8_t trend, uint8_t safety_state) {
+    return static_cast<uint8_t>(determinePacingMode(static_cast<Rhythm>(rhythm), hsi, static_cast<Trend>(trend),
+                                                    static_cast<SafetyState>(safety_state)));
+}
+
+double pm_compute_target_rate(const PolicyState* state, double current_hr, uint8_t rhythm, double hsi,
+                              uint8_t pacing_mode) {
+    return computeTargetRate(*state, current_hr, static_cast<Rhythm>(rhythm), hsi,
+                             static_cast<PacingMode>(pacing_mode));
+}
+
+double pm_compute_pacing_amplitude(uint8_t pacing_mode, double hsi) {
+    return computePacingAmplitude(static_cast<PacingMode>(pacing_mode), hsi);
+}
+
+void pm_compute_pacing_command(PolicyState* state, uint8_t rhythm, double confidence, double hsi, uint8_t trend,
+                               double heart_rate, pm_command* out) {
+    const PacingCommand cmd = computePacingCommand(*state, static_cast<Rhythm>(rhythm), confidence, hsi,
+                                                   static_cast<Trend>(trend), heart_rate);
+    out->pacing_enabled = cmd.pacingEnabled;
+    out->pacing_mode = static_cast<uint8_t>(cmd.mode);
+    out->safety_state = static_cast<uint8_t>(cmd.state);
+    out->rate_within_bounds = cmd.rateWithinBounds;
+    out->amplitude_within_bounds = cmd.amplitudeWithinBounds;
+    out->confidence_acceptable = cmd.confidenceAcceptable;
+    out->hsi_acceptable = cmd.hsiAcceptable;
+    out->reserved = 0;
+    out->target_rate_bpm = cmd.targetRateBpm;
+    out->pacing_amplitude_ma = cmd.amplitudeMa;
+}
+
+uint32_t pm_shaper_state_size(void) { return sizeof(ShaperState); }
+
+void pm_shaper_init(ShaperState* state) { initShaperState(*state); }
+
+void pm_shape_command(ShaperState* state, uint8_t enabled, double target_rate, uint8_t immediate, uint64_t now_ms,
+                      pm_shaped_command* out) {
+    const ShapedCommand cmd = shapeCommand(*state, DEFAULT_SHAPER_CONFIG, enabled != 0, target_rate, immediate != 0,
+                                           now_ms);
+    out->pacing_enabled = cmd.pacingEnabled;
+    out->publish = cmd.publish;
+    memset(out->reserved, 0, sizeof(out->reserved));
+    out->rate_bpm = cmd.rateBpm;
+}
+
+}  // extern "C"
@@ -0,0 +1,68 @@
+/**
+ * C ABI over TraceRing.h.
+ *
+ * Loaded from Python with ctypes (services/shared/tracing.py): each service
+ * process records its spans into one ring, and its exporter thread drains
+ * them as OTLP/JSON documents to a file or a collector.
+ */
+
+#include <new>
+
+#include "TraceRing.h"
+
+using namespace pulsemind::trace;
+
+namespace {
+
+/** A ring and the document drained from it but not yet taken. */
+struct TraceHandle {
+    explicit TraceHandle(uint32_t capacity) : ring(capacity) {}
+    SpanRing ring;
+    std::string pending;
+};
+
+}  // namespace
+
+extern "C" {
+
+uint32_t pm_trace_abi_version(void) { return 1; }
+
+TraceHandle* pm_trace_open(uint32_t capacity) {
+    return new (std::nothrow) TraceHandle(capacity ? capacity : DEFAULT_SPAN_CAPACITY);
+}
+
+/**
+ * Queue one finished span (trace_id is 16 bytes, text is UTF-8 with
+ * explicit lengths); 0 if the ring was full and the span dropped.
+ */
+int32_t pm_trace_record(TraceHandle* handle, const uint8_t* trace_id, uint64_t span_id, uint64_t parent_id,
+                        int64_t start_us, int64_t duration_us, uint8_t kind, uint8_t status, const char* service,
+                        uint64_t service_len, const char* name, uint64_t name_len, const char* attrs,
+                        uint64_t attrs_len) {
+    return handle->ring.record(trace_id, span_id, parent_id, start_us, duration_us, kind, status, service,
+                               service_len, name, name_len, attrs, attrs_len);
+}
+
+/**
+ * Drain up to max_spans spans as one OTLP/JSON document into out. Returns
+ * its length, 0 when nothing was queued, or minus the length needed when
+ * out is too small (the document is kept for the next call).
+ */
+int64_t pm_trace_drain(TraceHandle* handle, uint64_t max_spans, char* out, uint64_t capacity) {
+    if (handle->pending.empty() && handle->ring.drain(handle->pending, max_spans) == 0) {
+        return 0;
+    }
+    const uint64_t length = handle->pending.size();
+    if (length > capacity) {
+        return -static_cast<int64_t>(length);
+    }
+    memcpy(out, handle->pending.data(), length);
+    handle->pending.clear();
+    return static_cast<int64_t>(length);
+}
+
+void pm_trace_stats(const TraceHandle* handle, TraceStats* out) { *out = handle->ring.stats(); }
+
+void pm_trace_close(TraceHandle* handle) { delete handle; }
+
+}  // extern "C"
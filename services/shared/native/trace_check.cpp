@@ -0,0 +1,312 @@
+/**
+ * Self-checks and cost measurement for the span ring (TraceRing.h).
+ *
+ * Checks traceparent parsing against the W3C rules (versions, lengths,
+ * upper case, all-zero ids) and the round trip through formatting, the
+ * OTLP/JSON layout of a drained document (grouping by service, ids,
+ * nanosecond times, typed attributes, status), attribute truncation to
+ * whole lines, and a ring fed by several threads at once: every span
+ * exported exactly once or counted as dropped. The exporter is run against
+ * a temporary file. Then it times record() from one and from several
+ * threads.
+ *
+ * Usage:
+ *   trace_check [--spans N]
+ *
+ * Exit status is 0 when every check passed, 1 otherwise.
+ */
+
+#include "TraceRing.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace pulsemind::trace;
+
+namespace {
+
+int g_failures = 0;
+int g_checks = 0;
+
+void expect(bool ok, const char* what) {
+    g_checks++;
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s\n", what);
+        g_failures++;
+    }
+}
+
+bool parses(const char* s) {
+    TraceContext ctx;
+    return parseTraceparent(s, strlen(s), ctx);
+}
+
+void checkTraceparent() {
+    // The W3C specification's example
+    const char* example = "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01";
+    TraceContext ctx;
+    expect(parseTraceparent(example, strlen(example), ctx), "example parses");
+    expect(ctx.traceId[0] == 0x4b && ctx.traceId[15] == 0x36, "trace id bytes");
+    expect(ctx.spanId == 0x00f067aa0ba902b7ull, "parent span id");
+    expect(ctx.sampled(), "sampled flag");
+    char out[TRACEPARENT_LENGTH + 1];
+    formatTraceparent(ctx, out);
+    expect(strcmp(out, example) == 0, "format round trip");
+
+    expect(!parses("00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-0"), "short");
+    expect(!parses("00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01-x"), "version 00 with extra fields");
+    expect(parses("01-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01-x"), "later version with extra fields");
+    expect(!parses("ff-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01"), "version ff");
+    expect(!parses("00-4BF92F3577B34DA6A3CE929D0E0E4736-00f067aa0ba902b7-01"), "upper case");
+    expect(!parses("00-00000000000000000000000000000000-00f067aa0ba902b7-01"), "zero trace id");
+    expect(!parses("00-4bf92f3577b34da6a3ce929d0e0e4736-0000000000000000-01"), "zero span id");
+    expect(!parses("00_4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01"), "separator");
+
+    TraceContext unsampled;
+    expect(parses("00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-00"), "unsampled parses");
+    parseTraceparent("00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-00", TRACEPARENT_LENGTH, unsampled);
+    expect(!unsampled.sampled(), "unsampled flag");
+
+    std::set<uint64_t> ids;
+    for (int i = 0; i < 10000; i++) {
+        ids.insert(randomId());
+    }
+    expect(ids.size() == 10000 && ids.count(0) == 0, "random ids are distinct and non-zero");
+}
+
+void checkDocument() {
+    SpanRing ring(16);
+    std::string doc;
+    expect(ring.drain(doc, 100) == 0 && doc.empty(), "empty ring drains nothing");
+
+    TraceContext ctx;
+    parseTraceparent("00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01", TRACEPARENT_LENGTH, ctx);
+    const std::string attrs = "device.id=dev-a\nbeats=-12\nhr=72.50\nok=true\nnote=\"x\"\nbad\n=v\nzero=007";
+    ring.record(ctx.traceId, 0x1122334455667788ull, ctx.spanId, 1700000000000000LL, 1500, SPAN_KIND_CONSUMER,
+                SPAN_STATUS_UNSET, "ingest-worker", 13, "ingest.queue", 12, attrs.data(), attrs.size());
+    ring.record(ctx.traceId, 0x2ull, 0, 1700000000001000LL, 20, SPAN_KIND_INTERNAL, SPAN_STATUS_ERROR,
+                "esp32-firmware", 14, "device.sample_to_actuation", 26, "", 0);
+    ring.record(ctx.traceId, 0x3ull, 0x2ull, 1700000000002000LL, 5, SPAN_KIND_SERVER, SPAN_STATUS_OK,
+                "ingest-worker", 13, "policy.decide", 13, "", 0);
+    expect(ring.drain(doc, 100) == 3, "three spans drained");
+    expect(doc ==
+               "{\"resourceSpans\":["
+               "{\"resource\":{\"attributes\":[{\"key\":\"service.name\",\"value\":{\"stringValue\":\"ingest-worker\"}}]},"
+               "\"scopeSpans\":[{\"scope\":{\"name\":\"pulsemind.trace\"},\"spans\":["
+               "{\"traceId\":\"4bf92f3577b34da6a3ce929d0e0e4736\",\"spanId\":\"1122334455667788\","
+               "\"parentSpanId\":\"00f067aa0ba902b7\",\"name\":\"ingest.queue\",\"kind\":5,"
+               "\"startTimeUnixNano\":\"1700000000000000000\",\"endTimeUnixNano\":\"1700000000001500000\","
+               "\"attributes\":[{\"key\":\"device.id\",\"value\":{\"stringValue\":\"dev-a\"}},"
+               "{\"key\":\"beats\",\"value\":{\"intValue\":\"-12\"}},"
+               "{\"key\":\"hr\",\"value\":{\"doubleValue\":72.50}},"
+               "{\"key\":\"ok\",\"value\":{\"boolValue\":true}},"
+               "{\"key\":\"note\",\"value\":{\"stringValue\":\"\\\"x\\\"\"}},"
+               "{\"key\":\"zero\",\"value\":{\"stringValue\":\"007\"}}]},"
+               "{\"traceId\":\"4bf92f3577b34da6a3ce929d0e0e4736\",\"spanId\":\"0000000000000003\","
+               "\"parentSpanId\":\"0000000000000002\",\"name\":\"policy.decide\",\"kind\":2,"
+               "\"startTimeUnixNano\":\"1700000000002000000\",\"endTimeUnixNano\":\"1700000000002005000\","
+               "\"status\":{\"code\":1}}]}]},"
+               "{\"resource\":{\"attributes\":[{\"key\":\"service.name\",\"value\":{\"stringValue\":\"esp32-firmware\"}}]},"
+               "\"scopeSpans\":[{\"scope\":{\"name\":\"pulsemind.trace\"},\"spans\":["
+               "{\"traceId\":\"4bf92f3577b34da6a3ce929d0e0e4736\",\"spanId\":\"0000000000000002\","
+               "\"name\":\"device.sample_to_actuation\",\"kind\":1,"
+               "\"startTimeUnixNano\":\"1700000000001000000\",\"endTimeUnixNano\":\"1700000000001020000\","
+               "\"status\":{\"code\":2}}]}]}]}",
+           "document layout");
+
+    // Attributes that do not fit keep whole lines only
+    std::string many;
+    for (int i = 0; i < 40; i++) {
+        many += "key" + std::to_string(i) + "=value\n";
+    }
+    doc.clear();
+    ring.record(ctx.traceId, 0x4ull, 0, 0, 0, SPAN_KIND_INTERNAL, SPAN_STATUS_UNSET, "svc", 3, "n", 1,
+                many.data(), many.size());
+    expect(ring.drain(doc, 100) == 1, "truncated span drained");
+    expect(ring.stats().truncated == 1, "truncation counted");
+    expect(doc.find("\"key\":\"key0\"") != std::string::npos && doc.find("\"key\":\"key39\"") == std::string::npos,
+           "attributes cut");
+    expect(doc.find("\"stringValue\":\"val\"") == std::string::npos, "no partial attribute");
+}
+
+void checkRing(unsigned spans) {
+    // A small ring under several producers and a concurrent consumer
+    SpanRing ring(256);
+    const unsigned threads = 4;
+    std::vector<std::thread> pool;
+    std::vector<uint64_t> accepted(threads, 0);
+    std::atomic<bool> done{false};
+    std::string out;
+    std::vector<size_t> perDoc;
+    std::thread consumer([&] {
+        while (!done.load()) {
+            const size_t n = ring.drain(out, 64);
+            if (n > 0) {
+                perDoc.push_back(n);
+                out.push_back('\n');
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        size_t n;
+        while ((n = ring.drain(out, 64)) > 0) {
+            perDoc.push_back(n);
+            out.push_back('\n');
+        }
+    });
+    uint8_t traceId[TRACE_ID_BYTES];
+    newTraceId(traceId);
+    for (unsigned t = 0; t < threads; t++) {
+        pool.emplace_back([&, t] {
+            for (unsigned i = 0; i < spans / threads; i++) {
+                const uint64_t id = (static_cast<uint64_t>(t + 1) << 32) | (i + 1);
+                accepted[t] += ring.record(traceId, id, 0, i, 1, SPAN_KIND_INTERNAL, SPAN_STATUS_UNSET, "svc", 3,
+                                           "span", 4, "", 0);
+            }
+        });
+    }
+    for (std::thread& th : pool) {
+        th.join();
+    }
+    done.store(true);
+    consumer.join();
+
+    uint64_t total = 0;
+    for (uint64_t a : accepted) {
+        total += a;
+    }
+    size_t spanCount = 0;
+    for (size_t n : perDoc) {
+        spanCount += n;
+    }
+    size_t ids = 0;
+    for (size_t at = out.find("\"spanId\""); at != std::string::npos; at = out.find("\"spanId\"", at + 1)) {
+        ids++;
+    }
+    const TraceStats stats = ring.stats();
+    expect(spanCount == total && ids == total, "every accepted span exported once");
+    expect(stats.recorded == total && stats.exported == total, "recorded and exported counters");
+    expect(stats.recorded + stats.dropped == spans / threads * threads, "drops counted");
+    expect(out.size() > 0 && static_cast<size_t>(std::count(out.begin(), out.end(), '\n')) == perDoc.size(),
+           "one document per drain");
+    printf("ring: %llu spans from %u threads, %llu dropped with a 256-slot ring\n",
+           static_cast<unsigned long long>(total), threads, static_cast<unsigned long long>(stats.dropped));
+}
+
+void checkExporter() {
+    char path[] = "/tmp/trace_check_XXXXXX";
+    const int fd = mkstemp(path);
+    expect(fd >= 0, "temporary file");
+    {
+        SpanRing ring(1024);
+        TraceExporter exporter(ring, fd, 10);
+        uint8_t traceId[TRACE_ID_BYTES];
+        newTraceId(traceId);
+        for (int i = 0; i < 600; i++) {
+            ring.record(traceId, randomId(), 0, wallUs(), 10, SPAN_KIND_INTERNAL, SPAN_STATUS_UNSET, "svc", 3,
+                        "span", 4, "", 0);
+        }
+    }
+    std::string contents;
+    char buf[65536];
+    ssize_t n;
+    lseek(fd, 0, SEEK_SET);
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        contents.append(buf, static_cast<size_t>(n));
+    }
+    close(fd);
+    unlink(path);
+    size_t lines = 0;
+    size_t spans = 0;
+    bool wellFormed = true;
+    size_t start = 0;
+    while (start < contents.size()) {
+        const size_t end = contents.find('\n', start);
+        const std::string line = contents.substr(start, end - start);
+        wellFormed &= line.rfind("{\"resourceSpans\":[", 0) == 0 && line.back() == '}';
+        for (size_t at = line.find("\"spanId\""); at != std::string::npos; at = line.find("\"spanId\"", at + 1)) {
+            spans++;
+        }
+        lines++;
+        start = end + 1;
+    }
+    expect(wellFormed, "exporter writes one document per line");
+    expect(spans == 600, "exporter writes every span before stopping");
+    expect(lines >= 2, "exporter batches at most EXPORT_BATCH_SPANS per document");
+}
+
+void bench(unsigned spans) {
+    uint8_t traceId[TRACE_ID_BYTES];
+    newTraceId(traceId);
+    const std::string attrs = "device.id=ESP32_PulseMind_01\ncommand.published=true";
+    for (unsigned threads : {1u, 4u}) {
+        SpanRing ring(DEFAULT_SPAN_CAPACITY);
+        std::string sink;
+        const unsigned burst = DEFAULT_SPAN_CAPACITY / 2;
+        double recordNs = 0;
+        uint64_t kept = 0;
+        for (unsigned done = 0; done < spans; done += burst) {
+            std::vector<std::thread> pool;
+            std::vector<uint64_t> ok(threads, 0);
+            std::vector<double> ns(threads, 0);
+            for (unsigned t = 0; t < threads; t++) {
+                pool.emplace_back([&, t] {
+                    const auto s0 = std::chrono::steady_clock::now();
+                    for (unsigned i = 0; i < burst / threads; i++) {
+                        ok[t] += ring.record(traceId, randomId(), 0x42, wallUs(), 120, SPAN_KIND_INTERNAL,
+                                             SPAN_STATUS_UNSET, "ingest-worker", 13, "pipeline.analyze", 16,
+                                             attrs.data(), attrs.size());
+                    }
+                    ns[t] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - s0).count();
+                });
+            }
+            for (std::thread& th : pool) {
+                th.join();
+            }
+            for (unsigned t = 0; t < threads; t++) {
+                kept += ok[t];
+                recordNs += ns[t];
+            }
+            while (ring.drain(sink, EXPORT_BATCH_SPANS) > 0) {
+                sink.clear();
+            }
+        }
+        printf("bench: %u thread(s): %.0f ns per span (ids and clock included)\n", threads,
+               recordNs / static_cast<double>(kept));
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    unsigned spans = 200000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--spans") == 0 && i + 1 < argc) {
+            spans = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+        } else {
+            fprintf(stderr, "usage: %s [--spans N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    checkTraceparent();
+    checkDocument();
+    checkRing(spans / 4);
+    checkExporter();
+
+    if (g_failures > 0) {
+        fprintf(stderr, "trace_check: %d of %d check(s) failed\n", g_failures, g_checks);
+        return 1;
+    }
+    bench(spans);
+    printf("trace_check: all %d checks passed\n", g_checks);
+    return 0;
+}
@@ -0,0 +1,113 @@
+/**
+ * C ABI over TimeSeriesStore.h.
+ *
+ * Loaded from Python with ctypes (services/control-engine/waveform_store.py)
+ * to read the waveform behind a pacing decision and rollups for long-range
+ * plots, and to write in tools and tests; the ingest worker links the header
+ * directly. Query results go through per-thread buffers, so concurrent
+ * request threads can share one reader (the GIL is released during calls).
+ */
+
+#include <new>
+
+#include "TimeSeriesStore.h"
+
+using namespace pulsemind::tsdb;
+
+extern "C" {
+
+uint32_t pm_tsdb_abi_version(void) { return 2; }
+
+/**
+ * Tier to read for a plot of max_points over span_us (0: raw samples), or -1
+ * for an unknown metric.
+ */
+int32_t pm_tsdb_select_tier(uint32_t metric, int64_t span_us, uint64_t max_points) {
+    if (metric >= METRIC_COUNT) {
+        return -1;
+    }
+    return selectTier(static_cast<Metric>(metric), span_us, max_points);
+}
+
+/**
+ * Open a writer; nullptr (with the reason on stderr) on failure.
+ */
+TimeSeriesWriter* pm_tsdb_writer_open(const char* root, const char* name, int64_t block_duration_us) {
+    TimeSeriesWriter* writer = new (std::nothrow) TimeSeriesWriter();
+    std::string error;
+    if (writer != nullptr && !writer->open(root, name, error, block_duration_us)) {
+        fprintf(stderr, "tsdb: %s\n", error.c_str());
+        delete writer;
+        return nullptr;
+    }
+    return writer;
+}
+
+int32_t pm_tsdb_writer_append(TimeSeriesWriter* writer, const char* device_id, uint32_t metric, const int64_t* ts,
+                              const double* values, uint64_t n) {
+    if (metric >= METRIC_COUNT) {
+        return static_cast<int32_t>(Status::InvalidSeries);
+    }
+    return static_cast<int32_t>(writer->append(device_id, static_cast<Metric>(metric), ts, values, n));
+}
+
+int32_t pm_tsdb_writer_flush(TimeSeriesWriter* writer) { return static_cast<int32_t>(writer->sync()); }
+
+/**
+ * Flush and free the writer.
+ */
+void pm_tsdb_writer_close(TimeSeriesWriter* writer) { delete writer; }
+
+TimeSeriesReader* pm_tsdb_reader_open(const char* root) { return new (std::nothrow) TimeSeriesReader(root); }
+
+void pm_tsdb_reader_close(TimeSeriesReader* reader) { delete reader; }
+
+/**
+ * Samples with from_us <= ts < to_us, oldest first. Copies at most capacity
+ * samples and returns how many matched (call again with a larger buffer if
+ * that is more than capacity), or -1 for an unknown metric.
+ */
+int64_t pm_tsdb_reader_query(TimeSeriesReader* reader, const char* device_id, uint32_t metric, int64_t from_us,
+                             int64_t to_us, int64_t* ts_out, double* values_out, uint64_t capacity) {
+    if (metric >= METRIC_COUNT) {
+        return -1;
+    }
+    static thread_local std::vector<int64_t> ts;
+    static thread_local std::vector<double> values;
+    reader->query(device_id, static_cast<Metric>(metric), from_us, to_us, ts, values);
+    const size_t n = std::min<size_t>(ts.size(), capacity);
+    std::copy(ts.begin(), ts.begin() + n, ts_out);
+    std::copy(values.begin(), values.begin() + n, values_out);
+    return static_cast<int64_t>(ts.size());
+}
+
+/**
+ * Buckets of a rollup tier overlapping [from_us, to_us), oldest first, as
+ * min, max, mean and sample count. Same buffer protocol as
+ * pm_tsdb_reader_query; -1 for an unknown metric or tier.
+ */
+int64_t pm_tsdb_reader_query_rollup(TimeSeriesReader* reader, const char* device_id, uint32_t metric, uint32_t tier,
+                                    int64_t from_us, int64_t to_us, int64_t* ts_out, double* min_out,
+                                    double* max_out, double* mean_out, double* count_out, uint64_t capacity) {
+    if (metric >= METRIC_COUNT || tier == 0 || tier > ROLLUP_TIER_COUNT) {
+        return -1;
+    }
+    static thread_local RollupPoints points;
+    reader->queryRollup(device_id, static_cast<Metric>(metric), static_cast<uint8_t>(tier), from_us, to_us, points);
+    const size_t n = std::min<size_t>(points.size(), capacity);
+    for (size_t i = 0; i < n; i++) {
+        ts_out[i] = points.ts[i];
+        min_out[i] = points.min[i];
+        max_out[i] = points.max[i];
+        mean_out[i] = points.sum[i] / points.count[i];
+        count_out[i] = points.count[i];
+    }
+    return static_cast<int64_t>(points.size());
+}
+
+/**
+ * Blocks that failed their CRC or decode check in queries so far.
+ */
+uint64_t pm_tsdb_reader_corrupt_blocks(TimeSeriesReader* reader) { return reader->stats().corruptBlocks; }
+
+}  // extern "C"
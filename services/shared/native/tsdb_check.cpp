@@ -0,0 +1,456 @@
+/**
+ * Self-checks and throughput measurement for the time-series store
+ * (TimeSeriesStore.h).
+ *
+ * Round-trips every encoding (ADC counts, fixed-decimal values whose scale
+ * widens mid-block, arbitrary doubles including NaN, infinities and -0.0)
+ * through segments on disk and back, bit for bit, then checks slot cutting,
+ * out-of-order rejection, torn and corrupted blocks, readers following a
+ * live writer, and every rollup tier against aggregates computed from the
+ * raw samples, across writers and partial buckets. Finally it times ingest
+ * and query of synthetic 100 Hz PPG, raw and from the 1 s rollup tier, and
+ * reports the stored size per sample.
+ *
+ * Usage:
+ *   tsdb_check [--dir DIR] [--devices N] [--seconds S]
+ *
+ * Exit status is 0 when every check passed, 1 otherwise.
+ */
+
+#include "TimeSeriesStore.h"
+
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace pulsemind::tsdb;
+
+namespace {
+
+int g_failures = 0;
+
+void expect(bool ok, const char* what) {
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s\n", what);
+        g_failures++;
+    }
+}
+
+bool sameBits(double a, double b) { return memcmp(&a, &b, sizeof(a)) == 0; }
+
+double seconds(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+}
+
+void removeTree(const std::string& root) {
+    if (DIR* dir = opendir(root.c_str())) {
+        while (const dirent* entry = readdir(dir)) {
+            if (entry->d_name[0] != '.') {
+                unlink((root + "/" + entry->d_name).c_str());
+            }
+        }
+        closedir(dir);
+    }
+    rmdir(root.c_str());
+}
+
+/**
+ * Fresh store directory per check.
+ */
+std::string storeDir(const std::string& base, const char* name) {
+    const std::string root = base + "/" + name;
+    removeTree(root);
+    return root;
+}
+
+bool openWriter(TimeSeriesWriter& writer, const std::string& root, const char* name,
+                int64_t blockDurationUs = BLOCK_DURATION_US) {
+    std::string error;
+    if (!writer.open(root, name, error, blockDurationUs)) {
+        fprintf(stderr, "FAIL: open %s: %s\n", root.c_str(), error.c_str());
+        g_failures++;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * 100 Hz PPG-like samples starting at t0, with the device clock's
+ * millisecond jitter on every 10th sample.
+ */
+void synthesize(std::mt19937_64& rng, int64_t t0, size_t n, bool decimals, std::vector<int64_t>& ts,
+                std::vector<double>& values) {
+    std::normal_distribution<double> noise(0.0, 10.0);
+    std::uniform_int_distribution<int> jitter(-1, 1);
+    ts.resize(n);
+    values.resize(n);
+    int64_t t = t0;
+    for (size_t i = 0; i < n; i++) {
+        const double v = 2048 + 300 * std::sin(2 * M_PI * 1.2 * static_cast<double>(i) / 100.0) + noise(rng);
+        values[i] = decimals ? std::round(v * 100) / 100 : std::round(v);
+        ts[i] = t;
+        t += 10000 + (i % 10 == 9 ? 1000 * jitter(rng) : 0);
+    }
+}
+
+void checkRoundTrip(const std::string& base, const char* name, const std::vector<int64_t>& ts,
+                    const std::vector<double>& values, int64_t blockDurationUs = BLOCK_DURATION_US) {
+    const std::string root = storeDir(base, name);
+    {
+        TimeSeriesWriter writer;
+        if (!openWriter(writer, root, "w", blockDurationUs)) {
+            return;
+        }
+        // Uneven append sizes, as frames arrive
+        for (size_t at = 0; at < ts.size();) {
+            const size_t n = std::min<size_t>(ts.size() - at, 1 + at % 17);
+            expect(writer.append("dev-a", Metric::Ppg, &ts[at], &values[at], n) == Status::Ok, name);
+            at += n;
+        }
+        expect(writer.flush() == Status::Ok, name);
+    }
+    TimeSeriesReader reader(root);
+    std::vector<int64_t> gotTs;
+    std::vector<double> got;
+    reader.query("dev-a", Metric::Ppg, INT64_MIN, INT64_MAX, gotTs, got);
+    bool same = gotTs == ts && got.size() == values.size();
+    for (size_t i = 0; same && i < got.size(); i++) {
+        same = sameBits(got[i], values[i]);
+    }
+    expect(same, name);
+
+    // Sub-range crossing block boundaries
+    const size_t from = ts.size() / 3;
+    const size_t to = 2 * ts.size() / 3;
+    reader.query("dev-a", Metric::Ppg, ts[from], ts[to], gotTs, got);
+    expect(gotTs.size() == to - from && (gotTs.empty() || (gotTs.front() == ts[from] && gotTs.back() == ts[to - 1])),
+           name);
+    reader.query("dev-a", Metric::HeartRate, INT64_MIN, INT64_MAX, gotTs, got);
+    expect(gotTs.empty(), name);
+    expect(reader.stats().corruptBlocks == 0, name);
+    removeTree(root);
+}
+
+void checkEncodings(const std::string& base) {
+    std::mt19937_64 rng(7);
+    std::vector<int64_t> ts;
+    std::vector<double> values;
+
+    synthesize(rng, 1700000000000000, 30000, false, ts, values);
+    checkRoundTrip(base, "adc_counts", ts, values);
+
+    synthesize(rng, 1700000000000000, 30000, true, ts, values);
+    checkRoundTrip(base, "two_decimals", ts, values);
+
+    // Scale widens mid-block (1 -> 3 decimals), then no decimal scale fits
+    for (size_t i = 0; i < values.size(); i++) {
+        if (i % 1000 == 500) {
+            values[i] += 0.125;
+        }
+        if (i == 20000) {
+            values[i] = 1.0 / 3.0;
+        }
+    }
+    checkRoundTrip(base, "scale_upgrade", ts, values);
+
+    std::uniform_real_distribution<double> any(-1e6, 1e6);
+    for (double& v : values) {
+        v = any(rng);
+    }
+    values[3] = NAN;
+    values[4] = INFINITY;
+    values[5] = -INFINITY;
+    values[6] = -0.0;
+    values[7] = 5e300;
+    values[8] = values[9] = values[10] = 42.0;
+    checkRoundTrip(base, "arbitrary_doubles", ts, values);
+
+    // Large integers, equal timestamps, gaps longer than a block
+    for (size_t i = 0; i < values.size(); i++) {
+        values[i] = static_cast<double>((1ll << 52) - static_cast<int64_t>(i * i));
+        ts[i] = 1000 + static_cast<int64_t>(i / 3) * 7000 + (i % 5000 == 0 ? static_cast<int64_t>(i) * 1000000 : 0);
+    }
+    std::sort(ts.begin(), ts.end());
+    checkRoundTrip(base, "gaps_and_duplicates", ts, values, 1000000);
+}
+
+void checkWriterRules(const std::string& base) {
+    const std::string root = storeDir(base, "rules");
+    TimeSeriesWriter writer;
+    if (!openWriter(writer, root, "w", 1000000)) {
+        return;
+    }
+    const int64_t ts[] = {100, 200, 150, 300};
+    const double values[] = {1, 2, 3, 4};
+    expect(writer.append("dev", Metric::Hsi, ts, values, 4) == Status::OutOfOrder, "out of order rejected");
+    expect(writer.append("", Metric::Hsi, ts, values, 1) == Status::InvalidSeries, "empty device id rejected");
+    expect(writer.append(std::string(MAX_DEVICE_ID_BYTES + 1, 'x'), Metric::Hsi, ts, values, 1) ==
+               Status::InvalidSeries,
+           "long device id rejected");
+    // Three slots -> three blocks
+    const int64_t spread[] = {999999, 1000000, 2500000};
+    expect(writer.append("dev", Metric::Hsi, spread, values, 3) == Status::Ok, "slot append");
+    expect(writer.flush() == Status::Ok && writer.stats().blocks == 3, "blocks cut at slot boundaries");
+    expect(writer.openSeries() == 1, "flush keeps active series");
+    // Idle for a flush interval: the open 10 s bucket is stored in every coarser tier
+    expect(writer.flush() == Status::Ok && writer.stats().blocks == 6, "idle series stores open buckets");
+    expect(writer.openSeries() == 0, "flush releases idle series");
+
+    TimeSeriesReader reader(root);
+    std::vector<int64_t> gotTs;
+    std::vector<double> got;
+    reader.query("dev", Metric::Hsi, 0, INT64_MAX, gotTs, got);
+    expect((gotTs == std::vector<int64_t>{100, 200, 999999, 1000000, 2500000}), "accepted prefix stored");
+    reader.query("dev", Metric::Hsi, 1000000, 2500000, gotTs, got);
+    expect((gotTs == std::vector<int64_t>{1000000}), "half-open range");
+
+    std::string error;
+    TimeSeriesWriter bad;
+    expect(!bad.open(root, "a/b", error), "writer name with a slash rejected");
+    removeTree(root);
+}
+
+void checkDurability(const std::string& base) {
+    const std::string root = storeDir(base, "durability");
+    std::mt19937_64 rng(11);
+    std::vector<int64_t> ts;
+    std::vector<double> values;
+    synthesize(rng, 0, 12000, false, ts, values);
+
+    TimeSeriesWriter writer;
+    if (!openWriter(writer, root, "w", 10000000)) {
+        return;
+    }
+    TimeSeriesReader reader(root);
+    std::vector<int64_t> gotTs;
+    std::vector<double> got;
+
+    // A live writer: heads are invisible until flushed, then readers follow
+    writer.append("dev", Metric::Ppg, ts.data(), values.data(), 6000);
+    reader.query("dev", Metric::Ppg, 0, INT64_MAX, gotTs, got);
+    const size_t sealedEarly = gotTs.size();
+    expect(sealedEarly < 6000, "unflushed head not visible");
+    writer.flush();
+    reader.query("dev", Metric::Ppg, 0, INT64_MAX, gotTs, got);
+    expect(gotTs.size() == 6000, "reader follows the writer");
+    writer.append("dev", Metric::Ppg, ts.data() + 6000, values.data() + 6000, 6000);
+    writer.flush();
+    reader.query("dev", Metric::Ppg, 0, INT64_MAX, gotTs, got);
+    expect(gotTs == ts, "reader picks up appended blocks");
+
+    // Torn tail: only whole blocks before it are read
+    char path[256];
+    snprintf(path, sizeof(path), "%s/w-%08u.seg", root.c_str(), 0u);
+    struct stat st;
+    stat(path, &st);
+    expect(truncate(path, st.st_size - 5) == 0, "truncate");
+    TimeSeriesReader torn(root);
+    torn.query("dev", Metric::Ppg, 0, INT64_MAX, gotTs, got);
+    expect(torn.stats().blocks + 1 == reader.stats().blocks && !gotTs.empty() && gotTs.size() <= ts.size() &&
+               std::equal(gotTs.begin(), gotTs.end(), ts.begin()),
+           "torn tail ignored, earlier blocks intact");
+
+    // Flipped payload bit: that block fails its CRC, the others still read
+    const int fd = open(path, O_RDWR);
+    uint8_t byte;
+    expect(pread(fd, &byte, 1, 200) == 1, "read byte");
+    byte ^= 0x10;
+    expect(pwrite(fd, &byte, 1, 200) == 1, "write byte");
+    close(fd);
+    TimeSeriesReader corrupt(root);
+    corrupt.query("dev", Metric::Ppg, 0, INT64_MAX, gotTs, got);
+    expect(corrupt.stats().corruptBlocks == 1 && !gotTs.empty(), "corrupt block skipped");
+
+    // A new writer under the same name continues in a fresh segment
+    TimeSeriesWriter next;
+    if (openWriter(next, root, "w")) {
+        snprintf(path, sizeof(path), "%s/w-%08u.seg", root.c_str(), 1u);
+        expect(access(path, F_OK) == 0, "next segment sequence");
+    }
+    removeTree(root);
+}
+
+/**
+ * Every tier's buckets against aggregates of the raw samples. The series is
+ * written by two writers in turn, each stopping mid-bucket, so the reader
+ * has to merge partial buckets.
+ */
+void checkRollups(const std::string& base) {
+    const std::string root = storeDir(base, "rollups");
+    std::mt19937_64 rng(5);
+    std::vector<int64_t> ts;
+    std::vector<double> values;
+    // 25 minutes from 7.5 s past a 10-minute boundary
+    synthesize(rng, 1700000400000000 + 7500000, 150000, true, ts, values);
+    values[1234] = NAN;  // Stored raw, not aggregated
+
+    const size_t split = 80123;
+    const char* const names[] = {"w1", "w2"};
+    for (int part = 0; part < 2; part++) {
+        TimeSeriesWriter writer;
+        if (!openWriter(writer, root, names[part])) {
+            return;
+        }
+        const size_t begin = part == 0 ? 0 : split;
+        const size_t end = part == 0 ? split : ts.size();
+        for (size_t at = begin; at < end; at += 10) {
+            writer.append("dev", Metric::Ppg, &ts[at], &values[at], std::min<size_t>(10, end - at));
+            if (at % 1000 == 0) {
+                writer.flush();  // Every 10 s of data, as the ingest worker does
+            }
+        }
+    }
+
+    TimeSeriesReader reader(root);
+    RollupPoints points;
+    for (uint8_t tier = 1; tier <= ROLLUP_TIER_COUNT; tier++) {
+        const int64_t width = ROLLUP_TIER_US[tier];
+        RollupPoints want;
+        for (size_t i = 0; i < ts.size(); i++) {
+            if (!std::isfinite(values[i])) {
+                continue;
+            }
+            const int64_t start = alignDown(ts[i], width);
+            if (want.ts.empty() || want.ts.back() != start) {
+                want.ts.push_back(start);
+                want.min.push_back(values[i]);
+                want.max.push_back(values[i]);
+                want.sum.push_back(0);
+                want.count.push_back(0);
+            }
+            want.min.back() = std::min(want.min.back(), values[i]);
+            want.max.back() = std::max(want.max.back(), values[i]);
+            want.sum.back() += values[i];
+            want.count.back() += 1;
+        }
+        reader.queryRollup("dev", Metric::Ppg, tier, INT64_MIN, INT64_MAX, points);
+        bool same = points.ts == want.ts && points.min == want.min && points.max == want.max &&
+                    points.count == want.count;
+        for (size_t i = 0; same && i < points.size(); i++) {
+            same = std::fabs(points.sum[i] - want.sum[i]) <= 1e-9 * std::fabs(want.sum[i]);
+        }
+        char what[64];
+        snprintf(what, sizeof(what), "rollup tier %u matches the raw samples", tier);
+        expect(same, what);
+
+        // A range starting mid-bucket includes that bucket (tier 4 has three)
+        reader.queryRollup("dev", Metric::Ppg, tier, want.ts[0] + 1, want.ts[2], points);
+        snprintf(what, sizeof(what), "rollup tier %u range", tier);
+        expect((points.ts == std::vector<int64_t>{want.ts[0], want.ts[1]}), what);
+    }
+    reader.queryRollup("dev", Metric::Ppg, 0, INT64_MIN, INT64_MAX, points);
+    expect(points.size() == 0, "tier 0 is not a rollup");
+    expect(reader.stats().corruptBlocks == 0, "rollup blocks intact");
+
+    // Features skip the 1 s tier; plots pick the coarsest tier with a point per pixel
+    expect(selectTier(Metric::Ppg, 10LL * 1000000, 1000) == 0, "short span reads raw samples");
+    expect(selectTier(Metric::Ppg, 3600LL * 1000000, 1000) == 1, "hour of PPG from the 1 s tier");
+    expect(selectTier(Metric::Hsi, 3600LL * 1000000, 1000) == 0, "hour of HSI from raw features");
+    expect(selectTier(Metric::Hsi, 86400LL * 1000000, 1000) == 3, "day from the 1 min tier");
+    expect(selectTier(Metric::Ppg, 30 * 86400LL * 1000000, 1000) == 4, "month from the 10 min tier");
+    removeTree(root);
+}
+
+/**
+ * Ingest and query throughput on synthetic 100 Hz ADC PPG, appended in
+ * 10-sample frames round-robin across devices as the ingest worker does.
+ */
+void bench(const std::string& base, unsigned devices, unsigned secondsOfData) {
+    const std::string root = storeDir(base, "bench");
+    std::mt19937_64 rng(3);
+    std::vector<int64_t> ts;
+    std::vector<double> values;
+    const size_t perDevice = static_cast<size_t>(secondsOfData) * 100;
+    synthesize(rng, 1700000000000000, perDevice, false, ts, values);
+
+    std::vector<std::string> ids;
+    for (unsigned d = 0; d < devices; d++) {
+        ids.push_back("device-" + std::to_string(d));
+    }
+
+    TimeSeriesWriter writer;
+    if (!openWriter(writer, root, "bench")) {
+        return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t at = 0; at < perDevice; at += 10) {
+        for (const std::string& id : ids) {
+            writer.append(id, Metric::Ppg, &ts[at], &values[at], std::min<size_t>(10, perDevice - at));
+        }
+    }
+    writer.finish();
+    const double ingestSec = seconds(start);
+    const double samples = static_cast<double>(perDevice) * devices;
+
+    TimeSeriesReader reader(root);
+    std::vector<int64_t> gotTs;
+    std::vector<double> got;
+    const auto queryStart = std::chrono::steady_clock::now();
+    size_t read = 0;
+    for (const std::string& id : ids) {
+        reader.query(id, Metric::Ppg, INT64_MIN, INT64_MAX, gotTs, got);
+        read += gotTs.size();
+    }
+    const double querySec = seconds(queryStart);
+    expect(read == perDevice * devices, "bench read back");
+
+    // The whole span from the finest rollup tier
+    RollupPoints points;
+    const auto rollupStart = std::chrono::steady_clock::now();
+    for (const std::string& id : ids) {
+        reader.queryRollup(id, Metric::Ppg, 1, INT64_MIN, INT64_MAX, points);
+    }
+    const double rollupMs = seconds(rollupStart) * 1e3 / devices;
+    expect(points.size() >= secondsOfData, "bench rollup points");
+
+    printf("tsdb: %u devices x %us @100 Hz: %.2f bytes/sample, ingest %.1f M samples/s, query %.1f M samples/s, "
+           "%zu-point 1 s rollup query %.3f ms\n",
+           devices, secondsOfData, static_cast<double>(writer.stats().bytesWritten) / samples,
+           samples / ingestSec / 1e6, static_cast<double>(read) / querySec / 1e6, points.size(), rollupMs);
+    removeTree(root);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string dir = "build/tsdb_check.d";
+    unsigned devices = 100;
+    unsigned secondsOfData = 600;
+    for (int i = 1; i < argc; i++) {
+        const bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--dir") == 0 && hasValue) {
+            dir = argv[++i];
+        } else if (strcmp(argv[i], "--devices") == 0 && hasValue) {
+            devices = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--seconds") == 0 && hasValue) {
+            secondsOfData = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+        } else {
+            fprintf(stderr, "usage: %s [--dir DIR] [--devices N] [--seconds S]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (mkdir(dir.c_str(), 0750) != 0 && errno != EEXIST) {
+        perror(dir.c_str());
+        return 1;
+    }
+
+    checkEncodings(dir);
+    checkWriterRules(dir);
+    checkDurability(dir);
+    checkRollups(dir);
+    bench(dir, devices, secondsOfData);
+    rmdir(dir.c_str());
+
+    if (g_failures > 0) {
+        fprintf(stderr, "tsdb_check: %d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("tsdb_check: all checks passed\n");
+    return 0;
+}
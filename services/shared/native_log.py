@@ -0,0 +1,295 @@
+"""ctypes bindings for the native logging ring (shared/native/LogRing.h).
+
+A RingHandler hands each record to a LogSink: the calling thread renders the
+message and copies it into a lock-free ring; a native thread scrubs PHI,
+formats the JSON line and writes it. shared/logger.py installs one shared
+RingHandler per process when the library is available.
+
+LogSite is the admission check for hot-path call sites (sampling and/or a
+token bucket); see logger.hot_path_logger.
+
+Build the library with `make -C services/shared/native`, or point
+PULSEMIND_LOG_RING_LIB at a prebuilt liblog_ring.so.
+"""
+
+import ctypes
+import json
+import logging
+import os
+import threading
+import time
+from typing import Dict, Iterable, Optional
+
+DEFAULT_LIBRARY_PATH = os.path.join(
+    os.path.dirname(os.path.abspath(__file__)), "native", "build", "liblog_ring.so"
+)
+LIBRARY_PATH = os.getenv("PULSEMIND_LOG_RING_LIB", DEFAULT_LIBRARY_PATH)
+
+ABI_VERSION = 1
+
+# Ring slots; 0 takes the library default (4096)
+DEFAULT_CAPACITY = 0
+
+# Text bytes per slot (LOG_SLOT_BYTES less the header) and the service cap
+SLOT_TEXT_BYTES = 992
+MAX_SERVICE_BYTES = 64
+
+MASKED_PHI = "[MASKED_PHI]"
+
+
+class LogStats(ctypes.Structure):
+    """Mirror of pulsemind::logring::LogStats (submitted counts accepted records)."""
+
+    _fields_ = [
+        ("submitted", ctypes.c_uint64),
+        ("dropped", ctypes.c_uint64),
+        ("written", ctypes.c_uint64),
+        ("redacted", ctypes.c_uint64),
+        ("truncated", ctypes.c_uint64),
+        ("bytes", ctypes.c_uint64),
+        ("write_errors", ctypes.c_uint64),
+    ]
+
+
+_lib: Optional[ctypes.CDLL] = None
+
+
+def load_library(path: str = LIBRARY_PATH) -> ctypes.CDLL:
+    """Load and type the native library (cached after the first call).
+
+    Raises:
+        OSError: If the library is missing or has an incompatible ABI
+    """
+    global _lib
+    if _lib is not None:
+        return _lib
+
+    lib = ctypes.CDLL(path)
+    lib.pm_log_abi_version.restype = ctypes.c_uint32
+    if lib.pm_log_abi_version() != ABI_VERSION:
+        raise OSError(f"Unsupported log ring ABI version {lib.pm_log_abi_version()}")
+
+    lib.pm_log_open.argtypes = [ctypes.c_int32, ctypes.c_uint32, ctypes.c_char_p]
+    lib.pm_log_open.restype = ctypes.c_void_p
+    lib.pm_log_submit.argtypes = [
+        ctypes.c_void_p, ctypes.c_int64, ctypes.c_int32,
+        ctypes.c_char_p, ctypes.c_uint64, ctypes.c_char_p, ctypes.c_uint64,
+        ctypes.c_char_p, ctypes.c_uint64, ctypes.c_char_p, ctypes.c_uint64,
+    ]
+    lib.pm_log_submit.restype = ctypes.c_int32
+    lib.pm_log_flush.argtypes = [ctypes.c_void_p, ctypes.c_int64]
+    lib.pm_log_flush.restype = ctypes.c_int32
+    lib.pm_log_stats.argtypes = [ctypes.c_void_p, ctypes.POINTER(LogStats)]
+    lib.pm_log_stats.restype = None
+    lib.pm_log_close.argtypes = [ctypes.c_void_p]
+    lib.pm_log_close.restype = None
+    lib.pm_log_site_new.argtypes = [ctypes.c_double, ctypes.c_double, ctypes.c_uint32]
+    lib.pm_log_site_new.restype = ctypes.c_int32
+    lib.pm_log_site_allow.argtypes = [ctypes.c_int32]
+    lib.pm_log_site_allow.restype = ctypes.c_int64
+    lib.pm_log_site_allow_at.argtypes = [ctypes.c_int32, ctypes.c_int64]
+    lib.pm_log_site_allow_at.restype = ctypes.c_int64
+
+    _lib = lib
+    return lib
+
+
+def is_available(path: str = LIBRARY_PATH) -> bool:
+    """Return True if the native library can be loaded."""
+    try:
+        load_library(path)
+        return True
+    except OSError:
+        return False
+
+
+# ============================================================================
+# SINK AND HANDLER
+# ============================================================================
+
+class LogSink:
+    """A native ring plus the thread writing its records to fd as JSON lines."""
+
+    def __init__(self, fd: int, phi_fields: Iterable[str], capacity: int = DEFAULT_CAPACITY):
+        lib = load_library()
+        patterns = "\n".join(sorted(phi_fields)).encode()
+        self._ptr = lib.pm_log_open(fd, capacity, patterns)
+        if not self._ptr:
+            raise OSError("pm_log_open failed")
+        self.fd = fd
+        self._submit = lib.pm_log_submit
+
+    def submit(self, time_us: int, level: int, service: bytes, extra: bytes, message: bytes, exc: bytes) -> bool:
+        """Queue one record; False if it was dropped (ring full or sink closed)."""
+        if not self._ptr:
+            return False
+        return bool(self._submit(
+            self._ptr, time_us, level, service, len(service), extra, len(extra),
+            message, len(message), exc, len(exc)
+        ))
+
+    def flush(self, timeout: float = 2.0) -> bool:
+        """Wait until everything queued so far is written."""
+        if not self._ptr:
+            return True
+        return bool(_lib.pm_log_flush(self._ptr, int(timeout * 1000)))
+
+    def stats(self) -> Dict[str, int]:
+        stats = LogStats()
+        if not self._ptr:
+            return {name: 0 for name, _ in LogStats._fields_}
+        _lib.pm_log_stats(self._ptr, ctypes.byref(stats))
+        return {name: getattr(stats, name) for name, _ in LogStats._fields_}
+
+    def close(self) -> None:
+        """Drain and free the sink; it must not be used afterwards."""
+        if self._ptr:
+            _lib.pm_log_close(self._ptr)
+            self._ptr = None
+
+
+# LogRecord attributes that are not user extras (jsonlogger's RESERVED_ATTRS)
+_RESERVED = frozenset(logging.LogRecord("", 0, "", 0, "", (), None).__dict__) | {
+    "message", "asctime", "service", "taskName",
+}
+_PLAIN_RECORD_SIZE = len(logging.LogRecord("", 0, "", 0, "", (), None).__dict__)
+
+# Tracebacks are rendered as logging.Formatter (and so jsonlogger) does
+_formatter = logging.Formatter()
+
+
+class RingHandler(logging.Handler):
+    """Logging handler that submits records to a LogSink.
+
+    emit() does only what needs the record: render the message and copy the
+    bytes. The handler lock is not taken (the ring is safe for concurrent
+    producers), and no Formatter is used.
+
+    A record too big for a slot (typically a long traceback) is not cut: if
+    an overflow formatter is given, the ring is flushed and the record is
+    formatted and written in-line instead.
+    """
+
+    def __init__(self, sink: LogSink, phi_fields: Iterable[str],
+                 overflow: Optional[logging.Formatter] = None):
+        super().__init__()
+        self.sink = sink
+        self.phi_fields = frozenset(phi_fields)
+        self.overflow = overflow
+
+    def handle(self, record: logging.LogRecord) -> bool:
+        rv = self.filter(record)
+        if rv:
+            self.emit(record)
+        return rv
+
+    def _extra(self, record: logging.LogRecord) -> bytes:
+        """JSON fragment ('"k": v, ...') of user extras, PHI keys masked."""
+        attrs = record.__dict__
+        size = len(attrs)
+        if size <= _PLAIN_RECORD_SIZE or (size == _PLAIN_RECORD_SIZE + 1 and "service" in attrs):
+            if not record.stack_info:
+                return b""
+        extra = {}
+        if record.stack_info:
+            extra["stack_info"] = record.stack_info
+        for key, value in attrs.items():
+            if key not in _RESERVED:
+                extra[key] = MASKED_PHI if key in self.phi_fields else value
+        if not extra:
+            return b""
+        return json.dumps(extra, default=str)[1:-1].encode()
+
+    def emit(self, record: logging.LogRecord) -> None:
+        try:
+            message = record.getMessage().encode("utf-8", "surrogatepass")
+            exc = b""
+            if record.exc_info:
+                exc = _formatter.formatException(record.exc_info).encode("utf-8", "surrogatepass")
+            elif record.exc_text:
+                exc = record.exc_text.encode("utf-8", "surrogatepass")
+            service = str(getattr(record, "service", None) or "unknown").encode("utf-8", "surrogatepass")
+            extra = self._extra(record)
+            if self.overflow is not None and not _fits(service, extra, message, exc):
+                self._write_inline(record)
+                return
+            self.sink.submit(int(record.created * 1_000_000), record.levelno, service, extra, message, exc)
+        except Exception:
+            self.handleError(record)
+
+    def _write_inline(self, record: logging.LogRecord) -> None:
+        line = (self.overflow.format(record) + "\n").encode("utf-8", "surrogatepass")
+        self.sink.flush()
+        while line:
+            line = line[os.write(self.sink.fd, line):]
+
+    def flush(self) -> None:
+        self.sink.flush()
+
+
+def _fits(service: bytes, extra: bytes, message: bytes, exc: bytes) -> bool:
+    """Whether a record fits a slot whole (the native side's cut-off rules)."""
+    room = SLOT_TEXT_BYTES - min(len(service), MAX_SERVICE_BYTES)
+    if len(extra) > room // 2:
+        return False
+    return len(extra) + len(message) + len(exc) <= room
+
+
+# ============================================================================
+# HOT-PATH SITES
+# ============================================================================
+
+class LogSite:
+    """Admission for one call site: every Nth record and/or rate per second.
+
+    allow() returns None to drop the record, else how many were dropped
+    since the last one kept.
+    """
+
+    def __init__(self, per_second: float = 0.0, burst: float = 1.0, sample_every: int = 1):
+        self._id = load_library().pm_log_site_new(per_second, burst, sample_every)
+        if self._id < 0:
+            raise OSError("log site table is full")
+        self._allow = _lib.pm_log_site_allow
+
+    def allow(self) -> Optional[int]:
+        suppressed = self._allow(self._id)
+        return None if suppressed < 0 else suppressed
+
+    def allow_at(self, now_ns: int) -> Optional[int]:
+        """allow() at an explicit monotonic time, for tests."""
+        suppressed = _lib.pm_log_site_allow_at(self._id, now_ns)
+        return None if suppressed < 0 else suppressed
+
+
+class PyLogSite:
+    """Pure-Python LogSite (same algorithm), for when the library is missing."""
+
+    def __init__(self, per_second: float = 0.0, burst: float = 1.0, sample_every: int = 1):
+        self._interval = int(1e9 / per_second) if per_second > 0 else 0
+        self._tolerance = self._interval * int(max(burst - 1, 0))
+        self._sample_every = max(int(sample_every), 1)
+        self._lock = threading.Lock()
+        self._tat = None
+        self._seen = 0
+        self._suppressed = 0
+
+    def allow(self) -> Optional[int]:
+        return self.allow_at(time.monotonic_ns())
+
+    def allow_at(self, now_ns: int) -> Optional[int]:
+        with self._lock:
+            if self._sample_every > 1:
+                seen = self._seen
+                self._seen += 1
+                if seen % self._sample_every:
+                    self._suppressed += 1
+                    return None
+            if self._interval:
+                start = now_ns if self._tat is None else max(self._tat, now_ns)
+                if start - now_ns > self._tolerance:
+                    self._suppressed += 1
+                    return None
+                self._tat = start + self._interval
+            suppressed, self._suppressed = self._suppressed, 0
+            return suppressed
@@ -0,0 +1,308 @@
+"""AES-256-GCM for PHI at rest: a rotating keyring and batch seal/open.
+
+Keyring holds the service secrets, newest first: the newest seals, every
+one still opens. Each secret has a short key id, stored with whatever it
+sealed, so rotating is adding a secret at the front (ENCRYPTION_KEYS) and
+retiring the old one once nothing sealed under it is kept.
+
+seal_batch() and open_batch() take (key, nonce, aad, data) jobs. With the
+native library (shared/native/PhiCrypto.h) a batch is one ctypes call that
+releases the GIL and spreads large batches across cores; without it the
+same jobs run through cryptography's AESGCM one at a time. Both use
+OpenSSL's AES-NI/PCLMUL code underneath and produce identical output.
+
+PhiCipher seals self-describing tokens:
+
+    version (1) | key id (4) | nonce (12) | ciphertext | tag (16)
+
+Build the library with `make -C services/shared/native`, or point
+PULSEMIND_PHI_CRYPTO_LIB at a prebuilt libphi_crypto.so.
+"""
+
+import ctypes
+import hashlib
+import os
+from array import array
+from itertools import accumulate
+from typing import Dict, Iterable, List, NamedTuple, Optional, Sequence, Tuple
+
+from cryptography.exceptions import InvalidTag
+from cryptography.hazmat.primitives import hashes
+from cryptography.hazmat.primitives.ciphers.aead import AESGCM
+from cryptography.hazmat.primitives.kdf.hkdf import HKDF
+
+DEFAULT_LIBRARY_PATH = os.path.join(
+    os.path.dirname(os.path.abspath(__file__)), "native", "build", "libphi_crypto.so"
+)
+LIBRARY_PATH = os.getenv("PULSEMIND_PHI_CRYPTO_LIB", DEFAULT_LIBRARY_PATH)
+
+ABI_VERSION = 1
+
+KEY_SIZE = 32
+KEY_ID_SIZE = 4
+NONCE_SIZE = 12
+TAG_SIZE = 16
+
+TOKEN_VERSION = 1
+TOKEN_HEADER_SIZE = 1 + KEY_ID_SIZE + NONCE_SIZE
+
+# Below this many jobs a batch is cheaper through AESGCM than through ctypes
+NATIVE_MIN_BATCH = 4
+
+# Worker threads for native batches (0: one per core)
+THREADS = int(os.getenv("PULSEMIND_PHI_CRYPTO_THREADS", "0"))
+
+_STATUS_OK = 0
+
+# (key, nonce, associated data, plaintext or ciphertext-plus-tag)
+Job = Tuple[bytes, bytes, bytes, bytes]
+
+
+_lib: Optional[ctypes.CDLL] = None
+
+
+def load_library(path: str = LIBRARY_PATH) -> ctypes.CDLL:
+    """Load and type the native library (cached after the first call).
+
+    Raises:
+        OSError: If the library is missing or has an incompatible ABI
+    """
+    global _lib
+    if _lib is not None:
+        return _lib
+
+    lib = ctypes.CDLL(path)
+    lib.pm_phi_abi_version.restype = ctypes.c_uint32
+    if lib.pm_phi_abi_version() != ABI_VERSION:
+        raise OSError(f"Unsupported PHI crypto ABI version {lib.pm_phi_abi_version()}")
+
+    for fn in (lib.pm_phi_seal, lib.pm_phi_open):
+        fn.argtypes = [
+            ctypes.c_char_p, ctypes.c_uint32, ctypes.c_void_p, ctypes.c_char_p,
+            ctypes.c_char_p, ctypes.c_void_p, ctypes.c_char_p, ctypes.c_void_p,
+            ctypes.c_uint64, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_uint32,
+        ]
+        fn.restype = ctypes.c_int64
+
+    _lib = lib
+    return lib
+
+
+def is_available(path: str = LIBRARY_PATH) -> bool:
+    """Return True if the native library can be loaded."""
+    try:
+        load_library(path)
+        return True
+    except OSError:
+        return False
+
+
+# ============================================================================
+# BATCHES
+# ============================================================================
+
+_aesgcm_cache: Dict[bytes, AESGCM] = {}
+
+
+def _aesgcm(key: bytes) -> AESGCM:
+    cipher = _aesgcm_cache.get(key)
+    if cipher is None:
+        if len(_aesgcm_cache) > 256:
+            _aesgcm_cache.clear()
+        cipher = _aesgcm_cache[key] = AESGCM(key)
+    return cipher
+
+
+def _address(buffer) -> int:
+    return ctypes.addressof(ctypes.c_char.from_buffer(buffer)) if len(buffer) else 0
+
+
+def _run_native(jobs: Sequence[Job], encrypt: bool) -> Tuple[bytearray, List[int], array]:
+    """One native call over all jobs: (output, output offsets, statuses)."""
+    key_ids: Dict[bytes, int] = {}
+    key_index = array("I", (key_ids.setdefault(key, len(key_ids)) for key, _, _, _ in jobs))
+    keys = b"".join(key_ids)
+    nonces = b"".join(nonce for _, nonce, _, _ in jobs)
+    aad = b"".join(a for _, _, a, _ in jobs)
+    aad_offsets = array("Q", accumulate((len(a) for _, _, a, _ in jobs), initial=0))
+    data = b"".join(d for _, _, _, d in jobs)
+    in_offsets = array("Q", accumulate((len(d) for _, _, _, d in jobs), initial=0))
+    n = len(jobs)
+    # Each output is its input plus (seal) or minus (open) one tag
+    delta = TAG_SIZE if encrypt else -TAG_SIZE
+    out_offsets = [offset + i * delta for i, offset in enumerate(in_offsets)]
+    out = bytearray(max(out_offsets[-1], 0))
+    status = array("i", bytes(4 * n))
+
+    fn = _lib.pm_phi_seal if encrypt else _lib.pm_phi_open
+    failed = fn(
+        keys, len(key_ids), key_index.buffer_info()[0], nonces,
+        aad if aad else None, aad_offsets.buffer_info()[0], data, in_offsets.buffer_info()[0],
+        n, _address(out), status.buffer_info()[0], THREADS,
+    )
+    if failed < 0:
+        raise ValueError("Malformed PHI crypto batch")
+    return out, out_offsets, status
+
+
+def _check_jobs(jobs: Sequence[Job], encrypt: bool) -> None:
+    for key, nonce, _, data in jobs:
+        if len(key) != KEY_SIZE or len(nonce) != NONCE_SIZE:
+            raise ValueError("PHI crypto needs 32-byte keys and 12-byte nonces")
+        if not encrypt and len(data) < TAG_SIZE:
+            raise ValueError("Ciphertext shorter than the GCM tag")
+
+
+def seal_batch(jobs: Sequence[Job]) -> List[bytes]:
+    """Encrypt every job; each result is ciphertext followed by the tag."""
+    _check_jobs(jobs, True)
+    if len(jobs) < NATIVE_MIN_BATCH or not is_available():
+        return [_aesgcm(key).encrypt(nonce, data, aad or None) for key, nonce, aad, data in jobs]
+    out, offsets, _ = _run_native(jobs, True)
+    view = memoryview(out)
+    return [bytes(view[offsets[i]:offsets[i + 1]]) for i in range(len(jobs))]
+
+
+def open_batch(jobs: Sequence[Job]) -> List[Optional[bytes]]:
+    """Decrypt and authenticate every job; None where authentication failed."""
+    _check_jobs(jobs, False)
+    if len(jobs) < NATIVE_MIN_BATCH or not is_available():
+        results: List[Optional[bytes]] = []
+        for key, nonce, aad, data in jobs:
+            try:
+                results.append(_aesgcm(key).decrypt(nonce, data, aad or None))
+            except InvalidTag:
+                results.append(None)
+        return results
+    out, offsets, status = _run_native(jobs, False)
+    view = memoryview(out)
+    return [
+        bytes(view[offsets[i]:offsets[i + 1]]) if status[i] == _STATUS_OK else None
+        for i in range(len(jobs))
+    ]
+
+
+def seal(key: bytes, nonce: bytes, data: bytes, aad: bytes = b"") -> bytes:
+    """Encrypt one record (ciphertext followed by the tag)."""
+    return seal_batch([(key, nonce, aad, data)])[0]
+
+
+def open_sealed(key: bytes, nonce: bytes, data: bytes, aad: bytes = b"") -> bytes:
+    """Decrypt one record.
+
+    Raises:
+        InvalidTag: If the key, nonce, data or associated data do not match
+    """
+    plaintext = open_batch([(key, nonce, aad, data)])[0]
+    if plaintext is None:
+        raise InvalidTag()
+    return plaintext
+
+
+# ============================================================================
+# KEYS
+# ============================================================================
+
+class KeyringEntry(NamedTuple):
+    """One service secret and what is derived from it."""
+    key_id: bytes
+    secret: bytes
+    token_key: bytes
+
+
+def derive_key(secret: bytes, info: bytes) -> bytes:
+    """A 256-bit key for one purpose (info) from a service secret (HKDF-SHA256)."""
+    return HKDF(algorithm=hashes.SHA256(), length=KEY_SIZE, salt=None, info=info).derive(secret)
+
+
+def key_id_for(secret: bytes) -> bytes:
+    """Short public identifier of a secret (not usable to recover it)."""
+    return hashlib.sha256(b"pulsemind-phi/key-id/" + secret).digest()[:KEY_ID_SIZE]
+
+
+class Keyring:
+    """Service secrets, newest first; the newest seals, all of them open."""
+
+    def __init__(self, secrets: Iterable[bytes]):
+        self.entries: List[KeyringEntry] = []
+        self._by_id: Dict[bytes, KeyringEntry] = {}
+        for secret in secrets:
+            entry = KeyringEntry(key_id_for(secret), secret, derive_key(secret, b"pulsemind-phi/token"))
+            if entry.key_id in self._by_id:
+                continue
+            self.entries.append(entry)
+            self._by_id[entry.key_id] = entry
+        if not self.entries:
+            raise ValueError("Keyring needs at least one secret")
+
+    @classmethod
+    def from_strings(cls, secrets: Iterable[str]) -> "Keyring":
+        return cls(secret.encode() for secret in secrets)
+
+    @property
+    def current(self) -> KeyringEntry:
+        return self.entries[0]
+
+    def get(self, key_id: bytes) -> Optional[KeyringEntry]:
+        return self._by_id.get(key_id)
+
+
+# ============================================================================
+# TOKENS
+# ============================================================================
+
+class PhiCipher:
+    """Seals and opens self-describing PHI tokens under a Keyring."""
+
+    def __init__(self, keyring: Keyring):
+        self.keyring = keyring
+
+    def seal_many(self, plaintexts: Sequence[bytes], aad: bytes = b"") -> List[bytes]:
+        """Seal each plaintext under the current key, in one batch."""
+        entry = self.keyring.current
+        prefix = bytes([TOKEN_VERSION]) + entry.key_id
+        # Random nonces: one urandom call for the whole batch
+        nonces = os.urandom(NONCE_SIZE * len(plaintexts))
+        headers = [prefix + nonces[i:i + NONCE_SIZE] for i in range(0, len(nonces), NONCE_SIZE)]
+        # The token header is authenticated along with the caller's data
+        sealed = seal_batch([
+            (entry.token_key, header[1 + KEY_ID_SIZE:], header + aad, plaintext)
+            for header, plaintext in zip(headers, plaintexts)
+        ])
+        return [header + body for header, body in zip(headers, sealed)]
+
+    def open_many(self, tokens: Sequence[bytes], aad: bytes = b"") -> List[Optional[bytes]]:
+        """Open each token, in one batch; None for unknown keys or failed tokens."""
+        jobs = []
+        positions = []
+        for i, token in enumerate(tokens):
+            if len(token) < TOKEN_HEADER_SIZE + TAG_SIZE or token[0] != TOKEN_VERSION:
+                continue
+            entry = self.keyring.get(token[1:1 + KEY_ID_SIZE])
+            if entry is None:
+                continue
+            header = token[:TOKEN_HEADER_SIZE]
+            jobs.append((entry.token_key, header[1 + KEY_ID_SIZE:], header + aad, token[TOKEN_HEADER_SIZE:]))
+            positions.append(i)
+        results: List[Optional[bytes]] = [None] * len(tokens)
+        for i, plaintext in zip(positions, open_batch(jobs)):
+            results[i] = plaintext
+        return results
+
+    def seal(self, plaintext: bytes, aad: bytes = b"") -> bytes:
+        return self.seal_many([plaintext], aad)[0]
+
+    def open(self, token: bytes, aad: bytes = b"") -> bytes:
+        """Open one token.
+
+        Raises:
+            InvalidTag: If the token is malformed, tampered with or its key is unknown
+        """
+        plaintext = self.open_many([token], aad)[0]
+        if plaintext is None:
+            raise InvalidTag()
+        return plaintext
+
+    def is_current(self, token: bytes) -> bool:
+        """Whether a token is sealed under the current key."""
+        return token[1:1 + KEY_ID_SIZE] == self.keyring.current.key_id
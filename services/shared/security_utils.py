@@ -1,14 +1,26 @@
+import base64
+import json
 import os
 import jwt
 from datetime import datetime, timedelta
-from typing import Dict, Optional
-from cryptography.fernet import Fernet
+from functools import wraps
+from typing import Dict, List, Optional, Sequence
+from cryptography.fernet import Fernet, MultiFernet
+
+try:
+    from . import jwt_verify, phi_crypto
+except ImportError:  # Imported as a top-level module
+    import jwt_verify
+    import phi_crypto
 
 # Security Constants
 # CRITICAL: In production, these MUST be loaded from environment variables.
 JWT_SECRET = os.getenv("JWT_SECRET")
 JWT_ALGORITHM = "HS256"
-ENCRYPTION_KEY = os.getenv("ENCRYPTION_KEY")
+# Key rotation: ENCRYPTION_KEYS lists secrets newest first (comma-separated).
+# The newest encrypts; older ones are kept only to decrypt what they sealed.
+ENCRYPTION_KEYS = [key.strip() for key in os.getenv("ENCRYPTION_KEYS", "").split(",") if key.strip()]
+ENCRYPTION_KEY = ENCRYPTION_KEYS[0] if ENCRYPTION_KEYS else os.getenv("ENCRYPTION_KEY")
 
 if not JWT_SECRET or not ENCRYPTION_KEY:
     # Allow a fallback for development ONLY if explicitly permitted
@@ -21,7 +33,49 @@ if not JWT_SECRET or not ENCRYPTION_KEY:
             "System cannot start in clinical mode without these keys."
         )
 
-cipher_suite = Fernet(ENCRYPTION_KEY.encode())
+if not ENCRYPTION_KEYS:
+    ENCRYPTION_KEYS = [ENCRYPTION_KEY]
+
+# PHI is sealed with AES-256-GCM (phi_crypto): one operation per record,
+# batched across records where callers have many
+phi_keyring = phi_crypto.Keyring.from_strings(ENCRYPTION_KEYS)
+phi_cipher = phi_crypto.PhiCipher(phi_keyring)
+
+DECRYPTION_FAILED = "[DECRYPTION_FAILED]"
+
+# Access tokens are verified natively where available and cached until they
+# expire, so a session's repeated requests skip signature checks entirely
+access_token_verifier = jwt_verify.TokenVerifier(JWT_SECRET.encode())
+
+_legacy_cipher: Optional[MultiFernet] = None
+
+
+def _legacy_fernet() -> Optional[MultiFernet]:
+    """Fernet over the keyring, for tokens written before AES-GCM (None if no key is a Fernet key)."""
+    global _legacy_cipher
+    if _legacy_cipher is None:
+        ciphers = []
+        for key in ENCRYPTION_KEYS:
+            try:
+                ciphers.append(Fernet(key.encode()))
+            except ValueError:
+                continue
+        if not ciphers:
+            return None
+        _legacy_cipher = MultiFernet(ciphers)
+    return _legacy_cipher
+
+
+def _encode_token(token: bytes) -> str:
+    return base64.urlsafe_b64encode(token).decode()
+
+
+def _decode_token(encrypted_data: str) -> Optional[bytes]:
+    try:
+        return base64.urlsafe_b64decode(encrypted_data.encode())
+    except ValueError:
+        return None
+
 
 def create_access_token(data: dict, expires_delta: Optional[timedelta] = None) -> str:
     """Create a new JWT access token."""
@@ -36,27 +90,110 @@ def create_access_token(data: dict, expires_delta: Optional[timedelta] = None) -
     return encoded_jwt
 
 def decode_access_token(token: str) -> Optional[Dict]:
-    """Decode and validate a JWT access token."""
-    try:
-        decoded_token = jwt.decode(token, JWT_SECRET, algorithms=[JWT_ALGORITHM])
-        return decoded_token if decoded_token["exp"] >= datetime.utcnow().timestamp() else None
-    except Exception:
-        return None
+    """Decode and validate a JWT access token (None if invalid or expired)."""
+    return access_token_verifier.decode(token)
+
+def require_access_token(*roles: str):
+    """Flask route decorator: require a valid bearer access token.
+
+    The same check as the gateway's get_current_user, for write endpoints
+    that services expose directly. With roles, the token's role must be one
+    of them.
+    """
+    def decorator(view):
+        @wraps(view)
+        def wrapper(*args, **kwargs):
+            from flask import jsonify, request
+
+            scheme, _, token = request.headers.get("Authorization", "").partition(" ")
+            payload = decode_access_token(token.strip()) if scheme.lower() == "bearer" else None
+            if not payload:
+                return (jsonify({"success": False, "error": "Invalid or expired token"}), 401,
+                        {"WWW-Authenticate": "Bearer"})
+            if roles and payload.get("role") not in roles:
+                return jsonify({"success": False, "error": "Insufficient role"}), 403
+            return view(*args, **kwargs)
+        return wrapper
+    return decorator
 
 def encrypt_data(data: str) -> str:
-    """Encrypt sensitive data using AES-256 (Fernet)."""
+    """Encrypt sensitive data using AES-256-GCM under the current key."""
     if not data:
         return ""
-    return cipher_suite.encrypt(data.encode()).decode()
+    return _encode_token(phi_cipher.seal(data.encode()))
 
 def decrypt_data(encrypted_data: str) -> str:
-    """Decrypt data using AES-256 (Fernet)."""
+    """Decrypt data from encrypt_data (or a legacy Fernet token)."""
     if not encrypted_data:
         return ""
+    return decrypt_many([encrypted_data])[0]
+
+def encrypt_many(values: Sequence[str]) -> List[str]:
+    """Encrypt many values in one batch (empty values stay empty)."""
+    present = [i for i, value in enumerate(values) if value]
+    tokens = phi_cipher.seal_many([values[i].encode() for i in present])
+    results = [""] * len(values)
+    for i, token in zip(present, tokens):
+        results[i] = _encode_token(token)
+    return results
+
+def decrypt_many(encrypted_values: Sequence[str]) -> List[str]:
+    """Decrypt many values in one batch; DECRYPTION_FAILED for any that do not open."""
+    results = [""] * len(encrypted_values)
+    tokens = {}
+    for i, value in enumerate(encrypted_values):
+        if not value:
+            continue
+        token = _decode_token(value)
+        if token and token[0] == phi_crypto.TOKEN_VERSION:
+            tokens[i] = token
+        else:
+            results[i] = _decrypt_legacy(value)
+    opened = phi_cipher.open_many(list(tokens.values()))
+    for i, plaintext in zip(tokens, opened):
+        try:
+            results[i] = DECRYPTION_FAILED if plaintext is None else plaintext.decode()
+        except UnicodeDecodeError:
+            results[i] = DECRYPTION_FAILED
+    return results
+
+def _decrypt_legacy(encrypted_data: str) -> str:
+    legacy = _legacy_fernet()
+    if legacy is None:
+        return DECRYPTION_FAILED
     try:
-        return cipher_suite.decrypt(encrypted_data.encode()).decode()
+        return legacy.decrypt(encrypted_data.encode()).decode()
     except Exception:
-        return "[DECRYPTION_FAILED]"
+        return DECRYPTION_FAILED
+
+def encrypt_record(record: Dict) -> str:
+    """Encrypt a whole record (all of its PHI fields) in one operation."""
+    return encrypt_many([json.dumps(record, separators=(",", ":"))])[0]
+
+def decrypt_record(encrypted_record: str) -> Optional[Dict]:
+    """Decrypt a record from encrypt_record (None if it does not decrypt)."""
+    plaintext = decrypt_data(encrypted_record)
+    if plaintext == DECRYPTION_FAILED:
+        return None
+    return json.loads(plaintext)
+
+def rotate_encrypted(encrypted_values: Sequence[str]) -> List[str]:
+    """Re-encrypt values under the current key (unchanged if they already are).
+
+    Values that do not decrypt are returned unchanged; retire a key only once
+    rotation leaves nothing sealed under it.
+    """
+    results = list(encrypted_values)
+    stale = []
+    for i, value in enumerate(encrypted_values):
+        token = _decode_token(value) if value else None
+        if token is None or token[:1] != bytes([phi_crypto.TOKEN_VERSION]) or not phi_cipher.is_current(token):
+            stale.append(i)
+    plaintexts = decrypt_many([encrypted_values[i] for i in stale])
+    readable = [(i, text) for i, text in zip(stale, plaintexts) if text and text != DECRYPTION_FAILED]
+    for (i, _), value in zip(readable, encrypt_many([text for _, text in readable])):
+        results[i] = value
+    return results
 
 def anonymize_id(user_id: str) -> str:
     """Simple hash-based anonymization for logging."""
@@ -0,0 +1,80 @@
+"""Tests for the pixel-budget downsampling bindings."""
+
+import math
+import os
+import sys
+import unittest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+from shared import downsample  # noqa: E402
+
+
+@unittest.skipUnless(
+    downsample.is_available(),
+    "downsample library not built (make -C services/shared/native)"
+)
+class TestDownsample(unittest.TestCase):
+    """Test LTTB and min/max decimation against their definitions."""
+
+    def setUp(self):
+        # 60 s of 100 Hz PPG-like signal with one spike and one dropout
+        self.x = [i * 0.01 for i in range(6000)]
+        self.y = [2048 + 300 * math.sin(2 * math.pi * 1.2 * t) for t in self.x]
+        self.y[1234] = 4000.0
+        self.y[4321] = 100.0
+
+    def test_small_inputs_unchanged(self):
+        """Test inputs within the budget are returned as is."""
+        for mode in downsample.MODES:
+            self.assertEqual(downsample.downsample(mode, [0, 1, 2], [5, 6, 7], 10), ([0, 1, 2], [5, 6, 7]))
+            self.assertEqual(downsample.downsample(mode, [], [], 10), ([], []))
+
+    def test_lttb(self):
+        """Test LTTB keeps the end points and returns exactly the budget, in order."""
+        x, y = downsample.downsample("lttb", self.x, self.y, 500)
+        self.assertEqual(len(x), 500)
+        self.assertEqual((x[0], y[0]), (self.x[0], self.y[0]))
+        self.assertEqual((x[-1], y[-1]), (self.x[-1], self.y[-1]))
+        self.assertEqual(x, sorted(x))
+        self.assertIn(4000.0, y)  # A lone spike forms the largest triangle
+        self.assertIn(100.0, y)
+        points = dict(zip(self.x, self.y))
+        self.assertTrue(all(points[xi] == yi for xi, yi in zip(x, y)))
+
+    def test_min_max_envelope(self):
+        """Test every pixel column keeps its lowest and highest sample."""
+        x, y = downsample.downsample("minmax", self.x, self.y, 200)
+        self.assertLessEqual(len(x), 200)
+        self.assertEqual(x, sorted(x))
+        self.assertEqual(max(y), 4000.0)
+        self.assertEqual(min(y), 100.0)
+        width = (self.x[-1] - self.x[0]) / 100
+        for column in range(100):
+            inside = [yi for xi, yi in zip(self.x, self.y) if column == min(99, int(xi / width))]
+            kept = [yi for xi, yi in zip(x, y) if column == min(99, int(xi / width))]
+            self.assertEqual((min(kept), max(kept)), (min(inside), max(inside)))
+
+    def test_min_max_of_buckets(self):
+        """Test separate low/high inputs decimate rollup buckets."""
+        x, y = downsample.downsample("minmax", [0, 1, 2, 3], [1, 2, 0, 3], 2, high=[5, 9, 4, 6])
+        self.assertEqual((x, y), ([1, 2], [9, 0]))  # In x order
+
+    def test_numpy_input(self):
+        """Test numpy arrays of any dtype are accepted."""
+        import numpy as np
+        x, y = downsample.downsample("lttb", np.arange(1000), np.arange(1000, dtype=np.int32), 10)
+        self.assertEqual(len(x), 10)
+        self.assertEqual(y[-1], 999.0)
+
+    def test_invalid_arguments(self):
+        """Test unknown modes, mismatched lengths and empty budgets."""
+        with self.assertRaises(ValueError):
+            downsample.downsample("mean", [0], [0], 10)
+        with self.assertRaises(ValueError):
+            downsample.downsample("lttb", [0, 1], [0], 10)
+        with self.assertRaises(ValueError):
+            downsample.downsample("minmax", [0], [0], 0)
+
+
+if __name__ == "__main__":
+    unittest.main()
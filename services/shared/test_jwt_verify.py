@@ -0,0 +1,148 @@
+"""Tests for HS256 token verification and the verified-token cache."""
+
+import os
+import sys
+import time
+import unittest
+from unittest import mock
+
+import jwt
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+from shared import jwt_verify  # noqa: E402
+from shared import security_utils  # noqa: E402
+
+SECRET = b"test-secret-" + b"s" * 56
+
+
+def token(exp_in=600, secret=SECRET, algorithm="HS256", **claims):
+    if exp_in is not None:
+        claims["exp"] = int(time.time()) + exp_in
+    return jwt.encode(claims, secret, algorithm=algorithm)
+
+
+def verifiers():
+    """The pure-Python verifier, and the native one when the library is built."""
+    found = [jwt_verify.Hs256Verifier(SECRET, native=False)]
+    if jwt_verify.is_available():
+        found.append(jwt_verify.Hs256Verifier(SECRET, native=True))
+    return found
+
+
+class TestVerifier(unittest.TestCase):
+    """Test both verifiers accept what PyJWT accepts and reject the rest."""
+
+    def test_matches_pyjwt(self):
+        """Test claims of PyJWT-signed tokens decode identically on both paths."""
+        for claims in ({"sub": "dr-7"}, {"sub": "n-1", "roles": ["nurse"], "x": "é" * 300}, {"nbf": 0}):
+            signed = token(**claims)
+            expected = jwt.decode(signed, SECRET, algorithms=["HS256"])
+            for verifier in verifiers():
+                self.assertEqual(verifier.verify(signed), expected)
+
+    @unittest.skipUnless(jwt_verify.is_available(), "JWT library not built (make -C services/shared/native)")
+    def test_native_is_used(self):
+        """Test the default verifier uses the native library when it is built."""
+        self.assertTrue(jwt_verify.Hs256Verifier(SECRET).native)
+
+    def test_rejections(self):
+        """Test forged, tampered, mis-algorithm and expired tokens are all rejected."""
+        good = token(sub="dr-7")
+        header, payload, signature = good.split(".")
+        forged_payload = jwt.encode({"sub": "admin", "exp": 2 ** 40}, SECRET).split(".")[1]
+        unsigned = jwt.encode({"sub": "dr-7", "exp": 2 ** 40}, None, algorithm="none")
+        bad = [
+            token(sub="dr-7", secret=b"other-" + SECRET),
+            f"{header}.{forged_payload}.{signature}",
+            good[:-1] + ("A" if good[-1] != "A" else "B"),
+            good + "=",
+            unsigned,
+            token(sub="dr-7", algorithm="HS512"),
+            token(sub="dr-7", exp_in=-1),
+            token(exp_in=None, sub="dr-7"),
+            token(sub="dr-7", nbf=int(time.time()) + 300),
+            "not.a.token", "", "é.é.é", None,
+        ]
+        for verifier in verifiers():
+            for candidate in bad:
+                self.assertIsNone(verifier.verify(candidate), candidate)
+
+    def test_expiry_uses_now(self):
+        """Test a token is valid strictly before exp."""
+        signed = token(sub="dr-7", exp_in=None, exp=1000)
+        for verifier in verifiers():
+            self.assertIsNotNone(verifier.verify(signed, now=999.5))
+            self.assertIsNone(verifier.verify(signed, now=1000))
+
+
+class TestTokenCache(unittest.TestCase):
+    """Test cache hits, expiry and the size bound."""
+
+    def test_repeat_requests_skip_verification(self):
+        """Test a token is verified once and then served from the cache."""
+        verifier = jwt_verify.TokenVerifier(SECRET)
+        signed = token(sub="dr-7")
+        with mock.patch.object(verifier.verifier, "verify", wraps=verifier.verifier.verify) as verify:
+            first = verifier.decode(signed)
+            for _ in range(50):
+                self.assertEqual(verifier.decode(signed), first)
+        self.assertEqual(verify.call_count, 1)
+        self.assertEqual(verifier.cache.stats()["hits"], 50)
+
+        # Callers get copies; changing one does not change the cache
+        first["sub"] = "someone else"
+        self.assertEqual(verifier.decode(signed)["sub"], "dr-7")
+
+    def test_invalid_tokens_are_not_cached(self):
+        """Test rejected tokens never enter the cache."""
+        verifier = jwt_verify.TokenVerifier(SECRET)
+        for _ in range(3):
+            self.assertIsNone(verifier.decode(token(sub="x", secret=b"wrong-" + SECRET)))
+        self.assertEqual(len(verifier.cache), 0)
+
+    def test_expired_entries_are_dropped(self):
+        """Test a cached token stops being served at its exp."""
+        cache = jwt_verify.TokenCache()
+        cache.put("t", {"sub": "dr-7", "exp": 100}, 100, now=50)
+        self.assertEqual(cache.get("t", now=99)["sub"], "dr-7")
+        self.assertIsNone(cache.get("t", now=100))
+        self.assertEqual(len(cache), 0)
+
+    def test_bounded_expired_first(self):
+        """Test a full cache drops expired tokens before live ones, then the oldest."""
+        cache = jwt_verify.TokenCache(max_entries=8, shards=1)
+        for i in range(4):
+            cache.put(f"short-{i}", {}, 10, now=0)
+        for i in range(4):
+            cache.put(f"long-{i}", {}, 1000, now=0)
+        cache.put("new", {}, 1000, now=20)
+        self.assertEqual(len(cache), 5)
+        self.assertIsNotNone(cache.get("long-0", now=20))
+        for i in range(5):
+            cache.put(f"more-{i}", {}, 1000, now=20)
+        self.assertEqual(len(cache), 8)
+        self.assertIsNone(cache.get("long-0", now=20))
+        self.assertIsNotNone(cache.get("more-4", now=20))
+        self.assertEqual(cache.stats()["evictions"], 6)
+
+        sharded = jwt_verify.TokenCache(max_entries=64, shards=16)
+        for i in range(1000):
+            sharded.put(f"token-{i}", {}, 1000, now=0)
+        self.assertLessEqual(len(sharded), 64)
+
+
+class TestSecurityUtils(unittest.TestCase):
+    """Test the gateway-facing helpers."""
+
+    def test_access_token_round_trip(self):
+        """Test tokens from create_access_token decode; expired ones do not."""
+        from datetime import timedelta
+        signed = security_utils.create_access_token({"sub": "dr-7", "role": "clinician"})
+        self.assertEqual(security_utils.decode_access_token(signed)["role"], "clinician")
+        expired = security_utils.create_access_token({"sub": "dr-7"}, expires_delta=timedelta(seconds=-5))
+        self.assertIsNone(security_utils.decode_access_token(expired))
+        self.assertIsNone(security_utils.decode_access_token("garbage"))
+
+
+if __name__ == "__main__":
+    unittest.main()
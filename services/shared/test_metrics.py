@@ -0,0 +1,207 @@
+"""Tests for the metrics registries, their exposition text and the /metrics routes."""
+
+import os
+import sys
+import threading
+import unittest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+from shared import metrics  # noqa: E402
+
+
+def _populate(registry):
+    """The same series and samples in any registry."""
+    requests = registry.counter("test_requests_total", "Requests\nserved", route="/a\\b", note='say "hi"')
+    requests.inc()
+    requests.inc(4)
+    registry.counter("test_requests_total", route="/c").store(12)
+    depth = registry.gauge("test_queue_depth", "Queue depth")
+    depth.set(2.5)
+    depth.dec(4)
+    latency = registry.histogram("test_latency_seconds", "Latency", operation="x")
+    for us in (0, 1, 2, 5, 17, 300, 3000, 70_000_000, 1 << 40):
+        latency.observe_us(us)
+    latency.observe(0.25)
+
+
+class TestHistogramLayout(unittest.TestCase):
+    """Test bucket arithmetic matches Metrics.h."""
+
+    def test_buckets_cover_values(self):
+        for us in list(range(0, 300)) + [1000, 4096, 4097, 10**6, 1 << 35, (1 << 36) - 1]:
+            b = metrics.histogram_bucket(us)
+            self.assertLessEqual(us, metrics.histogram_bound(b), us)
+            if b > 0:
+                self.assertGreater(us, metrics.histogram_bound(b - 1), us)
+        self.assertEqual(metrics.histogram_bucket(1 << 40), metrics.HISTOGRAM_BUCKETS - 1)
+
+    def test_relative_error(self):
+        # 8 buckets per power of two keep a bound within 12.5% of every value it holds
+        for b in range(metrics.HISTOGRAM_SUB_BUCKETS, metrics.HISTOGRAM_BUCKETS):
+            low, high = metrics.histogram_bound(b - 1), metrics.histogram_bound(b)
+            self.assertLessEqual((high - low) / (low + 1), 0.125, b)
+
+
+class TestPyRegistry(unittest.TestCase):
+    """Test series semantics and the text exposition."""
+
+    def setUp(self):
+        self.registry = metrics.PyRegistry()
+
+    def test_exposition(self):
+        _populate(self.registry)
+        text = self.registry.render().decode()
+        self.assertIn("# HELP test_requests_total Requests\\nserved\n# TYPE test_requests_total counter\n", text)
+        self.assertIn('test_requests_total{route="/a\\\\b",note="say \\"hi\\""} 5\n', text)
+        self.assertIn('test_requests_total{route="/c"} 12\n', text)
+        self.assertIn("test_queue_depth -1.5\n", text)
+        self.assertIn('test_latency_seconds_bucket{operation="x",le="0.000001"} 2\n', text)
+        self.assertIn('test_latency_seconds_bucket{operation="x",le="0.000004"} 3\n', text)
+        self.assertIn('test_latency_seconds_bucket{operation="x",le="0.262144"} 8\n', text)
+        self.assertIn('test_latency_seconds_bucket{operation="x",le="67.108864"} 8\n', text)
+        self.assertIn('test_latency_seconds_bucket{operation="x",le="+Inf"} 10\n', text)
+        self.assertIn('test_latency_seconds_count{operation="x"} 10\n', text)
+        # One HELP/TYPE per family, families in registration order
+        self.assertEqual(text.count("# TYPE test_requests_total"), 1)
+        self.assertLess(text.index("test_requests_total"), text.index("test_latency_seconds"))
+
+    def test_registration_is_idempotent(self):
+        first = self.registry.counter("test_total", kind="a")
+        first.inc()
+        self.registry.counter("test_total", kind="a").inc()
+        self.assertEqual(first.value, 2)
+        self.assertEqual(self.registry.stats()["series"], 1)
+
+    def test_refuses_invalid_and_conflicting(self):
+        self.registry.counter("test_total")
+        for register in (
+            lambda: self.registry.gauge("test_total"),
+            lambda: self.registry.counter("1starts_with_digit"),
+            lambda: self.registry.counter("has-dash"),
+            lambda: self.registry.histogram("test_seconds", le="1"),
+            lambda: self.registry.counter("test_total", help="x" * (metrics.MAX_HELP_BYTES + 1)),
+        ):
+            with self.assertRaises(ValueError):
+                register()
+        self.assertEqual(self.registry.stats()["rejected"], 5)
+
+    def test_out_of_cells(self):
+        registry = metrics.PyRegistry(cells=1)
+        registry.histogram("test_seconds")
+        with self.assertRaises(ValueError):
+            registry.histogram("test_seconds", other="series")
+
+    def test_quantiles(self):
+        latency = self.registry.histogram("test_seconds")
+        self.assertEqual(latency.quantile(0.5), 0.0)
+        for ms in range(1, 101):
+            latency.observe(ms / 1000)
+        self.assertEqual(latency.count, 100)
+        self.assertAlmostEqual(latency.sum, 5.05)
+        # Bucket bounds are within 12.5% above the exact value
+        for q, exact in ((0.5, 0.050), (0.99, 0.099), (1.0, 0.100)):
+            self.assertGreaterEqual(latency.quantile(q), exact)
+            self.assertLessEqual(latency.quantile(q), exact * 1.125)
+
+    def test_collectors(self):
+        gauge = self.registry.gauge("test_collected")
+        values = iter([7, 8])
+        self.registry.add_collector(lambda: gauge.set(next(values)))
+        self.registry.add_collector(lambda: 1 / 0)
+        self.assertIn(b"test_collected 7\n", self.registry.exposition())
+        self.assertIn(b"test_collected 8\n", self.registry.exposition())
+
+
+@unittest.skipUnless(metrics.is_available(), "metrics library not built (make -C services/shared/native)")
+class TestNativeRegistry(unittest.TestCase):
+    """Test the native registry against the Python one."""
+
+    def test_matches_python(self):
+        native, python = metrics.NativeRegistry(), metrics.PyRegistry()
+        _populate(native)
+        _populate(python)
+        self.assertEqual(native.render(), python.render())
+        self.assertEqual(native.stats(), python.stats())
+        native_latency = native.histogram("test_latency_seconds", operation="x")
+        python_latency = python.histogram("test_latency_seconds", operation="x")
+        for q in (0.0, 0.5, 0.9, 1.0):
+            self.assertEqual(native_latency.quantile(q), python_latency.quantile(q))
+
+    def test_render_grows_buffer(self):
+        registry = metrics.NativeRegistry(cells=1 << 17)
+        for i in range(400):
+            registry.histogram("test_seconds", route=f"/r{i}").observe(0.001)
+        text = registry.render()
+        self.assertEqual(text.count(b"test_seconds_count"), 400)
+        self.assertTrue(text.endswith(b'test_seconds_count{route="/r399"} 1\n'))
+
+    def test_concurrent_recording(self):
+        registry = metrics.NativeRegistry()
+        counter = registry.counter("test_total")
+        latency = registry.histogram("test_seconds")
+
+        def work():
+            for _ in range(2000):
+                counter.inc()
+                latency.observe_us(10)
+
+        threads = [threading.Thread(target=work) for _ in range(4)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        self.assertEqual((counter.value, latency.count, latency.sum), (8000, 8000, 0.08))
+
+
+class TestFrameworks(unittest.TestCase):
+    """Test request metrics and the /metrics routes."""
+
+    def test_flask(self):
+        try:
+            from flask import Flask
+        except ImportError:
+            self.skipTest("flask not installed")
+        app = Flask(__name__)
+        registry = metrics.instrument_flask(app, "test-service", metrics.PyRegistry())
+
+        @app.route("/items/<int:item>", methods=["POST"])
+        def item(item):
+            return {"item": item}
+
+        client = app.test_client()
+        client.post("/items/1")
+        client.post("/items/2")
+        client.get("/missing")
+        response = client.get("/metrics")
+        self.assertEqual(response.status_code, 200)
+        self.assertEqual(response.content_type, metrics.CONTENT_TYPE)
+        text = response.get_data(as_text=True)
+        self.assertIn('pulsemind_http_requests_total{service="test-service",method="POST",'
+                      'route="/items/<int:item>",status="200"} 2\n', text)
+        self.assertIn('route="<unmatched>",status="404"} 1\n', text)
+        self.assertIn('pulsemind_http_request_duration_seconds_count{service="test-service",method="POST",'
+                      'route="/items/<int:item>"} 2\n', text)
+        self.assertEqual(registry.stats()["rejected"], 0)
+
+    def test_fastapi(self):
+        try:
+            from fastapi import FastAPI
+            from fastapi.testclient import TestClient
+        except (ImportError, RuntimeError):
+            self.skipTest("fastapi test client not installed")
+        app = FastAPI()
+        metrics.instrument_fastapi(app, "test-gateway", metrics.PyRegistry())
+
+        @app.get("/items/{item}")
+        async def item(item: int):
+            return {"item": item}
+
+        client = TestClient(app)
+        client.get("/items/3")
+        text = client.get("/metrics").text
+        self.assertIn('pulsemind_http_requests_total{service="test-gateway",method="GET",'
+                      'route="/items/{item}",status="200"} 1\n', text)
+
+
+if __name__ == "__main__":
+    unittest.main()
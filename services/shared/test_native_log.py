@@ -0,0 +1,274 @@
+"""Tests for the native logging ring and hot-path log sites."""
+
+import json
+import logging
+import os
+import subprocess
+import sys
+import tempfile
+import unittest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+from shared import logger as pm_logger  # noqa: E402
+from shared import native_log  # noqa: E402
+
+
+def _capture_logger(name, handler):
+    logger = logging.getLogger(name)
+    logger.propagate = False
+    logger.handlers = [handler]
+    logger.setLevel(logging.DEBUG)
+    return logger
+
+
+@unittest.skipUnless(
+    native_log.is_available(),
+    "log ring library not built (make -C services/shared/native)"
+)
+class TestRingHandler(unittest.TestCase):
+    """Test the native path writes the same lines as CustomJsonFormatter."""
+
+    def setUp(self):
+        fd, self.path = tempfile.mkstemp()
+        self.fd = fd
+        self.sink = native_log.LogSink(fd, pm_logger.PHI_FIELDS)
+        self.formatter = pm_logger.CustomJsonFormatter('%(timestamp)s %(level)s %(service)s %(message)s')
+
+        self.expected = []
+        formatter = self.formatter
+        expected = self.expected
+
+        class Reference(logging.Handler):
+            def emit(self, record):
+                expected.append(formatter.format(record))
+
+        self.handler = native_log.RingHandler(self.sink, pm_logger.PHI_FIELDS, overflow=self.formatter)
+        self.logger = _capture_logger("test-native-log", self.handler)
+        self.logger.addHandler(Reference())
+        self.adapter = logging.LoggerAdapter(self.logger, {"service": "test-service"})
+
+    def tearDown(self):
+        self.sink.close()
+        os.close(self.fd)
+        os.unlink(self.path)
+
+    def _lines(self):
+        self.assertTrue(self.sink.flush())
+        with open(self.path, encoding="utf-8") as f:
+            return f.read().splitlines()
+
+    def test_matches_python_formatter(self):
+        """Test native output equals CustomJsonFormatter byte for byte."""
+        self.adapter.info("hello %s", "world")
+        self.adapter.warning('unicode \u00e9 \u6f22 \U0001F600, control \x01\x1f, "quotes" \\')
+        self.adapter.info("with extras", extra={"count": 2, "items": [1, "a"], "nested": {"k": None}})
+        self.logger.log(25, "custom level, no service")
+        try:
+            raise ValueError("boom")
+        except ValueError:
+            self.adapter.exception("failed")
+        self.adapter.info("after")
+
+        lines = self._lines()
+        self.assertEqual(len(lines), 6)
+        self.assertEqual(lines, self.expected)
+        for line in lines:
+            json.loads(line)
+
+    def test_phi_redaction(self):
+        """Test PHI in the message is redacted (any case) and PHI extras masked."""
+        self.adapter.info("lookup for Patient_ID 1234")
+        self.logger.info("ok", extra={"service": "test-service", "ssn": "123-45-6789", "site": "icu"})
+        self.adapter.info("nothing sensitive")
+
+        lines = self._lines()
+        self.assertEqual(lines, self.expected)
+        records = [json.loads(line) for line in lines]
+        self.assertEqual(records[0]["message"], "[REDACTED_POTENTIAL_PHI]")
+        self.assertEqual(records[1]["ssn"], native_log.MASKED_PHI)
+        self.assertEqual(records[1]["site"], "icu")
+        self.assertEqual(records[2]["message"], "nothing sensitive")
+        self.assertNotIn("1234", "".join(lines))
+        self.assertEqual(self.sink.stats()["redacted"], 1)
+
+    def test_oversized_written_inline(self):
+        """Test records too big for a slot are written whole, in order."""
+        self.adapter.info("before")
+        self.adapter.error("with stack", stack_info=True)
+        self.adapter.info("x" * 5000)
+        self.adapter.info("after")
+
+        lines = self._lines()
+        self.assertEqual(lines, self.expected)
+        self.assertEqual(len(json.loads(lines[2])["message"]), 5000)
+        self.assertEqual(self.sink.stats()["written"], 2)
+
+    def test_long_message_truncated(self):
+        """Test without an overflow formatter oversized records are cut and flagged."""
+        self.handler.overflow = None
+        self.adapter.info("x" * 5000)
+        record = json.loads(self._lines()[0])
+        self.assertTrue(record["truncated"])
+        self.assertLess(len(record["message"]), 1024)
+        self.assertEqual(self.sink.stats()["truncated"], 1)
+
+    def test_full_ring_drops(self):
+        """Test a full ring drops records instead of blocking, and says so."""
+        fd, path = tempfile.mkstemp()
+        sink = native_log.LogSink(fd, pm_logger.PHI_FIELDS, capacity=4)
+        try:
+            accepted = sum(sink.submit(0, logging.INFO, b"s", b"", b"m", b"") for _ in range(10000))
+            self.assertTrue(sink.flush())
+            stats = sink.stats()
+            self.assertEqual(stats["submitted"], accepted)
+            self.assertEqual(stats["submitted"] + stats["dropped"], 10000)
+            self.assertGreater(stats["dropped"], 0)
+            self.assertGreaterEqual(stats["written"], accepted)
+            with open(path) as f:
+                self.assertIn("log ring full", f.read())
+        finally:
+            sink.close()
+            os.close(fd)
+            os.unlink(path)
+        self.assertFalse(sink.submit(0, logging.INFO, b"s", b"", b"m", b""))
+
+
+class TestLogSite(unittest.TestCase):
+    """Test hot-path admission: sampling, rate limiting and suppressed counts."""
+
+    SECOND = 1_000_000_000
+
+    def _sites(self, *args):
+        sites = [native_log.PyLogSite(*args)]
+        if native_log.is_available():
+            sites.append(native_log.LogSite(*args))
+        return sites
+
+    def test_sampling(self):
+        """Test every Nth record is kept and reports the ones skipped."""
+        for site in self._sites(0.0, 1.0, 4):
+            results = [site.allow_at(0) for _ in range(9)]
+            self.assertEqual(results, [0, None, None, None, 3, None, None, None, 3])
+
+    def test_rate_limit(self):
+        """Test a burst is admitted, then one record per interval."""
+        for site in self._sites(10.0, 3.0, 1):
+            burst = [site.allow_at(0) for _ in range(5)]
+            self.assertEqual(burst, [0, 0, 0, None, None])
+            # 100 ms later exactly one more record is due
+            self.assertEqual(site.allow_at(self.SECOND // 10), 2)
+            self.assertIsNone(site.allow_at(self.SECOND // 10))
+            # After a quiet period the burst is available again
+            later = [site.allow_at(10 * self.SECOND) for _ in range(4)]
+            self.assertEqual(later, [1, 0, 0, None])
+
+    def test_native_and_python_agree(self):
+        """Test both sites admit the same records on an irregular schedule."""
+        if not native_log.is_available():
+            self.skipTest("log ring library not built")
+        python_site, native_site = self._sites(50.0, 5.0, 2)
+        now = 0
+        for i in range(2000):
+            now += (i * 7919) % 13_000_000
+            self.assertEqual(python_site.allow_at(now), native_site.allow_at(now))
+
+
+class TestHotPathLogger(unittest.TestCase):
+    """Test HotPathLogger skips formatting and reports suppressed records."""
+
+    def setUp(self):
+        self.records = []
+        records = self.records
+
+        class Collect(logging.Handler):
+            def emit(self, record):
+                records.append(record)
+
+        self.logger = _capture_logger("test-hot-path", Collect())
+        self.adapter = logging.LoggerAdapter(self.logger, {"service": "test-service"})
+
+    def test_suppressed_count(self):
+        """Test dropped records are never formatted and are counted on the next."""
+        rendered = []
+
+        class Arg:
+            def __str__(self):
+                rendered.append(1)
+                return "arg"
+
+        hot = pm_logger.hot_path_logger(self.adapter, sample_every=3)
+        for _ in range(7):
+            hot.info("value %s", Arg())
+        for record in self.records:
+            record.getMessage()
+
+        self.assertEqual(len(self.records), 3)
+        self.assertEqual(len(rendered), 3)
+        self.assertEqual(self.records[0].service, "test-service")
+        self.assertFalse(hasattr(self.records[0], "suppressed"))
+        self.assertEqual([r.suppressed for r in self.records[1:]], [2, 2])
+
+    def test_disabled_level_not_counted(self):
+        """Test records below the logger level do not use the site's budget."""
+        hot = pm_logger.hot_path_logger(self.adapter, sample_every=2)
+        self.logger.setLevel(logging.INFO)
+        for _ in range(5):
+            hot.debug("hidden")
+        hot.info("shown")
+        self.assertEqual(len(self.records), 1)
+        self.assertFalse(hasattr(self.records[0], "suppressed"))
+
+
+class TestSetupLogger(unittest.TestCase):
+    """Test setup_logger end to end in a child process writing to stdout."""
+
+    SCRIPT = (
+        "import os, sys\n"
+        "sys.path.insert(0, {services!r})\n"
+        "from shared.logger import setup_logger, _get_ring_handler\n"
+        "log = setup_logger('svc-a')\n"
+        "print('native' if _get_ring_handler() else 'python', flush=True)\n"
+        "log.info('parent %s', 1)\n"
+        "pid = os.fork()\n"
+        "if pid == 0:\n"
+        "    log.info('child')\n"
+        "    os._exit(0 if _get_ring_handler() is None or _get_ring_handler().sink.flush() else 1)\n"
+        "os.waitpid(pid, 0)\n"
+        "setup_logger('svc-b').warning('ssn 123')\n"
+    )
+
+    def _run(self, native_env):
+        env = dict(os.environ, PULSEMIND_NATIVE_LOG=native_env)
+        script = self.SCRIPT.format(services=os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+        result = subprocess.run(
+            [sys.executable, "-c", script], env=env, capture_output=True, text=True, timeout=30
+        )
+        self.assertEqual(result.returncode, 0, result.stderr)
+        mode, *lines = result.stdout.splitlines()
+        return mode, sorted((json.loads(line) for line in lines), key=lambda r: (r["service"], r["message"]))
+
+    def _check(self, records):
+        self.assertEqual(
+            [(r["service"], r["level"], r["message"]) for r in records],
+            [("svc-a", "INFO", "child"), ("svc-a", "INFO", "parent 1"),
+             ("svc-b", "WARNING", "[REDACTED_POTENTIAL_PHI]")]
+        )
+        for record in records:
+            self.assertRegex(record["timestamp"], r"^\d{4}-\d\d-\d\dT\d\d:\d\d:\d\d\.\d{6}Z$")
+
+    @unittest.skipUnless(native_log.is_available(), "log ring library not built")
+    def test_native_path(self):
+        """Test the shared ring handler is used, including after fork."""
+        mode, records = self._run("1")
+        self.assertEqual(mode, "native")
+        self._check(records)
+
+    def test_python_fallback(self):
+        """Test PULSEMIND_NATIVE_LOG=0 formats in-line with the same output."""
+        mode, records = self._run("0")
+        self.assertEqual(mode, "python")
+        self._check(records)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,153 @@
+"""Tests for AES-GCM PHI encryption, batching and key rotation."""
+
+import os
+import sys
+import unittest
+from unittest import mock
+
+from cryptography.exceptions import InvalidTag
+from cryptography.fernet import Fernet
+from cryptography.hazmat.primitives.ciphers.aead import AESGCM
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+from shared import phi_crypto  # noqa: E402
+from shared import security_utils  # noqa: E402
+
+
+def jobs(count, size=200):
+    keys = [bytes([k]) * phi_crypto.KEY_SIZE for k in range(1, 4)]
+    return [
+        (keys[i % 3], i.to_bytes(phi_crypto.NONCE_SIZE, "little"), b"aad-%d" % i if i % 2 else b"",
+         os.urandom(size + i))
+        for i in range(count)
+    ]
+
+
+class TestBatches(unittest.TestCase):
+    """Test batch seal/open against AESGCM, natively and in the fallback."""
+
+    def setUp(self):
+        self.jobs = jobs(50)
+
+    def reference(self):
+        return [AESGCM(key).encrypt(nonce, data, aad or None) for key, nonce, aad, data in self.jobs]
+
+    def test_fallback_matches_aesgcm(self):
+        """Test the pure-Python path seals and opens like AESGCM."""
+        with mock.patch.object(phi_crypto, "is_available", return_value=False):
+            sealed = phi_crypto.seal_batch(self.jobs)
+            self.assertEqual(sealed, self.reference())
+            opened = phi_crypto.open_batch([(k, n, a, c) for (k, n, a, _), c in zip(self.jobs, sealed)])
+        self.assertEqual(opened, [data for _, _, _, data in self.jobs])
+
+    @unittest.skipUnless(
+        phi_crypto.is_available(),
+        "PHI crypto library not built (make -C services/shared/native)"
+    )
+    def test_native_matches_aesgcm(self):
+        """Test one native call over mixed keys equals record-at-a-time AESGCM."""
+        sealed = phi_crypto.seal_batch(self.jobs)
+        self.assertEqual(sealed, self.reference())
+        opened = phi_crypto.open_batch([(k, n, a, c) for (k, n, a, _), c in zip(self.jobs, sealed)])
+        self.assertEqual(opened, [data for _, _, _, data in self.jobs])
+
+    def test_tampering_is_reported_per_record(self):
+        """Test a tampered record fails alone, on either path."""
+        sealed = self.reference()
+        sealed[7] = bytes([sealed[7][0] ^ 1]) + sealed[7][1:]
+        opens = [(k, n, a, c) for (k, n, a, _), c in zip(self.jobs, sealed)]
+        opens[9] = (opens[9][0], opens[9][1], b"other aad", opens[9][3])
+        for native in (False, True):
+            if native and not phi_crypto.is_available():
+                continue
+            with mock.patch.object(phi_crypto, "is_available", return_value=native):
+                opened = phi_crypto.open_batch(opens)
+            self.assertIsNone(opened[7])
+            self.assertIsNone(opened[9])
+            self.assertEqual(opened[8], self.jobs[8][3])
+        with self.assertRaises(InvalidTag):
+            phi_crypto.open_sealed(*opens[7][:2], opens[7][3], opens[7][2])
+
+    def test_bad_jobs_rejected(self):
+        """Test malformed keys, nonces and ciphertexts raise instead of reaching the cipher."""
+        with self.assertRaises(ValueError):
+            phi_crypto.seal_batch([(b"short", bytes(12), b"", b"x")])
+        with self.assertRaises(ValueError):
+            phi_crypto.open_batch([(bytes(32), bytes(12), b"", b"too short")])
+
+
+class TestTokens(unittest.TestCase):
+    """Test self-describing tokens and key rotation."""
+
+    def test_round_trip_and_rotation(self):
+        """Test tokens open under any keyring holding their secret."""
+        old = phi_crypto.PhiCipher(phi_crypto.Keyring([b"old-secret"]))
+        token = old.seal(b"patient 17", aad=b"field")
+        self.assertEqual(len(token), phi_crypto.TOKEN_HEADER_SIZE + len(b"patient 17") + phi_crypto.TAG_SIZE)
+        self.assertEqual(old.open(token, aad=b"field"), b"patient 17")
+        with self.assertRaises(InvalidTag):
+            old.open(token, aad=b"other field")
+
+        rotated = phi_crypto.PhiCipher(phi_crypto.Keyring([b"new-secret", b"old-secret"]))
+        self.assertEqual(rotated.open(token, aad=b"field"), b"patient 17")
+        self.assertFalse(rotated.is_current(token))
+        self.assertTrue(rotated.is_current(rotated.seal(b"x")))
+
+        retired = phi_crypto.PhiCipher(phi_crypto.Keyring([b"new-secret"]))
+        self.assertEqual(retired.open_many([token, b"junk"]), [None, None])
+
+    def test_nonces_are_unique(self):
+        """Test sealing the same value twice gives different tokens."""
+        cipher = phi_crypto.PhiCipher(phi_crypto.Keyring([b"secret"]))
+        tokens = cipher.seal_many([b"same"] * 100)
+        self.assertEqual(len(set(tokens)), 100)
+        self.assertEqual(cipher.open_many(tokens), [b"same"] * 100)
+
+
+class TestSecurityUtils(unittest.TestCase):
+    """Test the service-facing helpers, including legacy Fernet tokens."""
+
+    def test_encrypt_decrypt(self):
+        """Test values and whole records round-trip; failures are reported."""
+        token = security_utils.encrypt_data("123-45-6789")
+        self.assertNotIn("6789", token)
+        self.assertEqual(security_utils.decrypt_data(token), "123-45-6789")
+        self.assertEqual(security_utils.encrypt_data(""), "")
+        self.assertEqual(security_utils.decrypt_data("garbage!"), security_utils.DECRYPTION_FAILED)
+
+        record = {"patient_id": "p-17", "ssn": "123-45-6789", "hsi_score": 71.5}
+        self.assertEqual(security_utils.decrypt_record(security_utils.encrypt_record(record)), record)
+
+    def test_batches_keep_positions(self):
+        """Test batch helpers keep order and leave empty values empty."""
+        values = ["a", "", "ccc", "d" * 1000]
+        tokens = security_utils.encrypt_many(values)
+        self.assertEqual(tokens[1], "")
+        self.assertEqual(security_utils.decrypt_many(tokens), values)
+
+    def test_legacy_fernet_tokens(self):
+        """Test values encrypted with Fernet by earlier releases still decrypt."""
+        legacy = Fernet(security_utils.ENCRYPTION_KEY.encode()).encrypt(b"old payload").decode()
+        self.assertEqual(security_utils.decrypt_data(legacy), "old payload")
+        self.assertEqual(
+            security_utils.decrypt_many([legacy, security_utils.encrypt_data("new")]), ["old payload", "new"]
+        )
+
+    def test_rotate_encrypted(self):
+        """Test rotation re-encrypts legacy and old-key values under the current key."""
+        legacy = Fernet(security_utils.ENCRYPTION_KEY.encode()).encrypt(b"legacy").decode()
+        old = security_utils.encrypt_data("old")
+        keyring = phi_crypto.Keyring.from_strings(["rotated-secret", security_utils.ENCRYPTION_KEY])
+        with mock.patch.object(security_utils, "phi_keyring", keyring), \
+                mock.patch.object(security_utils, "phi_cipher", phi_crypto.PhiCipher(keyring)):
+            current = security_utils.encrypt_data("current")
+            rotated = security_utils.rotate_encrypted([legacy, old, current, "", "garbage!"])
+            self.assertEqual(rotated[2], current)
+            self.assertEqual(rotated[3:], ["", "garbage!"])
+            self.assertEqual(security_utils.decrypt_many(rotated[:3]), ["legacy", "old", "current"])
+            for value in rotated[:3]:
+                self.assertTrue(security_utils.phi_cipher.is_current(security_utils._decode_token(value)))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,224 @@
+"""Tests for trace context, span rings, Flask instrumentation and the trace report."""
+
+import io
+import json
+import os
+import sys
+import tempfile
+import unittest
+from contextlib import redirect_stdout
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+from shared import trace_report  # noqa: E402
+from shared import tracing  # noqa: E402
+
+# W3C Trace Context example
+TRACEPARENT = "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01"
+TRACE_ID = bytes.fromhex("4bf92f3577b34da6a3ce929d0e0e4736")
+
+
+def _spans(document: bytes):
+    """(service, span) pairs of one exported document."""
+    out = []
+    for resource in json.loads(document)["resourceSpans"]:
+        service = resource["resource"]["attributes"][0]["value"]["stringValue"]
+        for span in resource["scopeSpans"][0]["spans"]:
+            out.append((service, span))
+    return out
+
+
+class TestTraceContext(unittest.TestCase):
+    """Test traceparent parsing follows TraceRing.h."""
+
+    def test_round_trip(self):
+        ctx = tracing.parse_traceparent(TRACEPARENT)
+        self.assertEqual(ctx, tracing.TraceContext(TRACE_ID, 0x00f067aa0ba902b7, 1))
+        self.assertTrue(ctx.sampled)
+        self.assertEqual(tracing.format_traceparent(ctx), TRACEPARENT)
+
+    def test_rejects_invalid(self):
+        for value in (
+            "", None, TRACEPARENT[:-1], TRACEPARENT + "-extra", TRACEPARENT.upper(),
+            "ff" + TRACEPARENT[2:],
+            "00-00000000000000000000000000000000-00f067aa0ba902b7-01",
+            "00-4bf92f3577b34da6a3ce929d0e0e4736-0000000000000000-01",
+        ):
+            self.assertIsNone(tracing.parse_traceparent(value), value)
+        # Later versions may carry more fields
+        self.assertIsNotNone(tracing.parse_traceparent("01" + TRACEPARENT[2:] + "-extra"))
+
+
+class TestSpanRings(unittest.TestCase):
+    """Test the Python ring's documents and limits."""
+
+    SPANS = [
+        (TRACE_ID, 1, 0, 1000, 5, tracing.KIND_SERVER, tracing.STATUS_UNSET, b"svc-a", b"GET /x", b""),
+        (TRACE_ID, 2, 1, 1001, -3, tracing.KIND_CLIENT, tracing.STATUS_ERROR, "své\"".encode(), b"call",
+         tracing.format_attributes({"n": 1, "x": 2.5, "ok": True, "s": "a\"b", "zeros": "007", "e": "1e5"})),
+        (TRACE_ID, 3, 2, 1002, 7, tracing.KIND_INTERNAL, tracing.STATUS_OK, b"svc-a", b"x" * 80,
+         b"k=" + b"v" * 100 + b"\nk2=" + b"w" * 100),
+    ]
+
+    def test_document(self):
+        ring = tracing.PySpanRing()
+        for span in self.SPANS:
+            self.assertTrue(ring.record(*span))
+        spans = _spans(ring.drain())
+        self.assertEqual([(service, span["spanId"]) for service, span in spans], [
+            ("svc-a", "0000000000000001"), ("svc-a", "0000000000000003"), ("své\"", "0000000000000002"),
+        ])
+        root, cut, call = (span for _, span in spans)
+        self.assertNotIn("parentSpanId", root)
+        self.assertNotIn("status", root)
+        self.assertEqual((root["startTimeUnixNano"], root["endTimeUnixNano"]), ("1000000", "1005000"))
+        self.assertEqual(call["endTimeUnixNano"], call["startTimeUnixNano"])  # Negative duration clamped
+        self.assertEqual(call["status"], {"code": tracing.STATUS_ERROR})
+        self.assertEqual({a["key"]: a["value"] for a in call["attributes"]}, {
+            "n": {"intValue": "1"}, "x": {"doubleValue": 2.5}, "ok": {"boolValue": True},
+            "s": {"stringValue": "a\"b"}, "zeros": {"stringValue": "007"}, "e": {"stringValue": "1e5"},
+        })
+        # Name capped, attributes cut to whole lines
+        self.assertEqual(len(cut["name"]), tracing.MAX_NAME_BYTES)
+        self.assertEqual([a["key"] for a in cut["attributes"]], ["k"])
+        self.assertEqual(ring.stats()["truncated"], 1)
+        self.assertEqual(ring.drain(), b"")
+
+    def test_full_ring_drops(self):
+        ring = tracing.PySpanRing(capacity=2)
+        results = [ring.record(*self.SPANS[0]) for _ in range(3)]
+        self.assertEqual(results, [True, True, False])
+        self.assertEqual(ring.stats()["dropped"], 1)
+
+    @unittest.skipUnless(
+        tracing.is_available(),
+        "trace ring library not built (make -C services/shared/native)"
+    )
+    def test_native_matches_python(self):
+        """Test both rings export byte-identical documents."""
+        native, python = tracing.NativeSpanRing(), tracing.PySpanRing()
+        try:
+            for span in self.SPANS:
+                native.record(*span)
+                python.record(*span)
+            self.assertEqual(native.drain(), python.drain())
+            self.assertEqual(native.stats(), python.stats())
+        finally:
+            native.close()
+
+
+class TestTracer(unittest.TestCase):
+    """Test span nesting, sampling and propagation."""
+
+    def setUp(self):
+        self.ring = tracing.PySpanRing()
+        self.tracer = tracing.Tracer("test-service", self.ring)
+
+    def test_nesting_and_errors(self):
+        with self.tracer.span("outer", tracing.KIND_SERVER) as outer:
+            with self.tracer.span("inner", attributes={"k": 1}) as inner:
+                headers = self.tracer.inject()
+            with self.assertRaises(ValueError):
+                with self.tracer.span("failing"):
+                    raise ValueError("boom")
+        self.assertIsNone(tracing.current_context())
+        self.assertEqual(tracing.parse_traceparent(headers["traceparent"]), inner.context)
+
+        spans = {span["name"]: span for _, span in _spans(self.ring.drain())}
+        self.assertEqual(set(spans), {"outer", "inner", "failing"})
+        self.assertNotIn("parentSpanId", spans["outer"])
+        self.assertEqual(spans["inner"]["parentSpanId"], f"{outer.context.span_id:016x}")
+        self.assertEqual(spans["inner"]["traceId"], outer.context.trace_id.hex())
+        self.assertEqual(spans["failing"]["status"], {"code": tracing.STATUS_ERROR})
+
+    def test_continues_incoming_trace(self):
+        parent = tracing.parse_traceparent(TRACEPARENT)
+        with self.tracer.span("child", parent=parent):
+            pass
+        (_, span), = _spans(self.ring.drain())
+        self.assertEqual((span["traceId"], span["parentSpanId"]), (TRACE_ID.hex(), "00f067aa0ba902b7"))
+
+    def test_unsampled(self):
+        tracer = tracing.Tracer("test-service", self.ring, sample_ratio=0.0)
+        with tracer.span("root") as root:
+            headers = tracer.inject()
+        self.assertFalse(root.context.sampled)
+        self.assertTrue(headers["traceparent"].endswith("-00"))
+        self.assertEqual(self.ring.drain(), b"")
+
+    def test_disabled_passes_context_through(self):
+        tracer = tracing.Tracer("test-service")
+        with tracer.span("hop", parent=tracing.parse_traceparent(TRACEPARENT)):
+            self.assertEqual(tracer.inject(), {"traceparent": TRACEPARENT})
+        with tracer.span("no-parent"):
+            self.assertEqual(tracer.inject(), {})
+
+
+class TestExportAndReport(unittest.TestCase):
+    """Test file export and the loop breakdown over it."""
+
+    def test_flask_spans_and_report(self):
+        try:
+            from flask import Flask
+        except ImportError:
+            self.skipTest("flask not installed")
+        fd, path = tempfile.mkstemp()
+        os.close(fd)
+        try:
+            ring = tracing.PySpanRing()
+            tracer = tracing.Tracer("test-service", ring)
+            app = Flask(__name__)
+            tracing.instrument_flask(app, tracer)
+
+            @app.route("/items/<int:item>", methods=["POST"])
+            def item(item):
+                return {"traceparent": tracer.inject().get("traceparent")}
+
+            @app.route("/fail")
+            def fail():
+                return "no", 503
+
+            client = app.test_client()
+            body = client.post("/items/7", headers={"traceparent": TRACEPARENT}).get_json()
+            client.get("/fail")
+
+            # A device-reported loop in the same trace, as the ingest worker records it
+            for span_id, parent, name, start, end in (
+                (0x00f067aa0ba902b7, 0, "device.sample_to_actuation", 0, 400),
+                (0x11, 0x00f067aa0ba902b7, "ingest.queue", 30, 31),
+                (0x12, 0x00f067aa0ba902b7, "pipeline.analyze", 31, 41),
+                (0x13, 0x00f067aa0ba902b7, "policy.decide", 41, 42),
+                (0x14, 0x12, "command.dispatch", 42, 43),
+                (0x15, 0x14, "device.command_apply", 70, 72),
+                (0x16, 0x15, "device.pulse_wait", 72, 400),
+            ):
+                ring.record(TRACE_ID, span_id, parent, 10**9 + start * 1000, (end - start) * 1000,
+                            tracing.KIND_INTERNAL, tracing.STATUS_OK, b"esp32-firmware", name.encode(), b"")
+            exporter = tracing.SpanExporter(ring, path=path)
+            self.assertEqual(exporter.export(), 1)
+
+            spans = trace_report.load_spans([path])
+            server = {s["name"]: s for s in spans if s["service"] == "test-service"}
+            self.assertEqual(set(server), {"POST /items/<int:item>", "GET /fail"})
+            post = server["POST /items/<int:item>"]
+            self.assertEqual((post["trace_id"], post["parent_id"]), (TRACE_ID.hex(), "00f067aa0ba902b7"))
+            self.assertEqual(tracing.parse_traceparent(body["traceparent"]).span_id, int(post["span_id"], 16))
+            self.assertTrue(server["GET /fail"]["error"])
+
+            report = trace_report.build_report(spans)
+            loop = report["loop"]
+            self.assertEqual(loop["end_to_end"]["count"], 1)
+            self.assertEqual(loop["end_to_end"]["max_ms"], 400.0)
+            self.assertEqual(loop["stages"]["device.pulse_wait"]["p50_ms"], 328.0)
+            self.assertEqual(loop["residual"]["p50_ms"], 400 - (1 + 10 + 1 + 1 + 2 + 328))
+            self.assertEqual(report["stages"]["GET /fail"]["errors"], 1)
+
+            out = io.StringIO()
+            with redirect_stdout(out):
+                self.assertEqual(trace_report.main([path]), 0)
+            self.assertIn("closed loop (1 reported)", out.getvalue())
+        finally:
+            os.unlink(path)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,166 @@
+"""Latency breakdown from exported spans.
+
+Reads OTLP/JSON span lines (the ingest worker's --trace-file and the
+services' PULSEMIND_TRACE_FILE) and reports:
+
+  - per span name: count, errors and duration quantiles;
+  - the closed loop: for every trace the device reported on
+    (device.sample_to_actuation), the end-to-end latency, the time in each
+    loop stage and the residual no stage accounts for, i.e. MQTT transport
+    both ways plus clock skew between the device and the worker.
+
+Usage:
+    python trace_report.py spans.jsonl [more.jsonl ...] [--json]
+"""
+
+import argparse
+import json
+import math
+import sys
+from collections import defaultdict
+from typing import Dict, Iterable, List, Optional, Sequence
+
+LOOP_ROOT = "device.sample_to_actuation"
+
+# Stages of one loop iteration, in order; they do not overlap
+LOOP_STAGES = (
+    "ingest.queue",
+    "pipeline.analyze",
+    "policy.decide",
+    "command.dispatch",
+    "device.command_apply",
+    "device.pulse_wait",
+)
+
+QUANTILES = (0.50, 0.90, 0.99)
+
+
+def load_spans(paths: Iterable[str]) -> List[dict]:
+    """Flatten span lines into dicts with service, ids, times (ns) and status."""
+    spans = []
+    for path in paths:
+        with open(path, encoding="utf-8") as f:
+            for line in f:
+                if not line.strip():
+                    continue
+                for resource in json.loads(line).get("resourceSpans", []):
+                    service = "unknown"
+                    for attr in resource.get("resource", {}).get("attributes", []):
+                        if attr.get("key") == "service.name":
+                            service = attr["value"].get("stringValue", service)
+                    for scope in resource.get("scopeSpans", []):
+                        for span in scope.get("spans", []):
+                            spans.append({
+                                "service": service,
+                                "name": span["name"],
+                                "trace_id": span["traceId"],
+                                "span_id": span["spanId"],
+                                "parent_id": span.get("parentSpanId"),
+                                "start_ns": int(span["startTimeUnixNano"]),
+                                "end_ns": int(span["endTimeUnixNano"]),
+                                "error": span.get("status", {}).get("code") == 2,
+                            })
+    return spans
+
+
+def quantile(sorted_values: Sequence[float], q: float) -> float:
+    """Nearest-rank quantile of an ascending sequence."""
+    if not sorted_values:
+        return 0.0
+    rank = min(len(sorted_values) - 1, max(0, math.ceil(q * len(sorted_values)) - 1))
+    return sorted_values[rank]
+
+
+def _summary(values_ms: List[float]) -> Dict[str, float]:
+    values_ms = sorted(values_ms)
+    out = {"count": len(values_ms)}
+    for q in QUANTILES:
+        out[f"p{int(q * 100)}_ms"] = round(quantile(values_ms, q), 3)
+    out["max_ms"] = round(values_ms[-1], 3) if values_ms else 0.0
+    return out
+
+
+def _duration_ms(span: dict) -> float:
+    return (span["end_ns"] - span["start_ns"]) / 1e6
+
+
+def stage_summary(spans: List[dict]) -> Dict[str, dict]:
+    """Duration quantiles and error counts per span name."""
+    durations = defaultdict(list)
+    errors = defaultdict(int)
+    for span in spans:
+        durations[span["name"]].append(_duration_ms(span))
+        errors[span["name"]] += int(span["error"])
+    return {name: dict(_summary(values), errors=errors[name]) for name, values in sorted(durations.items())}
+
+
+def loop_summary(spans: List[dict]) -> Optional[dict]:
+    """End-to-end latency of reported loops and where it went; None without reports."""
+    by_trace = defaultdict(list)
+    for span in spans:
+        by_trace[span["trace_id"]].append(span)
+
+    end_to_end = []
+    stages = defaultdict(list)
+    residual = []
+    for trace_spans in by_trace.values():
+        roots = [s for s in trace_spans if s["name"] == LOOP_ROOT]
+        if not roots:
+            continue
+        total = _duration_ms(roots[0])
+        end_to_end.append(total)
+        accounted = 0.0
+        for stage in LOOP_STAGES:
+            spent = sum(_duration_ms(s) for s in trace_spans if s["name"] == stage)
+            stages[stage].append(spent)
+            accounted += spent
+        residual.append(total - accounted)
+    if not end_to_end:
+        return None
+    total_ms = sum(end_to_end)
+    return {
+        "end_to_end": _summary(end_to_end),
+        "stages": {
+            stage: dict(_summary(stages[stage]), share=round(sum(stages[stage]) / total_ms, 4) if total_ms else 0.0)
+            for stage in LOOP_STAGES
+        },
+        "residual": dict(_summary(residual), share=round(sum(residual) / total_ms, 4) if total_ms else 0.0),
+    }
+
+
+def build_report(spans: List[dict]) -> dict:
+    return {"spans": len(spans), "stages": stage_summary(spans), "loop": loop_summary(spans)}
+
+
+def format_report(report: dict) -> str:
+    lines = [f"{report['spans']} spans", "", f"{'span':<32} {'count':>7} {'errors':>6} "
+             f"{'p50 ms':>9} {'p90 ms':>9} {'p99 ms':>9} {'max ms':>9}"]
+    for name, s in report["stages"].items():
+        lines.append(f"{name:<32} {s['count']:>7} {s['errors']:>6} {s['p50_ms']:>9.3f} {s['p90_ms']:>9.3f} "
+                     f"{s['p99_ms']:>9.3f} {s['max_ms']:>9.3f}")
+    loop = report["loop"]
+    if loop is None:
+        lines += ["", "no device trace reports"]
+        return "\n".join(lines)
+    e2e = loop["end_to_end"]
+    lines += ["", f"closed loop ({e2e['count']} reported): sample to actuation p50 {e2e['p50_ms']:.1f} ms, "
+              f"p99 {e2e['p99_ms']:.1f} ms, max {e2e['max_ms']:.1f} ms",
+              f"{'stage':<32} {'share':>7} {'p50 ms':>9} {'p99 ms':>9}"]
+    for name, s in list(loop["stages"].items()) + [("(transport, unaccounted)", loop["residual"])]:
+        lines.append(f"{name:<32} {s['share'] * 100:>6.1f}% {s['p50_ms']:>9.3f} {s['p99_ms']:>9.3f}")
+    return "\n".join(lines)
+
+
+def main(argv: Optional[Sequence[str]] = None) -> int:
+    parser = argparse.ArgumentParser(description="Latency breakdown from exported spans")
+    parser.add_argument("paths", nargs="+", help="OTLP/JSON span line files")
+    parser.add_argument("--json", action="store_true", help="Print the report as JSON")
+    args = parser.parse_args(argv)
+
+    report = build_report(load_spans(args.paths))
+    print(json.dumps(report, indent=2) if args.json else format_report(report))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
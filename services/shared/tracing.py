@@ -0,0 +1,634 @@
+"""End-to-end latency tracing: W3C trace context and OTLP/JSON spans.
+
+A Tracer records finished spans into a span ring (shared/native/TraceRing.h
+through ctypes, or PySpanRing when the library is missing, which formats the
+same documents). A SpanExporter thread drains the ring every second as
+OTLP/JSON ExportTraceServiceRequest documents, appended as lines to
+PULSEMIND_TRACE_FILE and/or POSTed to PULSEMIND_OTLP_ENDPOINT + /v1/traces.
+
+Trace context arrives in the "traceparent" header; instrument_flask() opens a
+server span per request under it, and Tracer.inject() forwards the current
+context on outgoing calls. With neither destination configured the tracer
+is disabled: it records nothing but still passes incoming context through,
+so a trace survives an untraced hop.
+
+The ingest worker and firmware record the device side of the same traces
+(see services/ingest-worker); services/shared/trace_report.py summarizes
+span files.
+
+Build the library with `make -C services/shared/native`, or point
+PULSEMIND_TRACE_LIB at a prebuilt libtrace_ring.so.
+"""
+
+import atexit
+import contextlib
+import contextvars
+import ctypes
+import json
+import os
+import random
+import re
+import threading
+import time
+import urllib.request
+from collections import deque
+from typing import Dict, Iterator, List, Mapping, NamedTuple, Optional
+
+DEFAULT_LIBRARY_PATH = os.path.join(
+    os.path.dirname(os.path.abspath(__file__)), "native", "build", "libtrace_ring.so"
+)
+LIBRARY_PATH = os.getenv("PULSEMIND_TRACE_LIB", DEFAULT_LIBRARY_PATH)
+
+ABI_VERSION = 1
+
+TRACEPARENT_HEADER = "traceparent"
+FLAG_SAMPLED = 0x01
+
+# Ring slots; 0 takes the library default (8192)
+DEFAULT_CAPACITY = 0
+PY_DEFAULT_CAPACITY = 8192
+
+# Slot text bytes and caps (TraceRing.h)
+SLOT_TEXT_BYTES = 192
+MAX_SERVICE_BYTES = 48
+MAX_NAME_BYTES = 64
+
+EXPORT_BATCH_SPANS = 512
+EXPORT_INTERVAL_S = 1.0
+SCOPE_NAME = "pulsemind.trace"
+
+# OTLP SpanKind and status code
+KIND_INTERNAL = 1
+KIND_SERVER = 2
+KIND_CLIENT = 3
+KIND_PRODUCER = 4
+KIND_CONSUMER = 5
+
+STATUS_UNSET = 0
+STATUS_OK = 1
+STATUS_ERROR = 2
+
+
+class TraceStats(ctypes.Structure):
+    """Mirror of pulsemind::trace::TraceStats."""
+
+    _fields_ = [
+        ("recorded", ctypes.c_uint64),
+        ("dropped", ctypes.c_uint64),
+        ("exported", ctypes.c_uint64),
+        ("truncated", ctypes.c_uint64),
+    ]
+
+
+_lib: Optional[ctypes.CDLL] = None
+
+
+def load_library(path: str = LIBRARY_PATH) -> ctypes.CDLL:
+    """Load and type the native library (cached after the first call).
+
+    Raises:
+        OSError: If the library is missing or has an incompatible ABI
+    """
+    global _lib
+    if _lib is not None:
+        return _lib
+
+    lib = ctypes.CDLL(path)
+    lib.pm_trace_abi_version.restype = ctypes.c_uint32
+    if lib.pm_trace_abi_version() != ABI_VERSION:
+        raise OSError(f"Unsupported trace ring ABI version {lib.pm_trace_abi_version()}")
+
+    lib.pm_trace_open.argtypes = [ctypes.c_uint32]
+    lib.pm_trace_open.restype = ctypes.c_void_p
+    lib.pm_trace_record.argtypes = [
+        ctypes.c_void_p, ctypes.c_char_p, ctypes.c_uint64, ctypes.c_uint64,
+        ctypes.c_int64, ctypes.c_int64, ctypes.c_uint8, ctypes.c_uint8,
+        ctypes.c_char_p, ctypes.c_uint64, ctypes.c_char_p, ctypes.c_uint64,
+        ctypes.c_char_p, ctypes.c_uint64,
+    ]
+    lib.pm_trace_record.restype = ctypes.c_int32
+    lib.pm_trace_drain.argtypes = [ctypes.c_void_p, ctypes.c_uint64, ctypes.c_char_p, ctypes.c_uint64]
+    lib.pm_trace_drain.restype = ctypes.c_int64
+    lib.pm_trace_stats.argtypes = [ctypes.c_void_p, ctypes.POINTER(TraceStats)]
+    lib.pm_trace_stats.restype = None
+    lib.pm_trace_close.argtypes = [ctypes.c_void_p]
+    lib.pm_trace_close.restype = None
+
+    _lib = lib
+    return lib
+
+
+def is_available(path: str = LIBRARY_PATH) -> bool:
+    """Return True if the native library can be loaded."""
+    try:
+        load_library(path)
+        return True
+    except OSError:
+        return False
+
+
+# ============================================================================
+# TRACE CONTEXT
+# ============================================================================
+
+class TraceContext(NamedTuple):
+    """A span's identity as it propagates: 16-byte trace id, span id, flags."""
+
+    trace_id: bytes
+    span_id: int
+    flags: int
+
+    @property
+    def sampled(self) -> bool:
+        return bool(self.flags & FLAG_SAMPLED)
+
+
+_TRACEPARENT = re.compile(r"([0-9a-f]{2})-([0-9a-f]{32})-([0-9a-f]{16})-([0-9a-f]{2})(-.*)?")
+
+
+def parse_traceparent(value: Optional[str]) -> Optional[TraceContext]:
+    """Parse a traceparent header (TraceRing.h's rules); None if invalid."""
+    if not value:
+        return None
+    match = _TRACEPARENT.fullmatch(value.strip())
+    if match is None:
+        return None
+    version, trace_hex, span_hex, flags, rest = match.groups()
+    if version == "ff" or (version == "00" and rest):
+        return None
+    trace_id = bytes.fromhex(trace_hex)
+    span_id = int(span_hex, 16)
+    if not any(trace_id) or span_id == 0:
+        return None
+    return TraceContext(trace_id, span_id, int(flags, 16))
+
+
+def format_traceparent(ctx: TraceContext) -> str:
+    return f"00-{ctx.trace_id.hex()}-{ctx.span_id:016x}-{ctx.flags:02x}"
+
+
+def _new_span_id() -> int:
+    # random is reseeded in forked children; ids need uniqueness, not secrecy
+    return random.getrandbits(64) or 1  # nosec B311
+
+
+def _new_trace_id() -> bytes:
+    return (random.getrandbits(128) or 1).to_bytes(16, "big")  # nosec B311
+
+
+# ============================================================================
+# RINGS
+# ============================================================================
+
+def format_attributes(attributes: Mapping[str, object]) -> bytes:
+    """Encode attributes as the ring's "key=value" lines.
+
+    bool, int and float keep their type in the export; anything else is a
+    string. Keys lose '=' and newlines, values newlines.
+    """
+    lines = []
+    for key, value in attributes.items():
+        if value is None:
+            continue
+        if isinstance(value, bool):
+            text = "true" if value else "false"
+        elif isinstance(value, (int, float)):
+            text = repr(value)
+        else:
+            text = str(value).replace("\n", " ")
+        key = str(key).replace("=", "_").replace("\n", "_")
+        lines.append(f"{key}={text}")
+    return "\n".join(lines).encode("utf-8", "replace")
+
+
+class NativeSpanRing:
+    """The native span ring (TraceRing.h's SpanRing behind trace_capi.cpp)."""
+
+    def __init__(self, capacity: int = DEFAULT_CAPACITY):
+        lib = load_library()
+        self._ptr = lib.pm_trace_open(capacity)
+        if not self._ptr:
+            raise OSError("pm_trace_open failed")
+        self._record = lib.pm_trace_record
+        self._buffer = ctypes.create_string_buffer(256 * 1024)
+
+    def record(self, trace_id: bytes, span_id: int, parent_id: int, start_us: int, duration_us: int,
+               kind: int, status: int, service: bytes, name: bytes, attrs: bytes) -> bool:
+        """Queue one finished span; False if it was dropped (ring full or closed)."""
+        if not self._ptr:
+            return False
+        return bool(self._record(
+            self._ptr, trace_id, span_id, parent_id, start_us, duration_us, kind, status,
+            service, len(service), name, len(name), attrs, len(attrs)
+        ))
+
+    def drain(self, max_spans: int = EXPORT_BATCH_SPANS) -> bytes:
+        """Up to max_spans spans as one OTLP/JSON document; b"" when none are queued.
+
+        One consumer at a time (the exporter thread).
+        """
+        if not self._ptr:
+            return b""
+        n = _lib.pm_trace_drain(self._ptr, max_spans, self._buffer, len(self._buffer))
+        if n < 0:
+            self._buffer = ctypes.create_string_buffer(-n)
+            n = _lib.pm_trace_drain(self._ptr, max_spans, self._buffer, len(self._buffer))
+        return self._buffer.raw[:n]
+
+    def stats(self) -> Dict[str, int]:
+        stats = TraceStats()
+        if not self._ptr:
+            return {name: 0 for name, _ in TraceStats._fields_}
+        _lib.pm_trace_stats(self._ptr, ctypes.byref(stats))
+        return {name: getattr(stats, name) for name, _ in TraceStats._fields_}
+
+    def close(self) -> None:
+        """Free the ring; it must not be used afterwards."""
+        if self._ptr:
+            _lib.pm_trace_close(self._ptr)
+            self._ptr = None
+
+
+def _utf8_prefix(data: bytes, limit: int) -> bytes:
+    """The longest prefix of data within limit bytes not ending inside a UTF-8 sequence."""
+    if len(data) <= limit:
+        return data
+    return data[:limit].decode("utf-8", "ignore").encode("utf-8")
+
+
+_INTEGER = re.compile(r"-?(?:0|[1-9][0-9]{0,17})")
+_DECIMAL = re.compile(r"-?(?:0|[1-9][0-9]{0,17})\.[0-9]+")
+
+
+def _otlp_attributes(attrs: bytes) -> str:
+    """appendAttributes() of TraceRing.h."""
+    items = []
+    for line in attrs.decode("utf-8", "replace").split("\n"):
+        key, sep, value = line.partition("=")
+        if not sep or not key:
+            continue
+        if _INTEGER.fullmatch(value):
+            typed = f'"intValue":"{value}"'
+        elif _DECIMAL.fullmatch(value):
+            typed = f'"doubleValue":{value}'
+        elif value in ("true", "false"):
+            typed = f'"boolValue":{value}'
+        else:
+            typed = f'"stringValue":{json.dumps(value)}'
+        items.append(f'{{"key":{json.dumps(key)},"value":{{{typed}}}}}')
+    return '"attributes":[' + ",".join(items) + "]"
+
+
+class PySpanRing:
+    """Pure-Python span ring with the native ring's limits and output."""
+
+    def __init__(self, capacity: int = PY_DEFAULT_CAPACITY):
+        self._capacity = capacity or PY_DEFAULT_CAPACITY
+        self._spans = deque()
+        self._lock = threading.Lock()
+        self._stats = {name: 0 for name, _ in TraceStats._fields_}
+
+    def record(self, trace_id: bytes, span_id: int, parent_id: int, start_us: int, duration_us: int,
+               kind: int, status: int, service: bytes, name: bytes, attrs: bytes) -> bool:
+        service = _utf8_prefix(service, MAX_SERVICE_BYTES)
+        name = _utf8_prefix(name, MAX_NAME_BYTES)
+        room = SLOT_TEXT_BYTES - len(service) - len(name)
+        truncated = len(attrs) > room
+        if truncated:
+            attrs = attrs[:attrs.rfind(b"\n", 0, room) + 1]
+        with self._lock:
+            if len(self._spans) >= self._capacity:
+                self._stats["dropped"] += 1
+                return False
+            self._spans.append((trace_id, span_id, parent_id, start_us, max(duration_us, 0), kind, status,
+                                service, name, attrs))
+            self._stats["recorded"] += 1
+            self._stats["truncated"] += int(truncated)
+        return True
+
+    def drain(self, max_spans: int = EXPORT_BATCH_SPANS) -> bytes:
+        with self._lock:
+            batch = [self._spans.popleft() for _ in range(min(max_spans, len(self._spans)))]
+            self._stats["exported"] += len(batch)
+        if not batch:
+            return b""
+        by_service: Dict[bytes, List[str]] = {}
+        for trace_id, span_id, parent_id, start_us, duration_us, kind, status, service, name, attrs in batch:
+            span = f'{{"traceId":"{trace_id.hex()}","spanId":"{span_id:016x}"'
+            if parent_id:
+                span += f',"parentSpanId":"{parent_id:016x}"'
+            span += (f',"name":{json.dumps(name.decode("utf-8", "replace"))},"kind":{kind}'
+                     f',"startTimeUnixNano":"{start_us * 1000}"'
+                     f',"endTimeUnixNano":"{(start_us + duration_us) * 1000}"')
+            if attrs:
+                span += "," + _otlp_attributes(attrs)
+            if status != STATUS_UNSET:
+                span += f',"status":{{"code":{status}}}'
+            by_service.setdefault(service, []).append(span + "}")
+        resources = [
+            '{"resource":{"attributes":[{"key":"service.name","value":{"stringValue":'
+            f'{json.dumps(service.decode("utf-8", "replace"))}}}}}]}},"scopeSpans":[{{"scope":{{"name":'
+            f'"{SCOPE_NAME}"}},"spans":[' + ",".join(spans) + "]}]}"
+            for service, spans in by_service.items()
+        ]
+        return ('{"resourceSpans":[' + ",".join(resources) + "]}").encode()
+
+    def stats(self) -> Dict[str, int]:
+        with self._lock:
+            return dict(self._stats)
+
+    def close(self) -> None:
+        pass
+
+
+def open_span_ring(capacity: int = DEFAULT_CAPACITY):
+    """The native ring when the library is available, else a PySpanRing."""
+    if is_available():
+        try:
+            return NativeSpanRing(capacity)
+        except OSError:
+            pass
+    return PySpanRing(capacity)
+
+
+# ============================================================================
+# SPANS
+# ============================================================================
+
+_current: contextvars.ContextVar[Optional[TraceContext]] = contextvars.ContextVar(
+    "pulsemind_trace_context", default=None
+)
+
+
+def current_context() -> Optional[TraceContext]:
+    """Context of the span in progress in this thread or task, if any."""
+    return _current.get()
+
+
+class Span:
+    """A span in progress; end() records it (once) when it is sampled."""
+
+    __slots__ = ("_tracer", "name", "kind", "context", "parent_id", "start_us", "attributes", "status", "_ended")
+
+    def __init__(self, tracer: "Tracer", name: str, kind: int, context: Optional[TraceContext],
+                 parent_id: int, attributes: Optional[Mapping[str, object]]):
+        self._tracer = tracer
+        self.name = name
+        self.kind = kind
+        self.context = context
+        self.parent_id = parent_id
+        self.start_us = time.time_ns() // 1000
+        self.attributes = dict(attributes) if attributes else {}
+        self.status = STATUS_UNSET
+        self._ended = False
+
+    @property
+    def recording(self) -> bool:
+        return self._tracer.ring is not None and self.context is not None and self.context.sampled
+
+    def set_attribute(self, key: str, value: object) -> None:
+        self.attributes[key] = value
+
+    def set_error(self) -> None:
+        self.status = STATUS_ERROR
+
+    def end(self) -> None:
+        if self._ended:
+            return
+        self._ended = True
+        if self.recording:
+            self._tracer.record(self, time.time_ns() // 1000 - self.start_us)
+
+
+class Tracer:
+    """Starts spans for one service and records the sampled ones into ring.
+
+    ring None disables recording (context still propagates). Root spans are
+    sampled with probability sample_ratio; child spans follow their parent.
+    """
+
+    def __init__(self, service: str, ring=None, sample_ratio: float = 1.0):
+        self.service = service
+        self._service = service.encode("utf-8", "replace")
+        self.ring = ring
+        self.sample_ratio = sample_ratio
+
+    @property
+    def enabled(self) -> bool:
+        return self.ring is not None
+
+    def start_span(self, name: str, kind: int = KIND_INTERNAL, parent: Optional[TraceContext] = None,
+                   attributes: Optional[Mapping[str, object]] = None) -> Span:
+        """Start a span under parent (default: the current context)."""
+        parent = parent or _current.get()
+        if self.ring is None:
+            # Disabled: the span stands in for its parent so inject() forwards it
+            return Span(self, name, kind, parent, 0, attributes)
+        if parent is not None:
+            context = TraceContext(parent.trace_id, _new_span_id(), parent.flags)
+            return Span(self, name, kind, context, parent.span_id, attributes)
+        sampled = self.sample_ratio >= 1.0 or random.random() < self.sample_ratio  # nosec B311
+        context = TraceContext(_new_trace_id(), _new_span_id(), FLAG_SAMPLED if sampled else 0)
+        return Span(self, name, kind, context, 0, attributes)
+
+    @contextlib.contextmanager
+    def span(self, name: str, kind: int = KIND_INTERNAL, parent: Optional[TraceContext] = None,
+             attributes: Optional[Mapping[str, object]] = None) -> Iterator[Span]:
+        """Run a block in a span, current for its duration; an exception marks it failed."""
+        span = self.start_span(name, kind, parent, attributes)
+        token = _current.set(span.context)
+        try:
+            yield span
+        except BaseException:
+            span.set_error()
+            raise
+        finally:
+            _current.reset(token)
+            span.end()
+
+    def record(self, span: Span, duration_us: int) -> bool:
+        ctx = span.context
+        return self.ring.record(
+            ctx.trace_id, ctx.span_id, span.parent_id, span.start_us, duration_us, span.kind, span.status,
+            self._service, span.name.encode("utf-8", "replace"), format_attributes(span.attributes)
+        )
+
+    @staticmethod
+    def inject(headers: Optional[Dict[str, str]] = None,
+               context: Optional[TraceContext] = None) -> Dict[str, str]:
+        """headers (a new dict by default) with the traceparent of context (default: current)."""
+        headers = {} if headers is None else headers
+        context = context or _current.get()
+        if context is not None:
+            headers[TRACEPARENT_HEADER] = format_traceparent(context)
+        return headers
+
+    @staticmethod
+    def extract(headers: Mapping[str, str]) -> Optional[TraceContext]:
+        return parse_traceparent(headers.get(TRACEPARENT_HEADER))
+
+
+# ============================================================================
+# EXPORT
+# ============================================================================
+
+class SpanExporter:
+    """A thread draining a span ring every interval to a file and/or collector.
+
+    A collector that cannot be reached loses those spans (counted in
+    post_errors); the file, when configured, still has them.
+    """
+
+    def __init__(self, ring, path: Optional[str] = None, endpoint: Optional[str] = None,
+                 interval: float = EXPORT_INTERVAL_S, timeout: float = 2.0):
+        self.ring = ring
+        self.path = path
+        self.endpoint = endpoint
+        self.url = endpoint.rstrip("/") + "/v1/traces" if endpoint else None
+        self.interval = interval
+        self.timeout = timeout
+        self.post_errors = 0
+        self.write_errors = 0
+        self._stop = threading.Event()
+        self._lock = threading.Lock()
+        self._thread = threading.Thread(target=self._run, name="span-exporter", daemon=True)
+
+    def start(self) -> "SpanExporter":
+        self._thread.start()
+        return self
+
+    def _run(self) -> None:
+        while not self._stop.wait(self.interval):
+            self.export()
+
+    def export(self) -> int:
+        """Drain everything queued now; returns the number of documents."""
+        documents = 0
+        with self._lock:
+            while True:
+                document = self.ring.drain(EXPORT_BATCH_SPANS)
+                if not document:
+                    return documents
+                documents += 1
+                if self.path:
+                    self._append(document + b"\n")
+                if self.url:
+                    self._post(document)
+
+    def _append(self, line: bytes) -> None:
+        # One O_APPEND write per document keeps lines whole when processes share the file
+        try:
+            fd = os.open(self.path, os.O_WRONLY | os.O_CREAT | os.O_APPEND, 0o644)
+            try:
+                os.write(fd, line)
+            finally:
+                os.close(fd)
+        except OSError:
+            self.write_errors += 1
+
+    def _post(self, document: bytes) -> None:
+        request = urllib.request.Request(
+            self.url, data=document, method="POST", headers={"Content-Type": "application/json"}
+        )
+        try:
+            with urllib.request.urlopen(request, timeout=self.timeout) as response:  # nosec B310
+                response.read()
+        except (OSError, ValueError):
+            self.post_errors += 1
+
+    def stop(self) -> None:
+        """Stop the thread and export what is left."""
+        self._stop.set()
+        if self._thread.is_alive():
+            self._thread.join()
+        self.export()
+
+
+_tracers: Dict[str, Tracer] = {}
+_exporter: Optional[SpanExporter] = None
+
+
+def _restart_after_fork() -> None:
+    """The exporter thread does not survive fork(); the child gets its own ring and thread."""
+    global _exporter
+    if _exporter is None:
+        return
+    ring = open_span_ring()
+    _exporter = SpanExporter(ring, _exporter.path, _exporter.endpoint, _exporter.interval).start()
+    for tracer in _tracers.values():
+        tracer.ring = ring
+
+
+def _stop_exporter() -> None:
+    if _exporter is not None:
+        _exporter.stop()
+
+
+def setup_tracing(service: str) -> Tracer:
+    """The process's tracer for service, exporting as the environment says.
+
+    PULSEMIND_TRACE_FILE (span lines) and/or PULSEMIND_OTLP_ENDPOINT (an
+    OTLP/HTTP collector base URL) enable it; PULSEMIND_TRACE_SAMPLE_RATIO
+    (default 1) samples root spans.
+    """
+    global _exporter
+    if service in _tracers:
+        return _tracers[service]
+    path = os.getenv("PULSEMIND_TRACE_FILE") or None
+    endpoint = os.getenv("PULSEMIND_OTLP_ENDPOINT") or None
+    ratio = float(os.getenv("PULSEMIND_TRACE_SAMPLE_RATIO", "1"))
+    ring = None
+    if path or endpoint:
+        if _exporter is None:
+            _exporter = SpanExporter(open_span_ring(), path, endpoint).start()
+            os.register_at_fork(after_in_child=_restart_after_fork)
+            atexit.register(_stop_exporter)
+        ring = _exporter.ring
+    tracer = Tracer(service, ring, ratio)
+    _tracers[service] = tracer
+    return tracer
+
+
+# ============================================================================
+# FLASK
+# ============================================================================
+
+def instrument_flask(app, tracer: Tracer) -> None:
+    """Run every request of app in a server span under its incoming traceparent.
+
+    The span is named "METHOD route"; responses of 500 and above and
+    unhandled exceptions mark it failed.
+    """
+    from flask import g, request
+
+    @app.before_request
+    def _start_server_span():
+        route = request.url_rule.rule if request.url_rule is not None else request.path
+        span = tracer.start_span(
+            f"{request.method} {route}", KIND_SERVER, parent=tracer.extract(request.headers),
+            attributes={"http.method": request.method, "http.route": route},
+        )
+        g.pulsemind_span = (span, _current.set(span.context))
+
+    @app.after_request
+    def _record_status(response):
+        entry = g.get("pulsemind_span")
+        if entry is not None:
+            entry[0].set_attribute("http.status_code", response.status_code)
+            if response.status_code >= 500:
+                entry[0].set_error()
+        return response
+
+    @app.teardown_request
+    def _end_server_span(exc):
+        entry = g.pop("pulsemind_span", None)
+        if entry is None:
+            return
+        span, token = entry
+        if exc is not None:
+            span.set_error()
+        try:
+            _current.reset(token)
+        except ValueError:
+            pass  # Torn down in another context
+        span.end()
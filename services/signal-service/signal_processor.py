@@ -13,38 +13,34 @@ from scipy import signal
 
 # Add shared module to path
 sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
-from shared.logger import setup_logger  # noqa: E402
+from shared.logger import hot_path_logger, setup_logger  # noqa: E402
 
 logger = setup_logger("signal-processor", level="INFO")
 
+# Per-request progress lines: kept to a steady trickle under load
+request_logger = hot_path_logger(logger, per_second=10, burst=20)
 
-def bandpass_filter(
-    signal_data: np.ndarray,
+
+def design_bandpass(
     sampling_rate: float,
     lowcut: float = 0.5,
     highcut: float = 4.0,
     order: int = 4
-) -> np.ndarray:
-    """Apply Butterworth bandpass filter to PPG signal.
+) -> Tuple[np.ndarray, np.ndarray]:
+    """Design the Butterworth bandpass used by bandpass_filter.
 
-    Typical PPG signals have frequency components between 0.5-4 Hz,
-    corresponding to heart rates of 30-240 BPM.
-    
     Args:
-        signal_data: Input signal array
         sampling_rate: Sampling rate in Hz
-        lowcut: Low cutoff frequency in Hz (default: 0.5 Hz = 30 BPM)
-        highcut: High cutoff frequency in Hz (default: 4 Hz = 240 BPM)
-        order: Filter order (default: 4)
-    
+        lowcut: Low cutoff frequency in Hz
+        highcut: High cutoff frequency in Hz
+        order: Filter order
+
     Returns:
-        Filtered signal array
-    
+        Tuple of (b, a) transfer function coefficients
+
     Raises:
         ValueError: If sampling rate is too low or cutoff frequencies are invalid
     """
-    logger.debug(f"Applying bandpass filter: {lowcut}-{highcut} Hz, SR={sampling_rate} Hz")
-    
     # Validate inputs
     if sampling_rate <= 0:
         raise ValueError(f"Sampling rate must be positive, got {sampling_rate}")
@@ -68,6 +64,37 @@ def bandpass_filter(
     
     # Design Butterworth bandpass filter
     b, a = signal.butter(order, [low, high], btype='band')
+    return b, a
+
+
+def bandpass_filter(
+    signal_data: np.ndarray,
+    sampling_rate: float,
+    lowcut: float = 0.5,
+    highcut: float = 4.0,
+    order: int = 4
+) -> np.ndarray:
+    """Apply Butterworth bandpass filter to PPG signal.
+
+    Typical PPG signals have frequency components between 0.5-4 Hz,
+    corresponding to heart rates of 30-240 BPM.
+    
+    Args:
+        signal_data: Input signal array
+        sampling_rate: Sampling rate in Hz
+        lowcut: Low cutoff frequency in Hz (default: 0.5 Hz = 30 BPM)
+        highcut: High cutoff frequency in Hz (default: 4 Hz = 240 BPM)
+        order: Filter order (default: 4)
+    
+    Returns:
+        Filtered signal array
+    
+    Raises:
+        ValueError: If sampling rate is too low or cutoff frequencies are invalid
+    """
+    logger.debug(f"Applying bandpass filter: {lowcut}-{highcut} Hz, SR={sampling_rate} Hz")
+    
+    b, a = design_bandpass(sampling_rate, lowcut, highcut, order)
     
     # Apply filter (using lfilter for causal/real-time processing)
     # MEDICAL GRADE: lfilter is causal and has zero look-ahead latency.
@@ -149,7 +176,7 @@ def extract_features(
     Raises:
         ValueError: If insufficient peaks for feature extraction
     """
-    logger.info(f"Extracting features from {len(peaks)} peaks")
+    request_logger.info("Extracting features from %d peaks", len(peaks))
     
     if len(peaks) < 2:
         raise ValueError(f"Need at least 2 peaks for feature extraction, got {len(peaks)}")
@@ -191,7 +218,7 @@ def extract_features(
         "num_peaks": int(len(peaks))
     }
     
-    logger.info(f"Features extracted: HR={heart_rate_bpm:.1f} BPM, HRV={hrv_sdnn_ms:.1f} ms")
+    request_logger.info("Features extracted: HR=%.1f BPM, HRV=%.1f ms", heart_rate_bpm, hrv_sdnn_ms)
     return features
 
 
@@ -219,7 +246,7 @@ def process_ppg_signal(
     Raises:
         ValueError: If input validation fails
     """
-    logger.info(f"Processing PPG signal: {len(signal_array)} samples at {sampling_rate} Hz")
+    request_logger.info("Processing PPG signal: %d samples at %s Hz", len(signal_array), sampling_rate)
     
     # Validate inputs
     if not signal_array:
@@ -275,7 +302,7 @@ def process_ppg_signal(
         logger.error(f"Feature extraction failed: {e}")
         raise ValueError(f"Feature extraction failed: {e}")
     
-    logger.info("PPG signal processing completed successfully")
+    request_logger.info("PPG signal processing completed successfully")
     
     return {
         "success": True,
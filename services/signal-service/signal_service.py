@@ -7,14 +7,22 @@ from flask import Flask, jsonify, request
 
 # Add shared module to path
 sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+from shared import metrics  # noqa: E402
 from shared.logger import setup_logger  # noqa: E402
 from shared.shutdown import register_shutdown_handler  # noqa: E402
+from shared.tracing import instrument_flask, setup_tracing  # noqa: E402
 from signal_processor import process_ppg_signal  # noqa: E402
 
 # Initialize logger
 logger = setup_logger("signal-service", level="INFO")
 
 app = Flask(__name__)
+instrument_flask(app, setup_tracing("signal-service"))
+registry = metrics.instrument_flask(app, "signal-service")
+process_seconds = registry.histogram(
+    "pulsemind_processing_duration_seconds", "Time spent in a service's processing steps",
+    service="signal-service", operation="process",
+)
 
 
 @app.route('/health')
@@ -131,6 +139,7 @@ def process_signal():
         # Add processing time to metadata
         processing_time_ms = (time.time() - start_time) * 1000
         result["metadata"]["processing_time_ms"] = round(processing_time_ms, 2)
+        process_seconds.observe(processing_time_ms / 1000)
         
         # Add timestamp (required by schema)
         result["timestamp"] = datetime.utcnow().isoformat() + "Z"
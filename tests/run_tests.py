@@ -19,8 +19,23 @@ BOLD = "\033[1m"
 SERVICES = {
     "Signal Service": "services/signal-service/test_signal_processor.py",
     "HSI Service": "services/hsi-service/test_hsi_computer.py",
+    "HSI History": "services/hsi-service/test_hsi_history.py",
     "AI Inference": "services/ai-inference/test_rhythm_classifier.py",
     "Control Engine": "services/control-engine/test_pacing_controller.py",
+    "Decision Replay": "services/control-engine/test_decision_replay.py",
+    "Decision Journal": "services/control-engine/test_decision_journal.py",
+    "Waveform Store": "services/control-engine/test_waveform_store.py",
+    "Downsampling": "services/shared/test_downsample.py",
+    "Native Logger": "services/shared/test_native_log.py",
+    "PHI Crypto": "services/shared/test_phi_crypto.py",
+    "JWT Verification": "services/shared/test_jwt_verify.py",
+    "Tracing": "services/shared/test_tracing.py",
+    "Metrics": "services/shared/test_metrics.py",
+    "Fused Pipeline": "services/pipeline-service/test_fused_pipeline.py",
+    "Ingest Worker": "services/ingest-worker/test_ingest_worker.py",
+    "Live Hub": "services/live-hub/test_live_hub.py",
+    "API Gateway": "services/api-gateway/test_upstream.py",
+    "Gateway Health Prober": "services/api-gateway/test_health_prober.py",
     "Integration Suite": "tests/integration_test.py"
 }
 